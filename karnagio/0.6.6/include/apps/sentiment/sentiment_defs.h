@@ -215,7 +215,7 @@ namespace fl{ namespace app {
       task();
       return ;
     } 
-    ws->schedule(task);
+    ws->schedule(task, args);
   }
 
 
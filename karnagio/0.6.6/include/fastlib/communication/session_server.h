@@ -0,0 +1,217 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef FL_LITE_INCLUDE_FASTLIB_COMMUNICATION_SESSION_SERVER_H_
+#define FL_LITE_INCLUDE_FASTLIB_COMMUNICATION_SESSION_SERVER_H_
+
+#include <map>
+#include <vector>
+#include "boost/asio.hpp"
+#include "boost/bind.hpp"
+#include "boost/shared_ptr.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/thread/thread.hpp"
+#include "boost/utility.hpp"
+#include "fastlib/base/base.h"
+#include "connection.h"
+
+namespace fl { namespace com {
+
+  /// The read handler of the synchronous reads, it records that the
+  /// message could not be decoded.
+  inline void ReadFailed(const boost::system::error_code &e,
+      connection *conn,
+      bool *failed) {
+    *failed=true;
+  }
+
+  /// Sends a request and waits for its response, it returns false if the
+  /// connection was lost or the service could not answer.
+  template<typename RequestType, typename ResponseType>
+  bool Exchange(connection_ptr conn,
+      RequestType &request,
+      ResponseType *response) {
+    bool failed=false;
+    try {
+      conn->sync_write(request);
+      conn->sync_read(*response, boost::bind(&ReadFailed, _1, _2, &failed));
+    }
+    catch(const std::exception &e) {
+      fl::logger->Warning()<<"Lost the connection to the service: "<<e.what();
+      return false;
+    }
+    if (failed) {
+      fl::logger->Warning()<<"Could not decode the answer of the service";
+      return false;
+    }
+    if (response->error!="") {
+      fl::logger->Warning()<<"The service could not answer: "<<response->error;
+      return false;
+    }
+    return true;
+  }
+
+  /// Copies n_points points of a table, starting at first_point, to a
+  /// request that carries dense points one after the other. The table
+  /// wraps around, so that a benchmark can send more points than it has.
+  template<typename TableType, typename RequestType>
+  void CopyPoints(const TableType &table,
+      index_t first_point,
+      index_t n_points,
+      RequestType *request) {
+    const index_t dimension=table.n_attributes();
+    request->dimension=dimension;
+    request->stop=false;
+    request->points.resize(n_points*dimension);
+    typename TableType::Point_t point;
+    for(index_t i=0; i<n_points; ++i) {
+      table.get((first_point+i) % table.n_entries(), &point);
+      for(index_t d=0; d<dimension; ++d) {
+        request->points[i*dimension+d]=point[d];
+      }
+    }
+  }
+
+  /// The responder of the Server that serves every connection on its own
+  /// thread until the client closes it. The handler answers the requests:
+  /// it defines Request_t and Response_t and
+  ///   void operator()(const Request_t &request, Response_t *response);
+  /// A request with stop set stops the io_service of the server.
+  template<typename HandlerType>
+  class SessionServer : private boost::noncopyable {
+    public:
+      typedef typename HandlerType::Request_t Request_t;
+      typedef typename HandlerType::Response_t Response_t;
+
+      SessionServer(HandlerType *handler,
+          boost::asio::io_service *io_service)
+        : handler_(handler), io_service_(io_service) {
+      }
+
+      bool operator()(const boost::system::error_code& e,
+          connection_ptr conn) {
+        std::vector<boost::shared_ptr<boost::thread> > finished;
+        {
+          // the thread is registered before the session can look for it
+          boost::mutex::scoped_lock lock(mutex_);
+          finished.swap(finished_);
+          sessions_[conn].reset(new boost::thread(
+              boost::bind(&SessionServer<HandlerType>::Session_, this, conn)));
+        }
+        for(size_t i=0; i<finished.size(); ++i) {
+          finished[i]->join();
+        }
+        return true;
+      }
+
+      /// Closes the connections that are still open and waits for their
+      /// threads.
+      void Join() {
+        std::vector<boost::shared_ptr<boost::thread> > threads;
+        {
+          // the sessions that wait for a request fail to read and return
+          boost::mutex::scoped_lock lock(mutex_);
+          boost::system::error_code error;
+          typename Sessions_t::iterator it;
+          for(it=sessions_.begin(); it!=sessions_.end(); ++it) {
+            it->first->socket().shutdown(
+                boost::asio::ip::tcp::socket::shutdown_both, error);
+            threads.push_back(it->second);
+          }
+          threads.insert(threads.end(), finished_.begin(), finished_.end());
+          finished_.clear();
+        }
+        for(size_t i=0; i<threads.size(); ++i) {
+          threads[i]->join();
+        }
+        // the sessions that were running moved their threads to finished_
+        boost::mutex::scoped_lock lock(mutex_);
+        finished_.clear();
+      }
+
+    private:
+      typedef std::map<connection_ptr,
+              boost::shared_ptr<boost::thread> > Sessions_t;
+
+      HandlerType *handler_;
+      boost::asio::io_service *io_service_;
+      // the sessions that are running, with their threads
+      Sessions_t sessions_;
+      // the threads of the sessions that returned, they are joined
+      // when the next connection is accepted or by Join
+      std::vector<boost::shared_ptr<boost::thread> > finished_;
+      boost::mutex mutex_;
+
+      void Session_(connection_ptr conn) {
+        Serve_(conn);
+        // the connection is released here, the thread cannot join itself
+        // so it is left for the next accept or for Join
+        boost::mutex::scoped_lock lock(mutex_);
+        typename Sessions_t::iterator it=sessions_.find(conn);
+        if (it!=sessions_.end()) {
+          finished_.push_back(it->second);
+          sessions_.erase(it);
+        }
+      }
+
+      void Serve_(connection_ptr conn) {
+        // the requests are small, they should not wait for the ack of the
+        // previous answer
+        conn->socket().set_option(boost::asio::ip::tcp::no_delay(true));
+        while (true) {
+          Request_t request;
+          bool failed=false;
+          try {
+            conn->sync_read(request, boost::bind(&ReadFailed, _1, _2, &failed));
+          }
+          catch(const std::exception &e) {
+            // the client closed the connection
+            return;
+          }
+          if (failed) {
+            fl::logger->Warning()<<"Received a request that could not be "
+              <<"decoded, closing the connection";
+            return;
+          }
+          if (request.stop) {
+            fl::logger->Message()<<"Received a stop request";
+            io_service_->stop();
+            return;
+          }
+          Response_t response;
+          (*handler_)(request, &response);
+          try {
+            conn->sync_write(response);
+          }
+          catch(const std::exception &e) {
+            return;
+          }
+        }
+      }
+  };
+
+}}
+
+#endif
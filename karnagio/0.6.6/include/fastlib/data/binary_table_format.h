@@ -0,0 +1,465 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef FL_LITE_FASTLIB_DATA_BINARY_TABLE_FORMAT_H_
+#define FL_LITE_FASTLIB_DATA_BINARY_TABLE_FORMAT_H_
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include "fastlib/base/base.h"
+#include "boost/shared_ptr.hpp"
+#include "boost/mpl/bool.hpp"
+#include "boost/serialization/nvp.hpp"
+#include "boost/serialization/serialization.hpp"
+#include "boost/serialization/split_member.hpp"
+#include "boost/static_assert.hpp"
+#include "boost/type_traits/integral_constant.hpp"
+#include "boost/type_traits/is_arithmetic.hpp"
+#include "boost/type_traits/is_floating_point.hpp"
+#include "boost/type_traits/is_signed.hpp"
+#include "boost/iostreams/device/mapped_file.hpp"
+
+namespace fl {
+namespace data {
+/**
+ * @brief The native binary table format. The file starts with a fixed
+ *        size prelude:
+ *          magic (8 bytes), version, footer offset, footer size
+ *        followed by the data blocks, every one of them aligned at 
+ *        kAlignment bytes:
+ *          dense:  one column major block per dense type, the same
+ *                  layout the Compact storage keeps in memory
+ *          sparse: one CSR block (row offsets, indices, values) 
+ *                  per sparse type
+ *          meta:   one array per metadata field
+ *          index:  optionally the tree and the permutation of the points
+ *        The footer has the header of the dataset and the offsets of
+ *        the blocks. The footer and the index are written with fixed
+ *        width fields (BinaryTableOArchive), so that the file does not
+ *        depend on the version of boost. Since the dense blocks
+ *        are stored exactly like in memory they are attached through mmap 
+ *        and paged in on demand.
+ */
+struct BinaryTableFormat {
+  static const char *Magic() {
+    return "FLTABLE\x01";
+  }
+  static const index_t kMagicSize=8;
+  static const uint64 kVersion=2;
+  static const uint64 kAlignment=64;
+  static const uint64 kPreludeSize=64;
+  /**
+   * @brief tables exported with this extension are written in the
+   *        binary format
+   */
+  static const char *Extension() {
+    return ".fltb";
+  }
+};
+
+/**
+ * @brief The type a field of type T is written as in a binary table:
+ *        integers take 64 bits, floating points keep their 32 or 64
+ *        bits and booleans take one byte
+ */
+template<typename T,
+         bool is_floating_point=boost::is_floating_point<T>::value,
+         bool is_signed=boost::is_signed<T>::value>
+struct BinaryTableField {
+  typedef uint64 type;
+};
+
+template<typename T, bool is_signed>
+struct BinaryTableField<T, true, is_signed> {
+  BOOST_STATIC_ASSERT(sizeof(T)==4 || sizeof(T)==8);
+  typedef T type;
+};
+
+template<typename T>
+struct BinaryTableField<T, false, true> {
+  typedef int64 type;
+};
+
+template<>
+struct BinaryTableField<bool, false, false> {
+  typedef uint8 type;
+};
+
+/**
+ * @brief Writes the footer and the index of a binary table with fixed
+ *        width fields, in the byte order of the prelude. Strings and
+ *        vectors start with their 64 bit size and pointers with a one
+ *        byte flag that is zero for NULL. The classes are written through
+ *        their boost serialize methods, like they would be in a boost
+ *        archive, but without the class information of boost. Shared
+ *        pointers are not tracked, every pointer is written in full.
+ */
+class BinaryTableOArchive {
+  public:
+    typedef boost::mpl::bool_<true> is_saving;
+    typedef boost::mpl::bool_<false> is_loading;
+
+    explicit BinaryTableOArchive(std::ostream &out) : out_(out) {
+    }
+
+    template<typename T>
+    BinaryTableOArchive &operator<<(const T &t) {
+      Save_(t);
+      return *this;
+    }
+
+    template<typename T>
+    BinaryTableOArchive &operator&(const T &t) {
+      Save_(t);
+      return *this;
+    }
+
+  private:
+    std::ostream &out_;
+
+    template<typename T>
+    void Write_(const T &t) {
+      typename BinaryTableField<T>::type field=
+        static_cast<typename BinaryTableField<T>::type>(t);
+      out_.write(reinterpret_cast<const char*>(&field), sizeof(field));
+    }
+
+    template<typename T>
+    void Save_(const boost::serialization::nvp<T> &t) {
+      Save_(t.const_value());
+    }
+
+    void Save_(const std::string &t) {
+      Write_(static_cast<uint64>(t.size()));
+      out_.write(t.data(), t.size());
+    }
+
+    template<typename T, typename Allocator>
+    void Save_(const std::vector<T, Allocator> &t) {
+      Write_(static_cast<uint64>(t.size()));
+      for(size_t i=0; i<t.size(); ++i) {
+        Save_(t[i]);
+      }
+    }
+
+    template<typename T, size_t n>
+    void Save_(const T (&t)[n]) {
+      for(size_t i=0; i<n; ++i) {
+        Save_(t[i]);
+      }
+    }
+
+    template<typename T>
+    void Save_(T * const &t) {
+      Write_(t!=NULL);
+      if (t!=NULL) {
+        Save_(*t);
+      }
+    }
+
+    template<typename T>
+    void Save_(const T &t) {
+      SaveValue_(t, boost::is_arithmetic<T>());
+    }
+
+    template<typename T>
+    void SaveValue_(const T &t, boost::true_type) {
+      Write_(t);
+    }
+
+    template<typename T>
+    void SaveValue_(const T &t, boost::false_type) {
+      boost::serialization::serialize_adl(*this, const_cast<T&>(t), 0);
+    }
+};
+
+/**
+ * @brief Reads what BinaryTableOArchive writes
+ */
+class BinaryTableIArchive {
+  public:
+    typedef boost::mpl::bool_<false> is_saving;
+    typedef boost::mpl::bool_<true> is_loading;
+
+    explicit BinaryTableIArchive(std::istream &in) : in_(in) {
+    }
+
+    template<typename T>
+    BinaryTableIArchive &operator>>(T &t) {
+      Load_(t);
+      return *this;
+    }
+
+    template<typename T>
+    BinaryTableIArchive &operator>>(const boost::serialization::nvp<T> &t) {
+      Load_(t.value());
+      return *this;
+    }
+
+    template<typename T>
+    BinaryTableIArchive &operator&(T &t) {
+      return *this >> t;
+    }
+
+    template<typename T>
+    BinaryTableIArchive &operator&(const boost::serialization::nvp<T> &t) {
+      return *this >> t;
+    }
+
+  private:
+    std::istream &in_;
+
+    void ReadBytes_(char *bytes, uint64 n_bytes) {
+      in_.read(bytes, n_bytes);
+      if (static_cast<uint64>(in_.gcount())!=n_bytes) {
+        fl::logger->Die()<<"The binary table ends in the middle of a field";
+      }
+    }
+
+    template<typename T>
+    void Read_(T *t) {
+      typename BinaryTableField<T>::type field;
+      ReadBytes_(reinterpret_cast<char*>(&field), sizeof(field));
+      *t=static_cast<T>(field);
+    }
+
+    void Load_(std::string &t) {
+      uint64 size;
+      Read_(&size);
+      t.resize(size);
+      if (size>0) {
+        ReadBytes_(&t[0], size);
+      }
+    }
+
+    template<typename T, typename Allocator>
+    void Load_(std::vector<T, Allocator> &t) {
+      uint64 size;
+      Read_(&size);
+      t.resize(size);
+      for(size_t i=0; i<t.size(); ++i) {
+        Load_(t[i]);
+      }
+    }
+
+    template<typename T, size_t n>
+    void Load_(T (&t)[n]) {
+      for(size_t i=0; i<n; ++i) {
+        Load_(t[i]);
+      }
+    }
+
+    template<typename T>
+    void Load_(T *&t) {
+      bool is_set;
+      Read_(&is_set);
+      t=NULL;
+      if (is_set) {
+        t=new T();
+        Load_(*t);
+      }
+    }
+
+    template<typename T>
+    void Load_(T &t) {
+      LoadValue_(t, boost::is_arithmetic<T>());
+    }
+
+    template<typename T>
+    void LoadValue_(T &t, boost::true_type) {
+      Read_(&t);
+    }
+
+    template<typename T>
+    void LoadValue_(T &t, boost::false_type) {
+      boost::serialization::serialize_adl(*this, t, 0);
+    }
+};
+
+/**
+ * @brief Everything we need to know to attach the blocks of a binary 
+ *        table file.
+ */
+struct BinaryTableFooter {
+  BinaryTableFooter() : version(BinaryTableFormat::kVersion), 
+    num_of_points(0), num_of_metadata(0), n_attributes(0), load_meta(0),
+    has_index(0), index_offset(0), index_size(0) {
+  }
+  uint64 version;
+  // the header as it would appear in a text file, we use it
+  // to check the types
+  std::string header;
+  std::string dataset_header;
+  std::string meta_types;
+  std::vector<std::string> labels;
+  index_t num_of_points;
+  index_t num_of_metadata;
+  index_t n_attributes;
+  int32 load_meta;
+  std::vector<index_t> dense_sizes;
+  std::vector<index_t> sparse_sizes;
+  // one offset per dense type 
+  std::vector<uint64> dense_offsets;
+  // three offsets per sparse type, row offsets, indices, values
+  std::vector<uint64> sparse_offsets;
+  // one offset per metadata field
+  std::vector<uint64> meta_offsets;
+  int32 has_index;
+  uint64 index_offset;
+  uint64 index_size;
+
+  template<typename Archive>
+  void serialize(Archive &ar, const unsigned int version) {
+    ar & this->version;
+    ar & header;
+    ar & dataset_header;
+    ar & meta_types;
+    ar & labels;
+    ar & num_of_points;
+    ar & num_of_metadata;
+    ar & n_attributes;
+    ar & load_meta;
+    ar & dense_sizes;
+    ar & sparse_sizes;
+    ar & dense_offsets;
+    ar & sparse_offsets;
+    ar & meta_offsets;
+    ar & has_index;
+    ar & index_offset;
+    ar & index_size;
+  }
+};
+
+/**
+ * @brief returns true if the file starts with the magic number 
+ *        of the binary format
+ */
+inline bool IsBinaryTableFile(const std::string &filename) {
+  std::ifstream fin(filename.c_str(), std::ios::in | std::ios::binary);
+  if (fin.fail()) {
+    return false;
+  }
+  char magic[BinaryTableFormat::kMagicSize];
+  fin.read(magic, BinaryTableFormat::kMagicSize);
+  if (fin.gcount()!=BinaryTableFormat::kMagicSize) {
+    return false;
+  }
+  return memcmp(magic, BinaryTableFormat::Magic(), 
+      BinaryTableFormat::kMagicSize)==0;
+}
+
+/**
+ * @brief pads the stream with zeros up to the next aligned position
+ */
+inline uint64 AlignBinaryTableStream(std::ostream &out) {
+  uint64 position=static_cast<uint64>(out.tellp());
+  uint64 padding=(BinaryTableFormat::kAlignment
+      -position%BinaryTableFormat::kAlignment)%BinaryTableFormat::kAlignment;
+  static const char zeros[BinaryTableFormat::kAlignment]={0};
+  out.write(zeros, padding);
+  return position+padding;
+}
+
+/**
+ * @brief writes the prelude at the beginning of the stream and
+ *        the footer at the current position
+ */
+inline void WriteBinaryTableFooter(const BinaryTableFooter &footer, 
+    std::ostream &out) {
+  uint64 footer_offset=AlignBinaryTableStream(out);
+  BinaryTableOArchive oa(out);
+  oa << footer;
+  uint64 footer_size=static_cast<uint64>(out.tellp())-footer_offset;
+  char prelude[BinaryTableFormat::kPreludeSize]={0};
+  memcpy(prelude, BinaryTableFormat::Magic(), BinaryTableFormat::kMagicSize);
+  uint64 version=BinaryTableFormat::kVersion;
+  memcpy(prelude+8, &version, sizeof(uint64));
+  memcpy(prelude+16, &footer_offset, sizeof(uint64));
+  memcpy(prelude+24, &footer_size, sizeof(uint64));
+  out.seekp(0);
+  out.write(prelude, BinaryTableFormat::kPreludeSize);
+  out.seekp(0, std::ios::end);
+  if (out.fail()) {
+    fl::logger->Die()<<"Something went wrong while writing the binary table";
+  }
+}
+
+/**
+ * @brief reads the footer of a binary table file
+ */
+inline void ReadBinaryTableFooter(const std::string &filename,
+    BinaryTableFooter *footer) {
+  std::ifstream fin(filename.c_str(), std::ios::in | std::ios::binary);
+  if (fin.fail()) {
+    fl::logger->Die() << "Could not open file " << filename
+      << "   error: " << strerror(errno);
+  }
+  char prelude[BinaryTableFormat::kPreludeSize];
+  fin.read(prelude, BinaryTableFormat::kPreludeSize);
+  if (fin.gcount()!=BinaryTableFormat::kPreludeSize 
+      || memcmp(prelude, BinaryTableFormat::Magic(), 
+        BinaryTableFormat::kMagicSize)!=0) {
+    fl::logger->Die()<<"File ("<<filename<<") is not a binary table";
+  }
+  uint64 version;
+  uint64 footer_offset;
+  memcpy(&version, prelude+8, sizeof(uint64));
+  memcpy(&footer_offset, prelude+16, sizeof(uint64));
+  if (version!=BinaryTableFormat::kVersion) {
+    fl::logger->Die()<<"File ("<<filename<<") has binary table version "
+      <<version<<" while this build supports version "
+      <<static_cast<uint64>(BinaryTableFormat::kVersion);
+  }
+  fin.seekg(footer_offset);
+  BinaryTableIArchive ia(fin);
+  ia >> *footer;
+  if (footer->version!=version) {
+    fl::logger->Die()<<"File ("<<filename<<") has a footer of version "
+      <<footer->version<<" in a binary table of version "<<version;
+  }
+}
+
+/**
+ * @brief maps a binary table file in memory. The mapping is private,
+ *        so that tables attached on it can still be modified without
+ *        touching the file. Pages are loaded only when they are accessed
+ */
+inline boost::shared_ptr<boost::iostreams::mapped_file> MapBinaryTableFile(
+    const std::string &filename) {
+  boost::shared_ptr<boost::iostreams::mapped_file> file;
+  try {
+    boost::iostreams::mapped_file_params params(filename);
+    params.flags=boost::iostreams::mapped_file::priv;
+    file.reset(new boost::iostreams::mapped_file(params));
+  }
+  catch(const std::exception &e) {
+    fl::logger->Die() << "Could not map file " << filename
+      << " in memory, error: " << e.what();
+  }
+  return file;
+}
+
+}}
+#endif
@@ -0,0 +1,237 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef FL_LITE_FASTLIB_DATA_COMPACT_SPARSE_CONTAINER_H_
+#define FL_LITE_FASTLIB_DATA_COMPACT_SPARSE_CONTAINER_H_
+#include <deque>
+#include <vector>
+#include "fastlib/base/base.h"
+#include "boost/serialization/split_member.hpp"
+#include "boost/serialization/deque.hpp"
+
+namespace fl {
+namespace data {
+/**
+ * @brief The container of the sparse points of a compact table. The 
+ *        elements of all the points are stored in CSR like arenas, one
+ *        for the whole table, or one for every part that is loaded by a 
+ *        different thread. Every point aliases its row, so there is
+ *        no heap allocation per point. The points and the rows live in
+ *        deques, so their addresses do not change when points are
+ *        appended.
+ */
+template<typename PointType>
+class CompactSparseContainer {
+  public:
+    friend class boost::serialization::access;
+    typedef CompactSparseContainer<PointType> type;
+    typedef typename PointType::Container_t Row_t;
+    typedef typename Row_t::Arena_t Arena_t;
+    typedef PointType value_type;
+    typedef PointType& reference;
+    typedef const PointType& const_reference;
+    typedef typename std::deque<PointType>::iterator iterator;
+    typedef typename std::deque<PointType>::const_iterator const_iterator;
+    typedef typename std::deque<PointType>::size_type size_type;
+
+    CompactSparseContainer() : dimension_(0) {
+    }
+
+    CompactSparseContainer(const CompactSparseContainer &other) : 
+      dimension_(0) {
+      CopyFrom(other);
+    }
+
+    CompactSparseContainer &operator=(const CompactSparseContainer &other) {
+      if (this != &other) {
+        CopyFrom(other);
+      }
+      return *this;
+    }
+
+    /**
+     * @brief Allocates n_points empty points of the given dimension, 
+     *        all of them store their elements in the same arena
+     */
+    void Init(index_t dimension, index_t n_points) {
+      points_.clear();
+      rows_.clear();
+      arenas_.clear();
+      dimension_ = dimension;
+      arenas_.resize(1);
+      resize(n_points);
+    }
+
+    /**
+     * @brief The points [first, first+n_points) get an arena of their own,
+     *        that way different threads can fill different ranges of points
+     */
+    void SplitArena(index_t first, index_t n_points) {
+      DEBUG_ASSERT(first + n_points <= static_cast<index_t>(rows_.size()));
+      arenas_.push_back(Arena_t());
+      for (index_t i = first; i < first + n_points; ++i) {
+        rows_[i].Attach(&arenas_.back());
+      }
+    }
+
+    /**
+     * @brief Releases the capacity the arenas got while growing
+     */
+    void ShrinkToFit() {
+      for (typename std::deque<Arena_t>::iterator it = arenas_.begin();
+           it != arenas_.end(); ++it) {
+        Arena_t(*it).swap(*it);
+      }
+    }
+
+    /**
+     * @brief Reserves space for n_elements more elements in the last arena
+     */
+    void ReserveElements(size_type n_elements) {
+      if (arenas_.empty()) {
+        arenas_.resize(1);
+      }
+      arenas_.back().reserve(arenas_.back().size() + n_elements);
+    }
+
+    index_t dimension() const {
+      return dimension_;
+    }
+
+    iterator begin() {
+      return points_.begin();
+    }
+
+    const_iterator begin() const {
+      return points_.begin();
+    }
+
+    iterator end() {
+      return points_.end();
+    }
+
+    const_iterator end() const {
+      return points_.end();
+    }
+
+    size_type size() const {
+      return points_.size();
+    }
+
+    bool empty() const {
+      return points_.empty();
+    }
+
+    reference operator[](size_type i) {
+      return points_[i];
+    }
+
+    const_reference operator[](size_type i) const {
+      return points_[i];
+    }
+
+    reference front() {
+      return points_.front();
+    }
+
+    reference back() {
+      return points_.back();
+    }
+
+    void clear() {
+      points_.clear();
+      rows_.clear();
+      arenas_.clear();
+    }
+
+    void resize(size_type n_points) {
+      if (arenas_.empty()) {
+        arenas_.resize(1);
+      }
+      while (points_.size() > n_points) {
+        points_.pop_back();
+        rows_.pop_back();
+      }
+      while (points_.size() < n_points) {
+        rows_.push_back(Row_t());
+        rows_.back().Attach(&arenas_.back());
+        points_.push_back(PointType());
+        points_.back().Alias(&rows_.back(), dimension_);
+      }
+    }
+
+    void push_back(const PointType &point) {
+      if (empty()) {
+        dimension_ = point.size();
+      }
+      resize(size() + 1);
+      points_.back().Alias(&rows_.back(), point.size());
+      rows_.back().assign(point.elem()->begin(), point.elem()->end());
+    }
+
+    // the points are archived the same way ExtendableContainer archives
+    // its std::vector of points
+    template<typename Archive>
+    void save(Archive &ar,
+              const unsigned int version) const {
+      boost::serialization::save(ar, points_, version);
+    }
+
+    template<typename Archive>
+    void load(Archive &ar,
+              const unsigned int version) {
+      std::deque<PointType> points;
+      boost::serialization::load(ar, points, version);
+      clear();
+      size_type n_elements = 0;
+      typename std::deque<PointType>::iterator it;
+      for (it = points.begin(); it != points.end(); ++it) {
+        n_elements += it->nnz();
+      }
+      ReserveElements(n_elements);
+      for (it = points.begin(); it != points.end(); ++it) {
+        push_back(*it);
+      }
+    }
+
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+  private:
+    void CopyFrom(const CompactSparseContainer &other) {
+      clear();
+      arenas_.resize(1);
+      dimension_ = other.dimension_;
+      for (const_iterator it = other.begin(); it != other.end(); ++it) {
+        push_back(*it);
+      }
+    }
+
+    index_t dimension_;
+    std::deque<PointType> points_;
+    std::deque<Row_t> rows_;
+    std::deque<Arena_t> arenas_;
+};
+
+}}  // namespaces
+#endif
@@ -33,10 +33,14 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <fstream>
 #include <errno.h>
 #include <typeinfo>
+#include <algorithm>
+#include <cstring>
 #include "fastlib/base/base.h"
 #include "fastlib/base/mpl.h"
 #include "point.h"
+#include "compact_sparse_container.h"
 #include "typename.h"
+#include "binary_table_format.h"
 #include "boost/algorithm/string/split.hpp"
 #include "boost/algorithm/string/classification.hpp"
 #include "boost/algorithm/string/trim.hpp"
@@ -65,6 +69,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "boost/serialization/split_member.hpp"
 #include "boost/serialization/base_object.hpp"
 #include "boost/archive/archive_exception.hpp"
+#include "boost/thread/thread.hpp"
+#include "boost/exception_ptr.hpp"
 
 namespace fl {
 namespace data {
@@ -137,6 +143,7 @@ class MultiDataset {
 
 MultiDataset() {
   num_of_points_=0;
+  n_threads_=std::max(1, static_cast<int>(boost::thread::hardware_concurrency()));
 }
 
 #include "multi_dataset_mpl_defs.h"
@@ -236,6 +243,30 @@ MultiDataset() {
               std::vector<index_t> &ignored_dense_columns,
               std::string mode);
 
+    /**
+     * @brief Reads only the header, the labels and the first point of a text
+     *        file, so that the dimensions of the table are known. No points
+     *        are loaded. lines_to_skip is set to the number of lines that
+     *        precede the first point. Used together with InitFromText for
+     *        files that are loaded in blocks
+     */
+    void InitLayout(const std::string &filename, index_t *lines_to_skip);
+    /**
+     * @brief Loads the points of the text in [begin, end) with the layout
+     *        of a dataset initialized with InitLayout. The range must start
+     *        on a line boundary. Returns true if the points ended at a blank
+     *        line, which marks the end of the data
+     */
+    bool InitFromText(const MultiDataset &layout,
+                      const char *begin,
+                      const char *end);
+    /**
+     * @brief Counts the points of the text in [begin, end) the way 
+     *        InitFromText would load them, without loading them. Returns
+     *        true if the points ended at a blank line
+     */
+    bool CountText(const char *begin, const char *end, index_t *n_points);
+
 #include "multi_dataset_init_from.h"
     /**
       * @brief Initialize the MultiDataset from a dense Matrix or a container of MonolithicPoitns
@@ -290,6 +321,11 @@ MultiDataset() {
      *
      */
      void push_back(std::string &point);
+    /**
+     * @brief Removes the last point of the dataset, the way pop_back of
+     *        STL containers does. The compact storage keeps its memory
+     */
+     void pop_back();
 
 
     /**
@@ -336,6 +372,26 @@ MultiDataset() {
     void SetHeader(std::string header_in) ;
 
     bool TryToInit(const std::string &file);
+    /**
+     * @brief writes the dense, sparse and metadata blocks of the binary
+     *        table format at the current position of the stream and
+     *        records their offsets in the footer
+     */
+    void SaveBinary(std::ostream &out, BinaryTableFooter *footer);
+    /**
+     * @brief attaches the dataset on a binary table file. The file is
+     *        memory mapped and the Compact dense storage points directly
+     *        in the mapping, so the data are paged in on demand
+     */
+    void InitBinary(const std::string &filename);
+    /**
+     * @brief sets the number of threads used for counting and parsing
+     *        the lines of a file in Init. By default it is equal to 
+     *        the number of cores
+     */
+    void set_n_threads(int n_threads);
+
+    int n_threads() const;
 
     template<typename Archive>
      void save(Archive &ar, const unsigned int version) const ;
@@ -369,6 +425,9 @@ MultiDataset() {
     bool comma_flag_;
     std::string delimiter_;
     std::string header_;
+    int n_threads_;
+    // the memory mapped binary file the dense containers alias
+    boost::shared_ptr<boost::iostreams::mapped_file> binary_file_;
 
 
 #include "multi_dataset_initializer.h"
@@ -384,6 +443,48 @@ MultiDataset() {
      void AddPoint(std::string &line,
                   std::vector<index_t> &ignored_dense_columns);
      void AddPointFast(std::string &line);
+     void AddPointFast(char *line,
+                  DenseIterators *dense_its,
+                  SparseIterators *sparse_its,
+                  MetaDataIterator *meta_it);
+#include "multi_dataset_parallel_loader.h"
+#include "multi_dataset_binary.h"
+    /**
+     * @brief parses the header and the labels of a text file and determines
+     *        the dimensions and the delimiter. Returns the number of lines
+     *        before the first point
+     */
+    index_t ReadTextLayout(const std::string &filename);
+    /**
+     * @brief allocates num_of_points_ points in every container
+     */
+    void AllocatePoints(const std::string &filename);
+    /**
+     * @brief counts, allocates and parses in parallel the points of 
+     *        a newline aligned text range. Returns true if the range
+     *        was truncated at a blank line
+     */
+    bool LoadTextRange(const char *begin,
+                       const char *end,
+                       bool stop_at_blank,
+                       const std::string &filename);
+    /**
+     * @brief splits the memory mapped data in n_threads_ chunks
+     *        that start and end on line boundaries 
+     */
+    void MakeLoaderChunks(const char *begin, 
+                          const char *end,
+                          std::vector<LoaderChunk> *chunks);
+    /**
+     * @brief counts the points in a chunk. If stop_at_blank is true 
+     *        the chunk is truncated at the first blank line
+     */
+    void CountLoaderChunk(LoaderChunk *chunk, bool stop_at_blank);
+    /**
+     * @brief parses the lines of a chunk directly into the 
+     *        rows starting at chunk->first_point 
+     */
+    void ParseLoaderChunk(LoaderChunk *chunk);
 
 };
 
@@ -0,0 +1,349 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef FL_LITE_FASTLIB_DATA_MULTIDATASET_BINARY_H_
+#define FL_LITE_FASTLIB_DATA_MULTIDATASET_BINARY_H_
+
+/**
+ * @brief Writes a dense block of the binary table format. The Compact 
+ *        storage is already column major so it is written in one go, 
+ *        otherwise we write it point by point
+ */
+struct BinaryDenseWriter {
+  struct CompactWriter {
+    template<typename T, typename Container>
+    static void Write(const Container &cont, std::ostream *out) {
+      out->write(reinterpret_cast<const char*>(cont.ptr()), 
+          sizeof(T)*cont.n_rows()*cont.n_cols());
+    }
+  };
+
+  struct STLWriter {
+    template<typename T, typename Container>
+    static void Write(const Container &cont, std::ostream *out) {
+      typename Container::const_iterator it;
+      for (it = cont.begin(); it != cont.end(); ++it) {
+        out->write(reinterpret_cast<const char*>(it->ptr()), 
+            sizeof(T)*it->size());
+      }
+    }
+  };
+
+  BinaryDenseWriter(DenseBox *box, 
+      std::ostream *out, 
+      BinaryTableFooter *footer) :
+    box_(box), out_(out), footer_(footer) {
+  }
+
+  template<typename T>
+  void operator()(T) {
+    typedef typename boost::mpl::if_<
+      boost::is_same<Storage_t, typename DatasetArgs::Compact>,
+      CompactWriter, STLWriter>::type Writer;
+    footer_->dense_offsets.push_back(AlignBinaryTableStream(*out_));
+    Writer::template Write<T>(DenseBox::template get<T>(*box_), out_);
+  }
+
+  private:
+    DenseBox *box_;
+    std::ostream *out_;
+    BinaryTableFooter *footer_;
+};
+
+/**
+ * @brief Attaches a dense block of a memory mapped binary table. 
+ *        The Compact storage aliases the mapped memory, so nothing
+ *        is read until it is accessed. Otherwise we have to copy the 
+ *        points
+ */
+struct BinaryDenseReader {
+  struct CompactReader {
+    template<typename T, typename Container>
+    static void Read(Container *cont, char *block, 
+        index_t dimension, index_t num_of_points) {
+      cont->Alias(reinterpret_cast<T*>(block), dimension, num_of_points);
+    }
+  };
+
+  struct STLReader {
+    template<typename T, typename Container>
+    static void Read(Container *cont, char *block, 
+        index_t dimension, index_t num_of_points) {
+      try {
+        cont->resize(num_of_points);
+      }
+      catch(const std::bad_alloc &e) {
+        fl::logger->Die()<< "I cannot allocate "
+          << num_of_points << " points for storing the dataset in RAM. "
+          << "It might be that your dataset is too big to fit in RAM or "
+          << "you are using a 32bit platform which limits the process address space "
+          << "to 4GB";
+      }
+      for (index_t i = 0; i < num_of_points; ++i) {
+        (*cont)[i].Init(dimension);
+        memcpy((*cont)[i].ptr(), block + i*dimension*sizeof(T), 
+            dimension*sizeof(T));
+      }
+    }
+  };
+
+  BinaryDenseReader(DenseBox *box, 
+      char *base, 
+      const BinaryTableFooter *footer,
+      index_t *count) :
+    box_(box), base_(base), footer_(footer), count_(count) {
+  }
+
+  template<typename T>
+  void operator()(T) {
+    typedef typename boost::mpl::if_<
+      boost::is_same<Storage_t, typename DatasetArgs::Compact>,
+      CompactReader, STLReader>::type Reader;
+    Reader::template Read<T>(&DenseBox::template get<T>(*box_),
+        base_ + footer_->dense_offsets[*count_],
+        footer_->dense_sizes[*count_],
+        footer_->num_of_points);
+    (*count_)++;
+  }
+
+  private:
+    DenseBox *box_;
+    char *base_;
+    const BinaryTableFooter *footer_;
+    index_t *count_;
+};
+
+/**
+ * @brief Writes a sparse block as CSR, first the row offsets, then 
+ *        the indices and then the values
+ */
+struct BinarySparseWriter {
+  BinarySparseWriter(SparseBox *box, 
+      std::ostream *out, 
+      BinaryTableFooter *footer) :
+    box_(box), out_(out), footer_(footer) {
+  }
+
+  template<typename T>
+  void operator()(T) {
+    Write<T>(SparseBox::template get<T>(*box_));
+  }
+
+  template<typename T, typename Container>
+  void Write(const Container &cont) {
+    typedef typename SparsePoint<T>::Container_t Elements_t;
+    typename Container::const_iterator it;
+    typename Elements_t::const_iterator elem;
+    footer_->sparse_offsets.push_back(AlignBinaryTableStream(*out_));
+    index_t row = 0;
+    out_->write(reinterpret_cast<const char*>(&row), sizeof(index_t));
+    for (it = cont.begin(); it != cont.end(); ++it) {
+      row += it->nnz();
+      out_->write(reinterpret_cast<const char*>(&row), sizeof(index_t));
+    }
+    footer_->sparse_offsets.push_back(AlignBinaryTableStream(*out_));
+    for (it = cont.begin(); it != cont.end(); ++it) {
+      for (elem = it->elem_->begin(); elem != it->elem_->end(); ++elem) {
+        out_->write(reinterpret_cast<const char*>(&elem->first), 
+            sizeof(index_t));
+      }
+    }
+    footer_->sparse_offsets.push_back(AlignBinaryTableStream(*out_));
+    for (it = cont.begin(); it != cont.end(); ++it) {
+      for (elem = it->elem_->begin(); elem != it->elem_->end(); ++elem) {
+        T value = elem->second;
+        out_->write(reinterpret_cast<const char*>(&value), sizeof(T));
+      }
+    }
+  }
+
+  private:
+    SparseBox *box_;
+    std::ostream *out_;
+    BinaryTableFooter *footer_;
+};
+
+/**
+ * @brief Reads a CSR block of a memory mapped binary table
+ */
+struct BinarySparseReader {
+  // compact containers get all the elements in one arena
+  struct CompactAllocator {
+    template<typename Container>
+    static void Allocate(Container *cont, index_t num_of_points, 
+        index_t dimension, index_t nnz) {
+      cont->Init(dimension, num_of_points);
+      cont->ReserveElements(nnz);
+    }
+  };
+
+  struct STLAllocator {
+    template<typename Container>
+    static void Allocate(Container *cont, index_t num_of_points, 
+        index_t dimension, index_t nnz) {
+      cont->resize(num_of_points);
+      typename Container::iterator it;
+      for (it = cont->begin(); it != cont->end(); ++it) {
+        it->Init(dimension);
+      }
+    }
+  };
+
+  BinarySparseReader(SparseBox *box, 
+      const char *base, 
+      const BinaryTableFooter *footer,
+      index_t *count) :
+    box_(box), base_(base), footer_(footer), count_(count) {
+  }
+
+  template<typename T>
+  void operator()(T) {
+    Read<T>(&SparseBox::template get<T>(*box_));
+    (*count_)++;
+  }
+
+  template<typename T, typename Container>
+  void Read(Container *cont) {
+    const index_t num_of_points = footer_->num_of_points;
+    const index_t dimension = footer_->sparse_sizes[*count_];
+    const index_t *rows = reinterpret_cast<const index_t*>(
+        base_ + footer_->sparse_offsets[3*(*count_)]);
+    const index_t *indices = reinterpret_cast<const index_t*>(
+        base_ + footer_->sparse_offsets[3*(*count_)+1]);
+    const T *values = reinterpret_cast<const T*>(
+        base_ + footer_->sparse_offsets[3*(*count_)+2]);
+    try {
+      boost::mpl::if_ <
+        boost::is_same<Storage_t, typename DatasetArgs::Compact>,
+        CompactAllocator, STLAllocator
+      >::type::Allocate(cont, num_of_points, dimension, rows[num_of_points]);
+      for (index_t i = 0; i < num_of_points; ++i) {
+        (*cont)[i].elem_->reserve(rows[i+1]-rows[i]);
+        for (index_t j = rows[i]; j < rows[i+1]; ++j) {
+          (*cont)[i].elem_->push_back(std::make_pair(indices[j], values[j]));
+        }
+      }
+    }
+    catch(const std::bad_alloc &e) {
+      fl::logger->Die()<<"The dataset is probably too big "
+        <<"I cannot allocate memory "
+        << "It might be that your dataset is too big to fit in RAM or "
+        << "you are using a 32bit platform which limits the process address space "
+        << "to 4GB";
+    }
+  }
+
+  private:
+    SparseBox *box_;
+    const char *base_;
+    const BinaryTableFooter *footer_;
+    index_t *count_;
+};
+
+/**
+ * @brief Writes the metadata column by column
+ */
+struct BinaryMetaWriter {
+  BinaryMetaWriter(const MetaDataBox *meta, 
+      std::ostream *out, 
+      BinaryTableFooter *footer) :
+    meta_(meta), out_(out), footer_(footer) {
+  }
+
+  template<typename T>
+  void operator()(T) {
+    static const int ind=T::value;
+    typedef typename boost::mpl::at_c <
+      typename MetaDataType_t::TypeList_t,
+      ind
+    >::type Field_t;
+    footer_->meta_offsets.push_back(AlignBinaryTableStream(*out_));
+    typename MetaDataBox::const_iterator it;
+    for (it = meta_->begin(); it != meta_->end(); ++it) {
+      Field_t value = it->template get<ind>();
+      out_->write(reinterpret_cast<const char*>(&value), sizeof(Field_t));
+    }
+  }
+
+  private:
+    const MetaDataBox *meta_;
+    std::ostream *out_;
+    BinaryTableFooter *footer_;
+};
+
+/**
+ * @brief Reads the metadata column by column
+ */
+struct BinaryMetaReader {
+  BinaryMetaReader(MetaDataBox *meta, 
+      const char *base, 
+      const BinaryTableFooter *footer) :
+    meta_(meta), base_(base), footer_(footer) {
+  }
+
+  template<typename T>
+  void operator()(T) {
+    static const int ind=T::value;
+    typedef typename boost::mpl::at_c <
+      typename MetaDataType_t::TypeList_t,
+      ind
+    >::type Field_t;
+    const char *column = base_ + footer_->meta_offsets[ind];
+    typename MetaDataBox::iterator it;
+    index_t i = 0;
+    for (it = meta_->begin(); it != meta_->end(); ++it, ++i) {
+      memcpy(&(it->template get<ind>()), column + i*sizeof(Field_t), 
+          sizeof(Field_t));
+    }
+  }
+
+  private:
+    MetaDataBox *meta_;
+    const char *base_;
+    const BinaryTableFooter *footer_;
+};
+
+/**
+ * @brief Builds a string with the names of the metadata types,
+ *        so that we can check them when we attach a binary table
+ */
+struct MetaTypeNames {
+  MetaTypeNames(std::string *names) : names_(names) {
+  }
+
+  template<typename T>
+  void operator()(T) {
+    static const int ind=T::value;
+    typedef typename boost::mpl::at_c <
+      typename MetaDataType_t::TypeList_t,
+      ind
+    >::type Field_t;
+    names_->append(Typename<Field_t>::Name()).append(",");
+  }
+
+  private:
+    std::string *names_;
+};
+
+#endif
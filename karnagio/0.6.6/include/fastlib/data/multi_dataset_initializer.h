@@ -76,8 +76,10 @@ struct Initializer {
 
   template<typename T>
   void operator()(T) {
-    typedef typename boost::mpl::if_ < boost::mpl::and_ < boost::is_same<BoxType, DenseBox>,
-    boost::is_same<Storage_t, typename DatasetArgs::Compact> > ,
+    // compact dense points go in a matrix and compact sparse points
+    // in a CompactSparseContainer, both of them are initialized the same way
+    typedef typename boost::mpl::if_ < 
+    boost::is_same<Storage_t, typename DatasetArgs::Compact>,
     FastlibInit, STLInit >::type Init;
     typedef typename
     boost::mpl::if_ < boost::is_same<BoxType, DenseBox>,
@@ -97,6 +99,78 @@ private:
   index_t num_of_points_;
 };
 
+/**
+ * @brief Gives the points [first, first+n_points) of every compact sparse
+ *        container their own arena, so that they can be filled by a 
+ *        different thread. It does nothing for the other containers
+ */
+template<typename BoxType>
+struct SplitSparseArena {
+  struct CompactCase {
+    template<typename Container>
+    static void Split(Container *cont, index_t first, index_t n_points) {
+      cont->SplitArena(first, n_points);
+    }
+  };
+
+  struct STLCase {
+    template<typename Container>
+    static void Split(Container *cont, index_t first, index_t n_points) {
+    }
+  };
+
+  SplitSparseArena(BoxType *box, index_t first, index_t n_points) :
+    box_(box), first_(first), n_points_(n_points) {
+  }
+
+  template<typename T>
+  void operator()(T) {
+    boost::mpl::if_ <
+      boost::is_same<Storage_t, typename DatasetArgs::Compact>,
+      CompactCase, STLCase
+    >::type::Split(&BoxType::template get<T>(*box_), first_, n_points_);
+  }
+
+  private:
+    BoxType *box_;
+    index_t first_;
+    index_t n_points_;
+};
+
+/**
+ * @brief Releases the unused capacity of the arenas of compact sparse 
+ *        containers once they are loaded
+ */
+template<typename BoxType>
+struct ShrinkSparseArenas {
+  struct CompactCase {
+    template<typename Container>
+    static void Shrink(Container *cont) {
+      cont->ShrinkToFit();
+    }
+  };
+
+  struct STLCase {
+    template<typename Container>
+    static void Shrink(Container *cont) {
+    }
+  };
+
+  ShrinkSparseArenas(BoxType *box) : box_(box) {
+  }
+
+  template<typename T>
+  void operator()(T) {
+    boost::mpl::if_ <
+      boost::is_same<Storage_t, typename DatasetArgs::Compact>,
+      CompactCase, STLCase
+    >::type::Shrink(&BoxType::template get<T>(*box_));
+  }
+
+  private:
+    BoxType *box_;
+};
+
 template<typename IteratorsType>
 struct InitBoxPoint {
   InitBoxPoint(IteratorsType *its,
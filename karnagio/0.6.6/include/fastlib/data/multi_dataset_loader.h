@@ -66,8 +66,10 @@ struct DensePointLoaderFast {
   DensePointLoaderFast(DenseIterators *its,
                    const std::string &delimeter,
                    char** tok,
+                   char** save_ptr,
                    index_t *offset) :  
-     its_(its), delimeter_(delimeter), tok_(tok), offset_(offset) {
+     its_(its), delimeter_(delimeter), tok_(tok), save_ptr_(save_ptr), 
+     offset_(offset) {
   }
   ~DensePointLoaderFast() {
   }
@@ -79,7 +81,7 @@ struct DensePointLoaderFast {
       for (index_t i = 0; i < len; i++) {
         T value=static_cast<T>(strtod(*tok_, NULL));
         it->set(i, value);
-        *tok_=strtok(NULL, delimeter_.c_str());
+        *tok_=strtok_r(NULL, delimeter_.c_str(), save_ptr_);
       }
     }
     catch(const boost::bad_lexical_cast &e) {
@@ -96,6 +98,7 @@ private:
   DenseIterators *its_;
   const std::string &delimeter_;
   char** tok_;
+  char** save_ptr_;
   index_t *offset_;
 };
 
@@ -306,8 +309,10 @@ struct SparsePointLoaderFast {
   SparsePointLoaderFast(SparseIterators *its,
                     const std::string &delimeter,
                     char **tok,     
+                    char **save_ptr,
                     index_t *offset) :
-      its_(its), delimeter_(delimeter), tok_(tok), offset_(offset) {
+      its_(its), delimeter_(delimeter), tok_(tok), save_ptr_(save_ptr), 
+      offset_(offset) {
   }
   ~SparsePointLoaderFast() {
   }
@@ -379,7 +384,7 @@ struct SparsePointLoaderFast {
       ContainerNullary1,
       ContainerNullary2
       >::type::set(it, ind, *offset_,  value);
-      *tok_=strtok(NULL, delimeter_.c_str());
+      *tok_=strtok_r(NULL, delimeter_.c_str(), save_ptr_);
     }
 
     boost::mpl::eval_if <
@@ -398,6 +403,7 @@ struct SparsePointLoaderFast {
     SparseIterators *its_;
     const std::string &delimeter_;
     char **tok_;     
+    char **save_ptr_;
     index_t *offset_;
 };
 
@@ -445,11 +451,13 @@ struct MetaLoaderFast  {
   MetaLoaderFast(MetaDataIterator &it,
              const std::string &delimeter,
              const index_t num_of_metadata_to_load,
-             char **tok) : 
+             char **tok,
+             char **save_ptr) : 
     it_(it),
     delimeter_(delimeter),
     largest_meta_(num_of_metadata_to_load),
-    tok_(tok)
+    tok_(tok),
+    save_ptr_(save_ptr)
  {
   }
 
@@ -467,7 +475,7 @@ struct MetaLoaderFast  {
            >::type
          >(strtod(*tok_, NULL));
     }
-    *tok_=strtok(NULL, delimeter_.c_str());
+    *tok_=strtok_r(NULL, delimeter_.c_str(), save_ptr_);
   }
 
   private:
@@ -475,6 +483,7 @@ struct MetaLoaderFast  {
     const std::string &delimeter_;
     const index_t largest_meta_;
     char** tok_;
+    char** save_ptr_;
 };
 
 #endif
@@ -0,0 +1,75 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef FL_LITE_FASTLIB_DATA_MULTIDATASET_PARALLEL_LOADER_H_
+#define FL_LITE_FASTLIB_DATA_MULTIDATASET_PARALLEL_LOADER_H_
+
+/**
+ * @brief A newline aligned slice of a memory mapped file. Every chunk is
+ *        counted and parsed by its own thread. Once the lines of all chunks
+ *        have been counted, first_point holds the row of the dataset where
+ *        the first line of the chunk will be stored
+ */
+struct LoaderChunk {
+  LoaderChunk() : begin(NULL), end(NULL), n_points(0),
+    first_point(0), stopped(false) {
+  }
+  const char *begin;
+  const char *end;
+  index_t n_points;
+  index_t first_point;
+  // dense files and files with meta data end at the first blank line,
+  // if that line is in this chunk we mark it
+  bool stopped;
+  // exceptions thrown in the loading threads are rethrown
+  // from the calling thread
+  boost::exception_ptr error;
+};
+
+/**
+ * @brief Points a set of iterators at the offset-th point of every
+ *        container in the box. Every loading thread gets its own
+ *        set of iterators so that it can fill its rows in place
+ */
+template<typename BoxType, typename IteratorsType>
+struct OffsetIterators {
+  OffsetIterators(BoxType *box,
+                  IteratorsType *its,
+                  index_t offset) :
+    box_(box), its_(its), offset_(offset) {
+  }
+
+  template<typename T>
+  void operator()(T) {
+    IteratorsType::template get<T>(*its_) = BoxType::template get<T>(*box_).begin();
+    IteratorsType::template get<T>(*its_) += offset_;
+  }
+
+  private:
+    BoxType *box_;
+    IteratorsType *its_;
+    index_t offset_;
+};
+
+#endif
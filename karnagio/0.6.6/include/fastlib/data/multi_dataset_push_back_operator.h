@@ -70,6 +70,27 @@ private:
   Point_t *point_;
 };
 
+/**
+ * @brief The following struct removes the last point of every box
+ */
+template<typename BoxType>
+struct PopBackOperator {
+  PopBackOperator(BoxType *box);
+
+  template<typename T>
+  void operator()(T);
+
+  // the dense points of a compact dataset are the columns of a matrix
+  template<typename T>
+  static void PopBack(CompactContainer<T> *matrix);
+
+  template<typename ContainerType>
+  static void PopBack(ContainerType *container);
+
+private:
+  BoxType *box_;
+};
+
 struct SetMetaDataOperator1 {
   struct type {
     template<typename MetaDataBoxType, typename PointType>
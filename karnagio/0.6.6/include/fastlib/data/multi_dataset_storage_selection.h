@@ -27,7 +27,8 @@ POSSIBILITY OF SUCH DAMAGE.
 /**
  * @brief This class chooses the right container for storing points
  *        if we require compact and static storage we use
- *        Matrices,  if we want to append points we use a vector
+ *        Matrices for dense points and CompactSparseContainer 
+ *        for sparse points, if we want to append points we use a vector
  *        that contains points. If we want  to be able to add and delete
  *        we use a list of points
  */
@@ -51,14 +52,14 @@ class DenseStorageSelection : public
 template<typename T>
 class SparseStorageSelection : public
       boost::mpl::if_ < boost::is_same < Storage_t,
-      typename DatasetArgs::Compact > , ExtendableContainer<T>,
+      typename DatasetArgs::Compact > , CompactSparseContainer<T>,
       typename boost::mpl::if_ < boost::is_same < Storage_t,
       typename DatasetArgs::Extendable > , ExtendableContainer<T>,
       typename boost::mpl::if_ < boost::is_same<Storage_t, DatasetArgs::Deletable>,
       DeletableContainer<T>, boost::mpl::void_ >::type >::type >::type::type {
   public:
     typedef typename boost::mpl::if_ < boost::is_same < Storage_t,
-    typename DatasetArgs::Compact > , ExtendableContainer<T>,
+    typename DatasetArgs::Compact > , CompactSparseContainer<T>,
     typename boost::mpl::if_ < boost::is_same < Storage_t,
     typename DatasetArgs::Extendable > , ExtendableContainer<T>,
     typename boost::mpl::if_ < boost::is_same<Storage_t, DatasetArgs::Deletable>,
@@ -30,6 +30,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <vector>
 #include "monolithic_point.h"
 #include "mixed_point.h"
+#include "sparse_row.h"
 #include "boost/mpl/if.hpp"
 #include "boost/mpl/vector.hpp"
 #include "boost/type_traits.hpp"
@@ -51,7 +52,8 @@ class SparsePoint {
     typedef boost::mpl::vector1<CalcPrecisionType> SparseMemberTypes_t;
     template<typename T> friend  class MultiDataset;
     typedef CalcPrecisionType CalcPrecision_t;
-    typedef std::vector<std::pair<index_t, CalcPrecision_t> > Container_t;
+    //typedef std::vector<std::pair<index_t, CalcPrecision_t> > Container_t;
+    typedef SparseRow<std::pair<index_t, CalcPrecision_t> > Container_t;
     //typedef std::map<index_t, CalcPrecision_t> Container_t;
     typedef typename Container_t::iterator Iterator;
     class iterator : public Iterator {
@@ -74,12 +76,13 @@ class SparsePoint {
         }
 
         bool operator==(const iterator &other) const {
-          return Iterator::operator==(static_cast<Iterator>(other));
+          return static_cast<const Iterator&>(*this)==
+            static_cast<const Iterator&>(other);
         }
 
         bool operator==(const Iterator &other) const {
           // return Iterator::operator==(other);
-          return static_cast<Iterator>(*this)==other;
+          return static_cast<const Iterator&>(*this)==other;
         }
 
         bool operator!=(const iterator &other) const {
@@ -89,7 +92,7 @@ class SparsePoint {
         }
 
         bool operator!=(const Iterator &other) const {
-          return static_cast<Iterator>(*this)!=(other);
+          return static_cast<const Iterator&>(*this)!=(other);
         }
 
         CalcPrecision_t &operator*()  {
@@ -131,12 +134,13 @@ class SparsePoint {
       }    
     };
 
-    SparsePoint(const SparsePoint &other) {
+    SparsePoint(const SparsePoint &other) : elem_(NULL),
+        should_free_(false) {
       size_ = other.size_ ;
-      should_free_ = other.should_free_;
       if (other.elem_ != NULL) {
         try {
           elem_ = new Container_t();
+          should_free_ = true;
         }
         catch(const std::bad_alloc &e) {
           fl::logger->Die() << "There was a problem allocating memory. "
@@ -490,7 +494,7 @@ class SparsePoint {
     }
 
     void SwapValues(SparsePoint *other) {
-      std::swap(*elem_, *(other->elem_));
+      elem_->swap(*(other->elem_));
       std::swap(size_, other->size_);
     }
     void Alias(const SparsePoint &other) {
@@ -498,6 +502,18 @@ class SparsePoint {
       elem_  = other.elem_;
       size_ = other.size_;
     }
+    /**
+     * @brief The point uses elem as its container, this is how the
+     *        points of compact sparse tables view their rows
+     */
+    void Alias(Container_t *elem, index_t size) {
+      if (should_free_ == true) {
+        delete elem_;
+      }
+      should_free_ = false;
+      elem_ = elem;
+      size_ = size;
+    }
     const index_t size() const {
       return size_;
     }
@@ -530,27 +546,37 @@ class SparsePoint {
     template<typename Archive>
     void save(Archive &ar,
               const unsigned int file_version) const {
-      ar << boost::serialization::make_nvp("elem_", *elem_);
+      // archived as a std::vector so that the format does not depend
+      // on where the elements are stored
+      std::vector<std::pair<index_t, CalcPrecision_t> > values(
+          elem_->begin(), elem_->end());
+      ar << boost::serialization::make_nvp("elem_", values);
       ar << boost::serialization::make_nvp("size_", size_);
     }
 
     template<typename Archive>
     void load(Archive &ar,
               const unsigned int file_version) {
-      delete elem_;
-      try {
-        elem_ = new Container_t();
-      }
-      catch(const std::bad_alloc &e) {
-          fl::logger->Die() << "There was a problem allocating memory. "
-            << "Either your dataset doesn't fit in the RAM, or"
-            << "you are using a 32bit platform that limits the process "
-            << "address space to 4GB";
+      // an aliased point loads in place
+      if (should_free_ == true || elem_ == NULL) {
+        if (should_free_ == true) {
+          delete elem_;
+        }
+        try {
+          elem_ = new Container_t();
+        }
+        catch(const std::bad_alloc &e) {
+            fl::logger->Die() << "There was a problem allocating memory. "
+              << "Either your dataset doesn't fit in the RAM, or"
+              << "you are using a 32bit platform that limits the process "
+              << "address space to 4GB";
+        }
+        should_free_=true;
       }
-
-      ar >> boost::serialization::make_nvp("elem_", *elem_);
+      std::vector<std::pair<index_t, CalcPrecision_t> > values;
+      ar >> boost::serialization::make_nvp("elem_", values);
+      elem_->assign(values.begin(), values.end());
       ar >> boost::serialization::make_nvp("size_", size_);
-      should_free_=true;
     }
 
     BOOST_SERIALIZATION_SPLIT_MEMBER()
@@ -717,11 +743,11 @@ class SparsePoint {
   };
 
   struct InsertElement2 {
-    static void Set(std::vector<std::pair<index_t, CalcPrecision_t> > *p,
+    static void Set(Container_t *p,
         index_t ind, CalcPrecision_t val) {
       p->push_back(std::make_pair(ind, val));
     }
-    static void Set(std::vector<std::pair<index_t, CalcPrecision_t> > *p,
+    static void Set(Container_t *p,
         const std::pair<index_t, CalcPrecision_t> &val) {
       p->push_back(val);
     }
@@ -0,0 +1,270 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef FL_LITE_FASTLIB_DATA_SPARSE_ROW_H_
+#define FL_LITE_FASTLIB_DATA_SPARSE_ROW_H_
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include "boost/iterator/iterator_adaptor.hpp"
+#include "boost/type_traits/is_convertible.hpp"
+#include "boost/utility/enable_if.hpp"
+
+namespace fl {
+namespace data {
+/**
+ * @brief Random access iterator over the elements of a SparseRow
+ */
+template<typename ValueType>
+class SparseRowIterator : public boost::iterator_adaptor <
+      SparseRowIterator<ValueType>, ValueType* > {
+  public:
+    SparseRowIterator() : SparseRowIterator::iterator_adaptor_(NULL) {
+    }
+
+    explicit SparseRowIterator(ValueType *p) :
+      SparseRowIterator::iterator_adaptor_(p) {
+    }
+
+    template<typename OtherValueType>
+    SparseRowIterator(const SparseRowIterator<OtherValueType> &other,
+        typename boost::enable_if <
+          boost::is_convertible<OtherValueType*, ValueType*>
+        >::type* = 0) :
+      SparseRowIterator::iterator_adaptor_(other.base()) {
+    }
+};
+
+/**
+ * @brief The container of the nonzero elements of a SparsePoint. It behaves
+ *        like the std::vector it replaces, but it can also live as a 
+ *        slice [offset, offset+size) of an arena, a vector shared by many
+ *        rows. The sparse points of a compact table keep their elements 
+ *        in a few arenas, so loading them does not need one heap allocation 
+ *        per point. An empty row always moves to the end of its arena,
+ *        and a row at the end of its arena grows in place. If a row that
+ *        is not at the end of its arena has to grow, its elements are copied
+ *        in its own vector and the row detaches from the arena.
+ */
+template<typename ValueType>
+class SparseRow {
+  public:
+    typedef ValueType value_type;
+    typedef ValueType& reference;
+    typedef const ValueType& const_reference;
+    typedef ValueType* pointer;
+    typedef const ValueType* const_pointer;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef SparseRowIterator<ValueType> iterator;
+    typedef SparseRowIterator<const ValueType> const_iterator;
+    typedef std::vector<ValueType> Arena_t;
+
+    SparseRow() : arena_(NULL), offset_(0), count_(0) {
+    }
+
+    SparseRow(const SparseRow &other) : 
+      owned_(other.begin(), other.end()), 
+      arena_(NULL), offset_(0), count_(0) {
+    }
+
+    SparseRow &operator=(const SparseRow &other) {
+      if (this != &other) {
+        if (arena_ != NULL && arena_ == other.arena_) {
+          // appending to the arena might move the elements of the other row
+          std::vector<ValueType> values(other.begin(), other.end());
+          assign(values.begin(), values.end());
+        } else {
+          assign(other.begin(), other.end());
+        }
+      }
+      return *this;
+    }
+
+    /**
+     * @brief The row drops its elements and from now on it stores
+     *        them at the end of the arena
+     */
+    void Attach(Arena_t *arena) {
+      std::vector<ValueType>().swap(owned_);
+      arena_ = arena;
+      offset_ = arena->size();
+      count_ = 0;
+    }
+
+    /**
+     * @brief Copies the elements in the row's own vector, the slice 
+     *        in the arena is not reclaimed
+     */
+    void Detach() {
+      if (arena_ != NULL) {
+        owned_.assign(begin(), end());
+        arena_ = NULL;
+        offset_ = 0;
+        count_ = 0;
+      }
+    }
+
+    bool is_attached() const {
+      return arena_ != NULL;
+    }
+
+    iterator begin() {
+      return iterator(data());
+    }
+
+    const_iterator begin() const {
+      return const_iterator(data());
+    }
+
+    iterator end() {
+      return iterator(data() + size());
+    }
+
+    const_iterator end() const {
+      return const_iterator(data() + size());
+    }
+
+    size_type size() const {
+      return arena_ == NULL ? owned_.size() : count_;
+    }
+
+    bool empty() const {
+      return size() == 0;
+    }
+
+    reference operator[](size_type i) {
+      return data()[i];
+    }
+
+    const_reference operator[](size_type i) const {
+      return data()[i];
+    }
+
+    reference back() {
+      return data()[size()-1];
+    }
+
+    const_reference back() const {
+      return data()[size()-1];
+    }
+
+    void push_back(const ValueType &value) {
+      if (arena_ != NULL) {
+        if (count_ == 0) {
+          offset_ = arena_->size();
+        }
+        if (offset_ + count_ == arena_->size()) {
+          arena_->push_back(value);
+          ++count_;
+          return;
+        }
+        Detach();
+      }
+      owned_.push_back(value);
+    }
+
+    template<typename IteratorType>
+    void assign(IteratorType first, IteratorType last) {
+      clear();
+      for (; first != last; ++first) {
+        push_back(*first);
+      }
+    }
+
+    void clear() {
+      if (arena_ != NULL) {
+        if (offset_ + count_ == arena_->size()) {
+          arena_->resize(offset_);
+        }
+        count_ = 0;
+      } else {
+        owned_.clear();
+      }
+    }
+
+    void reserve(size_type n) {
+      if (arena_ == NULL) {
+        owned_.reserve(n);
+      }
+    }
+
+    void resize(size_type n) {
+      Detach();
+      owned_.resize(n);
+    }
+
+    iterator insert(iterator position, const ValueType &value) {
+      const difference_type i = position - begin();
+      Detach();
+      owned_.insert(owned_.begin() + i, value);
+      return begin() + i;
+    }
+
+    iterator erase(iterator position) {
+      const difference_type i = position - begin();
+      Detach();
+      owned_.erase(owned_.begin() + i);
+      return begin() + i;
+    }
+
+    iterator erase(iterator first, iterator last) {
+      const difference_type i = first - begin();
+      const difference_type j = last - begin();
+      Detach();
+      owned_.erase(owned_.begin() + i, owned_.begin() + j);
+      return begin() + i;
+    }
+
+    void swap(SparseRow &other) {
+      owned_.swap(other.owned_);
+      std::swap(arena_, other.arena_);
+      std::swap(offset_, other.offset_);
+      std::swap(count_, other.count_);
+    }
+
+  private:
+    ValueType *data() {
+      if (arena_ == NULL) {
+        return owned_.empty() ? NULL : &owned_[0];
+      }
+      return count_ == 0 ? NULL : &(*arena_)[0] + offset_;
+    }
+
+    const ValueType *data() const {
+      if (arena_ == NULL) {
+        return owned_.empty() ? NULL : &owned_[0];
+      }
+      return count_ == 0 ? NULL : &(*arena_)[0] + offset_;
+    }
+
+    std::vector<ValueType> owned_;
+    Arena_t *arena_;
+    size_type offset_;
+    size_type count_;
+};
+
+}}  // namespaces
+
+#endif
@@ -36,6 +36,10 @@ POSSIBILITY OF SUCH DAMAGE
 #include "linear_algebra_aux.h"
 #include "boost/scoped_array.hpp"
 #include "fastlib/traits/fl_traits.h"
+#include "fastlib/dense/simd_kernels.h"
+#include "boost/mpl/bool.hpp"
+#include "boost/type_traits/is_base_of.hpp"
+#include "boost/type_traits/is_same.hpp"
 
 namespace fl {
 namespace  dense {
@@ -2494,6 +2498,9 @@ class ops {
      * @param length the length of the vectors
      * @param va first vector
      * @param vb second vector
+     *
+     * When both vectors are dense float or double vectors of the result's
+     * precision, L1 and L2 use the kernels of fastlib/dense/simd_kernels.h
      */
     template<int t_pow>
     class RawLMetric {
@@ -2502,6 +2509,52 @@ class ops {
         typename CalcPrecisionType >
         RawLMetric(const PointType1 &va, const PointType2 &vb,
                    CalcPrecisionType *result) {
+          Compute_(va, vb, result, boost::mpl::bool_ <
+                   (t_pow == 1 || t_pow == 2) &&
+                   IsSimdVector_<PointType1, CalcPrecisionType>::value &&
+                   IsSimdVector_<PointType2, CalcPrecisionType>::value > ());
+        }
+
+        template < typename PointType1, typename PointType2,
+        typename PointType3, typename CalcPrecisionType >
+        RawLMetric(const PointType3 &w,
+                   const PointType1 &va, const PointType2 &vb,
+                   CalcPrecisionType *result) {
+          Compute_(w, va, vb, result, boost::mpl::bool_ < t_pow == 2 &&
+                   IsSimdVector_<PointType1, CalcPrecisionType>::value &&
+                   IsSimdVector_<PointType2, CalcPrecisionType>::value &&
+                   IsSimdVector_<PointType3, CalcPrecisionType>::value > ());
+        }
+
+      private:
+        template<typename PointType, typename CalcPrecisionType>
+        struct IsSimdVector_ {
+          static const bool value =
+            (boost::is_same<CalcPrecisionType, double>::value ||
+             boost::is_same<CalcPrecisionType, float>::value) &&
+            boost::is_base_of<Matrix<CalcPrecisionType, true>,
+                              PointType>::value;
+        };
+
+        template < typename PointType1, typename PointType2,
+        typename CalcPrecisionType >
+        static void Compute_(const PointType1 &va, const PointType2 &vb,
+                             CalcPrecisionType *result, boost::mpl::true_) {
+          DEBUG_ASSERT(va.size() == vb.size());
+          if (t_pow == 1) {
+            *result = fl::dense::simd::DistanceL1(va.size(), va.ptr(),
+                                                  vb.ptr());
+          }
+          else {
+            *result = fl::dense::simd::DistanceSq(va.size(), va.ptr(),
+                                                  vb.ptr());
+          }
+        }
+
+        template < typename PointType1, typename PointType2,
+        typename CalcPrecisionType >
+        static void Compute_(const PointType1 &va, const PointType2 &vb,
+                             CalcPrecisionType *result, boost::mpl::false_) {
           DEBUG_ASSERT(va.size() == vb.size());
           size_t length = va.size();
           typedef CalcPrecisionType CalcPrecision_t;
@@ -2517,9 +2570,20 @@ class ops {
 
         template < typename PointType1, typename PointType2,
         typename PointType3, typename CalcPrecisionType >
-        RawLMetric(const PointType3 &w,
-                   const PointType1 &va, const PointType2 &vb,
-                   CalcPrecisionType *result) {
+        static void Compute_(const PointType3 &w,
+                             const PointType1 &va, const PointType2 &vb,
+                             CalcPrecisionType *result, boost::mpl::true_) {
+          DEBUG_ASSERT(va.size() == vb.size());
+          DEBUG_ASSERT(w.size() == va.size());
+          *result = fl::dense::simd::WeightedDistanceSq(va.size(), w.ptr(),
+                    va.ptr(), vb.ptr());
+        }
+
+        template < typename PointType1, typename PointType2,
+        typename PointType3, typename CalcPrecisionType >
+        static void Compute_(const PointType3 &w,
+                             const PointType1 &va, const PointType2 &vb,
+                             CalcPrecisionType *result, boost::mpl::false_) {
           DEBUG_ASSERT(va.size() == vb.size());
           DEBUG_ASSERT(w.size() == va.size());
           size_t length = va.size();
@@ -0,0 +1,95 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+/**
+ * @file simd_kernels.h
+ *
+ * @brief Vectorized kernels for dense arrays of floats and doubles.
+ *  The instruction set (AVX-512, AVX2, SSE2 or plain C++) is picked at
+ *  runtime from what the cpu supports. All of them accumulate the sum
+ *  in the same lanes and reduce the lanes in the same order, without
+ *  fused multiply-adds, so the results are exactly the same on every
+ *  cpu.
+ */
+#ifndef FL_LITE_FASTLIB_DENSE_SIMD_KERNELS_H_
+#define FL_LITE_FASTLIB_DENSE_SIMD_KERNELS_H_
+#include <string>
+#include "fastlib/base/base.h"
+
+namespace fl {
+namespace dense {
+namespace simd {
+
+/**
+ * @brief the number of reference points DistanceSqBlock is usually
+ *        called with, the base cases gather that many points at a time
+ */
+const index_t kBlockSize = 16;
+
+/** @brief returns \f$\sum_i (x_i-y_i)^2\f$ */
+double DistanceSq(index_t length, const double *x, const double *y);
+float DistanceSq(index_t length, const float *x, const float *y);
+
+/** @brief returns \f$\sum_i |x_i-y_i|\f$ */
+double DistanceL1(index_t length, const double *x, const double *y);
+float DistanceL1(index_t length, const float *x, const float *y);
+
+/** @brief returns \f$\sum_i w_i (x_i-y_i)^2\f$ */
+double WeightedDistanceSq(index_t length, const double *w,
+                          const double *x, const double *y);
+float WeightedDistanceSq(index_t length, const float *w,
+                         const float *x, const float *y);
+
+/** @brief returns \f$\sum_i x_i y_i\f$ */
+double Dot(index_t length, const double *x, const double *y);
+float Dot(index_t length, const float *x, const float *y);
+
+/**
+ * @brief computes DistanceSq(length, query, references[i]) for
+ *        i=0...count-1. The query is loaded once for several references,
+ *        every distance is exactly the one DistanceSq returns
+ */
+void DistanceSqBlock(index_t length, const double *query,
+                     const double *const *references, index_t count,
+                     double *distances);
+void DistanceSqBlock(index_t length, const float *query,
+                     const float *const *references, index_t count,
+                     float *distances);
+
+/**
+ * @brief returns the instruction set the kernels use, one of
+ *        avx512, avx2, sse2, scalar
+ */
+std::string instruction_set();
+
+/**
+ * @brief forces the kernels to an instruction set, mostly for testing
+ *        and benchmarking. Returns false and leaves the kernels 
+ *        unchanged if the cpu does not support it
+ */
+bool set_instruction_set(const std::string &name);
+
+}}} // namespaces
+
+#endif
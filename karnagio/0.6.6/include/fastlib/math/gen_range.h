@@ -67,6 +67,10 @@ class GenRange {
     /** Initializes to specified values. */
     GenRange(T lo_in, T hi_in)
         : lo(lo_in), hi(hi_in) {}
+    /** Initializes from a range of another precision. */
+    template<typename OtherT>
+    GenRange(const GenRange<OtherT> &other)
+        : lo(other.lo), hi(other.hi) {}
     template<typename Archive>
     void serialize(Archive &ar, const unsigned int version) {
       ar & boost::serialization::make_nvp("lo", lo);
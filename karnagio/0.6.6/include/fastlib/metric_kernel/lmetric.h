@@ -25,11 +25,21 @@ POSSIBILITY OF SUCH DAMAGE.
 #ifndef FL_LITE_INCLUDE_FASTLIB_METRIC_KERNEL_METRIC_H_
 #define FL_LITE_INCLUDE_FASTLIB_METRIC_KERNEL_METRIC_H_
 
+#include <algorithm>
 #include "fastlib/math/fl_math.h"
 #include "fastlib/dense/matrix.h"
 #include "fastlib/la/linear_algebra.h"
+#include "fastlib/dense/simd_kernels.h"
+#include "boost/mpl/or.hpp"
+#include "boost/type_traits/is_same.hpp"
+#include "boost/utility/enable_if.hpp"
 
 namespace fl {
+namespace data {
+template<typename CalcPrecisionType>
+class MonolithicPoint;
+}
+
 namespace math {
 /**
    * An L_p metric for vector spaces.
@@ -97,6 +107,83 @@ class LMetric<2> {
 
     }
 };
+
+/**
+ * @brief Computes the distances of a point to a block of points,
+ *        distances[i]=metric.DistanceSq(query, references[i]).
+ *        Base cases should call it instead of looping over the
+ *        references, so that the metrics and points that have
+ *        a vectorized kernel can use it
+ */
+template < typename MetricType, typename PointType1, typename PointType2,
+typename CalcPrecisionType >
+inline void DistanceSqBlock(const MetricType &metric,
+                            const PointType1 &query,
+                            const PointType2 *references,
+                            index_t count,
+                            CalcPrecisionType *distances) {
+  for (index_t i = 0; i < count; ++i) {
+    distances[i] = metric.DistanceSq(query, references[i]);
+  }
+}
+
+/**
+ * @brief Same as above with the arguments of DistanceSq in the opposite
+ *        order, distances[i]=metric.DistanceSq(references[i], query),
+ *        for the metrics that are not symmetric
+ */
+template < typename MetricType, typename PointType1, typename PointType2,
+typename CalcPrecisionType >
+inline void DistanceSqBlock(const MetricType &metric,
+                            const PointType2 *references,
+                            index_t count,
+                            const PointType1 &query,
+                            CalcPrecisionType *distances) {
+  for (index_t i = 0; i < count; ++i) {
+    distances[i] = metric.DistanceSq(references[i], query);
+  }
+}
+
+/**
+ * @brief The euclidean distance of dense points, it gives exactly the
+ *        same distances as LMetric<2>::DistanceSq
+ */
+template<typename PrecisionType>
+inline typename boost::enable_if < boost::mpl::or_ <
+boost::is_same<PrecisionType, double>,
+      boost::is_same<PrecisionType, float> > >::type
+DistanceSqBlock(const LMetric<2> &metric,
+                const fl::data::MonolithicPoint<PrecisionType> &query,
+                const fl::data::MonolithicPoint<PrecisionType> *references,
+                index_t count,
+                PrecisionType *distances) {
+  const PrecisionType *pointers[fl::dense::simd::kBlockSize];
+  for (index_t i = 0; i < count; i += fl::dense::simd::kBlockSize) {
+    index_t block = std::min(count - i, fl::dense::simd::kBlockSize);
+    for (index_t j = 0; j < block; ++j) {
+      DEBUG_ASSERT(references[i + j].size() == query.size());
+      pointers[j] = references[i + j].ptr();
+    }
+    fl::dense::simd::DistanceSqBlock(query.size(), query.ptr(), pointers,
+                                     block, distances + i);
+  }
+}
+
+/**
+ * @brief The euclidean distance is symmetric and (x-y)^2 is exactly
+ *        (y-x)^2, so the order does not matter
+ */
+template<typename PrecisionType>
+inline typename boost::enable_if < boost::mpl::or_ <
+boost::is_same<PrecisionType, double>,
+      boost::is_same<PrecisionType, float> > >::type
+DistanceSqBlock(const LMetric<2> &metric,
+                const fl::data::MonolithicPoint<PrecisionType> *references,
+                index_t count,
+                const fl::data::MonolithicPoint<PrecisionType> &query,
+                PrecisionType *distances) {
+  DistanceSqBlock(metric, query, references, count, distances);
+}
 }
 }
 
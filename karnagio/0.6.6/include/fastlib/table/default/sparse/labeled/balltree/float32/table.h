@@ -46,7 +46,7 @@ struct TableMap {
       boost::mpl::vector3<signed char, double, int>
       >::Generated MetaDataType;
       typedef double CalcPrecision;
-      typedef fl::data::DatasetArgs::Extendable StorageType;
+      typedef fl::data::DatasetArgs::Compact StorageType;
     };
     typedef fl::data::MultiDataset<DatasetArgs> DatasetType;
     typedef boost::mpl::bool_<true> SortPoints;
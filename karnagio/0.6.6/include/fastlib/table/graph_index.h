@@ -0,0 +1,229 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef FL_LITE_FASTLIB_TABLE_GRAPH_INDEX_H_
+#define FL_LITE_FASTLIB_TABLE_GRAPH_INDEX_H_
+
+#include <string>
+#include <vector>
+#include <utility>
+#include "fastlib/base/base.h"
+#include "boost/utility.hpp"
+#include "boost/thread/mutex.hpp"
+
+namespace fl {
+namespace table {
+/**
+ * @brief A navigable small world graph on the points of a table,
+ *        built as a hierarchy of proximity graphs (HNSW). Every point
+ *        is linked to its max_degree approximate neighbors on the levels
+ *        it belongs to, the upper levels hold exponentially fewer points.
+ *        A query walks greedily from the top level down and then does a
+ *        best first search of search_breadth candidates on the bottom one.
+ *        Unlike the trees it does not need a bounding geometry, so it
+ *        works with any metric and does not degrade in high dimensions.
+ *        It refers to the points with the ids of Table::get(), so it does
+ *        not mutate the table and it works whether the table is indexed
+ *        with a tree or not. Points are inserted in it from many threads
+ *        and new points can be added to a graph that is already built
+ */
+class GraphIndex : boost::noncopyable {
+  public:
+    /**
+     * @brief The arguments of building the graph, they play the same role
+     *        with Table::IndexArgs:
+     *        metric: the metric that the graph is built with, the searches
+     *                must use the same one
+     *        max_degree: the maximum number of links of a point on the upper
+     *                    levels, on the bottom level it is twice as much
+     *        ef_construction: the search breadth when the neighbors of a new
+     *                         point are searched, bigger is slower but gives
+     *                         a better graph
+     *        n_threads: the number of threads that insert points concurrently
+     *        seed: the levels of the points are a hash of the seed and the
+     *              point id, so that the graph does not depend on the order
+     *              the points are inserted
+     */
+    template<typename MetricType>
+    struct IndexArgs {
+      public:
+        IndexArgs() : max_degree(16), ef_construction(100), n_threads(1),
+            seed(0) {
+        }
+        typedef MetricType MetricType_t;
+        MetricType metric;
+        index_t max_degree;
+        index_t ef_construction;
+        int n_threads;
+        uint64 seed;
+    };
+
+    /**
+     * @brief Scratch memory of a search. A search allocates it when it is
+     *        not given one, threads that run many searches should keep
+     *        their own
+     */
+    class SearchSpace {
+      public:
+        SearchSpace() : tag_(0) {
+        }
+        friend class GraphIndex;
+      private:
+        void Reset(index_t n_entries);
+        bool Visit(index_t id);
+        std::vector<uint32> visited_;
+        uint32 tag_;
+    };
+
+    typedef std::pair<double, index_t> Neighbor_t;
+
+    GraphIndex();
+
+    /**
+     * @brief Builds the graph from scratch on all the points of the table
+     */
+    template<typename TableType, typename IndexArgsType>
+    void IndexData(const TableType &table, const IndexArgsType &args);
+
+    /**
+     * @brief Inserts in the graph the points of the table that it does not
+     *        have yet, the ones with ids from n_entries() up to
+     *        table.n_entries(). The table must have been appended to
+     *        after the graph was built
+     */
+    template<typename TableType, typename IndexArgsType>
+    void Insert(const TableType &table, const IndexArgsType &args);
+
+    /**
+     * @brief Finds the approximate k nearest neighbors of the query. The
+     *        neighbors are returned as (squared distance, point id) sorted
+     *        in increasing distance. search_breadth is the number of
+     *        candidates kept in the search, when it is less than k, k is
+     *        used. Bigger breadth gives better recall at a higher cost
+     */
+    template<typename TableType, typename MetricType, typename PointType>
+    void Search(const TableType &table,
+                const MetricType &metric,
+                const PointType &query,
+                index_t k,
+                index_t search_breadth,
+                std::vector<Neighbor_t> *neighbors,
+                SearchSpace *space = NULL) const;
+
+    /**
+     * @brief Stores the graph in a file next to the table it is built on
+     */
+    void Save(const std::string &file) const;
+    /**
+     * @brief Loads a graph that was stored with Save()
+     */
+    void Load(const std::string &file);
+
+    bool is_indexed() const;
+    index_t n_entries() const;
+    index_t max_degree() const;
+    int max_level() const;
+    const std::string &metric_type_id() const;
+    /**
+     * @brief The number of links of a point on a level, it is meant
+     *        for statistics and tests
+     */
+    index_t num_of_links(index_t point, int level) const;
+
+  private:
+    enum {kNumOfLocks = 1024};
+    index_t max_degree_;
+    std::string metric_type_id_;
+    uint64 seed_;
+    // the top level that every point belongs to
+    std::vector<int> levels_;
+    // links_[point][level] holds the neighbors of the point on that level
+    std::vector<std::vector<std::vector<index_t> > > links_;
+    index_t entry_point_;
+    int max_level_;
+    // links are locked in stripes so that threads inserting different
+    // points rarely wait for each other
+    mutable boost::mutex link_locks_[kNumOfLocks];
+    mutable boost::mutex entry_lock_;
+
+    int RandomLevel_(index_t point) const;
+
+    index_t MaxLinks_(int level) const;
+
+    void GetLinks_(index_t point, int level,
+                   std::vector<index_t> *links) const;
+
+    template<typename TableType, typename MetricType>
+    static void InsertRange_(GraphIndex *graph,
+                             const TableType *table,
+                             const MetricType *metric,
+                             index_t ef_construction,
+                             index_t *next_point,
+                             index_t end,
+                             boost::mutex *next_point_lock);
+
+    template<typename TableType, typename MetricType>
+    void InsertPoint_(const TableType &table,
+                      const MetricType &metric,
+                      index_t point,
+                      index_t ef_construction,
+                      SearchSpace *space);
+
+    template<typename TableType, typename MetricType, typename PointType>
+    index_t GreedySearch_(const TableType &table,
+                          const MetricType &metric,
+                          const PointType &query,
+                          index_t entry,
+                          int top_level,
+                          int bottom_level) const;
+
+    template<typename TableType, typename MetricType, typename PointType>
+    void SearchLevel_(const TableType &table,
+                      const MetricType &metric,
+                      const PointType &query,
+                      const std::vector<index_t> &entries,
+                      index_t search_breadth,
+                      int level,
+                      SearchSpace *space,
+                      std::vector<Neighbor_t> *result) const;
+
+    template<typename TableType, typename MetricType>
+    void SelectNeighbors_(const TableType &table,
+                          const MetricType &metric,
+                          const std::vector<Neighbor_t> &candidates,
+                          index_t max_links,
+                          std::vector<index_t> *selected) const;
+
+    template<typename TableType, typename MetricType>
+    void Link_(const TableType &table,
+               const MetricType &metric,
+               index_t point,
+               index_t neighbor,
+               int level);
+};
+
+}}
+
+#endif
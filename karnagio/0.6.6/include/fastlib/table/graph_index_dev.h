@@ -0,0 +1,378 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef FL_LITE_FASTLIB_TABLE_GRAPH_INDEX_DEV_H_
+#define FL_LITE_FASTLIB_TABLE_GRAPH_INDEX_DEV_H_
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <typeinfo>
+#include "fastlib/table/graph_index.h"
+#include "fastlib/base/logger.h"
+#include "boost/bind.hpp"
+#include "boost/thread/thread.hpp"
+
+namespace fl {
+namespace table {
+
+inline void GraphIndex::SearchSpace::Reset(index_t n_entries) {
+  if (static_cast<index_t>(visited_.size()) < n_entries) {
+    visited_.resize(n_entries, 0);
+  }
+  ++tag_;
+  // the tags wrapped around, the old marks must go
+  if (tag_ == 0) {
+    std::fill(visited_.begin(), visited_.end(), 0);
+    tag_ = 1;
+  }
+}
+
+inline bool GraphIndex::SearchSpace::Visit(index_t id) {
+  if (visited_[id] == tag_) {
+    return false;
+  }
+  visited_[id] = tag_;
+  return true;
+}
+
+inline void GraphIndex::GetLinks_(index_t point, int level,
+                                  std::vector<index_t> *links) const {
+  boost::mutex::scoped_lock lock(link_locks_[point % kNumOfLocks]);
+  *links = links_[point][level];
+}
+
+template<typename TableType, typename IndexArgsType>
+void GraphIndex::IndexData(const TableType &table,
+                           const IndexArgsType &args) {
+  if (table.n_entries() <= 0) {
+    fl::logger->Die() << "You are trying to build a graph on a table that is empty";
+  }
+  if (args.max_degree < 2) {
+    fl::logger->Die() << "The graph needs max_degree of at least 2";
+  }
+  levels_.clear();
+  links_.clear();
+  entry_point_ = -1;
+  max_level_ = -1;
+  max_degree_ = args.max_degree;
+  seed_ = args.seed;
+  metric_type_id_ = typeid(args.metric).name();
+  Insert(table, args);
+}
+
+template<typename TableType, typename IndexArgsType>
+void GraphIndex::Insert(const TableType &table, const IndexArgsType &args) {
+  if (metric_type_id_ != typeid(args.metric).name()) {
+    fl::logger->Die() << "The graph was built with a different metric ("
+      << metric_type_id_ << ") than " << typeid(args.metric).name();
+  }
+  index_t begin = n_entries();
+  index_t end = table.n_entries();
+  if (end < begin) {
+    fl::logger->Die() << "The graph has " << begin << " points, but the table "
+      << "has only " << end;
+  }
+  if (begin == end) {
+    return;
+  }
+  // the new points get all their levels before any thread starts, so
+  // that the links never move while they are searched
+  levels_.resize(end);
+  links_.resize(end);
+  for (index_t i = begin; i < end; ++i) {
+    levels_[i] = RandomLevel_(i);
+    links_[i].resize(levels_[i] + 1);
+  }
+  index_t ef_construction = std::max(args.ef_construction, max_degree_);
+  index_t next_point = begin;
+  boost::mutex next_point_lock;
+  // the first point has nothing to link to, it becomes the entry point
+  // before the others are inserted concurrently
+  if (entry_point_ < 0) {
+    entry_point_ = next_point;
+    max_level_ = levels_[next_point];
+    ++next_point;
+  }
+  boost::thread_group threads;
+  for (int i = 1; i < args.n_threads; ++i) {
+    threads.create_thread(boost::bind(
+        &GraphIndex::InsertRange_<TableType,
+          typename IndexArgsType::MetricType_t>,
+        this, &table, &args.metric, ef_construction,
+        &next_point, end, &next_point_lock));
+  }
+  InsertRange_(this, &table, &args.metric, ef_construction,
+               &next_point, end, &next_point_lock);
+  threads.join_all();
+}
+
+template<typename TableType, typename MetricType>
+void GraphIndex::InsertRange_(GraphIndex *graph,
+                              const TableType *table,
+                              const MetricType *metric,
+                              index_t ef_construction,
+                              index_t *next_point,
+                              index_t end,
+                              boost::mutex *next_point_lock) {
+  SearchSpace space;
+  while (true) {
+    index_t point;
+    {
+      boost::mutex::scoped_lock lock(*next_point_lock);
+      if (*next_point >= end) {
+        return;
+      }
+      point = (*next_point)++;
+    }
+    graph->InsertPoint_(*table, *metric, point, ef_construction, &space);
+  }
+}
+
+template<typename TableType, typename MetricType>
+void GraphIndex::InsertPoint_(const TableType &table,
+                              const MetricType &metric,
+                              index_t point,
+                              index_t ef_construction,
+                              SearchSpace *space) {
+  typename TableType::Point_t query;
+  table.get(point, &query);
+  index_t entry;
+  int top_level;
+  {
+    boost::mutex::scoped_lock lock(entry_lock_);
+    entry = entry_point_;
+    top_level = max_level_;
+  }
+  int level = levels_[point];
+  entry = GreedySearch_(table, metric, query, entry, top_level, level);
+  std::vector<index_t> entries(1, entry);
+  std::vector<Neighbor_t> candidates;
+  std::vector<index_t> selected;
+  for (int l = std::min(level, top_level); l >= 0; --l) {
+    SearchLevel_(table, metric, query, entries, ef_construction, l,
+                 space, &candidates);
+    SelectNeighbors_(table, metric, candidates, max_degree_, &selected);
+    {
+      boost::mutex::scoped_lock lock(link_locks_[point % kNumOfLocks]);
+      links_[point][l] = selected;
+    }
+    for (size_t i = 0; i < selected.size(); ++i) {
+      Link_(table, metric, selected[i], point, l);
+    }
+    entries.clear();
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      entries.push_back(candidates[i].second);
+    }
+  }
+  if (level > top_level) {
+    boost::mutex::scoped_lock lock(entry_lock_);
+    if (level > max_level_) {
+      entry_point_ = point;
+      max_level_ = level;
+    }
+  }
+}
+
+template<typename TableType, typename MetricType>
+void GraphIndex::Link_(const TableType &table,
+                       const MetricType &metric,
+                       index_t point,
+                       index_t neighbor,
+                       int level) {
+  index_t max_links = MaxLinks_(level);
+  boost::mutex::scoped_lock lock(link_locks_[point % kNumOfLocks]);
+  std::vector<index_t> &links = links_[point][level];
+  links.push_back(neighbor);
+  if (static_cast<index_t>(links.size()) <= max_links) {
+    return;
+  }
+  // the point has too many links, it keeps the ones the heuristic selects
+  typename TableType::Point_t center;
+  typename TableType::Point_t other;
+  table.get(point, &center);
+  std::vector<Neighbor_t> candidates;
+  for (size_t i = 0; i < links.size(); ++i) {
+    table.get(links[i], &other);
+    candidates.push_back(Neighbor_t(metric.DistanceSq(other, center),
+                                    links[i]));
+  }
+  std::sort(candidates.begin(), candidates.end());
+  SelectNeighbors_(table, metric, candidates, max_links, &links);
+}
+
+template<typename TableType, typename MetricType>
+void GraphIndex::SelectNeighbors_(const TableType &table,
+                                  const MetricType &metric,
+                                  const std::vector<Neighbor_t> &candidates,
+                                  index_t max_links,
+                                  std::vector<index_t> *selected) const {
+  // A candidate is kept only if it is closer to the point than to every
+  // neighbor kept so far, so that the links spread in all directions
+  // instead of crowding in the densest one. The candidates are sorted
+  selected->clear();
+  typename TableType::Point_t candidate;
+  typename TableType::Point_t kept;
+  for (size_t i = 0; i < candidates.size()
+       && static_cast<index_t>(selected->size()) < max_links; ++i) {
+    table.get(candidates[i].second, &candidate);
+    bool is_good = true;
+    for (size_t j = 0; j < selected->size(); ++j) {
+      table.get((*selected)[j], &kept);
+      if (metric.DistanceSq(kept, candidate) < candidates[i].first) {
+        is_good = false;
+        break;
+      }
+    }
+    if (is_good) {
+      selected->push_back(candidates[i].second);
+    }
+  }
+}
+
+template<typename TableType, typename MetricType, typename PointType>
+index_t GraphIndex::GreedySearch_(const TableType &table,
+                                  const MetricType &metric,
+                                  const PointType &query,
+                                  index_t entry,
+                                  int top_level,
+                                  int bottom_level) const {
+  typename TableType::Point_t point;
+  table.get(entry, &point);
+  // do not change the order of arguments it will fail in assymetric divergences
+  double distance = metric.DistanceSq(point, query);
+  std::vector<index_t> links;
+  for (int l = top_level; l > bottom_level; --l) {
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      GetLinks_(entry, l, &links);
+      for (size_t i = 0; i < links.size(); ++i) {
+        table.get(links[i], &point);
+        double d = metric.DistanceSq(point, query);
+        if (d < distance) {
+          distance = d;
+          entry = links[i];
+          changed = true;
+        }
+      }
+    }
+  }
+  return entry;
+}
+
+template<typename TableType, typename MetricType, typename PointType>
+void GraphIndex::SearchLevel_(const TableType &table,
+                              const MetricType &metric,
+                              const PointType &query,
+                              const std::vector<index_t> &entries,
+                              index_t search_breadth,
+                              int level,
+                              SearchSpace *space,
+                              std::vector<Neighbor_t> *result) const {
+  space->Reset(static_cast<index_t>(levels_.size()));
+  // the closest candidate that has not been expanded is on top
+  std::priority_queue<Neighbor_t, std::vector<Neighbor_t>,
+    std::greater<Neighbor_t> > candidates;
+  // the furthest of the best search_breadth points is on top
+  std::priority_queue<Neighbor_t> best;
+  typename TableType::Point_t point;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (space->Visit(entries[i]) == false) {
+      continue;
+    }
+    table.get(entries[i], &point);
+    double distance = metric.DistanceSq(point, query);
+    candidates.push(Neighbor_t(distance, entries[i]));
+    best.push(Neighbor_t(distance, entries[i]));
+    if (static_cast<index_t>(best.size()) > search_breadth) {
+      best.pop();
+    }
+  }
+  std::vector<index_t> links;
+  while (!candidates.empty()) {
+    Neighbor_t current = candidates.top();
+    if (current.first > best.top().first) {
+      break;
+    }
+    candidates.pop();
+    GetLinks_(current.second, level, &links);
+    for (size_t i = 0; i < links.size(); ++i) {
+      if (space->Visit(links[i]) == false) {
+        continue;
+      }
+      table.get(links[i], &point);
+      double distance = metric.DistanceSq(point, query);
+      if (static_cast<index_t>(best.size()) < search_breadth
+          || distance < best.top().first) {
+        candidates.push(Neighbor_t(distance, links[i]));
+        best.push(Neighbor_t(distance, links[i]));
+        if (static_cast<index_t>(best.size()) > search_breadth) {
+          best.pop();
+        }
+      }
+    }
+  }
+  result->resize(best.size());
+  for (index_t i = static_cast<index_t>(best.size()) - 1; i >= 0; --i) {
+    (*result)[i] = best.top();
+    best.pop();
+  }
+}
+
+template<typename TableType, typename MetricType, typename PointType>
+void GraphIndex::Search(const TableType &table,
+                        const MetricType &metric,
+                        const PointType &query,
+                        index_t k,
+                        index_t search_breadth,
+                        std::vector<Neighbor_t> *neighbors,
+                        SearchSpace *space) const {
+  neighbors->clear();
+  if (is_indexed() == false) {
+    fl::logger->Die() << "You are trying to search a graph that is not built";
+  }
+  SearchSpace local_space;
+  if (space == NULL) {
+    space = &local_space;
+  }
+  index_t entry;
+  int top_level;
+  {
+    boost::mutex::scoped_lock lock(entry_lock_);
+    entry = entry_point_;
+    top_level = max_level_;
+  }
+  entry = GreedySearch_(table, metric, query, entry, top_level, 0);
+  SearchLevel_(table, metric, query, std::vector<index_t>(1, entry),
+               std::max(k, search_breadth), 0, space, neighbors);
+  if (static_cast<index_t>(neighbors->size()) > k) {
+    neighbors->resize(k);
+  }
+}
+
+}}
+
+#endif
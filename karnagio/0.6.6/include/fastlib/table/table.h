@@ -141,16 +141,25 @@ class Table : boost::noncopyable {
      *                    recursion will stop once the maximum length
      *                    inside the node is less or equal to max_length
      *        Only one of the above attributes can be non-negative
+     *        n_threads: the number of threads that build sibling 
+     *                   subtrees concurrently. The tree is the same
+     *                   no matter how many threads are used
+     *        split: the split rule of the tree, empty for the default
+     *               rule of the tree spec. The kd-trees support
+     *               midpoint, sliding_midpoint, median and variance, the
+     *               ball tree furthest and sampled
      */
     template<typename MetricType>
     struct IndexArgs {
       public:
-        IndexArgs() : leaf_size(-1), level(-1), diameter(-1) {
+        IndexArgs() : leaf_size(-1), level(-1), diameter(-1), n_threads(1) {
         }
         MetricType metric;
         index_t leaf_size;
         index_t level;
         CalcPrecision_t diameter;
+        int n_threads;
+        std::string split;
         
         template<typename Archive>
         void serialize(Archive &ar, const unsigned int version);
@@ -203,7 +212,17 @@ class Table : boost::noncopyable {
      */
     void Init(const std::string &header);
     void Destruct();
+    /**
+     * @brief Saves the table as text, unless the filename ends with 
+     *        the extension of the binary format
+     */
     void Save();
+    /**
+     * @brief Saves the table in the native binary format. If the table
+     *        is indexed the tree is saved too, so that it doesn't have to
+     *        be rebuilt when the table is loaded
+     */
+    void SaveBinary(const std::string &file);
     // Carefull
     // CloneData will make a point by point copy
     // it will not copy index
@@ -226,6 +245,35 @@ class Table : boost::noncopyable {
 
     template<typename IndexArgsType>
     void IndexData(IndexArgsType &args);
+    /**
+     * @brief Adds the points of a table to an indexed table without
+     *        rebuilding the tree. Every point goes down to the leaf with
+     *        the closest bound, expanding the bounds on its way, and the
+     *        leaves that end up with more than leaf_size points are split.
+     *        The new points get the ids that follow the current ones
+     */
+    template<typename IndexArgsType>
+    void InsertData(Table_t &points, IndexArgsType &args);
+    /**
+     * @brief Removes points from the tree of an indexed table without
+     *        rebuilding it. The deleted points stay in the table as 
+     *        tombstones after the points of the tree, so no id changes and
+     *        the algorithms that traverse the tree never see them. The
+     *        nodes that lost more than half of their points are built
+     *        again, the bounds of the others are not shrunk. Deleting a 
+     *        tombstone again does nothing
+     */
+    template<typename IndexArgsType>
+    void DeleteData(const std::vector<index_t> &ids, IndexArgsType &args);
+    /**
+     * @brief Frees the tombstones DeleteData left. The points that 
+     *        remain keep their order but get consecutive ids, the id of a
+     *        point decreases by the number of tombstones with smaller ids.
+     *        If new_ids is not NULL it gets the new id of every old id, -1
+     *        for the tombstones, so that the callers that keep ids can
+     *        translate them. The tree does not change
+     */
+    void CompactData(std::vector<index_t> *new_ids=NULL);
     void DeleteIndex();
     template<typename ContainerType>
     void ComputeNodesPerLevel(ContainerType *cont);
@@ -301,6 +349,12 @@ class Table : boost::noncopyable {
     const std::vector<index_t> dense_sizes() const;
     const std::vector<index_t> sparse_sizes() const;
     index_t n_entries() const;
+    /**
+     * @brief The tombstones DeleteData left, they are counted in 
+     *        n_entries until CompactData frees them
+     */
+    index_t n_deleted_entries() const;
+    bool is_deleted(index_t point_id) const;
     index_t get_node_begin(Tree_t *node) const;
     index_t get_node_end(Tree_t *node) const ;
     index_t get_node_count(Tree_t *node) const;
@@ -334,6 +388,42 @@ class Table : boost::noncopyable {
     std::vector<index_t> shuffled_to_real_;
     std::vector<std::pair<Tree_t*, Point_t> > sampled_data_;
     std::pair<index_t, Point_t*> cached_point_;
+    /**
+     * @brief The number of points inserted in or deleted from every node
+     *        since it was built, indexed by the node id. A node that had
+     *        more than half of its points changed is built again
+     */
+    std::vector<index_t> node_changes_;
+
+    /**
+     * @brief Brings the tree up to date after points have been appended
+     *        to the table, from first_inserted on, or marked as deleted.
+     *        It moves the points so that every node is still a contiguous
+     *        range and the tombstones follow the tree, and rebuilds the
+     *        nodes that changed too much
+     */
+    template<typename IndexArgsType>
+    void UpdateIndex_(const std::vector<bool> &deleted,
+                      index_t first_inserted,
+                      IndexArgsType &args);
+    template<typename MetricType>
+    Tree_t *ClosestChild_(MetricType &metric,
+                          Tree_t *node,
+                          const Point_t &point);
+    template<typename ContainerType>
+    void ComputeNewPositionsRecursion_(Tree_t *node,
+                                       const std::vector<bool> &deleted,
+                                       ContainerType &inserted,
+                                       std::vector<index_t> *destination,
+                                       index_t *next);
+    template<typename IndexArgsType>
+    void RebuildChangedNodesRecursion_(Tree_t *node, IndexArgsType &args);
+    /**
+     * @brief Appends the changes of the nodes in depth first order,
+     *        which is the order of the ids NumberNodes_ gives
+     */
+    void CollectNodeChangesRecursion_(Tree_t *node, 
+                                      std::vector<index_t> *changes);
 
     template<typename ContainerType>
     void ComputeNodesPerLevelRecusrion_(Tree_t *node,
@@ -375,6 +465,8 @@ class Table : boost::noncopyable {
                                  index_t num_of_points, 
                                  Table_t *table);
 
+    void LoadBinaryIndex(const std::string &file);
+
   protected:
     void direct_get_(index_t point_id, Point_t *entry) const;
     index_t  direct_get_id_(index_t point_id) const;
@@ -0,0 +1,86 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef FL_LITE_FASTLIB_TABLE_TABLE_BINARY_H_
+#define FL_LITE_FASTLIB_TABLE_TABLE_BINARY_H_
+#include <fstream>
+#include "fastlib/table/table.h"
+#include "fastlib/data/binary_table_format.h"
+
+namespace fl {
+namespace table {
+
+template<typename TemplateMap>
+void Table<TemplateMap>::SaveBinary(const std::string &file) {
+  std::ofstream fout(file.c_str(), 
+      std::ios::out | std::ios::binary | std::ios::trunc);
+  if (fout.fail()) {
+    fl::logger->Die() << "Could not open file "
+      << file << " error " << strerror(errno);
+  }
+  // leave space for the prelude, it is written in the end
+  // when we know where the footer is
+  std::vector<char> prelude(fl::data::BinaryTableFormat::kPreludeSize, 0);
+  fout.write(&prelude[0], prelude.size());
+  fl::data::BinaryTableFooter footer;
+  data_->SaveBinary(fout, &footer);
+  if (tree_ != NULL) {
+    footer.has_index = 1;
+    footer.index_offset = fl::data::AlignBinaryTableStream(fout);
+    fl::data::BinaryTableOArchive oa(fout);
+    oa << real_to_shuffled_;
+    oa << shuffled_to_real_;
+    oa << tree_;
+    oa << num_of_nodes_;
+    oa << leaf_size_;
+    oa << metric_type_id_;
+    footer.index_size = static_cast<uint64>(fout.tellp())-footer.index_offset;
+  }
+  fl::data::WriteBinaryTableFooter(footer, fout);
+}
+
+template<typename TemplateMap>
+void Table<TemplateMap>::LoadBinaryIndex(const std::string &file) {
+  fl::data::BinaryTableFooter footer;
+  fl::data::ReadBinaryTableFooter(file, &footer);
+  if (footer.has_index == 0) {
+    return;
+  }
+  if (tree_ != NULL) {
+    delete tree_;
+    tree_ = NULL;
+  }
+  std::ifstream fin(file.c_str(), std::ios::in | std::ios::binary);
+  fin.seekg(footer.index_offset);
+  fl::data::BinaryTableIArchive ia(fin);
+  ia >> real_to_shuffled_;
+  ia >> shuffled_to_real_;
+  ia >> tree_;
+  ia >> num_of_nodes_;
+  ia >> leaf_size_;
+  ia >> metric_type_id_;
+}
+
+}}
+#endif
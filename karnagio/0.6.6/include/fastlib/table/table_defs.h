@@ -130,8 +130,316 @@ namespace table {
         }     
       }
     }
+    node_changes_.assign(num_of_nodes_, 0);
   }
 
+  template<typename TemplateMap>
+  template<typename IndexArgsType>
+  void Table<TemplateMap>::InsertData(Table_t &points, IndexArgsType &args) {
+    if (tree_ == NULL) {
+      fl::logger->Die() << "You are trying to insert points in a table "
+        << "that is not indexed, use IndexData instead";
+    }
+    if (points.n_attributes() != n_attributes()) {
+      fl::logger->Die() << "The inserted points have "
+        << points.n_attributes() << " attributes while the table has "
+        << n_attributes();
+    }
+    if (points.n_entries() == 0) {
+      return;
+    }
+    const index_t first_inserted=n_entries();
+    Point_t point;
+    for(index_t i=0; i<points.n_entries(); ++i) {
+      points.get(i, &point);
+      data_->push_back(point);
+    }
+    std::vector<bool> deleted(tree_->count(), false);
+    UpdateIndex_(deleted, first_inserted, args);
+  }
+
+  template<typename TemplateMap>
+  template<typename IndexArgsType>
+  void Table<TemplateMap>::DeleteData(const std::vector<index_t> &ids, 
+      IndexArgsType &args) {
+    if (tree_ == NULL) {
+      fl::logger->Die() << "You are trying to delete points from a table "
+        << "that is not indexed";
+    }
+    std::vector<bool> deleted(tree_->count(), false);
+    index_t num_of_deleted=0;
+    for(size_t i=0; i<ids.size(); ++i) {
+      if (ids[i] < 0 || ids[i] >= n_entries()) {
+        fl::logger->Die() << "You are trying to delete point " << ids[i]
+          << " from a table with " << n_entries() << " points";
+      }
+      if (is_deleted(ids[i])) {
+        continue;
+      }
+      if (deleted[real_to_shuffled_[ids[i]]] == false) {
+        deleted[real_to_shuffled_[ids[i]]] = true;
+        num_of_deleted++;
+      }
+    }
+    if (num_of_deleted == tree_->count()) {
+      fl::logger->Die() << "You are trying to delete all the points of the "
+        << "table, delete the table instead";
+    }
+    if (num_of_deleted == 0) {
+      return;
+    }
+    UpdateIndex_(deleted, n_entries(), args);
+  }
+
+  template<typename TemplateMap>
+  void Table<TemplateMap>::CompactData(std::vector<index_t> *new_ids) {
+    const index_t old_count=n_entries();
+    const index_t new_count=old_count-n_deleted_entries();
+    if (new_ids != NULL) {
+      new_ids->resize(old_count);
+      index_t next=0;
+      for(index_t i=0; i<old_count; ++i) {
+        (*new_ids)[i]=is_deleted(i) ? -1 : next++;
+      }
+    }
+    if (new_count == old_count) {
+      return;
+    }
+    // the ids are shifted down over the tombstones
+    std::vector<index_t> id_shift(old_count, 0);
+    index_t num_of_smaller_deleted=0;
+    for(index_t i=0; i<old_count; ++i) {
+      id_shift[i]=num_of_smaller_deleted;
+      num_of_smaller_deleted+=is_deleted(i) ? 1 : 0;
+    }
+    // the tombstones are already at the end when the points are sorted,
+    // otherwise the table is in the order of the ids and the points that
+    // remain move down over them
+    if (sort_points == false) {
+      for(index_t i=0; i<old_count; ++i) {
+        if (is_deleted(i) == false && id_shift[i] > 0) {
+          Point_t point1, point2;
+          data_->get(i, &point1);
+          data_->get(i-id_shift[i], &point2);
+          point1.SwapValues(&point2);
+        }
+      }
+    }
+    for(index_t i=new_count; i<old_count; ++i) {
+      data_->pop_back();
+    }
+    shuffled_to_real_.resize(new_count);
+    real_to_shuffled_.resize(new_count);
+    for(index_t i=0; i<new_count; ++i) {
+      shuffled_to_real_[i]-=id_shift[shuffled_to_real_[i]];
+      real_to_shuffled_[shuffled_to_real_[i]]=i;
+    }
+    cached_point_.first=-1;
+  }
+
+  template<typename TemplateMap>
+  template<typename IndexArgsType>
+  void Table<TemplateMap>::UpdateIndex_(const std::vector<bool> &deleted,
+      index_t first_inserted,
+      IndexArgsType &args) {
+    if (metric_type_id_ != typeid(args.metric).name()) {
+      fl::logger->Die() << "The table was indexed with a different metric "
+        << "than the one of the update";
+    }
+    if (leaf_size_ <= 1) {
+      fl::logger->Die() << "Only trees that were built with a leaf_size "
+        << "can be updated, this one has to be indexed again";
+    }
+    // the split rules stop at the leaf size the tree was built with
+    args.leaf_size = leaf_size_;
+    const index_t old_count = tree_->count();
+    const index_t total_count = n_entries();
+    node_changes_.resize(num_of_nodes_, 0);
+    // The points appended to the table go down to a leaf and wait
+    // there until the points are moved
+    std::unordered_map<Tree_t*, std::vector<index_t> > inserted;
+    Point_t point;
+    for(index_t i=first_inserted; i<total_count; ++i) {
+      data_->get(i, &point);
+      Tree_t *node=tree_;
+      while (true) {
+        node->bound().Expand(args.metric, point);
+        node_changes_[node->node_id()]++;
+        if (node->is_leaf()) {
+          break;
+        }
+        node=ClosestChild_(args.metric, node, point);
+      }
+      inserted[node].push_back(i);
+    }
+    for(index_t i=0; i<old_count; ++i) {
+      if (deleted[i] == false) {
+        continue;
+      }
+      Tree_t *node=tree_;
+      while (true) {
+        node_changes_[node->node_id()]++;
+        if (node->is_leaf()) {
+          break;
+        }
+        for(size_t j=0; j<node->children().size(); ++j) {
+          if (i < node->children()[j]->end()) {
+            node=node->children()[j];
+            break;
+          }
+        }
+      }
+    }
+    // Every node must still be a contiguous range of the table. The
+    // deleted points join the tombstones after the tree
+    std::vector<index_t> destination(total_count);
+    index_t next=0;
+    ComputeNewPositionsRecursion_(tree_, deleted, inserted, 
+        &destination, &next);
+    for(index_t i=0; i<old_count; ++i) {
+      if (deleted[i] == true) {
+        destination[i]=next++;
+      }
+    }
+    for(index_t i=old_count; i<first_inserted; ++i) {
+      destination[i]=next++;
+    }
+    DEBUG_ASSERT(next == total_count);
+    // the appended points get the ids that follow the existing ones
+    shuffled_to_real_.resize(total_count);
+    real_to_shuffled_.resize(total_count);
+    for(index_t i=first_inserted; i<total_count; ++i) {
+      shuffled_to_real_[i]=i;
+    }
+    // apply the permutation in place, one cycle at a time. When the points
+    // are not sorted the table stays in the order of the ids
+    for(index_t i=0; i<total_count; ++i) {
+      while (destination[i] != i) {
+        const index_t j=destination[i];
+        if (sort_points) {
+          Point_t point1, point2;
+          data_->get(i, &point1);
+          data_->get(j, &point2);
+          point1.SwapValues(&point2);
+        }
+        std::swap(shuffled_to_real_[i], shuffled_to_real_[j]);
+        std::swap(destination[i], destination[j]);
+      }
+    }
+    for(index_t i=0; i<total_count; ++i) {
+      real_to_shuffled_[shuffled_to_real_[i]]=i;
+    }
+    cached_point_.first=-1;
+    node_changes_.resize(num_of_nodes_, 0);
+    RebuildChangedNodesRecursion_(tree_, args);
+    // the rebuilt nodes took ids after the last one, the nodes are 
+    // numbered again so that the ids, and everything that is indexed
+    // by them, stay as many as the nodes of the tree
+    node_changes_.resize(num_of_nodes_, 0);
+    std::vector<index_t> changes;
+    changes.reserve(num_of_nodes_);
+    CollectNodeChangesRecursion_(tree_, &changes);
+    num_of_nodes_=0;
+    Tree_t::NumberNodes_(tree_, &num_of_nodes_);
+    node_changes_.swap(changes);
+  }
+
+  template<typename TemplateMap>
+  template<typename MetricType>
+  typename Table<TemplateMap>::Tree_t *Table<TemplateMap>::ClosestChild_(
+      MetricType &metric,
+      Tree_t *node,
+      const Point_t &point) {
+    Tree_t *closest=NULL;
+    CalcPrecision_t closest_distance=0;
+    for(size_t i=0; i<node->children().size(); ++i) {
+      Tree_t *child=node->children()[i];
+      const CalcPrecision_t distance=
+        child->bound().MinDistanceSq(metric, point);
+      // among the children that already contain the point the one
+      // with fewer points takes it
+      if (closest == NULL || distance < closest_distance
+          || (distance == closest_distance 
+              && child->count() < closest->count())) {
+        closest=child;
+        closest_distance=distance;
+      }
+    }
+    return closest;
+  }
+
+  template<typename TemplateMap>
+  template<typename ContainerType>
+  void Table<TemplateMap>::ComputeNewPositionsRecursion_(Tree_t *node,
+      const std::vector<bool> &deleted,
+      ContainerType &inserted,
+      std::vector<index_t> *destination,
+      index_t *next) {
+    const index_t begin=*next;
+    if (node->is_leaf()) {
+      for(index_t i=node->begin(); i<node->end(); ++i) {
+        if (deleted[i] == false) {
+          (*destination)[i]=(*next)++;
+        }
+      }
+      typename ContainerType::iterator it=inserted.find(node);
+      if (it != inserted.end()) {
+        for(size_t i=0; i<it->second.size(); ++i) {
+          (*destination)[it->second[i]]=(*next)++;
+        }
+      }
+    } else {
+      for(size_t i=0; i<node->children().size(); ++i) {
+        ComputeNewPositionsRecursion_(node->children()[i], deleted,
+            inserted, destination, next);
+      }
+    }
+    node->Init(begin, *next-begin);
+  }
+
+  template<typename TemplateMap>
+  template<typename IndexArgsType>
+  void Table<TemplateMap>::RebuildChangedNodesRecursion_(Tree_t *node, 
+      IndexArgsType &args) {
+    if (node->count() == 0) {
+      // there is nothing to bound, the node is never visited with points
+      return;
+    }
+    index_t &changes=node_changes_[node->node_id()];
+    if (2*changes > node->count() 
+        || (node->is_leaf() && node->count() > leaf_size_)) {
+      node->ReleaseChildren(tree_->arena_);
+      changes=0;
+      typename Table_t::TreeIterator it=get_node_iterator(node);
+      Tree_t::TreeSpec_t::SplitRule::FindBoundFromMatrix(args.metric,
+          it, &node->bound());
+      index_t level=0;
+      node->level(&level);
+      // the new nodes take the places the released ones left in the arena
+      std::vector<bool> membership;
+      Tree_t::template SplitTree_<0>(args, *this, node, level, 
+          &num_of_nodes_, 1, tree_->arena_, &membership);
+      return;
+    }
+    if (!node->is_leaf()) {
+      for(size_t i=0; i<node->children().size(); ++i) {
+        RebuildChangedNodesRecursion_(node->children()[i], args);
+      }
+    }
+  }
+
+  template<typename TemplateMap>
+  void Table<TemplateMap>::CollectNodeChangesRecursion_(Tree_t *node, 
+      std::vector<index_t> *changes) {
+    changes->push_back(node_changes_[node->node_id()]);
+    if (!node->is_leaf()) {
+      for(size_t i=0; i<node->children().size(); ++i) {
+        CollectNodeChangesRecursion_(node->children()[i], changes);
+      }
+    }
+  }
+
+
   template<typename TemplateMap>
   template<typename ContainerType>
   void Table<TemplateMap>::ComputeNodesPerLevel(ContainerType *cont) {
@@ -26,6 +26,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #define FL_LITE_FASTLIB_TABLE_TABLE_DEV_H_
 #include "fastlib/table/table.h"
 #include "fastlib/table/table_defs.h"
+#include "fastlib/table/table_binary.h"
 #include "fastlib/math/fl_math.h"
 #include "boost/lexical_cast.hpp"
 #include "boost/mpl/if.hpp"
@@ -151,6 +152,9 @@ Table<TemplateMap>::~Table() {
 template<typename TemplateMap>
 void Table<TemplateMap>::Init(const std::string &file, const char* mode) {
   data_->Init(file, mode);
+  if (std::string(mode) == "r" && fl::data::IsBinaryTableFile(file)) {
+    LoadBinaryIndex(file);
+  }
 }
 
 template<typename TemplateMap>
@@ -171,6 +175,10 @@ void Table<TemplateMap>::Destruct() {
 
 template<typename TemplateMap>
 void Table<TemplateMap>::Save() {
+  if (fl::StringEndsWith(filename_, fl::data::BinaryTableFormat::Extension())) {
+    SaveBinary(filename_);
+    return;
+  }
   data_->Save(filename_,
              true,
              std::vector<std::string>(),
@@ -310,6 +318,7 @@ template<typename TemplateMap>
 void Table<TemplateMap>::DeleteIndex() {
   metric_type_id_ = "";
   num_of_nodes_=0;
+  node_changes_.clear();
   if (tree_ != NULL) {
     delete tree_;
     tree_ = NULL;
@@ -987,6 +996,22 @@ index_t  Table<TemplateMap>::n_entries() const {
   return data_->n_points();
 }
 
+template<typename TemplateMap>
+index_t Table<TemplateMap>::n_deleted_entries() const {
+  if (tree_ == NULL) {
+    return 0;
+  }
+  return n_entries() - tree_->count();
+}
+
+template<typename TemplateMap>
+bool Table<TemplateMap>::is_deleted(index_t point_id) const {
+  DEBUG_ASSERT(point_id>=0);
+  DEBUG_ASSERT(point_id<n_entries());
+  // the tombstones are the points after the ones of the tree
+  return tree_ != NULL && real_to_shuffled_[point_id] >= tree_->count();
+}
+
 template<typename TemplateMap>
 index_t Table<TemplateMap>::get_node_begin(Tree_t *node) const {
   return node->begin();
@@ -0,0 +1,147 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef FL_LITE_FASTLIB_TABLE_TABLE_STREAM_H_
+#define FL_LITE_FASTLIB_TABLE_TABLE_STREAM_H_
+#include <deque>
+#include <string>
+#include "fastlib/base/base.h"
+#include "boost/shared_ptr.hpp"
+#include "boost/scoped_ptr.hpp"
+#include "boost/thread.hpp"
+#include "boost/exception_ptr.hpp"
+#include "boost/cstdint.hpp"
+#include "boost/iostreams/device/mapped_file.hpp"
+
+namespace fl { namespace table {
+/**
+ * @brief Reads a table that is too big for RAM as a sequence of blocks.
+ *        A text file is memory mapped one window at a time and every block
+ *        holds the points of about block_size bytes of the file. At most
+ *        window blocks are resident: the one returned by NextBlock and 
+ *        the ones a background thread reads ahead. The bound holds as long
+ *        as the caller does not keep the blocks it has already consumed.
+ *        Binary table files are already paged in on demand, so they are
+ *        returned as a single block.
+ *
+ * @code
+ *   fl::table::TableStream<Table_t> stream;
+ *   stream.Init("huge.csv", 64<<20, 2);
+ *   boost::shared_ptr<Table_t> block;
+ *   while (stream.NextBlock(&block)) {
+ *     for(index_t i=0; i<block->n_entries(); ++i) {
+ *       ...
+ *     }
+ *   }
+ * @endcode
+ */
+template<typename TableType>
+class TableStream {
+  public:
+    typedef TableType Table_t;
+    TableStream();
+    ~TableStream();
+    /**
+     * @brief Opens the file and reads its header. block_size is in bytes,
+     *        window is the maximum number of resident blocks. If window
+     *        is 1 blocks are read when NextBlock is called
+     */
+    void Init(const std::string &filename, index_t block_size, int window);
+    /**
+     * @brief Streams a table that is already in memory as a single block
+     */
+    void Init(boost::shared_ptr<TableType> table);
+    /**
+     * @brief Returns the next block of the table, or false if all the
+     *        points have been read. The previous block held by *block is
+     *        released before the next one is read
+     */
+    bool NextBlock(boost::shared_ptr<TableType> *block);
+    /**
+     * @brief Rewinds the stream to the first point, so that the table
+     *        can be read again
+     */
+    void Reset();
+    /**
+     * @brief A table with the dimensions, the labels and the header 
+     *        of the streamed file. It has no points, unless the file 
+     *        is binary, in which case it is the single block
+     */
+    const TableType &layout() const;
+    /**
+     * @brief The number of points of the table. For a text file the 
+     *        points are counted in a pass over the file the first time 
+     *        it is called, one block at a time and without parsing them
+     */
+    index_t n_entries();
+    index_t n_attributes() const;
+    const std::string &filename() const;
+    index_t block_size() const;
+    int window() const;
+    /**
+     * @brief The number of threads that parse every block, 
+     *        by default it is the number of cores
+     */
+    void set_n_threads(int n_threads);
+
+  private:
+    std::string filename_;
+    index_t block_size_;
+    int window_;
+    int n_threads_;
+    boost::shared_ptr<TableType> layout_;
+    // binary files and tables in memory are streamed as one block
+    bool single_block_;
+    boost::uintmax_t file_size_;
+    // the offset of the first point in the file
+    boost::uintmax_t data_offset_;
+    // the offset of the next block in the file
+    boost::uintmax_t offset_;
+    bool finished_;
+    // -1 until the points are counted
+    index_t n_entries_;
+    // read ahead state, everything below is guarded by mutex_
+    boost::scoped_ptr<boost::thread> reader_;
+    boost::mutex mutex_;
+    boost::condition_variable changed_;
+    std::deque<boost::shared_ptr<TableType> > blocks_;
+    bool reader_done_;
+    bool stop_reader_;
+    boost::exception_ptr error_;
+
+    /**
+     * @brief maps the block that starts at offset, [*begin, *end) are 
+     *        the complete lines of the block
+     */
+    void MapBlock(boost::uintmax_t offset,
+        boost::iostreams::mapped_file_source *region,
+        const char **begin, const char **end);
+    bool ReadBlock(boost::shared_ptr<TableType> *block);
+    void ReadAhead();
+    void StopReader();
+};
+
+}}
+#endif
@@ -0,0 +1,319 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef FL_LITE_FASTLIB_TABLE_TABLE_STREAM_DEV_H_
+#define FL_LITE_FASTLIB_TABLE_TABLE_STREAM_DEV_H_
+#include <fstream>
+#include <algorithm>
+#include "fastlib/table/table_stream.h"
+#include "fastlib/base/logger.h"
+#include "fastlib/data/binary_table_format.h"
+#include "boost/bind.hpp"
+#include "boost/filesystem.hpp"
+#include "boost/iostreams/device/mapped_file.hpp"
+
+namespace fl { namespace table {
+
+template<typename TableType>
+TableStream<TableType>::TableStream() : 
+  block_size_(0), window_(1), 
+  n_threads_(std::max(1, static_cast<int>(boost::thread::hardware_concurrency()))),
+  single_block_(false), file_size_(0), data_offset_(0), offset_(0),
+  finished_(false), n_entries_(-1), reader_done_(false), stop_reader_(false) {
+}
+
+template<typename TableType>
+TableStream<TableType>::~TableStream() {
+  StopReader();
+}
+
+template<typename TableType>
+void TableStream<TableType>::Init(const std::string &filename,
+    index_t block_size, int window) {
+  FL_SCOPED_LOG(TableStream);
+  if (block_size <= 0) {
+    fl::logger->Die() << "The block size of a table stream must be positive";
+  }
+  if (window < 1) {
+    fl::logger->Die() << "A table stream needs a window of at least one block";
+  }
+  StopReader();
+  filename_ = filename;
+  block_size_ = block_size;
+  window_ = window;
+  n_entries_ = -1;
+  layout_.reset(new TableType());
+  single_block_ = fl::data::IsBinaryTableFile(filename);
+  if (single_block_) {
+    // the binary file is memory mapped and paged in on demand, 
+    // so the whole table is the only block
+    layout_->Init(filename, "r");
+    data_offset_ = 0;
+  } else {
+    index_t lines_to_skip = 0;
+    layout_->data()->InitLayout(filename, &lines_to_skip);
+    std::ifstream fin(filename.c_str(), std::ios_base::in);
+    std::string line;
+    for (index_t i = 0; i < lines_to_skip; ++i) {
+      std::getline(fin, line);
+    }
+    data_offset_ = fin.good() ? static_cast<boost::uintmax_t>(fin.tellg()) : 0;
+    file_size_ = boost::filesystem::file_size(filename);
+  }
+  layout_->filename() = filename;
+  Reset();
+}
+
+template<typename TableType>
+void TableStream<TableType>::Init(boost::shared_ptr<TableType> table) {
+  StopReader();
+  filename_ = table->filename();
+  block_size_ = 0;
+  window_ = 1;
+  n_entries_ = -1;
+  layout_ = table;
+  single_block_ = true;
+  data_offset_ = 0;
+  Reset();
+}
+
+template<typename TableType>
+bool TableStream<TableType>::NextBlock(boost::shared_ptr<TableType> *block) {
+  block->reset();
+  if (window_ == 1) {
+    return ReadBlock(block);
+  }
+  boost::mutex::scoped_lock lock(mutex_);
+  if (reader_.get() == NULL && reader_done_ == false) {
+    reader_.reset(new boost::thread(
+        boost::bind(&TableStream<TableType>::ReadAhead, this)));
+  }
+  while (blocks_.empty() && reader_done_ == false) {
+    changed_.wait(lock);
+  }
+  if (blocks_.empty() == false) {
+    *block = blocks_.front();
+    blocks_.pop_front();
+    changed_.notify_all();
+    return true;
+  }
+  if (error_) {
+    boost::exception_ptr error = error_;
+    error_ = boost::exception_ptr();
+    boost::rethrow_exception(error);
+  }
+  return false;
+}
+
+template<typename TableType>
+void TableStream<TableType>::Reset() {
+  StopReader();
+  blocks_.clear();
+  reader_done_ = false;
+  error_ = boost::exception_ptr();
+  offset_ = data_offset_;
+  finished_ = false;
+}
+
+template<typename TableType>
+const TableType &TableStream<TableType>::layout() const {
+  return *layout_;
+}
+
+template<typename TableType>
+index_t TableStream<TableType>::n_entries() {
+  if (n_entries_ >= 0) {
+    return n_entries_;
+  }
+  if (single_block_) {
+    n_entries_ = layout_->n_entries();
+    return n_entries_;
+  }
+  index_t n_entries = 0;
+  boost::uintmax_t offset = data_offset_;
+  while (offset < file_size_) {
+    boost::iostreams::mapped_file_source region;
+    const char *begin = NULL;
+    const char *end = NULL;
+    MapBlock(offset, &region, &begin, &end);
+    index_t n_points = 0;
+    const bool stopped = layout_->data()->CountText(begin, end, &n_points);
+    n_entries += n_points;
+    offset += end - begin;
+    if (stopped) {
+      break;
+    }
+  }
+  n_entries_ = n_entries;
+  return n_entries_;
+}
+
+template<typename TableType>
+index_t TableStream<TableType>::n_attributes() const {
+  return layout_->n_attributes();
+}
+
+template<typename TableType>
+const std::string &TableStream<TableType>::filename() const {
+  return filename_;
+}
+
+template<typename TableType>
+index_t TableStream<TableType>::block_size() const {
+  return block_size_;
+}
+
+template<typename TableType>
+int TableStream<TableType>::window() const {
+  return window_;
+}
+
+template<typename TableType>
+void TableStream<TableType>::set_n_threads(int n_threads) {
+  n_threads_ = std::max(1, n_threads);
+}
+
+template<typename TableType>
+void TableStream<TableType>::MapBlock(boost::uintmax_t offset,
+    boost::iostreams::mapped_file_source *region,
+    const char **begin, const char **end) {
+  // mappings must start at a multiple of the alignment
+  const boost::uintmax_t alignment = 
+    boost::iostreams::mapped_file_source::alignment();
+  const boost::uintmax_t map_offset = offset - offset % alignment;
+  boost::uintmax_t length = offset - map_offset 
+    + static_cast<boost::uintmax_t>(block_size_);
+  while (true) {
+    length = std::min(length, file_size_ - map_offset);
+    try {
+      region->open(filename_, length, map_offset);
+    }
+    catch(const std::exception &e) {
+      fl::logger->Die() << "Could not map a block of " << filename_
+        << " in memory, error: " << e.what();
+    }
+    *begin = region->data() + (offset - map_offset);
+    *end = region->data() + length;
+    if (map_offset + length == file_size_) {
+      return;
+    }
+    // the block ends at the last complete line of the window
+    const char *eol = *end;
+    while (eol > *begin && *(eol - 1) != '\n') {
+      --eol;
+    }
+    if (eol > *begin) {
+      *end = eol;
+      return;
+    }
+    // not even one line fits in the window, so we grow it
+    region->close();
+    length *= 2;
+  }
+}
+
+template<typename TableType>
+bool TableStream<TableType>::ReadBlock(boost::shared_ptr<TableType> *block) {
+  if (finished_ == true) {
+    return false;
+  }
+  if (single_block_) {
+    *block = layout_;
+    finished_ = true;
+    return true;
+  }
+  if (offset_ >= file_size_) {
+    finished_ = true;
+    return false;
+  }
+  boost::iostreams::mapped_file_source region;
+  const char *begin = NULL;
+  const char *end = NULL;
+  MapBlock(offset_, &region, &begin, &end);
+  block->reset(new TableType());
+  (*block)->data()->set_n_threads(n_threads_);
+  finished_ = (*block)->data()->InitFromText(*layout_->data(), begin, end);
+  (*block)->filename() = filename_;
+  offset_ += end - begin;
+  if ((*block)->n_entries() == 0 && finished_ == true) {
+    block->reset();
+    return false;
+  }
+  return true;
+}
+
+template<typename TableType>
+void TableStream<TableType>::ReadAhead() {
+  try {
+    while (true) {
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        // the block held by the caller and the one we are about
+        // to read count in the window
+        while (static_cast<int>(blocks_.size()) + 2 > window_ 
+            && stop_reader_ == false) {
+          changed_.wait(lock);
+        }
+        if (stop_reader_ == true) {
+          return;
+        }
+      }
+      boost::shared_ptr<TableType> block;
+      bool has_block = ReadBlock(&block);
+      boost::mutex::scoped_lock lock(mutex_);
+      if (has_block == false) {
+        reader_done_ = true;
+        changed_.notify_all();
+        return;
+      }
+      blocks_.push_back(block);
+      changed_.notify_all();
+    }
+  }
+  catch(...) {
+    boost::mutex::scoped_lock lock(mutex_);
+    error_ = boost::current_exception();
+    reader_done_ = true;
+    changed_.notify_all();
+  }
+}
+
+template<typename TableType>
+void TableStream<TableType>::StopReader() {
+  if (reader_.get() == NULL) {
+    return;
+  }
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stop_reader_ = true;
+    changed_.notify_all();
+  }
+  reader_->join();
+  reader_.reset();
+  stop_reader_ = false;
+}
+
+}}
+#endif
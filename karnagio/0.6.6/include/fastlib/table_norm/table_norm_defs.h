@@ -88,6 +88,7 @@ void TableNorm<boost::mpl::void_>::Core<WorkSpaceType>::operator()(
     "so that it can do the normalizations"
   );
 
+  fl::ws::AddWorkSpaceOptions(&desc);
   boost::program_options::variables_map vm;
   boost::program_options::command_line_parser clp(args_);
   clp.style(boost::program_options::command_line_style::default_style
@@ -31,6 +31,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "fastlib/base/logger.h"
 #include "fastlib/workspace/based_on_table_run.h"
 #include "fastlib/util/string_utils.h"
+#include "fastlib/workspace/arguments.h"
 
 
 namespace fl { namespace table {
@@ -64,6 +65,7 @@ void SelfOuterProd<boost::mpl::void_>::Core<WorkSpaceType>::operator()(
     "Everything below this flag will be clipped to zero"  
   );
 
+  fl::ws::AddWorkSpaceOptions(&desc);
   boost::program_options::variables_map vm;
   boost::program_options::command_line_parser clp(args_);
   clp.style(boost::program_options::command_line_style::default_style
@@ -30,6 +30,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "fastlib/table_util/table_summary.h"
 #include "fastlib/base/logger.h"
 #include "fastlib/workspace/based_on_table_run.h"
+#include "fastlib/table/table_stream.h"
 #include "fastlib/util/string_utils.h"
 #include "fastlib/workspace/arguments.h"
 #include "fastlib/math/fl_math.h"
@@ -61,6 +62,7 @@ void TableSummary<boost::mpl::void_>::Core<WorkSpaceType>::operator()(
     boost::program_options::value<int32>()->default_value(10),
     "granullarity for histogram of continuous values"
   );
+  fl::ws::AddWorkSpaceOptions(&desc);
 
   boost::program_options::variables_map vm;
   boost::program_options::command_line_parser clp(args_);
@@ -90,10 +92,17 @@ void TableSummary<boost::mpl::void_>::Core<WorkSpaceType>::operator()(
     return;
   }
   std::vector<std::string> references=fl::ws::GetFileSequence("references", vm);
-  boost::shared_ptr<TableType> table;
   index_t n_attributes=0;
   ws_->GetTableInfo(references[0], NULL, &n_attributes, NULL, NULL);
   std::vector<double> means;
+  // the count, the mean and the sum of squared deviations of the 
+  // values every attribute visits, they are merged block by block
+  std::vector<index_t> counts;
+  std::vector<double> visited_means;
+  std::vector<double> visited_m2s;
+  std::vector<index_t> block_counts;
+  std::vector<double> block_means;
+  std::vector<double> block_m2s;
   std::vector<double> variances;
   std::set<double> zero_attributes;
   std::vector<double> minimums;
@@ -103,6 +112,16 @@ void TableSummary<boost::mpl::void_>::Core<WorkSpaceType>::operator()(
   means.resize(n_attributes);
   std::fill(means.begin(), means.end(), 0.0);
  
+  counts.resize(n_attributes);
+  std::fill(counts.begin(), counts.end(), 0);
+  visited_means.resize(n_attributes);
+  std::fill(visited_means.begin(), visited_means.end(), 0.0);
+  visited_m2s.resize(n_attributes);
+  std::fill(visited_m2s.begin(), visited_m2s.end(), 0.0);
+  block_counts.resize(n_attributes);
+  block_means.resize(n_attributes);
+  block_m2s.resize(n_attributes);
+
   variances.resize(n_attributes);
   std::fill(variances.begin(), variances.end(), 0.0);
  
@@ -120,25 +139,60 @@ void TableSummary<boost::mpl::void_>::Core<WorkSpaceType>::operator()(
   std::unordered_map<int32, index_t> cont_label_statistics;
   //int32 cont_granularity=vm["cont_granularity"].as<int32>();
   index_t n_entries=0;
+  // everything is computed in a single pass, so that references 
+  // that do not fit in memory can be streamed
   for(auto reference : references) {
-    ws_->Attach(reference, &table);
+    boost::shared_ptr<fl::table::TableStream<TableType> > stream;
+    ws_->AttachStream(reference, &stream);
+    boost::shared_ptr<TableType> table;
     typename TableType::Point_t point;
     typename TableType::Point_t::iterator it;
-    n_entries+=table->n_entries();
-    for(index_t i=0; i<table->n_entries(); ++i) {
-      table->get(i, &point);
-      for(it=point.begin(); it!=point.end(); ++it) {
-        means[it.attribute()]+=static_cast<double>(it.value());
-        minimums[it.attribute()]=std::min(minimums[it.attribute()], static_cast<double>(it.value()));
-        maximums[it.attribute()]=std::max(maximums[it.attribute()], static_cast<double>(it.value()));
+    while (stream->NextBlock(&table)) {
+      n_entries+=table->n_entries();
+      std::fill(block_counts.begin(), block_counts.end(), 0);
+      std::fill(block_means.begin(), block_means.end(), 0.0);
+      std::fill(block_m2s.begin(), block_m2s.end(), 0.0);
+      for(index_t i=0; i<table->n_entries(); ++i) {
+        table->get(i, &point);
+        for(it=point.begin(); it!=point.end(); ++it) {
+          const index_t j=it.attribute();
+          const double value=static_cast<double>(it.value());
+          // Welford update, sums of squares cancel catastrophically 
+          // when the values have a large offset
+          block_counts[j]+=1;
+          const double delta=value-block_means[j];
+          block_means[j]+=delta/block_counts[j];
+          block_m2s[j]+=delta*(value-block_means[j]);
+          minimums[j]=std::min(minimums[j], value);
+          maximums[j]=std::max(maximums[j], value);
+        }
+      }
+      // Chan's merge of the block into the totals
+      for(index_t j=0; j<n_attributes; ++j) {
+        if (block_counts[j]==0) {
+          continue;
+        }
+        const double total=counts[j]+block_counts[j];
+        const double delta=block_means[j]-visited_means[j];
+        visited_means[j]+=delta*block_counts[j]/total;
+        visited_m2s[j]+=block_m2s[j]
+          +delta*delta*counts[j]*(block_counts[j]/total);
+        counts[j]+=block_counts[j];
       }
     }
+    table.reset();
+    stream.reset();
     ws_->Purge(reference);
     ws_->Detach(reference);
   }
   
   for(size_t i=0; i<n_attributes; ++i) {
-    means[i]/=n_entries;
+    means[i]=visited_means[i]*counts[i]/n_entries;
+    // this is the sum of (x-mean)^2 over the values visited by the point
+    // iterators, divided by the number of points. The values deviate 
+    // from the mean of all the points by the deviation of their own mean
+    const double offset=visited_means[i]-means[i];
+    variances[i]=(visited_m2s[i]+counts[i]*offset*offset)/n_entries;
  
     if ((minimums[i]==maximums[i])==0) {
       zero_attributes.insert(i);    
@@ -161,23 +215,6 @@ void TableSummary<boost::mpl::void_>::Core<WorkSpaceType>::operator()(
       +boost::lexical_cast<std::string>(maximums[i])+"]";
   }
   fl::logger->Message()<<"Bounds="<<bound_str;
-  for(auto reference : references) {
-    ws_->Attach(reference, &table);
-    typename TableType::Point_t point;
-    typename TableType::Point_t::iterator it;
-    for(index_t i=0; i<n_entries; ++i) {
-      table->get(i, &point);
-      for(it=point.begin(); it!=point.end(); ++it) {
-        variances[it.attribute()]+=
-          fl::math::Pow<double, 2, 1>(static_cast<double>(it.value())-means[it.attribute()]);
-      }
-    }
-    ws_->Purge(reference);
-    ws_->Detach(reference);
-  }
-  for(size_t i=0; i<variances.size(); ++i) {
-    variances[i]/=n_entries;
-  }
   std::string variance_str;
   for(auto i=0; i<variances.size(); ++i) {
     variance_str+=boost::lexical_cast<std::string>(i)+":"+boost::lexical_cast<std::string>(variances[i])+",";
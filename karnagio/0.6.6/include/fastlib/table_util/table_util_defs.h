@@ -28,6 +28,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "fastlib/base/logger.h"
 #include "fastlib/workspace/based_on_table_run.h"
 #include "fastlib/util/string_utils.h"
+#include "fastlib/workspace/arguments.h"
 
 namespace fl {namespace table {
 
@@ -116,6 +117,7 @@ void TableUtil<boost::mpl::void_>::Core<WorkSpaceType>::operator()(
              " resulting files will be N*{--perencentage}"
   );
 
+  fl::ws::AddWorkSpaceOptions(&desc);
   boost::program_options::variables_map vm;
   boost::program_options::command_line_parser clp(args_);
   clp.style(boost::program_options::command_line_style::default_style
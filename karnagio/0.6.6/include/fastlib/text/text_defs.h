@@ -298,7 +298,7 @@ namespace fl{ namespace txt {
       WorkSpaceType,
       &Main<WorkSpaceType> 
     > task(ws, args);
-    ws->schedule(task); 
+    ws->schedule(task, args);
   }
 
   void fl::txt::TextPreprocessor::ExportWordFrequencies(const std::string &filename, 
@@ -38,9 +38,12 @@ POSSIBILITY OF SUCH DAMAGE.
 #ifndef FL_LITE_FASTLIB_TREE_BOUNDS_H
 #define FL_LITE_FASTLIB_TREE_BOUNDS_H
 
+#include <cmath>
 #include <limits>
 #include <string>
 #include <vector>
+#include "boost/serialization/split_member.hpp"
+#include "boost/serialization/vector.hpp"
 #include "fastlib/dense/matrix.h"
 #include "fastlib/math/fl_math.h"
 #include "fastlib/math/gen_range.h"
@@ -52,6 +55,11 @@ namespace tree {
  *
  * Template parameter t_pow is the metric to use; use 2 for
  * Euclidean (L2).
+ *
+ * StoragePrecision can be narrower than the points, float boxes take
+ * half the memory of double ones. The boxes are then rounded outwards
+ * so that they still contain their points, and the distances are
+ * computed in CalcPrecision, so pruning on them stays correct.
  */
 template < typename StoragePrecision = double, typename CalcPrecision = double,
 int t_pow = 2 >
@@ -60,11 +68,33 @@ class GenHrectBound {
     typedef StoragePrecision Precision_t;
     typedef CalcPrecision CalcPrecision_t;
     static const int PREFERRED_POWER = t_pow;
+    /**
+     * The boxes are archived in CalcPrecision, so that an index saved
+     * with one storage precision can be loaded with another
+     */
     template<typename Archive>
-    void serialize(Archive &ar, const unsigned int version) {
-      ar & boost::serialization::make_nvp("bounds", bounds_);
+    void save(Archive &ar, const unsigned int version) const {
+      std::vector<GenRange<CalcPrecision> > bounds(bounds_.size());
+      for (size_t i = 0; i < bounds_.size(); i++) {
+        bounds[i].lo = bounds_[i].lo;
+        bounds[i].hi = bounds_[i].hi;
+      }
+      ar << boost::serialization::make_nvp("bounds", bounds);
+    }
+
+    template<typename Archive>
+    void load(Archive &ar, const unsigned int version) {
+      std::vector<GenRange<CalcPrecision> > bounds;
+      ar >> boost::serialization::make_nvp("bounds", bounds);
+      bounds_.resize(bounds.size());
+      for (size_t i = 0; i < bounds_.size(); i++) {
+        bounds_[i].lo = RoundDown_(bounds[i].lo);
+        bounds_[i].hi = RoundUp_(bounds[i].hi);
+      }
     }
 
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+
     template<typename StreamType>
     void Print(StreamType &stream, const std::string &delim) const {
       stream << "*RectBound*" << "\n";
@@ -86,6 +116,30 @@ class GenHrectBound {
     typedef std::vector<BoundsType> BoundsVector;
     BoundsVector bounds_;
 
+    /**
+     * The largest StoragePrecision that is not more than value
+     */
+    static StoragePrecision RoundDown_(CalcPrecision value) {
+      StoragePrecision rounded = static_cast<StoragePrecision>(value);
+      if (rounded > value) {
+        rounded = std::nextafter(rounded,
+                                 -std::numeric_limits<StoragePrecision>::max());
+      }
+      return rounded;
+    }
+
+    /**
+     * The smallest StoragePrecision that is not less than value
+     */
+    static StoragePrecision RoundUp_(CalcPrecision value) {
+      StoragePrecision rounded = static_cast<StoragePrecision>(value);
+      if (rounded < value) {
+        rounded = std::nextafter(rounded,
+                                 std::numeric_limits<StoragePrecision>::max());
+      }
+      return rounded;
+    }
+
   public:
 
     GenHrectBound() {
@@ -144,7 +198,8 @@ class GenHrectBound {
     CalcPrecision MaxDistanceWithinBound() const {
       CalcPrecision max_dist_within = 0;
       for (index_t i = 0; i < bounds_.size(); i++) {
-        max_dist_within += math::Pow<CalcPrecision, t_pow, 1>(bounds_[i].hi - bounds_[i].lo);
+        max_dist_within += math::Pow<CalcPrecision, t_pow, 1>(
+            static_cast<CalcPrecision>(bounds_[i].hi) - bounds_[i].lo);
       }
       return math::Pow<CalcPrecision, 1, t_pow>(max_dist_within);
     }
@@ -173,9 +228,9 @@ class GenHrectBound {
       DEBUG_SAME_SIZE(static_cast<index_t>(point.size()), bounds_.size());
       CalcPrecision sum = 0;
       for (index_t i = 0; i < bounds_.size(); i++) {
-        StoragePrecision v =  point[i];
-        StoragePrecision v1 = bounds_[i].lo - v;
-        StoragePrecision v2 = v - bounds_[i].hi;
+        CalcPrecision v =  point[i];
+        CalcPrecision v1 = bounds_[i].lo - v;
+        CalcPrecision v2 = v - bounds_[i].hi;
         v = (v1 + fabs(v1)) + (v2 + fabs(v2));
         sum += fl::math::Pow<CalcPrecision, t_pow, 1>(v); // v is non-negative
       }
@@ -197,8 +252,8 @@ class GenHrectBound {
       typename std::vector<GenRange<StoragePrecision> >::const_iterator a = bounds_.begin();
       typename std::vector<GenRange<StoragePrecision> >::const_iterator b = other.bounds_.begin();
       for (; a != bounds_.end(); ++a, ++b) {
-        CalcPrecision v1 = b->lo - a->hi;
-        CalcPrecision v2 = a->lo - b->hi;
+        CalcPrecision v1 = static_cast<CalcPrecision>(b->lo) - a->hi;
+        CalcPrecision v2 = static_cast<CalcPrecision>(a->lo) - b->hi;
         // We invoke the following:
         //   x + fabs(x) = max(x * 2, 0)
         //   (x * 2)^2 / 4 = x^2
@@ -223,8 +278,9 @@ class GenHrectBound {
       DEBUG_SAME_SIZE((index_t)point.size(), (index_t)bounds_.size());
 
       for (index_t d = 0; d < bounds_.size(); d++) {
-        CalcPrecision v = std::max(point[d] - bounds_[d].lo,
-                                   bounds_[d].hi - point[d]);
+        CalcPrecision v = std::max(
+            static_cast<CalcPrecision>(point[d]) - bounds_[d].lo,
+            static_cast<CalcPrecision>(bounds_[d].hi) - point[d]);
         sum += fl::math::Pow<CalcPrecision, t_pow, 1>(v); // v is non-negative
       }
 
@@ -240,8 +296,9 @@ class GenHrectBound {
       CalcPrecision sum = 0;
 
       for (index_t d = 0; d < bounds_.size(); d++) {
-        CalcPrecision v = std::max(point[d] - bounds_[d].lo,
-                                   bounds_[d].hi - point[d]);
+        CalcPrecision v = std::max(
+            static_cast<CalcPrecision>(point[d]) - bounds_[d].lo,
+            static_cast<CalcPrecision>(bounds_[d].hi) - point[d]);
         sum += fl::math::Pow<CalcPrecision, t_pow, 1>(v); // v is non-negative
       }
 
@@ -260,7 +317,8 @@ class GenHrectBound {
       typename std::vector<GenRange<StoragePrecision> >::const_iterator a = bounds_.begin();
       typename std::vector<GenRange<StoragePrecision> >::const_iterator b = other.bounds_.begin();
       for (; a != bounds_.end(); ++a, ++b) {
-        CalcPrecision v = std::max(b->hi - a->lo, a->hi - b->lo);
+        CalcPrecision v = std::max(static_cast<CalcPrecision>(b->hi) - a->lo,
+                                   static_cast<CalcPrecision>(a->hi) - b->lo);
 
         // v is non-negative
         sum += fl::math::PowAbs<CalcPrecision, t_pow, 1>(v);
@@ -281,11 +339,11 @@ class GenHrectBound {
 
       DEBUG_SAME_SIZE(bounds_.size(), other.bounds_.size());
 
-      typename std::vector<GenRange<CalcPrecision> >::const_iterator a = bounds_.begin();
-      typename std::vector<GenRange<CalcPrecision> >::const_iterator b = other.bounds_.begin();
+      typename std::vector<GenRange<StoragePrecision> >::const_iterator a = bounds_.begin();
+      typename std::vector<GenRange<StoragePrecision> >::const_iterator b = other.bounds_.begin();
       for (; a != bounds_.end(); ++a, ++b) {
-        CalcPrecision v1 = b->lo - a->hi;
-        CalcPrecision v2 = a->lo - b->hi;
+        CalcPrecision v1 = static_cast<CalcPrecision>(b->lo) - a->hi;
+        CalcPrecision v2 = static_cast<CalcPrecision>(a->lo) - b->hi;
         // We invoke the following:
         //   x + fabs(x) = max(x * 2, 0)
         //   (x * 2)^2 / 4 = x^2
@@ -372,8 +430,8 @@ class GenHrectBound {
       typename std::vector<GenRange<StoragePrecision> >::const_iterator a = bounds_.begin();
       typename std::vector<GenRange<StoragePrecision> >::const_iterator b = other.bounds_.begin();
       for (; a != bounds_.end(); ++a, ++b) {
-        CalcPrecision v1 = b->hi - a->hi;
-        CalcPrecision v2 = a->lo - b->lo;
+        CalcPrecision v1 = static_cast<CalcPrecision>(b->hi) - a->hi;
+        CalcPrecision v2 = static_cast<CalcPrecision>(a->lo) - b->lo;
         CalcPrecision v = std::max(v1, v2);
         v = (v + fabs(v)); /* truncate negatives to zero */
         sum += fl::math::Pow<CalcPrecision, t_pow, 1>(v); // v is non-negative
@@ -395,7 +453,7 @@ class GenHrectBound {
       typename std::vector<GenRange<StoragePrecision> >::const_iterator b = other.bounds_.begin();
       for (; a != bounds_.end(); ++a, ++b) {
         sum += fl::math::PowAbs<CalcPrecision, t_pow, 1>(
-                 a->hi + a->lo - b->hi - b->lo);
+                 static_cast<CalcPrecision>(a->hi) + a->lo - b->hi - b->lo);
       }
 
       return fl::math::Pow<CalcPrecision, 2, t_pow>(sum) / 4;
@@ -411,12 +469,28 @@ class GenHrectBound {
       DEBUG_SAME_SIZE(static_cast<index_t>(vector.length()), bounds_.size());
 
       for (index_t i = 0; i < bounds_.size(); i++) {
-        bounds_[i] |= vector[i];
+        const CalcPrecision value = vector[i];
+        if (value < bounds_[i].lo) {
+          bounds_[i].lo = RoundDown_(value);
+        }
+        if (value > bounds_[i].hi) {
+          bounds_[i].hi = RoundUp_(value);
+        }
       }
 
       return *this;
     }
 
+    /**
+     * Expands this region to include a point inserted in the tree.
+     * The metric is not needed, it is here so that all the bounds
+     * can be expanded the same way
+     */
+    template<typename MetricType, typename PointType>
+    void Expand(const MetricType &metric, const PointType &point) {
+      *this |= point;
+    }
+
     /**
      * Expands this region to encompass another bound.
      */
@@ -497,6 +571,15 @@ class BallBound {
       return MidDistance(metric, point) <= radius_;
     }
 
+    /**
+     * Grows the radius so that the ball contains a point inserted in
+     * the tree, the center does not move
+     */
+    template<typename MetricType, typename OtherPointType>
+    void Expand(const MetricType &metric, const OtherPointType &point) {
+      radius_ = std::max(radius_, MidDistance(metric, point));
+    }
+
     /**
      * Gets the center.
      *
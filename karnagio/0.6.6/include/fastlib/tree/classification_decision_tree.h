@@ -262,6 +262,7 @@ class ClassificationDecisionTree {
      *  @param node_level The output of the computed level.
      */
     static const bool is_binary = true;
+    static const bool splits_at_random = false;
     template<typename TableType, typename TreeType>
     static void ComputeLevel(TableType &table,
                              TreeType *node,
@@ -298,7 +299,7 @@ class ClassificationDecisionTree {
           const std::pair<int, std::string> &int_dimension_split_values,
           int best_dimension,
           const std::string &best_dimension_type,
-          std::deque<bool> *membership) {
+          std::vector<bool> *membership) {
 
           if (best_dimension_type == "float") {
             ((typename TreeType::Bound_t &)
@@ -378,7 +379,7 @@ class ClassificationDecisionTree {
         static bool Partition(ImpurityType &impurity,
                               TreeIteratorType &it,
                               TreeType *node,
-                              std::deque<bool> *membership) {
+                              std::vector<bool> *membership) {
 
           typedef typename TreeIteratorType::Point_t::CalcPrecision_t CalcPrecision_t;
 
@@ -120,7 +120,7 @@ class PartitionNumericDimension {
     template<typename TreeIteratorType, typename TreeType, typename T>
     PartitionNumericDimension(TreeIteratorType &it, TreeType *node,
                               const std::pair<int, T> &split_values,
-                              std::deque<bool> *membership) {
+                              std::vector<bool> *membership) {
 
       // Allocate the membership vector.
       membership->resize(it.count());
@@ -561,7 +561,7 @@ class PartitionNominalDimension {
     template<typename TreeIteratorType, typename TreeType>
     PartitionNominalDimension(TreeIteratorType &it, TreeType *node,
                               const std::pair<int, std::string> &split_values,
-                              std::deque<bool> *membership) {
+                              std::vector<bool> *membership) {
 
       // Allocate the membership vector.
       membership->resize(it.count());
@@ -22,188 +22,143 @@ STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
 IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 POSSIBILITY OF SUCH DAMAGE.
 */
+
 #ifndef FASTLIB_TREE_COVER_TREE_H
 #define FASTLIB_TREE_COVER_TREE_H
 
-#include "fastlib/fastlib.h"
-#include "spacetree.h"
-#include "bounds.h"
-
+#include <cmath>
+#include <limits>
+#include <string>
 #include <vector>
+#include "fastlib/base/base.h"
+#include "metric_tree.h"
 
 namespace fl {
 namespace tree {
-/** @brief The generic cover tree for L_p metric.
+/** @brief The cover tree for any metric. A node of radius R is covered
+ *         with balls of radius base^(s-1), where s is the smallest scale
+ *         with R <= base^s. The centers of the balls are at least that
+ *         far from each other, so on data of low intrinsic dimension
+ *         there are few of them, however many the dimensions are.
+ *         The tree is binarized so that the dual-tree traversals of
+ *         the ball-trees run on it unchanged. The balls of a cover set
+ *         are never cut, they are grouped around the two centers that
+ *         are furthest apart. The bounds are the balls of MetricTree.
  */
-template < typename StoragePrecision, typename CalcPrecision,
-typename Metric, int BaseNominator, int BaseDenominator >
-class CoverTree {
-
+class CoverTree : public MetricTree {
   public:
+    /**
+     * @brief The radius of the cover balls shrinks by that at every
+     *        scale
+     */
+    static const int base = 2;
+    /**
+     * @brief A cover set never gets more centers than that, the points
+     *        that no center covers after that go to the closest one
+     */
+    static const index_t max_centers = 8;
+
+    class SplitRule : public MetricTree::SplitRule {
+      public:
+        template < typename MetricType,
+        typename TreeIteratorType,
+        typename TreeType >
+        static bool Partition(MetricType &metric,
+                              TreeIteratorType &it,
+                              TreeType *node,
+                              std::vector<bool> *membership) {
+
+          typedef typename TreeIteratorType::Point_t Point_t;
+          typedef typename Point_t::CalcPrecision_t CalcPrecision_t;
+          // The first point of the node is the first center.
+          Point_t root;
+          it.get(0, &root);
+          CalcPrecision_t radius;
+          Point_t furthest;
+          FurthestPoint(metric, root, it, &radius, &furthest);
+          if (radius <= std::numeric_limits<CalcPrecision_t>::min()) {
+            return false;
+          }
+          CalcPrecision_t cover_radius = std::pow(CalcPrecision_t(base),
+              std::ceil(std::log(radius) / std::log(CalcPrecision_t(base)))
+              - 1);
+          // the rounding of the logarithm can give the scale of the node
+          if (cover_radius >= radius) {
+            cover_radius /= base;
+          }
 
-    typedef StoragePrecision StoragePrecision_t;
-
-    typedef StoragePrecision Precision_t;
-
-    typedef CalcPrecision CalcPrecision_t;
-
-    typedef Metric Metric_t;
-
-    static const bool is_binary = false;
-
-    static const bool store_level = true;
-
-    typedef fl::tree::DBallBound < StoragePrecision, CalcPrecision, Metric_t,
-    fl::la::GenMatrix<StoragePrecision, true> > Bound_t;
-
-    static const CalcPrecision_t base =
-      1.0*BaseNominator / BaseDenominator;
-
-  private:
-
-    static inline CalcPrecision_t inverse_log_base_() {
-      CalcPrecision_t inverse_log_base  = 1.0 / log(base);
-      return inverse_log_base;
-    }
-
-    static inline index_t scale_of_distance_(CalcPrecision_t distance) {
-      return (index_t) ceil(log(distance) * inverse_log_base_());
-    }
-
-  public:
-
-    template<typename TableType, typename TreeType>
-    static void ComputeLevel(TableType &table,
-                             const TreeType *node,
-                             const TreeType *node_parent,
-                             index_t *node_level) {
-      if (node_parent != NULL) {
-        index_t parent_level;
-        node_parent->level(&parent_level);
-        (*node_level) = std::min(parent_level - 1,
-                                 scale_of_distance_(table.get_node_bound(node).radius()));
-      }
-      else {
-        *node_level = scale_of_distance_(table.get_node_bound(node).radius());
-      }
-    }
-
-    class SplitRule {
-
-      private:
-        template<typename TreeIterator>
-        static void FurthestPoint_(
-          const fl::la::GenMatrix<StoragePrecision, true> &pivot,
-          TreeIterator &it,
-          CalcPrecision *furthest_distance,
-          fl::la::GenMatrix<StoragePrecision, true> *furthest_point) {
-
-          *furthest_distance = -1.0;
-
-          fl::la::GenMatrix<StoragePrecision, true> point;
-          it.Reset();
-          while (it.HasNext()) {
-            index_t point_id;
-            it.Next(&point, &point_id);
-            CalcPrecision distance_between_center_and_point =
-              Metric_t::Distance(pivot, point);
-
-            if ((*furthest_distance) < distance_between_center_and_point) {
-              *furthest_distance = distance_between_center_and_point;
-              furthest_point->Alias(point);
+          // Every point goes to the closest center, if none covers it
+          // it becomes a center itself.
+          std::vector<index_t> centers(1, 0);
+          std::vector<index_t> cover(it.count(), 0);
+          Point_t point;
+          Point_t center;
+          for (index_t i = 1; i < it.count(); ++i) {
+            it.get(i, &point);
+            CalcPrecision_t closest_distance =
+              std::numeric_limits<CalcPrecision_t>::max();
+            for (size_t c = 0; c < centers.size(); ++c) {
+              it.get(centers[c], &center);
+              // the order of the arguments is the one of FurthestPoint,
+              // it matters for the assymetric divergences
+              CalcPrecision_t distance = metric.Distance(point, center);
+              if (distance < closest_distance) {
+                closest_distance = distance;
+                cover[i] = c;
+              }
+            }
+            if (closest_distance > cover_radius
+                && static_cast<index_t>(centers.size()) < max_centers) {
+              cover[i] = centers.size();
+              centers.push_back(i);
             }
           }
-        }
-
-      public:
 
-        template<typename TreeIterator>
-        static void FindBoundFromMatrix(
-          TreeIterator &it,
-          Bound_t *bound) {
-
-          // Choose the first point in the list as the pivot.
-          fl::la::GenMatrix<StoragePrecision, true> first_vector;
-          it.Reset();
-          index_t point_id;
-          it.Next(&first_vector, &point_id);
-          bound->center().CopyValues(first_vector);
-
-          // Compute the furthest distance.
-          CalcPrecision furthest_distance;
-          fl::la::GenMatrix<StoragePrecision, true> furthest_point;
-          FurthestPoint_(bound->center(), it,
-                         &furthest_distance, &furthest_point);
-          bound->set_radius(furthest_distance);
-        }
-
-        template<typename TreeIterator, typename TreeType>
-        static bool Partition(
-          TreeIterator &it,
-          TreeType *node,
-          std::vector<bool> *membership) {
-
-          if (it.table().get_node_bound(node).radius() <
-              std::numeric_limits<typename TreeType::Precision_t>::max()) {
+          // only with distances that do not compare, like nans
+          if (centers.size() < 2) {
             return false;
           }
-
-          // Pick the first row in the list for the first child (for
-          // self-branch), and otherwise a random row as the pivot and
-          // swap it with the first point in the list.
-          fl::la::GenMatrix<StoragePrecision, true> random_row_vec;
-          it.RandomPick(&random_row_vec);
-          fl::la::GenMatrix<StoragePrecision, true> first_row_vec;
-          it.Reset();
-          index_t point_id;
-          it.Next(&first_row_vec, &point_id);
-
-          if (random_row_vec.ptr() != first_row_vec.ptr()) {
-            first_row_vec.SwapValues(&random_row_vec);
+          // The balls go to the side of the center that is closer, the
+          // first center or the one furthest from it.
+          Point_t right_pivot;
+          index_t right_center = 1;
+          CalcPrecision_t furthest_distance = -1;
+          for (size_t c = 1; c < centers.size(); ++c) {
+            it.get(centers[c], &center);
+            CalcPrecision_t distance = metric.Distance(center, root);
+            if (furthest_distance < distance) {
+              furthest_distance = distance;
+              right_center = c;
+            }
           }
+          it.get(centers[right_center], &right_pivot);
+          std::vector<bool> goes_left(centers.size());
+          for (size_t c = 0; c < centers.size(); ++c) {
+            it.get(centers[c], &center);
+            goes_left[c] = (metric.Distance(center, root)
+                            <= metric.Distance(center, right_pivot));
+          }
+          goes_left[0] = true;
+          goes_left[right_center] = false;
 
-          // Now, the first vector in the list should hold the pivot.
-          index_t node_level;
-
-          // I need to somehow change the Partition function definition to get
-          // the level of the node.
-
-          // node->level(&node_level);
-          CalcPrecision distance_limit = pow(base, node_level - 1);
-
-          // Initialize the membership variable.
           membership->resize(it.count());
-
-          // The distance limit is BASE^(parent scale - 1)
-          index_t true_count = 0;
-
-          fl::la::GenMatrix<StoragePrecision, true> point;
-          it.Reset();
-          for (index_t left = 0; left < it.count(); left++) {
-
-            DEBUG_ASSERT(it.HasNext());
-            // Make alias of the current point.
-            index_t point_id;
-            it.Next(&point, &point_id);
-            // Compute the distances from the two pivots.
-            CalcPrecision distance_from_pivot =
-              Metric_t::Distance(first_row_vec, point);
-
-            // Set the boolean vector indicating whether the point is
-            // closer to the left pivot than the right pivot.
-            (*membership)[left] = (distance_from_pivot <=
-                                   distance_limit);
-
-            if ((*membership)[left]) {
-              true_count++;
-            }
+          for (index_t i = 0; i < it.count(); ++i) {
+            (*membership)[i] = goes_left[cover[i]];
           }
           return true;
         }
     };
 };
 
-}; // tree namespace
-}; // fl namespace
+/** @brief The cover tree takes the ball-tree split rules too, an empty
+ *         split is the cover tree rule
+ */
+template<>
+struct SplitRuleSelector<CoverTree>
+  : public MetricTreeSplitRuleSelector<CoverTree> {
+};
+
+}    // tree namespace
+}    // fl namespace
 
 #endif
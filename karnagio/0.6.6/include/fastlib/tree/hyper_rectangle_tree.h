@@ -39,6 +39,7 @@ class HyperRectangleTree {
   public:
 
     static const bool is_binary = true;
+    static const bool splits_at_random = false;
 
     template<typename TableType, typename TreeType>
     static void ComputeLevel(TableType &table,
@@ -101,7 +102,7 @@ class HyperRectangleTree {
         static bool Partition(MetricType &metric,
                               TreeIteratorType &it,
                               TreeType *node,
-                              std::deque<bool> *membership) {
+                              std::vector<bool> *membership) {
 
           // We choose the widest dimension to be the splitting
           // dimension with the split value being the middle.
@@ -31,6 +31,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <vector>
 #include <deque>
 #include <algorithm>
+#include <string>
 #include "boost/type_traits/is_same.hpp"
 
 namespace fl {
@@ -50,6 +51,7 @@ class MidpointKdTree {
      *  @param node_level The output of the computed level.
      */
     static const bool is_binary = true;
+    static const bool splits_at_random = false;
     template<typename TableType, typename TreeType>
     static void ComputeLevel(TableType &table,
                              TreeType *node,
@@ -94,12 +96,11 @@ class MidpointKdTree {
         template < typename MetricType,
         typename TreeIteratorType,
         typename TreeType >
-        static bool Partition(MetricType &metric,
+        static bool FindSplit(MetricType &metric,
                               TreeIteratorType &it,
                               TreeType *node,
-                              std::deque<bool> *membership) {
+                              AxisSplit<typename TreeIteratorType::CalcPrecision_t> *split) {
 
-          typedef typename TreeIteratorType::Point_t Point_t;
           index_t split_dim = std::numeric_limits<index_t>::max();
           typedef typename TreeIteratorType::CalcPrecision_t CalcPrecision_t;
           CalcPrecision_t max_width = 0;
@@ -121,21 +122,12 @@ class MidpointKdTree {
 
           GenRange<CalcPrecision_t> split_dim_range =
             it.table().get_node_bound(node).get(split_dim);
-          CalcPrecision_t split_value = split_dim_range.mid();
-
-          membership->resize(it.count());
-          bool has_members[2] = {false,false};
-	  //#pragma omp parallel for		
-	  //shared(membership)
-          for (index_t i = 0; i < it.count(); i++) {
-            Point_t point;
-            it.get(i, &point);
-            (*membership)[i] = (point[split_dim] < split_value);
-            has_members[(point[split_dim] < split_value)] = true;
-          }
-
-          // "Fail to split, a dimension may still."
-          return has_members[0] && has_members[1];
+          split->dimension = split_dim;
+          split->value = split_dim_range.mid();
+          split->inclusive = false;
+          // "Fail to split, a dimension may still." if the partition
+          // leaves a side empty
+          return true;
         }
     };
 };
@@ -146,6 +138,7 @@ class MidpointKdTree {
 class MedianKdTree {
   public:
     static const bool is_binary = true;
+    static const bool splits_at_random = false;
     template<typename TableType, typename TreeType>
     static void ComputeLevel(TableType &table,
                              TreeType *node,
@@ -241,13 +234,12 @@ class MedianKdTree {
         template < typename MetricType,
         typename TreeIteratorType,
         typename TreeType >
-        static bool Partition(MetricType &metric,
+        static bool FindSplit(MetricType &metric,
                               TreeIteratorType &it,
                               TreeType *node,
-                              std::deque<bool> *membership) {
+                              AxisSplit<typename TreeIteratorType::CalcPrecision_t> *split) {
 
-          typedef typename TreeIteratorType::Point_t Point_t;
-          typedef typename Point_t::CalcPrecision_t CalcPrecision_t;
+          typedef typename TreeIteratorType::CalcPrecision_t CalcPrecision_t;
           index_t split_dim = std::numeric_limits<index_t>::max();
           CalcPrecision_t max_width = 0;
 
@@ -273,21 +265,239 @@ class MedianKdTree {
             // "Still fails to split node, split_val does."
             return false;
           }
+          split->dimension = split_dim;
+          split->value = split_value;
+          split->inclusive = false;
+          return true;
+        }
+    };
+};
+
+/** @brief The sliding midpoint split KD-tree. It splits the widest
+ *         dimension at the midpoint like MidpointKdTree. When the
+ *         midpoint leaves less than a tenth of the points on one side
+ *         the split slides towards the data until that side gets a
+ *         tenth of them, so that skewed or clustered data does not
+ *         build deep trees of thin nodes.
+ */
+class SlidingMidpointKdTree : public MidpointKdTree {
+  public:
+    // each side of a split gets at least 1/min_fraction of the points
+    static const index_t min_fraction = 10;
+
+    class SplitRule : public MidpointKdTree::SplitRule {
+      public:
+        template < typename MetricType,
+        typename TreeIteratorType,
+        typename TreeType >
+        static bool FindSplit(MetricType &metric,
+                              TreeIteratorType &it,
+                              TreeType *node,
+                              AxisSplit<typename TreeIteratorType::CalcPrecision_t> *split) {
 
-          membership->resize(it.count());
-	  //#pragma omp parallel for		
-	  //shared(membership)			
-	  //firstprivate(split_dim)		
-	  //firstprivate(split_value)
+          typedef typename TreeIteratorType::Point_t Point_t;
+          typedef typename TreeIteratorType::CalcPrecision_t CalcPrecision_t;
+          index_t split_dim = std::numeric_limits<index_t>::max();
+          CalcPrecision_t max_width = 0;
+
+          for (index_t d = 0; d < it.table().n_attributes(); d++) {
+            const CalcPrecision_t w =
+              it.table().get_node_bound(node).get(d).width();
+
+            if (unlikely(w > max_width)) {
+              max_width = w;
+              split_dim = d;
+            }
+          }
+          if (max_width == 0) {
+            return false;
+          }
+
+          CalcPrecision_t split_value =
+            it.table().get_node_bound(node).get(split_dim).mid();
+          std::vector<CalcPrecision_t> values(it.count());
+          index_t left_count = 0;
           for (index_t i = 0; i < it.count(); i++) {
             Point_t point;
             it.get(i, &point);
-            (*membership)[i] = (point[split_dim] < split_value);
+            values[i] = point[split_dim];
+            left_count += (values[i] < split_value);
           }
+          index_t min_count = std::max(index_t(1),
+                                       it.count() / min_fraction);
+          // the points that go left are the ones below the split, if the
+          // split slides on a value that repeats it takes them all
+          bool inclusive = false;
+          if (left_count < min_count
+              || it.count() - left_count < min_count) {
+            index_t k = (left_count < min_count) ? min_count
+                        : it.count() - min_count;
+            std::vector<CalcPrecision_t> sorted(values);
+            std::nth_element(sorted.begin(), sorted.begin() + k,
+                             sorted.end());
+            split_value = sorted[k];
+            inclusive = (split_value == *std::min_element(sorted.begin(),
+                         sorted.begin() + k + 1));
+          }
+
+          split->dimension = split_dim;
+          split->value = split_value;
+          split->inclusive = inclusive;
           return true;
         }
     };
 };
+
+/** @brief The maximum variance split KD-tree. It splits the dimension
+ *         with the largest variance at its median. Both are estimated
+ *         on a sample of the points of the node, so a split costs a
+ *         single pass over the node. If the sample does not split the
+ *         node it falls back to the midpoint split.
+ */
+class VarianceKdTree : public MidpointKdTree {
+  public:
+    static const index_t sample_size = 128;
+
+    class SplitRule : public MidpointKdTree::SplitRule {
+      public:
+        template < typename MetricType,
+        typename TreeIteratorType,
+        typename TreeType >
+        static bool FindSplit(MetricType &metric,
+                              TreeIteratorType &it,
+                              TreeType *node,
+                              AxisSplit<typename TreeIteratorType::CalcPrecision_t> *split) {
+
+          typedef typename TreeIteratorType::Point_t Point_t;
+          typedef typename TreeIteratorType::CalcPrecision_t CalcPrecision_t;
+          const index_t n_attributes = it.table().n_attributes();
+          const index_t stride = std::max(index_t(1),
+                                          it.count() / sample_size);
+          std::vector<CalcPrecision_t> sums(n_attributes, 0);
+          std::vector<CalcPrecision_t> sums_of_squares(n_attributes, 0);
+          index_t n_samples = 0;
+          for (index_t i = 0; i < it.count(); i += stride) {
+            Point_t point;
+            it.get(i, &point);
+            for (index_t d = 0; d < n_attributes; d++) {
+              const CalcPrecision_t value = point[d];
+              sums[d] += value;
+              sums_of_squares[d] += value * value;
+            }
+            n_samples++;
+          }
+          index_t split_dim = std::numeric_limits<index_t>::max();
+          CalcPrecision_t max_variance = 0;
+          for (index_t d = 0; d < n_attributes; d++) {
+            const CalcPrecision_t mean = sums[d] / n_samples;
+            const CalcPrecision_t variance =
+              sums_of_squares[d] / n_samples - mean * mean;
+            if (unlikely(variance > max_variance)) {
+              max_variance = variance;
+              split_dim = d;
+            }
+          }
+          if (max_variance <= 0) {
+            return MidpointKdTree::SplitRule::FindSplit(metric, it, node,
+                   split);
+          }
+
+          std::vector<CalcPrecision_t> samples;
+          samples.reserve(n_samples);
+          for (index_t i = 0; i < it.count(); i += stride) {
+            Point_t point;
+            it.get(i, &point);
+            samples.push_back(point[split_dim]);
+          }
+          std::nth_element(samples.begin(),
+                           samples.begin() + samples.size() / 2,
+                           samples.end());
+          const CalcPrecision_t split_value = samples[samples.size() / 2];
+
+          // the median is a point of the node, so the right side is never
+          // empty and the left one is not if a point is below it
+          for (index_t i = 0; i < it.count(); i++) {
+            Point_t point;
+            it.get(i, &point);
+            if (point[split_dim] < split_value) {
+              split->dimension = split_dim;
+              split->value = split_value;
+              split->inclusive = false;
+              return true;
+            }
+          }
+          return MidpointKdTree::SplitRule::FindSplit(metric, it, node,
+                 split);
+        }
+    };
+};
+
+/** @brief The split rules of the kd-trees, they all share the bounds
+ *         of MidpointKdTree. An empty split is the rule of the tree spec
+ */
+template<typename TreeSpecType>
+struct KdTreeSplitRuleSelector {
+  typedef boost::mpl::true_ SplitsOnAxis;
+
+  static void Check(const std::string &split) {
+    if (!split.empty() && split != "midpoint" && split != "sliding_midpoint"
+        && split != "median" && split != "variance") {
+      fl::logger->Die() << "Unknown kd-tree split rule (" << split
+        << "), it must be one of midpoint, sliding_midpoint, median, variance";
+    }
+  }
+
+  template<typename MetricType, typename TreeIteratorType, typename TreeType>
+  static bool FindSplit(const std::string &split,
+                        MetricType &metric,
+                        TreeIteratorType &it,
+                        TreeType *node,
+                        AxisSplit<typename TreeIteratorType::CalcPrecision_t> *axis_split) {
+    if (split.empty()) {
+      return TreeSpecType::SplitRule::FindSplit(metric, it, node,
+             axis_split);
+    }
+    if (split == "midpoint") {
+      return MidpointKdTree::SplitRule::FindSplit(metric, it, node,
+             axis_split);
+    }
+    if (split == "sliding_midpoint") {
+      return SlidingMidpointKdTree::SplitRule::FindSplit(metric, it, node,
+             axis_split);
+    }
+    if (split == "median") {
+      return MedianKdTree::SplitRule::FindSplit(metric, it, node,
+             axis_split);
+    }
+    if (split == "variance") {
+      return VarianceKdTree::SplitRule::FindSplit(metric, it, node,
+             axis_split);
+    }
+    Check(split);
+    return false;
+  }
+};
+
+template<>
+struct SplitRuleSelector<MidpointKdTree>
+  : public KdTreeSplitRuleSelector<MidpointKdTree> {
+};
+
+template<>
+struct SplitRuleSelector<MedianKdTree>
+  : public KdTreeSplitRuleSelector<MedianKdTree> {
+};
+
+template<>
+struct SplitRuleSelector<SlidingMidpointKdTree>
+  : public KdTreeSplitRuleSelector<SlidingMidpointKdTree> {
+};
+
+template<>
+struct SplitRuleSelector<VarianceKdTree>
+  : public KdTreeSplitRuleSelector<VarianceKdTree> {
+};
+
 } // tree namespace
 } // fl namespace
 
@@ -69,6 +69,7 @@ class RegressionnDecisionTree {
      *  @param node_level The output of the computed level.
      */
     static const bool is_binary = true;
+    static const bool splits_at_random = false;
     template<typename TableType, typename TreeType>
     static void ComputeLevel(TableType &table,
                              TreeType *node,
@@ -119,7 +120,7 @@ class RegressionnDecisionTree {
         static bool Partition(MetricType &metric,
                               TreeIteratorType &it,
                               TreeType *node,
-                              std::deque<bool> *membership) {
+                              std::vector<bool> *membership) {
 
           // we need to do this check in case we have garbage
           CalcPrecision_t max_width = std::numeric_limit<CalcPrecision_t>::min();
@@ -135,6 +135,7 @@ class SimilarityTree {
   public:
 
     static const bool is_binary = true;
+    static const bool splits_at_random = true;
 
     template<typename TableType, typename TreeType>
     static void ComputeLevel(TableType &table,
@@ -229,7 +230,7 @@ class SimilarityTree {
         static bool Partition(MetricType &metric,
                               TreeIteratorType &it,
                               TreeType *node,
-                              std::deque<bool> *membership) {
+                              std::vector<bool> *membership) {
 
           typedef typename TreeIteratorType::Point_t Point_t;
           typedef typename Point_t::CalcPrecision_t CalcPrecision_t;
@@ -28,7 +28,9 @@ POSSIBILITY OF SUCH DAMAGE.
 //#include <omp.h>
 #include <limits>
 #include <deque>
+#include <vector>
 #include <iostream>
+#include <string>
 #include "fastlib/base/base.h"
 #include "abstract_statistic.h"
 #include "fastlib/metric_kernel/lmetric.h"
@@ -39,6 +41,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "boost/mpl/assert.hpp"
 #include "boost/type_traits.hpp"
 #include "boost/serialization/nvp.hpp"
+#include "boost/thread/thread.hpp"
+#include "boost/bind.hpp"
 
 
 namespace fl {
@@ -58,7 +62,57 @@ class TreeArgs {
     typedef boost::mpl::bool_<true> SortPoints;
     typedef boost::mpl::bool_<true> StoreLevel;
     typedef boost::mpl::void_ BoundType;
+    // the nodes of the tree are allocated from a NodeArena in 
+    // depth first order instead of one by one on the heap
+    typedef boost::mpl::bool_<true> ArenaNodes;
 };
+
+/**
+ * @brief A split on one dimension. The points whose value on dimension
+ *        is less than value go left, or not more than value if inclusive
+ */
+template<typename PrecisionType>
+struct AxisSplit {
+  index_t dimension;
+  PrecisionType value;
+  bool inclusive;
+
+  template<typename PointType>
+  bool GoesLeft(const PointType &point) const {
+    return inclusive ? point[dimension] <= value : point[dimension] < value;
+  }
+};
+
+/**
+ * @brief Picks the split rule of a tree at run time, from the split
+ *        member of the IndexArgs. A tree spec that has only one split
+ *        rule accepts only an empty split. The kd-trees and the ball tree
+ *        specialize it in kdtree.h and metric_tree.h. A selector whose
+ *        rules all split on one dimension has SplitsOnAxis true and a
+ *        FindSplit instead of Partition, the points are then partitioned
+ *        in place without a membership vector
+ */
+template<typename TreeSpecType>
+struct SplitRuleSelector {
+  typedef boost::mpl::false_ SplitsOnAxis;
+
+  static void Check(const std::string &split) {
+    if (!split.empty()) {
+      fl::logger->Die() << "This tree does not support the split rule ("
+        << split << ")";
+    }
+  }
+
+  template<typename MetricType, typename TreeIteratorType, typename TreeType>
+  static bool Partition(const std::string &split,
+                        MetricType &metric,
+                        TreeIteratorType &it,
+                        TreeType *node,
+                        std::vector<bool> *membership) {
+    return TreeSpecType::SplitRule::Partition(metric, it, node, membership);
+  }
+};
+
 /**
  *  @brief class Tree provides the core datastructure for building trees
  *         It is strongly connected with class Table, since it provides
@@ -79,8 +133,17 @@ class Tree  {
 
     static const bool store_level = TreeMap_t::StoreLevel::value;
 
+    static const bool arena_nodes = TreeMap_t::ArenaNodes::value;
+
     static const bool IsBinary = TreeSpec_t::is_binary;
 
+    /**
+     * @brief nodes with fewer points than that are split by the thread
+     *        that split their parent, smaller subtrees are not worth
+     *        the cost of a thread
+     */
+    static const index_t parallel_split_size = 1<<14;
+
     typedef class fl::table::Table<TemplateMap> Table_t;
 
     typedef typename Table_t::Point_t Point_t;
@@ -91,12 +154,13 @@ class Tree  {
 
     friend class fl::table::Table<TemplateMap>;
     friend class fl_private::LeftRightAccessors<IsBinary>;
+    friend class fl_private::NodeArena<Tree_t>;
     //friend class fl_private::ComputeStatisticHelper<IsBinary>;
     template<typename MetricType, typename TreeIteratorType, typename TreeType>
     friend bool Partition(MetricType &metric,
                           TreeIteratorType &it,
                           TreeType *node,
-                          std::deque<bool> *membership);
+                          std::vector<bool> *membership);
     /**
      * @brief A simple constructor
      */
@@ -106,20 +170,32 @@ class Tree  {
      */
     ~Tree();
     /** @brief Build the tree given a table and the limit on the
-     *         leaf size.
+     *         leaf size. If args.n_threads is more than one, sibling
+     *         subtrees are built concurrently. The node ids and the
+     *         order of the points are the same as in a serial build
      */
     template<int mode, typename IndexArgsType>
     static Tree_t *BuildTree(Table_t &table,
                              IndexArgsType &args,
                              index_t *num_of_nodes);
 
-    template<typename MetricType>
-    static inline index_t MatrixPartition(MetricType &metric,
-                                          Table_t &table,
+    /**
+     * @brief moves the points of [first, first+count) whose membership
+     *        is true before the others and returns where the others start
+     */
+    static inline index_t MatrixPartition(Table_t &table,
                                           index_t first,
                                           index_t count,
-                                          Tree_t *new_node,
-                                          std::deque<bool> &left_membership);
+                                          std::vector<bool> &left_membership);
+    /**
+     * @brief the same as MatrixPartition, the side of a point comes from
+     *        split when it is visited
+     */
+    template<typename PrecisionType>
+    static inline index_t AxisPartition(Table_t &table,
+                                        index_t first,
+                                        index_t count,
+                                        const AxisSplit<PrecisionType> &split);
 
     /**
      *  @brief SplitTree splits the nodes of the tree.
@@ -149,6 +225,11 @@ class Tree  {
      *  @brief prints the current level
      */
     inline void PrintLevel(const Tree_t *root_node) const;
+    /**
+     * @brief true if the node was allocated by a NodeArena, it is
+     *        destroyed with the arena of the root
+     */
+    inline bool in_arena() const;
 
     /**
      *  @brief serializes a tree
@@ -158,11 +239,76 @@ class Tree  {
                    const unsigned int version);
 
   private:
+    /**
+     * @brief SplitTree_ does the work for SplitTree. When n_threads
+     *        is more than one the children of a big node are split
+     *        after all of them have been partitioned, each one on 
+     *        its own share of the threads. Their node ids are then
+     *        meaningless until NumberNodes_ is called
+     */
+    template<int mode, typename IndexArgsType>
+    static void SplitTree_(IndexArgsType &args,
+                           Table_t &table,
+                           Tree_t *node,
+                           index_t level,
+                           index_t *node_counter,
+                           int n_threads,
+                           fl_private::NodeArena<Tree_t> *arena,
+                           std::vector<bool> *membership);
+    /**
+     * @brief splits the points of [first, first+count) of node with the
+     *        split rule of the tree and puts the ones of the left side
+     *        first. It returns false if the rule cannot split them, else
+     *        left_count gets the number of points on the left side
+     */
+    template<typename IndexArgsType>
+    static bool Cut_(IndexArgsType &args,
+                     Table_t &table,
+                     Tree_t *node,
+                     index_t first,
+                     index_t count,
+                     std::vector<bool> *membership,
+                     index_t *left_count,
+                     boost::mpl::false_);
+    template<typename IndexArgsType>
+    static bool Cut_(IndexArgsType &args,
+                     Table_t &table,
+                     Tree_t *node,
+                     index_t first,
+                     index_t count,
+                     std::vector<bool> *membership,
+                     index_t *left_count,
+                     boost::mpl::true_);
+    static inline void SwapPoints_(Table_t &table, index_t i, index_t j);
+    /**
+     * @brief allocates a node from the arena, or from the heap if 
+     *        arena is NULL
+     */
+    static Tree_t *NewNode_(fl_private::NodeArena<Tree_t> *arena);
+    /**
+     * @brief a guess of the number of nodes under a node of count points,
+     *        it is the size of the first block of its arena
+     */
+    template<int mode, typename IndexArgsType>
+    static index_t ExpectedNodes_(IndexArgsType &args, index_t count);
+    /**
+     * @brief gives node ids in the order of a depth first traversal,
+     *        that is the order in which the serial SplitTree gives them
+     */
+    static void NumberNodes_(Tree_t *node, index_t *node_counter);
     /**
      * @brief In some trees it is necessary to store the level
      *
      */
     fl_private::StoreLevelTrait<store_level> store_level_;
+    /**
+     * @brief the root owns the arena where the rest of the nodes live
+     */
+    fl_private::NodeArena<Tree_t> *arena_;
+    /**
+     * @brief true if the node lives in an arena
+     */
+    bool in_arena_;
     /**
      * @brief Every node must have a bounding box, also known as Bound_t
      */
@@ -213,6 +359,13 @@ class Tree  {
     inline void Init(index_t begin_in, index_t count_in, index_t node_id);
 
     inline void Init(index_t begin_in, index_t count_in);
+    /**
+     * @brief detaches the subtree under the node so that the node can be
+     *        split again. The nodes on the heap are deleted, the ones
+     *        in the arena are given back to arena, which must be the 
+     *        arena of the root
+     */
+    inline void ReleaseChildren(fl_private::NodeArena<Tree_t> *arena);
 
     /** @brief Find a node in this tree by its begin and count.
      *
@@ -295,6 +448,8 @@ template<typename TemplateMap>
 Tree<TemplateMap>::Tree() {
   // stat_ = NULL;
   node_id_=-1;
+  arena_=NULL;
+  in_arena_=false;
 }
 /**
  * @brief deleted recursively the node and the corresponding subtree
@@ -306,6 +461,7 @@ Tree<TemplateMap>::~Tree() {
   if (!is_leaf()) {
     fl_private::ChildTrait<IsBinary, Tree_t>::Destruct(children_);
   }
+  delete arena_;
 }
 
 /** @brief Build the tree given a table and the limit on
@@ -320,16 +476,13 @@ typename Tree<TemplateMap>::Tree_t *Tree<TemplateMap>::BuildTree(
   typename Tree<TemplateMap>::Table_t &table,
   IndexArgsType &args,
   index_t *num_of_nodes) {
+  SplitRuleSelector<TreeSpec_t>::Check(args.split);
   index_t node_counter=*num_of_nodes;
-  Tree_t *node=NULL;
-  try {
-    node = new Tree_t();
-  } 
-  catch(const std::bad_alloc &e) {
-    fl::logger->Die() << "Problems while allocating memory in tree building. "
-      << "It might be that your dataset is too big to fit in RAM or "
-      << "you are using a 32bit platform which limits the process address space "
-      << "to 4GB";
+  // the table deletes the root, the rest of the nodes go to its arena
+  Tree_t *node=NewNode_(NULL);
+  if (arena_nodes) {
+    node->arena_=new fl_private::NodeArena<Tree_t>(
+        ExpectedNodes_<mode>(args, table.n_entries()));
   }
   DEBUG_ASSERT(node_counter>=0);
   node->Init(0, table.n_entries(), node_counter);
@@ -354,19 +507,31 @@ typename Tree<TemplateMap>::Tree_t *Tree<TemplateMap>::BuildTree(
   node->set_level(initial_level);
   // Starting splitting.
   node_counter++;
-  Tree_t::template SplitTree<mode>(args, table, node, initial_level, &node_counter);
+  int n_threads=args.n_threads;
+  if (n_threads>1 && TreeSpec_t::splits_at_random) {
+    // the splits would race for the random number generator and 
+    // the tree would depend on the thread timing
+    fl::logger->Warning()<<"This tree picks random points to split, "
+      <<"it will be built with one thread";
+    n_threads=1;
+  }
+  std::vector<bool> membership;
+  Tree_t::template SplitTree_<mode>(args, table, node, initial_level, 
+      &node_counter, n_threads, node->arena_, &membership);
+  if (n_threads>1) {
+    node_counter=*num_of_nodes;
+    NumberNodes_(node, &node_counter);
+  }
   *num_of_nodes=node_counter;
   return node;
 }
 
 template<typename TemplateMap>
-template<typename MetricType>
-index_t Tree<TemplateMap>::MatrixPartition(MetricType &metric,
+index_t Tree<TemplateMap>::MatrixPartition(
     typename Tree<TemplateMap>::Table_t &table,
     index_t first,
     index_t count,
-    Tree_t *new_node,
-    std::deque<bool> &left_membership) {
+    std::vector<bool> &left_membership) {
 
   index_t left = first;
   index_t right = first + count - 1;
@@ -386,39 +551,114 @@ index_t Tree<TemplateMap>::MatrixPartition(MetricType &metric,
       // left == right + 1
       break;
     }
-
-    // Swap the left vector with the right vector.
-    if (sort_points) {
-      Point_t left_point, right_point;
-      table.direct_get_(left, &left_point);
-      table.direct_get_(right, &right_point);
-      left_point.SwapValues(&right_point);
-    }
-
-    // Swap the membership boolean vectors and the old from new
-    // vectors.
+    SwapPoints_(table, left, right);
+    // Swap the membership boolean vectors
     bool t = left_membership[left - first];
     left_membership[left - first] = left_membership[right - first];
     left_membership[right - first] = t;
-    std::swap(table.shuffled_to_real_[left],
-              table.shuffled_to_real_[right]);
-    table.real_to_shuffled_[table.shuffled_to_real_[left]] = left;
-    table.real_to_shuffled_[table.shuffled_to_real_[right]] = right;
     DEBUG_ASSERT(left <= right);
     right--;
   }
 
-
   DEBUG_ASSERT(left == right + 1);
+  return left;
+}
 
-  // Create the new node and find its bound.
-  new_node->Init(first, left - first);
-  typename Table_t::TreeIterator it = table.get_node_iterator(new_node);
-  TreeSpec_t::SplitRule::FindBoundFromMatrix(metric,
-      it, &(new_node->bound()));
+template<typename TemplateMap>
+template<typename PrecisionType>
+index_t Tree<TemplateMap>::AxisPartition(
+    typename Tree<TemplateMap>::Table_t &table,
+    index_t first,
+    index_t count,
+    const AxisSplit<PrecisionType> &split) {
+
+  index_t left = first;
+  index_t right = first + count - 1;
+  Point_t point;
+  // the same swaps as MatrixPartition with the membership of the split,
+  // so both build the same tree
+  for (;;) {
+    while (likely(left <= right)) {
+      table.direct_get_(left, &point);
+      if (!split.GoesLeft(point)) {
+        break;
+      }
+      left++;
+    }
+    while (likely(left <= right)) {
+      table.direct_get_(right, &point);
+      if (split.GoesLeft(point)) {
+        break;
+      }
+      right--;
+    }
+    if (unlikely(left > right)) {
+      break;
+    }
+    SwapPoints_(table, left, right);
+    DEBUG_ASSERT(left <= right);
+    right--;
+  }
+
+  DEBUG_ASSERT(left == right + 1);
   return left;
 }
 
+template<typename TemplateMap>
+void Tree<TemplateMap>::SwapPoints_(
+    typename Tree<TemplateMap>::Table_t &table, index_t i, index_t j) {
+  if (sort_points) {
+    Point_t point_i, point_j;
+    table.direct_get_(i, &point_i);
+    table.direct_get_(j, &point_j);
+    point_i.SwapValues(&point_j);
+  }
+  std::swap(table.shuffled_to_real_[i], table.shuffled_to_real_[j]);
+  table.real_to_shuffled_[table.shuffled_to_real_[i]] = i;
+  table.real_to_shuffled_[table.shuffled_to_real_[j]] = j;
+}
+
+template<typename TemplateMap>
+template<typename IndexArgsType>
+bool Tree<TemplateMap>::Cut_(IndexArgsType &args,
+    typename Tree<TemplateMap>::Table_t &table,
+    Tree_t *node,
+    index_t first,
+    index_t count,
+    std::vector<bool> *membership,
+    index_t *left_count,
+    boost::mpl::false_) {
+  typename Table_t::TreeIterator it = table.get_node_iterator(first, count);
+  if (!SplitRuleSelector<TreeSpec_t>::Partition(args.split,
+        args.metric, it, node, membership)) {
+    return false;
+  }
+  *left_count = MatrixPartition(table, first, count, *membership) - first;
+  return true;
+}
+
+template<typename TemplateMap>
+template<typename IndexArgsType>
+bool Tree<TemplateMap>::Cut_(IndexArgsType &args,
+    typename Tree<TemplateMap>::Table_t &table,
+    Tree_t *node,
+    index_t first,
+    index_t count,
+    std::vector<bool> *membership,
+    index_t *left_count,
+    boost::mpl::true_) {
+  typedef typename Table_t::TreeIterator TreeIterator_t;
+  typename Table_t::TreeIterator it = table.get_node_iterator(first, count);
+  AxisSplit<typename TreeIterator_t::CalcPrecision_t> split;
+  if (!SplitRuleSelector<TreeSpec_t>::FindSplit(args.split,
+        args.metric, it, node, &split)) {
+    return false;
+  }
+  // a side that ends up empty leaves the points where they were
+  *left_count = AxisPartition(table, first, count, split) - first;
+  return *left_count > 0 && *left_count < count;
+}
+
 template<typename TemplateMap>
 template<int mode, typename IndexArgsType>
 void Tree<TemplateMap>::SplitTree(IndexArgsType &args,
@@ -426,7 +666,26 @@ void Tree<TemplateMap>::SplitTree(IndexArgsType &args,
                                   Tree_t *node,
                                   index_t level,
                                   index_t *node_counter) {
+  std::vector<bool> membership;
+  SplitTree_<mode>(args, table, node, level, node_counter, 1, NULL, 
+      &membership);
+}
 
+template<typename TemplateMap>
+template<int mode, typename IndexArgsType>
+void Tree<TemplateMap>::SplitTree_(IndexArgsType &args,
+                                   typename Tree<TemplateMap>::Table_t &table,
+                                   Tree_t *node,
+                                   index_t level,
+                                   index_t *node_counter,
+                                   int n_threads,
+                                   fl_private::NodeArena<Tree_t> *arena,
+                                   std::vector<bool> *membership) {
+  // the children of a node cover disjoint ranges of the table, once
+  // they are partitioned they can be split independently
+  bool split_in_parallel = n_threads > 1 
+    && node->count() >= parallel_split_size;
+  std::vector<std::pair<Tree_t*, index_t> > pending;
   if ((mode == 0 && node->count() > args.leaf_size)
       || (mode == 1 && level < args.level)
       || (mode == 2 && node->bound().MaxDistanceWithinBound() > args.diameter)) {
@@ -439,37 +698,27 @@ void Tree<TemplateMap>::SplitTree(IndexArgsType &args,
     while (num_child_created < child_limit
            && ((mode == 0 && remaining_count > args.leaf_size)
                || ((mode == 1 || mode == 2) && remaining_count > 0))) {
-      std::deque<bool> membership;
-      // Create an iterator that starts from the beginning of
-      // the remaining set of points.
-      typename Table_t::TreeIterator it =
-        table.get_node_iterator(starting_index, remaining_count);
-      bool can_cut = TreeSpec_t::SplitRule::Partition(args.metric,
-                     it, node, &membership);
+      // Reorder the matrix so that the points under the new node
+      // are sequentially ordered in DFS from left to right.
+      index_t left_count = 0;
+      bool can_cut = Cut_(args, table, node, starting_index,
+                          remaining_count, membership, &left_count,
+                          typename SplitRuleSelector<TreeSpec_t>::SplitsOnAxis());
       if (!can_cut) {
         break;
       }
       // Create the new child and add to the child list of the
       // current node and increment the child number.
 
-      Tree_t *new_child =NULL;
-      try { 
-        new_child=new Tree_t();
-      }
-      catch(const std::bad_alloc &e) {
-        fl::logger->Die() << "Problems while allocating memory in tree building. "
-          << "It might be that your dataset is too big to fit in RAM or "
-          << "you are using a 32bit platform which limits the process address space "
-          << "to 4GB";
-      }
+      Tree_t *new_child=NewNode_(arena);
       new_child->bound().Init(table);
       node->set_children(new_child, num_child_created);
       num_child_created++;
-      // Reorder the matrix so that the points under the new node
-      // are sequentially ordered in DFS from left to right.
-      starting_index = MatrixPartition(args.metric,
-                                       table, starting_index, remaining_count,
-                                       new_child, membership);
+      new_child->Init(starting_index, left_count);
+      typename Table_t::TreeIterator it = table.get_node_iterator(new_child);
+      TreeSpec_t::SplitRule::FindBoundFromMatrix(args.metric,
+          it, &(new_child->bound()));
+      starting_index += left_count;
       DEBUG_ASSERT(*node_counter>=0);
       new_child->node_id()=*node_counter;
       (*node_counter)++;
@@ -484,22 +733,18 @@ void Tree<TemplateMap>::SplitTree(IndexArgsType &args,
         new_child->set_level(new_child_level);
       }
       // Recurse on the new child branch.
-      SplitTree<mode>(args, table,
-                      new_child, new_child_level, node_counter);
+      if (split_in_parallel) {
+        pending.push_back(std::make_pair(new_child, new_child_level));
+      } else {
+        SplitTree_<mode>(args, table,
+                         new_child, new_child_level, node_counter, 1, 
+                         arena, membership);
+      }
     }
     // Create the final branch if at least one cutting was
     // successful and recurse.
     if (num_child_created > 0) {
-      Tree_t *final_child = NULL;
-      try {
-        final_child = new Tree_t();
-      }
-      catch(const std::bad_alloc &e) {
-        fl::logger->Die() << "Problems while allocating memory in tree building. "
-          << "It might be that your dataset is too big to fit in RAM or "
-          << "you are using a 32bit platform which limits the process address space "
-          << "to 4GB";
-      }
+      Tree_t *final_child = NewNode_(arena);
 
       node->set_children(final_child, num_child_created);
       final_child->bound().Init(table);
@@ -516,13 +761,97 @@ void Tree<TemplateMap>::SplitTree(IndexArgsType &args,
                                  &final_child_level);
         final_child->set_level(final_child_level);
       }
-      SplitTree<mode>(args, table, final_child, final_child_level, node_counter);
+      if (split_in_parallel) {
+        pending.push_back(std::make_pair(final_child, final_child_level));
+      } else {
+        SplitTree_<mode>(args, table, final_child, final_child_level, 
+            node_counter, 1, arena, membership);
+      }
     }
   } // end of the recursion case.
+  if (pending.empty()) {
+    return;
+  }
+  // Every child gets its share of the threads, the last one is split
+  // by this thread together with the children that got no thread
+  index_t num_pending = pending.size();
+  std::vector<int> child_threads(num_pending);
+  std::vector<index_t> child_counters(num_pending, 0);
+  std::vector<fl_private::NodeArena<Tree_t>*> child_arenas(num_pending, arena);
+  std::vector<std::vector<bool> > child_memberships(num_pending);
+  for(index_t i=0; i<num_pending; ++i) {
+    child_threads[i] = n_threads / num_pending 
+      + (i < n_threads % num_pending ? 1 : 0);
+  }
+  boost::thread_group threads;
+  for(index_t i=0; i+1<num_pending; ++i) {
+    if (child_threads[i]>0) {
+      if (arena!=NULL) {
+        child_arenas[i]=arena->Fork(
+            ExpectedNodes_<mode>(args, pending[i].first->count()));
+      }
+      threads.create_thread(boost::bind(
+          &Tree_t::template SplitTree_<mode, IndexArgsType>,
+          boost::ref(args), boost::ref(table), 
+          pending[i].first, pending[i].second, 
+          &child_counters[i], child_threads[i],
+          child_arenas[i], &child_memberships[i]));
+    }
+  }
+  for(index_t i=0; i<num_pending; ++i) {
+    if (i+1==num_pending || child_threads[i]==0) {
+      SplitTree_<mode>(args, table, pending[i].first, pending[i].second,
+          &child_counters[i], std::max(child_threads[i], 1), 
+          arena, membership);
+    }
+  }
+  threads.join_all();
   // Compute the statistics based on the created children.
   // node->compute_statistic(table);
 }
 
+template<typename TemplateMap>
+typename Tree<TemplateMap>::Tree_t *Tree<TemplateMap>::NewNode_(
+    fl_private::NodeArena<Tree_t> *arena) {
+  Tree_t *node=NULL;
+  try {
+    if (arena==NULL) {
+      node=new Tree_t();
+    } else {
+      node=arena->Allocate();
+    }
+  } 
+  catch(const std::bad_alloc &e) {
+    fl::logger->Die() << "Problems while allocating memory in tree building. "
+      << "It might be that your dataset is too big to fit in RAM or "
+      << "you are using a 32bit platform which limits the process address space "
+      << "to 4GB";
+  }
+  return node;
+}
+
+template<typename TemplateMap>
+template<int mode, typename IndexArgsType>
+index_t Tree<TemplateMap>::ExpectedNodes_(IndexArgsType &args, 
+    index_t count) {
+  if (mode==0 && args.leaf_size>0) {
+    // the leaves are at least half full in most trees
+    return 4*count/args.leaf_size+1;
+  }
+  return 1024;
+}
+
+template<typename TemplateMap>
+void Tree<TemplateMap>::NumberNodes_(Tree_t *node, index_t *node_counter) {
+  node->node_id()=*node_counter;
+  (*node_counter)++;
+  if (!node->is_leaf()) {
+    for(size_t i=0; i<node->children().size(); ++i) {
+      NumberNodes_(node->children()[i], node_counter);
+    }
+  }
+}
+
 /**
  * @brief inherited from StoreLevelTrait
  */
@@ -530,6 +859,11 @@ template<typename TemplateMap>
 void Tree<TemplateMap>::set_level(index_t level_in) {
   store_level_.set_level(level_in);
 }
+template<typename TemplateMap>
+bool Tree<TemplateMap>::in_arena() const {
+  return in_arena_;
+}
+
 /**
  * @brief returns the level
  */
@@ -629,6 +963,28 @@ void Tree<TemplateMap>::Init(index_t begin_in, index_t count_in) {
   begin_ = begin_in;
   count_ = count_in;
 }
+
+template<typename TemplateMap>
+void Tree<TemplateMap>::ReleaseChildren(
+    fl_private::NodeArena<Tree_t> *arena) {
+  if (is_leaf()) {
+    return;
+  }
+  for(size_t i=0; i<children_.size(); ++i) {
+    Tree_t *child=children_[i];
+    if (child==NULL) {
+      continue;
+    }
+    child->ReleaseChildren(arena);
+    if (child->in_arena()) {
+      DEBUG_ASSERT(arena!=NULL);
+      arena->Recycle(child);
+    } else {
+      delete child;
+    }
+  }
+  fl_private::ChildTrait<IsBinary, Tree_t>::Clear(children_);
+}
 /** @brief Find a node in this tree by its begin and count.
  *
  * Every node is uniquely identified by these two numbers.
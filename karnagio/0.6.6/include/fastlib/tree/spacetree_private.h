@@ -26,6 +26,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #define FASTLIB_TREE_SPACETREE_PRIVATE_H
 
 #include <algorithm>
+#include <new>
+#include <utility>
 #include <vector>
 #include "boost/mpl/assert.hpp"
 #include "fastlib/base/base.h"
@@ -79,8 +81,16 @@ private:
     }
 
     static void Destruct(Container &cont) {
-      delete cont[0];
-      delete cont[1];
+      for (size_t i = 0; i < 2; i++) {
+        if (cont[i] != NULL && cont[i]->in_arena() == false) {
+          delete cont[i];
+        }
+      }
+    }
+
+    static void Clear(Container &cont) {
+      cont[0] = NULL;
+      cont[1] = NULL;
     }
 
 };
@@ -116,10 +126,106 @@ class ChildTrait<false, T> {
 
     static void Destruct(Container &cont) {
       for (std::size_t i = 0; i < cont.size(); i++) {
-        delete cont[i];
+        if (cont[i] != NULL && cont[i]->in_arena() == false) {
+          delete cont[i];
+        }
+      }
+    }
+
+    static void Clear(Container &cont) {
+      cont.clear();
+    }
+
+};
+
+/**
+ * @brief NodeArena allocates tree nodes in big contiguous blocks, in
+ *        the order they are created. SplitTree creates them depth first,
+ *        so a subtree occupies a contiguous range of memory. The nodes
+ *        are destroyed with the arena, never one by one. An arena is
+ *        used by one thread, threads that build other subtrees get a
+ *        Fork of it
+ */
+template<typename T>
+class NodeArena {
+  public:
+    NodeArena(index_t block_size) {
+      block_size_ = std::max(block_size, index_t(64));
+      used_ = 0;
+    }
+
+    ~NodeArena() {
+      // the nodes here can have children in the forks, the forks
+      // must still be alive when they are destroyed
+      for (std::size_t i = 0; i < blocks_.size(); i++) {
+        index_t used = (i + 1 == blocks_.size()) ? used_ : blocks_[i].second;
+        for (index_t j = 0; j < used; j++) {
+          blocks_[i].first[j].~T();
+        }
+      }
+      for (std::size_t i = 0; i < forks_.size(); i++) {
+        delete forks_[i];
+      }
+      for (std::size_t i = 0; i < blocks_.size(); i++) {
+        ::operator delete(blocks_[i].first);
+      }
+    }
+
+    T *Allocate() {
+      if (free_.empty() == false) {
+        T *node = free_.back();
+        free_.pop_back();
+        node->~T();
+        new(node) T();
+        node->in_arena_ = true;
+        return node;
+      }
+      if (blocks_.empty() || used_ == blocks_.back().second) {
+        index_t size = block_size_;
+        if (blocks_.empty() == false) {
+          // every new block is as big as half of the previous ones
+          size = std::max(block_size_, NumOfNodes() / 2);
+        }
+        blocks_.push_back(std::make_pair(
+          static_cast<T*>(::operator new(size * sizeof(T))), size));
+        used_ = 0;
       }
+      T *node = new(blocks_.back().first + used_) T();
+      used_++;
+      node->in_arena_ = true;
+      return node;
     }
 
+    /**
+     * @brief takes back a node without children, Allocate gives it 
+     *        again. The node stays alive until then, so the arena 
+     *        still destroys it with the rest
+     */
+    void Recycle(T *node) {
+      free_.push_back(node);
+    }
+
+    NodeArena *Fork(index_t block_size) {
+      forks_.push_back(new NodeArena(block_size));
+      return forks_.back();
+    }
+
+    index_t NumOfNodes() const {
+      index_t result = used_;
+      for (std::size_t i = 0; i + 1 < blocks_.size(); i++) {
+        result += blocks_[i].second;
+      }
+      return result;
+    }
+
+  private:
+    index_t block_size_;
+    // the nodes in use in the last block
+    index_t used_;
+    std::vector<std::pair<T*, index_t> > blocks_;
+    std::vector<NodeArena*> forks_;
+    // the nodes given back with Recycle
+    std::vector<T*> free_;
 };
 
 template<bool StoreLevel>
@@ -26,7 +26,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #define FASTLIB_TREE_TREE_H_
 
 #include "bounds.h"
-//#include "cover_tree.h"
+#include "cover_tree.h"
 #include "kdtree.h"
 #include "metric_tree.h"
 #include "similarity_tree.h"
@@ -132,5 +132,14 @@ namespace fl {namespace ws {
         const boost::program_options::variables_map &vm);
     std::vector<std::string> GetFileSequence(const std::string &table_name,
         std::map<std::string, std::string> &vm);
+
+   /**
+    * @brief WorkSpace::LoadAllTables and IndexAllReferencesQueries read 
+    *        some options from the arguments of every program, every Main 
+    *        adds them to its own options so that it does not reject them 
+    *        as unknown
+    */
+    void AddWorkSpaceOptions(
+        boost::program_options::options_description *desc);
 }}
 #endif
@@ -0,0 +1,112 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_FASTLIB_WORKSPACE_TABLE_LOCK_H_
+#define INCLUDE_FASTLIB_WORKSPACE_TABLE_LOCK_H_
+
+#include "boost/utility.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/thread/shared_mutex.hpp"
+#include "boost/thread/condition_variable.hpp"
+
+namespace fl { namespace ws {
+  /**
+   * @brief Guards a table of the workspace. It has two independent parts.
+   *        The access lock is a reader/writer lock that protects the
+   *        entry of the table. Readers take it shared, so any number of
+   *        read only tasks can attach the same table concurrently, writers
+   *        and paging take it exclusively. It is always released by the 
+   *        thread that took it.
+   *        The busy flag tells if a task is producing the table. A table 
+   *        is busy from the moment it is created or attached for writing 
+   *        until it is purged, readers wait until it is ready. The flag
+   *        can be set and cleared by different threads
+   */
+  class TableLock : boost::noncopyable {
+    public:
+      TableLock() : busy_(true) {
+      }
+      void lock_shared() {
+        access_.lock_shared();
+      }
+      void unlock_shared() {
+        access_.unlock_shared();
+      }
+      void lock() {
+        access_.lock();
+      }
+      bool try_lock() {
+        return access_.try_lock();
+      }
+      void unlock() {
+        access_.unlock();
+      }
+      /**
+       * @brief marks the table busy, it does not wait
+       */
+      void MarkBusy() {
+        boost::mutex::scoped_lock lock(state_mutex_);
+        busy_=true;
+      }
+      /**
+       * @brief marks the table ready and wakes up the waiting tasks
+       */
+      void MarkReady() {
+        {
+          boost::mutex::scoped_lock lock(state_mutex_);
+          busy_=false;
+        }
+        ready_.notify_all();
+      }
+      bool IsReady() {
+        boost::mutex::scoped_lock lock(state_mutex_);
+        return busy_==false;
+      }
+      void WaitUntilReady() {
+        boost::mutex::scoped_lock lock(state_mutex_);
+        while (busy_==true) {
+          ready_.wait(lock);
+        }
+      }
+      /**
+       * @brief waits until the table is ready and marks it busy, 
+       *        only one writer can get it
+       */
+      void WaitAndMarkBusy() {
+        boost::mutex::scoped_lock lock(state_mutex_);
+        while (busy_==true) {
+          ready_.wait(lock);
+        }
+        busy_=true;
+      }
+
+    private:
+      boost::shared_mutex access_;
+      boost::mutex state_mutex_;
+      boost::condition_variable ready_;
+      bool busy_;
+  };
+}}
+#endif
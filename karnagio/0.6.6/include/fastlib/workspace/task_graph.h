@@ -0,0 +1,139 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_FASTLIB_WORKSPACE_TASK_GRAPH_H_
+#define INCLUDE_FASTLIB_WORKSPACE_TASK_GRAPH_H_
+
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "boost/function.hpp"
+#include "boost/shared_ptr.hpp"
+#include "boost/utility.hpp"
+#include "boost/thread.hpp"
+#include "boost/thread/tss.hpp"
+#include "fastlib/base/base.h"
+
+namespace fl { namespace ws {
+  /**
+   * @brief Runs tasks in the order of the tables they read and write.
+   *        Every task is submitted with the names of its input and output
+   *        tables. A task depends on the last unfinished task that writes
+   *        any of its tables. If nobody writes an input and it is not in 
+   *        the workspace either, the task waits until a task that is 
+   *        submitted later produces it. 
+   *        Ready tasks run on a pool of workers. Every worker has its own
+   *        deque, it pushes the tasks it releases and pops them from the 
+   *        back, so a consumer usually runs on the worker of its producer.
+   *        An idle worker steals from the front of the other deques
+   */
+  class TaskGraph : boost::noncopyable {
+    public:
+      typedef boost::function0<void> Task_t;
+      typedef boost::function1<bool, const std::string&> IsAvailable_t;
+
+      TaskGraph();
+      ~TaskGraph();
+      /**
+       * @brief starts the workers. is_available tells if a table that 
+       *        no task writes already exists
+       */
+      void Init(int n_threads, const IsAvailable_t &is_available);
+      void Submit(const Task_t &task,
+          const std::vector<std::string> &inputs,
+          const std::vector<std::string> &outputs);
+      /**
+       * @brief waits until all the submitted tasks are done. It dies if
+       *        the remaining tasks wait for tables that nobody produces
+       */
+      void Wait();
+      /**
+       * @brief the tasks that have not started are dropped
+       */
+      void Clear();
+      /**
+       * @brief When a task has to wait for a table it should not block 
+       *        its worker. If it is called from a worker it runs other 
+       *        ready tasks until is_done returns true. Otherwise it returns 
+       *        false immediately and the caller has to wait
+       */
+      bool HelpUntil(const boost::function0<bool> &is_done);
+      int n_threads() const;
+
+    private:
+      struct Node {
+        Task_t task;
+        // the tables it is registered as a reader of
+        std::vector<std::string> inputs;
+        std::vector<std::string> outputs;
+        std::vector<Node*> dependents;
+        int n_missing;
+        int generation;
+      };
+      struct Queue {
+        boost::mutex mutex;
+        std::deque<Node*> nodes;
+      };
+      void Work(int id);
+      void Stop();
+      /**
+       * @brief pops from the back of its own deque, otherwise it steals 
+       *        from the front of the others
+       */
+      bool Pop(int id, Node **node);
+      /**
+       * @brief the caller must hold mutex_
+       */
+      void Push(int id, Node *node);
+      void Run(int id, Node *node);
+      void Release(int id, Node *node);
+      void ClearLocked();
+      int WorkerId();
+
+      boost::mutex mutex_;
+      boost::condition_variable changed_;
+      std::vector<boost::shared_ptr<Queue> > queues_;
+      boost::thread_group workers_;
+      boost::thread_specific_ptr<int> worker_id_;
+      // the last unfinished task that writes a table
+      std::map<std::string, Node*> writers_;
+      // the unfinished tasks that read a table since its last writer was
+      // submitted, the next writer waits for them
+      std::map<std::string, std::vector<Node*> > readers_;
+      // tasks that wait for a table that nobody has produced yet
+      std::map<std::string, std::vector<Node*> > waiting_;
+      std::set<std::string> produced_;
+      IsAvailable_t is_available_;
+      index_t n_ready_;
+      index_t n_running_;
+      index_t n_unfinished_;
+      int next_queue_;
+      int generation_;
+      bool stop_;
+  };
+}}
+#endif
@@ -30,6 +30,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "boost/any.hpp"
 #include "boost/shared_ptr.hpp"
 #include "boost/thread/mutex.hpp"
+#include "boost/thread/shared_mutex.hpp"
 #include "boost/mpl/for_each.hpp"
 #include "boost/mpl/vector.hpp"
 #include "boost/utility.hpp"
@@ -39,6 +40,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "boost/archive/xml_oarchive.hpp"
 #include "boost/filesystem.hpp"
 #include "fastlib/table/branch_on_table.h"
+#include "fastlib/workspace/table_lock.h"
+#include "fastlib/workspace/task_graph.h"
 #include "fastlib/util/timer.h"
 #include "fastlib/table/table_defs.h"
 #include "fastlib/table/default_table.h"
@@ -47,11 +50,13 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "fastlib/table/uinteger_table.h"
 #include "fastlib/table/integer_table.h"
 #include "fastlib/table/table_vector.h"
+#include "fastlib/table/table_stream.h"
 #include "fastlib/table/default_sparse_int_table.h"
 #include "fastlib/table/default_sparse_double_table.h"
 #include "fastlib/metric_kernel/weighted_lmetric.h"
 #include "fastlib/table/default/categorical/labeled/balltree/table.h"
 #include "fastlib/table/default/dense/labeled/balltree/table.h"
+#include "fastlib/table/default/dense/labeled/covertree/table.h"
 #include "fastlib/table/default/dense/labeled/kdtree/table.h"
 #include "fastlib/table/default/dense_categorical/labeled/balltree/table.h"
 #include "fastlib/table/default/dense_sparse/labeled/balltree/table.h"
@@ -87,7 +92,7 @@ class WorkSpace : boost::noncopyable {
       TableVector<signed char>
     > ParameterTables_t;
 
-    typedef boost::mpl::vector8<
+    typedef boost::mpl::vector9<
       fl::table::dense::labeled::kdtree::Table,
       fl::table::dense::labeled::balltree::Table,
       fl::table::sparse::labeled::balltree::Table,
@@ -95,7 +100,8 @@ class WorkSpace : boost::noncopyable {
       fl::table::categorical::labeled::balltree::Table,
       fl::table::dense_categorical::labeled::balltree::Table,
       fl::table::sparse::labeled::balltree::uint8::Table,
-      fl::table::sparse::labeled::balltree::uint16::Table
+      fl::table::sparse::labeled::balltree::uint16::Table,
+      fl::table::dense::labeled::covertree::Table
     > DataTables_t;
 
     struct TableInfo {
@@ -126,7 +132,12 @@ class WorkSpace : boost::noncopyable {
      *  or _out. If the workspace works in a sequential mode then
      *  it will mutate the table. If it is working on an asynchronous
      *  concurrent mode then it will create new tables index them
-     *  and also update the command line arguments
+     *  and also update the command line arguments. Every tree is
+     *  built with --index_threads threads (default 1) and the
+     *  --split rule of the tree (default the one of the tree). With
+     *  --algorithm=graph nothing is indexed, the graph index
+     *  replaces the trees. With --tree=covertree the dense tables
+     *  are moved to cover tree tables before they are indexed
      */
     void IndexAllReferencesQueries(std::vector<std::string> *args);
     void ExportAllTables(const std::vector<std::string> args);
@@ -214,12 +225,16 @@ class WorkSpace : boost::noncopyable {
      * @brief this function indexes a table in place. It mutates the table.
      *        It is a blocking function, but also dangerous. You have to 
      *        make sure that nobody can access the data while being indexed.
-     *        The advantage of this method is that avoids copying the data
+     *        The advantage of this method is that avoids copying the data.
+     *        n_threads is the number of threads that build the tree and
+     *        split the split rule, see Table::IndexArgs
      */
     void IndexTable(const std::string &variable, 
         const std::string &metric,
         const std::string &metric_args,
-        const int leaf_size);
+        const int leaf_size,
+        const int n_threads=1,
+        const std::string &split="");
     /**
      * @brief this function indexes a table variable. The indexed table
      *        is stored in the new variable_indexed. The advantage of this
@@ -231,6 +246,35 @@ class WorkSpace : boost::noncopyable {
         const std::string &metric,
         const std::string &metric_args,
         const int leaf_size);
+    /**
+     * @brief moves the points of a dense table to a cover tree table
+     *        with the same name, so that it is indexed with a cover tree.
+     *        Like IndexTable it mutates the table, an index it had is
+     *        dropped. A cover tree table is left as it is
+     */
+    void MakeCoverTreeTable(const std::string &variable);
+
+    /**
+     * @brief inserts the points of the table points_variable in the 
+     *        indexed table variable. The tree is updated in place, the
+     *        algorithms that attach the table afterwards search the new
+     *        points too. The metric must be the one the table was 
+     *        indexed with. Like IndexTable it mutates the table
+     */
+    void InsertIntoTable(const std::string &variable,
+        const std::string &points_variable,
+        const std::string &metric,
+        const std::string &metric_args);
+    /**
+     * @brief deletes the points with the given ids from the tree of the
+     *        indexed table variable without building the tree again. The
+     *        points stay in the table as tombstones, so the ids of the 
+     *        others do not change
+     */
+    void DeleteFromTable(const std::string &variable,
+        const std::vector<index_t> &ids,
+        const std::string &metric,
+        const std::string &metric_args);
 
     void ExportToFile(const std::string &name, const std::string &filename);
     
@@ -309,6 +353,21 @@ class WorkSpace : boost::noncopyable {
      */   
     void Purge(const std::string &table_name, bool force_save);
 
+    /**
+     * @brief Gives a stream over the blocks of a table. If the table was 
+     *        registered as a stream by LoadAllTables the blocks are read
+     *        from its file, otherwise the table is attached and it is 
+     *        the only block of the stream
+     */
+    template<typename TableType>
+    void AttachStream(const std::string &name,
+        boost::shared_ptr<fl::table::TableStream<TableType> > *stream);
+    /**
+     * @brief Checks if a table is read in blocks from its file instead
+     *        of being loaded in memory
+     */
+    bool IsStreamed(const std::string &name);
+
     template<int Index, typename TableType1, typename TableType2, typename TableType3>
     void TieLabels(boost::shared_ptr<TableType1> table,
         boost::shared_ptr<TableType2> labels, 
@@ -329,10 +388,34 @@ class WorkSpace : boost::noncopyable {
         std::vector<index_t> *sparse_sizes);
 
     void schedule(boost::threadpool::task_func const &task);
+    /**
+     * @brief schedules a task that reads the tables in inputs and writes
+     *        the tables in outputs. In schedule mode 3 the task does not 
+     *        run before the tasks that produce its inputs are done, in the
+     *        other modes the tables are ignored
+     */
+    void schedule(boost::threadpool::task_func const &task,
+        const std::vector<std::string> &inputs,
+        const std::vector<std::string> &outputs);
+    /**
+     * @brief the same as before, the tables are the ones of the *_in and
+     *        *_out arguments of the task
+     */
+    void schedule(boost::threadpool::task_func const &task,
+        const std::vector<std::string> &args);
+    /**
+     * @brief finds the tables of the *_in and *_out arguments. File 
+     *        sequences are not included
+     */
+    static void GetTaskTables(const std::vector<std::string> &args,
+        std::vector<std::string> *inputs,
+        std::vector<std::string> *outputs);
     /**
      * @brief schedule mode = 0 uses the threadpool
      *                      = 1 uses a vector of threads
      *                      = 2 executes the task immediately not asynchronous
+     *                      = 3 uses the task graph, tasks run when their 
+     *                          input tables are ready
      */
     void set_schedule_mode(int schedule_mode);
     /**
@@ -341,6 +424,27 @@ class WorkSpace : boost::noncopyable {
      *        default is 1
      */
     void set_paging_mode(int paging_mode);
+    /**
+     * @brief selects how the tables are written to the temp directory 
+     *        when they are paged out
+     *        codec = binary  the native binary table format, a table is
+     *                        mapped back in memory when it is attached
+     *              = archive an uncompressed boost archive
+     *              = gzip    a compressed boost archive, it is slow but 
+     *                        it takes the least space
+     *        default is binary. LoadAllTables also sets it from 
+     *        --spill_codec
+     */
+    void set_spill_codec(const std::string &codec);
+    /**
+     * @brief if block_size is positive LoadAllTables does not load the
+     *        --references_in tables in memory, it registers them as streams
+     *        that are read in blocks of block_size bytes. Window is the
+     *        maximum number of resident blocks of every stream. LoadAllTables
+     *        also sets it from --stream_block_mb and --stream_window. 
+     *        By default tables are not streamed
+     */
+    void set_stream_mode(index_t block_size, int window);
     /**
      * @brief it checks if the tasks are scheduled sequentially. This is very
      *        important because if workspace runs in sequential mode then
@@ -371,11 +475,10 @@ class WorkSpace : boost::noncopyable {
       public:
         LoadMeta(const std::string &name,
             const std::string &filename, 
-            boost::mutex *mutex,
-            boost::mutex &global_mutex,
+            boost::shared_mutex &global_mutex,
             std::map<std::string, boost::any> *var_map,
             bool *success) : name_(name),
-          filename_(filename), mutex_(mutex), global_mutex_(global_mutex),
+          filename_(filename), global_mutex_(global_mutex),
           var_map_(var_map), success_(success) {
         }
         template<typename TableType>
@@ -383,8 +486,7 @@ class WorkSpace : boost::noncopyable {
       private:
         const std::string &name_;
         const std::string &filename_;
-        boost::mutex *mutex_;
-        boost::mutex &global_mutex_;
+        boost::shared_mutex &global_mutex_;
         std::map<std::string, boost::any> *var_map_; 
         bool *success_;
     };
@@ -393,10 +495,10 @@ class WorkSpace : boost::noncopyable {
       public:
         SaveMeta(
             WorkSpace *ws,
-            std::map<std::string, boost::any> *var_map, 
+            boost::any *table, 
             const std::string &name, 
             const std::string &filename, 
-            bool *success) : ws_(ws), var_map_(var_map), name_(name), 
+            bool *success) : ws_(ws), table_(table), name_(name), 
                              filename_(filename), success_(success)
         {
         } 
@@ -405,7 +507,7 @@ class WorkSpace : boost::noncopyable {
 
       private:
         WorkSpace *ws_;
-        std::map<std::string, boost::any> *var_map_;
+        boost::any *table_;
         const std::string &name_;
         const std::string &filename_;
         bool *success_;  
@@ -414,28 +516,64 @@ class WorkSpace : boost::noncopyable {
     struct IndexMeta {
       public:
         IndexMeta(WorkSpace *ws,
-            std::map<std::string, boost::any> *var_map, 
+            boost::any *table, 
             const std::string &variable,
             const std::string &metric,
             const std::string &metric_args,
             const int &leaf_size,
+            const int &n_threads,
+            const std::string &split,
             bool *success) : ws_(ws),
-          var_map_(var_map), variable_(variable), metric_(metric), 
-          metric_args_(metric_args), leaf_size_(leaf_size), success_(success) {
+          table_(table), variable_(variable), metric_(metric), 
+          metric_args_(metric_args), leaf_size_(leaf_size), 
+          n_threads_(n_threads), split_(split), success_(success) {
         }
         template<typename TableType>
         void operator()(TableType&);
 
       private:
         WorkSpace *ws_;
-        std::map<std::string, boost::any> *var_map_;
+        boost::any *table_;
         const std::string &variable_;
         const std::string &metric_;
         const std::string &metric_args_;
         const int &leaf_size_;
+        const int &n_threads_;
+        const std::string &split_;
         bool *success_;
     };
 
+    struct UpdateMeta {
+      public:
+        UpdateMeta(WorkSpace *ws,
+            boost::any *table, 
+            const std::string &variable,
+            const std::string &points_variable,
+            const std::vector<index_t> &ids,
+            const std::string &metric,
+            const std::string &metric_args,
+            bool *success) : ws_(ws),
+          table_(table), variable_(variable), 
+          points_variable_(points_variable), ids_(ids), metric_(metric), 
+          metric_args_(metric_args), success_(success) {
+        }
+        template<typename TableType>
+        void operator()(TableType&);
+
+      private:
+        WorkSpace *ws_;
+        boost::any *table_;
+        const std::string &variable_;
+        const std::string &points_variable_;
+        const std::vector<index_t> &ids_;
+        const std::string &metric_;
+        const std::string &metric_args_;
+        bool *success_;
+
+        template<typename TableType, typename IndexArgsType>
+        void Update_(TableType *table, IndexArgsType &args);
+    };
+
     struct CopyMeta {
       public:
         CopyMeta(WorkSpace * const ws, 
@@ -451,15 +589,53 @@ class WorkSpace : boost::noncopyable {
         const std::string &dest_;
     };
 
+    struct StreamMeta {
+      public:
+        StreamMeta(const std::string &name,
+            const std::string &filename,
+            boost::any *table,
+            TableInfo *info,
+            bool *success) : name_(name), filename_(filename),
+          table_(table), info_(info), success_(success) {
+        }
+        template<typename TableType>
+        void operator()(TableType&);
+      private:
+        const std::string &name_;
+        const std::string &filename_;
+        boost::any *table_;
+        TableInfo *info_;
+        bool *success_;
+    };
+
+    struct CountStreamMeta {
+      public:
+        CountStreamMeta(const std::string &filename,
+            const boost::any &table,
+            index_t block_size,
+            index_t *n_entries,
+            bool *success) : filename_(filename), table_(table),
+          block_size_(block_size), n_entries_(n_entries), success_(success) {
+        }
+        template<typename TableType>
+        void operator()(TableType&);
+      private:
+        const std::string &filename_;
+        const boost::any &table_;
+        index_t block_size_;
+        index_t *n_entries_;
+        bool *success_;
+    };
+
     struct SerializeToDiskMeta {
       public:
         SerializeToDiskMeta(
             WorkSpace *ws, 
             const std::string &name, 
-            std::map<std::string, boost::any> &var_map,
+            const boost::any &table,
             boost::archive::binary_oarchive &oa, 
             bool *success) : ws_(ws), name_(name), 
-                             var_map_(var_map),
+                             table_(table),
                              oa_(oa), success_(success)
         {
         } 
@@ -469,23 +645,37 @@ class WorkSpace : boost::noncopyable {
       private:
         WorkSpace *ws_;
         const std::string &name_;
-        std::map<std::string, boost::any> &var_map_;
+        const boost::any &table_;
         boost::archive::binary_oarchive &oa_;
         bool *success_;  
     };
 
+    struct SaveBinaryMeta {
+      public:
+        SaveBinaryMeta(const std::string &filename,
+            const boost::any &table,
+            bool *success) : filename_(filename), 
+                             table_(table), success_(success) {
+        }
+        template<typename TableType>
+        void operator()(TableType&);
+
+      private:
+        const std::string &filename_;
+        const boost::any &table_;
+        bool *success_;
+    };
+
     struct ClearTableNameMeta {
       public:
-        ClearTableNameMeta(const std::string &table, 
-            std::map<std::string, boost::any> &var_map,
+        ClearTableNameMeta(boost::any *table,
             bool *success) :
-          table_(table), var_map_(var_map), success_(success) {}
+          table_(table), success_(success) {}
         template<typename TableType>
         void operator()(TableType&);
       
       private:
-        const std::string &table_;
-        std::map<std::string, boost::any> &var_map_;
+        boost::any *table_;
         bool *success_;
     };
 
@@ -493,11 +683,21 @@ class WorkSpace : boost::noncopyable {
     index_t temp_var_counter_;
     boost::mutex temp_var_mutex_;
     std::string workspace_name_;
+    // the entries of var_map_ are guarded by the locks of the tables,
+    // global_mutex_ guards the structure of the maps, it is taken
+    // shared for lookups and exclusively for insertions and deletions.
+    // A table lock is always taken before global_mutex_
     std::map<std::string, boost::any> var_map_;
     std::map<std::string, TableInfo> table_info_;
-    std::map<std::string, boost::shared_ptr<boost::mutex> > mutex_map_;
-    boost::mutex global_mutex_;
+    std::map<std::string, boost::shared_ptr<TableLock> > table_locks_;
+    // tables that are read in blocks, the key is the table name
+    // and the value is the file
+    std::map<std::string, std::string> streams_;
+    index_t stream_block_size_;
+    int stream_window_;
+    boost::shared_mutex global_mutex_;
     boost::scoped_ptr<boost::threadpool::pool> pool_; 
+    boost::scoped_ptr<TaskGraph> task_graph_;
     std::list<boost::thread*> vector_pool_;
     boost::thread_group thread_group_;
     boost::filesystem::path temp_directory_;
@@ -507,6 +707,7 @@ class WorkSpace : boost::noncopyable {
      * the dist
      */
     bool use_paging_;
+    std::string spill_codec_;
     /**
      * @brief this variable selects which scheduler to use
      *        if it is set to 0 it uses the boost threadpool
@@ -520,6 +721,62 @@ class WorkSpace : boost::noncopyable {
     void DummyThreadLaunch(boost::threadpool::task_func const & task);
 
     bool IsInTempDir(const std::string &name);
+    /**
+     * @brief waits until a table is produced, in schedule mode 3 
+     *        the worker runs other tasks in the meantime
+     */
+    void WaitUntilReady(TableLock *table_lock);
+    /**
+     * @brief returns the lock of a table, if the table does not exist
+     *        the lock is created busy, so tasks that attach the table 
+     *        wait until it is produced
+     */
+    boost::shared_ptr<TableLock> GetTableLock(const std::string &name);
+    /**
+     * @brief returns the lock of a table or NULL if the table does not exist
+     */
+    boost::shared_ptr<TableLock> FindTableLock(const std::string &name);
+    /**
+     * @brief returns the entry of a table in var_map_, it dies if the table
+     *        does not exist. The caller must hold the lock of the table
+     */
+    boost::any *FindTable(const std::string &name);
+    /**
+     * @brief it is like LoadFromFile, but the caller must hold the lock
+     *        of the table exclusively. It returns false if the type of the
+     *        file is not supported
+     */
+    template<typename TableSetType>
+    bool LoadFromFileLocked(const std::string &name,
+      const std::string &filename);
+    /**
+     * @brief brings back a table that was paged out of memory. 
+     *        The caller must hold the lock of the table exclusively
+     */
+    template<typename TableType>
+    void PageIn(const std::string &name, 
+        boost::shared_ptr<TableType> *table);
+    /**
+     * @brief computes the info of a table, the caller must hold 
+     *        the lock of the table
+     */
+    void GetTableInfo(const std::string &table_name,
+        const boost::any &table,
+        TableInfo *info);
+    /**
+     * @brief finds the type of a table file and registers it as a stream,
+     *        only the header of the file is read
+     */
+    void RegisterStream(const std::string &name, const std::string &filename);
+    /**
+     * @brief if a table is registered as a stream it is loaded in memory,
+     *        this is the fallback for algorithms that attach the whole table
+     */
+    void LoadStreamedTable(const std::string &name);
+    /**
+     * @brief counts the points of a streamed table, once
+     */
+    index_t CountStreamedEntries(const std::string &name);
     template<typename TableType>
     void SerializeFromDisk(const std::string &name, 
         boost::shared_ptr<TableType> *table);
@@ -527,7 +784,8 @@ class WorkSpace : boost::noncopyable {
      * @brief Serializes a table to disk. It assumes that table is locked for the
      *        outiside environment
      */
-    void SerializeToDisk(const std::string &table_name); 
+    void SerializeToDisk(const std::string &table_name, 
+        const boost::any &table); 
 
     boost::filesystem::path FromTableNameToPath(
         const std::string &table_name);
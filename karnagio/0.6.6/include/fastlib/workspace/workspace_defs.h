@@ -37,6 +37,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "boost/archive/xml_iarchive.hpp"
 #include "boost/serialization/shared_ptr.hpp"
 #include "fastlib/table/table_serialization.h"
+#include "fastlib/table/table_stream_dev.h"
+#include "fastlib/table/table_binary.h"
+#include "fastlib/data/binary_table_format.h"
 #include "fastlib/data/multi_dataset_reset.h"
 #include "boost/iostreams/filtering_streambuf.hpp"
 #include "boost/iostreams/copy.hpp"
@@ -47,44 +50,42 @@ namespace fl { namespace ws {
 
   template<typename TableType>
   void WorkSpace::LoadTable(const std::string &name, boost::shared_ptr<TableType> table) {
-    boost::mutex* mutex;
-    global_mutex_.lock();
-    if (mutex_map_.count(name)==0) {
-      mutex=new boost::mutex();
-      mutex_map_[name].reset(mutex);
-    } else {
-      mutex=mutex_map_[name].get();
+    boost::shared_ptr<TableLock> table_lock=GetTableLock(name);
+    {
+      boost::unique_lock<TableLock> lock(*table_lock);
+      table->filename()=name;
+      boost::unique_lock<boost::shared_mutex> global_lock(global_mutex_);
+      var_map_[name]=table;
     }
-    mutex->try_lock();
-    table->filename()=name;
-    var_map_[name]=table;
-    mutex->unlock();
-    global_mutex_.unlock(); 
+    table_lock->MarkReady();
   }
 
   template<typename TableSetType>
   void WorkSpace::LoadFromFile(const std::string &name,
       const std::string &filename) {
     FL_SCOPED_LOG(LoadFromFile);
-    boost::mutex* mutex;
-    global_mutex_.lock();
-    if (mutex_map_.count(name)==0) {
-      mutex=new boost::mutex();
-      mutex_map_[name].reset(mutex);
-    } else {
-      mutex=mutex_map_[name].get();
+    boost::shared_ptr<TableLock> table_lock=GetTableLock(name);
+    table_lock->MarkBusy();
+    bool success;
+    {
+      boost::unique_lock<TableLock> lock(*table_lock);
+      success=LoadFromFileLocked<TableSetType>(name, filename);
     }
-    mutex->try_lock();
-    global_mutex_.unlock();
-    bool success=false;
-    boost::mpl::for_each<TableSetType>(LoadMeta(name, filename,  
-          mutex, global_mutex_, &var_map_, &success));
-    mutex->unlock();
+    table_lock->MarkReady();
     if (success==false) {
       fl::logger->Die()<< "Failed to load "<< filename<<" unsupported type";
     }
   }
 
+  template<typename TableSetType>
+  bool WorkSpace::LoadFromFileLocked(const std::string &name,
+      const std::string &filename) {
+    bool success=false;
+    boost::mpl::for_each<TableSetType>(LoadMeta(name, filename,  
+          global_mutex_, &var_map_, &success));
+    return success;
+  }
+
   template<typename TableType>
   void WorkSpace::LoadMeta::operator()(TableType&) {
     if (*success_==true) {
@@ -95,9 +96,8 @@ namespace fl { namespace ws {
         new TableType());
       table->data()->TryToInit(filename_);
       table->Init(filename_, "r");
-      global_mutex_.lock();
+      boost::unique_lock<boost::shared_mutex> lock(global_mutex_);
       var_map_->operator[](name_)=table;
-      global_mutex_.unlock();
       *success_=true;
       fl::logger->Debug()<<"File: "<<filename_<<" was loaded in the workspace"
        <<std::endl; 
@@ -119,111 +119,161 @@ namespace fl { namespace ws {
         const std::string &mode) {
     FL_SCOPED_LOG(WorkSpace);
     FL_SCOPED_LOG(attach);
+    LoadStreamedTable(name);
+    if (mode!="r" && mode!="w") {
+      fl::logger->Die()<<"Unrecognized mode ("<<mode<<")";
+    }
+    // in sequential mode nobody else can produce the table, 
+    // waiting for it would never return
+    if (schedule_mode_==2 && FindTableLock(name).get()==NULL) {
+      fl::logger->Die()<<"Table ("<<name<<") does not exist in workspace ("
+        <<workspace_name_<<")";
+    }
+    boost::shared_ptr<TableLock> table_lock=GetTableLock(name);
     if (mode=="r") { 
-      boost::mutex* mutex;
-      global_mutex_.lock();
-      if (mutex_map_.count(name)==0) {
-        mutex=new boost::mutex();
-        mutex_map_[name].reset(mutex);
-        mutex->lock();
-      } else {
-        mutex=mutex_map_[name].get();      
-      }
-      global_mutex_.unlock();
-      mutex->lock();
+      WaitUntilReady(table_lock.get());
+      boost::shared_lock<TableLock> lock(*table_lock);
       try {
-        global_mutex_.lock();
-        if (var_map_.count(name)==0) {
-          fl::logger->Die()<<"Detected unsafe deletion of table ("
-            <<name<<")";
-        }
-        *table=boost::any_cast<boost::shared_ptr<TableType> >(var_map_[name]);
-        if (table->get()==NULL) {
-          if (use_paging_) {
-            if (IsInTempDir(name)) {
-              SerializeFromDisk(name, table);
-              var_map_[name]=*table;
-            } else {
-              LoadDataTableFromFile(name, name);
-            }
-          } else {
-            fl::logger->Die() << "You are trying to attach a table ("<<name
-              << ") that somehow has been deleted, please report this bug";
-          }
-        }
-        global_mutex_.unlock();
+        *table=boost::any_cast<boost::shared_ptr<TableType> >(*FindTable(name));
       }
       catch(const boost::bad_any_cast &e) {
-        mutex->unlock();
-        global_mutex_.unlock();
         fl::logger->Die()<<"Failed to attach ("<<name<<"), There seems to be "
           "a bad type conversion";
       }
-      mutex->unlock();
+      if (table->get()!=NULL) {
+        return;
+      }
     } else {
-      if (mode=="w") {
-        try {
-          if (var_map_.count(name)==0) {
-            fl::logger->Die()<<"Detected unsafe deletion of table ("
-              <<name<<")";
-          }
-        *table=boost::any_cast<boost::shared_ptr<TableType> >(var_map_[name]);
-        if (table->get()==NULL) {
-          if (use_paging_) {
-            if (IsInTempDir(name)) {
-              SerializeFromDisk(name, table);
-              var_map_[name]=*table;
-            } else {
-              LoadDataTableFromFile(name, name);
-            }
-          } else {
-            fl::logger->Die() << "You are trying to attach a table ("<<name
-              << ") that somehow has been deleted, please report this bug";
-          }
-        }
+      // the writer keeps the table busy until it purges it
+      WaitUntilReady(table_lock.get());
+      table_lock->WaitAndMarkBusy();
+    }
+    // the table has to be paged in or it is attached for writing,
+    // only one task can do it  
+    boost::unique_lock<TableLock> lock(*table_lock);
+    try {
+      *table=boost::any_cast<boost::shared_ptr<TableType> >(*FindTable(name));
+    }
+    catch(const boost::bad_any_cast &e) {
+      fl::logger->Die()<<"Failed to attach ("<<name<<"), There seems to be "
+        "a bad type conversion";
+    }
+    if (table->get()==NULL) {
+      PageIn(name, table);
+    }
+  }
+
+  template<typename TableType>
+  void WorkSpace::PageIn(const std::string &name, 
+      boost::shared_ptr<TableType> *table) {
+    if (use_paging_==false) {
+      fl::logger->Die() << "You are trying to attach a table ("<<name
+        << ") that somehow has been deleted, please report this bug";
+    }
+    if (IsInTempDir(name)) {
+      SerializeFromDisk(name, table);
+      boost::unique_lock<boost::shared_mutex> global_lock(global_mutex_);
+      var_map_[name]=*table;
+    } else {
+      if (LoadFromFileLocked<DataTables_t>(name, name)==false) {
+        fl::logger->Die()<< "Failed to load "<< name<<" unsupported type";
+      }
+      try {
+        *table=boost::any_cast<boost::shared_ptr<TableType> >(*FindTable(name));
       }
       catch(const boost::bad_any_cast &e) {
         fl::logger->Die()<<"Failed to attach ("<<name<<"), There seems to be "
           "a bad type conversion";
       }
-     
-      } else {      
-        fl::logger->Die()<<"Unrecognized mode ("<<mode<<")";
+    }
+  }
+
+  template<typename TableType>
+  void WorkSpace::StreamMeta::operator()(TableType&) {
+    if (*success_==true) {
+      return;
+    }
+    try {
+      boost::shared_ptr<TableType> table(new TableType());
+      table->data()->TryToInit(filename_);
+      // reads only the header, the stream is reopened every time
+      // it is attached
+      fl::table::TableStream<TableType> stream;
+      stream.Init(filename_, 1, 1);
+      // it is counted when somebody asks for it
+      info_->n_entries=-1;
+      info_->n_attributes=stream.n_attributes();
+      info_->dense_sizes=stream.layout().dense_sizes();
+      info_->sparse_sizes=stream.layout().sparse_sizes();
+      *table_=boost::shared_ptr<TableType>();
+      *success_=true;
+      fl::logger->Debug()<<"File: "<<filename_<<" will be streamed"
+       <<std::endl; 
+    }
+    catch(const fl::TypeException &e) {
+      
+    }
+  }
+
+  template<typename TableType>
+  void WorkSpace::CountStreamMeta::operator()(TableType&) {
+    if (*success_==true) {
+      return;
+    }
+    try {
+      // the streamed tables are registered with an empty table 
+      // of their type
+      boost::any_cast<boost::shared_ptr<TableType> >(table_);
+    }
+    catch(const boost::bad_any_cast &e) {
+      return;
+    }
+    fl::table::TableStream<TableType> stream;
+    stream.Init(filename_, block_size_, 1);
+    *n_entries_=stream.n_entries();
+    *success_=true;
+  }
+
+  template<typename TableType>
+  void WorkSpace::AttachStream(const std::string &name,
+      boost::shared_ptr<fl::table::TableStream<TableType> > *stream) {
+    FL_SCOPED_LOG(WorkSpace);
+    FL_SCOPED_LOG(AttachStream);
+    std::string filename;
+    {
+      boost::shared_lock<boost::shared_mutex> global_lock(global_mutex_);
+      std::map<std::string, std::string>::const_iterator it=streams_.find(name);
+      if (it!=streams_.end()) {
+        filename=it->second;
       }
-    
     }
+    if (filename.empty()==false) {
+      stream->reset(new fl::table::TableStream<TableType>());
+      (*stream)->Init(filename, stream_block_size_, stream_window_);
+      return;
+    }
+    boost::shared_ptr<TableType> table;
+    Attach(name, &table);
+    stream->reset(new fl::table::TableStream<TableType>());
+    (*stream)->Init(table);
   }
 
   template<typename TableType>
   void WorkSpace::TryToAttach(const std::string &name) {
-    boost::mutex* mutex;
-    global_mutex_.lock();
-    bool is_name_in_map=mutex_map_.count(name)==0;
-    global_mutex_.unlock();
-    if (is_name_in_map) {
-      mutex=new boost::mutex();
-      global_mutex_.lock();
-      mutex_map_[name].reset(mutex);
-      global_mutex_.unlock();
-      mutex->lock();
-    } else {
-      global_mutex_.lock();
-      mutex=mutex_map_[name].get();
-      global_mutex_.unlock();      
+    boost::shared_ptr<TableLock> table_lock=GetTableLock(name);
+    table_lock->WaitUntilReady();
+    boost::shared_lock<TableLock> lock(*table_lock);
+    boost::shared_lock<boost::shared_mutex> global_lock(global_mutex_);
+    std::map<std::string, boost::any>::iterator it=var_map_.find(name);
+    if (it==var_map_.end()) {
+      throw fl::TypeException();
     }
-    mutex->lock();
     try {
-      boost::shared_ptr<TableType> table;
-      global_mutex_.lock();
-      table=boost::any_cast<boost::shared_ptr<TableType> >(var_map_[name]);
-      global_mutex_.unlock();
+      boost::any_cast<boost::shared_ptr<TableType> >(it->second);
     }
     catch(const boost::bad_any_cast &e) {
-      mutex->unlock();
-      global_mutex_.unlock();
       throw fl::TypeException();  
     }
-    mutex->unlock();
   }
 
   template<typename TableType>
@@ -232,28 +282,22 @@ namespace fl { namespace ws {
       const std::vector<index_t> sparse_sizes,
       const index_t num_of_points,
       boost::shared_ptr<TableType> *table) {
-    boost::mutex* mutex;
-    global_mutex_.lock();
-    bool  has_name=var_map_.count(name)!=0;
-    global_mutex_.unlock();
-    if (has_name) {
-      fl::logger->Die()<<"Workspace ("+workspace_name_+") already contains "
-        "variable: "+name;
+    boost::shared_ptr<TableType> new_table(new TableType());
+    new_table->Init(name, 
+        dense_sizes, sparse_sizes,
+        num_of_points);
+    boost::shared_ptr<TableLock> table_lock=GetTableLock(name);
+    {
+      boost::unique_lock<boost::shared_mutex> global_lock(global_mutex_);
+      if (var_map_.count(name)!=0) {
+        fl::logger->Die()<<"Workspace ("+workspace_name_+") already contains "
+          "variable: "+name;
+      }
+      // the table is busy until the producer purges it
+      table_lock->MarkBusy();
+      var_map_[name]=new_table;
     }
-    global_mutex_.lock();
-    if (mutex_map_.count(name)!=0) {
-      mutex=mutex_map_[name].get();
-    } else {
-      mutex=new boost::mutex();
-      mutex_map_[name].reset(mutex);
-    } 
-    mutex->try_lock();
-    var_map_[name]=boost::shared_ptr<TableType>(new TableType());
-    boost::any_cast<boost::shared_ptr<TableType> >(var_map_[name])->Init(name, 
-          dense_sizes, sparse_sizes,
-          num_of_points);
-    *table=boost::any_cast<boost::shared_ptr<TableType> >(var_map_[name]);
-    global_mutex_.unlock();
+    *table=new_table;
   }
  
   template<int Index,typename TableType1, typename TableType2, typename TableType3>
@@ -285,13 +329,14 @@ namespace fl { namespace ws {
         boost::shared_ptr<TableType2> *table2) {
 
     
-    var_map_[table1->filename()]=boost::shared_ptr<TableType2>(new TableType2());
-    boost::any_cast<boost::shared_ptr<
-      TableType2> >(var_map_[table1->filename()])->Init(table1->filename(), 
-          table1->dense_sizes(), table1->sparse_sizes(),
-          table1->n_entries());
-    *table2=boost::any_cast<
-      boost::shared_ptr<TableType2> >(var_map_[table1->filename()]);   
+    table2->reset(new TableType2());
+    (*table2)->Init(table1->filename(), 
+        table1->dense_sizes(), table1->sparse_sizes(),
+        table1->n_entries());
+    {
+      boost::unique_lock<boost::shared_mutex> global_lock(global_mutex_);
+      var_map_[table1->filename()]=*table2;
+    }
     typename TableType1::Point_t point1;
     typename TableType2::Point_t point2;
     for(index_t i=0; i<table1->n_entries(); ++i) {
@@ -305,6 +350,14 @@ namespace fl { namespace ws {
   void WorkSpace::SerializeFromDisk(const std::string &name, 
         boost::shared_ptr<TableType> *table) {
     boost::filesystem::path to_be_saved=FromTableNameToPath(name);
+    // the codec is found from the file, so the tables that were
+    // paged out before the codec changed can still be read
+    if (fl::data::IsBinaryTableFile(to_be_saved.string())) {
+      table->reset(new TableType());
+      (*table)->Init(to_be_saved.string(), "r");
+      (*table)->filename()=name;
+      return;
+    }
     std::ifstream ifs(to_be_saved.string().c_str(),
         std::ios::in|std::ios::binary);
     if (ifs.good()==false) {
@@ -313,7 +366,10 @@ namespace fl { namespace ws {
         <<") for reading table"; 
     }    
     boost::iostreams::filtering_streambuf<boost::iostreams::input> in;
-    in.push(boost::iostreams::gzip_decompressor());
+    // gzip files start with 0x1f 0x8b
+    if (ifs.peek()==0x1f) {
+      in.push(boost::iostreams::gzip_decompressor());
+    }
     in.push(ifs);
     boost::archive::binary_iarchive ia(in);
     table->reset(new TableType());
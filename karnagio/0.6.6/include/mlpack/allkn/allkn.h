@@ -33,11 +33,15 @@ POSSIBILITY OF SUCH DAMAGE.
 #ifndef FL_LITE_MLPACK_ALLKN_ALLKN_H
 #define FL_LITE_MLPACK_ALLKN_ALLKN_H
 
+#include <algorithm>
 #include <vector>
 #include <string>
 #include "fastlib/base/mpl.h"
 #include "fastlib/base/base.h"
+#include "fastlib/data/sparse_point.h"
 #include "fastlib/table/table.h"
+#include "fastlib/table/graph_index.h"
+#include "fastlib/metric_kernel/lmetric.h"
 #include "boost/mpl/if.hpp"
 #include "boost/mpl/int.hpp"
 #include "boost/mpl/insert.hpp"
@@ -49,6 +53,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "allkn_computations.h"
 #include "boost/shared_ptr.hpp"
 #include "boost/program_options.hpp"
+#include "boost/thread/mutex.hpp"
 
 class TestAllkN;
 namespace fl {
@@ -154,6 +159,8 @@ namespace ml {
         public:
           static const bool IS_RANGE_NEIGHBORS =
             !boost::is_integral<NeighborMethodType>::value;
+          typedef ContainerDistType ContainerDist_t;
+          typedef ContainerIndType ContainerInd_t;
     
           TreeArguments();
     
@@ -490,11 +497,112 @@ namespace ml {
                             NeighborMethodType kns,
                             ContainerDistType* neighbor_distances,
                             PointContainerType* neighbor_points);
+
+      /**
+       * @brief
+       * Computes the range neighbors, all the (query, reference) pairs
+       * closer than radius (further for furthest neighbors), without
+       * keeping them in memory. The query tree is split in subtrees and
+       * as soon as a subtree is done its pairs are handed to the sink as
+       * (*sink)(indices, distances), where indices is a
+       * std::vector<std::pair<index_t, index_t> > of (query, reference)
+       * pairs and distances the std::vector<CalcPrecision_t> of their
+       * squared distances. All the pairs of a query come in the same call.
+       * The subtrees are traversed on n_threads() threads, the sink is
+       * never called concurrently. Like the range neighbors of
+       * ComputeNeighbors, radius is compared to the squared distance
+       */
+      template<typename MetricType, typename SinkType>
+      void ComputeRangeJoin(const std::string &traversal_mode,
+                            const MetricType &metric,
+                            CalcPrecision_t radius,
+                            SinkType *sink);
   
  
       index_t num_of_prunes() const {
         return number_of_prunes_;
       }
+
+      /**
+       * @brief Sets the number of threads ComputeNeighbors uses for
+       *        the dual, single and naive traversals. The query tree
+       *        is split in subtrees that are traversed in parallel,
+       *        the results are the same as with a single thread. The
+       *        blocked and graph searches split the queries in blocks
+       */
+      void set_n_threads(int n_threads) {
+        n_threads_ = n_threads;
+      }
+
+      int n_threads() const {
+        return n_threads_;
+      }
+
+      /**
+       * @brief Sets the relative error of (1+epsilon) approximate
+       *        neighbors. Every neighbor found is at most (1+epsilon)
+       *        times further than the true neighbor of the same rank
+       *        (for furthest neighbors at least 1/(1+epsilon) as far).
+       *        0 gives exact neighbors
+       */
+      void set_epsilon(double epsilon) {
+        epsilon_ = epsilon;
+      }
+
+      double epsilon() const {
+        return epsilon_;
+      }
+
+      /**
+       * @brief Sets rank approximate neighbors. With probability alpha
+       *        every neighbor found is among the tau percent of the
+       *        references closest to the query. The reference nodes are
+       *        sampled instead of searched when that takes at most
+       *        sample_limit points. tau=0 gives exact neighbors
+       */
+      void set_rank_approximation(double tau, double alpha,
+                                  index_t sample_limit) {
+        tau_ = tau;
+        alpha_ = alpha;
+        sample_limit_ = sample_limit;
+      }
+
+      double tau() const {
+        return tau_;
+      }
+
+      double alpha() const {
+        return alpha_;
+      }
+
+      /**
+       * @brief After approximate neighbors are computed, that many queries
+       *        are searched exhaustively to measure the recall, 0 skips it
+       */
+      void set_recall_sample(index_t recall_sample) {
+        recall_sample_ = recall_sample;
+      }
+
+      /**
+       * @brief The fraction of the true k neighbors that the last
+       *        approximate computation found, on the recall sample.
+       *        It is 1 for exact computations
+       */
+      double recall() const {
+        return recall_;
+      }
+
+      /**
+       * @brief Sets the graph index of the references that
+       *        ComputeNeighbors searches with the "graph" traversal.
+       *        search_breadth is the number of candidates every query
+       *        keeps, bigger gives better recall and is slower
+       */
+      void set_graph(const fl::table::GraphIndex *graph,
+                     index_t search_breadth) {
+        graph_ = graph;
+        search_breadth_ = search_breadth;
+      }
   
       /**
        * @brief returns a pointer to the query_table
@@ -519,9 +627,204 @@ namespace ml {
       // The total number of prunes.
       index_t number_of_prunes_;
       std::vector<NeighborStatistic<CalcPrecision_t> > stat_; 
+      // The number of threads for ComputeNeighbors
+      int n_threads_;
+      // The approximation parameters
+      double epsilon_;
+      double tau_;
+      double alpha_;
+      index_t sample_limit_;
+      index_t recall_sample_;
+      double recall_;
+      // The graph index for the graph traversal
+      const fl::table::GraphIndex *graph_;
+      index_t search_breadth_;
+      /**
+       * @brief A query subtree together with the reference nodes it
+       *        is visited with, in the order of the single thread
+       *        traversal
+       */
+      struct QueryTask_ {
+        QueryTree_t *query_node;
+        std::vector<std::pair<ReferenceTree_t*, CalcPrecision_t> > references;
+      };
       template<typename TreeType, typename TableType, typename PrecisionType>
       void ResetStatisticsRecursion_(TreeType *node, TableType *table,
                                      PrecisionType value);
+
+      template<typename TraversalType, typename ArgsType>
+      void ComputeNeighbors_(const std::string &traversal_mode, 
+                             ArgsType *args);
+
+      template<typename TraversalType, typename ArgsType>
+      static void ComputeSingleThread_(const std::string &traversal_mode,
+                                       ArgsType *args);
+
+      template<typename TraversalType, typename ArgsType>
+      static void ComputeQueryTasks_(const std::string &traversal_mode,
+                                     const ArgsType *args,
+                                     std::vector<QueryTask_> *tasks,
+                                     index_t *next_task,
+                                     boost::mutex *task_mutex,
+                                     DynamicArguments_t *info);
+
+      template<typename MetricType>
+      void CollectQueryTasks_(const MetricType &metric,
+                              bool is_dual,
+                              DynamicArguments_t *info,
+                              QueryTree_t *query_node,
+                              ReferenceTree_t *reference_node,
+                              CalcPrecision_t bound_distance,
+                              int depth,
+                              std::vector<index_t> *task_ids,
+                              std::vector<QueryTask_> *tasks);
+
+      bool IsSampled_(DynamicArguments_t *info,
+                      ReferenceTree_t *reference_node) const;
+
+      void UpdateQueryBounds_(QueryTree_t *query_node, int depth);
+
+      /**
+       * @brief The sink ComputeNeighbors uses for range neighbors on
+       *        many threads, it appends the pairs to its containers
+       */
+      template<typename ContainerDistType, typename ContainerIndType>
+      struct RangeAppender_ {
+        RangeAppender_(ContainerDistType *distances,
+                       ContainerIndType *indices) :
+          distances_(distances), indices_(indices) {
+        }
+        void operator()(const ContainerIndType &indices,
+                        const ContainerDistType &distances) {
+          indices_->insert(indices_->end(), indices.begin(), indices.end());
+          distances_->insert(distances_->end(), distances.begin(),
+                             distances.end());
+        }
+        ContainerDistType *distances_;
+        ContainerIndType *indices_;
+      };
+
+      template<typename TraversalType, typename ArgsType, typename SinkType>
+      void ComputeRangeTasks_(const std::string &traversal_mode,
+                              ArgsType *args,
+                              SinkType *sink);
+
+      template<typename TraversalType, typename ArgsType, typename SinkType>
+      static void ComputeRangeQueryTasks_(const std::string &traversal_mode,
+                                          const ArgsType *args,
+                                          std::vector<QueryTask_> *tasks,
+                                          index_t *next_task,
+                                          boost::mutex *task_mutex,
+                                          DynamicArguments_t *info,
+                                          SinkType *sink,
+                                          boost::mutex *sink_mutex);
+
+      template<typename MetricType,
+               typename NeighborMethodType,
+               typename ContainerDistType,
+               typename ContainerIndType>
+      void ComputeGraphNeighbors_(const MetricType &metric,
+                                  NeighborMethodType kns,
+                                  ContainerDistType *neighbor_distances,
+                                  ContainerIndType *neighbor_indices,
+                                  boost::mpl::false_ is_range_neighbors);
+
+      template<typename MetricType,
+               typename NeighborMethodType,
+               typename ContainerDistType,
+               typename ContainerIndType>
+      void ComputeGraphNeighbors_(const MetricType &metric,
+                                  NeighborMethodType kns,
+                                  ContainerDistType *neighbor_distances,
+                                  ContainerIndType *neighbor_indices,
+                                  boost::mpl::true_ is_range_neighbors);
+
+      template<typename MetricType, typename ContainerDistType,
+               typename ContainerIndType>
+      static void SearchGraph_(const AllKN *allkn,
+                               const MetricType *metric,
+                               index_t kns,
+                               ContainerDistType *neighbor_distances,
+                               ContainerIndType *neighbor_indices,
+                               index_t *next_query,
+                               boost::mutex *query_mutex);
+
+      /**
+       * @brief The queries and the references are packed in dense
+       *        blocks of that many points for the blocked search
+       */
+      static const index_t kBlockedQueries_ = 64;
+      static const index_t kBlockedReferences_ = 512;
+
+      template<typename MetricType,
+               typename NeighborMethodType,
+               typename ContainerDistType,
+               typename ContainerIndType>
+      void ComputeBlockedNeighbors_(const MetricType &metric,
+                                    NeighborMethodType kns,
+                                    ContainerDistType *neighbor_distances,
+                                    ContainerIndType *neighbor_indices);
+
+      template<typename MetricType,
+               typename NeighborMethodType,
+               typename ContainerDistType,
+               typename ContainerIndType>
+      static void SearchBlocks_(const AllKN *allkn,
+                                const MetricType *metric,
+                                NeighborMethodType kns,
+                                const std::vector<CalcPrecision_t> *references,
+                                const std::vector<CalcPrecision_t> *reference_norms,
+                                ContainerDistType *neighbor_distances,
+                                ContainerIndType *neighbor_indices,
+                                index_t *next_query,
+                                boost::mutex *query_mutex);
+
+      template<typename ContainerDistType, typename ContainerIndType>
+      static void StoreBlockedNeighbors_(
+        index_t query_begin,
+        index_t kns,
+        std::vector<std::vector<std::pair<CalcPrecision_t, index_t> > >
+          *candidates,
+        ContainerDistType *neighbor_distances,
+        ContainerIndType *neighbor_indices,
+        boost::mutex *query_mutex,
+        boost::mpl::false_ is_range_neighbors);
+
+      template<typename ContainerDistType, typename ContainerIndType>
+      static void StoreBlockedNeighbors_(
+        index_t query_begin,
+        index_t kns,
+        std::vector<std::vector<std::pair<CalcPrecision_t, index_t> > >
+          *candidates,
+        ContainerDistType *neighbor_distances,
+        ContainerIndType *neighbor_indices,
+        boost::mutex *query_mutex,
+        boost::mpl::true_ is_range_neighbors);
+
+      static index_t RankApproximationSamples_(index_t n_references,
+                                               index_t kns,
+                                               double tau,
+                                               double alpha);
+
+      template<typename MetricType,
+               typename NeighborMethodType,
+               typename ContainerDistType,
+               typename ContainerIndType>
+      double ComputeRecall_(const MetricType &metric,
+                            NeighborMethodType kns,
+                            const ContainerDistType &neighbor_distances,
+                            const ContainerIndType &neighbor_indices,
+                            boost::mpl::false_ is_range_neighbors);
+
+      template<typename MetricType,
+               typename NeighborMethodType,
+               typename ContainerDistType,
+               typename ContainerIndType>
+      double ComputeRecall_(const MetricType &metric,
+                            NeighborMethodType kns,
+                            const ContainerDistType &neighbor_distances,
+                            const ContainerIndType &neighbor_indices,
+                            boost::mpl::true_ is_range_neighbors);
   
   }; //class AllkNN
   
@@ -565,6 +868,83 @@ namespace ml {
         };
         typedef AllKN<DefaultAllKNNMap> DefaultAllKNN;
         typedef AllKN<DefaultAllKFNMap> DefaultAllKFN;
+        /**
+         * @brief The sink of ComputeRangeJoin that writes the range
+         *        neighbors straight in the sparse output tables. All the
+         *        neighbors of a query come in the same call, so every
+         *        row is loaded at once
+         */
+        template<typename IndexTableType, typename DistanceTableType>
+        struct RangeTableSink {
+          RangeTableSink(IndexTableType *indices_table,
+                         DistanceTableType *distances_table) :
+            indices_table_(indices_table),
+            distances_table_(distances_table),
+            num_of_pairs_(0) {
+          }
+          template<typename ContainerIndType, typename ContainerDistType>
+          void operator()(const ContainerIndType &indices,
+                          const ContainerDistType &distances) {
+            std::vector<std::pair<std::pair<index_t, index_t>, double> >
+              pairs(indices.size());
+            for (size_t i = 0; i < indices.size(); ++i) {
+              pairs[i] = std::make_pair(indices[i], distances[i]);
+            }
+            std::sort(pairs.begin(), pairs.end());
+            typename IndexTableType::Point_t index_point;
+            typename DistanceTableType::Point_t dist_point;
+            std::vector<std::pair<index_t, int> > index_row;
+            std::vector<std::pair<index_t, double> > dist_row;
+            size_t i = 0;
+            while (i < pairs.size()) {
+              index_t query = pairs[i].first.first;
+              index_row.clear();
+              dist_row.clear();
+              for (; i < pairs.size() && pairs[i].first.first == query; ++i) {
+                index_row.push_back(std::make_pair(pairs[i].first.second, 1));
+                dist_row.push_back(std::make_pair(pairs[i].first.second,
+                                                  pairs[i].second));
+              }
+              indices_table_->get(query, &index_point);
+              SparsePart<int>(index_point).Load(index_row.begin(),
+                                                index_row.end());
+              distances_table_->get(query, &dist_point);
+              SparsePart<double>(dist_point).Load(dist_row.begin(),
+                                                  dist_row.end());
+            }
+            num_of_pairs_ += pairs.size();
+          }
+          /**
+           * @brief The rows of the sparse tables are either sparse
+           *        points or mixed points with a sparse part
+           */
+          template<typename PrecisionType, typename PointType>
+          static fl::data::SparsePoint<PrecisionType> &SparsePart(
+            PointType &point) {
+            return point.template sparse_point<PrecisionType>();
+          }
+          template<typename PrecisionType>
+          static fl::data::SparsePoint<PrecisionType> &SparsePart(
+            fl::data::SparsePoint<PrecisionType> &point) {
+            return point;
+          }
+          IndexTableType *indices_table_;
+          DistanceTableType *distances_table_;
+          index_t num_of_pairs_;
+        };
+        /**
+         * @brief Loads the graph index of the table from graph_file and
+         *        inserts the points that were appended to the table after
+         *        it was stored. If the file does not exist the graph is
+         *        built and stored there
+         */
+        template<typename MetricType>
+        static void IndexGraph(const TableType &table,
+                               const std::string &graph_file,
+                               index_t max_degree,
+                               index_t ef_construction,
+                               int n_threads,
+                               fl::table::GraphIndex *graph);
         template<typename DataAccessType>
         static int Main(DataAccessType *data,
                         boost::program_options::variables_map &vm);
@@ -57,12 +57,50 @@ struct DynamicArguments<SingleThreadAllKNTraversal> {
 public:
   DynamicArguments() {
     num_of_prunes_ = 0;
+    num_of_samples_ = 0;
+    prune_factor_ = 1.0;
+    sample_fraction_ = 0.0;
+    sample_limit_ = 0;
   }
   index_t &num_of_prunes() {
     return num_of_prunes_;
   }
+  /**
+   * @brief The number of reference points that were sampled instead
+   *        of searched, for rank approximate neighbors
+   */
+  index_t &num_of_samples() {
+    return num_of_samples_;
+  }
+  /**
+   * @brief The squared distance bounds are multiplied (divided for
+   *        furthest neighbors) by this factor before they are compared to
+   *        the neighbors found so far. For (1+epsilon) approximate neighbors
+   *        it is (1+epsilon)^2, 1 means exact pruning
+   */
+  double &prune_factor() {
+    return prune_factor_;
+  }
+  /**
+   * @brief The fraction of the points of a reference node that are sampled
+   *        when the node is not pruned. 0 means no sampling
+   */
+  double &sample_fraction() {
+    return sample_fraction_;
+  }
+  /**
+   * @brief A reference node is sampled only if it needs at most that
+   *        many samples, otherwise we descend to its children
+   */
+  index_t &sample_limit() {
+    return sample_limit_;
+  }
 private:
   index_t num_of_prunes_;
+  index_t num_of_samples_;
+  double prune_factor_;
+  double sample_fraction_;
+  index_t sample_limit_;
 };
 
 
@@ -90,14 +128,24 @@ class SingleThreadDualTreeAllKNBaseTrait;
 struct ALLKNMPL {
   struct UpdateOperator1 {
     struct type {
-      template < typename NeighborContainerType,
-      typename DistanceContainerType,
-      typename IndexContainerType >
-      static inline void InitTempNeighbors(NeighborContainerType *neighbors,
-                                           index_t ind,
-                                           index_t offset,
-                                           DistanceContainerType &distances,
-                                           IndexContainerType &indices);
+      /**
+       * @brief The k neighbors of a query are kept sorted in their row
+       *        of the flat n_queries x k containers, best first. A
+       *        neighbor better than the last one shifts the worse ones
+       *        down by one, so the base cases need no temporary
+       *        containers and no sorting
+       */
+      template < AllKNMode mode,
+      typename Container1Type,
+      typename Container2Type,
+      typename CalcPrecisionType
+      >
+      static inline void InsertSorted(Container1Type *indices,
+                                      Container2Type *distances,
+                                      index_t neighbor_position,
+                                      index_t kns,
+                                      index_t neighbor,
+                                      CalcPrecisionType distance);
       template < typename Container1Type,
       typename Container2Type,
       typename CalcPrecisionType
@@ -113,14 +161,17 @@ struct ALLKNMPL {
 
   struct UpdateOperator2 {
     struct type {
-      template < typename NeighborContainerType,
-      typename DistanceContainerType,
-      typename IndexContainerType >
-      static inline void InitTempNeighbors(NeighborContainerType *neighbors,
-                                           index_t ind,
-                                           index_t offset,
-                                           DistanceContainerType &distances,
-                                           IndexContainerType &indices);
+      template < AllKNMode mode,
+      typename Container1Type,
+      typename Container2Type,
+      typename CalcPrecisionType
+      >
+      static inline void InsertSorted(Container1Type *indices,
+                                      Container2Type *distances,
+                                      index_t neighbor_position,
+                                      index_t kns,
+                                      index_t neighbor,
+                                      CalcPrecisionType distance);
       template < typename Container1Type,
       typename Container2Type,
       typename CalcPrecisionType
@@ -230,6 +281,33 @@ class SingleThreadAllKNTraversal {
       template<typename ArgsType>
       static inline void ComputeSingleNeighborsRecursion(ArgsType *args);
 
+      /**
+       * @brief Routines for rank approximate neighbors, a reference node
+       *        is replaced by a sample of its points
+       */
+      template<typename ArgsType>
+      static inline index_t NumOfSamples(ArgsType *args);
+
+      template<typename ArgsType>
+      static inline void ComputeDualSampledBaseCase(ArgsType *args,
+          index_t num_of_samples);
+
+      template<typename ArgsType>
+      static inline void ComputeSingleSampledBaseCase(ArgsType *args,
+          index_t num_of_samples);
+
+      static inline void SampleReferences(const ReferenceTable_t *table,
+                                          ReferenceTree_t *node,
+                                          std::size_t seed,
+                                          index_t num_of_samples,
+                                          std::vector<index_t> *positions);
+
+      template<typename ArgsType>
+      static inline void InsertNeighbor(ArgsType *args,
+                                        index_t ind,
+                                        index_t neighbor,
+                                        CalcPrecision_t distance);
+
       /**
        *  @brief Routines for progressive computations for neighbors
        */
@@ -27,15 +27,20 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <string>
 #include <iostream>
+#include <numeric>
 #include "allkn.h"
+#include "fastlib/table/default/dense/labeled/covertree/table.h"
 #include "fastlib/base/base.h"
 #include "boost/mpl/void.hpp"
 #include "fastlib/util/timer.h"
 #include "fastlib/metric_kernel/lmetric.h"
 #include "fastlib/metric_kernel/weighted_lmetric_dev.h"
 #include "fastlib/metric_kernel/hellinger_metric.h"
+#include "fastlib/metric_kernel/cosine_metric.h"
+#include "boost/filesystem.hpp"
 #include "mlpack/mnnclassifier/mnnclassifier_defs.h"
 #include "fastlib/workspace/task.h"
+#include "fastlib/workspace/arguments.h"
 
 namespace fl {
 namespace ml {
@@ -65,6 +70,17 @@ int AllKN<boost::mpl::void_>::Core<TableType>::Main(
   index_t auc_label=1; 
   std::string roc_out="";
   index_t max_trace_size=0;
+  int threads=1;
+  double epsilon=0;
+  double tau=0;
+  double alpha=0.95;
+  index_t sample_limit=20;
+  index_t recall_sample=0;
+  std::string graph_file;
+  index_t graph_degree=16;
+  index_t graph_ef_construction=100;
+  index_t search_breadth=100;
+  index_t blocked_dimension=50;
   try {
 	// warnings and missing
     if (!vm.count("references_in") && vm["method"].as<std::string>() != "classification") {
@@ -96,6 +112,17 @@ int AllKN<boost::mpl::void_>::Core<TableType>::Main(
     auc_label=vm["auc_label"].as<int>();
     roc_out=vm["roc_out"].as<std::string>();
     max_trace_size=vm["max_trace_size"].as<index_t>();
+    threads=vm["threads"].as<int>();
+    epsilon=vm["epsilon"].as<double>();
+    tau=vm["tau"].as<double>();
+    alpha=vm["alpha"].as<double>();
+    sample_limit=vm["sample_limit"].as<index_t>();
+    recall_sample=vm["recall_sample"].as<index_t>();
+    graph_file=vm["graph_file"].as<std::string>();
+    graph_degree=vm["graph_degree"].as<index_t>();
+    graph_ef_construction=vm["graph_ef_construction"].as<index_t>();
+    search_breadth=vm["search_breadth"].as<index_t>();
+    blocked_dimension=vm["blocked_dimension"].as<index_t>();
 	  if(distances_out == "") {
 		  fl::logger->Warning() << "No --distances_out argument. Nearest Neighbor distances will not be output";
 	  }
@@ -112,6 +139,45 @@ int AllKN<boost::mpl::void_>::Core<TableType>::Main(
   }
   
 
+  if (epsilon < 0) {
+    fl::logger->Die() << "--epsilon must be non negative";
+  }
+  if (tau < 0 || tau > 100) {
+    fl::logger->Die() << "--tau must be a percentage between 0 and 100";
+  }
+  if (alpha <= 0 || alpha >= 1) {
+    fl::logger->Die() << "--alpha must be between 0 and 1";
+  }
+  if (metric=="cosine" && algorithm!="graph") {
+    fl::logger->Die() << "--metric=cosine is supported only with --algorithm=graph";
+  }
+  if (algorithm=="graph") {
+    if (method!="nearest" && method!="nnclassification") {
+      fl::logger->Die() << "--algorithm=graph finds only nearest neighbors";
+    }
+    if (k_neighbors < 0) {
+      fl::logger->Die() << "--algorithm=graph needs --k_neighbors";
+    }
+    if (iterations >= 0) {
+      fl::logger->Die() << "--algorithm=graph does not run progressively, "
+        "--iterations must not be set";
+    }
+    if (graph_degree < 2) {
+      fl::logger->Die() << "--graph_degree must be at least 2";
+    }
+    if (search_breadth <= 0) {
+      fl::logger->Die() << "--search_breadth must be positive";
+    }
+  }
+  if (algorithm=="blocked") {
+    if (metric!="l2") {
+      fl::logger->Die() << "--algorithm=blocked is supported only with --metric=l2";
+    }
+    if (iterations >= 0) {
+      fl::logger->Die() << "--algorithm=blocked does not run progressively, "
+        "--iterations must not be set";
+    }
+  }
   if (k_neighbors < 0 && r_neighbors < 0) {
     fl::logger->Die() << "You must give either --k_neighbors or --r_neighbors";
     return 1;
@@ -130,7 +196,20 @@ int AllKN<boost::mpl::void_>::Core<TableType>::Main(
     fl::util::Timer timer;
     timer.Start();
     data->Attach(references_in, &reference_table);
-    if (reference_table->is_indexed()==false) {
+    if (vm["algorithm"].defaulted() && metric=="l2" && iterations < 0
+        && epsilon==0 && tau==0 && blocked_dimension >= 0
+        && reference_table->n_attributes() > blocked_dimension) {
+      const std::vector<index_t> sparse_sizes=reference_table->sparse_sizes();
+      if (std::accumulate(sparse_sizes.begin(), sparse_sizes.end(), 0)==0) {
+        fl::logger->Message() << "The references have "
+          << reference_table->n_attributes() << " dimensions, more than "
+          << "--blocked_dimension=" << blocked_dimension
+          << ", switching to --algorithm=blocked";
+        algorithm="blocked";
+      }
+    }
+    if (reference_table->is_indexed()==false && algorithm!="graph"
+        && algorithm!="blocked") {
       fl::logger->Die()<<"Reference table ("<<references_in
         <<")  is not indexed"; 
     }
@@ -460,6 +539,52 @@ int AllKN<boost::mpl::void_>::Core<TableType>::Main(
     return 0;   
   }
   
+  fl::table::GraphIndex graph;
+  fl::math::CosineMetric cosine_metric;
+  if (algorithm=="graph") {
+    if (metric=="l2") {
+      IndexGraph<fl::math::LMetric<2> >(*reference_table, graph_file,
+          graph_degree, graph_ef_construction, threads, &graph);
+    } else {
+      if (metric=="weighted_l2") {
+        IndexGraph<WLMetric_t>(*reference_table, graph_file,
+            graph_degree, graph_ef_construction, threads, &graph);
+      } else {
+        if (metric=="hellinger") {
+          IndexGraph<fl::math::HellingerMetric>(*reference_table, graph_file,
+              graph_degree, graph_ef_construction, threads, &graph);
+        } else {
+          if (metric=="cosine") {
+            IndexGraph<fl::math::CosineMetric>(*reference_table, graph_file,
+                graph_degree, graph_ef_construction, threads, &graph);
+          } else {
+            fl::logger->Die() << "Unrecognized metric " << metric;
+          }
+        }
+      }
+    }
+  }
+
+  // range neighbors are written in the sparse output tables while they
+  // are computed, only the progressive mode keeps them in memory
+  boost::shared_ptr<typename DataAccessType::DefaultSparseIntTable_t> range_indices_table;
+  boost::shared_ptr<typename DataAccessType::DefaultSparseDoubleTable_t> range_dists_table;
+  if (k_neighbors < 0) {
+    data->Attach(indices_out,
+                 std::vector<index_t>(),
+                 std::vector<index_t>(1, reference_table->n_entries()),
+                 query_table==NULL?reference_table->n_entries():query_table->n_entries(),
+                 &range_indices_table);
+    data->Attach(distances_out,
+                 std::vector<index_t>(),
+                 std::vector<index_t>(1, reference_table->n_entries()),
+                 query_table==NULL?reference_table->n_entries():query_table->n_entries(),
+                 &range_dists_table);
+  }
+  RangeTableSink<typename DataAccessType::DefaultSparseIntTable_t,
+    typename DataAccessType::DefaultSparseDoubleTable_t> range_sink(
+      range_indices_table.get(), range_dists_table.get());
+
   fl::logger->Message() << "Running neighbors task.";
   fl::util::Timer timer;
   timer.Start();
@@ -470,6 +595,11 @@ int AllKN<boost::mpl::void_>::Core<TableType>::Main(
     } else {
       allknn.Init(reference_table.get(), NULL);
     }
+    allknn.set_n_threads(threads);
+    allknn.set_epsilon(epsilon);
+    allknn.set_rank_approximation(tau, alpha, sample_limit);
+    allknn.set_recall_sample(recall_sample);
+    allknn.set_graph(&graph, search_breadth);
 
     if (k_neighbors >= 0) {
       fl::logger->Message() << "Finding k=" << k_neighbors
@@ -498,6 +628,15 @@ int AllKN<boost::mpl::void_>::Core<TableType>::Main(
               k_neighbors,
               &dist_neighbors,
               &k_ind_neighbors);
+            } else {
+              if (metric=="cosine") {
+                allknn.ComputeNeighbors(
+                  algorithm,
+                  cosine_metric,
+                  k_neighbors,
+                  &dist_neighbors,
+                  &k_ind_neighbors);
+              }
             }
           } 
         }
@@ -564,28 +703,25 @@ int AllKN<boost::mpl::void_>::Core<TableType>::Main(
 
       if (iterations < 0) {
         if (metric=="l2") {
-          allknn.ComputeNeighbors(
+          allknn.ComputeRangeJoin(
             algorithm,
             l_index_args.metric,
             r_neighbors,
-            &dist_neighbors,
-            &r_ind_neighbors);
+            &range_sink);
         } else {
           if (metric=="weighted_l2") {
-            allknn.ComputeNeighbors(
+            allknn.ComputeRangeJoin(
               algorithm,
               w_index_args.metric,
               r_neighbors,
-              &dist_neighbors,
-              &r_ind_neighbors);
+              &range_sink);
           } else {
             if (metric=="hellinger") {
-              allknn.ComputeNeighbors(
+              allknn.ComputeRangeJoin(
                 algorithm,
                 hel_index_args.metric,
                 r_neighbors,
-                &dist_neighbors,
-                &r_ind_neighbors);
+                &range_sink);
             }          
           }              
         }
@@ -650,6 +786,10 @@ int AllKN<boost::mpl::void_>::Core<TableType>::Main(
       } else {
         allknn.Init(reference_table.get(), NULL);
       }
+      allknn.set_n_threads(threads);
+      allknn.set_epsilon(epsilon);
+      allknn.set_rank_approximation(tau, alpha, sample_limit);
+      allknn.set_recall_sample(recall_sample);
       if (k_neighbors >= 0) {
         fl::logger->Message() << "Finding k=" << k_neighbors
         << " furthest neighbors.";
@@ -737,28 +877,25 @@ int AllKN<boost::mpl::void_>::Core<TableType>::Main(
         << r_neighbors << ".";
         if (iterations < 0) {
           if (metric=="l2") {
-            allknn.ComputeNeighbors(
+            allknn.ComputeRangeJoin(
               algorithm,
               l_index_args.metric,
               r_neighbors,
-              &dist_neighbors,
-              &r_ind_neighbors);
+              &range_sink);
           } else {
             if (metric=="weighted_l2") {
-              allknn.ComputeNeighbors(
+              allknn.ComputeRangeJoin(
                 algorithm,
                 w_index_args.metric,
                 r_neighbors,
-                &dist_neighbors,
-                &r_ind_neighbors);
+                &range_sink);
             } else {
               if (metric=="hellinger") {
-                allknn.ComputeNeighbors(
+                allknn.ComputeRangeJoin(
                   algorithm,
                   hel_index_args.metric,
                   r_neighbors,
-                  &dist_neighbors,
-                  &r_ind_neighbors);
+                  &range_sink);
               }           
             }        
           }
@@ -976,22 +1113,16 @@ int AllKN<boost::mpl::void_>::Core<TableType>::Main(
     }
   }
   else { // r_neighbors >= 0.0
-    boost::shared_ptr<typename DataAccessType::DefaultSparseIntTable_t> indices_output_table;
-    data->Attach(indices_out,
-                 std::vector<index_t>(),
-                 std::vector<index_t>(1, reference_table->n_entries()),
-                 query_table==NULL?reference_table->n_entries():query_table->n_entries(),
-                 &indices_output_table);
-
-    boost::shared_ptr<typename DataAccessType::DefaultSparseDoubleTable_t> dists_output_table;
-    data->Attach(distances_out,
-       std::vector<index_t>(),
-       std::vector<index_t>(1, reference_table->n_entries()),
-       query_table==NULL?reference_table->n_entries():query_table->n_entries(),
-       &dists_output_table);
+    boost::shared_ptr<typename DataAccessType::DefaultSparseIntTable_t>
+      indices_output_table = range_indices_table;
+    boost::shared_ptr<typename DataAccessType::DefaultSparseDoubleTable_t>
+      dists_output_table = range_dists_table;
 
-    fl::logger->Message() << "Got " << dist_neighbors.size() <<
-    " results for range neighbor";
+    fl::logger->Message() << "Got "
+    << dist_neighbors.size() + range_sink.num_of_pairs_
+    << " results for range neighbor";
+    // the progressive mode leaves the neighbors in dist_neighbors
+    // and r_ind_neighbors
     for (unsigned int i = 0; i < dist_neighbors.size(); ++i) {
       typename DataAccessType::DefaultSparseIntTable_t::Point_t index_point;
       typename DataAccessType::DefaultSparseDoubleTable_t::Point_t dist_point;
@@ -1124,6 +1255,44 @@ int AllKN<boost::mpl::void_>::Core<TableType>::Main(
 }
 
 
+template<typename TableType>
+template<typename MetricType>
+void AllKN<boost::mpl::void_>::Core<TableType>::IndexGraph(
+    const TableType &table,
+    const std::string &graph_file,
+    index_t max_degree,
+    index_t ef_construction,
+    int n_threads,
+    fl::table::GraphIndex *graph) {
+  fl::table::GraphIndex::IndexArgs<MetricType> args;
+  args.max_degree=max_degree;
+  args.ef_construction=ef_construction;
+  args.n_threads=n_threads;
+  fl::util::Timer timer;
+  timer.Start();
+  if (graph_file!="" && boost::filesystem::exists(graph_file)) {
+    fl::logger->Message() << "Loading the graph index from " << graph_file;
+    graph->Load(graph_file);
+    if (graph->n_entries() < table.n_entries()) {
+      fl::logger->Message() << "Inserting "
+        << table.n_entries()-graph->n_entries()
+        << " new references in the graph index";
+      graph->Insert(table, args);
+      graph->Save(graph_file);
+    }
+  } else {
+    fl::logger->Message() << "Building the graph index of the references";
+    graph->IndexData(table, args);
+    if (graph_file!="") {
+      fl::logger->Message() << "Storing the graph index in " << graph_file;
+      graph->Save(graph_file);
+    }
+  }
+  timer.End();
+  fl::logger->Message() << "Time taken to index the references with a graph: "
+    << timer.GetTotalElapsedTimeString().c_str();
+}
+
 template<typename DataAccessType, typename BranchType>
 int AllKN<boost::mpl::void_>::Main(
   DataAccessType *data,
@@ -1188,13 +1357,14 @@ int AllKN<boost::mpl::void_>::Main(
   )(
     "r_neighbors",
     boost::program_options::value<double>()->default_value(-1.0),
-    "The query radius for the all-range-neighbors method.\n"
+    "The query radius for the all-range-neighbors method, it is compared "
+    "to the squared distances, like the ones in --distances_out.\n"
     "One of --k_neighbors or --r_neighbors must be given."
   )(
     "metric",
     boost::program_options::value<std::string>()->default_value("l2"),
     "Metric function used by allkn.  One of:\n"
-    "  l2, weighted_l2, hellinger"
+    "  l2, weighted_l2, hellinger, cosine (only for --algorithm=graph)"
   )(
     "metric_weights_in",
     boost::program_options::value<std::string>()->default_value(""),
@@ -1208,7 +1378,31 @@ int AllKN<boost::mpl::void_>::Main(
     "algorithm",
     boost::program_options::value<std::string>()->default_value("dual"),
     "Algorithm used to compute neighbors.  One of:\n"
-    "  dual, single"
+    "  dual, single, graph, blocked\n"
+    "graph searches a navigable small world graph of the references, it "
+    "does not need the references indexed with a tree and it works well in "
+    "high dimensions, but the neighbors are approximate. "
+    "blocked compares blocks of queries with blocks of references through "
+    "matrix products, it is exact, it needs no tree and it is faster than "
+    "the trees in high dimensions. It works only with --metric=l2"
+  )(
+    "tree",
+    boost::program_options::value<std::string>()->default_value(""),
+    "The tree of the references and the queries, the default is the one "
+    "of their table.  One of:\n"
+    "  covertree\n"
+    "covertree moves the dense tables to cover trees, they prune better "
+    "than the kd-trees when the data has many dimensions but a low "
+    "intrinsic dimension"
+  )(
+    "split",
+    boost::program_options::value<std::string>()->default_value(""),
+    "The split rule of the trees of the references and the queries, the "
+    "default is the one of the tree.  One of:\n"
+    "  kd-trees: midpoint, sliding_midpoint, median, variance\n"
+    "  ball-trees: furthest, sampled\n"
+    "sliding_midpoint and variance build balanced trees on skewed data, "
+    "sampled picks the first ball-tree pivot on a sample, saving a scan"
   )("auc", 
     boost::program_options::value<bool>()->default_value("true"),
     "If this flag is set to true then the classifier computes the "
@@ -1230,6 +1424,70 @@ int AllKN<boost::mpl::void_>::Main(
     "max_trace_size",
     boost::program_options::value<index_t>()->default_value(std::numeric_limits<index_t>::max()),
     "when running in iterative mode, the trace can become too big, so we need to limit it" 
+  )(
+    "threads",
+    boost::program_options::value<int>()->default_value(1),
+    "number of threads for --algorithm=dual, single or naive. The query tree "
+    "is split in subtrees that are searched in parallel, the neighbors are "
+    "the same as with one thread. Range neighbors are streamed in the output "
+    "tables as the subtrees finish. "
+    "For --algorithm=graph the graph is also built with that many threads, "
+    "for --algorithm=blocked the threads take blocks of queries in turn"
+  )(
+    "graph_file",
+    boost::program_options::value<std::string>()->default_value(""),
+    "OPTIONAL file for the graph index of --algorithm=graph. If it exists "
+    "the graph is loaded from it and the references appended after it was "
+    "stored are inserted, otherwise the graph is built and stored there"
+  )(
+    "graph_degree",
+    boost::program_options::value<index_t>()->default_value(16),
+    "for --algorithm=graph, the maximum number of links of every point, "
+    "bigger gives better recall and a bigger and slower to build graph"
+  )(
+    "graph_ef_construction",
+    boost::program_options::value<index_t>()->default_value(100),
+    "for --algorithm=graph, the number of candidates searched when a point "
+    "is inserted in the graph, bigger gives a better graph and a slower build"
+  )(
+    "search_breadth",
+    boost::program_options::value<index_t>()->default_value(100),
+    "for --algorithm=graph, the number of candidates every query keeps, "
+    "bigger gives better recall and slower search"
+  )(
+    "blocked_dimension",
+    boost::program_options::value<index_t>()->default_value(50),
+    "when --algorithm is not given and the references are dense with more "
+    "dimensions than this, --algorithm=blocked is used. A negative value "
+    "never switches"
+  )(
+    "epsilon",
+    boost::program_options::value<double>()->default_value(0.0),
+    "relative error for approximate neighbors, every neighbor is at most "
+    "(1+epsilon) times further than the true neighbor of the same rank. "
+    "Nodes that cannot improve the neighbors by more than that are pruned. "
+    "0 finds exact neighbors"
+  )(
+    "tau",
+    boost::program_options::value<double>()->default_value(0.0),
+    "rank approximation, the neighbors are among the tau percent of the "
+    "references closest to the query with probability --alpha. The reference "
+    "nodes are sampled instead of searched. 0 finds exact neighbors"
+  )(
+    "alpha",
+    boost::program_options::value<double>()->default_value(0.95),
+    "the probability of the rank approximation guarantee for --tau"
+  )(
+    "sample_limit",
+    boost::program_options::value<index_t>()->default_value(20),
+    "for --tau, a reference node is sampled only when it needs at most that "
+    "many samples, otherwise it is searched further"
+  )(
+    "recall_sample",
+    boost::program_options::value<index_t>()->default_value(100),
+    "when --epsilon or --tau is set, that many queries are searched "
+    "exhaustively to report the recall of the approximate neighbors. "
+    "0 skips it"
   )(
     "log_tree_stats",
     boost::program_options::value<bool>()->default_value(true),
@@ -1238,6 +1496,7 @@ int AllKN<boost::mpl::void_>::Main(
     " or due to pathological data then there is not point in running nearest neighbors"
   );
 
+  fl::ws::AddWorkSpaceOptions(&desc);
   boost::program_options::variables_map vm;
   boost::program_options::command_line_parser clp(args);
   clp.style(boost::program_options::command_line_style::default_style
@@ -1274,6 +1533,15 @@ int AllKN<boost::mpl::void_>::Main(
       "precomputed neighbor indices.\n";
   }
  
+  if (vm["tree"].as<std::string>()!="" && 
+      vm["tree"].as<std::string>()!="covertree") {
+    fl::logger->Die() << "--tree can only be covertree";
+  }
+  // the workspace makes the cover tree tables, a file never loads as
+  // one, so the branch on the table type does not look for them
+  if (vm["tree"].as<std::string>()=="covertree") {
+    return Core<fl::table::dense::labeled::covertree::Table>::Main(data, vm);
+  }
   return BranchType::template BranchOnTable<AllKN<boost::mpl::void_>, DataAccessType>(data, vm);
 }
 
@@ -1289,7 +1557,7 @@ void fl::ml::AllKN<boost::mpl::void_>::Run(
        typename DataAccessType::Branch_t
       > 
   > task(data, args);
-  data->schedule(task); 
+  data->schedule(task, args);
 }
 
 }} // namespaces
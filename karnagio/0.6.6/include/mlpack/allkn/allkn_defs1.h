@@ -28,6 +28,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <string>
 #include <iostream>
 #include "allkn.h"
+#include "fastlib/table/default/dense/labeled/covertree/table.h"
 #include "fastlib/workspace/task.h"
 
 namespace fl {
@@ -98,13 +99,14 @@ int AllKN<boost::mpl::void_>::Main(
   )(
     "r_neighbors",
     boost::program_options::value<double>()->default_value(-1.0),
-    "The query radius for the all-range-neighbors method.\n"
+    "The query radius for the all-range-neighbors method, it is compared "
+    "to the squared distances, like the ones in --distances_out.\n"
     "One of --k_neighbors or --r_neighbors must be given."
   )(
     "metric",
     boost::program_options::value<std::string>()->default_value("l2"),
     "Metric function used by allkn.  One of:\n"
-    "  l2, weighted_l2, hellinger"
+    "  l2, weighted_l2, hellinger, cosine (only for --algorithm=graph)"
   )(
     "metric_weights_in",
     boost::program_options::value<std::string>()->default_value(""),
@@ -118,7 +120,22 @@ int AllKN<boost::mpl::void_>::Main(
     "algorithm",
     boost::program_options::value<std::string>()->default_value("dual"),
     "Algorithm used to compute neighbors.  One of:\n"
-    "  dual, single"
+    "  dual, single, graph, blocked\n"
+    "graph searches a navigable small world graph of the references, it "
+    "does not need the references indexed with a tree and it works well in "
+    "high dimensions, but the neighbors are approximate. "
+    "blocked compares blocks of queries with blocks of references through "
+    "matrix products, it is exact, it needs no tree and it is faster than "
+    "the trees in high dimensions. It works only with --metric=l2"
+  )(
+    "tree",
+    boost::program_options::value<std::string>()->default_value(""),
+    "The tree of the references and the queries, the default is the one "
+    "of their table.  One of:\n"
+    "  covertree\n"
+    "covertree moves the dense tables to cover trees, they prune better "
+    "than the kd-trees when the data has many dimensions but a low "
+    "intrinsic dimension"
   )("auc", 
     boost::program_options::value<bool>()->default_value("true"),
     "If this flag is set to true then the classifier computes the "
@@ -140,6 +157,70 @@ int AllKN<boost::mpl::void_>::Main(
     "max_trace_size",
     boost::program_options::value<index_t>()->default_value(std::numeric_limits<index_t>::max()),
     "when running in iterative mode, the trace can become too big, so we need to limit it" 
+  )(
+    "threads",
+    boost::program_options::value<int>()->default_value(1),
+    "number of threads for --algorithm=dual, single or naive. The query tree "
+    "is split in subtrees that are searched in parallel, the neighbors are "
+    "the same as with one thread. Range neighbors are streamed in the output "
+    "tables as the subtrees finish. "
+    "For --algorithm=graph the graph is also built with that many threads, "
+    "for --algorithm=blocked the threads take blocks of queries in turn"
+  )(
+    "graph_file",
+    boost::program_options::value<std::string>()->default_value(""),
+    "OPTIONAL file for the graph index of --algorithm=graph. If it exists "
+    "the graph is loaded from it and the references appended after it was "
+    "stored are inserted, otherwise the graph is built and stored there"
+  )(
+    "graph_degree",
+    boost::program_options::value<index_t>()->default_value(16),
+    "for --algorithm=graph, the maximum number of links of every point, "
+    "bigger gives better recall and a bigger and slower to build graph"
+  )(
+    "graph_ef_construction",
+    boost::program_options::value<index_t>()->default_value(100),
+    "for --algorithm=graph, the number of candidates searched when a point "
+    "is inserted in the graph, bigger gives a better graph and a slower build"
+  )(
+    "search_breadth",
+    boost::program_options::value<index_t>()->default_value(100),
+    "for --algorithm=graph, the number of candidates every query keeps, "
+    "bigger gives better recall and slower search"
+  )(
+    "blocked_dimension",
+    boost::program_options::value<index_t>()->default_value(50),
+    "when --algorithm is not given and the references are dense with more "
+    "dimensions than this, --algorithm=blocked is used. A negative value "
+    "never switches"
+  )(
+    "epsilon",
+    boost::program_options::value<double>()->default_value(0.0),
+    "relative error for approximate neighbors, every neighbor is at most "
+    "(1+epsilon) times further than the true neighbor of the same rank. "
+    "Nodes that cannot improve the neighbors by more than that are pruned. "
+    "0 finds exact neighbors"
+  )(
+    "tau",
+    boost::program_options::value<double>()->default_value(0.0),
+    "rank approximation, the neighbors are among the tau percent of the "
+    "references closest to the query with probability --alpha. The reference "
+    "nodes are sampled instead of searched. 0 finds exact neighbors"
+  )(
+    "alpha",
+    boost::program_options::value<double>()->default_value(0.95),
+    "the probability of the rank approximation guarantee for --tau"
+  )(
+    "sample_limit",
+    boost::program_options::value<index_t>()->default_value(20),
+    "for --tau, a reference node is sampled only when it needs at most that "
+    "many samples, otherwise it is searched further"
+  )(
+    "recall_sample",
+    boost::program_options::value<index_t>()->default_value(100),
+    "when --epsilon or --tau is set, that many queries are searched "
+    "exhaustively to report the recall of the approximate neighbors. "
+    "0 skips it"
   )(
     "log_tree_stats",
     boost::program_options::value<bool>()->default_value(true),
@@ -183,6 +264,15 @@ int AllKN<boost::mpl::void_>::Main(
       "precomputed neighbor indices.\n";
   }
  
+  if (vm["tree"].as<std::string>()!="" && 
+      vm["tree"].as<std::string>()!="covertree") {
+    fl::logger->Die() << "--tree can only be covertree";
+  }
+  // the workspace makes the cover tree tables, a file never loads as
+  // one, so the branch on the table type does not look for them
+  if (vm["tree"].as<std::string>()=="covertree") {
+    return Core<fl::table::dense::labeled::covertree::Table>::Main(data, vm);
+  }
   return BranchType::template BranchOnTable<AllKN<boost::mpl::void_>, DataAccessType>(data, vm);
 }
 
@@ -196,7 +286,7 @@ void fl::ml::AllKN<boost::mpl::void_>::Run(
       typename DataAccessType::Branch_t
     >
   > task(data, args);
-  data->schedule(task); 
+  data->schedule(task, args);
 }
 
 }} // namespaces
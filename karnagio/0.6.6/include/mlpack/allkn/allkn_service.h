@@ -0,0 +1,253 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef FL_LITE_MLPACK_ALLKN_ALLKN_SERVICE_H_
+#define FL_LITE_MLPACK_ALLKN_ALLKN_SERVICE_H_
+#include <deque>
+#include <string>
+#include <vector>
+// boost headers go first, fastlib/base/compiler.h defines expect and likely
+#include "boost/date_time/posix_time/posix_time.hpp"
+#include "boost/serialization/string.hpp"
+#include "boost/serialization/vector.hpp"
+#include "boost/scoped_ptr.hpp"
+#include "boost/shared_ptr.hpp"
+#include "boost/thread/condition_variable.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/thread/thread.hpp"
+#include "mlpack/allkn/allkn.h"
+#include "fastlib/communication/client.h"
+#include "fastlib/communication/server.h"
+#include "fastlib/communication/session_server.h"
+
+namespace fl {
+namespace ml {
+  /**
+   * @brief A batch of query points sent to the allkn service. The points
+   *        are dense and stored one after the other. A request with
+   *        stop set shuts the service down
+   */
+  struct KnnRequest {
+    public:
+      KnnRequest() : k(0), dimension(0), stop(false) {
+      }
+      index_t k;
+      index_t dimension;
+      std::vector<double> points;
+      bool stop;
+
+      template<typename Archive>
+      void serialize(Archive &ar, const unsigned int version) {
+        ar & k;
+        ar & dimension;
+        ar & points;
+        ar & stop;
+      }
+  };
+
+  /**
+   * @brief The answer to a KnnRequest, k indices and distances for every
+   *        query point, in the same layout allkn exports them. If the
+   *        request could not be served error says why
+   */
+  struct KnnResponse {
+    public:
+      std::vector<index_t> indices;
+      std::vector<double> distances;
+      std::string error;
+
+      template<typename Archive>
+      void serialize(Archive &ar, const unsigned int version) {
+        ar & indices;
+        ar & distances;
+        ar & error;
+      }
+  };
+
+  template<typename TemplateArgs>
+  class AllKNService;
+
+  /**
+   * @brief A long running k nearest neighbor service. The reference table
+   *        is loaded and indexed once and stays in memory. Clients keep a
+   *        connection open and send KnnRequests, the requests that arrive
+   *        close in time are merged in one query table and answered with a
+   *        single dual tree traversal
+   */
+  template<>
+  class AllKNService<boost::mpl::void_> {
+    public:
+      /**
+       * @brief Collects the requests of all the connections and answers
+       *        them in batches. A batch starts with the oldest request and
+       *        takes the ones that arrive in the next batch_window
+       *        microseconds, up to max_batch_points query points
+       */
+      template<typename TableType>
+      class QueryBatcher : private boost::noncopyable {
+        public:
+          QueryBatcher(TableType *references,
+                       index_t max_batch_points,
+                       int batch_window,
+                       index_t leaf_size,
+                       int n_threads);
+          ~QueryBatcher();
+          void Start();
+          void Stop();
+          /**
+           * @brief Blocks until the batch the request went in is computed
+           */
+          void Query(const KnnRequest &request, KnnResponse *response);
+          index_t num_of_batches() const;
+          index_t num_of_requests() const;
+
+        private:
+          struct Pending_ {
+            const KnnRequest *request;
+            KnnResponse *response;
+            bool done;
+          };
+          struct AllKNMap_ : public AllKNArgs {
+            typedef TableType QueryTableType;
+            typedef TableType ReferenceTableType;
+            typedef boost::mpl::int_<0>::type KNmode;
+          };
+          TableType *references_;
+          index_t max_batch_points_;
+          int batch_window_;
+          index_t leaf_size_;
+          int n_threads_;
+          std::deque<Pending_*> queue_;
+          index_t queued_points_;
+          bool stopped_;
+          index_t num_of_batches_;
+          index_t num_of_requests_;
+          mutable boost::mutex mutex_;
+          boost::condition_variable arrived_;
+          boost::condition_variable finished_;
+          boost::scoped_ptr<boost::thread> worker_;
+
+          void Run_();
+          void ComputeBatch_(const std::vector<Pending_*> &batch);
+      };
+
+      /**
+       * @brief The handler of the fl::com::SessionServer, the requests of
+       *        all the connections go to the batcher
+       */
+      template<typename TableType>
+      struct ResponderServer : private boost::noncopyable {
+        public:
+          typedef KnnRequest Request_t;
+          typedef KnnResponse Response_t;
+          ResponderServer(QueryBatcher<TableType> *batcher);
+          void operator()(const KnnRequest &request, KnnResponse *response);
+
+        private:
+          QueryBatcher<TableType> *batcher_;
+      };
+
+      /**
+       * @brief The responder of the fl::com::Client that sends the points
+       *        of a query table in requests of request_points points and
+       *        collects the neighbors
+       */
+      template<typename TableType>
+      struct ResponderClient : private boost::noncopyable {
+        public:
+          ResponderClient(const TableType *queries,
+                          index_t k,
+                          index_t request_points,
+                          std::vector<index_t> *indices,
+                          std::vector<double> *distances);
+          bool operator()(const boost::system::error_code& e,
+                          fl::com::connection_ptr conn);
+
+        private:
+          const TableType *queries_;
+          index_t k_;
+          index_t request_points_;
+          std::vector<index_t> *indices_;
+          std::vector<double> *distances_;
+      };
+
+      /**
+       * @brief The responder of the fl::com::Client that sends requests at
+       *        a fixed rate for a while and records their latency. The
+       *        latency is measured from the time the request was due, so
+       *        that a slow service is not hidden by the client waiting
+       */
+      template<typename TableType>
+      struct ResponderBenchmark : private boost::noncopyable {
+        public:
+          ResponderBenchmark(const TableType *queries,
+                             index_t k,
+                             index_t request_points,
+                             double interval,
+                             double duration,
+                             index_t first_query,
+                             std::vector<double> *latencies);
+          bool operator()(const boost::system::error_code& e,
+                          fl::com::connection_ptr conn);
+
+        private:
+          const TableType *queries_;
+          index_t k_;
+          index_t request_points_;
+          double interval_;
+          double duration_;
+          index_t first_query_;
+          std::vector<double> *latencies_;
+      };
+
+      /**
+       * @brief Depending on --mode it runs the service, a client that
+       *        answers a query table through the service, a benchmark, or
+       *        it stops a running service
+       */
+      template<typename DataAccessType>
+      static int Main(DataAccessType *data,
+                      const std::vector<std::string> &args);
+
+    private:
+      template<typename TableType>
+      static void MakeRequest_(const TableType &queries,
+                               index_t first_query,
+                               index_t n_points,
+                               index_t k,
+                               KnnRequest *request);
+
+      /**
+       * @brief Connects to the service and runs the responder on its own
+       *        io_service, so that every client can have its own thread
+       */
+      template<typename ResponderType>
+      static void RunClient_(const std::string &host,
+                             const std::string &port,
+                             ResponderType *responder);
+  };
+}}
+
+#endif
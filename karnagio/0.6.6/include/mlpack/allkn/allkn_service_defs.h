@@ -0,0 +1,748 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef FL_LITE_MLPACK_ALLKN_ALLKN_SERVICE_DEFS_H_
+#define FL_LITE_MLPACK_ALLKN_ALLKN_SERVICE_DEFS_H_
+#include <algorithm>
+#include "boost/program_options.hpp"
+#include "mlpack/allkn/allkn_service.h"
+#include "mlpack/allkn/allkn_dev.h"
+#include "fastlib/util/string_utils.h"
+#include "fastlib/util/timer.h"
+#include "fastlib/workspace/arguments.h"
+
+namespace fl { namespace ml {
+
+template<typename TableType>
+AllKNService<boost::mpl::void_>::QueryBatcher<TableType>::QueryBatcher(
+    TableType *references,
+    index_t max_batch_points,
+    int batch_window,
+    index_t leaf_size,
+    int n_threads) :
+  references_(references),
+  max_batch_points_(max_batch_points),
+  batch_window_(batch_window),
+  leaf_size_(leaf_size),
+  n_threads_(n_threads),
+  queued_points_(0),
+  stopped_(true),
+  num_of_batches_(0),
+  num_of_requests_(0) {
+}
+
+template<typename TableType>
+AllKNService<boost::mpl::void_>::QueryBatcher<TableType>::~QueryBatcher() {
+  Stop();
+}
+
+template<typename TableType>
+void AllKNService<boost::mpl::void_>::QueryBatcher<TableType>::Start() {
+  boost::mutex::scoped_lock lock(mutex_);
+  if (worker_) {
+    return;
+  }
+  stopped_=false;
+  worker_.reset(new boost::thread(
+      boost::bind(&QueryBatcher<TableType>::Run_, this)));
+}
+
+template<typename TableType>
+void AllKNService<boost::mpl::void_>::QueryBatcher<TableType>::Stop() {
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stopped_=true;
+  }
+  arrived_.notify_all();
+  if (worker_) {
+    worker_->join();
+    worker_.reset();
+  }
+}
+
+template<typename TableType>
+void AllKNService<boost::mpl::void_>::QueryBatcher<TableType>::Query(
+    const KnnRequest &request, KnnResponse *response) {
+  response->indices.clear();
+  response->distances.clear();
+  response->error.clear();
+  const index_t dimension=references_->n_attributes();
+  if (request.k<=0 || request.k>references_->n_entries()) {
+    response->error="k must be between 1 and the number of references ("
+      +boost::lexical_cast<std::string>(references_->n_entries())+")";
+    return;
+  }
+  if (request.dimension!=dimension) {
+    response->error="the query points must have "
+      +boost::lexical_cast<std::string>(dimension)+" dimensions";
+    return;
+  }
+  if (request.points.empty() || request.points.size() % dimension!=0) {
+    response->error="the request must contain a whole number of points";
+    return;
+  }
+  Pending_ pending;
+  pending.request=&request;
+  pending.response=response;
+  pending.done=false;
+  boost::mutex::scoped_lock lock(mutex_);
+  if (stopped_) {
+    response->error="the service is shutting down";
+    return;
+  }
+  queue_.push_back(&pending);
+  queued_points_+=request.points.size()/dimension;
+  arrived_.notify_all();
+  while (pending.done==false) {
+    finished_.wait(lock);
+  }
+}
+
+template<typename TableType>
+index_t AllKNService<boost::mpl::void_>::QueryBatcher<TableType>::num_of_batches() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return num_of_batches_;
+}
+
+template<typename TableType>
+index_t AllKNService<boost::mpl::void_>::QueryBatcher<TableType>::num_of_requests() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return num_of_requests_;
+}
+
+template<typename TableType>
+void AllKNService<boost::mpl::void_>::QueryBatcher<TableType>::Run_() {
+  const index_t dimension=references_->n_attributes();
+  std::vector<Pending_*> batch;
+  while (true) {
+    batch.clear();
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      while (queue_.empty() && stopped_==false) {
+        arrived_.wait(lock);
+      }
+      if (stopped_) {
+        for(size_t i=0; i<queue_.size(); ++i) {
+          queue_[i]->response->error="the service is shutting down";
+          queue_[i]->done=true;
+        }
+        queue_.clear();
+        queued_points_=0;
+        finished_.notify_all();
+        return;
+      }
+      // give the requests that are on their way the chance to join the
+      // batch, a full batch does not wait
+      boost::system_time deadline=boost::get_system_time()
+        +boost::posix_time::microseconds(batch_window_);
+      while (queued_points_<max_batch_points_ && stopped_==false) {
+        if (arrived_.timed_wait(lock, deadline)==false) {
+          break;
+        }
+      }
+      index_t batch_points=0;
+      while (queue_.empty()==false) {
+        const index_t n_points=queue_.front()->request->points.size()/dimension;
+        if (batch.empty()==false && batch_points+n_points>max_batch_points_) {
+          break;
+        }
+        batch.push_back(queue_.front());
+        queue_.pop_front();
+        batch_points+=n_points;
+      }
+      queued_points_-=batch_points;
+    }
+    ComputeBatch_(batch);
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      for(size_t i=0; i<batch.size(); ++i) {
+        batch[i]->done=true;
+      }
+      num_of_batches_+=1;
+      num_of_requests_+=batch.size();
+    }
+    finished_.notify_all();
+  }
+}
+
+template<typename TableType>
+void AllKNService<boost::mpl::void_>::QueryBatcher<TableType>::ComputeBatch_(
+    const std::vector<Pending_*> &batch) {
+  const index_t dimension=references_->n_attributes();
+  index_t n_points=0;
+  index_t k=0;
+  for(size_t i=0; i<batch.size(); ++i) {
+    n_points+=batch[i]->request->points.size()/dimension;
+    k=std::max(k, batch[i]->request->k);
+  }
+  try {
+    TableType queries;
+    queries.Init(std::vector<index_t>(1, dimension),
+                 std::vector<index_t>(),
+                 n_points);
+    typename TableType::Point_t point;
+    index_t row=0;
+    for(size_t i=0; i<batch.size(); ++i) {
+      const std::vector<double> &points=batch[i]->request->points;
+      for(size_t j=0; j<points.size(); j+=dimension, ++row) {
+        queries.get(row, &point);
+        for(index_t d=0; d<dimension; ++d) {
+          point.set(d, points[j+d]);
+        }
+      }
+    }
+    typename TableType::template IndexArgs<fl::math::LMetric<2> > index_args;
+    index_args.leaf_size=leaf_size_;
+    queries.IndexData(index_args);
+
+    fl::math::LMetric<2> metric;
+    std::vector<double> distances;
+    std::vector<index_t> indices;
+    AllKN<AllKNMap_> allkn;
+    allkn.Init(references_, &queries);
+    allkn.set_n_threads(n_threads_);
+    allkn.ComputeNeighbors(std::string("dual"), metric, k,
+                           &distances, &indices);
+    // every request gets the first k of the neighbors of its points, they
+    // are sorted from the nearest to the furthest
+    row=0;
+    for(size_t i=0; i<batch.size(); ++i) {
+      const index_t request_k=batch[i]->request->k;
+      const index_t request_points=
+        batch[i]->request->points.size()/dimension;
+      KnnResponse *response=batch[i]->response;
+      response->indices.resize(request_points*request_k);
+      response->distances.resize(request_points*request_k);
+      for(index_t j=0; j<request_points; ++j, ++row) {
+        std::copy(indices.begin()+row*k,
+                  indices.begin()+row*k+request_k,
+                  response->indices.begin()+j*request_k);
+        std::copy(distances.begin()+row*k,
+                  distances.begin()+row*k+request_k,
+                  response->distances.begin()+j*request_k);
+      }
+    }
+  }
+  catch(const fl::Exception &exception) {
+    for(size_t i=0; i<batch.size(); ++i) {
+      batch[i]->response->indices.clear();
+      batch[i]->response->distances.clear();
+      batch[i]->response->error="the batch of the request failed";
+    }
+  }
+}
+
+template<typename TableType>
+AllKNService<boost::mpl::void_>::ResponderServer<TableType>::ResponderServer(
+    QueryBatcher<TableType> *batcher) :
+  batcher_(batcher) {
+}
+
+template<typename TableType>
+void AllKNService<boost::mpl::void_>::ResponderServer<TableType>::operator()(
+    const KnnRequest &request,
+    KnnResponse *response) {
+  batcher_->Query(request, response);
+}
+
+template<typename TableType>
+AllKNService<boost::mpl::void_>::ResponderClient<TableType>::ResponderClient(
+    const TableType *queries,
+    index_t k,
+    index_t request_points,
+    std::vector<index_t> *indices,
+    std::vector<double> *distances) :
+  queries_(queries),
+  k_(k),
+  request_points_(request_points),
+  indices_(indices),
+  distances_(distances) {
+}
+
+template<typename TableType>
+bool AllKNService<boost::mpl::void_>::ResponderClient<TableType>::operator()(
+    const boost::system::error_code& e,
+    fl::com::connection_ptr conn) {
+  conn->socket().set_option(boost::asio::ip::tcp::no_delay(true));
+  indices_->clear();
+  distances_->clear();
+  KnnRequest request;
+  KnnResponse response;
+  for(index_t i=0; i<queries_->n_entries(); i+=request_points_) {
+    MakeRequest_(*queries_, i,
+        std::min(request_points_, queries_->n_entries()-i), k_, &request);
+    if (fl::com::Exchange(conn, request, &response)==false) {
+      fl::logger->Die()<<"The service did not answer the queries";
+    }
+    indices_->insert(indices_->end(),
+        response.indices.begin(), response.indices.end());
+    distances_->insert(distances_->end(),
+        response.distances.begin(), response.distances.end());
+  }
+  return true;
+}
+
+template<typename TableType>
+AllKNService<boost::mpl::void_>::ResponderBenchmark<TableType>::ResponderBenchmark(
+    const TableType *queries,
+    index_t k,
+    index_t request_points,
+    double interval,
+    double duration,
+    index_t first_query,
+    std::vector<double> *latencies) :
+  queries_(queries),
+  k_(k),
+  request_points_(request_points),
+  interval_(interval),
+  duration_(duration),
+  first_query_(first_query),
+  latencies_(latencies) {
+}
+
+template<typename TableType>
+bool AllKNService<boost::mpl::void_>::ResponderBenchmark<TableType>::operator()(
+    const boost::system::error_code& e,
+    fl::com::connection_ptr conn) {
+  conn->socket().set_option(boost::asio::ip::tcp::no_delay(true));
+  KnnRequest request;
+  KnnResponse response;
+  const boost::posix_time::ptime start=
+    boost::posix_time::microsec_clock::universal_time();
+  for(index_t i=0; i*interval_<duration_; ++i) {
+    const boost::posix_time::ptime due=start
+      +boost::posix_time::microseconds(static_cast<int64>(i*interval_*1e6));
+    const boost::posix_time::ptime now=
+      boost::posix_time::microsec_clock::universal_time();
+    if (now<due) {
+      boost::this_thread::sleep(due-now);
+    }
+    MakeRequest_(*queries_,
+        (first_query_+i*request_points_) % queries_->n_entries(),
+        request_points_, k_, &request);
+    if (fl::com::Exchange(conn, request, &response)==false) {
+      break;
+    }
+    latencies_->push_back((boost::posix_time::microsec_clock::universal_time()
+          -due).total_microseconds()/1000.0);
+  }
+  return true;
+}
+
+template<typename TableType>
+void AllKNService<boost::mpl::void_>::MakeRequest_(const TableType &queries,
+    index_t first_query,
+    index_t n_points,
+    index_t k,
+    KnnRequest *request) {
+  fl::com::CopyPoints(queries, first_query, n_points, request);
+  request->k=k;
+}
+
+template<typename ResponderType>
+void AllKNService<boost::mpl::void_>::RunClient_(const std::string &host,
+    const std::string &port,
+    ResponderType *responder) {
+  try {
+    boost::asio::io_service io_service;
+    fl::com::Client<ResponderType> client(io_service, host, port, responder);
+    io_service.run();
+  }
+  catch(const fl::Exception &exception) {
+  }
+  catch(const std::exception &exception) {
+    fl::logger->Warning()<<"Client failed: "<<exception.what();
+  }
+}
+
+template<typename DataAccessType>
+int AllKNService<boost::mpl::void_>::Main(DataAccessType *data,
+    const std::vector<std::string> &args) {
+  typedef typename DataAccessType::DefaultTable_t Table_t;
+  boost::program_options::options_description desc("Available options");
+  desc.add_options()(
+    "help", "Print this information."
+  )(
+    "mode",
+    boost::program_options::value<std::string>()->default_value("server"),
+    "One of:\n"
+    "  server: keeps the references in memory and answers the queries of "
+    "the clients\n"
+    "  client: sends --queries_in to the service and exports the neighbors\n"
+    "  benchmark: sends requests at the rates of --qps and reports the "
+    "latency\n"
+    "  stop: stops a running service"
+  )(
+    "references_in",
+    boost::program_options::value<std::string>()->default_value(""),
+    "the reference points the service answers from. In the client and "
+    "benchmark modes it starts a service inside the same process on --port"
+  )(
+    "queries_in",
+    boost::program_options::value<std::string>()->default_value(""),
+    "the query points of the client and benchmark modes. The benchmark uses "
+    "the references if it is not set"
+  )(
+    "host",
+    boost::program_options::value<std::string>()->default_value("127.0.0.1"),
+    "the host the service runs on"
+  )(
+    "port",
+    boost::program_options::value<std::string>()->default_value("4554"),
+    "the port the service listens to"
+  )(
+    "k_neighbors",
+    boost::program_options::value<index_t>()->default_value(1),
+    "the number of nearest neighbors, the client and the benchmark ask for"
+  )(
+    "leaf_size",
+    boost::program_options::value<index_t>()->default_value(20),
+    "the leaf size of the trees built on the references and on every batch"
+  )(
+    "threads",
+    boost::program_options::value<int>()->default_value(1),
+    "the number of threads every batch is computed with"
+  )(
+    "batch_points",
+    boost::program_options::value<index_t>()->default_value(1024),
+    "the maximum number of query points answered by one traversal"
+  )(
+    "batch_window",
+    boost::program_options::value<int>()->default_value(500),
+    "microseconds the service waits for more requests before it starts a "
+    "batch that is not full"
+  )(
+    "request_points",
+    boost::program_options::value<index_t>()->default_value(1),
+    "the number of query points in every request of the client and the "
+    "benchmark"
+  )(
+    "indices_out",
+    boost::program_options::value<std::string>()->default_value(""),
+    "the nearest neighbor indices the client received"
+  )(
+    "distances_out",
+    boost::program_options::value<std::string>()->default_value(""),
+    "the nearest neighbor distances the client received, they are squared "
+    "l2 distances like allkn exports them"
+  )(
+    "qps",
+    boost::program_options::value<std::string>()->default_value("100,1000"),
+    "comma separated list of the request rates the benchmark runs at"
+  )(
+    "duration",
+    boost::program_options::value<double>()->default_value(5.0),
+    "seconds the benchmark runs every rate for"
+  )(
+    "clients",
+    boost::program_options::value<int>()->default_value(4),
+    "the number of connections of the benchmark, the rate is split among "
+    "them"
+  );
+
+  fl::ws::AddWorkSpaceOptions(&desc);
+  boost::program_options::variables_map vm;
+  boost::program_options::command_line_parser clp(args);
+  clp.style(boost::program_options::command_line_style::default_style
+     ^boost::program_options::command_line_style::allow_guessing );
+  try {
+    boost::program_options::store(clp.options(desc).run(), vm);
+  }
+  catch(const boost::program_options::invalid_option_value &e) {
+    fl::logger->Die() << "Invalid Argument: " << e.what();
+  }
+  catch(const boost::program_options::invalid_command_line_syntax &e) {
+    fl::logger->Die() << "Invalid command line syntax: " << e.what();
+  }
+  catch (const boost::program_options::unknown_option &e) {
+    fl::logger->Die() << e.what() << std::endl;
+  }
+  catch ( const boost::program_options::error &e) {
+    fl::logger->Die() << e.what();
+  }
+  boost::program_options::notify(vm);
+  if (vm.count("help")) {
+    std::cout << fl::DISCLAIMER << "\n";
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  const std::string mode=vm["mode"].as<std::string>();
+  const std::string references_in=vm["references_in"].as<std::string>();
+  const std::string queries_in=vm["queries_in"].as<std::string>();
+  const std::string host=vm["host"].as<std::string>();
+  const std::string port=vm["port"].as<std::string>();
+  const index_t k_neighbors=vm["k_neighbors"].as<index_t>();
+  const index_t leaf_size=vm["leaf_size"].as<index_t>();
+  const int n_threads=vm["threads"].as<int>();
+  const index_t batch_points=vm["batch_points"].as<index_t>();
+  const int batch_window=vm["batch_window"].as<int>();
+  const index_t request_points=vm["request_points"].as<index_t>();
+  const double duration=vm["duration"].as<double>();
+  const int n_clients=vm["clients"].as<int>();
+  if (mode!="server" && mode!="client" && mode!="benchmark" && mode!="stop") {
+    fl::logger->Die()<<"--mode="<<mode<<" is not supported";
+  }
+  if (mode=="server" && references_in=="") {
+    fl::logger->Die()<<"The service needs --references_in";
+  }
+  if (k_neighbors<=0) {
+    fl::logger->Die()<<"--k_neighbors must be positive";
+  }
+  if (leaf_size<=1) {
+    fl::logger->Die()<<"--leaf_size must be greater than 1";
+  }
+  if (n_threads<=0) {
+    fl::logger->Die()<<"--threads must be positive";
+  }
+  if (batch_points<=0) {
+    fl::logger->Die()<<"--batch_points must be positive";
+  }
+  if (batch_window<0) {
+    fl::logger->Die()<<"--batch_window can not be negative";
+  }
+  if (request_points<=0) {
+    fl::logger->Die()<<"--request_points must be positive";
+  }
+  if (duration<=0) {
+    fl::logger->Die()<<"--duration must be positive";
+  }
+  if (n_clients<=0) {
+    fl::logger->Die()<<"--clients must be positive";
+  }
+  std::vector<double> rates;
+  if (mode=="benchmark") {
+    std::vector<std::string> tokens=fl::SplitString(
+        vm["qps"].as<std::string>(), ",");
+    for(size_t i=0; i<tokens.size(); ++i) {
+      try {
+        rates.push_back(boost::lexical_cast<double>(tokens[i]));
+      }
+      catch(const boost::bad_lexical_cast &e) {
+        fl::logger->Die()<<"--qps="<<tokens[i]<<" is not a number";
+      }
+      if (rates.back()<=0) {
+        fl::logger->Die()<<"--qps must be positive";
+      }
+    }
+    if (rates.empty()) {
+      fl::logger->Die()<<"--qps is empty";
+    }
+  }
+
+  if (mode=="stop") {
+    boost::asio::io_service io_service;
+    fl::com::connection conn(io_service);
+    boost::asio::ip::tcp::resolver resolver(io_service);
+    boost::asio::ip::tcp::resolver::query query(host, port);
+    try {
+      boost::asio::connect(conn.socket(), resolver.resolve(query));
+      KnnRequest request;
+      request.stop=true;
+      conn.sync_write(request);
+    }
+    catch(const std::exception &e) {
+      fl::logger->Die()<<"Could not reach the service on "<<host<<":"<<port
+        <<", "<<e.what();
+    }
+    return 0;
+  }
+
+  // the service, in the client and the benchmark mode it runs next to them
+  // when the references are given
+  boost::shared_ptr<Table_t> references;
+  boost::scoped_ptr<QueryBatcher<Table_t> > batcher;
+  boost::asio::io_service io_service;
+  boost::scoped_ptr<ResponderServer<Table_t> > handler;
+  boost::scoped_ptr<fl::com::SessionServer<ResponderServer<Table_t> > >
+    responder;
+  boost::scoped_ptr<fl::com::Server<
+    fl::com::SessionServer<ResponderServer<Table_t> > > > server;
+  boost::scoped_ptr<boost::thread> server_thread;
+  if (references_in!="") {
+    fl::logger->Message()<<"Loading the references "<<references_in;
+    data->Attach(references_in, &references);
+    if (references->is_indexed()==false) {
+      fl::logger->Message()<<"Building the reference tree";
+      typename Table_t::template IndexArgs<fl::math::LMetric<2> > index_args;
+      index_args.leaf_size=leaf_size;
+      references->IndexData(index_args);
+    }
+    batcher.reset(new QueryBatcher<Table_t>(references.get(),
+          batch_points, batch_window, leaf_size, n_threads));
+    batcher->Start();
+    handler.reset(new ResponderServer<Table_t>(batcher.get()));
+    responder.reset(new fl::com::SessionServer<ResponderServer<Table_t> >(
+          handler.get(), &io_service));
+    server.reset(new fl::com::Server<
+        fl::com::SessionServer<ResponderServer<Table_t> > >(
+          io_service, port, responder.get()));
+    if (mode=="server") {
+      fl::logger->Message()<<"Answering "<<references->n_entries()
+        <<" references on port "<<port;
+      io_service.run();
+      fl::logger->Message()<<"Answered "<<batcher->num_of_requests()
+        <<" requests in "<<batcher->num_of_batches()<<" batches";
+      batcher->Stop();
+      responder->Join();
+      return 0;
+    }
+    server_thread.reset(new boost::thread(
+          boost::bind(&boost::asio::io_service::run, &io_service)));
+  }
+
+  boost::shared_ptr<Table_t> queries;
+  if (queries_in!="") {
+    data->Attach(queries_in, &queries);
+  } else if (mode=="benchmark" && references) {
+    queries=references;
+  } else {
+    fl::logger->Die()<<"--mode="<<mode<<" needs --queries_in";
+  }
+  if (queries->n_entries()==0) {
+    fl::logger->Die()<<"There are no queries in "<<queries_in;
+  }
+
+  if (mode=="client") {
+    std::vector<index_t> indices;
+    std::vector<double> distances;
+    fl::util::Timer timer;
+    timer.Start();
+    ResponderClient<Table_t> client(queries.get(), k_neighbors,
+        request_points, &indices, &distances);
+    RunClient_(host, port, &client);
+    timer.End();
+    if (static_cast<index_t>(indices.size())
+          ==queries->n_entries()*k_neighbors) {
+      fl::logger->Message()<<"Received the neighbors of "
+        <<queries->n_entries()<<" queries in "
+        <<timer.GetTotalElapsedTimeString().c_str();
+      std::string indices_out=vm["indices_out"].as<std::string>();
+      std::string distances_out=vm["distances_out"].as<std::string>();
+      if (indices_out=="") {
+        indices_out=data->GiveTempVarName();
+      }
+      if (distances_out=="") {
+        distances_out=data->GiveTempVarName();
+      }
+      boost::shared_ptr<typename DataAccessType::UIntegerTable_t>
+        indices_output_table;
+      data->Attach(indices_out,
+          std::vector<index_t>(1, k_neighbors),
+          std::vector<index_t>(),
+          queries->n_entries(),
+          &indices_output_table);
+      boost::shared_ptr<typename DataAccessType::DefaultTable_t>
+        dists_output_table;
+      data->Attach(distances_out,
+          std::vector<index_t>(1, k_neighbors),
+          std::vector<index_t>(),
+          queries->n_entries(),
+          &dists_output_table);
+      typename DataAccessType::UIntegerTable_t::Point_t index_point;
+      typename DataAccessType::DefaultTable_t::Point_t dist_point;
+      for(index_t i=0; i<queries->n_entries(); ++i) {
+        indices_output_table->get(i, &index_point);
+        dists_output_table->get(i, &dist_point);
+        for(index_t j=0; j<k_neighbors; ++j) {
+          index_point.set(j, indices[i*k_neighbors+j]);
+          dist_point.set(j, distances[i*k_neighbors+j]);
+        }
+      }
+      data->Purge(indices_out);
+      data->Detach(indices_out);
+      data->Purge(distances_out);
+      data->Detach(distances_out);
+    } else {
+      fl::logger->Warning()<<"The service did not answer all the queries";
+    }
+  }
+
+  if (mode=="benchmark") {
+    for(size_t r=0; r<rates.size(); ++r) {
+      std::vector<std::vector<double> > latencies(n_clients);
+      std::vector<boost::shared_ptr<ResponderBenchmark<Table_t> > >
+        clients(n_clients);
+      const index_t first_batch=batcher ? batcher->num_of_batches() : 0;
+      const index_t first_request=batcher ? batcher->num_of_requests() : 0;
+      const boost::posix_time::ptime start=
+        boost::posix_time::microsec_clock::universal_time();
+      boost::thread_group threads;
+      for(int c=0; c<n_clients; ++c) {
+        // every client starts from a different query, so that the batches
+        // are not made of the same point
+        clients[c].reset(new ResponderBenchmark<Table_t>(queries.get(),
+              k_neighbors, request_points, n_clients/rates[r], duration,
+              c*queries->n_entries()/n_clients, &latencies[c]));
+        threads.create_thread(boost::bind(
+              &AllKNService<boost::mpl::void_>::RunClient_<
+                ResponderBenchmark<Table_t> >,
+              host, port, clients[c].get()));
+      }
+      threads.join_all();
+      const double elapsed=(boost::posix_time::microsec_clock::universal_time()
+          -start).total_microseconds()/1e6;
+      std::vector<double> all_latencies;
+      for(int c=0; c<n_clients; ++c) {
+        all_latencies.insert(all_latencies.end(),
+            latencies[c].begin(), latencies[c].end());
+      }
+      if (all_latencies.empty()) {
+        fl::logger->Warning()<<"No request was answered at "<<rates[r]
+          <<" requests per second";
+        continue;
+      }
+      std::sort(all_latencies.begin(), all_latencies.end());
+      const size_t n=all_latencies.size();
+      fl::logger->Message()<<"Offered "<<rates[r]<<" requests/sec, achieved "
+        <<n/elapsed<<" requests/sec, latency p50="
+        <<all_latencies[n/2]<<"ms p99="
+        <<all_latencies[std::min(n-1, static_cast<size_t>(0.99*n))]
+        <<"ms max="<<all_latencies.back()<<"ms";
+      if (batcher) {
+        const index_t n_batches=batcher->num_of_batches()-first_batch;
+        if (n_batches>0) {
+          fl::logger->Message()<<"The service answered "
+            <<batcher->num_of_requests()-first_request<<" requests in "
+            <<n_batches<<" batches, "
+            <<static_cast<double>(batcher->num_of_requests()-first_request)
+              /n_batches<<" requests per batch";
+        }
+      }
+    }
+  }
+
+  if (server_thread) {
+    io_service.stop();
+    server_thread->join();
+    batcher->Stop();
+    responder->Join();
+  }
+  return 0;
+}
+
+}}
+
+#endif
@@ -81,6 +81,7 @@ namespace fl { namespace ml {
       "the number of points per cluster"  
     );
 
+    fl::ws::AddWorkSpaceOptions(&desc);
     boost::program_options::variables_map vm;
     std::vector<std::string> args1=fl::ws::MakeArgsFromPrefix(args_, "");
     boost::program_options::command_line_parser clp(args1);
@@ -283,7 +283,7 @@ void fl::ml::Cart<boost::mpl::void_>::Run(
       typename DataAccessType::Branch_t
     > 
   > task(data, args);
-  data->schedule(task); 
+  data->schedule(task, args);
 }
 
 #endif
@@ -33,6 +33,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "mlpack/xmeans/xmeans.h"
 #include "kmeans_cv.h"
 #include "kmeans_online.h"
+#include "kmeans_stream.h"
 #include "fastlib/util/timer.h"
 #include "fastlib/table/default/dense/unlabeled/balltree/table.h"
 #include "fastlib/workspace/task.h"
@@ -372,7 +373,103 @@ namespace fl {
           }
         }
   
-        if (k_clusters > 1) {
+        if (k_clusters > 1 && data->IsStreamed(references_in[0])) {
+          // the references do not fit in memory, every iteration is a 
+          // pass over the blocks of the file
+          if (references_in.size()!=1 || algorithm!="naive") {
+            fl::logger->Die()<<"Tables that are streamed can only be "
+              "clustered one at a time with --algorithm=naive";
+          }
+          if (centroids_in=="" && initialization!="random") {
+            fl::logger->Die()<<"kmeans++ needs random access to the points, "
+              "use --initialization=random for tables that are streamed";
+          }
+          fl::math::LMetric<2> metric;
+          std::vector<index_t> dense_sizes, sparse_sizes;
+          data->GetTableInfo(references_in[0], NULL, NULL, 
+              &dense_sizes, &sparse_sizes);
+          CentroidTable_t centroids;
+          centroids.Init(dense_sizes, sparse_sizes, k_clusters);
+          boost::shared_ptr<CentroidTable_t> best_centroids;
+          double min_distortion=std::numeric_limits<double>::max();
+          for(index_t i=0; i<n_restarts; ++i) {
+            if (centroids_in=="") {
+              fl::ml::KMeansStream::AssignInitialCentroids<TableType>(
+                  references_in[0], data, &centroids);
+            } else {
+              typename CentroidTable_t::Point_t point1, point2;
+              for(index_t k=0; k<k_clusters; ++k) {
+                initial_centroid_table->get(k, &point1);
+                centroids.get(k, &point2);
+                point2.template dense_point<typename CentroidTable_t::
+                  CalcPrecision_t>().CopyValues(point1);
+              }
+            }
+            double distortion=0;
+            index_t total_iterations=
+              fl::ml::KMeansStream::Run<TableType>(references_in[0],
+                data, metric, iterations, min_cluster_movement_threshold,
+                &centroids, &distortion);
+            fl::logger->Message() << "***** batch restart="<<i
+              <<", distortion="<<distortion
+              <<", iterations="<<total_iterations<<std::endl;
+            if (distortion<min_distortion) {
+              min_distortion=distortion;
+              best_centroids.reset(new CentroidTable_t());
+              best_centroids->Init(dense_sizes, sparse_sizes, k_clusters);
+              typename CentroidTable_t::Point_t point1, point2;
+              for(index_t k=0; k<k_clusters; ++k) {
+                centroids.get(k, &point1);
+                best_centroids->get(k, &point2);
+                point2.template dense_point<typename CentroidTable_t::
+                  CalcPrecision_t>().CopyValues(point1);
+              }
+            }
+          }
+          fl::logger->Message() << "Lowest Distortion found=" << min_distortion;
+          std::string final_centroids_out=centroids_out!="" ?
+            centroids_out : data->GiveTempVarName();
+          boost::shared_ptr<CentroidTable_t> centroids_table;
+          data->Attach(final_centroids_out, dense_sizes, sparse_sizes, 
+              k_clusters, &centroids_table);
+          typename CentroidTable_t::Point_t point1, point2;
+          for(index_t k=0; k<k_clusters; ++k) {
+            best_centroids->get(k, &point1);
+            centroids_table->get(k, &point2);
+            point2.template dense_point<typename CentroidTable_t::
+              CalcPrecision_t>().CopyValues(point1);
+          }
+          data->Purge(final_centroids_out);
+          data->Detach(final_centroids_out);
+          index_t n_entries=0;
+          data->GetTableInfo(references_in[0], &n_entries, NULL, NULL, NULL);
+          boost::shared_ptr<typename DataAccessType::UIntegerTable_t> memberships;
+          fl::logger->Message() << "Emitting cluster memberships to " 
+            << memberships_out[0];
+          data->Attach(memberships_out[0], 
+              std::vector<index_t>(1,1),
+              std::vector<index_t>(),
+              n_entries,
+              &memberships);
+          boost::shared_ptr<typename DataAccessType::DefaultTable_t> distortions;
+          if (distortions_out!="") {
+            fl::logger->Message()<<"Emitting centroid distortions to "
+              << distortions_out<<std::endl; 
+            data->Attach(distortions_out, 
+                std::vector<index_t>(1,1),
+                std::vector<index_t>(),
+                k_clusters,
+                &distortions); 
+          }
+          fl::ml::KMeansStream::Assign<TableType>(references_in[0], data, 
+              metric, *best_centroids, memberships.get(), distortions.get());
+          data->Purge(memberships_out[0]);
+          data->Detach(memberships_out[0]);
+          if (distortions_out!="") {
+            data->Purge(distortions_out);
+            data->Detach(distortions_out);
+          }
+        } else if (k_clusters > 1) {
           typename TableType::CalcPrecision_t min_distortion = std::numeric_limits<typename TableType::CalcPrecision_t>::max();
           fl::ml::KMeans<KMeansArgs<fl::math::LMetric<2>, 
           typename DataAccessType::DefaultTable_t> > *kmeans_final=NULL;
@@ -968,6 +1065,7 @@ namespace fl {
       "  silent: no logging"
       );
 
+    fl::ws::AddWorkSpaceOptions(&desc);
     boost::program_options::variables_map vm;
     boost::program_options::command_line_parser clp(args);
     clp.style(boost::program_options::command_line_style::default_style
@@ -1012,7 +1110,7 @@ namespace fl {
         typename DataAccessType::Branch_t
       >
     > task(data, args);
-    data->schedule(task); 
+    data->schedule(task, args);
   }
 
 
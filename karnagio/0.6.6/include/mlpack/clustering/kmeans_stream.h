@@ -0,0 +1,241 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef FL_LITE_INCLUDE_MLPACK_CLUSTERING_KMEANS_STREAM_H_
+#define FL_LITE_INCLUDE_MLPACK_CLUSTERING_KMEANS_STREAM_H_
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <string>
+#include <vector>
+#include "boost/shared_ptr.hpp"
+#include "fastlib/base/base.h"
+#include "fastlib/la/linear_algebra.h"
+#include "fastlib/table/table_stream.h"
+
+namespace fl { namespace ml {
+  /**
+   * @brief Naive kmeans for a table that is read as a stream of blocks,
+   *        because it does not fit in memory. Every Lloyd iteration is 
+   *        one pass over the stream and only the centroids and their sums
+   *        are kept in memory
+   */
+  class KMeansStream {
+    public:
+      /**
+       * @brief Sets the centroids to distinct random points of the table
+       */
+      template<typename TableType, 
+               typename WorkSpaceType, 
+               typename CentroidTableType>
+      static void AssignInitialCentroids(const std::string &references,
+          WorkSpaceType *ws,
+          CentroidTableType *centroids) {
+        index_t n_entries=0;
+        ws->GetTableInfo(references, &n_entries, NULL, NULL, NULL);
+        std::set<index_t> unique_ids;
+        while (static_cast<index_t>(unique_ids.size())<centroids->n_entries()) {
+          unique_ids.insert(fl::math::Random(index_t(0), n_entries-1));
+        }
+        // the ids are sorted, so they are all found in a single pass
+        std::vector<index_t> ids(unique_ids.begin(), unique_ids.end());
+        boost::shared_ptr<fl::table::TableStream<TableType> > stream;
+        ws->AttachStream(references, &stream);
+        boost::shared_ptr<TableType> table;
+        typename TableType::Point_t point;
+        typename CentroidTableType::Point_t cent;
+        index_t offset=0;
+        size_t next=0;
+        while (next<ids.size() && stream->NextBlock(&table)) {
+          while (next<ids.size() && ids[next]<offset+table->n_entries()) {
+            table->get(ids[next]-offset, &point);
+            centroids->get(next, &cent);
+            cent.template dense_point<
+              typename CentroidTableType::CalcPrecision_t>().SetAll(0);
+            for(typename TableType::Point_t::iterator it=point.begin();
+                it!=point.end(); ++it) {
+              cent.set(it.attribute(), it.value());
+            }
+            ++next;
+          }
+          offset+=table->n_entries();
+        }
+      }
+
+      /**
+       * @brief Runs Lloyd iterations until the centroids move less than
+       *        min_cluster_movement_threshold or until max_iterations.
+       *        It returns the number of iterations and the mean squared
+       *        distance of the points from their centroids
+       */
+      template<typename TableType, 
+               typename WorkSpaceType,
+               typename CentroidTableType,
+               typename MetricType>
+      static index_t Run(const std::string &references,
+          WorkSpaceType *ws,
+          const MetricType &metric,
+          index_t max_iterations,
+          double min_cluster_movement_threshold,
+          CentroidTableType *centroids,
+          double *distortion) {
+        typedef typename CentroidTableType::CalcPrecision_t CalcPrecision_t;
+        const index_t k_clusters=centroids->n_entries();
+        CentroidTableType sums;
+        sums.Init(centroids->data()->dense_sizes(),
+            centroids->data()->sparse_sizes(),
+            k_clusters);
+        std::vector<index_t> counts(k_clusters);
+        boost::shared_ptr<fl::table::TableStream<TableType> > stream;
+        ws->AttachStream(references, &stream);
+        typename TableType::Point_t point;
+        typename CentroidTableType::Point_t cent;
+        typename CentroidTableType::Point_t sum;
+        index_t iterations=0;
+        while (true) {
+          std::fill(counts.begin(), counts.end(), 0);
+          for(index_t k=0; k<k_clusters; ++k) {
+            sums.get(k, &sum);
+            sum.template dense_point<CalcPrecision_t>().SetAll(0);
+          }
+          *distortion=0;
+          index_t n_entries=0;
+          stream->Reset();
+          boost::shared_ptr<TableType> table;
+          while (stream->NextBlock(&table)) {
+            for(index_t i=0; i<table->n_entries(); ++i) {
+              table->get(i, &point);
+              double best_distance=0;
+              index_t best_centroid=Closest(metric, *centroids, point,
+                  &best_distance);
+              counts[best_centroid]+=1;
+              sums.get(best_centroid, &sum);
+              fl::la::AddExpert(CalcPrecision_t(1.0), point, 
+                  &sum.template dense_point<CalcPrecision_t>());
+              *distortion+=best_distance;
+            }
+            n_entries+=table->n_entries();
+          }
+          *distortion/=n_entries;
+          // the centroids that have no points do not move
+          double max_cluster_movement=0;
+          for(index_t k=0; k<k_clusters; ++k) {
+            if (counts[k]==0) {
+              continue;
+            }
+            centroids->get(k, &cent);
+            sums.get(k, &sum);
+            fl::la::SelfScale(1.0/counts[k], 
+                &sum.template dense_point<CalcPrecision_t>());
+            max_cluster_movement=std::max(max_cluster_movement,
+                static_cast<double>(metric.DistanceSq(
+                    cent.template dense_point<CalcPrecision_t>(),
+                    sum.template dense_point<CalcPrecision_t>())));
+            cent.template dense_point<CalcPrecision_t>().CopyValues(
+                sum.template dense_point<CalcPrecision_t>());
+          }
+          fl::logger->Debug() << "streamed naive iteration="<<iterations
+              <<", distortion="<<*distortion;
+          iterations++;
+          if (max_cluster_movement==0
+              || max_cluster_movement<min_cluster_movement_threshold
+              || (max_iterations!=-1 && iterations>max_iterations)) {
+            break;
+          }
+        }
+        fl::logger->Message() << "Total iterations: " << iterations;
+        return iterations;
+      }
+
+      /**
+       * @brief Writes the closest centroid of every point in memberships
+       *        and adds the squared distances of the points of every 
+       *        centroid in distortions. Both of them can be NULL
+       */
+      template<typename TableType, 
+               typename WorkSpaceType,
+               typename CentroidTableType,
+               typename MetricType,
+               typename MembershipTableType,
+               typename DistortionTableType>
+      static void Assign(const std::string &references,
+          WorkSpaceType *ws,
+          const MetricType &metric,
+          const CentroidTableType &centroids,
+          MembershipTableType *memberships,
+          DistortionTableType *distortions) {
+        boost::shared_ptr<fl::table::TableStream<TableType> > stream;
+        ws->AttachStream(references, &stream);
+        boost::shared_ptr<TableType> table;
+        typename TableType::Point_t point;
+        typename MembershipTableType::Point_t mpoint;
+        typename DistortionTableType::Point_t dpoint;
+        index_t offset=0;
+        while (stream->NextBlock(&table)) {
+          for(index_t i=0; i<table->n_entries(); ++i) {
+            table->get(i, &point);
+            double best_distance=0;
+            index_t best_centroid=Closest(metric, centroids, point, 
+                &best_distance);
+            if (memberships!=NULL) {
+              memberships->get(offset+i, &mpoint);
+              mpoint.set(0, best_centroid);
+            }
+            if (distortions!=NULL) {
+              distortions->get(best_centroid, &dpoint);
+              dpoint.set(0, dpoint[0]+best_distance);
+            }
+          }
+          offset+=table->n_entries();
+        }
+      }
+
+    private:
+      // ties go to the centroid with the lower index, like 
+      // KMeans::GetClosestCentroid
+      template<typename MetricType, 
+               typename CentroidTableType, 
+               typename PointType>
+      static index_t Closest(const MetricType &metric,
+          const CentroidTableType &centroids,
+          const PointType &point,
+          double *best_distance) {
+        typename CentroidTableType::Point_t cent;
+        index_t best_centroid=-1;
+        *best_distance=std::numeric_limits<double>::max();
+        for(index_t k=0; k<centroids.n_entries(); ++k) {
+          centroids.get(k, &cent);
+          double distance=metric.DistanceSq(cent.template dense_point<
+              typename CentroidTableType::CalcPrecision_t>(), point);
+          if (distance<*best_distance) {
+            *best_distance=distance;
+            best_centroid=k;
+          }
+        }
+        DEBUG_ASSERT(best_centroid!=-1);
+        return best_centroid;
+      }
+  };
+}}
+#endif
@@ -80,6 +80,7 @@ namespace fl {namespace ml{
       boost::program_options::value<index_t>()->default_value(5),
       "the restricted horizon for the dynamic time warping search"  
     );
+    fl::ws::AddWorkSpaceOptions(&desc);
     boost::program_options::variables_map vm;
     boost::program_options::command_line_parser clp(args_);
     clp.style(boost::program_options::command_line_style::default_style
@@ -106,6 +106,7 @@ int fl::ml::EnSvd<boost::mpl::void_>::Main(WorkSpaceType *ws, const std::vector<
   ); 
 
 
+  fl::ws::AddWorkSpaceOptions(&desc);
   boost::program_options::variables_map vm;
   std::vector<std::string> args1=fl::ws::MakeArgsFromPrefix(args, "");
   boost::program_options::command_line_parser clp(args1);
@@ -320,7 +321,7 @@ void fl::ml::EnSvd<boost::mpl::void_>::Run(
       typename WorkSpaceType::Branch_t
     > 
   > task(ws, args);
-  ws->schedule(task); 
+  ws->schedule(task, args);
 }
 
 template<typename WorkSpaceType>
@@ -108,6 +108,37 @@ namespace fl { namespace ml {
         bool make_symmetric, // switch for making the graph symmetric
         const std::string &graph_name // the graph table name 
         );
+
+      /**
+       * @brief Makes a graph out of the sparse distances of a range
+       *        neighbor search, in place. The range search writes its
+       *        pairs straight in the graph table, so there are no
+       *        indices and weights tables in between. A monochromatic
+       *        range search is already symmetric
+       */
+      template<typename EdgeFunctorType, typename GraphTableType>
+      static void MakeRangeGraph(WorkSpaceType *ws, // WorkSpace that contains
+                                                    // all the tables
+        const EdgeFunctorType *edge_functor, // function object that post
+                                             // processes the edge values
+        const std::string &normalization, // Normalization method for
+                                          // the outgoing edge weights
+                                          // for every node
+        const std::string &graph_name // the graph table name, it holds
+                                      // the range neighbor distances
+        );
+
+      template<typename GraphTableType>
+      static void MakeRangeGraph(WorkSpaceType *ws, // WorkSpace that contains
+                                                    // all the tables
+        const std::string &edge_option, // A string for the setting
+                                        /// the function object
+        const std::string &normalization, // Normalization method for
+                                          // the outgoing edge weights
+                                          // for every node
+        const std::string &graph_name // the graph table name, it holds
+                                      // the range neighbor distances
+        );
       
       /**
        * @brief Diffusion policies
@@ -267,6 +267,98 @@ namespace fl { namespace ml {
     }
   }
  
+  template<typename WorkSpaceType>
+  template<typename EdgeFunctorType, typename GraphTableType>
+  void GraphDiffuser<WorkSpaceType>::MakeRangeGraph(
+                WorkSpaceType *ws,
+                const EdgeFunctorType *edge_functor,
+                const std::string &normalization,
+                const std::string &graph_name) {
+    FL_SCOPED_LOG(MakeRangeGraph);
+    boost::shared_ptr<GraphTableType> graph;
+    ws->Attach(graph_name, &graph);
+    int norm=0;
+    if (normalization=="l1") {
+      norm=1;
+    } else {
+      if (normalization=="l2") {
+        norm=2;
+      } else {
+        if (normalization=="none") {
+          norm=3;
+        } else {
+          fl::logger->Die()<<"This graph normalization ("
+              <<normalization <<") is not supported";
+        }
+      }
+    }
+    typename GraphTableType::Point_t g_point;
+    std::vector<std::pair<index_t, double> > load_cont;
+    for(index_t i=0; i<graph->n_entries(); ++i) {
+      graph->get(i, &g_point);
+      load_cont.clear();
+      for(typename fl::data::SparsePoint<double>::Iterator
+          it=g_point.template sparse_point<double>().begin();
+          it!=g_point.template sparse_point<double>().end(); ++it) {
+        load_cont.push_back(std::make_pair(it->first, it->second));
+      }
+      if (edge_functor!=NULL) {
+        for(std::vector<std::pair<index_t, double> >::iterator
+            it=load_cont.begin(); it!=load_cont.end(); ++it) {
+          (*edge_functor)(&(it->second));
+        }
+      }
+      Normalize(load_cont.begin(), load_cont.end(), norm);
+      g_point.template sparse_point<double>().Load(load_cont.begin(),
+          load_cont.end());
+    }
+    ws->Purge(graph_name);
+    ws->Detach(graph_name);
+  }
+
+  template<typename WorkSpaceType>
+  template<typename GraphTableType>
+  void GraphDiffuser<WorkSpaceType>::MakeRangeGraph(
+                WorkSpaceType *ws,
+                const std::string &edge_option,
+                const std::string &normalization,
+                const std::string &graph_name) {
+    if (edge_option=="none") {
+      UnitEdge unit_edge;
+      MakeRangeGraph<UnitEdge, GraphTableType>(ws,
+        &unit_edge,
+        normalization,
+        graph_name);
+    } else {
+      if (edge_option=="dist") {
+        MakeRangeGraph<UnitEdge, GraphTableType>(ws,
+          NULL,
+          normalization,
+          graph_name);
+      } else {
+        if (edge_option=="1/dist") {
+          DistInvEdge dist_inv_edge;
+          MakeRangeGraph<DistInvEdge, GraphTableType>(ws,
+            &dist_inv_edge,
+            normalization,
+            graph_name);
+        } else {
+          if (edge_option=="exp(-dist/h)") {
+            GaussEdge func;
+            func.set_h(1.0);
+            MakeRangeGraph<GaussEdge, GraphTableType>(ws,
+              &func,
+              normalization,
+              graph_name);
+          } else {
+            fl::logger->Die()<<"--weight_policy="<<edge_option
+              <<" is not a valid option";
+          }
+        }
+      }
+    }
+  }
+ 
   template<typename WorkSpaceType>
   void GraphDiffuser<WorkSpaceType>::DotProdPolicy::Init(double val) {
     result_=val;
@@ -628,6 +720,9 @@ namespace fl { namespace ml {
       "         making sure that each node is symmetrically connected to its neighbors\n"
       "  nn  :  nonsymetric euclidean nearest neighbors. Builds a directed graph by computing\n"
       "         the k-nearest neighbors for every point.\n"
+      "  range:  connects every point with all the points within the radius\n"
+      "         given with --allkn:r_neighbors. The neighbors are streamed\n"
+      "         straight in the graph, the graph is symmetric\n"
     )("robust_nn",
       boost::program_options::value<bool>()->default_value(false),
       "If the summarization method is randomized then it might be a good idea "
@@ -726,6 +821,7 @@ namespace fl { namespace ml {
       "  combined   :  \n" 
     );
         
+    fl::ws::AddWorkSpaceOptions(&desc);
     boost::program_options::variables_map vm;
     std::vector<std::string> args1=fl::ws::MakeArgsFromPrefix(args_, "");
     boost::program_options::command_line_parser clp(args1);
@@ -923,11 +1019,30 @@ namespace fl { namespace ml {
           }        
         }
       } else {
-        if (connect_nodes=="none") {
-          // do nothing 
+        if (connect_nodes=="range") {
+          if (robust_nn==true) {
+            fl::logger->Die()<<"Robust range neighbors"
+              <<NOT_SUPPORTED_MESSAGE;
+          }
+          // the range neighbors are streamed straight in the graph
+          std::vector<std::string> nn_args1=nn_args;
+          nn_args1.push_back("--references_in="+allkn_references);
+          nn_args1.push_back("--indices_out="+indices_name);
+          nn_args1.push_back("--distances_out="+graph_name);
+          ws_->IndexAllReferencesQueries(&nn_args1);
+          fl::ml::AllKN<boost::mpl::void_>::Run(ws_, nn_args1);
+          GraphDiffuser<WorkSpaceType>::template
+          MakeRangeGraph<typename WorkSpaceType::DefaultSparseDoubleTable_t>(ws_,
+                    weight_policy,
+                    "none",
+                    graph_name);
         } else {
-          fl::logger->Die()<<"This option ("<<connect_nodes<<") "
-            "for --connect_nodes is not supported";
+          if (connect_nodes=="none") {
+            // do nothing 
+          } else {
+            fl::logger->Die()<<"This option ("<<connect_nodes<<") "
+              "for --connect_nodes is not supported";
+          }
         }
       }
     }
@@ -495,6 +495,7 @@ void fl::ml::GraphVis<boost::mpl::void_>::Core<WorkSpaceType>::operator()(
     "the url of the ubigraph server"
   );
 
+  fl::ws::AddWorkSpaceOptions(&desc);
   boost::program_options::variables_map vm;
   std::vector<std::string> args1=fl::ws::MakeArgsFromPrefix(args_, "");
   boost::program_options::command_line_parser clp(args1);
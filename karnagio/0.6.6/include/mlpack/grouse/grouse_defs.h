@@ -173,6 +173,7 @@ namespace fl {namespace ml {
       boost::program_options::value<std::string>(),
       "logs the magnitude of every update on the subspace"  
     );
+    fl::ws::AddWorkSpaceOptions(&desc);
     boost::program_options::variables_map vm;
     boost::program_options::command_line_parser clp(args_);
     clp.style(boost::program_options::command_line_style::default_style
@@ -440,6 +440,7 @@ namespace fl { namespace ml {
       boost::program_options::value<std::string>(),
       "This prefix will contain all the arguments the distribution needs to be imported" 
      );
+    fl::ws::AddWorkSpaceOptions(&desc);
     boost::program_options::variables_map vm;
     std::vector<std::string> args1=fl::ws::MakeArgsFromPrefix(args_, "");
     boost::program_options::command_line_parser clp(args1);
@@ -68,6 +68,7 @@ POSSIBILITY OF SUCH DAMAGE.
  *     typedef fl::ml::KdeResult<std::vector<double> > Result_t;
  *     typedef fl::ml::KdeStatistic<double> Statistic_t;
  *     typedef fl::ml::KdeSummary<double> Summary_t;
+ *     typedef fl::ml::KdeSeries<fl::math::GaussianKernel<double> > Series_t;
  *   };
  * 
  * 
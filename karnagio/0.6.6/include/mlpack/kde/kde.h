@@ -29,6 +29,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "fastlib/base/base.h"
 #include "fastlib/la/linear_algebra.h"
 #include "mlpack/kde/kde_stat.h"
+#include "mlpack/kde/kde_series.h"
+#include "mlpack/kde/kde_grid_stat.h"
 #include "fastlib/base/base.h"
 #include "fastlib/math/fl_math.h"
 #include "fastlib/base/mpl.h"
@@ -104,6 +106,8 @@ class Kde {
     typedef typename TemplateArgs::ComputationType::Statistic_t Statistic_t;
     /** Keeps the lower and upper bound of the results for a particular node */
     typedef typename TemplateArgs::ComputationType::Summary_t Summary_t;
+    /** Series expansion that can summarize a node pair */
+    typedef typename TemplateArgs::ComputationType::Series_t Series_t;
 
   public:
     /** 
@@ -140,9 +144,24 @@ class Kde {
               double bandwidth_factor_in,
               double relative_error_in,
               double probability_in);
-    
+    /**
+     * @brief Initialize a Kde engine that evaluates a grid of bandwidths
+     *        in one traversal. It needs the KdeGridStructArgs computation.
+     *   @param reference_table a pointer to the reference table
+     *   @param query_table a pointer to the query table
+     *   @param bandwidths_in the grid of bandwidths
+     */
+    void Init(Table_t *reference_table,
+              Table_t *query_table,
+              const std::vector<double> &bandwidths_in,
+              double relative_error_in,
+              double probability_in);
+
 
   private:
+    void InitTables_(Table_t *reference_table,
+                     Table_t *query_table);
+
     Table_t *query_table_;
     Table_t *reference_table_;
     Global_t global_;
@@ -287,6 +306,23 @@ class Kde<boost::mpl::void_> {
           typedef KdeResult< std::vector<double> > Result_t;
           typedef typename TemplateArgs::Statistic_t Statistic_t;
           typedef KdeSummary<typename TemplateArgs::CalcPrecision_t> Summary_t;
+          typedef KdeSeries<typename TemplateArgs::KernelType> Series_t;
+        };
+
+        /** @brief
+         *  Computes the densities for a grid of bandwidths in one
+         *  traversal, the results are in KdeGridResult
+         */
+        template<typename TemplateArgs>
+        struct KdeGridStructArgs {
+          typedef KdeGridDelta<typename TemplateArgs::CalcPrecision_t> Delta_t;
+          typedef KdeGridGlobal<TemplateArgs> Global_t;
+          typedef KdeGridPostponed<typename TemplateArgs::CalcPrecision_t> Postponed_t;
+          typedef KdeGridResult<typename TemplateArgs::CalcPrecision_t> Result_t;
+          typedef KdeGridStatistic<typename TemplateArgs::CalcPrecision_t> Statistic_t;
+          typedef KdeGridSummary<typename TemplateArgs::CalcPrecision_t> Summary_t;
+          /** The expansions are written for a single bandwidth */
+          typedef KdeSeries<boost::mpl::void_> Series_t;
         };
         /**
          * @brief This function is used by our internal system for instantiation
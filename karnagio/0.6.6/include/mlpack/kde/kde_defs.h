@@ -34,8 +34,10 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "boost/math/special_functions/fpclassify.hpp"
 #include "fastlib/base/base.h"
 #include "fastlib/data/multi_dataset.h"
+#include "fastlib/table/default/dense/labeled/covertree/table.h"
 #include "fastlib/metric_kernel/weighted_lmetric_dev.h"
 #include "mlpack/kde/kde_lscv_function.h"
+#include "mlpack/kde/kde_lscv_grid.h"
 #include "fastlib/optimization/lbfgs/lbfgs_dev.h"
 #include "mlpack/kde/dualtree_dfs_dev.h"
 #include "fastlib/util/timer.h"
@@ -43,6 +45,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "kde_stat.h"
 #include "mlpack/mnnclassifier/auc.h"
 #include "fastlib/workspace/task.h"
+#include "fastlib/workspace/arguments.h"
 
 template<typename TableType1>
 template<class DataAccessType>
@@ -130,6 +133,9 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
   // Read in the number of iterations.
   index_t iterations = vm["iterations"].as<index_t>();
 
+  // Read in the number of threads of the dual-tree computation.
+  int n_threads = vm["threads"].as<int>();
+
   std::vector<double> priors;
   if (vm.count("priors")) {
     std::vector<std::string> tokens ;
@@ -256,6 +262,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
             // Initialize the dual-tree engine for the KDE instance.
             fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
             dualtree_engine.Init(kde_instance);
+            dualtree_engine.set_n_threads(n_threads);
             fl::util::Timer timer;
             if (iterations<0) {
               fl::logger->Message() << "Non progressive mode"<<std::endl; 
@@ -300,6 +307,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
             // Initialize the dual-tree engine for the KDE instance.
             fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
             dualtree_engine.Init(kde_instance);
+            dualtree_engine.set_n_threads(n_threads);
             fl::util::Timer timer;
             if (iterations<0) {
               fl::logger->Message() << "Non progressive mode"<<std::endl; 
@@ -346,6 +354,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
               // Initialize the dual-tree engine for the KDE instance.
               fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
               dualtree_engine.Init(kde_instance);
+              dualtree_engine.set_n_threads(n_threads);
               fl::util::Timer timer;
               // Gaussian Kernel
               if (iterations<0) {
@@ -388,6 +397,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
               // Initialize the dual-tree engine for the KDE instance.
               fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
               dualtree_engine.Init(kde_instance);
+              dualtree_engine.set_n_threads(n_threads);
               fl::util::Timer timer;
               // Gaussian Kernel
               if (iterations<0) {
@@ -441,6 +451,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
               // Initialize the dual-tree engine for the KDE instance.
               fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
               dualtree_engine.Init(kde_instance);
+              dualtree_engine.set_n_threads(n_threads);
               fl::util::Timer timer;
   
               if (iterations<0) {
@@ -485,6 +496,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
               // Initialize the dual-tree engine for the KDE instance.
               fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
               dualtree_engine.Init(kde_instance);
+              dualtree_engine.set_n_threads(n_threads);
               fl::util::Timer timer;
   
               if (iterations<0) {
@@ -534,6 +546,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                 // Initialize the dual-tree engine for the KDE instance.
                 fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                 dualtree_engine.Init(kde_instance);
+                dualtree_engine.set_n_threads(n_threads);
                 fl::util::Timer timer;
   
                 if (iterations<0) {
@@ -579,6 +592,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                 // Initialize the dual-tree engine for the KDE instance.
                 fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                 dualtree_engine.Init(kde_instance);
+                dualtree_engine.set_n_threads(n_threads);
                 fl::util::Timer timer;
   
                 if (iterations<0) {
@@ -688,7 +702,24 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                     break;
                   }
                 }
-              } 
+              } else if (bandwidth_selection == "grid") {
+                // Score a grid of bandwidths around the plugin one in a
+                // single traversal.
+                fl::ml::KdeLscvGrid< KdeArgs<fl::math::GaussianKernel<double>,
+                  fl::math::LMetric<2>, fl::table::NullFilter,
+                  KdeGridStructArgs> > lscv_grid;
+                std::vector<double> bandwidths;
+                lscv_grid.DefaultGrid(exp(bandwidth), &bandwidths);
+                lscv_grid.Init(references[0].get(), bandwidths, relative_error);
+                lscv_grid.set_n_threads(n_threads);
+                lscv_grid.Compute(fl::math::LMetric<2>());
+                global_min_point_iterate.first[0] =
+                  log(lscv_grid.optimal_bandwidth());
+                global_min_point_iterate.second = lscv_grid.optimal_score();
+                fl::logger->Message() << "The optimal bandwidth of the grid is "
+                  << lscv_grid.optimal_bandwidth() << " with LSCV score of "
+                  << lscv_grid.optimal_score();
+              }
             } else {
               if (metric=="weighted_l2") {
                 // Choose the starting (plugin) bandwidth in log scale.
@@ -740,6 +771,21 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                       break;
                     }
                   }
+                } else if (bandwidth_selection == "grid") {
+                  fl::ml::KdeLscvGrid< KdeArgs<fl::math::GaussianKernel<double>,
+                    fl::math::WeightedLMetric<2, fl::data::MonolithicPoint<double> >,
+                    fl::table::NullFilter, KdeGridStructArgs> > lscv_grid;
+                  std::vector<double> bandwidths;
+                  lscv_grid.DefaultGrid(exp(bandwidth), &bandwidths);
+                  lscv_grid.Init(references[0].get(), bandwidths, relative_error);
+                  lscv_grid.set_n_threads(n_threads);
+                  lscv_grid.Compute(w_index_args.metric);
+                  global_min_point_iterate.first[0] =
+                    log(lscv_grid.optimal_bandwidth());
+                  global_min_point_iterate.second = lscv_grid.optimal_score();
+                  fl::logger->Message() << "The optimal bandwidth of the grid is "
+                    << lscv_grid.optimal_bandwidth() << " with LSCV score of "
+                    << lscv_grid.optimal_score();
                 }
               } else {
                 fl::logger->Die()<<"Unknown metric "<<metric;
@@ -780,6 +826,10 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
             fl::logger->Die() <<"Uknown kernel " <<kernel;
           }
         } else {
+          if (bandwidth_selection == "grid") {
+            fl::logger->Die() << "--bandwidth_selection=grid does not support "
+              "--filter";
+          }
           if (kernel=="gaussian") {
             std::pair< fl::data::MonolithicPoint<double>, double >
             global_min_point_iterate;
@@ -996,6 +1046,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                    // Initialize the dual-tree engine for the KDE instance.
                    fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                    dualtree_engine.Init(kde_instance);
+                   dualtree_engine.set_n_threads(n_threads);
                    dualtree_engine.Compute(fl::math::LMetric<2>(), &result[i]);
                    
                 }
@@ -1011,6 +1062,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                   // Initialize the dual-tree engine for the KDE instance.
                   fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                   dualtree_engine.Init(kde_instance);
+                  dualtree_engine.set_n_threads(n_threads);
                   typename fl::ml::DualtreeDfs<Kde_t>::template
                   iterator<fl::math::LMetric<2> > it = dualtree_engine.get_iterator(
                                            fl::math::LMetric<2>(), &result[i]);
@@ -1045,6 +1097,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                      // Initialize the dual-tree engine for the KDE instance.
                      fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                      dualtree_engine.Init(kde_instance);
+                     dualtree_engine.set_n_threads(n_threads);
                      dualtree_engine.Compute(fl::math::LMetric<2>(), &result[i]);
                   }
                   timer.End();
@@ -1059,6 +1112,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                     // Initialize the dual-tree engine for the KDE instance.
                     fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                     dualtree_engine.Init(kde_instance);
+                    dualtree_engine.set_n_threads(n_threads);
                     typename fl::ml::DualtreeDfs<Kde_t>::template
                     iterator<fl::math::LMetric<2> > it = dualtree_engine.get_iterator(
                                            fl::math::LMetric<2>(), &result[i]);
@@ -1098,6 +1152,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                      // Initialize the dual-tree engine for the KDE instance.
                      fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                      dualtree_engine.Init(kde_instance);
+                     dualtree_engine.set_n_threads(n_threads);
                      dualtree_engine.Compute(w_index_args.metric, &result[i]);
                   }
                   timer.End();
@@ -1112,6 +1167,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                     // Initialize the dual-tree engine for the KDE instance.
                     fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                     dualtree_engine.Init(kde_instance);
+                    dualtree_engine.set_n_threads(n_threads);
     
                     typename fl::ml::DualtreeDfs<Kde_t>::template
                     iterator<fl::math::WeightedLMetric<2, fl::data::MonolithicPoint<double> > > it = dualtree_engine.get_iterator(
@@ -1146,6 +1202,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                        // Initialize the dual-tree engine for the KDE instance.
                        fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                        dualtree_engine.Init(kde_instance);
+                       dualtree_engine.set_n_threads(n_threads);
                        dualtree_engine.Compute(fl::math::LMetric<2>(), &result[i]);
                     }
                     timer.End();
@@ -1160,6 +1217,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                       // Initialize the dual-tree engine for the KDE instance.
                       fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                       dualtree_engine.Init(kde_instance);
+                      dualtree_engine.set_n_threads(n_threads);
                       typename fl::ml::DualtreeDfs<Kde_t>::template
                       iterator<fl::math::WeightedLMetric<2, fl::data::MonolithicPoint<double> > > it = dualtree_engine.get_iterator(
                                              w_index_args.metric, &result[i]);
@@ -1203,6 +1261,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                    // Initialize the dual-tree engine for the KDE instance.
                    fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                    dualtree_engine.Init(kde_instance);
+                   dualtree_engine.set_n_threads(n_threads);
                    dualtree_engine.Compute(fl::math::LMetric<2>(), &result[i]);
                    
                 }
@@ -1218,6 +1277,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                   // Initialize the dual-tree engine for the KDE instance.
                   fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                   dualtree_engine.Init(kde_instance);
+                  dualtree_engine.set_n_threads(n_threads);
                   typename fl::ml::DualtreeDfs<Kde_t>::template
                   iterator<fl::math::LMetric<2> > it = dualtree_engine.get_iterator(
                                            fl::math::LMetric<2>(), &result[i]);
@@ -1252,6 +1312,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                      // Initialize the dual-tree engine for the KDE instance.
                      fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                      dualtree_engine.Init(kde_instance);
+                     dualtree_engine.set_n_threads(n_threads);
                      dualtree_engine.Compute(fl::math::LMetric<2>(), &result[i]);
                   }
                   timer.End();
@@ -1266,6 +1327,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                     // Initialize the dual-tree engine for the KDE instance.
                     fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                     dualtree_engine.Init(kde_instance);
+                    dualtree_engine.set_n_threads(n_threads);
                     typename fl::ml::DualtreeDfs<Kde_t>::template
                     iterator<fl::math::LMetric<2> > it = dualtree_engine.get_iterator(
                                            fl::math::LMetric<2>(), &result[i]);
@@ -1305,6 +1367,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                      // Initialize the dual-tree engine for the KDE instance.
                      fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                      dualtree_engine.Init(kde_instance);
+                     dualtree_engine.set_n_threads(n_threads);
                      dualtree_engine.Compute(w_index_args.metric, &result[i]);
                   }
                   timer.End();
@@ -1319,6 +1382,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                     // Initialize the dual-tree engine for the KDE instance.
                     fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                     dualtree_engine.Init(kde_instance);
+                    dualtree_engine.set_n_threads(n_threads);
     
                     typename fl::ml::DualtreeDfs<Kde_t>::template
                     iterator<fl::math::WeightedLMetric<2, fl::data::MonolithicPoint<double> > > it = dualtree_engine.get_iterator(
@@ -1353,6 +1417,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                        // Initialize the dual-tree engine for the KDE instance.
                        fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                        dualtree_engine.Init(kde_instance);
+                       dualtree_engine.set_n_threads(n_threads);
                        dualtree_engine.Compute(fl::math::LMetric<2>(), &result[i]);
                     }
                     timer.End();
@@ -1367,6 +1432,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                       // Initialize the dual-tree engine for the KDE instance.
                       fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                       dualtree_engine.Init(kde_instance);
+                      dualtree_engine.set_n_threads(n_threads);
                       typename fl::ml::DualtreeDfs<Kde_t>::template
                       iterator<fl::math::WeightedLMetric<2, fl::data::MonolithicPoint<double> > > it = dualtree_engine.get_iterator(
                                              w_index_args.metric, &result[i]);
@@ -1546,6 +1612,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                    // Initialize the dual-tree engine for the KDE instance.
                    fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                    dualtree_engine.Init(kde_instance);
+                   dualtree_engine.set_n_threads(n_threads);
                    dualtree_engine.Compute(fl::math::LMetric<2>(), &result[i]);
                    
                 }
@@ -1568,6 +1635,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                   // Initialize the dual-tree engine for the KDE instance.
                   fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                   dualtree_engine.Init(kde_instance);
+                  dualtree_engine.set_n_threads(n_threads);
                   typename fl::ml::DualtreeDfs<Kde_t>::template
                   iterator<fl::math::LMetric<2> > it = dualtree_engine.get_iterator(
                                            fl::math::LMetric<2>(), &result[i]);
@@ -1607,6 +1675,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                      // Initialize the dual-tree engine for the KDE instance.
                      fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                      dualtree_engine.Init(kde_instance);
+                     dualtree_engine.set_n_threads(n_threads);
                      dualtree_engine.Compute(fl::math::LMetric<2>(), &result[i]);
                   }
                   timer.End();
@@ -1628,6 +1697,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                     // Initialize the dual-tree engine for the KDE instance.
                     fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                     dualtree_engine.Init(kde_instance);
+                    dualtree_engine.set_n_threads(n_threads);
   
                     typename fl::ml::DualtreeDfs<Kde_t>::template
                     iterator<fl::math::LMetric<2> > it = dualtree_engine.get_iterator(
@@ -1673,6 +1743,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                      // Initialize the dual-tree engine for the KDE instance.
                      fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                      dualtree_engine.Init(kde_instance);
+                     dualtree_engine.set_n_threads(n_threads);
                      dualtree_engine.Compute(w_index_args.metric, &result[i]);
                   }
                   timer.End();
@@ -1693,6 +1764,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                     // Initialize the dual-tree engine for the KDE instance.
                     fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                     dualtree_engine.Init(kde_instance);
+                    dualtree_engine.set_n_threads(n_threads);
   
                     typename fl::ml::DualtreeDfs<Kde_t>::template
                     iterator<fl::math::WeightedLMetric<2, fl::data::MonolithicPoint<double> > > it = dualtree_engine.get_iterator(
@@ -1731,6 +1803,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                       // Initialize the dual-tree engine for the KDE instance.
                       fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                       dualtree_engine.Init(kde_instance);
+                      dualtree_engine.set_n_threads(n_threads);
                       dualtree_engine.Compute(fl::math::LMetric<2>(), &result[i]);
                     }
                     timer.End();
@@ -1751,6 +1824,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                       // Initialize the dual-tree engine for the KDE instance.
                       fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                       dualtree_engine.Init(kde_instance); 
+                      dualtree_engine.set_n_threads(n_threads);
                       typename fl::ml::DualtreeDfs<Kde_t>::template
                       iterator<fl::math::WeightedLMetric<2, fl::data::MonolithicPoint<double> > > it = dualtree_engine.get_iterator(
                                              w_index_args.metric, &result[i]);
@@ -1799,6 +1873,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                    // Initialize the dual-tree engine for the KDE instance.
                    fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                    dualtree_engine.Init(kde_instance);
+                   dualtree_engine.set_n_threads(n_threads);
                    dualtree_engine.Compute(fl::math::LMetric<2>(), &result[i]);
                    
                 }
@@ -1821,6 +1896,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                   // Initialize the dual-tree engine for the KDE instance.
                   fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                   dualtree_engine.Init(kde_instance);
+                  dualtree_engine.set_n_threads(n_threads);
                   typename fl::ml::DualtreeDfs<Kde_t>::template
                   iterator<fl::math::LMetric<2> > it = dualtree_engine.get_iterator(
                                            fl::math::LMetric<2>(), &result[i]);
@@ -1860,6 +1936,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                      // Initialize the dual-tree engine for the KDE instance.
                      fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                      dualtree_engine.Init(kde_instance);
+                     dualtree_engine.set_n_threads(n_threads);
                      dualtree_engine.Compute(fl::math::LMetric<2>(), &result[i]);
                   }
                   timer.End();
@@ -1881,6 +1958,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                     // Initialize the dual-tree engine for the KDE instance.
                     fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                     dualtree_engine.Init(kde_instance);
+                    dualtree_engine.set_n_threads(n_threads);
   
                     typename fl::ml::DualtreeDfs<Kde_t>::template
                     iterator<fl::math::LMetric<2> > it = dualtree_engine.get_iterator(
@@ -1926,6 +2004,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                      // Initialize the dual-tree engine for the KDE instance.
                      fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                      dualtree_engine.Init(kde_instance);
+                     dualtree_engine.set_n_threads(n_threads);
                      dualtree_engine.Compute(w_index_args.metric, &result[i]);
                   }
                   timer.End();
@@ -1946,6 +2025,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                     // Initialize the dual-tree engine for the KDE instance.
                     fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                     dualtree_engine.Init(kde_instance);
+                    dualtree_engine.set_n_threads(n_threads);
   
                     typename fl::ml::DualtreeDfs<Kde_t>::template
                     iterator<fl::math::WeightedLMetric<2, fl::data::MonolithicPoint<double> > > it = dualtree_engine.get_iterator(
@@ -1984,6 +2064,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                       // Initialize the dual-tree engine for the KDE instance.
                       fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                       dualtree_engine.Init(kde_instance);
+                      dualtree_engine.set_n_threads(n_threads);
                       dualtree_engine.Compute(fl::math::LMetric<2>(), &result[i]);
                     }
                     timer.End();
@@ -2004,6 +2085,7 @@ int fl::ml::Kde<boost::mpl::void_>::Core<TableType1>::Main(
                       // Initialize the dual-tree engine for the KDE instance.
                       fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
                       dualtree_engine.Init(kde_instance); 
+                      dualtree_engine.set_n_threads(n_threads);
                       typename fl::ml::DualtreeDfs<Kde_t>::template
                       iterator<fl::math::WeightedLMetric<2, fl::data::MonolithicPoint<double> > > it = dualtree_engine.get_iterator(
                                              w_index_args.metric, &result[i]);
@@ -2181,7 +2263,9 @@ int fl::ml::Kde<boost::mpl::void_>::Main(
     "bandwidth_selection",
     boost::program_options::value<std::string>(),
     "OPTIONAL The method used for optimizing the bandwidth."
-    "Available options: plugin, monte_carlo"
+    "Available options: plugin, monte_carlo, grid. The grid scores 17 "
+    "bandwidths from 1/4 to 4 times the plugin one in a single traversal, "
+    "it needs the gaussian kernel and no --filter"
   )(
     "bandwidth_out",
     boost::program_options::value<std::string>(),
@@ -2232,7 +2316,19 @@ int fl::ml::Kde<boost::mpl::void_>::Main(
     "tree",
     boost::program_options::value<std::string>()->default_value("kdtree"),
     "Tree structure used by KDE.  One of:\n"
-    "  kdtree, balltree"
+    "  kdtree, balltree, covertree\n"
+    "kdtree and balltree keep the tree of the table, covertree moves the "
+    "dense tables to cover trees, they prune better than the kd-trees when "
+    "the data has many dimensions but a low intrinsic dimension"
+  )(
+    "split",
+    boost::program_options::value<std::string>()->default_value(""),
+    "The split rule of the trees of the references and the queries, the "
+    "default is the one of the tree.  One of:\n"
+    "  kd-trees: midpoint, sliding_midpoint, median, variance\n"
+    "  ball-trees: furthest, sampled\n"
+    "sliding_midpoint and variance build balanced trees on skewed data, "
+    "sampled picks the first ball-tree pivot on a sample, saving a scan"
   )("filter",
     boost::program_options::value<std::string>()->default_value("null"),
     "This option let's kde filter out points while traversing a tree and not consider them in computation\n"
@@ -2245,6 +2341,13 @@ int fl::ml::Kde<boost::mpl::void_>::Main(
     "KDE can run in either batch or progressive mode.  If --iterations=i "
     "is omitted, KDE computes approximatesly to completion; otherwise, "
     "it terminates after i progressive refinements."
+  )(
+    "threads",
+    boost::program_options::value<int>()->default_value(1),
+    "number of threads for KDE and KDA in batch mode. The query tree is "
+    "split in subtrees that are computed in parallel, the error guarantees "
+    "are the same as with one thread. The progressive mode runs on one "
+    "thread"
   )(
     "num_lbfgs_restarts",
     boost::program_options::value<index_t>()->default_value(1),
@@ -2274,6 +2377,7 @@ int fl::ml::Kde<boost::mpl::void_>::Main(
     "For example --priors=0.2,0.8"
   );
 
+  fl::ws::AddWorkSpaceOptions(&desc);
   boost::program_options::variables_map vm;
   boost::program_options::command_line_parser clp(args);
   clp.style(boost::program_options::command_line_style::default_style
@@ -2343,15 +2447,19 @@ int fl::ml::Kde<boost::mpl::void_>::Main(
   }
   if (vm.count("bandwidth") == 0 && vm.count("kda_bandwidths")==0 &&
       vm["bandwidth_selection"].as<std::string>() != "plugin" &&
-    vm["bandwidth_selection"].as<std::string>() != "monte_carlo") {
+    vm["bandwidth_selection"].as<std::string>() != "monte_carlo" &&
+    vm["bandwidth_selection"].as<std::string>() != "grid") {
     fl::logger->Die() << "The --bandwidth_selection takes the value of "
-      << "either plugin or monte_carlo.";
+      << "plugin, monte_carlo or grid.";
   }
   if (vm["probability"].as<double>() <= 0 ||
       vm["probability"].as<double>() > 1) {
     fl::logger->Die() << "The --probability requires a real number "
     "$0 < p <= 1$ ";
   }
+  if (vm["threads"].as<int>() <= 0) {
+    fl::logger->Die() << "The --threads requires a positive integer";
+  }
   if (vm["relative_error"].as<double>() < 0) {
     fl::logger->Die() << "The --relative_error requires a real number $r >= 0$";
   }
@@ -2372,11 +2480,21 @@ int fl::ml::Kde<boost::mpl::void_>::Main(
       vm["filter"].as<std::string>()!="time") {
     fl::logger->Die()<<"--filter can only be null or time";
   }
+  if (vm["tree"].as<std::string>()!="kdtree" &&
+      vm["tree"].as<std::string>()!="balltree" &&
+      vm["tree"].as<std::string>()!="covertree") {
+    fl::logger->Die()<<"--tree can only be kdtree, balltree or covertree";
+  }
   if (vm.count("help")) {
     std::cout << fl::DISCLAIMER << "\n";
     std::cout << desc << "\n";
     return 1;
   }
+  // the workspace makes the cover tree tables, a file never loads as
+  // one, so the branch on the table type does not look for them
+  if (vm["tree"].as<std::string>()=="covertree") {
+    return Core<fl::table::dense::labeled::covertree::Table>::Main(data, vm);
+  }
   return BranchType::template BranchOnTable<Kde<boost::mpl::void_>, DataAccessType>(data, vm);
 }
 
@@ -2391,7 +2509,7 @@ void fl::ml::Kde<boost::mpl::void_>::Run(
       typename DataAccessType::Branch_t
     > 
   >task(data, args);
-  data->schedule(task); 
+  data->schedule(task, args);
 }
 
 #endif  
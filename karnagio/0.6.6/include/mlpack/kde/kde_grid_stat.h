@@ -0,0 +1,667 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef FL_LITE_MLPACK_KDE_KDE_GRID_STAT_H
+#define FL_LITE_MLPACK_KDE_KDE_GRID_STAT_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "fastlib/base/base.h"
+#include "fastlib/math/fl_math.h"
+#include "fastlib/tree/abstract_statistic.h"
+#include "mlpack/kde/mean_variance_pair.h"
+
+/**
+ * The classes here evaluate a grid of bandwidths in one traversal of
+ * DualtreeDfs. Every bound of KdeStat becomes a vector with one entry
+ * per bandwidth, and a node pair is only pruned when it can be pruned
+ * for every bandwidth. The objects are made by the engine before they
+ * see the grid, so the vectors grow on first use and a missing entry
+ * counts as zero.
+ */
+namespace fl {
+namespace ml {
+
+/**
+ * @brief Adds the entries of in to out, growing out if it is shorter
+ */
+template<typename CalcPrecision_t>
+inline void KdeGridAdd(const std::vector<CalcPrecision_t> &in,
+                       std::vector<CalcPrecision_t> *out) {
+  if (out->size() < in.size()) {
+    out->resize(in.size(), 0);
+  }
+  for (size_t i = 0; i < in.size(); ++i) {
+    (*out)[i] += in[i];
+  }
+}
+
+/**
+ * @brief Whether the kernel for a bandwidth is the square of the kernel
+ *        for sqrt(2) times that bandwidth, true for the gaussian
+ */
+template<typename KernelType>
+struct KdeGridSquares {
+  static const bool value = false;
+};
+
+template<typename Precision, bool USE_NORMALIZATION>
+struct KdeGridSquares<fl::math::GaussianKernel<Precision, USE_NORMALIZATION> > {
+  static const bool value = true;
+};
+
+template<typename CalcPrecision_t>
+class KdeGridPostponed {
+
+  public:
+
+    std::vector<CalcPrecision_t> densities_l_;
+
+    std::vector<CalcPrecision_t> densities_u_;
+
+    CalcPrecision_t pruned_;
+
+    KdeGridPostponed() {
+      SetZero();
+    }
+
+    ~KdeGridPostponed() {
+    }
+
+    void Init() {
+      SetZero();
+    }
+
+    void Init(index_t rnode_count) {
+      std::fill(densities_l_.begin(), densities_l_.end(), 0);
+      std::fill(densities_u_.begin(), densities_u_.end(), 0);
+      pruned_ = (CalcPrecision_t) rnode_count;
+    }
+
+    template<typename DeltaType, typename ResultType>
+    void ApplyDelta(const DeltaType &delta_in,
+                    ResultType *query_results) {
+      KdeGridAdd(delta_in.densities_l_, &densities_l_);
+      KdeGridAdd(delta_in.densities_u_, &densities_u_);
+      pruned_ += delta_in.pruned_;
+    }
+
+    void ApplyPostponed(const KdeGridPostponed &other_postponed) {
+      KdeGridAdd(other_postponed.densities_l_, &densities_l_);
+      KdeGridAdd(other_postponed.densities_u_, &densities_u_);
+      pruned_ += other_postponed.pruned_;
+    }
+
+    template<typename GlobalType, typename MetricType, typename PointType>
+    void ApplyContribution(const GlobalType &global,
+                           const MetricType &metric,
+                           const PointType &query_point,
+                           const PointType &reference_point) {
+      ApplyContribution(global,
+                        metric.DistanceSq(query_point, reference_point),
+                        reference_point);
+    }
+
+    template<typename GlobalType, typename PointType>
+    void ApplyContribution(const GlobalType &global,
+                           double distsq,
+                           const PointType &reference_point) {
+      const int n_bandwidths = global.n_bandwidths();
+      if (static_cast<int>(densities_l_.size()) < n_bandwidths) {
+        densities_l_.resize(n_bandwidths, 0);
+        densities_u_.resize(n_bandwidths, 0);
+      }
+      global.EvalUnnormOnSq(distsq, &kernel_values_);
+      CalcPrecision_t *densities_l = &densities_l_[0];
+      CalcPrecision_t *densities_u = &densities_u_[0];
+      const CalcPrecision_t *kernel_values = &kernel_values_[0];
+      for (int i = 0; i < n_bandwidths; ++i) {
+        densities_l[i] += kernel_values[i];
+        densities_u[i] += kernel_values[i];
+      }
+    }
+
+    void SetZero() {
+      std::fill(densities_l_.begin(), densities_l_.end(), 0);
+      std::fill(densities_u_.begin(), densities_u_.end(), 0);
+      pruned_ = 0;
+    }
+
+  private:
+    /** The kernels of one reference point, kept to save allocations. */
+    std::vector<CalcPrecision_t> kernel_values_;
+};
+
+template<typename CalcPrecision_t>
+class KdeGridStatistic;
+
+template<typename TemplateMap>
+class KdeGridGlobal {
+
+  public:
+
+    typedef typename TemplateMap::TableType Table_t;
+
+    typedef typename TemplateMap::KernelType Kernel_t;
+
+    typedef typename TemplateMap::TableType::CalcPrecision_t CalcPrecision_t;
+
+    typedef KdeGridStatistic<CalcPrecision_t> Statistic_t;
+
+  protected:
+
+    double relative_error_;
+
+    double probability_;
+
+    std::vector<double> bandwidths_;
+
+    std::vector<Kernel_t> kernels_;
+
+    std::vector<CalcPrecision_t> mult_consts_;
+
+    /** The kernels that EvalUnnormOnSq computes with exp. */
+    std::vector<int> exp_kernels_;
+
+    /**
+     * The (kernel, wider kernel) pairs where the first is the square of
+     * the second, the wider ones first.
+     */
+    std::vector<std::pair<int, int> > square_kernels_;
+
+    /** The (kernel, kernel) pairs of repeated bandwidths. */
+    std::vector<std::pair<int, int> > copy_kernels_;
+
+    Table_t *query_table_;
+
+    Table_t *reference_table_;
+
+    std::vector<Statistic_t> *reference_statistics_;
+
+  public:
+
+    Table_t *query_table() {
+      return query_table_;
+    }
+
+    const Table_t *query_table() const {
+      return query_table_;
+    }
+
+    Table_t *reference_table() {
+      return reference_table_;
+    }
+
+    const Table_t *reference_table() const {
+      return reference_table_;
+    }
+
+    double relative_error() const {
+      return relative_error_;
+    }
+
+    double probability() const {
+      return probability_;
+    }
+
+    int n_bandwidths() const {
+      return bandwidths_.size();
+    }
+
+    double bandwidth(int i) const {
+      return bandwidths_[i];
+    }
+
+    const Kernel_t &kernel(int i) const {
+      return kernels_[i];
+    }
+
+    std::vector<Statistic_t>* &reference_statistic() {
+      return reference_statistics_;
+    }
+
+    const std::vector<Statistic_t>* reference_statistic() const {
+      return reference_statistics_;
+    }
+
+    void Init(Table_t *reference_table_in, Table_t *query_table_in,
+              std::vector<Statistic_t> *references_stats,
+              const std::vector<double> &bandwidths_in,
+              const bool is_monochromatic,
+              double relative_error_in, double probability_in) {
+      if (bandwidths_in.empty()) {
+        fl::logger->Die() << "The grid of bandwidths is empty";
+      }
+      reference_statistics_ = references_stats;
+      index_t effective_num_points =
+        (is_monochromatic) ?
+        (reference_table_in->n_entries() -
+         reference_table_in->n_deleted_entries() - 1) :
+        (reference_table_in->n_entries() -
+         reference_table_in->n_deleted_entries());
+      bandwidths_ = bandwidths_in;
+      kernels_.resize(bandwidths_.size());
+      mult_consts_.resize(bandwidths_.size());
+      for (size_t i = 0; i < bandwidths_.size(); ++i) {
+        kernels_[i].Init(bandwidths_[i]);
+        mult_consts_[i] = 1.0 /
+                          (kernels_[i].CalcNormConstant(
+                             reference_table_in->n_attributes()) *
+                           ((CalcPrecision_t) effective_num_points));
+      }
+      relative_error_ = relative_error_in;
+      probability_ = probability_in;
+      query_table_ = query_table_in;
+      reference_table_ = reference_table_in;
+
+      // The widest bandwidths go first, so that a kernel is computed
+      // before the ones that square it.
+      std::vector<int> order(bandwidths_.size());
+      for (size_t i = 0; i < bandwidths_.size(); ++i) {
+        order[i] = i;
+      }
+      std::stable_sort(order.begin(), order.end(),
+                       WiderBandwidth_(bandwidths_));
+      exp_kernels_.resize(0);
+      square_kernels_.resize(0);
+      copy_kernels_.resize(0);
+      for (size_t k = 0; k < order.size(); ++k) {
+        const int i = order[k];
+        const double bandwidth_sq = kernels_[i].bandwidth_sq();
+        if (k > 0 && kernels_[order[k - 1]].bandwidth_sq() == bandwidth_sq) {
+          copy_kernels_.push_back(std::make_pair(i, order[k - 1]));
+          continue;
+        }
+        int wider = -1;
+        for (size_t l = 0; l < k && KdeGridSquares<Kernel_t>::value; ++l) {
+          if (std::fabs(kernels_[order[l]].bandwidth_sq() - 2 * bandwidth_sq)
+              <= 1e-12 * bandwidth_sq) {
+            wider = order[l];
+            break;
+          }
+        }
+        if (wider < 0) {
+          exp_kernels_.push_back(i);
+        }
+        else {
+          square_kernels_.push_back(std::make_pair(i, wider));
+        }
+      }
+    }
+
+    CalcPrecision_t get_mult_const(int i) const {
+      return mult_consts_[i];
+    }
+
+    /**
+     * @brief The unnormalized kernels of every bandwidth, on a geometric
+     *        grid most of them are squares of the wider ones and need
+     *        no exp
+     */
+    void EvalUnnormOnSq(double distsq,
+                        std::vector<CalcPrecision_t> *values) const {
+      values->resize(kernels_.size());
+      CalcPrecision_t *v = &(*values)[0];
+      for (size_t k = 0; k < exp_kernels_.size(); ++k) {
+        v[exp_kernels_[k]] = kernels_[exp_kernels_[k]].EvalUnnormOnSq(distsq);
+      }
+      // A square below the smallest normal number is flushed to zero,
+      // the denormals are slow
+      const CalcPrecision_t min_root =
+        sqrt(std::numeric_limits<CalcPrecision_t>::min());
+      for (size_t k = 0; k < square_kernels_.size(); ++k) {
+        const CalcPrecision_t wider = v[square_kernels_[k].second];
+        v[square_kernels_[k].first] = wider < min_root ? 0 :
+                                      fl::math::Sqr(wider);
+      }
+      for (size_t k = 0; k < copy_kernels_.size(); ++k) {
+        v[copy_kernels_[k].first] = v[copy_kernels_[k].second];
+      }
+    }
+
+  private:
+    struct WiderBandwidth_ {
+      WiderBandwidth_(const std::vector<double> &bandwidths) :
+          bandwidths_(bandwidths) {
+      }
+      bool operator()(int i, int j) const {
+        return bandwidths_[i] > bandwidths_[j];
+      }
+      const std::vector<double> &bandwidths_;
+    };
+};
+
+/**
+ * @brief The densities of every query point, densities_[q][i] is the
+ *        density of the query point q for the bandwidth i of the grid
+ */
+template<typename CalcPrecision_t>
+class KdeGridResult {
+  public:
+    std::vector< std::vector<CalcPrecision_t> > densities_l_;
+    std::vector< std::vector<CalcPrecision_t> > densities_;
+    std::vector< std::vector<CalcPrecision_t> > densities_u_;
+    std::vector<CalcPrecision_t> pruned_;
+
+    KdeGridResult() {
+    }
+
+    ~KdeGridResult() {
+    }
+
+    template<typename MetricType, typename GlobalType>
+    void PostProcess(const MetricType &metric,
+                     index_t q_index,
+                     const GlobalType &global,
+                     const bool is_monochromatic) {
+      const int n_bandwidths = global.n_bandwidths();
+      densities_l_[q_index].resize(n_bandwidths, 0);
+      densities_u_[q_index].resize(n_bandwidths, 0);
+      densities_[q_index].resize(n_bandwidths);
+      for (int i = 0; i < n_bandwidths; ++i) {
+        densities_[q_index][i] = 0.5 * (densities_l_[q_index][i] +
+                                        densities_u_[q_index][i]);
+        densities_l_[q_index][i] *= global.get_mult_const(i);
+        densities_[q_index][i] *= global.get_mult_const(i);
+        densities_u_[q_index][i] *= global.get_mult_const(i);
+      }
+    }
+
+    /**
+     * @brief Writes the densities, one column for every bandwidth
+     */
+    template<int mode, typename TableType>
+    void GetDensities(TableType* table) {
+      if (mode == 0) {
+        table->Init("", std::vector<index_t>(1,
+                    densities_.empty() ? 0 : densities_[0].size()),
+                    std::vector<index_t>(), densities_.size());
+      }
+      for (size_t i = 0; i < densities_.size(); i++) {
+        typename TableType::Point_t point;
+        table->get(i, &point);
+        for (size_t j = 0; j < densities_[i].size(); ++j) {
+          point.set(j, densities_[i][j]);
+        }
+      }
+    }
+
+    void Init(int num_points) {
+      densities_l_.resize(num_points);
+      densities_.resize(num_points);
+      densities_u_.resize(num_points);
+      pruned_.resize(num_points);
+
+      SetZero();
+    }
+
+    void SetZero() {
+      for (int i = 0; i < static_cast<int>(densities_l_.size()); i++) {
+        densities_l_[i].clear();
+        densities_[i].clear();
+        densities_u_[i].clear();
+        pruned_[i] = 0;
+      }
+    }
+
+    template<typename GlobalType, typename TreeType, typename DeltaType>
+    void ApplyProbabilisticDelta(const GlobalType &global,
+                                 TreeType *qnode,
+                                 double failure_probability,
+                                 const DeltaType &delta_in) {
+      fl::logger->Die() << "Monte Carlo is not supported on a grid of "
+                        "bandwidths";
+    }
+
+    void ApplyPostponed(int q_index,
+                        const KdeGridPostponed<CalcPrecision_t> &postponed_in) {
+      KdeGridAdd(postponed_in.densities_l_, &densities_l_[q_index]);
+      KdeGridAdd(postponed_in.densities_u_, &densities_u_[q_index]);
+      pruned_[q_index] += postponed_in.pruned_;
+    }
+};
+
+template<typename CalcPrecision_t>
+class KdeGridDelta {
+
+  public:
+
+    std::vector<CalcPrecision_t> densities_l_;
+
+    std::vector<CalcPrecision_t> densities_u_;
+
+    CalcPrecision_t pruned_;
+
+    std::vector< fl::ml::MeanVariancePair > *mean_variance_pair_;
+
+    KdeGridDelta() {
+      SetZero();
+    }
+
+    ~KdeGridDelta() {
+    }
+
+    void SetZero() {
+      std::fill(densities_l_.begin(), densities_l_.end(), 0);
+      std::fill(densities_u_.begin(), densities_u_.end(), 0);
+      pruned_ = 0;
+      mean_variance_pair_ = NULL;
+    }
+
+    template<typename MetricType, typename GlobalType, typename TreeType>
+    void DeterministicCompute(
+      const MetricType &metric,
+      const GlobalType &global, TreeType *qnode, TreeType *rnode,
+      const GenRange<CalcPrecision_t> &squared_distance_range) {
+
+      index_t rnode_count = global.reference_table()->get_node_count(rnode);
+      global.EvalUnnormOnSq(squared_distance_range.hi, &densities_l_);
+      global.EvalUnnormOnSq(squared_distance_range.lo, &densities_u_);
+      for (int i = 0; i < global.n_bandwidths(); ++i) {
+        densities_l_[i] *= rnode_count;
+        densities_u_[i] *= rnode_count;
+      }
+      pruned_ = (CalcPrecision_t) rnode_count;
+    }
+};
+
+template<typename CalcPrecision_t>
+class KdeGridSummary {
+
+  public:
+
+    std::vector<CalcPrecision_t> densities_l_;
+
+    std::vector<CalcPrecision_t> densities_u_;
+
+    CalcPrecision_t pruned_l_;
+
+    KdeGridSummary() {
+      SetZero();
+    }
+
+    ~KdeGridSummary() {
+    }
+
+    /**
+     * @brief The samples of the Monte Carlo summaries are not shared
+     *        between the bandwidths, so the grid never samples
+     */
+    template < typename MetricType, typename GlobalType, typename DeltaType,
+    typename TreeType, typename ResultType >
+    bool CanProbabilisticSummarize(
+      const MetricType &metric, const GlobalType &global,
+      DeltaType &delta, TreeType *qnode, TreeType *rnode,
+      double failure_probability, ResultType *query_results) const {
+      return false;
+    }
+
+    /**
+     * @brief The pair is pruned only if the bounds of every bandwidth
+     *        meet its relative error
+     */
+    template < typename GlobalType, typename DeltaType, typename TreeType,
+    typename ResultType >
+    bool CanSummarize(
+      const GlobalType &global, const DeltaType &delta,
+      TreeType *qnode, TreeType *rnode, ResultType *query_results) const {
+
+      double error_per_density =
+        global.reference_table()->get_node_count(rnode) *
+        global.relative_error() /
+        static_cast<double>(global.reference_table()->n_entries() -
+            global.reference_table()->n_deleted_entries());
+      for (size_t i = 0; i < delta.densities_l_.size(); ++i) {
+        double left_hand_side =
+          0.5 * (delta.densities_u_[i] - delta.densities_l_[i]);
+        double right_hand_side = error_per_density *
+                                 (i < densities_l_.size() ? densities_l_[i] : 0);
+        if (left_hand_side > right_hand_side) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    void SetZero() {
+      densities_l_.clear();
+      densities_u_.clear();
+      pruned_l_ = 0;
+      reaccumulate_ = false;
+    }
+
+    void Init() {
+      SetZero();
+    }
+
+    void StartReaccumulate() {
+      densities_l_.clear();
+      densities_u_.clear();
+      pruned_l_ = std::numeric_limits<CalcPrecision_t>::max();
+      reaccumulate_ = true;
+    }
+
+    template<typename ResultType>
+    void Accumulate(const ResultType &results, index_t q_index) {
+      Accumulate_(results.densities_l_[q_index], results.densities_u_[q_index],
+                  results.pruned_[q_index]);
+    }
+
+    void Accumulate(const KdeGridSummary<CalcPrecision_t> &summary_in) {
+      Accumulate_(summary_in.densities_l_, summary_in.densities_u_,
+                  summary_in.pruned_l_);
+    }
+
+    void Accumulate(const KdeGridSummary<CalcPrecision_t> &summary_in,
+                    const KdeGridPostponed<CalcPrecision_t> &postponed_in) {
+      std::vector<CalcPrecision_t> densities_l(summary_in.densities_l_);
+      std::vector<CalcPrecision_t> densities_u(summary_in.densities_u_);
+      KdeGridAdd(postponed_in.densities_l_, &densities_l);
+      KdeGridAdd(postponed_in.densities_u_, &densities_u);
+      Accumulate_(densities_l, densities_u,
+                  summary_in.pruned_l_ + postponed_in.pruned_);
+    }
+
+    void ApplyDelta(const KdeGridDelta<CalcPrecision_t> &delta_in) {
+      KdeGridAdd(delta_in.densities_l_, &densities_l_);
+      KdeGridAdd(delta_in.densities_u_, &densities_u_);
+    }
+
+    void ApplyPostponed(const KdeGridPostponed<CalcPrecision_t>
+                        &postponed_in) {
+      KdeGridAdd(postponed_in.densities_l_, &densities_l_);
+      KdeGridAdd(postponed_in.densities_u_, &densities_u_);
+      pruned_l_ += postponed_in.pruned_;
+    }
+
+  private:
+    /**
+     * @brief After StartReaccumulate the first bounds are copied, the
+     *        ones after them are merged
+     */
+    void Accumulate_(const std::vector<CalcPrecision_t> &densities_l,
+                     const std::vector<CalcPrecision_t> &densities_u,
+                     CalcPrecision_t pruned) {
+      if (reaccumulate_) {
+        densities_l_ = densities_l;
+        densities_u_ = densities_u;
+        reaccumulate_ = false;
+      }
+      else {
+        size_t size = std::max(densities_l_.size(), densities_l.size());
+        densities_l_.resize(size, 0);
+        densities_u_.resize(size, 0);
+        for (size_t i = 0; i < size; ++i) {
+          densities_l_[i] = std::min(densities_l_[i], i < densities_l.size() ?
+                                     densities_l[i] : 0);
+          densities_u_[i] = std::max(densities_u_[i], i < densities_u.size() ?
+                                     densities_u[i] : 0);
+        }
+      }
+      pruned_l_ = std::min(pruned_l_, pruned);
+    }
+
+    /** The summary has been reset and nothing is accumulated yet. */
+    bool reaccumulate_;
+};
+
+template<typename CalcPrecision_t>
+class KdeGridStatistic : public fl::tree::AbstractStatistic {
+
+  public:
+
+    fl::ml::KdeGridPostponed<CalcPrecision_t> postponed;
+
+    fl::ml::KdeGridSummary<CalcPrecision_t> summary;
+
+    KdeGridStatistic() {
+    }
+
+    ~KdeGridStatistic() {
+    }
+
+    void SetZero() {
+      postponed.SetZero();
+      summary.SetZero();
+    }
+
+    template<typename TreeIterator>
+    void Init(TreeIterator &it) {
+      SetZero();
+    }
+
+    template<typename TreeIterator>
+    void Init(TreeIterator &it,
+              const KdeGridStatistic& left_stat,
+              const KdeGridStatistic& right_stat) {
+      SetZero();
+    }
+};
+}
+}
+
+#endif
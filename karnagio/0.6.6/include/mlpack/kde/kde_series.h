@@ -0,0 +1,355 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef FL_LITE_MLPACK_KDE_KDE_SERIES_H
+#define FL_LITE_MLPACK_KDE_KDE_SERIES_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "fastlib/base/base.h"
+#include "fastlib/math/fl_math.h"
+#include "fastlib/metric_kernel/lmetric.h"
+#include "mlpack/kde/dualtree_dfs.h"
+
+namespace fl {
+namespace ml {
+
+/**
+ * @brief Summarizes a node pair with a series expansion of the kernel.
+ *        Only the gaussian kernel has one, so for every other kernel
+ *        the pair is never summarized this way.
+ */
+template<typename KernelType>
+class KdeSeries {
+  public:
+    template < typename MetricType, typename GlobalType, typename DeltaType,
+    typename SummaryType, typename TreeType, typename ResultType >
+    bool CanSummarize(
+      const MetricType &metric, const GlobalType &global,
+      const DeltaType &delta, const SummaryType &summary,
+      TreeType *qnode, TreeType *rnode, ResultType *query_results) {
+      return false;
+    }
+
+    template < typename GlobalType, typename DeltaType, typename TreeType,
+    typename ResultType >
+    void Summarize(const GlobalType &global, const DeltaType &delta,
+                   TreeType *qnode, TreeType *rnode,
+                   ResultType *query_results) {
+    }
+};
+
+/**
+ * @brief The series of the gaussian kernel under the l2 metric.
+ *        With s = sqrt(2) h, the kernel between a query x and a
+ *        reference y factors over the dimensions, and in every
+ *        dimension
+ *        exp(-(u - t)^2) = sum_n t^n / n! h_n(u),
+ *        where h_n(u) = H_n(u) exp(-u^2) is the hermite function.
+ *        The far field expansion takes t = (y - c_R) / s about the
+ *        center of the reference node and u = (x - c_R) / s, the
+ *        local expansion swaps the roles of the two and expands about
+ *        the center of the query node. Both keep the orders below p
+ *        in every dimension, that is p^D coefficients, which are
+ *        accumulated once over the reference points and are then
+ *        evaluated once for every query point, instead of visiting
+ *        every query and reference pair.
+ *
+ *        By Cramer's inequality |h_n(u)| <= 1.09 2^(n/2) sqrt(n!),
+ *        so if every t of the expanded node is within rho h / s, the
+ *        dropped terms of one dimension add up to at most
+ *        T = 1.09 rho^p / sqrt(p!) / (1 - rho / sqrt(p + 1))
+ *        and the product over the dimensions is off by at most
+ *        (1 + T)^D - 1 for each reference point. The order is the
+ *        smallest one that keeps this within the error that the
+ *        midpoint bounds of the pair would be allowed, and the
+ *        expansion is only used when (|Q| + |R|) p^D is cheaper than
+ *        the |Q| |R| D of the base case.
+ */
+template<typename Precision, bool USE_NORMALIZATION>
+class KdeSeries<fl::math::GaussianKernel<Precision, USE_NORMALIZATION> > {
+  public:
+    KdeSeries() {
+      far_field_ = true;
+      order_ = 0;
+      error_ = 0;
+      scale_ = 1;
+    }
+
+    /**
+     * @brief Other metrics change the kernel, it does not factor
+     *        the same way
+     */
+    template < typename MetricType, typename GlobalType, typename DeltaType,
+    typename SummaryType, typename TreeType, typename ResultType >
+    bool CanSummarize(
+      const MetricType &metric, const GlobalType &global,
+      const DeltaType &delta, const SummaryType &summary,
+      TreeType *qnode, TreeType *rnode, ResultType *query_results) {
+      return false;
+    }
+
+    template < typename GlobalType, typename DeltaType,
+    typename SummaryType, typename TreeType, typename ResultType >
+    bool CanSummarize(
+      const fl::math::LMetric<2> &metric, const GlobalType &global,
+      const DeltaType &delta, const SummaryType &summary,
+      TreeType *qnode, TreeType *rnode, ResultType *query_results) {
+
+      const typename GlobalType::Table_t *query_table = global.query_table();
+      const typename GlobalType::Table_t *reference_table =
+        global.reference_table();
+      const index_t dimension = reference_table->n_attributes();
+      const double qnode_count = query_table->get_node_count(qnode);
+      const double rnode_count = reference_table->get_node_count(rnode);
+      const double direct_cost = qnode_count * rnode_count * dimension;
+      // The highest order that is still cheaper than the base case.
+      // The first order only keeps a constant, where the midpoint
+      // bounds would have done as well, so it takes two at least.
+      int max_order = 1;
+      while (max_order < 16 &&
+             (qnode_count + rnode_count) *
+             (Power_(max_order + 1, dimension) + (max_order + 1) * dimension)
+             < direct_cost) {
+        ++max_order;
+      }
+      if (max_order < 2) {
+        return false;
+      }
+      if (NodesShareAPoint(query_table, qnode, reference_table, rnode)) {
+        return false;
+      }
+      // The same error that CanSummarize of the summary allows, for
+      // every reference point.
+      double point_error_bound = global.relative_error() *
+                                 summary.densities_l_ /
+                                 static_cast<double>(
+                                   reference_table->n_entries() -
+                                   reference_table->n_deleted_entries());
+      if (point_error_bound <= 0) {
+        return false;
+      }
+
+      // Expand about the smaller of the two nodes.
+      double query_radius = Radius_(query_table->get_node_bound(qnode),
+                                    dimension);
+      double reference_radius =
+        Radius_(reference_table->get_node_bound(rnode), dimension);
+      double bandwidth = sqrt(global.kernel().bandwidth_sq());
+      far_field_ = reference_radius <= query_radius;
+      double rho = std::min(query_radius, reference_radius) / bandwidth;
+
+      // The lowest order that meets the error, rho^p / sqrt(p!) is
+      // updated from one order to the next.
+      order_ = 0;
+      double term = 1;
+      for (int order = 1; order <= max_order; ++order) {
+        term *= rho / sqrt(static_cast<double>(order));
+        double ratio = rho / sqrt(order + 1.0);
+        if (ratio >= 1) {
+          continue;
+        }
+        double tail = 1.09 * term / (1 - ratio);
+        double point_error = Power_(1 + tail, dimension) - 1;
+        if (point_error <= point_error_bound) {
+          order_ = order;
+          error_ = rnode_count * point_error;
+          break;
+        }
+      }
+      if (order_ == 0) {
+        return false;
+      }
+      Center_(far_field_ ? reference_table->get_node_bound(rnode) :
+              query_table->get_node_bound(qnode), dimension);
+      scale_ = sqrt(2.0) * bandwidth;
+      return true;
+    }
+
+    template < typename GlobalType, typename DeltaType, typename TreeType,
+    typename ResultType >
+    void Summarize(const GlobalType &global, const DeltaType &delta,
+                   TreeType *qnode, TreeType *rnode,
+                   ResultType *query_results) {
+
+      const index_t dimension = global.reference_table()->n_attributes();
+      index_t num_terms = 1;
+      for (index_t d = 0; d < dimension; ++d) {
+        num_terms *= order_;
+      }
+      std::vector<double> coefficients(num_terms, 0.0);
+      std::vector<double> products(num_terms);
+      std::vector<double> factors(dimension * order_);
+
+      // Accumulate the coefficients over the reference points, the far
+      // field takes the powers of the reference points and the local
+      // expansion the hermite functions.
+      typename GlobalType::Table_t::TreeIterator rnode_it =
+        global.reference_table()->get_node_iterator(rnode);
+      typename GlobalType::Table_t::Point_t rpoint;
+      index_t rpoint_index;
+      while (rnode_it.HasNext()) {
+        rnode_it.Next(&rpoint, &rpoint_index);
+        Factors_(rpoint, dimension, !far_field_, true, &factors);
+        TensorProduct_(factors, dimension, &products);
+        for (index_t i = 0; i < num_terms; ++i) {
+          coefficients[i] += products[i];
+        }
+      }
+
+      // Evaluate them at every query point.
+      typename GlobalType::Table_t::TreeIterator qnode_it =
+        global.query_table()->get_node_iterator(qnode);
+      typename GlobalType::Table_t::Point_t qpoint;
+      index_t qpoint_index;
+      while (qnode_it.HasNext()) {
+        qnode_it.Next(&qpoint, &qpoint_index);
+        Factors_(qpoint, dimension, far_field_, false, &factors);
+        TensorProduct_(factors, dimension, &products);
+        double value = 0;
+        for (index_t i = 0; i < num_terms; ++i) {
+          value += coefficients[i] * products[i];
+        }
+        query_results->densities_l_[qpoint_index] +=
+          std::max<double>(value - error_, delta.densities_l_);
+        query_results->densities_u_[qpoint_index] +=
+          std::min<double>(value + error_, delta.densities_u_);
+        query_results->pruned_[qpoint_index] += delta.pruned_;
+      }
+    }
+
+  private:
+    /** x^n, the powers here are too small for pow to pay off. */
+    static double Power_(double x, index_t n) {
+      double result = 1;
+      for (index_t i = 0; i < n; ++i) {
+        result *= x;
+      }
+      return result;
+    }
+
+    /**
+     * @brief The largest half width of the box of the bound
+     */
+    template<typename BoundType>
+    double Radius_(const BoundType &bound, index_t dimension) const {
+      double radius = 0;
+      for (index_t d = 0; d < dimension; ++d) {
+        radius = std::max<double>(radius,
+                                  0.5 * (bound.get(d).hi - bound.get(d).lo));
+      }
+      return radius;
+    }
+
+    /**
+     * @brief Expands about the center of the box of the bound
+     */
+    template<typename BoundType>
+    void Center_(const BoundType &bound, index_t dimension) {
+      center_.resize(dimension);
+      for (index_t d = 0; d < dimension; ++d) {
+        center_[d] = 0.5 * (bound.get(d).lo + bound.get(d).hi);
+      }
+    }
+
+    /**
+     * @brief The one dimensional terms of a point, the powers or the
+     *        hermite functions of (point - center) / s up to the order,
+     *        divided by n! on the side of the coefficients
+     */
+    template<typename PointType>
+    void Factors_(const PointType &point, index_t dimension,
+                  bool hermite, bool divide_factorial,
+                  std::vector<double> *factors) {
+      for (index_t d = 0; d < dimension; ++d) {
+        double *f = &(*factors)[d * order_];
+        double u = (point[d] - center_[d]) / scale_;
+        if (hermite) {
+          f[0] = exp(-u * u);
+          if (order_ > 1) {
+            f[1] = 2 * u * f[0];
+          }
+          for (int n = 1; n + 1 < order_; ++n) {
+            f[n + 1] = 2 * u * f[n] - 2 * n * f[n - 1];
+          }
+        }
+        else {
+          f[0] = 1;
+          for (int n = 1; n < order_; ++n) {
+            f[n] = f[n - 1] * u;
+          }
+        }
+        if (divide_factorial) {
+          double factorial = 1;
+          for (int n = 1; n < order_; ++n) {
+            factorial *= n;
+            f[n] /= factorial;
+          }
+        }
+      }
+    }
+
+    /**
+     * @brief Multiplies out the terms of every dimension, the order of
+     *        the first dimension varies the slowest
+     */
+    void TensorProduct_(const std::vector<double> &factors,
+                        index_t dimension, std::vector<double> *products) {
+      (*products)[0] = 1;
+      index_t size = 1;
+      for (index_t d = 0; d < dimension; ++d) {
+        const double *f = &factors[d * order_];
+        // going backwards the products of the previous dimensions are
+        // read before they are overwritten
+        for (index_t k = size - 1; k >= 0; --k) {
+          double product = (*products)[k];
+          for (int n = order_ - 1; n >= 0; --n) {
+            (*products)[k * order_ + n] = product * f[n];
+          }
+        }
+        size *= order_;
+      }
+    }
+
+    /** Whether the expansion is about the reference node. */
+    bool far_field_;
+
+    /** The orders below this are kept in every dimension. */
+    int order_;
+
+    /** The bound on the error for every query point. */
+    double error_;
+
+    /** The center of the expansion. */
+    std::vector<double> center_;
+
+    /** sqrt(2) times the bandwidth. */
+    double scale_;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,254 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef FL_LITE_MLPACK_KDE_KDE_SERVICE_H_
+#define FL_LITE_MLPACK_KDE_KDE_SERVICE_H_
+#include <deque>
+#include <string>
+#include <vector>
+// boost headers go first, fastlib/base/compiler.h defines expect and likely
+#include "boost/date_time/posix_time/posix_time.hpp"
+#include "boost/program_options.hpp"
+#include "boost/serialization/string.hpp"
+#include "boost/serialization/vector.hpp"
+#include "boost/scoped_ptr.hpp"
+#include "boost/shared_ptr.hpp"
+#include "boost/thread/condition_variable.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/thread/thread.hpp"
+#include "mlpack/kde/kde.h"
+#include "fastlib/table/point_filters.h"
+#include "fastlib/communication/client.h"
+#include "fastlib/communication/server.h"
+#include "fastlib/communication/session_server.h"
+
+namespace fl {
+namespace ml {
+  /**
+   * @brief A batch of events sent to the kde service. The points are dense
+   *        and stored one after the other. If score is set the service
+   *        answers the density of every point given the references it has
+   *        at that moment, if append is set the points become references
+   *        after they are scored. A request with stop set shuts the
+   *        service down
+   */
+  struct KdeRequest {
+    public:
+      KdeRequest() : dimension(0), score(true), append(false), stop(false) {
+      }
+      index_t dimension;
+      std::vector<double> points;
+      bool score;
+      bool append;
+      bool stop;
+
+      template<typename Archive>
+      void serialize(Archive &ar, const unsigned int version) {
+        ar & dimension;
+        ar & points;
+        ar & score;
+        ar & append;
+        ar & stop;
+      }
+  };
+
+  /**
+   * @brief The answer to a KdeRequest, the density of every point if it
+   *        was scored and the number of references after the request. If
+   *        the request could not be served error says why
+   */
+  struct KdeResponse {
+    public:
+      KdeResponse() : n_references(0) {
+      }
+      std::vector<double> densities;
+      index_t n_references;
+      std::string error;
+
+      template<typename Archive>
+      void serialize(Archive &ar, const unsigned int version) {
+        ar & densities;
+        ar & n_references;
+        ar & error;
+      }
+  };
+
+  template<typename TemplateArgs>
+  class KdeService;
+
+  /**
+   * @brief A long running kernel density service for streams of events.
+   *        The reference table is loaded and indexed once and stays in
+   *        memory, the events that are appended go in the existing tree
+   *        with InsertData instead of rebuilding it. Every event is scored
+   *        against the references that came before it, which is what
+   *        --filter=time of kde does on a table with timestamps, without
+   *        rescoring the old events
+   */
+  template<>
+  class KdeService<boost::mpl::void_> {
+    public:
+      /**
+       * @brief Collects the requests of all the connections and serves
+       *        them in the order they arrived. The scores of consecutive
+       *        requests are computed in one dual tree traversal, a batch
+       *        ends after a request that appends, so that every request
+       *        sees the appends of the requests before it. A batch starts
+       *        with the oldest request and takes the ones that arrive in
+       *        the next batch_window microseconds, up to max_batch_points
+       *        points. If window is positive only the latest window
+       *        references are kept
+       */
+      template<typename TableType, typename KernelType>
+      class DensityStream : private boost::noncopyable {
+        public:
+          DensityStream(TableType *references,
+                        double bandwidth,
+                        double relative_error,
+                        index_t max_batch_points,
+                        int batch_window,
+                        index_t leaf_size,
+                        int n_threads,
+                        index_t window);
+          ~DensityStream();
+          void Start();
+          void Stop();
+          /**
+           * @brief Blocks until the batch the request went in is computed
+           */
+          void Submit(const KdeRequest &request, KdeResponse *response);
+          index_t num_of_batches() const;
+          index_t num_of_requests() const;
+          index_t num_of_references() const;
+
+        private:
+          struct Pending_ {
+            const KdeRequest *request;
+            KdeResponse *response;
+            bool done;
+          };
+          typedef Kde<boost::mpl::void_>::Core<TableType> Core_t;
+          typedef Kde<typename Core_t::template KdeArgs<KernelType,
+                  fl::math::LMetric<2>,
+                  fl::table::NullFilter,
+                  Core_t::template KdeStructArgs> > Kde_t;
+          TableType *references_;
+          double bandwidth_;
+          double relative_error_;
+          index_t max_batch_points_;
+          int batch_window_;
+          index_t leaf_size_;
+          int n_threads_;
+          index_t window_;
+          std::deque<Pending_*> queue_;
+          index_t queued_points_;
+          bool stopped_;
+          index_t num_of_batches_;
+          index_t num_of_requests_;
+          index_t num_of_references_;
+          mutable boost::mutex mutex_;
+          boost::condition_variable arrived_;
+          boost::condition_variable finished_;
+          boost::scoped_ptr<boost::thread> worker_;
+
+          void Run_();
+          void ScoreBatch_(const std::vector<Pending_*> &batch);
+          void AppendBatch_(const std::vector<Pending_*> &batch);
+          /**
+           * @brief Deletes the oldest references that do not fit in the
+           *        window
+           */
+          void Forget_();
+          /**
+           * @brief Puts the points of the requests that score, or of the
+           *        ones that append, in a table and returns their number.
+           *        The table is left empty if there are none
+           */
+          index_t MakeTable_(const std::vector<Pending_*> &batch,
+                             bool scored,
+                             TableType *table);
+      };
+
+      /**
+       * @brief The handler of the fl::com::SessionServer, the events of
+       *        all the connections go to the stream
+       */
+      template<typename StreamType>
+      struct ResponderServer : private boost::noncopyable {
+        public:
+          typedef KdeRequest Request_t;
+          typedef KdeResponse Response_t;
+          ResponderServer(StreamType *stream);
+          void operator()(const KdeRequest &request, KdeResponse *response);
+
+        private:
+          StreamType *stream_;
+      };
+
+      /**
+       * @brief The responder of the fl::com::Client that sends the points
+       *        of a table as a feed of events, request_points at a time,
+       *        and collects their densities
+       */
+      template<typename TableType>
+      struct ResponderClient : private boost::noncopyable {
+        public:
+          ResponderClient(const TableType *events,
+                          index_t request_points,
+                          bool score,
+                          bool append,
+                          std::vector<double> *densities);
+          bool operator()(const boost::system::error_code& e,
+                          fl::com::connection_ptr conn);
+
+        private:
+          const TableType *events_;
+          index_t request_points_;
+          bool score_;
+          bool append_;
+          std::vector<double> *densities_;
+      };
+
+      /**
+       * @brief Depending on --mode it runs the service, a client that
+       *        sends an event table to the service, or it stops a running
+       *        service
+       */
+      template<typename DataAccessType>
+      static int Main(DataAccessType *data,
+                      const std::vector<std::string> &args);
+
+    private:
+      /**
+       * @brief Main without the argument parsing, for the kernel of
+       *        --kernel
+       */
+      template<typename KernelType, typename DataAccessType>
+      static int Run_(DataAccessType *data,
+                      const boost::program_options::variables_map &vm);
+  };
+}}
+
+#endif
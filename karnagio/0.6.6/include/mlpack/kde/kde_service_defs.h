@@ -0,0 +1,710 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef FL_LITE_MLPACK_KDE_KDE_SERVICE_DEFS_H_
+#define FL_LITE_MLPACK_KDE_KDE_SERVICE_DEFS_H_
+#include <algorithm>
+#include "boost/program_options.hpp"
+#include "mlpack/kde/kde_service.h"
+#include "mlpack/kde/kde_dev.h"
+#include "fastlib/util/timer.h"
+#include "fastlib/workspace/arguments.h"
+
+namespace fl { namespace ml {
+
+template<typename TableType, typename KernelType>
+KdeService<boost::mpl::void_>::DensityStream<TableType, KernelType>::DensityStream(
+    TableType *references,
+    double bandwidth,
+    double relative_error,
+    index_t max_batch_points,
+    int batch_window,
+    index_t leaf_size,
+    int n_threads,
+    index_t window) :
+  references_(references),
+  bandwidth_(bandwidth),
+  relative_error_(relative_error),
+  max_batch_points_(max_batch_points),
+  batch_window_(batch_window),
+  leaf_size_(leaf_size),
+  n_threads_(n_threads),
+  window_(window),
+  queued_points_(0),
+  stopped_(true),
+  num_of_batches_(0),
+  num_of_requests_(0),
+  num_of_references_(references->n_entries()-
+      references->n_deleted_entries()) {
+}
+
+template<typename TableType, typename KernelType>
+KdeService<boost::mpl::void_>::DensityStream<TableType, KernelType>::~DensityStream() {
+  Stop();
+}
+
+template<typename TableType, typename KernelType>
+void KdeService<boost::mpl::void_>::DensityStream<TableType, KernelType>::Start() {
+  boost::mutex::scoped_lock lock(mutex_);
+  if (worker_) {
+    return;
+  }
+  Forget_();
+  num_of_references_=references_->n_entries()-
+    references_->n_deleted_entries();
+  stopped_=false;
+  worker_.reset(new boost::thread(
+      boost::bind(&DensityStream<TableType, KernelType>::Run_, this)));
+}
+
+template<typename TableType, typename KernelType>
+void KdeService<boost::mpl::void_>::DensityStream<TableType, KernelType>::Stop() {
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stopped_=true;
+  }
+  arrived_.notify_all();
+  if (worker_) {
+    worker_->join();
+    worker_.reset();
+  }
+}
+
+template<typename TableType, typename KernelType>
+void KdeService<boost::mpl::void_>::DensityStream<TableType, KernelType>::Submit(
+    const KdeRequest &request, KdeResponse *response) {
+  response->densities.clear();
+  response->n_references=0;
+  response->error.clear();
+  const index_t dimension=references_->n_attributes();
+  if (request.dimension!=dimension) {
+    response->error="the points must have "
+      +boost::lexical_cast<std::string>(dimension)+" dimensions";
+    return;
+  }
+  if (request.points.empty() || request.points.size() % dimension!=0) {
+    response->error="the request must contain a whole number of points";
+    return;
+  }
+  if (request.score==false && request.append==false) {
+    response->error="the request must score or append its points";
+    return;
+  }
+  Pending_ pending;
+  pending.request=&request;
+  pending.response=response;
+  pending.done=false;
+  boost::mutex::scoped_lock lock(mutex_);
+  if (stopped_) {
+    response->error="the service is shutting down";
+    return;
+  }
+  queue_.push_back(&pending);
+  queued_points_+=request.points.size()/dimension;
+  arrived_.notify_all();
+  while (pending.done==false) {
+    finished_.wait(lock);
+  }
+}
+
+template<typename TableType, typename KernelType>
+index_t KdeService<boost::mpl::void_>::DensityStream<TableType, KernelType>::num_of_batches() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return num_of_batches_;
+}
+
+template<typename TableType, typename KernelType>
+index_t KdeService<boost::mpl::void_>::DensityStream<TableType, KernelType>::num_of_requests() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return num_of_requests_;
+}
+
+template<typename TableType, typename KernelType>
+index_t KdeService<boost::mpl::void_>::DensityStream<TableType, KernelType>::num_of_references() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return num_of_references_;
+}
+
+template<typename TableType, typename KernelType>
+void KdeService<boost::mpl::void_>::DensityStream<TableType, KernelType>::Run_() {
+  const index_t dimension=references_->n_attributes();
+  std::vector<Pending_*> batch;
+  while (true) {
+    batch.clear();
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      while (queue_.empty() && stopped_==false) {
+        arrived_.wait(lock);
+      }
+      if (stopped_) {
+        for(size_t i=0; i<queue_.size(); ++i) {
+          queue_[i]->response->error="the service is shutting down";
+          queue_[i]->done=true;
+        }
+        queue_.clear();
+        queued_points_=0;
+        finished_.notify_all();
+        return;
+      }
+      // give the requests that are on their way the chance to join the
+      // batch, a full batch does not wait
+      boost::system_time deadline=boost::get_system_time()
+        +boost::posix_time::microseconds(batch_window_);
+      while (queued_points_<max_batch_points_ && stopped_==false) {
+        if (arrived_.timed_wait(lock, deadline)==false) {
+          break;
+        }
+      }
+      // a request that scores can not go after one that appends, it has
+      // to see the new references
+      index_t batch_points=0;
+      bool appends=false;
+      while (queue_.empty()==false) {
+        const KdeRequest *request=queue_.front()->request;
+        const index_t n_points=request->points.size()/dimension;
+        if (batch.empty()==false && (batch_points+n_points>max_batch_points_
+              || (appends && request->score))) {
+          break;
+        }
+        batch.push_back(queue_.front());
+        queue_.pop_front();
+        batch_points+=n_points;
+        appends=appends || request->append;
+      }
+      queued_points_-=batch_points;
+    }
+    ScoreBatch_(batch);
+    AppendBatch_(batch);
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      for(size_t i=0; i<batch.size(); ++i) {
+        batch[i]->done=true;
+      }
+      num_of_batches_+=1;
+      num_of_requests_+=batch.size();
+      num_of_references_=references_->n_entries()-
+        references_->n_deleted_entries();
+    }
+    finished_.notify_all();
+  }
+}
+
+template<typename TableType, typename KernelType>
+void KdeService<boost::mpl::void_>::DensityStream<TableType, KernelType>::ScoreBatch_(
+    const std::vector<Pending_*> &batch) {
+  const index_t dimension=references_->n_attributes();
+  try {
+    TableType queries;
+    if (MakeTable_(batch, true, &queries)==0) {
+      return;
+    }
+    typename TableType::template IndexArgs<fl::math::LMetric<2> > index_args;
+    index_args.leaf_size=leaf_size_;
+    queries.IndexData(index_args);
+
+    Kde_t kde;
+    kde.Init(references_, &queries, bandwidth_, relative_error_, 1.0);
+    fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
+    dualtree_engine.Init(kde);
+    dualtree_engine.set_n_threads(n_threads_);
+    typename Kde_t::Result_t result;
+    dualtree_engine.Compute(fl::math::LMetric<2>(), &result);
+    index_t row=0;
+    for(size_t i=0; i<batch.size(); ++i) {
+      if (batch[i]->request->score==false) {
+        continue;
+      }
+      const index_t request_points=
+        batch[i]->request->points.size()/dimension;
+      batch[i]->response->densities.assign(
+          result.densities_.begin()+row,
+          result.densities_.begin()+row+request_points);
+      row+=request_points;
+    }
+  }
+  catch(const fl::Exception &exception) {
+    for(size_t i=0; i<batch.size(); ++i) {
+      batch[i]->response->densities.clear();
+      batch[i]->response->error="the batch of the request failed";
+    }
+  }
+}
+
+template<typename TableType, typename KernelType>
+void KdeService<boost::mpl::void_>::DensityStream<TableType, KernelType>::AppendBatch_(
+    const std::vector<Pending_*> &batch) {
+  const index_t dimension=references_->n_attributes();
+  index_t n_references=references_->n_entries()-
+    references_->n_deleted_entries();
+  try {
+    TableType points;
+    if (MakeTable_(batch, false, &points)>0) {
+      // the tree is updated in place, only the nodes on the way of the
+      // new points change
+      typename TableType::template IndexArgs<fl::math::LMetric<2> >
+        index_args;
+      index_args.leaf_size=leaf_size_;
+      references_->InsertData(points, index_args);
+      Forget_();
+    }
+  }
+  catch(const fl::Exception &exception) {
+    for(size_t i=0; i<batch.size(); ++i) {
+      batch[i]->response->n_references=references_->n_entries()-
+        references_->n_deleted_entries();
+      if (batch[i]->request->append) {
+        batch[i]->response->error="the points of the request were not "
+          "appended";
+      }
+    }
+    return;
+  }
+  for(size_t i=0; i<batch.size(); ++i) {
+    if (batch[i]->request->append) {
+      n_references+=batch[i]->request->points.size()/dimension;
+    }
+    batch[i]->response->n_references=
+      window_>0 ? std::min(n_references, window_) : n_references;
+  }
+}
+
+template<typename TableType, typename KernelType>
+void KdeService<boost::mpl::void_>::DensityStream<TableType, KernelType>::Forget_() {
+  const index_t n_deleted=references_->n_deleted_entries();
+  if (window_<=0 || references_->n_entries()-n_deleted<=window_) {
+    return;
+  }
+  // the appended points get the ids that follow the current ones, so the
+  // oldest references have the first ids and the ones deleted before are
+  // the first n_deleted
+  std::vector<index_t> ids(references_->n_entries()-n_deleted-window_);
+  for(size_t i=0; i<ids.size(); ++i) {
+    ids[i]=n_deleted+i;
+  }
+  typename TableType::template IndexArgs<fl::math::LMetric<2> > index_args;
+  index_args.leaf_size=leaf_size_;
+  references_->DeleteData(ids, index_args);
+  // the tombstones are freed once they outnumber the window, so the
+  // table never holds more than twice the points of the window
+  if (references_->n_deleted_entries()>window_) {
+    references_->CompactData();
+  }
+}
+
+template<typename TableType, typename KernelType>
+index_t KdeService<boost::mpl::void_>::DensityStream<TableType, KernelType>::MakeTable_(
+    const std::vector<Pending_*> &batch,
+    bool scored,
+    TableType *table) {
+  const index_t dimension=references_->n_attributes();
+  index_t n_points=0;
+  for(size_t i=0; i<batch.size(); ++i) {
+    const KdeRequest *request=batch[i]->request;
+    if (scored ? request->score : request->append) {
+      n_points+=request->points.size()/dimension;
+    }
+  }
+  if (n_points==0) {
+    return 0;
+  }
+  table->Init(std::vector<index_t>(1, dimension),
+              std::vector<index_t>(),
+              n_points);
+  typename TableType::Point_t point;
+  index_t row=0;
+  for(size_t i=0; i<batch.size(); ++i) {
+    const KdeRequest *request=batch[i]->request;
+    if ((scored ? request->score : request->append)==false) {
+      continue;
+    }
+    const std::vector<double> &points=request->points;
+    for(size_t j=0; j<points.size(); j+=dimension, ++row) {
+      table->get(row, &point);
+      for(index_t d=0; d<dimension; ++d) {
+        point.set(d, points[j+d]);
+      }
+    }
+  }
+  return n_points;
+}
+
+template<typename StreamType>
+KdeService<boost::mpl::void_>::ResponderServer<StreamType>::ResponderServer(
+    StreamType *stream) :
+  stream_(stream) {
+}
+
+template<typename StreamType>
+void KdeService<boost::mpl::void_>::ResponderServer<StreamType>::operator()(
+    const KdeRequest &request,
+    KdeResponse *response) {
+  stream_->Submit(request, response);
+}
+
+template<typename TableType>
+KdeService<boost::mpl::void_>::ResponderClient<TableType>::ResponderClient(
+    const TableType *events,
+    index_t request_points,
+    bool score,
+    bool append,
+    std::vector<double> *densities) :
+  events_(events),
+  request_points_(request_points),
+  score_(score),
+  append_(append),
+  densities_(densities) {
+}
+
+template<typename TableType>
+bool KdeService<boost::mpl::void_>::ResponderClient<TableType>::operator()(
+    const boost::system::error_code& e,
+    fl::com::connection_ptr conn) {
+  conn->socket().set_option(boost::asio::ip::tcp::no_delay(true));
+  densities_->clear();
+  KdeRequest request;
+  KdeResponse response;
+  for(index_t i=0; i<events_->n_entries(); i+=request_points_) {
+    fl::com::CopyPoints(*events_, i,
+        std::min(request_points_, events_->n_entries()-i), &request);
+    request.score=score_;
+    request.append=append_;
+    if (fl::com::Exchange(conn, request, &response)==false) {
+      fl::logger->Die()<<"The service did not take the events";
+    }
+    densities_->insert(densities_->end(),
+        response.densities.begin(), response.densities.end());
+  }
+  return true;
+}
+
+template<typename DataAccessType>
+int KdeService<boost::mpl::void_>::Main(DataAccessType *data,
+    const std::vector<std::string> &args) {
+  boost::program_options::options_description desc("Available options");
+  desc.add_options()(
+    "help", "Print this information."
+  )(
+    "mode",
+    boost::program_options::value<std::string>()->default_value("server"),
+    "One of:\n"
+    "  server: keeps the references in memory, scores the events of the "
+    "clients and appends them to the references\n"
+    "  client: sends --events_in to the service and exports their "
+    "densities\n"
+    "  stop: stops a running service"
+  )(
+    "references_in",
+    boost::program_options::value<std::string>()->default_value(""),
+    "the reference points the service starts with. In the client mode it "
+    "starts a service inside the same process on --port"
+  )(
+    "events_in",
+    boost::program_options::value<std::string>()->default_value(""),
+    "the events the client sends, in the order they happened"
+  )(
+    "action",
+    boost::program_options::value<std::string>()->default_value("score_append"),
+    "what the client asks for every event. One of:\n"
+    "  score: its density given the references before it\n"
+    "  append: it becomes a reference\n"
+    "  score_append: both, it is scored first"
+  )(
+    "host",
+    boost::program_options::value<std::string>()->default_value("127.0.0.1"),
+    "the host the service runs on"
+  )(
+    "port",
+    boost::program_options::value<std::string>()->default_value("4555"),
+    "the port the service listens to"
+  )(
+    "kernel",
+    boost::program_options::value<std::string>()->default_value("gaussian"),
+    "Kernel function used by KDE. One of:\n"
+    "  epan, gaussian"
+  )(
+    "bandwidth",
+    boost::program_options::value<double>(),
+    "REQUIRED the bandwidth of the kernel"
+  )(
+    "relative_error",
+    boost::program_options::value<double>()->default_value(0.01),
+    "Relative error for the approximation of KDE."
+  )(
+    "window",
+    boost::program_options::value<index_t>()->default_value(0),
+    "if positive the service keeps only the latest window references and "
+    "forgets the older ones"
+  )(
+    "leaf_size",
+    boost::program_options::value<index_t>()->default_value(20),
+    "the leaf size of the trees built on the references and on every batch"
+  )(
+    "threads",
+    boost::program_options::value<int>()->default_value(1),
+    "the number of threads every batch is computed with"
+  )(
+    "batch_points",
+    boost::program_options::value<index_t>()->default_value(1024),
+    "the maximum number of points scored by one traversal"
+  )(
+    "batch_window",
+    boost::program_options::value<int>()->default_value(500),
+    "microseconds the service waits for more requests before it starts a "
+    "batch that is not full"
+  )(
+    "request_points",
+    boost::program_options::value<index_t>()->default_value(1),
+    "the number of events in every request of the client"
+  )(
+    "densities_out",
+    boost::program_options::value<std::string>()->default_value(""),
+    "the densities of the events the client received"
+  );
+
+  fl::ws::AddWorkSpaceOptions(&desc);
+  boost::program_options::variables_map vm;
+  boost::program_options::command_line_parser clp(args);
+  clp.style(boost::program_options::command_line_style::default_style
+     ^boost::program_options::command_line_style::allow_guessing );
+  try {
+    boost::program_options::store(clp.options(desc).run(), vm);
+  }
+  catch(const boost::program_options::invalid_option_value &e) {
+    fl::logger->Die() << "Invalid Argument: " << e.what();
+  }
+  catch(const boost::program_options::invalid_command_line_syntax &e) {
+    fl::logger->Die() << "Invalid command line syntax: " << e.what();
+  }
+  catch (const boost::program_options::unknown_option &e) {
+    fl::logger->Die() << e.what() << std::endl;
+  }
+  catch ( const boost::program_options::error &e) {
+    fl::logger->Die() << e.what();
+  }
+  boost::program_options::notify(vm);
+  if (vm.count("help")) {
+    std::cout << fl::DISCLAIMER << "\n";
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  const std::string mode=vm["mode"].as<std::string>();
+  const std::string kernel=vm["kernel"].as<std::string>();
+  const std::string action=vm["action"].as<std::string>();
+  if (mode!="server" && mode!="client" && mode!="stop") {
+    fl::logger->Die()<<"--mode="<<mode<<" is not supported";
+  }
+  if (mode=="server" && vm["references_in"].as<std::string>()=="") {
+    fl::logger->Die()<<"The service needs --references_in";
+  }
+  if (kernel!="gaussian" && kernel!="epan") {
+    fl::logger->Die()<<"We support only epan or gaussian for the kernel.";
+  }
+  if (vm["references_in"].as<std::string>()!="" &&
+      (vm.count("bandwidth")==0 || vm["bandwidth"].as<double>()<=0)) {
+    fl::logger->Die()<<"The --bandwidth requires a positive real number";
+  }
+  if (vm["relative_error"].as<double>()<0) {
+    fl::logger->Die()<<"The --relative_error requires a real number $r >= 0$";
+  }
+  if (action!="score" && action!="append" && action!="score_append") {
+    fl::logger->Die()<<"--action="<<action<<" is not supported";
+  }
+  if (vm["window"].as<index_t>()<0) {
+    fl::logger->Die()<<"--window can not be negative";
+  }
+  if (vm["leaf_size"].as<index_t>()<=1) {
+    fl::logger->Die()<<"--leaf_size must be greater than 1";
+  }
+  if (vm["threads"].as<int>()<=0) {
+    fl::logger->Die()<<"--threads must be positive";
+  }
+  if (vm["batch_points"].as<index_t>()<=0) {
+    fl::logger->Die()<<"--batch_points must be positive";
+  }
+  if (vm["batch_window"].as<int>()<0) {
+    fl::logger->Die()<<"--batch_window can not be negative";
+  }
+  if (vm["request_points"].as<index_t>()<=0) {
+    fl::logger->Die()<<"--request_points must be positive";
+  }
+
+  if (mode=="stop") {
+    const std::string host=vm["host"].as<std::string>();
+    const std::string port=vm["port"].as<std::string>();
+    boost::asio::io_service io_service;
+    fl::com::connection conn(io_service);
+    boost::asio::ip::tcp::resolver resolver(io_service);
+    boost::asio::ip::tcp::resolver::query query(host, port);
+    try {
+      boost::asio::connect(conn.socket(), resolver.resolve(query));
+      KdeRequest request;
+      request.stop=true;
+      conn.sync_write(request);
+    }
+    catch(const std::exception &e) {
+      fl::logger->Die()<<"Could not reach the service on "<<host<<":"<<port
+        <<", "<<e.what();
+    }
+    return 0;
+  }
+
+  if (kernel=="epan") {
+    return Run_<fl::math::EpanKernel<double> >(data, vm);
+  }
+  return Run_<fl::math::GaussianKernel<double> >(data, vm);
+}
+
+template<typename KernelType, typename DataAccessType>
+int KdeService<boost::mpl::void_>::Run_(DataAccessType *data,
+    const boost::program_options::variables_map &vm) {
+  typedef typename DataAccessType::DefaultTable_t Table_t;
+  typedef DensityStream<Table_t, KernelType> Stream_t;
+  const std::string mode=vm["mode"].as<std::string>();
+  const std::string references_in=vm["references_in"].as<std::string>();
+  const std::string events_in=vm["events_in"].as<std::string>();
+  const std::string host=vm["host"].as<std::string>();
+  const std::string port=vm["port"].as<std::string>();
+  const std::string action=vm["action"].as<std::string>();
+  const index_t leaf_size=vm["leaf_size"].as<index_t>();
+
+  // the service, in the client mode it runs next to it when the references
+  // are given
+  boost::shared_ptr<Table_t> references;
+  boost::scoped_ptr<Stream_t> stream;
+  boost::asio::io_service io_service;
+  boost::scoped_ptr<ResponderServer<Stream_t> > handler;
+  boost::scoped_ptr<fl::com::SessionServer<ResponderServer<Stream_t> > >
+    responder;
+  boost::scoped_ptr<fl::com::Server<
+    fl::com::SessionServer<ResponderServer<Stream_t> > > > server;
+  boost::scoped_ptr<boost::thread> server_thread;
+  if (references_in!="") {
+    fl::logger->Message()<<"Loading the references "<<references_in;
+    data->Attach(references_in, &references);
+    if (references->is_indexed()==false) {
+      fl::logger->Message()<<"Building the reference tree";
+      typename Table_t::template IndexArgs<fl::math::LMetric<2> > index_args;
+      index_args.leaf_size=leaf_size;
+      references->IndexData(index_args);
+    }
+    stream.reset(new Stream_t(references.get(),
+          vm["bandwidth"].as<double>(),
+          vm["relative_error"].as<double>(),
+          vm["batch_points"].as<index_t>(),
+          vm["batch_window"].as<int>(),
+          leaf_size,
+          vm["threads"].as<int>(),
+          vm["window"].as<index_t>()));
+    stream->Start();
+    handler.reset(new ResponderServer<Stream_t>(stream.get()));
+    responder.reset(new fl::com::SessionServer<ResponderServer<Stream_t> >(
+          handler.get(), &io_service));
+    server.reset(new fl::com::Server<
+        fl::com::SessionServer<ResponderServer<Stream_t> > >(
+          io_service, port, responder.get()));
+    if (mode=="server") {
+      fl::logger->Message()<<"Scoring events against "
+        <<stream->num_of_references()<<" references on port "<<port;
+      io_service.run();
+      fl::logger->Message()<<"Answered "<<stream->num_of_requests()
+        <<" requests in "<<stream->num_of_batches()<<" batches, the service "
+        <<"ended with "<<stream->num_of_references()<<" references";
+      stream->Stop();
+      responder->Join();
+      return 0;
+    }
+    server_thread.reset(new boost::thread(
+          boost::bind(&boost::asio::io_service::run, &io_service)));
+  }
+
+  if (events_in=="") {
+    fl::logger->Die()<<"--mode="<<mode<<" needs --events_in";
+  }
+  boost::shared_ptr<Table_t> events;
+  data->Attach(events_in, &events);
+  if (events->n_entries()==0) {
+    fl::logger->Die()<<"There are no events in "<<events_in;
+  }
+
+  std::vector<double> densities;
+  fl::util::Timer timer;
+  timer.Start();
+  ResponderClient<Table_t> client(events.get(),
+      vm["request_points"].as<index_t>(),
+      action!="append", action!="score", &densities);
+  try {
+    boost::asio::io_service client_io_service;
+    fl::com::Client<ResponderClient<Table_t> > com_client(
+        client_io_service, host, port, &client);
+    client_io_service.run();
+  }
+  catch(const fl::Exception &exception) {
+  }
+  catch(const std::exception &exception) {
+    fl::logger->Warning()<<"Client failed: "<<exception.what();
+  }
+  timer.End();
+  if (action=="append") {
+    fl::logger->Message()<<"Appended "<<events->n_entries()<<" events in "
+      <<timer.GetTotalElapsedTimeString().c_str();
+  } else if (static_cast<index_t>(densities.size())==events->n_entries()) {
+    fl::logger->Message()<<"Received the densities of "
+      <<events->n_entries()<<" events in "
+      <<timer.GetTotalElapsedTimeString().c_str();
+    std::string densities_out=vm["densities_out"].as<std::string>();
+    if (densities_out=="") {
+      densities_out=data->GiveTempVarName();
+    }
+    boost::shared_ptr<typename DataAccessType::DefaultTable_t>
+      densities_table;
+    data->Attach(densities_out,
+        std::vector<index_t>(1, 1),
+        std::vector<index_t>(),
+        events->n_entries(),
+        &densities_table);
+    typename DataAccessType::DefaultTable_t::Point_t point;
+    for(index_t i=0; i<events->n_entries(); ++i) {
+      densities_table->get(i, &point);
+      point.set(0, densities[i]);
+    }
+    data->Purge(densities_out);
+    data->Detach(densities_out);
+  } else {
+    fl::logger->Warning()<<"The service did not score all the events";
+  }
+
+  if (server_thread) {
+    io_service.stop();
+    server_thread->join();
+    stream->Stop();
+    responder->Join();
+  }
+  return 0;
+}
+
+}}
+
+#endif
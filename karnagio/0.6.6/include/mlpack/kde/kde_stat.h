@@ -89,7 +89,19 @@ class KdePostponed {
                            const MetricType &metric,
                            const PointType &query_point,
                            const PointType &reference_point) {
-      double distsq = metric.DistanceSq(query_point, reference_point);
+      ApplyContribution(global,
+                        metric.DistanceSq(query_point, reference_point),
+                        reference_point);
+    }
+
+    /**
+     * @brief same as above, for a distance the base case has already
+     *        computed
+     */
+    template<typename GlobalType, typename PointType>
+    void ApplyContribution(const GlobalType &global,
+                           double distsq,
+                           const PointType &reference_point) {
       double density_incoming = global.kernel().EvalUnnormOnSq(distsq);
       densities_l_ = ((CalcPrecision_t) densities_l_ + density_incoming);
       densities_u_ = ((CalcPrecision_t) densities_u_ + density_incoming);
@@ -198,8 +210,10 @@ class KdeGlobal {
       reference_statistics_=references_stats;
       index_t effective_num_points =
         (is_monochromatic) ?
-        (reference_table_in->n_entries() - 1) :
-        reference_table_in->n_entries();
+        (reference_table_in->n_entries() -
+         reference_table_in->n_deleted_entries() - 1) :
+        (reference_table_in->n_entries() -
+         reference_table_in->n_deleted_entries());
       kernel_.Init(bandwidth_in);
       mult_const_ = 1.0 /
                     (kernel_.CalcNormConstant(
@@ -499,7 +513,8 @@ class KdeSummary {
         double right_hand_side =
           global.reference_table()->get_node_count(rnode) *
           global.relative_error() * modified_densities_l /
-          static_cast<double>(global.reference_table()->n_entries());
+          static_cast<double>(global.reference_table()->n_entries() -
+            global.reference_table()->n_deleted_entries());
 
         prunable = (left_hand_side <= right_hand_side);
 
@@ -520,7 +535,8 @@ class KdeSummary {
       double right_hand_side =
         global.reference_table()->get_node_count(rnode) *
         global.relative_error() * densities_l_ /
-        static_cast<double>(global.reference_table()->n_entries());
+        static_cast<double>(global.reference_table()->n_entries() -
+            global.reference_table()->n_deleted_entries());
 
       return left_hand_side <= right_hand_side;
     }
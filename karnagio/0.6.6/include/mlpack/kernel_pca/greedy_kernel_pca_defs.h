@@ -36,6 +36,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "fastlib/table/default/dense/unlabeled/kdtree/compact/table.h"
 #include "mlpack/kernel_pca/greedy_kernel_pca.h"
 #include "mlpack/kernel_pca/kernel_pca_private.h"
+#include "fastlib/workspace/arguments.h"
 
 namespace fl {
 namespace ml {
@@ -245,6 +246,7 @@ ConstructBoostVariableMap(
    "it needs a threshold to decide if the vector belongs to the dictionary"
   );
 
+  fl::ws::AddWorkSpaceOptions(&desc);
   boost::program_options::command_line_parser clp(args);
   clp.style(boost::program_options::command_line_style::default_style
      ^boost::program_options::command_line_style::allow_guessing );
@@ -50,7 +50,7 @@ namespace fl {
           typename DataAccessType::Branch_t
          > 
       >task(data, args);
-      data->schedule(task); 
+      data->schedule(task, args);
     }
 
   }
@@ -35,6 +35,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "fastlib/table/default/dense/unlabeled/kdtree/compact/table.h"
 #include "mlpack/kernel_pca/matrix_free_kernel_pca.h"
 #include "mlpack/kernel_pca/kernel_pca_private.h"
+#include "fastlib/workspace/arguments.h"
 
 namespace fl {
 namespace ml {
@@ -248,6 +249,7 @@ ConstructBoostVariableMap(
    "  warning: log only warnings\n"
    "  silent: no logging");
 
+  fl::ws::AddWorkSpaceOptions(&desc);
   boost::program_options::store(boost::program_options::
                                 command_line_parser(args).options(desc).run(),
                                 *vm);
@@ -89,6 +89,7 @@ int GaussSeidelLasso<boost::mpl::void_>::Main(
   );
   
 
+   fl::ws::AddWorkSpaceOptions(&desc);
    boost::program_options::variables_map vm;
    std::vector<std::string> args1=fl::ws::MakeArgsFromPrefix(args, "");
    boost::program_options::command_line_parser clp(args1);
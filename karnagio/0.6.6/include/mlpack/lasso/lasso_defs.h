@@ -49,7 +49,7 @@ void fl::ml::Lasso<boost::mpl::void_>::Run(
       typename DataAccessType::Branch_t
     >
   > task(data, args);
-  data->schedule(task); 
+  data->schedule(task, args);
 }
 
 #endif
@@ -152,6 +152,7 @@ namespace fl { namespace ml {
       "The factorization rank"
     );
 
+    fl::ws::AddWorkSpaceOptions(&desc);
     boost::program_options::variables_map vm;
     std::vector<std::string> args1=fl::ws::MakeArgsFromPrefix(args_, "");
     boost::program_options::command_line_parser clp(args1);
@@ -260,6 +260,7 @@ int fl::ml::Moe<boost::mpl::void_>::Main(
    );
 
   std::vector<std::string> args1=fl::ws::MakeArgsFromPrefix(args, "");
+  fl::ws::AddWorkSpaceOptions(&desc);
   boost::program_options::variables_map vm;
   boost::program_options::command_line_parser clp(args1);
   clp.style(boost::program_options::command_line_style::default_style
@@ -301,7 +302,7 @@ void fl::ml::Moe<boost::mpl::void_>::Run(
       typename WorkSpaceType::Branch_t
     > 
   > task(ws, args);
-  ws->schedule(task); 
+  ws->schedule(task, args);
 }
 
 #endif
@@ -258,6 +258,7 @@ POSSIBILITY OF SUCH DAMAGE.
       "this is the table to store the predicted values when using --run_mode=predict"  
     );
     
+    fl::ws::AddWorkSpaceOptions(&desc);
     boost::program_options::variables_map vm;
     std::vector<std::string> args1=fl::ws::MakeArgsFromPrefix(args_, "");
     boost::program_options::command_line_parser clp(args1);
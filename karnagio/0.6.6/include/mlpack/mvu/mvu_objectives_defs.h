@@ -37,6 +37,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "fastlib/optimization/augmented_lagrangian/lbfgs.h"
 #include "fastlib/optimization/augmented_lagrangian/optimization_utils.h"
 #include "fastlib/workspace/task.h"
+#include "fastlib/workspace/arguments.h"
 
 namespace fl {
 namespace ml {
@@ -345,6 +346,7 @@ int DimensionalityReduction<boost::mpl::void_>::Main(DataAccessType *data,
     "  warning: log only warnings\n"
     "  silent: no logging" );
 
+  fl::ws::AddWorkSpaceOptions(&desc);
   boost::program_options::variables_map vm;
   boost::program_options::command_line_parser clp(args);
   clp.style(boost::program_options::command_line_style::default_style
@@ -371,7 +373,7 @@ void DimensionalityReduction<boost::mpl::void_>::Run(
        typename DataAccessType::Branch_t
     > 
   > task(data, args);
-  data->schedule(task); 
+  data->schedule(task, args);
 }
 
 }}
@@ -34,6 +34,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "fastlib/table/table.h"
 #include "fastlib/tree/similarity_tree.h"
 #include "bpp_nnls_nmf.h"
+#include "fastlib/workspace/arguments.h"
 
 namespace fl {
 namespace ml {
@@ -69,6 +70,7 @@ int BppNnlsNmf<boost::mpl::void_>::Main(DataAccessType *data,
    "  warning: log only warnings\n"
    "  silent: no logging");
 
+  fl::ws::AddWorkSpaceOptions(&desc);
   boost::program_options::variables_map vm;
   boost::program_options::store(boost::program_options::
                                 command_line_parser(args).options(desc).run(), vm);
@@ -31,6 +31,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "boost/algorithm/string/classification.hpp"
 #include "boost/lexical_cast.hpp"
 #include "fastlib/workspace/task.h"
+#include "fastlib/workspace/arguments.h"
 
 namespace fl {
 namespace ml {
@@ -223,6 +224,7 @@ int Nmf::Main(DataAccessType *data,
    " --row=1,1,4,4 --col=2,55,33,55 . Notice that both lists must have the same size."
    " You can also specify a file name that has the indices, instead of a list.");
 
+  fl::ws::AddWorkSpaceOptions(&desc);
   boost::program_options::variables_map vm;
   boost::program_options::command_line_parser clp(args);
   clp.style(boost::program_options::command_line_style::default_style
@@ -269,7 +271,7 @@ void Nmf::Run(
       typename DataAccessType::Branch_t
     > 
   > task(data, args);
-  data->schedule(task); 
+  data->schedule(task, args);
 }
 
 }
@@ -27,6 +27,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #define FL_LITE_MLPACK_NMF_LBFGS_DEFS_H_
 #include "sparse_nmf.h"
 #include "fastlib/util/timer.h"
+#include "fastlib/workspace/arguments.h"
 namespace fl {
 namespace ml {
 
@@ -230,6 +231,7 @@ int SparseNmf<boost::mpl::void_>::Main(DataAccessType *data,
    "  warning: log only warnings\n"
    "  silent: no logging");
 
+  fl::ws::AddWorkSpaceOptions(&desc);
   boost::program_options::variables_map vm;
   boost::program_options::store(boost::program_options::
                                 command_line_parser(args).options(desc).run(), vm);
@@ -88,6 +88,9 @@ namespace fl {namespace ml {
             typedef NprResult< std::vector<double> > Result_t;
             typedef NprStatistic<double> Statistic_t;
             typedef KdeSummary<double> Summary_t;
+            // the expansions only sum the kernel, not the weighted
+            // sums of the regression
+            typedef KdeSeries<boost::mpl::void_> Series_t;
           };
 
           struct NprArgs {
@@ -34,6 +34,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "mlpack/kde/kde_dev.h"
 #include "mlpack/kde/dualtree_dfs_dev.h"
 #include "fastlib/workspace/task.h"
+#include "fastlib/workspace/arguments.h"
 
 namespace fl { namespace ml {
   template<typename TableType>
@@ -910,6 +911,7 @@ namespace fl { namespace ml {
       "eval (for predicting the value of a point)." 
       );
   
+    fl::ws::AddWorkSpaceOptions(&desc);
     boost::program_options::variables_map vm;
     boost::program_options::command_line_parser clp(args);
     clp.style(boost::program_options::command_line_style::default_style
@@ -951,7 +953,7 @@ namespace fl { namespace ml {
         typename WorkSpaceType::Branch_t
       > 
     > task(ws, args);
-   ws->schedule(task); 
+   ws->schedule(task, args);
 }
 
 }} // namespace fl ml
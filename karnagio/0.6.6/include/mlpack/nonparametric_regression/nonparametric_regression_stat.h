@@ -64,7 +64,15 @@ class NprPostponed : public KdePostponed<CalcPrecision_t> {
                            const MetricType &metric,
                            const PointType &query_point,
                            const PointType &reference_point) {
-      double distsq = metric.DistanceSq(query_point, reference_point);
+      ApplyContribution(global,
+                        metric.DistanceSq(query_point, reference_point),
+                        reference_point);
+    }
+
+    template<typename GlobalType, typename PointType>
+    void ApplyContribution(const GlobalType &global,
+                           double distsq,
+                           const PointType &reference_point) {
       double density_incoming = global.kernel().EvalUnnormOnSq(distsq);
       this->densities_l_ = ((CalcPrecision_t) this->densities_l_ + density_incoming);
       this->densities_u_ = ((CalcPrecision_t) this->densities_u_ + density_incoming);
@@ -514,6 +514,7 @@ namespace fl { namespace ml {
       boost::program_options::value<bool>()->default_value(false),
       "set this true if you want the maximum score of the w_matrix to be one"
     );
+    fl::ws::AddWorkSpaceOptions(&desc);
     boost::program_options::variables_map vm;
     boost::program_options::command_line_parser clp(args_);
     clp.style(boost::program_options::command_line_style::default_style
@@ -34,6 +34,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "fastlib/table/table.h"
 #include "ortho_range_search.h"
 #include "fastlib/workspace/task.h"
+#include "fastlib/workspace/arguments.h"
 
 namespace fl {
 namespace ml {
@@ -76,6 +77,7 @@ int OrthoRangeSearch<boost::mpl::void_>::Main(
    "  silent: no logging");
 
 
+  fl::ws::AddWorkSpaceOptions(&desc);
   boost::program_options::variables_map vm;
   boost::program_options::command_line_parser clp(args);
   clp.style(boost::program_options::command_line_style::default_style
@@ -156,7 +158,7 @@ void OrthoRangeSearch<boost::mpl::void_>::Run(
       typename DataAccessType::Branch_t
     > 
   > task(data, args);
-    data->schedule(task); 
+    data->schedule(task, args);
 }
 };
 };
@@ -32,6 +32,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "fastlib/workspace/task.h"
 #include "fastlib/workspace/arguments.h"
 #include "fastlib/table/linear_algebra.h"
+#include "fastlib/table/table_stream.h"
 #include "fastlib/workspace/based_on_table_run.h"
 #include "random_projections.h"
 #include "fastlib/table/linear_algebra.h"
@@ -117,6 +118,7 @@ namespace fl { namespace ml {
       "does not fit in memory so we have to chunk it,  if it is set to -1 then no chunking "
       "happens"  
     );
+    fl::ws::AddWorkSpaceOptions(&desc);
     boost::program_options::variables_map vm;
     std::vector<std::string> args1=fl::ws::MakeArgsFromPrefix(args_, "");
     boost::program_options::command_line_parser clp(args1);
@@ -205,19 +207,40 @@ namespace fl { namespace ml {
           fl::logger->Message()<<"using gaussian table from ("<<projection_matrix[0]<<")";
           ws_->Attach(projection_matrix[0], &projector_table);
         }
-        // projecting the input
+        // projecting the input, one block at a time so that references
+        // that do not fit in memory can be streamed
         for(size_t i=0; i<references.size(); ++i) {
-          boost::shared_ptr<TableType> references_table;
           fl::logger->Message()<<"Projecting ("<<references[i]<<") table";
-          ws_->Attach(references[i], &references_table);
+          index_t n_entries=0;
+          ws_->GetTableInfo(references[i], &n_entries, NULL, NULL, NULL);
           boost::shared_ptr<typename WorkSpaceType::MatrixTable_t> projected_table;
           ws_->Attach(projected_names[i],
               std::vector<index_t>(1, vm["projection_rank"].as<int32>()),
               std::vector<index_t>(),
-              references_table->n_entries(),
+              n_entries,
               &projected_table);
-          fl::table::Mul<fl::la::NoTrans, fl::la::Trans>(*references_table, 
-              *projector_table, projected_table.get());
+          boost::shared_ptr<fl::table::TableStream<TableType> > stream;
+          ws_->AttachStream(references[i], &stream);
+          boost::shared_ptr<TableType> block;
+          typename WorkSpaceType::MatrixTable_t::Point_t point1, point2;
+          index_t offset=0;
+          while (stream->NextBlock(&block)) {
+            typename WorkSpaceType::MatrixTable_t projected_block;
+            projected_block.Init(
+                std::vector<index_t>(1, vm["projection_rank"].as<int32>()),
+                std::vector<index_t>(),
+                block->n_entries());
+            fl::table::Mul<fl::la::NoTrans, fl::la::Trans>(*block, 
+                *projector_table, &projected_block);
+            for(index_t j=0; j<block->n_entries(); ++j) {
+              projected_block.get(j, &point1);
+              projected_table->get(offset+j, &point2);
+              point2.CopyValues(point1);
+            }
+            offset+=block->n_entries();
+          }
+          block.reset();
+          stream.reset();
           ws_->Purge(references[i]);
           ws_->Detach(references[i]);
           ws_->Purge(projected_names[i]);
@@ -32,6 +32,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "mlpack/regression/stepwise_regression_dev.h"
 #include "mlpack/regression/correlation_prune_dev.h"
 #include "fastlib/workspace/task.h"
+#include "fastlib/workspace/arguments.h"
 
 template<typename TableType1>
 template<typename Dataset_t>
@@ -1179,6 +1180,7 @@ bool fl::ml::LinearRegression<boost::mpl::void_>::ConstructBoostVariableMap(
     "flag appropriately."
    );
 
+  fl::ws::AddWorkSpaceOptions(&desc);
   boost::program_options::command_line_parser clp(args);
   clp.style(boost::program_options::command_line_style::default_style
             ^ boost::program_options::command_line_style::allow_guessing);
@@ -1257,7 +1259,7 @@ void fl::ml::LinearRegression<boost::mpl::void_>::Run(
     DataAccessType,
     &Main<DataAccessType, typename DataAccessType::Branch_t>
   > task(data, args);
-  data->schedule(task); 
+  data->schedule(task, args);
 }
 
 #endif
@@ -49,6 +49,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "fastlib/table/linear_algebra.h"
 #include "fastlib/util/timer.h"
 #include "mlpack/random_projections/random_projections_defs.h"
+#include "fastlib/workspace/arguments.h"
 
 
 template<typename WorkSpaceType>
@@ -138,6 +139,7 @@ void fl::ml::Svd<boost::mpl::void_>::Core<WorkSpaceType>::operator()(
    "The output file for the transposed right singular vectors (each row is a singular vector).");
 
 
+  fl::ws::AddWorkSpaceOptions(&desc);
   boost::program_options::variables_map vm;
   boost::program_options::command_line_parser clp(
       fl::ws::MakeArgsFromPrefix(args_, ""));
@@ -29,6 +29,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "fastlib/util/timer.h"
 #include "svm.h"
 #include "fastlib/workspace/task.h"
+#include "fastlib/workspace/arguments.h"
 
 namespace fl {
   namespace ml {
@@ -380,6 +381,7 @@ namespace fl {
         "OPTIONAL. the file to store the prediction accuracy"
         );
 
+      fl::ws::AddWorkSpaceOptions(&desc);
       boost::program_options::variables_map vm;
       boost::program_options::command_line_parser clp(args);
       clp.style(boost::program_options::command_line_style::default_style
@@ -417,7 +419,7 @@ namespace fl {
           typename DataAccessType::Branch_t
         > 
       > task(data, args);
-      data->schedule(task); 
+      data->schedule(task, args);
     }
 
   } // ml
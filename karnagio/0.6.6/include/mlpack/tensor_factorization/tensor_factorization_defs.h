@@ -863,6 +863,7 @@ namespace fl { namespace ml {
       boost::program_options::value<int32>()->default_value(10),
       "number of iterations to run the Lbfgs optimization"
     );
+    fl::ws::AddWorkSpaceOptions(&desc);
     boost::program_options::variables_map vm;
     std::vector<std::string> args1=fl::ws::MakeArgsFromPrefix(args_, "");
     boost::program_options::command_line_parser clp(args1);
@@ -0,0 +1,3 @@
+INCLUDE(FindThreads)
+list(APPEND GenCMake_LIBRARIES
+   ${CMAKE_THREAD_LIBS_INIT} ) 
@@ -0,0 +1,45 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <vector>
+#include <string>
+#include "mlpack/kde/kde_service_defs.h"
+#include "fastlib/workspace/workspace_defs.h"
+
+int main(int argc, char *argv[]) {
+  fl::logger->SetLogger("debug");
+  // Convert C input to C++; skip executable name for Boost
+  std::vector<std::string> args(argv + 1, argv + argc);
+  try {
+    // Use a generic workspace model
+    fl::ws::WorkSpace ws;
+    ws.set_schedule_mode(2);
+    ws.set_pool(1);
+    ws.LoadAllTables(args);
+    fl::ml::KdeService<boost::mpl::void_>::Main(&ws, args);
+    ws.ExportAllTables(args);
+  } catch (...) {
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,206 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include <string>
+#include "boost/program_options.hpp"
+#include "fastlib/base/base.h"
+#include "fastlib/base/logger.h"
+#include "fastlib/base/constant_strings.h"
+#include "fastlib/math/fl_math.h"
+#include "fastlib/util/timer.h"
+#include "fastlib/dense/simd_kernels.h"
+
+/**
+ * @brief Times the squared euclidean distance of every point to every
+ *        other point, first with the plain loop the metrics used to
+ *        run and then with the kernels of every instruction set the
+ *        cpu supports, one pair at a time and a block of references
+ *        at a time
+ */
+template<typename T>
+class MetricBench {
+  public:
+    MetricBench(index_t dimensions, index_t points, int repetitions) :
+      dimensions_(dimensions), points_(points), repetitions_(repetitions) {
+      data_.resize(dimensions_ * points_);
+      for (size_t i = 0; i < data_.size(); ++i) {
+        data_[i] = fl::math::Random(-1.0, 1.0);
+      }
+      for (index_t i = 0; i < points_; ++i) {
+        pointers_.push_back(&data_[i * dimensions_]);
+      }
+    }
+
+    void Run(const std::string &precision) {
+      fl::logger->Message() << "Benchmarking " << precision << " points of "
+        << dimensions_ << " dimensions";
+      double checksum = 0;
+      double loop_time = Time_(&MetricBench::Loop_, &checksum);
+      fl::logger->Message() << "loop: " << loop_time << " sec";
+      const char *instruction_sets[] = {"scalar", "sse2", "avx2", "avx512"};
+      std::string best = fl::dense::simd::instruction_set();
+      for (int s = 0; s < 4; ++s) {
+        if (fl::dense::simd::set_instruction_set(instruction_sets[s])
+            == false) {
+          continue;
+        }
+        double pair_checksum = 0;
+        double pair_time = Time_(&MetricBench::Pair_, &pair_checksum);
+        double block_checksum = 0;
+        double block_time = Time_(&MetricBench::Block_, &block_checksum);
+        if (pair_checksum != block_checksum) {
+          fl::logger->Die() << instruction_sets[s] 
+            << ": the block kernel does not match the pair kernel";
+        }
+        fl::logger->Message() << instruction_sets[s] << " pair: " 
+          << pair_time << " sec (x" << loop_time / pair_time << "), block: "
+          << block_time << " sec (x" << loop_time / block_time 
+          << "), relative difference from the loop: "
+          << fabs(block_checksum - checksum) / checksum;
+      }
+      fl::dense::simd::set_instruction_set(best);
+    }
+
+  private:
+    double Time_(void (MetricBench::*method)(double *), double *checksum) {
+      fl::util::Timer timer;
+      timer.Start();
+      for (int r = 0; r < repetitions_; ++r) {
+        *checksum = 0;
+        (this->*method)(checksum);
+      }
+      timer.End();
+      return timer.GetTotalElapsedTime();
+    }
+
+    void Loop_(double *checksum) {
+      for (index_t i = 0; i < points_; ++i) {
+        for (index_t j = 0; j < points_; ++j) {
+          const T *x = pointers_[i];
+          const T *y = pointers_[j];
+          T s = 0;
+          for (index_t k = 0; k < dimensions_; ++k) {
+            T d = x[k] - y[k];
+            s += d * d;
+          }
+          *checksum += s;
+        }
+      }
+    }
+
+    void Pair_(double *checksum) {
+      for (index_t i = 0; i < points_; ++i) {
+        for (index_t j = 0; j < points_; ++j) {
+          *checksum += fl::dense::simd::DistanceSq(dimensions_, 
+                       pointers_[i], pointers_[j]);
+        }
+      }
+    }
+
+    void Block_(double *checksum) {
+      T distances[fl::dense::simd::kBlockSize];
+      for (index_t i = 0; i < points_; ++i) {
+        for (index_t j = 0; j < points_; j += fl::dense::simd::kBlockSize) {
+          index_t count = std::min(points_ - j, fl::dense::simd::kBlockSize);
+          fl::dense::simd::DistanceSqBlock(dimensions_, pointers_[i],
+              &pointers_[j], count, distances);
+          for (index_t k = 0; k < count; ++k) {
+            *checksum += distances[k];
+          }
+        }
+      }
+    }
+
+    index_t dimensions_;
+    index_t points_;
+    int repetitions_;
+    std::vector<T> data_;
+    std::vector<const T*> pointers_;
+};
+
+int main(int argc, char *argv[]) {
+  fl::logger->SetLogger("debug");
+  boost::program_options::options_description desc("Available options");
+  desc.add_options()(
+    "help", "Print this information."
+  )(
+    "dimensions",
+    boost::program_options::value<index_t>()->default_value(32),
+    "the number of dimensions of the points"
+  )(
+    "points",
+    boost::program_options::value<index_t>()->default_value(2048),
+    "the number of points, the distances of all pairs are computed"
+  )(
+    "repetitions",
+    boost::program_options::value<int>()->default_value(5),
+    "how many times every kernel is timed"
+  )(
+    "precision",
+    boost::program_options::value<std::string>()->default_value("double"),
+    "double or float"
+  );
+
+  boost::program_options::variables_map vm;
+  try {
+    boost::program_options::store(
+      boost::program_options::parse_command_line(argc, argv, desc), vm);
+  }
+  catch (const boost::program_options::error &e) {
+    fl::logger->Die() << e.what();
+  }
+  boost::program_options::notify(vm);
+  if (vm.count("help")) {
+    std::cout << fl::DISCLAIMER << "\n";
+    std::cout << desc << "\n";
+    return EXIT_SUCCESS;
+  }
+  fl::logger->Message() << "The kernels use " 
+    << fl::dense::simd::instruction_set();
+  index_t dimensions = vm["dimensions"].as<index_t>();
+  index_t points = vm["points"].as<index_t>();
+  int repetitions = vm["repetitions"].as<int>();
+  std::string precision = vm["precision"].as<std::string>();
+  if (dimensions <= 0 || points <= 0 || repetitions <= 0) {
+    fl::logger->Die() << "--dimensions, --points and --repetitions "
+      "must be positive";
+  }
+  if (precision == "double") {
+    MetricBench<double> bench(dimensions, points, repetitions);
+    bench.Run(precision);
+  }
+  else if (precision == "float") {
+    MetricBench<float> bench(dimensions, points, repetitions);
+    bench.Run(precision);
+  }
+  else {
+    fl::logger->Die() << "--precision=" << precision 
+      << " is not supported, use double or float";
+  }
+  return EXIT_SUCCESS;
+}
@@ -28,6 +28,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "fastlib/data/multi_dataset.h"
 #include "multi_dataset_reset.h"
 #include <sstream>
+#include "boost/bind.hpp"
+#include "boost/iostreams/device/mapped_file.hpp"
 
 namespace fl { namespace data {
 
@@ -355,6 +357,36 @@ namespace fl { namespace data {
   }
 
 
+  template<typename ParameterList>
+  template<typename BoxType>
+  MultiDataset<ParameterList>::PopBackOperator<BoxType>::
+      PopBackOperator(BoxType *box) {
+    box_ = box;
+  }
+
+  template<typename ParameterList>
+  template<typename BoxType>
+  template<typename T>
+  void MultiDataset<ParameterList>::PopBackOperator<BoxType>::operator()(T) {
+    PopBack(&(box_->template get<T>()));
+  }
+
+  template<typename ParameterList>
+  template<typename BoxType>
+  template<typename T>
+  void MultiDataset<ParameterList>::PopBackOperator<BoxType>::PopBack(
+      CompactContainer<T> *matrix) {
+    matrix->resize(matrix->n_rows(), matrix->n_cols() - 1);
+  }
+
+  template<typename ParameterList>
+  template<typename BoxType>
+  template<typename ContainerType>
+  void MultiDataset<ParameterList>::PopBackOperator<BoxType>::PopBack(
+      ContainerType *container) {
+    container->resize(container->size() - 1);
+  }
+
   template<typename ParameterList>
   template<typename MetaDataBoxType, typename PointType>
   void MultiDataset<ParameterList>::SetMetaDataOperator1::type::
@@ -434,6 +466,22 @@ namespace fl { namespace data {
     num_of_points_++;
   }
   
+  template<typename ParameterList>
+  void MultiDataset<ParameterList>::pop_back() {
+    if (num_of_points_ <= 0) {
+      fl::logger->Die() << "You are trying to remove a point from an empty "
+        << "dataset";
+    }
+    boost::mpl::for_each<DenseTypeList_t>(
+      PopBackOperator<DenseBox>(&dense_));
+    boost::mpl::for_each<SparseTypeList_t>(
+      PopBackOperator<SparseBox>(&sparse_));
+    if (IsMixed_t::value && !meta_.empty()) {
+      meta_.pop_back();
+    }
+    num_of_points_--;
+  }
+
   template<typename ParameterList>
   void MultiDataset<ParameterList>::push_back(
     std::string &point) {
@@ -511,93 +559,201 @@ namespace fl { namespace data {
     ignored_dense_columns_ = ignored_dense_columns;
     load_meta_ = false;
     if (mode == "r") {
-      num_of_points_ = 0;
-      // we need this variable in case the file is just a dense csv
-      index_t single_dense_csv_dimension = -1;
-      num_of_points_ = 0;
-      index_t lines_to_skip = 0;
-      std::ifstream fin(filename.c_str(), std::ios_base::in);
-      if (fin.fail()) {
-        fl::logger->Die() << "Could not open file " << filename.c_str()
-        << "   error: " << strerror(errno);
-    
+      if (IsBinaryTableFile(filename)) {
+        if (ignored_dense_columns_.size() != 0) {
+          fl::logger->Die() << "Ignoring columns is not supported for binary "
+            << "table files (" << filename << ")";
+        }
+        InitBinary(filename);
+        return;
+      }
+      index_t lines_to_skip = ReadTextLayout(filename);
+      // if the file contains only sparse and not metadata then a blank line
+      // means all zero point, otherwise it marks the end of the data
+      const bool stop_at_blank = HasDense_t::value == true  || load_meta_ == true;
+      if (ignored_dense_columns_.size() == 0) {
+        // The file is mapped in memory and split in newline aligned chunks.
+        // Every chunk is counted and later parsed by its own thread, 
+        // so the file is read only once 
+        boost::iostreams::mapped_file_source mapped_file;
+        try {
+          mapped_file.open(filename);
+        }
+        catch(const std::exception &e) {
+          fl::logger->Die() << "Could not map file " << filename
+            << " in memory, error: " << e.what();
+        }
+        const char *data_begin = mapped_file.data();
+        const char *data_end = data_begin + mapped_file.size();
+        for (index_t i = 0; i < lines_to_skip && data_begin < data_end; i++) {
+          const char *eol = static_cast<const char*>(
+              memchr(data_begin, '\n', data_end - data_begin));
+          data_begin = (eol == NULL) ? data_end : eol + 1;
+        }
+        LoadTextRange(data_begin, data_end, stop_at_blank, filename);
+        return;
       }
       std::string line;
-      std::getline(fin, line);
-      if (fin.fail()) {
-        fl::logger->Die() << "Something went wrong while reading";
+      std::ifstream fin(filename.c_str(), std::ios_base::in);
+      for (index_t i = 0; i < lines_to_skip; i++) {
+        std::getline(fin, line);
       }
-      if (!fin.eof()) {
-        // find out if it has header information
-        boost::algorithm::trim_if(line,  boost::algorithm::is_any_of(" ,\t\r\n"));
-        if (line.find("header") != std::string::npos) {
-          lines_to_skip++;
-          try {
-            ParseHeader(line);
-          }
-          catch(const fl::TypeException &e) {
-            fl::logger->Die() << e.what();
-          }
-          if (std::getline(fin, line).good()) {
-            boost::algorithm::trim_if(line,  boost::algorithm::is_any_of(" ,\t\r\n"));
-            // find out if it has labels
-            if (line.find("attribute_names") != std::string::npos
-                || line.find("labels") != std::string::npos) {
-              lines_to_skip++;
-              ParseLabels(line);
-              if (std::getline(fin, line).good()) {
-                boost::algorithm::trim_if(line,  boost::algorithm::is_any_of(" ,\t\r\n"));
-                FindDelimeter(line);
-                num_of_points_++;
-              }
-              else {
-                fl::logger->Die() << "Something went wrong while reading ("
-                  <<filename<<") or it might be empty";
-              }
-            }
-            else {
-              num_of_points_ = 1;
-              FindDelimeter(line);
-            }
-          }
-          else {
-            fl::logger->Die() << "Something went wrong while reading ("
-              <<filename<<") or it might be empty";
-          }
+      // find out the number of points;
+      num_of_points_ = 0;
+      while (fin.good()) {
+        std::getline(fin, line);
+        if ((line.size() == 0) && stop_at_blank == true) {
+          break;
         }
-        else {
+        num_of_points_++;
+      }
+      if (stop_at_blank == false) {
+        --num_of_points_;
+      }
+  
+      // now go back in the begining of the file
+      fin.close();
+      fin.open(filename.c_str(), std::ios_base::in);
+      fin.clear();
+      for (index_t i = 0; i < lines_to_skip; i++) {
+        std::getline(fin, line);
+      }
+      AllocatePoints(filename);
+      for (index_t i = 0; i < num_of_points_; ++i) {
+        std::getline(fin, line);
+        AddPoint(line, ignored_dense_columns_);
+      }
+      boost::mpl::for_each<SparseTypeList_t>(
+        ShrinkSparseArenas<SparseBox>(&sparse_));
+      return;
+    }
+    fl::logger->Die() << "This option " << mode.c_str() << "is not supported";
+  }  
+
+  template<typename ParameterList>
+  void MultiDataset<ParameterList>::InitLayout(const std::string &filename,
+      index_t *lines_to_skip) {
+    FL_SCOPED_LOG(MultiDataset); 
+    num_of_metadata_ = MetaDataType_t::size;
+    ignored_dense_columns_.clear();
+    load_meta_ = false;
+    *lines_to_skip = ReadTextLayout(filename);
+    num_of_points_ = 0;
+    AllocatePoints(filename);
+  }
+
+  template<typename ParameterList>
+  bool MultiDataset<ParameterList>::InitFromText(const MultiDataset &layout,
+      const char *begin, const char *end) {
+    FL_SCOPED_LOG(MultiDataset); 
+    num_of_metadata_ = layout.num_of_metadata_;
+    load_meta_ = layout.load_meta_;
+    labels_ = layout.labels_;
+    dense_sizes_ = layout.dense_sizes_;
+    sparse_sizes_ = layout.sparse_sizes_;
+    ignored_dense_columns_.clear();
+    is_2_tokens_ = layout.is_2_tokens_;
+    comma_flag_ = layout.comma_flag_;
+    delimiter_ = layout.delimiter_;
+    header_ = layout.header_;
+    const bool stop_at_blank = HasDense_t::value == true  || load_meta_ == true;
+    return LoadTextRange(begin, end, stop_at_blank, "text block");
+  }
+
+  template<typename ParameterList>
+  bool MultiDataset<ParameterList>::CountText(const char *begin,
+      const char *end, index_t *n_points) {
+    const bool stop_at_blank = HasDense_t::value == true  || load_meta_ == true;
+    std::vector<LoaderChunk> chunks;
+    MakeLoaderChunks(begin, end, &chunks);
+    *n_points = 0;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      CountLoaderChunk(&chunks[i], stop_at_blank);
+      *n_points += chunks[i].n_points;
+      if (chunks[i].stopped == true) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  template<typename ParameterList>
+  index_t MultiDataset<ParameterList>::ReadTextLayout(
+      const std::string &filename) {
+    num_of_points_ = 0;
+    // we need this variable in case the file is just a dense csv
+    index_t single_dense_csv_dimension = -1;
+    index_t lines_to_skip = 0;
+    std::ifstream fin(filename.c_str(), std::ios_base::in);
+    if (fin.fail()) {
+      fl::logger->Die() << "Could not open file " << filename.c_str()
+      << "   error: " << strerror(errno);
+  
+    }
+    std::string line;
+    std::getline(fin, line);
+    if (fin.fail()) {
+      fl::logger->Die() << "Something went wrong while reading";
+    }
+    if (!fin.eof()) {
+      // find out if it has header information
+      boost::algorithm::trim_if(line,  boost::algorithm::is_any_of(" ,\t\r\n"));
+      if (line.find("header") != std::string::npos) {
+        lines_to_skip++;
+        try {
+          ParseHeader(line);
+        }
+        catch(const fl::TypeException &e) {
+          fl::logger->Die() << e.what();
+        }
+        if (std::getline(fin, line).good()) {
+          boost::algorithm::trim_if(line,  boost::algorithm::is_any_of(" ,\t\r\n"));
+          // find out if it has labels
           if (line.find("attribute_names") != std::string::npos
               || line.find("labels") != std::string::npos) {
             lines_to_skip++;
             ParseLabels(line);
             if (std::getline(fin, line).good()) {
               boost::algorithm::trim_if(line,  boost::algorithm::is_any_of(" ,\t\r\n"));
-              num_of_points_ = 1;
               FindDelimeter(line);
+              num_of_points_++;
             }
             else {
               fl::logger->Die() << "Something went wrong while reading ("
-                <<filename<<")";
+                <<filename<<") or it might be empty";
             }
           }
           else {
             num_of_points_ = 1;
             FindDelimeter(line);
           }
-          // if no header has been provided then the file can only be
-          // dense csv file, so we need to determine the dimension of the points
-          std::vector<std::string> temporary_tokens;
-          boost::algorithm::trim_if(line,  boost::algorithm::is_any_of(" ,\t\r\n"));
-          boost::algorithm::split(temporary_tokens, line, boost::algorithm::is_any_of(" ,\t"));
-          single_dense_csv_dimension = static_cast<index_t>(temporary_tokens.size());
-          if (HasMetaData_t::value == true && load_meta_ == true) {
-            single_dense_csv_dimension -= MetaDataType_t::size;
+        }
+        else {
+          fl::logger->Die() << "Something went wrong while reading ("
+            <<filename<<") or it might be empty";
+        }
+      }
+      else {
+        if (line.find("attribute_names") != std::string::npos
+            || line.find("labels") != std::string::npos) {
+          lines_to_skip++;
+          ParseLabels(line);
+          if (std::getline(fin, line).good()) {
+            boost::algorithm::trim_if(line,  boost::algorithm::is_any_of(" ,\t\r\n"));
+            num_of_points_ = 1;
+            FindDelimeter(line);
+          }
+          else {
+            fl::logger->Die() << "Something went wrong while reading ("
+              <<filename<<")";
           }
-  
         }
-      } else {
-        num_of_points_=1;
-        FindDelimeter(line);
+        else {
+          num_of_points_ = 1;
+          FindDelimeter(line);
+        }
+        // if no header has been provided then the file can only be
+        // dense csv file, so we need to determine the dimension of the points
         std::vector<std::string> temporary_tokens;
         boost::algorithm::trim_if(line,  boost::algorithm::is_any_of(" ,\t\r\n"));
         boost::algorithm::split(temporary_tokens, line, boost::algorithm::is_any_of(" ,\t"));
@@ -605,91 +761,136 @@ namespace fl { namespace data {
         if (HasMetaData_t::value == true && load_meta_ == true) {
           single_dense_csv_dimension -= MetaDataType_t::size;
         }
+
       }
-        
-      // find out the number of points;
-      while (fin.good()) {
-        std::getline(fin, line);
-        // if the file contains only sparse and not metadata then a blank line
-        // means all zero point
-        if ((line.size() == 0) && (HasDense_t::value == true  || load_meta_ == true)) {
-          break;
-        }
-        num_of_points_++;
-      }
-      if (!(HasDense_t::value == true  || load_meta_ == true)) {
-        --num_of_points_;
-      }
-  
-      // now go back in the begining of the file
-      fin.close();
-      fin.open(filename.c_str(), std::ios_base::in);
-      fin.clear();
-      for (index_t i = 0; i < lines_to_skip; i++) {
-        std::getline(fin, line);
+    } else {
+      num_of_points_=1;
+      FindDelimeter(line);
+      std::vector<std::string> temporary_tokens;
+      boost::algorithm::trim_if(line,  boost::algorithm::is_any_of(" ,\t\r\n"));
+      boost::algorithm::split(temporary_tokens, line, boost::algorithm::is_any_of(" ,\t"));
+      single_dense_csv_dimension = static_cast<index_t>(temporary_tokens.size());
+      if (HasMetaData_t::value == true && load_meta_ == true) {
+        single_dense_csv_dimension -= MetaDataType_t::size;
       }
-  
-      // Allocate the space for the containers
-      // and start reading
-      index_t count = 0;
-      // this is an indication that the file is dense csv, it didn't have a header
-      // maybe it had labels. In any event we have determined the dimension of the points
-      // and we have to pass it in the vector with the dimensions
-      if (single_dense_csv_dimension > 0) {
-        dense_sizes_.push_back(single_dense_csv_dimension);
+    }
+    // this is an indication that the file is dense csv, it didn't have a header
+    // maybe it had labels. In any event we have determined the dimension of the points
+    // and we have to pass it in the vector with the dimensions
+    if (single_dense_csv_dimension > 0) {
+      dense_sizes_.push_back(single_dense_csv_dimension);
+    }
+    index_t cumsum = 0;
+    for (size_t i = 0; i < dense_sizes_.size(); i++) {
+      cumsum += dense_sizes_[i];
+      size_t j = 0;
+      while (j < ignored_dense_columns_.size() &&  ignored_dense_columns_[j] < cumsum) {
+        dense_sizes_[i] -= 1;
+        j++;
       }
-      index_t cumsum = 0;
-      for (size_t i = 0; i < dense_sizes_.size(); i++) {
-        cumsum += dense_sizes_[i];
-        size_t j = 0;
-        while (j < ignored_dense_columns_.size() &&  ignored_dense_columns_[j] < cumsum) {
-          dense_sizes_[i] -= 1;
-          j++;
-        }
+    }
+    return lines_to_skip;
+  }
+
+  template<typename ParameterList>
+  void MultiDataset<ParameterList>::AllocatePoints(
+      const std::string &filename) {
+    index_t count = 0;
+    // Allocate containers for meta_data
+    if (HasMetaData_t::value == true) {
+      try {
+        meta_.resize(num_of_points_);
+      } 
+      catch(const std::bad_alloc &) {
+        fl::logger->Die() << "Problems in allocating memory for table ("<<filename<<"), the "
+          << "dataset is probably too big too fit in RAM."
+          << "It might be that your dataset is too big to fit in RAM or "
+          << "you are using a 32bit platform which limits the process address space "
+          << "to 4GB. Datasets that do not fit in RAM can be read in blocks "
+          << "with fl::table::TableStream";
+
       }
-      // Allocate containers for meta_data
-      if (HasMetaData_t::value == true) {
-        try {
-          meta_.resize(num_of_points_);
-        } 
-        catch(const std::bad_alloc &) {
-          fl::logger->Die() << "Problems in allocating memory for table ("<<filename<<"), the "
-            << "dataset is probably too big too fit in RAM."
-            << "It might be that your dataset is too big to fit in RAM or "
-            << "you are using a 32bit platform which limits the process address space "
-            << "to 4GB";
+      meta_it_ = meta_.begin();
+    }
+    boost::mpl::for_each<DenseTypeList_t>(Initializer<DenseBox, DenseIterators>(&dense_,
+                                          &dense_its_, &dense_sizes_, &count, num_of_points_));
+    count = 0;
+    boost::mpl::for_each<SparseTypeList_t>(Initializer<SparseBox, SparseIterators>(&sparse_,
+                                           &sparse_its_, &sparse_sizes_, &count, num_of_points_));
+    n_attributes_ = 0;
+    for (index_t i = 0; i < static_cast<index_t>(dense_sizes_.size()); i++) {
+      n_attributes_ += dense_sizes_[i];
+    }
+    for (index_t i = 0; i < static_cast<index_t>(sparse_sizes_.size()); i++) {
+      n_attributes_ += sparse_sizes_[i];
+    }
+  }
 
-        }
-        meta_it_ = meta_.begin();
+  template<typename ParameterList>
+  bool MultiDataset<ParameterList>::LoadTextRange(const char *begin,
+      const char *end,
+      bool stop_at_blank,
+      const std::string &filename) {
+    std::vector<LoaderChunk> chunks;
+    MakeLoaderChunks(begin, end, &chunks);
+    if (chunks.size() == 1) {
+      CountLoaderChunk(&chunks[0], stop_at_blank);
+    } else {
+      boost::thread_group counters;
+      for (size_t i = 0; i < chunks.size(); ++i) {
+        counters.create_thread(boost::bind(
+            &MultiDataset<ParameterList>::CountLoaderChunk, 
+            this, &chunks[i], stop_at_blank));
       }
-      boost::mpl::for_each<DenseTypeList_t>(Initializer<DenseBox, DenseIterators>(&dense_,
-                                            &dense_its_, &dense_sizes_, &count, num_of_points_));
-      count = 0;
-      boost::mpl::for_each<SparseTypeList_t>(Initializer<SparseBox, SparseIterators>(&sparse_,
-                                             &sparse_its_, &sparse_sizes_, &count, num_of_points_));
-      n_attributes_ = 0;
-      for (index_t i = 0; i < static_cast<index_t>(dense_sizes_.size()); i++) {
-        n_attributes_ += dense_sizes_[i];
+      counters.join_all();
+    }
+    bool stopped = false;
+    num_of_points_ = 0;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      chunks[i].first_point = num_of_points_;
+      num_of_points_ += chunks[i].n_points;
+      if (chunks[i].stopped == true) {
+        stopped = true;
+        chunks.resize(i+1);
+        break;
       }
-      for (index_t i = 0; i < static_cast<index_t>(sparse_sizes_.size()); i++) {
-        n_attributes_ += sparse_sizes_[i];
+    }
+    AllocatePoints(filename);
+    // compact sparse points of every chunk are appended to
+    // an arena of the chunk
+    for (size_t i = 1; i < chunks.size(); ++i) {
+      boost::mpl::for_each<SparseTypeList_t>(
+        SplitSparseArena<SparseBox>(&sparse_, 
+          chunks[i].first_point, chunks[i].n_points));
+    }
+    if (chunks.size() == 1) {
+      ParseLoaderChunk(&chunks[0]);
+    } else {
+      boost::thread_group parsers;
+      for (size_t i = 0; i < chunks.size(); ++i) {
+        parsers.create_thread(boost::bind(
+            &MultiDataset<ParameterList>::ParseLoaderChunk, 
+            this, &chunks[i]));
       }
-      if (ignored_dense_columns_.size()!=0) {
-        for (index_t i = 0; i < num_of_points_; ++i) {
-          std::getline(fin, line);
-          AddPoint(line, ignored_dense_columns_);
-        }
-      } else {
-         for (index_t i = 0; i < num_of_points_; ++i) {
-          std::getline(fin, line);
-          AddPointFast(line);
-        }
-     
+      parsers.join_all();
+    }
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      if (chunks[i].error) {
+        boost::rethrow_exception(chunks[i].error);
       }
-      return;
     }
-    fl::logger->Die() << "This option " << mode.c_str() << "is not supported";
-  }  
+    // leave the iterators where the serial loader would have left them
+    if (load_meta_ == true) {
+      std::advance(meta_it_, num_of_points_);
+    }
+    boost::mpl::for_each<DenseTypeList_t>(
+      OffsetIterators<DenseBox, DenseIterators>(&dense_, &dense_its_, num_of_points_));
+    boost::mpl::for_each<SparseTypeList_t>(
+      OffsetIterators<SparseBox, SparseIterators>(&sparse_, &sparse_its_, num_of_points_));
+    boost::mpl::for_each<SparseTypeList_t>(
+      ShrinkSparseArenas<SparseBox>(&sparse_));
+    return stopped;
+  }
   
   
   template<typename ParameterList>
@@ -812,6 +1013,24 @@ namespace fl { namespace data {
   
   template<typename ParameterList>
   bool MultiDataset<ParameterList>::TryToInit(const std::string &filename) {
+    if (IsBinaryTableFile(filename)) {
+      BinaryTableFooter footer;
+      ReadBinaryTableFooter(filename, &footer);
+      std::string meta_types;
+      boost::mpl::for_each<boost::mpl::range_c<int, 0, MetaDataType_t::size> >(
+        MetaTypeNames(&meta_types));
+      if (footer.meta_types != meta_types) {
+        std::ostringstream s1;
+        s1 << "[DATA TYPE ERROR] The metadata types in the file are ("
+          << footer.meta_types << ") while this class is designed for ("
+          << meta_types << ")";
+        throw fl::TypeException(s1.str());
+      }
+      ParseHeader(footer.header);
+      dense_sizes_.clear();
+      sparse_sizes_.clear();
+      return true;
+    }
         std::ifstream fin(filename.c_str(), std::ios_base::in);
     if (fin.fail()) {
       fl::logger->Die() << "Could not open file " << filename.c_str()
@@ -1118,23 +1337,197 @@ namespace fl { namespace data {
 
   template<typename ParameterList>
   void MultiDataset<ParameterList>::AddPointFast(std::string &line) {
-    char *tok=strtok(const_cast<char*>(line.c_str()), delimiter_.c_str()); 
+    AddPointFast(const_cast<char*>(line.c_str()), 
+        &dense_its_, &sparse_its_, &meta_it_);
+  }
+
+  template<typename ParameterList>
+  void MultiDataset<ParameterList>::AddPointFast(char *line,
+      DenseIterators *dense_its,
+      SparseIterators *sparse_its,
+      MetaDataIterator *meta_it) {
+    // strtok_r keeps its state in save_ptr, so that many threads
+    // can tokenize their lines at the same time 
+    char *save_ptr=NULL;
+    char *tok=strtok_r(line, delimiter_.c_str(), &save_ptr); 
     // loading meta data
     if (load_meta_ == true) {
       boost::mpl::for_each<boost::mpl::range_c<int, 0, MetaDataType_t::size> >(
-        MetaLoaderFast(meta_it_, delimiter_, num_of_metadata_, &tok));
-	  ++meta_it_;
+        MetaLoaderFast(*meta_it, delimiter_, num_of_metadata_, &tok, &save_ptr));
+	  ++(*meta_it);
     }
     
     // the elements are in the file in an increasing order,
     // we need to offset them so that all containers are 0 based
     index_t offset = 0;
     boost::mpl::for_each<DenseTypeList_t>(
-      DensePointLoaderFast(&dense_its_, delimiter_, &tok, &offset));
+      DensePointLoaderFast(dense_its, delimiter_, &tok, &save_ptr, &offset));
     boost::mpl::for_each<SparseTypeList_t>(
-      SparsePointLoaderFast(&sparse_its_, delimiter_, &tok, &offset));
+      SparsePointLoaderFast(sparse_its, delimiter_, &tok, &save_ptr, &offset));
   
   }
 
+  template<typename ParameterList>
+  void MultiDataset<ParameterList>::MakeLoaderChunks(const char *begin, 
+      const char *end,
+      std::vector<LoaderChunk> *chunks) {
+    // chunks smaller than that are not worth a thread
+    const ptrdiff_t kMinChunkSize=1<<16;
+    ptrdiff_t step=std::max(kMinChunkSize, 
+        static_cast<ptrdiff_t>((end-begin)/n_threads_+1));
+    const char *chunk_begin=begin;
+    do {
+      LoaderChunk chunk;
+      chunk.begin=chunk_begin;
+      if (end-chunk_begin<=step) {
+        chunk.end=end;
+      } else {
+        // make sure the chunk ends right after a newline
+        const char *eol=static_cast<const char*>(
+            memchr(chunk_begin+step-1, '\n', end-(chunk_begin+step-1)));
+        chunk.end=(eol==NULL) ? end : eol+1;
+      }
+      chunks->push_back(chunk);
+      chunk_begin=chunk.end;
+    } while (chunk_begin<end);
+  }
+
+  template<typename ParameterList>
+  void MultiDataset<ParameterList>::CountLoaderChunk(LoaderChunk *chunk, 
+      bool stop_at_blank) {
+    const char *line=chunk->begin;
+    while (line<chunk->end) {
+      const char *eol=static_cast<const char*>(
+          memchr(line, '\n', chunk->end-line));
+      if (eol==NULL) {
+        eol=chunk->end;
+      }
+      if (eol==line && stop_at_blank==true) {
+        chunk->stopped=true;
+        chunk->end=line;
+        break;
+      }
+      chunk->n_points++;
+      line=eol+1;
+    }
+  }
+
+  template<typename ParameterList>
+  void MultiDataset<ParameterList>::ParseLoaderChunk(LoaderChunk *chunk) {
+    try {
+      DenseIterators dense_its;
+      SparseIterators sparse_its;
+      MetaDataIterator meta_it=meta_.begin();
+      std::advance(meta_it, chunk->first_point);
+      boost::mpl::for_each<DenseTypeList_t>(
+        OffsetIterators<DenseBox, DenseIterators>(&dense_, &dense_its, chunk->first_point));
+      boost::mpl::for_each<SparseTypeList_t>(
+        OffsetIterators<SparseBox, SparseIterators>(&sparse_, &sparse_its, chunk->first_point));
+      std::vector<char> buffer;
+      const char *line=chunk->begin;
+      for (index_t i=0; i<chunk->n_points; ++i) {
+        const char *eol=static_cast<const char*>(
+            memchr(line, '\n', chunk->end-line));
+        if (eol==NULL) {
+          eol=chunk->end;
+        }
+        buffer.assign(line, eol);
+        buffer.push_back('\0');
+        AddPointFast(&buffer[0], &dense_its, &sparse_its, &meta_it);
+        line=eol+1;
+      }
+    }
+    catch(...) {
+      chunk->error=boost::current_exception();
+    }
+  }
+
+  template<typename ParameterList>
+  void MultiDataset<ParameterList>::SaveBinary(std::ostream &out, 
+      BinaryTableFooter *footer) {
+    // the header is written exactly as in the text files, so that the 
+    // types are checked by ParseHeader when the file is loaded
+    bool comma_flag = comma_flag_;
+    comma_flag_ = true;
+    std::ostringstream header;
+    WriteHeader(header);
+    comma_flag_ = comma_flag;
+    footer->header = header.str();
+    boost::algorithm::trim_if(footer->header,  
+        boost::algorithm::is_any_of(" ,\t\r\n"));
+    footer->dataset_header = header_;
+    boost::mpl::for_each<boost::mpl::range_c<int, 0, MetaDataType_t::size> >(
+      MetaTypeNames(&footer->meta_types));
+    footer->labels = labels_;
+    footer->num_of_points = num_of_points_;
+    footer->num_of_metadata = num_of_metadata_;
+    footer->n_attributes = n_attributes_;
+    footer->load_meta = load_meta_;
+    footer->dense_sizes = dense_sizes_;
+    footer->sparse_sizes = sparse_sizes_;
+    boost::mpl::for_each<DenseTypeList_t>(
+      BinaryDenseWriter(&dense_, &out, footer));
+    boost::mpl::for_each<SparseTypeList_t>(
+      BinarySparseWriter(&sparse_, &out, footer));
+    if (HasMetaData_t::value == true) {
+      boost::mpl::for_each<boost::mpl::range_c<int, 0, MetaDataType_t::size> >(
+        BinaryMetaWriter(&meta_, &out, footer));
+    }
+    if (out.fail()) {
+      fl::logger->Die() << "Something went wrong while writing the binary table";
+    }
+  }
+
+  template<typename ParameterList>
+  void MultiDataset<ParameterList>::InitBinary(const std::string &filename) {
+    BinaryTableFooter footer;
+    ReadBinaryTableFooter(filename, &footer);
+    // this will throw a TypeException if the types do not match
+    ParseHeader(footer.header);
+    binary_file_ = MapBinaryTableFile(filename);
+    char *base = binary_file_->data();
+    num_of_points_ = footer.num_of_points;
+    num_of_metadata_ = footer.num_of_metadata;
+    n_attributes_ = footer.n_attributes;
+    load_meta_ = static_cast<bool>(footer.load_meta);
+    dense_sizes_ = footer.dense_sizes;
+    sparse_sizes_ = footer.sparse_sizes;
+    labels_ = footer.labels;
+    header_ = footer.dataset_header;
+    delimiter_ = ",";
+    comma_flag_ = true;
+    if (HasMetaData_t::value == true) {
+      try {
+        meta_.resize(num_of_points_);
+      } 
+      catch(const std::bad_alloc &) {
+        fl::logger->Die() << "Problems in allocating memory for table ("<<filename<<"), the "
+          << "dataset is probably too big too fit in RAM."
+          << "It might be that your dataset is too big to fit in RAM or "
+          << "you are using a 32bit platform which limits the process address space "
+          << "to 4GB";
+      }
+      boost::mpl::for_each<boost::mpl::range_c<int, 0, MetaDataType_t::size> >(
+        BinaryMetaReader(&meta_, base, &footer));
+    }
+    index_t count = 0;
+    boost::mpl::for_each<DenseTypeList_t>(
+      BinaryDenseReader(&dense_, base, &footer, &count));
+    count = 0;
+    boost::mpl::for_each<SparseTypeList_t>(
+      BinarySparseReader(&sparse_, base, &footer, &count));
+    Reset();
+  }
+
+  template<typename ParameterList>
+  void MultiDataset<ParameterList>::set_n_threads(int n_threads) {
+    n_threads_=std::max(1, n_threads);
+  }
+
+  template<typename ParameterList>
+  int MultiDataset<ParameterList>::n_threads() const {
+    return n_threads_;
+  }
+
 }}
 #endif
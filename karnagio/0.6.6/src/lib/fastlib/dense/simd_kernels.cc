@@ -0,0 +1,692 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <cmath>
+#include "fastlib/dense/simd_kernels.h"
+
+// The kernels must add and multiply exactly as written, a fused
+// multiply-add would make the results depend on the cpu
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FL_SIMD_X86
+#include <immintrin.h>
+#endif
+
+// The helpers return vector registers, they must be inlined in the loops
+// at every optimization level
+#ifdef __GNUC__
+#define FL_SIMD_INLINE inline __attribute__((always_inline))
+#else
+#define FL_SIMD_INLINE inline
+#endif
+
+namespace {
+
+enum Operation {
+  kSquared = 0,
+  kAbsolute,
+  kWeightedSquared,
+  kProduct
+};
+
+/**
+ * Every sum is accumulated in Lanes<T>::value partial sums, element i goes
+ * to partial sum i % value. The partial sums are then added pairwise, the
+ * upper half to the lower half, until one is left, and the elements after
+ * the last full set of lanes are added to it in order. This is what the
+ * registers of every instruction set below do, so they all give the same
+ * result
+ */
+template<typename T>
+struct Lanes;
+
+template<>
+struct Lanes<double> {
+  static const int value = 8;
+};
+
+template<>
+struct Lanes<float> {
+  static const int value = 16;
+};
+
+template<Operation op, typename T>
+FL_SIMD_INLINE T ScalarTerm(const T *w, const T *x, const T *y, index_t i) {
+  if (op == kProduct) {
+    return x[i] * y[i];
+  }
+  T d = x[i] - y[i];
+  if (op == kAbsolute) {
+    return std::fabs(d);
+  }
+  T s = d * d;
+  if (op == kWeightedSquared) {
+    return w[i] * s;
+  }
+  return s;
+}
+
+template<Operation op, typename T>
+T ScalarSum(index_t length, const T *w, const T *x, const T *y) {
+  const int lanes = Lanes<T>::value;
+  T acc[lanes];
+  for (int l = 0; l < lanes; ++l) {
+    acc[l] = 0;
+  }
+  index_t i = 0;
+  for (; i + lanes <= length; i += lanes) {
+    for (int l = 0; l < lanes; ++l) {
+      acc[l] += ScalarTerm<op>(w, x, y, i + l);
+    }
+  }
+  for (int width = lanes / 2; width >= 1; width /= 2) {
+    for (int l = 0; l < width; ++l) {
+      acc[l] += acc[l + width];
+    }
+  }
+  T s = acc[0];
+  for (; i < length; ++i) {
+    s += ScalarTerm<op>(w, x, y, i);
+  }
+  return s;
+}
+
+template<typename T>
+void ScalarBlock(index_t length, const T *query,
+                 const T *const *references, index_t count, T *distances) {
+  for (index_t r = 0; r < count; ++r) {
+    distances[r] = ScalarSum<kSquared>(length, query, query, references[r]);
+  }
+}
+
+#ifdef FL_SIMD_X86
+
+/////////////////////////////////// SSE2 ///////////////////////////////////
+template<Operation op>
+__attribute__((target("sse2")))
+FL_SIMD_INLINE __m128d Sse2Term(const double *w, const double *x,
+                                const double *y) {
+  __m128d a = _mm_loadu_pd(x);
+  __m128d b = _mm_loadu_pd(y);
+  if (op == kProduct) {
+    return _mm_mul_pd(a, b);
+  }
+  __m128d d = _mm_sub_pd(a, b);
+  if (op == kAbsolute) {
+    return _mm_andnot_pd(_mm_set1_pd(-0.0), d);
+  }
+  __m128d s = _mm_mul_pd(d, d);
+  if (op == kWeightedSquared) {
+    return _mm_mul_pd(_mm_loadu_pd(w), s);
+  }
+  return s;
+}
+
+template<Operation op>
+__attribute__((target("sse2")))
+FL_SIMD_INLINE __m128 Sse2Term(const float *w, const float *x,
+                               const float *y) {
+  __m128 a = _mm_loadu_ps(x);
+  __m128 b = _mm_loadu_ps(y);
+  if (op == kProduct) {
+    return _mm_mul_ps(a, b);
+  }
+  __m128 d = _mm_sub_ps(a, b);
+  if (op == kAbsolute) {
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), d);
+  }
+  __m128 s = _mm_mul_ps(d, d);
+  if (op == kWeightedSquared) {
+    return _mm_mul_ps(_mm_loadu_ps(w), s);
+  }
+  return s;
+}
+
+// lanes 0-1 are added to 2-3 in double and 0-3 to 4-7 in float
+__attribute__((target("sse2")))
+FL_SIMD_INLINE double Sse2Reduce(__m128d lanes01, __m128d lanes23) {
+  __m128d u = _mm_add_pd(lanes01, lanes23);
+  return _mm_cvtsd_f64(_mm_add_sd(u, _mm_unpackhi_pd(u, u)));
+}
+
+__attribute__((target("sse2")))
+FL_SIMD_INLINE float Sse2Reduce(__m128 lanes0123, __m128 lanes4567) {
+  __m128 u = _mm_add_ps(lanes0123, lanes4567);
+  __m128 v = _mm_add_ps(u, _mm_movehl_ps(u, u));
+  return _mm_cvtss_f32(_mm_add_ss(v, _mm_shuffle_ps(v, v, 1)));
+}
+
+template<Operation op>
+__attribute__((target("sse2")))
+double Sse2Sum(index_t length, const double *w, const double *x,
+               const double *y) {
+  __m128d a0 = _mm_setzero_pd();
+  __m128d a1 = _mm_setzero_pd();
+  __m128d a2 = _mm_setzero_pd();
+  __m128d a3 = _mm_setzero_pd();
+  index_t i = 0;
+  for (; i + 8 <= length; i += 8) {
+    a0 = _mm_add_pd(a0, Sse2Term<op>(w + i, x + i, y + i));
+    a1 = _mm_add_pd(a1, Sse2Term<op>(w + i + 2, x + i + 2, y + i + 2));
+    a2 = _mm_add_pd(a2, Sse2Term<op>(w + i + 4, x + i + 4, y + i + 4));
+    a3 = _mm_add_pd(a3, Sse2Term<op>(w + i + 6, x + i + 6, y + i + 6));
+  }
+  double s = Sse2Reduce(_mm_add_pd(a0, a2), _mm_add_pd(a1, a3));
+  for (; i < length; ++i) {
+    s += ScalarTerm<op>(w, x, y, i);
+  }
+  return s;
+}
+
+template<Operation op>
+__attribute__((target("sse2")))
+float Sse2Sum(index_t length, const float *w, const float *x,
+              const float *y) {
+  __m128 a0 = _mm_setzero_ps();
+  __m128 a1 = _mm_setzero_ps();
+  __m128 a2 = _mm_setzero_ps();
+  __m128 a3 = _mm_setzero_ps();
+  index_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    a0 = _mm_add_ps(a0, Sse2Term<op>(w + i, x + i, y + i));
+    a1 = _mm_add_ps(a1, Sse2Term<op>(w + i + 4, x + i + 4, y + i + 4));
+    a2 = _mm_add_ps(a2, Sse2Term<op>(w + i + 8, x + i + 8, y + i + 8));
+    a3 = _mm_add_ps(a3, Sse2Term<op>(w + i + 12, x + i + 12, y + i + 12));
+  }
+  float s = Sse2Reduce(_mm_add_ps(a0, a2), _mm_add_ps(a1, a3));
+  for (; i < length; ++i) {
+    s += ScalarTerm<op>(w, x, y, i);
+  }
+  return s;
+}
+
+// SSE2 has too few registers to keep several references in flight
+template<typename T>
+__attribute__((target("sse2")))
+void Sse2Block(index_t length, const T *query,
+               const T *const *references, index_t count, T *distances) {
+  for (index_t r = 0; r < count; ++r) {
+    distances[r] = Sse2Sum<kSquared>(length, query, query, references[r]);
+  }
+}
+
+/////////////////////////////////// AVX2 ///////////////////////////////////
+// The AVX functions clear the upper halves of the registers before they
+// return, the callers may run legacy SSE code and the compiler does not
+// do it when it does not optimize
+template<Operation op>
+__attribute__((target("avx2")))
+FL_SIMD_INLINE __m256d Avx2Term(const double *w, const double *x,
+                                const double *y) {
+  __m256d a = _mm256_loadu_pd(x);
+  __m256d b = _mm256_loadu_pd(y);
+  if (op == kProduct) {
+    return _mm256_mul_pd(a, b);
+  }
+  __m256d d = _mm256_sub_pd(a, b);
+  if (op == kAbsolute) {
+    return _mm256_andnot_pd(_mm256_set1_pd(-0.0), d);
+  }
+  __m256d s = _mm256_mul_pd(d, d);
+  if (op == kWeightedSquared) {
+    return _mm256_mul_pd(_mm256_loadu_pd(w), s);
+  }
+  return s;
+}
+
+template<Operation op>
+__attribute__((target("avx2")))
+FL_SIMD_INLINE __m256 Avx2Term(const float *w, const float *x,
+                               const float *y) {
+  __m256 a = _mm256_loadu_ps(x);
+  __m256 b = _mm256_loadu_ps(y);
+  if (op == kProduct) {
+    return _mm256_mul_ps(a, b);
+  }
+  __m256 d = _mm256_sub_ps(a, b);
+  if (op == kAbsolute) {
+    return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), d);
+  }
+  __m256 s = _mm256_mul_ps(d, d);
+  if (op == kWeightedSquared) {
+    return _mm256_mul_ps(_mm256_loadu_ps(w), s);
+  }
+  return s;
+}
+
+__attribute__((target("avx2")))
+FL_SIMD_INLINE double Avx2Reduce(__m256d lower, __m256d upper) {
+  __m256d t = _mm256_add_pd(lower, upper);
+  return Sse2Reduce(_mm256_castpd256_pd128(t), _mm256_extractf128_pd(t, 1));
+}
+
+__attribute__((target("avx2")))
+FL_SIMD_INLINE float Avx2Reduce(__m256 lower, __m256 upper) {
+  __m256 t = _mm256_add_ps(lower, upper);
+  return Sse2Reduce(_mm256_castps256_ps128(t), _mm256_extractf128_ps(t, 1));
+}
+
+template<Operation op>
+__attribute__((target("avx2")))
+double Avx2Sum(index_t length, const double *w, const double *x,
+               const double *y) {
+  __m256d a0 = _mm256_setzero_pd();
+  __m256d a1 = _mm256_setzero_pd();
+  index_t i = 0;
+  for (; i + 8 <= length; i += 8) {
+    a0 = _mm256_add_pd(a0, Avx2Term<op>(w + i, x + i, y + i));
+    a1 = _mm256_add_pd(a1, Avx2Term<op>(w + i + 4, x + i + 4, y + i + 4));
+  }
+  double s = Avx2Reduce(a0, a1);
+  for (; i < length; ++i) {
+    s += ScalarTerm<op>(w, x, y, i);
+  }
+  _mm256_zeroupper();
+  return s;
+}
+
+template<Operation op>
+__attribute__((target("avx2")))
+float Avx2Sum(index_t length, const float *w, const float *x,
+              const float *y) {
+  __m256 a0 = _mm256_setzero_ps();
+  __m256 a1 = _mm256_setzero_ps();
+  index_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    a0 = _mm256_add_ps(a0, Avx2Term<op>(w + i, x + i, y + i));
+    a1 = _mm256_add_ps(a1, Avx2Term<op>(w + i + 8, x + i + 8, y + i + 8));
+  }
+  float s = Avx2Reduce(a0, a1);
+  for (; i < length; ++i) {
+    s += ScalarTerm<op>(w, x, y, i);
+  }
+  _mm256_zeroupper();
+  return s;
+}
+
+// four references share every load of the query
+__attribute__((target("avx2")))
+void Avx2Block(index_t length, const double *query,
+               const double *const *references, index_t count,
+               double *distances) {
+  index_t r = 0;
+  for (; r + 4 <= count; r += 4) {
+    __m256d lower[4];
+    __m256d upper[4];
+    for (int k = 0; k < 4; ++k) {
+      lower[k] = _mm256_setzero_pd();
+      upper[k] = _mm256_setzero_pd();
+    }
+    index_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+      for (int k = 0; k < 4; ++k) {
+        const double *reference = references[r + k] + i;
+        lower[k] = _mm256_add_pd(lower[k],
+            Avx2Term<kSquared>(query, query + i, reference));
+        upper[k] = _mm256_add_pd(upper[k],
+            Avx2Term<kSquared>(query, query + i + 4, reference + 4));
+      }
+    }
+    for (int k = 0; k < 4; ++k) {
+      double s = Avx2Reduce(lower[k], upper[k]);
+      for (index_t j = i; j < length; ++j) {
+        s += ScalarTerm<kSquared>(query, query, references[r + k], j);
+      }
+      distances[r + k] = s;
+    }
+  }
+  for (; r < count; ++r) {
+    distances[r] = Avx2Sum<kSquared>(length, query, query, references[r]);
+  }
+  _mm256_zeroupper();
+}
+
+__attribute__((target("avx2")))
+void Avx2Block(index_t length, const float *query,
+               const float *const *references, index_t count,
+               float *distances) {
+  index_t r = 0;
+  for (; r + 4 <= count; r += 4) {
+    __m256 lower[4];
+    __m256 upper[4];
+    for (int k = 0; k < 4; ++k) {
+      lower[k] = _mm256_setzero_ps();
+      upper[k] = _mm256_setzero_ps();
+    }
+    index_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+      for (int k = 0; k < 4; ++k) {
+        const float *reference = references[r + k] + i;
+        lower[k] = _mm256_add_ps(lower[k],
+            Avx2Term<kSquared>(query, query + i, reference));
+        upper[k] = _mm256_add_ps(upper[k],
+            Avx2Term<kSquared>(query, query + i + 8, reference + 8));
+      }
+    }
+    for (int k = 0; k < 4; ++k) {
+      float s = Avx2Reduce(lower[k], upper[k]);
+      for (index_t j = i; j < length; ++j) {
+        s += ScalarTerm<kSquared>(query, query, references[r + k], j);
+      }
+      distances[r + k] = s;
+    }
+  }
+  for (; r < count; ++r) {
+    distances[r] = Avx2Sum<kSquared>(length, query, query, references[r]);
+  }
+  _mm256_zeroupper();
+}
+
+///////////////////////////////// AVX-512 //////////////////////////////////
+template<Operation op>
+__attribute__((target("avx512f")))
+FL_SIMD_INLINE __m512d Avx512Term(const double *w, const double *x,
+                                  const double *y) {
+  __m512d a = _mm512_loadu_pd(x);
+  __m512d b = _mm512_loadu_pd(y);
+  if (op == kProduct) {
+    return _mm512_mul_pd(a, b);
+  }
+  __m512d d = _mm512_sub_pd(a, b);
+  if (op == kAbsolute) {
+    return _mm512_castsi512_pd(_mm512_and_epi64(_mm512_castpd_si512(d),
+        _mm512_set1_epi64(0x7fffffffffffffffLL)));
+  }
+  __m512d s = _mm512_mul_pd(d, d);
+  if (op == kWeightedSquared) {
+    return _mm512_mul_pd(_mm512_loadu_pd(w), s);
+  }
+  return s;
+}
+
+template<Operation op>
+__attribute__((target("avx512f")))
+FL_SIMD_INLINE __m512 Avx512Term(const float *w, const float *x,
+                                 const float *y) {
+  __m512 a = _mm512_loadu_ps(x);
+  __m512 b = _mm512_loadu_ps(y);
+  if (op == kProduct) {
+    return _mm512_mul_ps(a, b);
+  }
+  __m512 d = _mm512_sub_ps(a, b);
+  if (op == kAbsolute) {
+    return _mm512_castsi512_ps(_mm512_and_epi32(_mm512_castps_si512(d),
+        _mm512_set1_epi32(0x7fffffff)));
+  }
+  __m512 s = _mm512_mul_ps(d, d);
+  if (op == kWeightedSquared) {
+    return _mm512_mul_ps(_mm512_loadu_ps(w), s);
+  }
+  return s;
+}
+
+__attribute__((target("avx512f")))
+FL_SIMD_INLINE double Avx512Reduce(__m512d a) {
+  return Avx2Reduce(_mm512_castpd512_pd256(a), _mm512_extractf64x4_pd(a, 1));
+}
+
+__attribute__((target("avx512f")))
+FL_SIMD_INLINE float Avx512Reduce(__m512 a) {
+  return Avx2Reduce(_mm512_castps512_ps256(a),
+      _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(a), 1)));
+}
+
+
+template<Operation op>
+__attribute__((target("avx512f")))
+double Avx512Sum(index_t length, const double *w, const double *x,
+                 const double *y) {
+  __m512d a = _mm512_setzero_pd();
+  index_t i = 0;
+  for (; i + 8 <= length; i += 8) {
+    a = _mm512_add_pd(a, Avx512Term<op>(w + i, x + i, y + i));
+  }
+  double s = Avx512Reduce(a);
+  for (; i < length; ++i) {
+    s += ScalarTerm<op>(w, x, y, i);
+  }
+  _mm256_zeroupper();
+  return s;
+}
+
+template<Operation op>
+__attribute__((target("avx512f")))
+float Avx512Sum(index_t length, const float *w, const float *x,
+                const float *y) {
+  __m512 a = _mm512_setzero_ps();
+  index_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    a = _mm512_add_ps(a, Avx512Term<op>(w + i, x + i, y + i));
+  }
+  float s = Avx512Reduce(a);
+  for (; i < length; ++i) {
+    s += ScalarTerm<op>(w, x, y, i);
+  }
+  _mm256_zeroupper();
+  return s;
+}
+
+__attribute__((target("avx512f")))
+void Avx512Block(index_t length, const double *query,
+                 const double *const *references, index_t count,
+                 double *distances) {
+  index_t r = 0;
+  for (; r + 4 <= count; r += 4) {
+    __m512d acc[4];
+    for (int k = 0; k < 4; ++k) {
+      acc[k] = _mm512_setzero_pd();
+    }
+    index_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+      for (int k = 0; k < 4; ++k) {
+        acc[k] = _mm512_add_pd(acc[k],
+            Avx512Term<kSquared>(query, query + i, references[r + k] + i));
+      }
+    }
+    for (int k = 0; k < 4; ++k) {
+      double s = Avx512Reduce(acc[k]);
+      for (index_t j = i; j < length; ++j) {
+        s += ScalarTerm<kSquared>(query, query, references[r + k], j);
+      }
+      distances[r + k] = s;
+    }
+  }
+  for (; r < count; ++r) {
+    distances[r] = Avx512Sum<kSquared>(length, query, query, references[r]);
+  }
+  _mm256_zeroupper();
+}
+
+__attribute__((target("avx512f")))
+void Avx512Block(index_t length, const float *query,
+                 const float *const *references, index_t count,
+                 float *distances) {
+  index_t r = 0;
+  for (; r + 4 <= count; r += 4) {
+    __m512 acc[4];
+    for (int k = 0; k < 4; ++k) {
+      acc[k] = _mm512_setzero_ps();
+    }
+    index_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+      for (int k = 0; k < 4; ++k) {
+        acc[k] = _mm512_add_ps(acc[k],
+            Avx512Term<kSquared>(query, query + i, references[r + k] + i));
+      }
+    }
+    for (int k = 0; k < 4; ++k) {
+      float s = Avx512Reduce(acc[k]);
+      for (index_t j = i; j < length; ++j) {
+        s += ScalarTerm<kSquared>(query, query, references[r + k], j);
+      }
+      distances[r + k] = s;
+    }
+  }
+  for (; r < count; ++r) {
+    distances[r] = Avx512Sum<kSquared>(length, query, query, references[r]);
+  }
+  _mm256_zeroupper();
+}
+
+#endif
+
+/**
+ * @brief The kernels of one instruction set, the sums are indexed by
+ *        Operation
+ */
+struct Kernels {
+  const char *name;
+  double (*sum_double[4])(index_t, const double *, const double *,
+      const double *);
+  float (*sum_float[4])(index_t, const float *, const float *,
+      const float *);
+  void (*block_double)(index_t, const double *, const double *const *,
+      index_t, double *);
+  void (*block_float)(index_t, const float *, const float *const *,
+      index_t, float *);
+};
+
+#define FL_SIMD_KERNELS(name, Sum, Block) { \
+  name, \
+  {&Sum<kSquared>, &Sum<kAbsolute>, &Sum<kWeightedSquared>, &Sum<kProduct>}, \
+  {&Sum<kSquared>, &Sum<kAbsolute>, &Sum<kWeightedSquared>, &Sum<kProduct>}, \
+  &Block, \
+  &Block \
+}
+
+const Kernels kScalarKernels =
+  FL_SIMD_KERNELS("scalar", ScalarSum, ScalarBlock);
+#ifdef FL_SIMD_X86
+const Kernels kSse2Kernels = FL_SIMD_KERNELS("sse2", Sse2Sum, Sse2Block);
+const Kernels kAvx2Kernels = FL_SIMD_KERNELS("avx2", Avx2Sum, Avx2Block);
+const Kernels kAvx512Kernels =
+  FL_SIMD_KERNELS("avx512", Avx512Sum, Avx512Block);
+#endif
+
+#undef FL_SIMD_KERNELS
+#undef FL_SIMD_INLINE
+
+const Kernels *Supported(const std::string &name) {
+  if (name == "scalar") {
+    return &kScalarKernels;
+  }
+#ifdef FL_SIMD_X86
+  __builtin_cpu_init();
+  if (name == "sse2" && __builtin_cpu_supports("sse2")) {
+    return &kSse2Kernels;
+  }
+  if (name == "avx2" && __builtin_cpu_supports("avx2")) {
+    return &kAvx2Kernels;
+  }
+  if (name == "avx512" && __builtin_cpu_supports("avx512f")) {
+    return &kAvx512Kernels;
+  }
+#endif
+  return NULL;
+}
+
+const Kernels *Best() {
+  const char *names[] = {"avx512", "avx2", "sse2"};
+  for (int i = 0; i < 3; ++i) {
+    if (Supported(names[i]) != NULL) {
+      return Supported(names[i]);
+    }
+  }
+  return &kScalarKernels;
+}
+
+const Kernels *&Current() {
+  static const Kernels *current = Best();
+  return current;
+}
+
+}
+
+namespace fl { namespace dense { namespace simd {
+
+double DistanceSq(index_t length, const double *x, const double *y) {
+  return Current()->sum_double[kSquared](length, x, x, y);
+}
+
+float DistanceSq(index_t length, const float *x, const float *y) {
+  return Current()->sum_float[kSquared](length, x, x, y);
+}
+
+double DistanceL1(index_t length, const double *x, const double *y) {
+  return Current()->sum_double[kAbsolute](length, x, x, y);
+}
+
+float DistanceL1(index_t length, const float *x, const float *y) {
+  return Current()->sum_float[kAbsolute](length, x, x, y);
+}
+
+double WeightedDistanceSq(index_t length, const double *w,
+                          const double *x, const double *y) {
+  return Current()->sum_double[kWeightedSquared](length, w, x, y);
+}
+
+float WeightedDistanceSq(index_t length, const float *w,
+                         const float *x, const float *y) {
+  return Current()->sum_float[kWeightedSquared](length, w, x, y);
+}
+
+double Dot(index_t length, const double *x, const double *y) {
+  return Current()->sum_double[kProduct](length, x, x, y);
+}
+
+float Dot(index_t length, const float *x, const float *y) {
+  return Current()->sum_float[kProduct](length, x, x, y);
+}
+
+void DistanceSqBlock(index_t length, const double *query,
+                     const double *const *references, index_t count,
+                     double *distances) {
+  Current()->block_double(length, query, references, count, distances);
+}
+
+void DistanceSqBlock(index_t length, const float *query,
+                     const float *const *references, index_t count,
+                     float *distances) {
+  Current()->block_float(length, query, references, count, distances);
+}
+
+std::string instruction_set() {
+  return Current()->name;
+}
+
+bool set_instruction_set(const std::string &name) {
+  const Kernels *kernels = Supported(name);
+  if (kernels == NULL) {
+    return false;
+  }
+  Current() = kernels;
+  return true;
+}
+
+}}}
@@ -0,0 +1,139 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include "fastlib/table/graph_index.h"
+#include "fastlib/base/logger.h"
+#include "boost/functional/hash.hpp"
+#include "boost/archive/binary_oarchive.hpp"
+#include "boost/archive/binary_iarchive.hpp"
+#include "boost/archive/archive_exception.hpp"
+#include "boost/serialization/vector.hpp"
+#include "boost/serialization/string.hpp"
+
+namespace fl {
+namespace table {
+
+GraphIndex::GraphIndex() : max_degree_(0), seed_(0), entry_point_(-1),
+    max_level_(-1) {
+}
+
+void GraphIndex::Save(const std::string &file) const {
+  std::ofstream fout(file.c_str(),
+      std::ios::out | std::ios::binary | std::ios::trunc);
+  if (fout.fail()) {
+    fl::logger->Die() << "Could not open file "
+      << file << " error " << strerror(errno);
+  }
+  try {
+    boost::archive::binary_oarchive oa(fout);
+    oa << max_degree_;
+    oa << metric_type_id_;
+    oa << seed_;
+    oa << levels_;
+    oa << links_;
+    oa << entry_point_;
+    oa << max_level_;
+  }
+  catch(const boost::archive::archive_exception &e) {
+    fl::logger->Die() << "Graph archiving (save): " << e.what();
+  }
+}
+
+void GraphIndex::Load(const std::string &file) {
+  std::ifstream fin(file.c_str(), std::ios::in | std::ios::binary);
+  if (fin.fail()) {
+    fl::logger->Die() << "Could not open file "
+      << file << " error " << strerror(errno);
+  }
+  try {
+    boost::archive::binary_iarchive ia(fin);
+    ia >> max_degree_;
+    ia >> metric_type_id_;
+    ia >> seed_;
+    ia >> levels_;
+    ia >> links_;
+    ia >> entry_point_;
+    ia >> max_level_;
+  }
+  catch(const boost::archive::archive_exception &e) {
+    fl::logger->Die() << "Graph archiving (load): " << e.what();
+  }
+}
+
+bool GraphIndex::is_indexed() const {
+  return entry_point_ >= 0;
+}
+
+index_t GraphIndex::n_entries() const {
+  return static_cast<index_t>(levels_.size());
+}
+
+index_t GraphIndex::max_degree() const {
+  return max_degree_;
+}
+
+int GraphIndex::max_level() const {
+  return max_level_;
+}
+
+const std::string &GraphIndex::metric_type_id() const {
+  return metric_type_id_;
+}
+
+index_t GraphIndex::num_of_links(index_t point, int level) const {
+  if (level > levels_[point]) {
+    return 0;
+  }
+  boost::mutex::scoped_lock lock(link_locks_[point % kNumOfLocks]);
+  return static_cast<index_t>(links_[point][level].size());
+}
+
+/**
+ * The levels are geometric, a point is on level l with probability
+ * max_degree^-l, so that every level has about max_degree times fewer
+ * points than the one below
+ */
+int GraphIndex::RandomLevel_(index_t point) const {
+  std::size_t hash = 0;
+  boost::hash_combine(hash, seed_);
+  boost::hash_combine(hash, point);
+  // boost::hash of integers is the identity, scramble it
+  uint64 bits = static_cast<uint64>(hash) * 0x9E3779B97F4A7C15ULL;
+  bits ^= bits >> 29;
+  bits *= 0xBF58476D1CE4E5B9ULL;
+  bits ^= bits >> 32;
+  double uniform = (static_cast<double>(bits >> 11) + 1.0) / 9007199254740992.0;
+  return static_cast<int>(std::floor(-std::log(uniform)
+                                     / std::log(static_cast<double>(max_degree_))));
+}
+
+index_t GraphIndex::MaxLinks_(int level) const {
+  return level == 0 ? 2 * max_degree_ : max_degree_;
+}
+
+}}
@@ -28,6 +28,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "fastlib/table/default/categorical/labeled/balltree/table.h"
 #include "fastlib/table/default/dense/labeled/kdtree/table.h"
 #include "fastlib/table/default/dense/labeled/balltree/table.h"
+#include "fastlib/table/default/dense/labeled/covertree/table.h"
 #include "fastlib/table/default/dense_categorical/labeled/balltree/table.h"
 #include "fastlib/table/default/dense_sparse/labeled/balltree/table.h"
 #include "fastlib/table/default/sparse/labeled/balltree/table.h"
@@ -36,6 +37,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 template class ::fl::table::Table<fl::table::dense::labeled::kdtree::TableMap> ;
 template class ::fl::table::Table<fl::table::dense::labeled::balltree::TableMap> ;
+template class ::fl::table::Table<fl::table::dense::labeled::covertree::TableMap> ;
 template class ::fl::table::Table<fl::table::sparse::labeled::balltree::TableMap> ;
 template class ::fl::table::Table<fl::table::dense_sparse::labeled::balltree::TableMap> ;
 template class fl::table::Table<fl::table::categorical::labeled::balltree::TableMap> ;
@@ -389,3 +389,30 @@ POSSIBILITY OF SUCH DAMAGE.
    return results;
  }
 
+ void fl::ws::AddWorkSpaceOptions(
+     boost::program_options::options_description *desc) {
+   desc->add_options()(
+     "stream_block_mb",
+     boost::program_options::value<int64>(),
+     "if it is set the tables that support it are not loaded in memory, "
+     "they are read in blocks of that many megabytes. Use it for tables "
+     "that do not fit in RAM"
+   )(
+     "stream_window",
+     boost::program_options::value<int>(),
+     "the maximum number of blocks of --stream_block_mb that are in memory, "
+     "1 by default. When it is more than 1 the next blocks are read in the "
+     "background"
+   )(
+     "spill_codec",
+     boost::program_options::value<std::string>(),
+     "the format of the tables paged to the temp directory: binary is "
+     "mapped back without parsing (default), archive is a boost archive, "
+     "gzip is a compressed boost archive that uses less disk"
+   )(
+     "index_threads",
+     boost::program_options::value<int>(),
+     "the number of threads that build the trees of the references and "
+     "the queries, 1 by default"
+   );
+ }
@@ -0,0 +1,337 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "fastlib/workspace/task_graph.h"
+#include <algorithm>
+#include "boost/bind.hpp"
+#include "fastlib/base/logger.h"
+
+namespace fl { namespace ws {
+  TaskGraph::TaskGraph() : n_ready_(0), n_running_(0), n_unfinished_(0),
+    next_queue_(0), generation_(0), stop_(false) {
+  }
+
+  TaskGraph::~TaskGraph() {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      ClearLocked();
+    }
+    Stop();
+  }
+
+  void TaskGraph::Init(int n_threads, const IsAvailable_t &is_available) {
+    if (n_threads<1) {
+      fl::logger->Die()<<"The task graph needs at least one thread";
+    }
+    Stop();
+    is_available_=is_available;
+    stop_=false;
+    queues_.clear();
+    for(int i=0; i<n_threads; ++i) {
+      queues_.push_back(boost::shared_ptr<Queue>(new Queue()));
+    }
+    for(int i=0; i<n_threads; ++i) {
+      workers_.create_thread(boost::bind(&TaskGraph::Work, this, i));
+    }
+  }
+
+  void TaskGraph::Stop() {
+    Wait();
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      stop_=true;
+      changed_.notify_all();
+    }
+    workers_.join_all();
+  }
+
+  void TaskGraph::Submit(const Task_t &task,
+      const std::vector<std::string> &inputs,
+      const std::vector<std::string> &outputs) {
+    if (queues_.empty()) {
+      fl::logger->Die()<<"The task graph has not been initialized";
+    }
+    boost::mutex::scoped_lock lock(mutex_);
+    Node *node=new Node();
+    node->task=task;
+    node->outputs=outputs;
+    node->n_missing=0;
+    node->generation=generation_;
+    for(size_t i=0; i<inputs.size(); ++i) {
+      std::map<std::string, Node*>::iterator it=writers_.find(inputs[i]);
+      if (it!=writers_.end()) {
+        it->second->dependents.push_back(node);
+        node->n_missing++;
+      } else if (produced_.count(inputs[i])==0 
+          && is_available_(inputs[i])==false) {
+        // it reads what a later task writes, it becomes a reader
+        // when that task is submitted
+        waiting_[inputs[i]].push_back(node);
+        node->n_missing++;
+        continue;
+      }
+      readers_[inputs[i]].push_back(node);
+      node->inputs.push_back(inputs[i]);
+    }
+    // a table is written in the order the tasks were submitted, after 
+    // the tasks that were submitted before and read the previous version
+    for(size_t i=0; i<outputs.size(); ++i) {
+      std::map<std::string, Node*>::iterator it=writers_.find(outputs[i]);
+      if (it!=writers_.end() && it->second!=node) {
+        it->second->dependents.push_back(node);
+        node->n_missing++;
+      }
+      writers_[outputs[i]]=node;
+      std::map<std::string, std::vector<Node*> >::iterator 
+        readers=readers_.find(outputs[i]);
+      if (readers!=readers_.end()) {
+        for(size_t j=0; j<readers->second.size(); ++j) {
+          if (readers->second[j]!=node) {
+            readers->second[j]->dependents.push_back(node);
+            node->n_missing++;
+          }
+        }
+        readers_.erase(readers);
+      }
+      // the tasks that waited for the first version of the table wait
+      // for this task now, and the next writer has to wait for them
+      std::map<std::string, std::vector<Node*> >::iterator
+        waiting=waiting_.find(outputs[i]);
+      if (waiting!=waiting_.end()) {
+        std::vector<Node*> still_waiting;
+        for(size_t j=0; j<waiting->second.size(); ++j) {
+          Node *reader=waiting->second[j];
+          if (reader==node) {
+            still_waiting.push_back(reader);
+            continue;
+          }
+          node->dependents.push_back(reader);
+          readers_[outputs[i]].push_back(reader);
+          reader->inputs.push_back(outputs[i]);
+        }
+        if (still_waiting.empty()) {
+          waiting_.erase(waiting);
+        } else {
+          waiting->second.swap(still_waiting);
+        }
+      }
+    }
+    n_unfinished_++;
+    if (node->n_missing==0) {
+      int id=WorkerId();
+      if (id<0) {
+        id=next_queue_;
+        next_queue_=(next_queue_+1) % queues_.size();
+      }
+      Push(id, node);
+    }
+  }
+
+  void TaskGraph::Wait() {
+    boost::mutex::scoped_lock lock(mutex_);
+    while (n_unfinished_>0) {
+      if (n_running_==0 && n_ready_==0) {
+        std::string missing;
+        for(std::map<std::string, std::vector<Node*> >::iterator 
+            it=waiting_.begin(); it!=waiting_.end(); ++it) {
+          missing.append(" "+it->first);
+        }
+        ClearLocked();
+        fl::logger->Die()<<"There are tasks waiting for tables that are "
+          "never produced:"<<missing;
+      }
+      changed_.wait(lock);
+    }
+  }
+
+  void TaskGraph::Clear() {
+    boost::mutex::scoped_lock lock(mutex_);
+    ClearLocked();
+  }
+
+  void TaskGraph::ClearLocked() {
+    // the tasks of older generations are not run, but they still go 
+    // through the queues so that their dependents are released 
+    generation_++;
+    std::map<std::string, std::vector<Node*> > waiting;
+    waiting.swap(waiting_);
+    for(std::map<std::string, std::vector<Node*> >::iterator 
+        it=waiting.begin(); it!=waiting.end(); ++it) {
+      for(size_t i=0; i<it->second.size(); ++i) {
+        it->second[i]->n_missing--;
+        if (it->second[i]->n_missing==0) {
+          Push(0, it->second[i]);
+        }
+      }
+    }
+  }
+
+  bool TaskGraph::HelpUntil(const boost::function0<bool> &is_done) {
+    int id=WorkerId();
+    if (id<0) {
+      return false;
+    }
+    while (is_done()==false) {
+      Node *node;
+      if (Pop(id, &node)) {
+        Run(id, node);
+        continue;
+      }
+      // the event we wait for does not come from the graph,
+      // so we poll
+      boost::mutex::scoped_lock lock(mutex_);
+      if (n_ready_==0) {
+        changed_.timed_wait(lock, boost::posix_time::milliseconds(1));
+      }
+    }
+    return true;
+  }
+
+  int TaskGraph::n_threads() const {
+    return queues_.size();
+  }
+
+  void TaskGraph::Work(int id) {
+    worker_id_.reset(new int(id));
+    while (true) {
+      Node *node;
+      if (Pop(id, &node)) {
+        Run(id, node);
+        continue;
+      }
+      boost::mutex::scoped_lock lock(mutex_);
+      if (stop_==true) {
+        return;
+      }
+      if (n_ready_==0) {
+        changed_.wait(lock);
+      }
+    }
+  }
+
+  bool TaskGraph::Pop(int id, Node **node) {
+    *node=NULL;
+    {
+      boost::mutex::scoped_lock lock(queues_[id]->mutex);
+      if (queues_[id]->nodes.empty()==false) {
+        *node=queues_[id]->nodes.back();
+        queues_[id]->nodes.pop_back();
+      }
+    }
+    for(size_t i=1; *node==NULL && i<queues_.size(); ++i) {
+      Queue &victim=*queues_[(id+i) % queues_.size()];
+      boost::mutex::scoped_lock lock(victim.mutex);
+      if (victim.nodes.empty()==false) {
+        *node=victim.nodes.front();
+        victim.nodes.pop_front();
+      }
+    }
+    if (*node==NULL) {
+      return false;
+    }
+    boost::mutex::scoped_lock lock(mutex_);
+    n_ready_--;
+    n_running_++;
+    return true;
+  }
+
+  void TaskGraph::Push(int id, Node *node) {
+    {
+      boost::mutex::scoped_lock lock(queues_[id]->mutex);
+      queues_[id]->nodes.push_back(node);
+    }
+    n_ready_++;
+    changed_.notify_all();
+  }
+
+  void TaskGraph::Run(int id, Node *node) {
+    bool cancelled;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      cancelled=node->generation!=generation_;
+    }
+    if (cancelled==false) {
+      try {
+        node->task();
+      }
+      catch(...) {
+        boost::mutex::scoped_lock lock(*global_exception_mutex);
+        fl::global_exception=boost::current_exception();
+      }
+    }
+    Release(id, node);
+  }
+
+  void TaskGraph::Release(int id, Node *node) {
+    boost::mutex::scoped_lock lock(mutex_);
+    for(size_t i=0; i<node->inputs.size(); ++i) {
+      std::map<std::string, std::vector<Node*> >::iterator 
+        readers=readers_.find(node->inputs[i]);
+      if (readers!=readers_.end()) {
+        readers->second.erase(std::remove(readers->second.begin(), 
+              readers->second.end(), node), readers->second.end());
+        if (readers->second.empty()) {
+          readers_.erase(readers);
+        }
+      }
+    }
+    for(size_t i=0; i<node->outputs.size(); ++i) {
+      const std::string &table=node->outputs[i];
+      produced_.insert(table);
+      std::map<std::string, Node*>::iterator it=writers_.find(table);
+      if (it!=writers_.end() && it->second==node) {
+        writers_.erase(it);
+      }
+      std::map<std::string, std::vector<Node*> >::iterator 
+        waiting=waiting_.find(table);
+      if (waiting!=waiting_.end()) {
+        for(size_t j=0; j<waiting->second.size(); ++j) {
+          waiting->second[j]->n_missing--;
+          if (waiting->second[j]->n_missing==0) {
+            Push(id, waiting->second[j]);
+          }
+        }
+        waiting_.erase(waiting);
+      }
+    }
+    for(size_t i=0; i<node->dependents.size(); ++i) {
+      node->dependents[i]->n_missing--;
+      if (node->dependents[i]->n_missing==0) {
+        Push(id, node->dependents[i]);
+      }
+    }
+    n_running_--;
+    n_unfinished_--;
+    delete node;
+    changed_.notify_all();
+  }
+
+  int TaskGraph::WorkerId() {
+    if (worker_id_.get()==NULL) {
+      return -1;
+    }
+    return *worker_id_;
+  }
+}}
@@ -57,15 +57,10 @@ namespace fl { namespace ws {
     for(it1=var_map_.begin();it1!=var_map_.end(); ++it1) {
       it1->second=std::string();
     }
-    std::map<std::string, boost::shared_ptr<boost::mutex> >::iterator it;
-    global_mutex_.try_lock();
-    for(it=mutex_map_.begin(); it!=mutex_map_.end(); ++it) {
-      // we need to make sure that all the mutexes are unlocked
-      it->second->try_lock();
-      it->second->unlock();
-      it->second.reset(new boost::mutex());
-    }
-    global_mutex_.unlock();
+    {
+      boost::unique_lock<boost::shared_mutex> global_lock(global_mutex_);
+      table_locks_.clear();
+    }
     timer_.End();
     fl::logger->Debug()<<"Workspace terminated at time: "<<timer_.GetTotalElapsedTime()
       <<"sec "<<std::endl;
@@ -77,6 +72,9 @@ namespace fl { namespace ws {
     temp_var_prefix_="ismion_temp_vars_"+boost::lexical_cast<std::string>(time(NULL))+"_";
     schedule_mode_=0;
     use_paging_=true;
+    spill_codec_="binary";
+    stream_block_size_=0;
+    stream_window_=1;
     boost::system::error_code error_code;
     temp_directory_=boost::filesystem::temp_directory_path(error_code);
     if (error_code.value()!=0) {
@@ -97,6 +95,30 @@ namespace fl { namespace ws {
     // this variable is used to handle cases where we have
     // file sequences with a prefix and an increasing numbering
     std::map<std::string, std::pair<std::string, int32> > file_sequences;
+    // tables that are bigger than RAM can be streamed in blocks
+    for(unsigned int i=0; i<args.size(); ++i) {
+      try {
+        if (boost::algorithm::starts_with(args[i], "--stream_block_mb=")) {
+          stream_block_size_=boost::lexical_cast<index_t>(
+              args[i].substr(std::string("--stream_block_mb=").size()))<<20;
+        }
+        if (boost::algorithm::starts_with(args[i], "--stream_window=")) {
+          stream_window_=boost::lexical_cast<int>(
+              args[i].substr(std::string("--stream_window=").size()));
+        }
+        if (boost::algorithm::starts_with(args[i], "--spill_codec=")) {
+          set_spill_codec(
+              args[i].substr(std::string("--spill_codec=").size()));
+        }
+      }
+      catch(...) {
+        fl::logger->Die()<<"There is something wrong in this argument "
+          <<args[i];
+      }
+    }
+    if (stream_window_<1) {
+      fl::logger->Die()<<"--stream_window must be at least 1";
+    }
     for(unsigned int i=0; i<args.size(); ++i) {
       if (boost::algorithm::starts_with(args[i], "--") &&
           boost::algorithm::contains(args[i], "_in=")) {
@@ -137,6 +159,11 @@ namespace fl { namespace ws {
             && fl::StringEndsWith(tokens[0], "_prefix_in")==false) {
           std::string filename=tokens[1];
           std::string variable=filename;
+          if (boost::algorithm::contains(tokens[0], "references_in") &&
+              stream_block_size_>0) {
+            RegisterStream(variable, filename);
+            continue;
+          }
           if (boost::algorithm::contains(tokens[0], "references_in")||
              boost::algorithm::contains(tokens[0], "queries_in")) {
             LoadFromFile<DataTables_t>(variable, filename);
@@ -152,6 +179,11 @@ namespace fl { namespace ws {
              boost::algorithm::is_any_of(":,"));
           for(unsigned int j=0; j<filenames.size(); ++j) {
             std::string variable(filenames[j]);
+            if (boost::algorithm::contains(tokens[0], "references_in") &&
+                stream_block_size_>0) {
+              RegisterStream(variable, filenames[j]);
+              continue;
+            }
             if (boost::algorithm::contains(tokens[0], "references")||
               boost::algorithm::contains(tokens[0], "queries")) {
               LoadFromFile<DataTables_t>(variable, filenames[j]);
@@ -197,6 +229,9 @@ namespace fl { namespace ws {
     std::string metric("l2");
     std::string metric_args;
     int leaf_size=20;
+    int n_threads=1;
+    std::string split;
+    std::string tree;
     std::map<std::string, std::string> argmap;
     for(unsigned int i=0; i<args->size(); ++i) {
       std::vector<std::string> tokens;
@@ -217,8 +252,22 @@ namespace fl { namespace ws {
     if (argmap.count("leaf_size")>0) {
       leaf_size=boost::lexical_cast<int>(argmap["leaf_size"]);         
     }
+    if (argmap.count("index_threads")>0) {
+      n_threads=boost::lexical_cast<int>(argmap["index_threads"]);         
+    }
+    if (argmap.count("split")>0) {
+      split=argmap["split"];
+    }
+    if (argmap.count("tree")>0) {
+      tree=argmap["tree"];
+    }
+    // --algorithm=graph searches a graph index instead of the trees,
+    // the trees do not support all the metrics the graph does anyway
+    if (argmap.count("algorithm")>0 && argmap["algorithm"]=="graph") {
+      return;
+    }
     std::vector<std::string> references_names;
-    if (argmap.count("refernces_in")>0 || argmap.count("references_prefix_in")>0) {
+    if (argmap.count("references_in")>0 || argmap.count("references_prefix_in")>0) {
       references_names=fl::ws::GetFileSequence("references", argmap);
     }
     std::vector<std::string> queries_names;
@@ -227,21 +276,41 @@ namespace fl { namespace ws {
     }
     
     for(size_t i=0; i<references_names.size(); ++i) {
+      // a streamed table is read one block at a time, it has no tree
+      if (IsStreamed(references_names[i])) {
+        continue;
+      }
       if (is_sequential) {
-        IndexTable(references_names[i], metric, metric_args, leaf_size);
+        if (tree=="covertree") {
+          MakeCoverTreeTable(references_names[i]);
+        }
+        IndexTable(references_names[i], metric, metric_args, leaf_size,
+            n_threads, split);
       } else {
         std::string new_variable=GiveTempVarName();
         MakeTableCopy(references_names[i], new_variable);
-        IndexTable(new_variable, metric, metric_args, leaf_size);
+        if (tree=="covertree") {
+          MakeCoverTreeTable(new_variable);
+        }
+        IndexTable(new_variable, metric, metric_args, leaf_size, n_threads,
+            split);
       }
     }
     for(size_t i=0; i<queries_names.size(); ++i) {
       if (is_sequential) {
-        IndexTable(queries_names[i], metric, metric_args, leaf_size);
+        if (tree=="covertree") {
+          MakeCoverTreeTable(queries_names[i]);
+        }
+        IndexTable(queries_names[i], metric, metric_args, leaf_size,
+            n_threads, split);
       } else {
         std::string new_variable=GiveTempVarName();
         MakeTableCopy(queries_names[i], new_variable);
-        IndexTable(new_variable, metric, metric_args, leaf_size);
+        if (tree=="covertree") {
+          MakeCoverTreeTable(new_variable);
+        }
+        IndexTable(new_variable, metric, metric_args, leaf_size, n_threads,
+            split);
       }
     }
   }
@@ -252,6 +321,43 @@ namespace fl { namespace ws {
     boost::mpl::for_each<DataTables_t>(CopyMeta(this, &success,
             source_table, dest_table));
   }
+
+  void WorkSpace::MakeCoverTreeTable(const std::string &variable) {
+    try {
+      TryToAttach<fl::table::dense::labeled::covertree::Table>(variable);
+      return;
+    }
+    catch(const fl::TypeException &e) {
+    }
+    try {
+      TryToAttach<fl::table::dense::labeled::kdtree::Table>(variable);
+    }
+    catch(const fl::TypeException &e) {
+      fl::logger->Die()<<"Table ("<<variable<<") is not dense, "
+        "--tree=covertree needs dense tables";
+    }
+    boost::shared_ptr<fl::table::dense::labeled::kdtree::Table> table;
+    Attach(variable, &table);
+    boost::shared_ptr<fl::table::dense::labeled::covertree::Table> cover_table(
+        new fl::table::dense::labeled::covertree::Table());
+    cover_table->Init(variable, 
+        table->dense_sizes(), 
+        table->sparse_sizes(),
+        table->n_entries());
+    cover_table->labels()=table->labels();
+    fl::table::dense::labeled::kdtree::Table::Point_t point;
+    fl::table::dense::labeled::covertree::Table::Point_t cover_point;
+    for(index_t i=0; i<table->n_entries(); ++i) {
+      table->get(i, &point);
+      cover_table->get(i, &cover_point);
+      // the tables are both dense but their points are of different types
+      cover_point.dense_point<double>().CopyValues(point.dense_point<double>());
+      cover_point.meta_data()=point.meta_data();
+    }
+    LoadTable(variable, cover_table);
+    fl::logger->Message()<<"Moved table ("<<variable
+      <<") to a cover tree table"<<std::endl;
+  }
   
 
   void WorkSpace::ExportAllTablesTask(
@@ -336,27 +442,28 @@ namespace fl { namespace ws {
 
   void WorkSpace::ExportAllTables(
       const std::vector<std::string> args) {
-    this->schedule(boost::bind(&WorkSpace::ExportAllTablesTask, this, args));
+    // the export reads the tables that the other tasks write
+    std::vector<std::string> inputs;
+    std::vector<std::string> outputs;
+    GetTaskTables(args, &inputs, &outputs);
+    this->schedule(boost::bind(&WorkSpace::ExportAllTablesTask, this, args),
+        outputs, std::vector<std::string>());
   }
 
   void WorkSpace::RemoveTable(const std::string &table_name) {
-    boost::mutex* mutex;
-    global_mutex_.lock();
-    if (mutex_map_.count(table_name)==0) {
+    boost::shared_ptr<TableLock> table_lock=FindTableLock(table_name);
+    if (table_lock.get()==NULL) {
       fl::logger->Warning()<<"Attempt to remove non-existent table ("
        <<table_name<<") from workspace (" 
        <<workspace_name_
        <<")"
        <<std::endl;
       return;
-    } else {
-      mutex=mutex_map_[table_name].get();
-    }
-    mutex->try_lock();
+    } 
+    boost::unique_lock<TableLock> lock(*table_lock);
+    boost::unique_lock<boost::shared_mutex> global_lock(global_mutex_);
     var_map_.erase(table_name);
-    mutex->unlock();
-    mutex_map_.erase(table_name);
-    global_mutex_.unlock(); 
+    table_locks_.erase(table_name);
   }
 
   void WorkSpace::ExportFileSequence(
@@ -499,44 +606,36 @@ namespace fl { namespace ws {
   void WorkSpace::IndexTable(const std::string &variable, 
         const std::string &metric,
         const std::string &metric_args,
-        const int leaf_size) {
-    boost::mutex* mutex;
-    global_mutex_.lock();
-    bool is_name_in_map=mutex_map_.count(variable)==0;
-    global_mutex_.unlock();
-    if (is_name_in_map) {
-      mutex=new boost::mutex();
-      global_mutex_.lock();
-      mutex_map_[variable].reset(mutex);
-      global_mutex_.unlock();
-      mutex->lock();
-    } else {
-      global_mutex_.lock();
-      mutex=mutex_map_[variable].get();
-      global_mutex_.unlock();
-    }
-    
-    mutex->lock();
-    bool success=false;
-    boost::mpl::for_each<DataTables_t>(IndexMeta(this,
-            &var_map_, 
-            variable,
-            metric,
-            metric_args,
-            leaf_size,
-            &success));
-    if (use_paging_) {
-      SerializeToDisk(variable); 
-    }
-    success=false;
-    boost::mpl::for_each<DataTables_t>(
-        ClearTableNameMeta(variable, var_map_, &success)); 
-    if (success==false) {
-      boost::mpl::for_each<ParameterTables_t>(
-        ClearTableNameMeta(variable, var_map_, &success));
+        const int leaf_size,
+        const int n_threads,
+        const std::string &split) {
+    boost::shared_ptr<TableLock> table_lock=GetTableLock(variable);
+    table_lock->WaitAndMarkBusy();
+    {
+      boost::unique_lock<TableLock> lock(*table_lock);
+      boost::any *table=FindTable(variable);
+      bool success=false;
+      boost::mpl::for_each<DataTables_t>(IndexMeta(this,
+              table, 
+              variable,
+              metric,
+              metric_args,
+              leaf_size,
+              n_threads,
+              split,
+              &success));
+      if (use_paging_) {
+        SerializeToDisk(variable, *table); 
+      }
+      success=false;
+      boost::mpl::for_each<DataTables_t>(
+          ClearTableNameMeta(table, &success)); 
+      if (success==false) {
+        boost::mpl::for_each<ParameterTables_t>(
+          ClearTableNameMeta(table, &success));
+      }
     }
-
-    mutex->unlock();
+    table_lock->MarkReady();
   }
 
   template<typename TableType>
@@ -546,11 +645,10 @@ namespace fl { namespace ws {
     }
     boost::shared_ptr<TableType> table;
     try {
-      table=boost::any_cast<boost::shared_ptr<TableType> >(
-          var_map_->operator[](variable_));
+      table=boost::any_cast<boost::shared_ptr<TableType> >(*table_);
       if (ws_->use_paging()) {
         ws_->SerializeFromDisk(variable_, &table); 
-          (*var_map_)[variable_]=table;
+        *table_=table;
       }
 
       *success_=true;
@@ -566,6 +664,8 @@ namespace fl { namespace ws {
     if (metric_=="l2") {
       typename TableType::template IndexArgs<fl::math::LMetric<2> > index_args;
       index_args.leaf_size = leaf_size_;
+      index_args.n_threads = n_threads_;
+      index_args.split = split_;
       if (table->is_indexed()==false) {
         table->IndexData(index_args);
       }
@@ -579,6 +679,8 @@ namespace fl { namespace ws {
         metric_weights->get(0, &weight_point);
         w_index_args.metric.set_weights(weight_point.template dense_point<double>());
         w_index_args.leaf_size = leaf_size_;
+        w_index_args.n_threads = n_threads_;
+        w_index_args.split = split_;
         if (table->is_indexed()==false) {
           table->IndexData(w_index_args);
         }
@@ -590,6 +692,124 @@ namespace fl { namespace ws {
     table->LogTreeStats();
   }
 
+  void WorkSpace::InsertIntoTable(const std::string &variable,
+        const std::string &points_variable,
+        const std::string &metric,
+        const std::string &metric_args) {
+    if (variable==points_variable) {
+      fl::logger->Die()<<"You cannot insert table ("<<variable
+        <<") in itself";
+    }
+    const std::vector<index_t> ids;
+    boost::shared_ptr<TableLock> table_lock=GetTableLock(variable);
+    table_lock->WaitAndMarkBusy();
+    {
+      boost::unique_lock<TableLock> lock(*table_lock);
+      boost::any *table=FindTable(variable);
+      bool success=false;
+      boost::mpl::for_each<DataTables_t>(UpdateMeta(this,
+              table, 
+              variable,
+              points_variable,
+              ids,
+              metric,
+              metric_args,
+              &success));
+      if (success==false) {
+        fl::logger->Die()<<"Table ("<<variable<<") cannot be updated";
+      }
+      if (use_paging_) {
+        SerializeToDisk(variable, *table); 
+      }
+    }
+    table_lock->MarkReady();
+  }
+
+  void WorkSpace::DeleteFromTable(const std::string &variable,
+        const std::vector<index_t> &ids,
+        const std::string &metric,
+        const std::string &metric_args) {
+    const std::string points_variable;
+    boost::shared_ptr<TableLock> table_lock=GetTableLock(variable);
+    table_lock->WaitAndMarkBusy();
+    {
+      boost::unique_lock<TableLock> lock(*table_lock);
+      boost::any *table=FindTable(variable);
+      bool success=false;
+      boost::mpl::for_each<DataTables_t>(UpdateMeta(this,
+              table, 
+              variable,
+              points_variable,
+              ids,
+              metric,
+              metric_args,
+              &success));
+      if (success==false) {
+        fl::logger->Die()<<"Table ("<<variable<<") cannot be updated";
+      }
+      if (use_paging_) {
+        SerializeToDisk(variable, *table); 
+      }
+    }
+    table_lock->MarkReady();
+  }
+
+  template<typename TableType>
+  void WorkSpace::UpdateMeta::operator()(TableType&) {
+    if (*success_==true) {
+      return;
+    }
+    boost::shared_ptr<TableType> table;
+    try {
+      table=boost::any_cast<boost::shared_ptr<TableType> >(*table_);
+      if (ws_->use_paging()) {
+        ws_->SerializeFromDisk(variable_, &table); 
+        *table_=table;
+      }
+      *success_=true;
+    }
+    catch(const boost::bad_any_cast &e) {
+      return; 
+    }
+    if (table->is_indexed()==false) {
+      fl::logger->Die()<<"Table ("<<variable_
+        <<") is not indexed, index it before updating it";
+    }
+    if (metric_=="l2") {
+      typename TableType::template IndexArgs<fl::math::LMetric<2> > index_args;
+      Update_(table.get(), index_args);
+    } else {
+      if (metric_=="weighted_l2") {
+        typename TableType::template IndexArgs<fl::math::WeightedLMetric < 2,
+        fl::data::MonolithicPoint<double> > > w_index_args;
+        typename DefaultTable_t::Point_t weight_point;
+        boost::shared_ptr<DefaultTable_t> metric_weights;
+        ws_->Attach(metric_args_, &metric_weights);
+        metric_weights->get(0, &weight_point);
+        w_index_args.metric.set_weights(weight_point.template dense_point<double>());
+        Update_(table.get(), w_index_args);
+      } else {
+        fl::logger->Die() << "Unknown metric ("<<metric_<<")";     
+      }
+    }
+  }
+
+  template<typename TableType, typename IndexArgsType>
+  void WorkSpace::UpdateMeta::Update_(TableType *table, 
+      IndexArgsType &args) {
+    if (points_variable_.empty()) {
+      table->DeleteData(ids_, args);
+      fl::logger->Message()<<"Deleted "<<ids_.size()<<" points from table: "
+        <<variable_<<std::endl;
+    } else {
+      boost::shared_ptr<TableType> points;
+      ws_->Attach(points_variable_, &points);
+      table->InsertData(*points, args);
+      fl::logger->Message()<<"Inserted "<<points->n_entries()
+        <<" points in table: "<<variable_<<std::endl;
+    }
+  }
+
   WorkSpace::CopyMeta::CopyMeta(WorkSpace * const ws,
      bool *success,
      const std::string &source, const std::string &dest) :
@@ -616,13 +836,8 @@ namespace fl { namespace ws {
   }
 
   void WorkSpace::ExportToFile(const std::string &name, const std::string &filename) {
-    boost::mutex* mutex;
-    bool is_name_in_map;
-    {
-      boost::mutex::scoped_lock lock(global_mutex_);
-      is_name_in_map=(mutex_map_.count(name)!=0);
-    }
-    if (schedule_mode_==2 && is_name_in_map==false) {
+    boost::shared_ptr<TableLock> table_lock=FindTableLock(name);
+    if (schedule_mode_==2 && table_lock.get()==NULL) {
       fl::logger->Warning()<<"table ("
         <<name
         <<") was not generated at all by your program "
@@ -631,33 +846,25 @@ namespace fl { namespace ws {
         <<")"<<std::endl;
       return;
     }
-    if (is_name_in_map==false) {
-      mutex=new boost::mutex();
-      boost::mutex::scoped_lock lock(global_mutex_);
-      mutex_map_[name].reset(mutex);
-      mutex->lock();
-    } else {
-      boost::mutex::scoped_lock lock(global_mutex_);
-      mutex=mutex_map_[name].get();
+    if (table_lock.get()==NULL) {
+      table_lock=GetTableLock(name);
     }
-    if (schedule_mode_==2) {
-      if (mutex->try_lock()==false) {
-        fl::logger->Warning()<<"something happened and table ("
-          <<name
-          <<") was not generated properly by your program "
-          <<"skiping export to filename ("
-          <<filename
-          <<")"<<std::endl;
-       return;
-      } else {
-        mutex->unlock();
-      }
+    if (schedule_mode_==2 && table_lock->IsReady()==false) {
+      fl::logger->Warning()<<"something happened and table ("
+        <<name
+        <<") was not generated properly by your program "
+        <<"skiping export to filename ("
+        <<filename
+        <<")"<<std::endl;
+      return;
     }
-    boost::mutex::scoped_lock lock(*mutex);
+    table_lock->WaitUntilReady();
+    boost::unique_lock<TableLock> lock(*table_lock);
+    boost::any *table=FindTable(name);
     bool success=false;
-    boost::mpl::for_each<ParameterTables_t>(SaveMeta(this, &var_map_, 
+    boost::mpl::for_each<ParameterTables_t>(SaveMeta(this, table, 
           name, filename, &success));
-    boost::mpl::for_each<DataTables_t>(SaveMeta(this, &var_map_, 
+    boost::mpl::for_each<DataTables_t>(SaveMeta(this, table, 
           name, filename, &success));
     if (success==false) {
       fl::logger->Die()<<"Cannot save table ("<<name<<"), the table "
@@ -666,22 +873,56 @@ namespace fl { namespace ws {
   }
 
 
+  void WorkSpace::WaitUntilReady(TableLock *table_lock) {
+    if (schedule_mode_==3 && table_lock->IsReady()==false) {
+      task_graph_->HelpUntil(boost::bind(&TableLock::IsReady, table_lock));
+    }
+    table_lock->WaitUntilReady();
+  }
+
   bool WorkSpace::IsTableAvailable(const std::string &name) {
-    global_mutex_.lock();
-    bool is_name_in_map=mutex_map_.count(name)==0;
-    if (is_name_in_map) {
-      global_mutex_.unlock();
+    boost::shared_ptr<TableLock> table_lock=FindTableLock(name);
+    if (table_lock.get()==NULL) {
       return false;
-    } else {
-      boost::mutex* mutex;
-      mutex=mutex_map_[name].get();
-      global_mutex_.unlock();
-      bool lock_success=mutex->try_lock();
-      if (lock_success==true) {
-        mutex->unlock();
+    } 
+    return table_lock->IsReady();
+  }
+
+  boost::shared_ptr<TableLock> WorkSpace::GetTableLock(const std::string &name) {
+    {
+      boost::shared_lock<boost::shared_mutex> global_lock(global_mutex_);
+      std::map<std::string, boost::shared_ptr<TableLock> >::iterator 
+        it=table_locks_.find(name);
+      if (it!=table_locks_.end()) {
+        return it->second;
       }
-      return lock_success;
     }
+    boost::unique_lock<boost::shared_mutex> global_lock(global_mutex_);
+    boost::shared_ptr<TableLock> &table_lock=table_locks_[name];
+    if (table_lock.get()==NULL) {
+      table_lock.reset(new TableLock());
+    }
+    return table_lock;
+  }
+
+  boost::shared_ptr<TableLock> WorkSpace::FindTableLock(const std::string &name) {
+    boost::shared_lock<boost::shared_mutex> global_lock(global_mutex_);
+    std::map<std::string, boost::shared_ptr<TableLock> >::iterator 
+      it=table_locks_.find(name);
+    if (it==table_locks_.end()) {
+      return boost::shared_ptr<TableLock>();
+    }
+    return it->second;
+  }
+
+  boost::any *WorkSpace::FindTable(const std::string &name) {
+    boost::shared_lock<boost::shared_mutex> global_lock(global_mutex_);
+    std::map<std::string, boost::any>::iterator it=var_map_.find(name);
+    if (it==var_map_.end()) {
+      fl::logger->Die()<<"Detected unsafe deletion of table ("
+        <<name<<")";
+    }
+    return &(it->second);
   }
 
   template<typename TableType>
@@ -690,20 +931,20 @@ namespace fl { namespace ws {
       return;
     }
     try {
-      if (boost::any_cast<boost::shared_ptr<TableType> >((*var_map_)[name_]).get()==NULL) {
+      if (boost::any_cast<boost::shared_ptr<TableType> >(*table_).get()==NULL) {
         boost::shared_ptr<TableType> table;
         if (ws_->use_paging()) {
           ws_->SerializeFromDisk(name_, &table); 
-          (*var_map_)[name_]=table;
+          *table_=table;
         } else {
           fl::logger->Die() << "You are trying to attach a table ("<<name_
               << ") that somehow has been deleted, please report this bug";
 
         }
       }
-      boost::any_cast<boost::shared_ptr<TableType> >((*var_map_)[name_])->filename()=filename_;
-      boost::any_cast<boost::shared_ptr<TableType> >((*var_map_)[name_])->Save();
-      (*var_map_)[name_]=boost::shared_ptr<TableType>();
+      boost::any_cast<boost::shared_ptr<TableType> >(*table_)->filename()=filename_;
+      boost::any_cast<boost::shared_ptr<TableType> >(*table_)->Save();
+      *table_=boost::shared_ptr<TableType>();
       *success_=true;
     }
     catch(const boost::bad_any_cast &e) {
@@ -711,6 +952,88 @@ namespace fl { namespace ws {
     }
   }
 
+  void WorkSpace::RegisterStream(const std::string &name,
+      const std::string &filename) {
+    FL_SCOPED_LOG(RegisterStream);
+    TableInfo info;
+    boost::any table;
+    bool success=false;
+    boost::shared_ptr<TableLock> table_lock=GetTableLock(name);
+    boost::mpl::for_each<DataTables_t>(StreamMeta(name, filename,  
+          &table, &info, &success));
+    if (success==false) {
+      fl::logger->Die()<< "Failed to stream "<< filename<<" unsupported type";
+    }
+    {
+      boost::unique_lock<boost::shared_mutex> global_lock(global_mutex_);
+      var_map_[name]=table;
+      streams_[name]=filename;
+      table_info_[name]=info;
+    }
+    table_lock->MarkReady();
+  }
+
+  void WorkSpace::LoadStreamedTable(const std::string &name) {
+    // this is called on every attachment, so the common case 
+    // takes the map lock shared
+    if (IsStreamed(name)==false) {
+      return;
+    }
+    std::string filename;
+    {
+      boost::unique_lock<boost::shared_mutex> global_lock(global_mutex_);
+      std::map<std::string, std::string>::iterator it=streams_.find(name);
+      if (it==streams_.end()) {
+        return;
+      }
+      filename=it->second;
+      streams_.erase(it);
+      table_info_.erase(name);
+    }
+    fl::logger->Warning()<<"Table ("<<name<<") was registered as a stream "
+      "but it is attached as a whole, it will be loaded in memory";
+    LoadDataTableFromFile(name, filename);
+  }
+
+  index_t WorkSpace::CountStreamedEntries(const std::string &name) {
+    FL_SCOPED_LOG(CountStreamedEntries);
+    std::string filename;
+    boost::any table;
+    {
+      boost::shared_lock<boost::shared_mutex> global_lock(global_mutex_);
+      std::map<std::string, std::string>::const_iterator 
+        it=streams_.find(name);
+      std::map<std::string, boost::any>::const_iterator 
+        table_it=var_map_.find(name);
+      if (it==streams_.end() || table_it==var_map_.end()) {
+        return -1;
+      }
+      filename=it->second;
+      table=table_it->second;
+    }
+    index_t n_entries=-1;
+    bool success=false;
+    boost::mpl::for_each<DataTables_t>(CountStreamMeta(filename, table,
+          stream_block_size_>0 ? stream_block_size_ : (64<<20), 
+          &n_entries, &success));
+    if (success==false) {
+      fl::logger->Die()<<"Failed to count the points of ("<<name<<")";
+    }
+    {
+      boost::unique_lock<boost::shared_mutex> global_lock(global_mutex_);
+      std::map<std::string, TableInfo>::iterator it=table_info_.find(name);
+      if (it!=table_info_.end()) {
+        it->second.n_entries=n_entries;
+      }
+    }
+    return n_entries;
+  }
+
+  bool WorkSpace::IsStreamed(const std::string &name) {
+    boost::shared_lock<boost::shared_mutex> global_lock(global_mutex_);
+    return streams_.count(name)!=0;
+  }
+
   void WorkSpace::LoadDataTableFromFile(const std::string &name,
       const std::string &filename) {
     LoadFromFile<DataTables_t>(name, filename);
@@ -738,9 +1061,9 @@ namespace fl { namespace ws {
     }
     try {
       boost::shared_ptr<TableType> dummy;
-      dummy=boost::any_cast<boost::shared_ptr<TableType> >(var_map_[table_]);
+      dummy=boost::any_cast<boost::shared_ptr<TableType> >(*table_);
       boost::shared_ptr<TableType> dummy1;
-      var_map_[table_]=dummy1;
+      *table_=dummy1;
       *success_=true;
     }
     catch(const boost::bad_any_cast &e) {
@@ -756,41 +1079,44 @@ namespace fl { namespace ws {
       bool force_save) {
     FL_SCOPED_LOG(Workspace);
     FL_SCOPED_LOG(Purge);
-    global_mutex_.lock();
-    if (mutex_map_.count(table_name)==0) {
-      global_mutex_.unlock();
+    boost::shared_ptr<TableLock> table_lock=FindTableLock(table_name);
+    if (table_lock.get()==NULL) {
       fl::logger->Die() << "Variable ("<<table_name<<")"
         << "does not exist, detachment failed";
     }
-    // if the table is in read mode then it is already unlocked 
-    // we do a try_lock 
-    mutex_map_[table_name]->try_lock();
-    // if it was in write mode then it is locked. If it was in read mode
-    // it will be locked after the try_lock
-    GetTableInfo(table_name,
-        &(table_info_[table_name].n_entries), 
-        &(table_info_[table_name].n_attributes),
-        &(table_info_[table_name].dense_sizes),
-        &(table_info_[table_name].sparse_sizes)); 
-    
-    if (IsInTempDir(table_name)==false || force_save==true) {
-      if (use_paging_) {
-        SerializeToDisk(table_name); 
-      }
+    // streamed tables are never in memory
+    if (IsStreamed(table_name)) {
+      return;
     }
+    {
+      // readers are done with the entry when they get the table, 
+      // so the exclusive lock only waits for attachments in progress
+      boost::unique_lock<TableLock> lock(*table_lock);
+      boost::any *table=FindTable(table_name);
+      TableInfo info;
+      GetTableInfo(table_name, *table, &info);
+      {
+        boost::unique_lock<boost::shared_mutex> global_lock(global_mutex_);
+        table_info_[table_name]=info;
+      }
+      if (IsInTempDir(table_name)==false || force_save==true) {
+        if (use_paging_) {
+          SerializeToDisk(table_name, *table); 
+        }
+      }
 
-    bool success=false;
-    boost::mpl::for_each<DataTables_t>(
-        ClearTableNameMeta(table_name, var_map_, &success)); 
-    if (success==false) {
-      boost::mpl::for_each<ParameterTables_t>(
-        ClearTableNameMeta(table_name, var_map_, &success));
-    }
-    if (success==false) {
-      fl::logger->Die()<<"Failed to Purge ("<<table_name<<")";
+      bool success=false;
+      boost::mpl::for_each<DataTables_t>(
+          ClearTableNameMeta(table, &success)); 
+      if (success==false) {
+        boost::mpl::for_each<ParameterTables_t>(
+          ClearTableNameMeta(table, &success));
+      }
+      if (success==false) {
+        fl::logger->Die()<<"Failed to Purge ("<<table_name<<")";
+      }
     }
-    mutex_map_[table_name]->unlock();
-    global_mutex_.unlock();
+    table_lock->MarkReady();
     fl::logger->Debug()<<"Table ("<<table_name<<") purged";
   }
 
@@ -798,14 +1124,14 @@ namespace fl { namespace ws {
     class Do {
       public:
         Do(WorkSpace *ws,
-            std::map<std::string, boost::any> &var_map,
+            const boost::any &table,
             const std::string &table_name,
             index_t *n_entries,
             index_t *n_attributes,
             std::vector<index_t> *dense_sizes,
             std::vector<index_t> *sparse_sizes,
             bool *success) :
-          ws_(ws), var_map_(var_map),table_name_(table_name), n_entries_(n_entries),
+          ws_(ws), table_(table),table_name_(table_name), n_entries_(n_entries),
           n_attributes_(n_attributes), dense_sizes_(dense_sizes),
           sparse_sizes_(sparse_sizes), success_(success) {
         }
@@ -816,7 +1142,7 @@ namespace fl { namespace ws {
           }
           boost::shared_ptr<TableType> table;
           try {
-            table=boost::any_cast<boost::shared_ptr<TableType> >(var_map_[table_name_]);
+            table=boost::any_cast<boost::shared_ptr<TableType> >(table_);
             *success_=true;
             if (n_entries_!=NULL) {
               *n_entries_=table->n_entries();
@@ -840,7 +1166,7 @@ namespace fl { namespace ws {
         }
       private:
         WorkSpace *ws_;
-        std::map<std::string, boost::any> &var_map_;
+        const boost::any &table_;
         const std::string &table_name_;
         index_t *n_entries_;
         index_t *n_attributes_;
@@ -855,39 +1181,66 @@ namespace fl { namespace ws {
         std::vector<index_t> *dense_sizes,
         std::vector<index_t> *sparse_sizes) {
     FL_SCOPED_LOG(GetTableInfo);
-    if (table_info_[table_name].n_entries>0) {
-      if (n_entries!=NULL) {
-          *n_entries=table_info_[table_name].n_entries;
-      }
-      if (n_attributes!=NULL) {
-        *n_attributes=table_info_[table_name].n_attributes;
+    TableInfo info;
+    bool is_cached=false;
+    {
+      // the number of points of a streamed table is counted
+      // the first time it is asked for
+      boost::shared_lock<boost::shared_mutex> global_lock(global_mutex_);
+      std::map<std::string, TableInfo>::const_iterator 
+        it=table_info_.find(table_name);
+      if (it!=table_info_.end() && (it->second.n_entries>0 
+            || streams_.count(table_name)!=0)) {
+        info=it->second;
+        is_cached=true;
       }
-      if (dense_sizes!=NULL) {
-        *dense_sizes=table_info_[table_name].dense_sizes;
+    }
+    if (is_cached==false) {
+      boost::shared_ptr<TableLock> table_lock=FindTableLock(table_name);
+      if (table_lock.get()==NULL) {
+        fl::logger->Die()<<"Table ("<<table_name<<") does not exist";
       }
-      if (sparse_sizes!=NULL) {
-         *sparse_sizes=table_info_[table_name].sparse_sizes;
-      }       
-      return;
+      boost::shared_lock<TableLock> lock(*table_lock);
+      GetTableInfo(table_name, *FindTable(table_name), &info);
+    }
+    if (n_entries!=NULL && info.n_entries<0 && is_cached==true) {
+      info.n_entries=CountStreamedEntries(table_name);
     }
+    if (n_entries!=NULL) {
+      *n_entries=info.n_entries;
+    }
+    if (n_attributes!=NULL) {
+      *n_attributes=info.n_attributes;
+    }
+    if (dense_sizes!=NULL) {
+      *dense_sizes=info.dense_sizes;
+    }
+    if (sparse_sizes!=NULL) {
+      *sparse_sizes=info.sparse_sizes;
+    }       
+  }
+
+  void WorkSpace::GetTableInfo(const std::string &table_name,
+      const boost::any &table,
+      TableInfo *info) {
     bool success=false;
     boost::mpl::for_each<DataTables_t>(
         WorkSpace_GetTableInfo::Do(this,
-          var_map_,
+          table,
           table_name,
-          n_entries,
-          n_attributes,
-          dense_sizes,
-          sparse_sizes,
+          &info->n_entries,
+          &info->n_attributes,
+          &info->dense_sizes,
+          &info->sparse_sizes,
           &success));
     boost::mpl::for_each<ParameterTables_t>(
         WorkSpace_GetTableInfo::Do(this,
-          var_map_,
+          table,
           table_name,
-          n_entries,
-          n_attributes,
-          dense_sizes,
-          sparse_sizes,
+          &info->n_entries,
+          &info->n_attributes,
+          &info->dense_sizes,
+          &info->sparse_sizes,
           &success)
         ); 
     if (success==false) {
@@ -902,6 +1255,11 @@ namespace fl { namespace ws {
     if(schedule_mode == 0) {
        pool_.reset(new boost::threadpool::pool(2));
     }
+    if (schedule_mode==3) {
+      task_graph_.reset(new TaskGraph());
+      task_graph_->Init(2, 
+          boost::bind(&WorkSpace::IsTableAvailable, this, _1));
+    }
   }
 
   void WorkSpace::set_paging_mode(int paging_mode) {
@@ -911,6 +1269,22 @@ namespace fl { namespace ws {
   }
 
 
+  void WorkSpace::set_spill_codec(const std::string &codec) {
+    if (codec!="binary" && codec!="archive" && codec!="gzip") {
+      fl::logger->Die()<<"Unknown spill codec ("<<codec<<"), "
+        "the options are binary, archive, gzip";
+    }
+    spill_codec_=codec;
+  }
+
+  void WorkSpace::set_stream_mode(index_t block_size, int window) {
+    if (window<1) {
+      fl::logger->Die()<<"A stream needs a window of at least one block";
+    }
+    stream_block_size_=block_size;
+    stream_window_=window;
+  }
+
   bool WorkSpace::is_mode_sequential() const {
     if (schedule_mode_==2) {
       return true;
@@ -926,6 +1300,10 @@ namespace fl { namespace ws {
     if (schedule_mode_==0) {
       pool_.reset(new boost::threadpool::pool(n_threads));
     }
+    if (schedule_mode_==3) {
+      task_graph_->Init(n_threads, 
+          boost::bind(&WorkSpace::IsTableAvailable, this, _1));
+    }
   }
 
   void WorkSpace::set_temp_directory(const std::string &directory) {
@@ -955,6 +1333,10 @@ namespace fl { namespace ws {
 
   void WorkSpace::CancelAllTasks() {
     boost::mutex::scoped_lock lock(schedule_mutex_);
+    if (schedule_mode_==3) {
+      task_graph_->Clear();
+      return;
+    }
     if (schedule_mode_==0) {
       pool_->clear();
     } else {
@@ -970,6 +1352,10 @@ namespace fl { namespace ws {
   }
 
   void WorkSpace::WaitAllTasks() {
+    if (schedule_mode_==3) {
+      task_graph_->Wait();
+      return;
+    }
     if (schedule_mode_==0) {
       while(true) {
         //boost::this_thread::sleep(boost::posix_time::milliseconds(1000));
@@ -1058,17 +1444,77 @@ namespace fl { namespace ws {
   }
 
   void WorkSpace::MakeACopy(WorkSpace *ws) {
-    global_mutex_.lock();
+    boost::shared_lock<boost::shared_mutex> global_lock(global_mutex_);
     ws->temp_var_prefix_=this->temp_var_prefix_;
     ws->temp_var_counter_=this->temp_var_counter_;
     ws->workspace_name_=this->workspace_name_;
-    ws->mutex_map_=this->mutex_map_;
-    std::map<std::string, boost::shared_ptr<boost::mutex> >::iterator it;
+    ws->table_locks_=this->table_locks_;
     ws->var_map_=this->var_map_;
-    global_mutex_.unlock();
   } 
 
   void WorkSpace::schedule(boost::threadpool::task_func const & task) {
+    schedule(task, std::vector<std::string>(), std::vector<std::string>());
+  }
+
+  void WorkSpace::schedule(boost::threadpool::task_func const &task,
+      const std::vector<std::string> &args) {
+    std::vector<std::string> inputs;
+    std::vector<std::string> outputs;
+    GetTaskTables(args, &inputs, &outputs);
+    schedule(task, inputs, outputs);
+  }
+
+  void WorkSpace::GetTaskTables(const std::vector<std::string> &args,
+      std::vector<std::string> *inputs,
+      std::vector<std::string> *outputs) {
+    for(unsigned int i=0; i<args.size(); ++i) {
+      if (boost::algorithm::starts_with(args[i], "--")==false) {
+        continue;
+      }
+      std::vector<std::string> tokens;
+      boost::algorithm::split(tokens, args[i],
+          boost::algorithm::is_any_of("="));
+      if (tokens.size()<2 || tokens[1].empty()) {
+        continue;
+      }
+      std::vector<std::string> *tables;
+      if (fl::StringEndsWith(tokens[0], "_in")) {
+        tables=inputs;
+      } else {
+        if (fl::StringEndsWith(tokens[0], "_out")) {
+          tables=outputs;
+        } else {
+          continue;
+        }
+      }
+      // file sequences are named after the task runs
+      if (fl::StringEndsWith(tokens[0], "_prefix_in") 
+          || fl::StringEndsWith(tokens[0], "_num_in")
+          || fl::StringEndsWith(tokens[0], "_prefix_out") 
+          || fl::StringEndsWith(tokens[0], "_num_out")) {
+        continue;
+      }
+      std::vector<std::string> names;
+      boost::algorithm::trim_right_if(tokens[1], 
+          boost::algorithm::is_any_of(":,"));
+      boost::algorithm::split(names, tokens[1], 
+          boost::algorithm::is_any_of(":,"));
+      tables->insert(tables->end(), names.begin(), names.end());
+    }
+  }
+
+  void WorkSpace::schedule(boost::threadpool::task_func const &task,
+      const std::vector<std::string> &inputs,
+      const std::vector<std::string> &outputs) {
+    if (schedule_mode_==3) {
+      boost::mutex::scoped_lock lock(*global_exception_mutex);
+      if (fl::global_exception) {
+        return;
+      }
+      lock.unlock();
+      task_graph_->Submit(task, inputs, outputs);
+      return;
+    }
     if (schedule_mode_!=2) {
       schedule_mutex_.lock();
     }
@@ -1129,7 +1575,7 @@ namespace fl { namespace ws {
     }
     try {
       boost::shared_ptr<TableType> table;
-      table=boost::any_cast<boost::shared_ptr<TableType> >(var_map_[name_]);
+      table=boost::any_cast<boost::shared_ptr<TableType> >(table_);
       oa_<<*table;
       *success_=true;
     }
@@ -1139,40 +1585,73 @@ namespace fl { namespace ws {
   }
 
 
-  void WorkSpace::SerializeToDisk(const std::string &table_name) {
+  template<typename TableType>
+  void WorkSpace::SaveBinaryMeta::operator()(TableType&) {
+    if (*success_==true) {
+      return;
+    }
+    try {
+      boost::shared_ptr<TableType> table;
+      table=boost::any_cast<boost::shared_ptr<TableType> >(table_);
+      table->SaveBinary(filename_);
+      *success_=true;
+    }
+    catch(const boost::bad_any_cast &e) {
+      
+    }
+  }
+
+  void WorkSpace::SerializeToDisk(const std::string &table_name,
+      const boost::any &table) {
     FL_SCOPED_LOG(Workspace);
     boost::filesystem::path to_be_saved=FromTableNameToPath(table_name);
-    std::ofstream ofs(to_be_saved.string().c_str(),
-        std::ios::out|std::ios::binary);
-    if (ofs.good()==false) {
-      fl::logger->Die()<<"Cannot open file ("
-        <<to_be_saved.string()
-        <<") for saving table"; 
-    }    
-    boost::iostreams::filtering_streambuf<boost::iostreams::output> out;
-    out.push(boost::iostreams::gzip_compressor());
-    out.push(ofs);
-    boost::archive::binary_oarchive oa(out);
+    // the table is written next to the old file and replaces it when
+    // it is complete, a table that is still mapped from the old file
+    // keeps its pages 
+    boost::filesystem::path partial(to_be_saved.string()+".part");
     bool success=false;
-    boost::mpl::for_each<DataTables_t>(
-        SerializeToDiskMeta(
-          this,
-          table_name,  
-          var_map_,
-          oa,  &success));
-    if (success==false) {
-      boost::mpl::for_each<ParameterTables_t>(
+    if (spill_codec_=="binary") {
+      boost::mpl::for_each<DataTables_t>(
+          SaveBinaryMeta(partial.string(), table, &success));
+      if (success==false) {
+        boost::mpl::for_each<ParameterTables_t>(
+            SaveBinaryMeta(partial.string(), table, &success));
+      }
+    } else {
+      std::ofstream ofs(partial.string().c_str(),
+          std::ios::out|std::ios::binary);
+      if (ofs.good()==false) {
+        fl::logger->Die()<<"Cannot open file ("
+          <<partial.string()
+          <<") for saving table"; 
+      }    
+      boost::iostreams::filtering_streambuf<boost::iostreams::output> out;
+      if (spill_codec_=="gzip") {
+        out.push(boost::iostreams::gzip_compressor());
+      }
+      out.push(ofs);
+      boost::archive::binary_oarchive oa(out);
+      boost::mpl::for_each<DataTables_t>(
           SerializeToDiskMeta(
-          this,
-          table_name,  
-          var_map_,
-          oa,  &success));
+            this,
+            table_name,  
+            table,
+            oa,  &success));
+      if (success==false) {
+        boost::mpl::for_each<ParameterTables_t>(
+            SerializeToDiskMeta(
+            this,
+            table_name,  
+            table,
+            oa,  &success));
+      }
     }
     if (success==false) {
+      boost::filesystem::remove(partial);
       fl::logger->Warning()<<"Unable to serialize table "<<table_name<<" to disk";
+      return;
     }
-    //oa << *table;
-
+    boost::filesystem::rename(partial, to_be_saved);
   }
 
 }}
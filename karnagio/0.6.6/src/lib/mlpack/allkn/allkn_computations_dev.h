@@ -25,24 +25,56 @@ POSSIBILITY OF SUCH DAMAGE.
 #ifndef FL_LITE_MLPACK_ALLKN_ALLKN_COMPUTATIONS_DEV_H_
 #define FL_LITE_MLPACK_ALLKN_ALLKN_COMPUTATIONS_DEV_H_
 #include "mlpack/allkn/allkn_computations.h"
+#include <algorithm>
+#include <cmath>
 #include <functional>
+#include <unordered_set>
+#include "boost/functional/hash.hpp"
+#include "boost/random/linear_congruential.hpp"
+#include "boost/random/uniform_int.hpp"
+#include "boost/random/variate_generator.hpp"
+#include "fastlib/metric_kernel/lmetric.h"
 //#include <omp.h>
 //#include <fastlib/omptl/omptl_algorithm>
 
 namespace fl {
 namespace ml {
-template < typename NeighborContainerType,
-typename DistanceContainerType,
-typename IndexContainerType >
-void ALLKNMPL::UpdateOperator1::type::InitTempNeighbors(
-  NeighborContainerType *neighbors,
-  index_t ind,
-  index_t offset,
-  DistanceContainerType &distances,
-  IndexContainerType &indices) {
-  neighbors->operator[](ind).first=distances[offset+ind],
-                                   neighbors->operator[](ind).second=indices[offset+ind];
-
+/**
+ * Ties are broken by the index, so the row is the same as sorting the
+ * old neighbors together with the new ones
+ */
+template < AllKNMode mode,
+typename Container1Type,
+typename Container2Type,
+typename CalcPrecisionType
+>
+void ALLKNMPL::UpdateOperator1::type::InsertSorted(Container1Type *indices,
+    Container2Type *distances,
+    index_t neighbor_position,
+    index_t kns,
+    index_t neighbor,
+    CalcPrecisionType distance) {
+  std::pair<CalcPrecisionType, index_t> candidate(distance, neighbor);
+  index_t position = neighbor_position + kns - 1;
+  std::pair<CalcPrecisionType, index_t> last(
+    distances->operator[](position), indices->operator[](position));
+  if ((mode == NearestNeighborAllKN && !(candidate < last)) ||
+      (mode == FurthestNeighborAllKN && !(last < candidate))) {
+    return;
+  }
+  while (position > neighbor_position) {
+    std::pair<CalcPrecisionType, index_t> previous(
+      distances->operator[](position - 1), indices->operator[](position - 1));
+    if ((mode == NearestNeighborAllKN && !(candidate < previous)) ||
+        (mode == FurthestNeighborAllKN && !(previous < candidate))) {
+      break;
+    }
+    distances->operator[](position) = previous.first;
+    indices->operator[](position) = previous.second;
+    --position;
+  }
+  distances->operator[](position) = distance;
+  indices->operator[](position) = neighbor;
 }
 
 template < typename Container1Type,
@@ -59,15 +91,17 @@ void ALLKNMPL::UpdateOperator1::type::Insert(Container1Type *indices,
   distances->operator[](neighbor_position+neighbor_rank) = distance;
 }
 
-template < typename NeighborContainerType,
-typename DistanceContainerType,
-typename IndexContainerType >
-void ALLKNMPL::UpdateOperator2::type::InitTempNeighbors(
-  NeighborContainerType *neighbors,
-  index_t ind,
-  index_t offset,
-  DistanceContainerType &distances,
-  IndexContainerType &indices) {
+template < AllKNMode mode,
+typename Container1Type,
+typename Container2Type,
+typename CalcPrecisionType
+>
+void ALLKNMPL::UpdateOperator2::type::InsertSorted(Container1Type *indices,
+    Container2Type *distances,
+    index_t neighbor_position,
+    index_t kns,
+    index_t neighbor,
+    CalcPrecisionType distance) {
 }
 
 template < typename Container1Type,
@@ -101,13 +135,26 @@ QueryBinaryReferenceBinary::ComputeDualNeighborsRecursion(ArgsType *args) {
   bool prune_or_not;
   CalcPrecision_t dist_so_far=
     args->stat()->at(args->query_table()->get_node_id(args->query_node())).dist_so_far();
+  // for approximate neighbors the bound is inflated, so that we also prune
+  // nodes that can improve the neighbors by less than (1+epsilon)
+  CalcPrecision_t prune_factor = 1;
+  index_t num_of_samples = 0;
+  if (args->info() != NULL && !IS_RANGE_NEIGHBORS) {
+    prune_factor = args->info()->prune_factor();
+  }
 
   if (mode == NearestNeighborAllKN) {
-    prune_or_not = args->bound_distance() > dist_so_far;
+    // the bound of the root is the maximum value, it must not overflow
+    prune_or_not = std::min(args->bound_distance() * prune_factor,
+                            std::numeric_limits<CalcPrecision_t>::max())
+                   > dist_so_far;
   }
   if (mode == FurthestNeighborAllKN) {
     prune_or_not =
-      args->bound_distance() < dist_so_far;
+      args->bound_distance() < dist_so_far * prune_factor;
+  }
+  if (!prune_or_not) {
+    num_of_samples = NumOfSamples(args);
   }
 
   if (prune_or_not) {
@@ -116,6 +163,10 @@ QueryBinaryReferenceBinary::ComputeDualNeighborsRecursion(ArgsType *args) {
       args->info()->num_of_prunes()++;
     }
   }
+  else if (num_of_samples > 0) {
+    // Rank approximation, a sample of the reference node is enough
+    ComputeDualSampledBaseCase(args, num_of_samples);
+  }
   else {
     if (args->query_table()->node_is_leaf(args->query_node()) &&
         args->reference_table()->node_is_leaf(args->reference_node())) {
@@ -411,8 +462,10 @@ void SingleThreadAllKNTraversal<TypeVector>::
 QueryBinaryReferenceBinary::ComputeAllSingleNeighborsRecursion(ArgsType *args) {
   static const bool IS_RANGE_NEIGHBORS = ArgsType::IS_RANGE_NEIGHBORS;
   if (args->query_table()->get_tree() != NULL) {
+    // the query node is the root, unless the query tree is split
+    // between threads
     typename QueryTable_t::TreeIterator it(*(args->query_table()),
-                                           args->query_table()->get_tree());
+                                           args->query_node());
     while (it.HasNext()) {
       if (mode == NearestNeighborAllKN && !IS_RANGE_NEIGHBORS) {
         args->dist_so_far() = std::numeric_limits<CalcPrecision_t>::max();
@@ -462,53 +515,20 @@ QueryBinaryReferenceBinary::ComputeSingleNeighborsRecursion(ArgsType *args) {
   // node->is_leaf() works as one would expect
   if (args->reference_table()->node_is_leaf(args->reference_node())) {
     // Base Case
-    index_t nearest_size;
-    if (Is1N == true) {
-      nearest_size = 1;
-    }
-    else {
-      nearest_size = static_cast<index_t>(args->kns());
-    }
     typename ReferenceTable_t::TreeIterator reference_it(
       *args->reference_table(),
       args->reference_node());
     ReferencePoint_t reference_point;
     index_t reference_index;
 
-    std::vector<std::pair<CalcPrecision_t, index_t> > neighbors;
     index_t ind;
     if (!IS_RANGE_NEIGHBORS) {
       if (Is1N == false) {
-        neighbors.resize(nearest_size + reference_it.count());
-        if (mode == NearestNeighborAllKN) {
-          std::fill(neighbors.begin(), neighbors.end(),
-                    std::make_pair(std::numeric_limits<CalcPrecision_t>::max(), -1));
-        }
-        else {
-          if (mode == FurthestNeighborAllKN) {
-            std::fill(neighbors.begin(), neighbors.end(),
-                      std::make_pair(-std::numeric_limits<CalcPrecision_t>::max(), -1));
-          }
-        }
         ind = args->query_point_id() * static_cast<index_t>(args->kns());
       }
       else {
         ind = args->query_point_id();
       }
-      if (Is1N == false && !IS_RANGE_NEIGHBORS) {
-        for (index_t i = 0; i < static_cast<index_t>(args->kns()); i++) {
-          boost::mpl::eval_if <
-          boost::mpl::bool_<IS_RANGE_NEIGHBORS>,
-          ALLKNMPL::UpdateOperator2,
-          ALLKNMPL::UpdateOperator1
-          >::type::InitTempNeighbors(
-            &neighbors,
-            i,
-            ind,
-            *(args->neighbor_distances()),
-            *(args->neighbor_indices()));
-        }
-      }
     }
     //#pragma omp parallel for firstprivate(args)
     for (index_t i = 0; i < reference_it.count(); i++) {
@@ -536,8 +556,7 @@ QueryBinaryReferenceBinary::ComputeSingleNeighborsRecursion(ArgsType *args) {
               distance > args->dist_so_far();
           }
           if (push_back_or_not) {
-            neighbors[nearest_size+i].first = distance;
-            neighbors[nearest_size+i].second = reference_index;
+            InsertNeighbor(args, ind, reference_index, distance);
           }
         }
         else {
@@ -582,48 +601,22 @@ QueryBinaryReferenceBinary::ComputeSingleNeighborsRecursion(ArgsType *args) {
       }
     } // for reference_index
     if (Is1N == false && !IS_RANGE_NEIGHBORS) {
-      if (mode == NearestNeighborAllKN) {
-        std::sort(neighbors.begin(), neighbors.end());
-        /* std::nth_element(neighbors.begin(),
-                         neighbors.begin()+static_cast<int>(args->kns())-1,
-                         neighbors.end());
-         */
-
-      }
-      if (mode == FurthestNeighborAllKN) {
-        std::sort(neighbors.begin(), neighbors.end(),
-                    std::greater<std::pair<CalcPrecision_t, index_t> >());
-
-        /* std::nth_element(neighbors.begin(),
-                         neighbors.begin()+static_cast<int>(args->kns())-1,
-                         neighbors.end(),
-                         std::greater<std::pair<CalcPrecision_t, index_t> >());
-        */
-      }
-      //#pragma omp parallel if (!IS_RANGE_NEIGHBORS) firstprivate(args)
-      {
-        //#pragma omp for
-        for (index_t i = 0; i < static_cast<index_t>(args->kns()); i++) {
-          index_t neighbor_id;
-          neighbor_id = ind;
-          boost::mpl::eval_if <
-          boost::mpl::bool_<IS_RANGE_NEIGHBORS>,
-          ALLKNMPL::UpdateOperator2,
-          ALLKNMPL::UpdateOperator1
-          >::type::Insert(args->neighbor_indices(),
-                          args->neighbor_distances(),
-                          neighbor_id,
-                          neighbors[i].second,
-                          i,
-                          neighbors[i].first);
-        }
-      }
       args->dist_so_far() = (*(args->neighbor_distances()))
                             [ind+static_cast<index_t>(args->kns())-1];
     }
     else {
     }
   } else {
+    index_t num_of_samples = NumOfSamples(args);
+    if (num_of_samples > 0) {
+      // Rank approximation, a sample of the reference node is enough
+      ComputeSingleSampledBaseCase(args, num_of_samples);
+      return;
+    }
+    CalcPrecision_t prune_factor = 1;
+    if (args->info() != NULL && !IS_RANGE_NEIGHBORS) {
+      prune_factor = args->info()->prune_factor();
+    }
     // We'll order the computation by distance
     ReferenceTree_t *left_node = args->reference_table()->get_node_left_child(
                                    args->reference_node());
@@ -662,14 +655,16 @@ QueryBinaryReferenceBinary::ComputeSingleNeighborsRecursion(ArgsType *args) {
       ComputeSingleNeighborsRecursion(args);
       bool prune_or_not = false;
       if (mode == NearestNeighborAllKN) {
-        prune_or_not = args->dist_so_far() < right_distance;
+        prune_or_not = args->dist_so_far() < right_distance * prune_factor;
       }
       if (mode == FurthestNeighborAllKN) {
-        prune_or_not = args->dist_so_far() > right_distance;
+        prune_or_not = args->dist_so_far() * prune_factor > right_distance;
       }
 
       if (prune_or_not) {
-        args->info()->num_of_prunes()++;
+        if (args->info() != NULL) {
+          args->info()->num_of_prunes()++;
+        }
         return;
       }
       args->reference_node() = right_node;
@@ -680,14 +675,16 @@ QueryBinaryReferenceBinary::ComputeSingleNeighborsRecursion(ArgsType *args) {
       ComputeSingleNeighborsRecursion(args);
       bool prune_or_not = false;
       if (mode == NearestNeighborAllKN) {
-        prune_or_not = args->dist_so_far() < left_distance;
+        prune_or_not = args->dist_so_far() < left_distance * prune_factor;
       }
       if (mode == FurthestNeighborAllKN) {
-        prune_or_not = args->dist_so_far() > left_distance;
+        prune_or_not = args->dist_so_far() * prune_factor > left_distance;
       }
 
       if (prune_or_not) {
-        args->info()->num_of_prunes()++;
+        if (args->info() != NULL) {
+          args->info()->num_of_prunes()++;
+        }
         return;
       }
       args->reference_node() = left_node;
@@ -696,6 +693,184 @@ QueryBinaryReferenceBinary::ComputeSingleNeighborsRecursion(ArgsType *args) {
   }
 }
 
+/**
+ * For rank approximate neighbors we sample the same fraction of every
+ * reference node that is not pruned, so that every query sees enough
+ * samples to have its neighbors in the top ranks with the requested
+ * probability. Nodes that need more samples than the limit are
+ * searched further, leaves are always searched exactly
+ */
+template<typename TypeVector>
+template<typename ArgsType>
+index_t SingleThreadAllKNTraversal<TypeVector>::
+QueryBinaryReferenceBinary::NumOfSamples(ArgsType *args) {
+  static const bool IS_RANGE_NEIGHBORS = ArgsType::IS_RANGE_NEIGHBORS;
+  if (IS_RANGE_NEIGHBORS || args->info() == NULL
+      || args->info()->sample_fraction() <= 0
+      || args->reference_table()->node_is_leaf(args->reference_node())) {
+    return 0;
+  }
+  index_t count = args->reference_table()->get_node_count(
+                    args->reference_node());
+  index_t num_of_samples = static_cast<index_t>(
+                             std::ceil(args->info()->sample_fraction() * count));
+  if (num_of_samples > args->info()->sample_limit()) {
+    return 0;
+  }
+  return std::min(num_of_samples, count);
+}
+
+template<typename TypeVector>
+template<typename ArgsType>
+void SingleThreadAllKNTraversal<TypeVector>::
+QueryBinaryReferenceBinary::ComputeDualSampledBaseCase(ArgsType *args,
+    index_t num_of_samples) {
+  // the samples only depend on the reference node, the threads split
+  // the query node and every part must get the same sample
+  std::size_t seed = 0;
+  boost::hash_combine(seed,
+                      args->reference_table()->get_node_id(args->reference_node()));
+  std::vector<index_t> positions;
+  SampleReferences(args->reference_table(), args->reference_node(), seed,
+                   num_of_samples, &positions);
+  typename ReferenceTable_t::TreeIterator reference_it(
+    *(args->reference_table()),
+    args->reference_node());
+  std::vector<ReferencePoint_t> sample_points(positions.size());
+  std::vector<index_t> sample_ids(positions.size());
+  for (size_t i = 0; i < positions.size(); ++i) {
+    reference_it.get(positions[i], &sample_points[i]);
+    reference_it.get_id(positions[i], &sample_ids[i]);
+  }
+  args->info()->num_of_samples() += positions.size();
+
+  CalcPrecision_t query_bound_neighbor_distance;
+  if (mode == NearestNeighborAllKN) {
+    query_bound_neighbor_distance = -std::numeric_limits<CalcPrecision_t>::max();
+  }
+  if (mode == FurthestNeighborAllKN) {
+    query_bound_neighbor_distance = std::numeric_limits<CalcPrecision_t>::max();
+  }
+  index_t kns = static_cast<index_t>(args->kns());
+  std::vector<CalcPrecision_t> distances(positions.size());
+  typename QueryTable_t::TreeIterator query_it(*(args->query_table()),
+      args->query_node());
+  QueryPoint_t query_point;
+  for (index_t k = 0; k < query_it.count(); ++k) {
+    index_t query_id;
+    query_it.get(k, &query_point);
+    query_it.get_id(k, &query_id);
+    index_t ind = query_id * kns;
+    // Do not change the order of arguments, it will fail for non symetric divergences
+    fl::math::DistanceSqBlock(*args->metric(), &sample_points[0],
+                              static_cast<index_t>(sample_points.size()),
+                              query_point, &distances[0]);
+    for (size_t i = 0; i < positions.size(); ++i) {
+      if (!(IsMonochromatic && sample_ids[i] == query_id)) {
+        InsertNeighbor(args, ind, sample_ids[i], distances[i]);
+      }
+    }
+    CalcPrecision_t distance = (*(args->neighbor_distances()))[ind + kns - 1];
+    if (mode == NearestNeighborAllKN) {
+      query_bound_neighbor_distance =
+        std::max(query_bound_neighbor_distance, distance);
+    }
+    if (mode == FurthestNeighborAllKN) {
+      query_bound_neighbor_distance =
+        std::min(query_bound_neighbor_distance, distance);
+    }
+  }
+  args->stat()->at(args->query_table()->get_node_id(args->query_node())).
+  set_dist_so_far(query_bound_neighbor_distance);
+}
+
+template<typename TypeVector>
+template<typename ArgsType>
+void SingleThreadAllKNTraversal<TypeVector>::
+QueryBinaryReferenceBinary::ComputeSingleSampledBaseCase(ArgsType *args,
+    index_t num_of_samples) {
+  std::size_t seed = 0;
+  boost::hash_combine(seed, args->query_point_id());
+  boost::hash_combine(seed,
+                      args->reference_table()->get_node_id(args->reference_node()));
+  std::vector<index_t> positions;
+  SampleReferences(args->reference_table(), args->reference_node(), seed,
+                   num_of_samples, &positions);
+  typename ReferenceTable_t::TreeIterator reference_it(
+    *(args->reference_table()),
+    args->reference_node());
+  args->info()->num_of_samples() += positions.size();
+  index_t kns = static_cast<index_t>(args->kns());
+  index_t ind = args->query_point_id() * kns;
+  ReferencePoint_t reference_point;
+  index_t reference_index;
+  for (size_t i = 0; i < positions.size(); ++i) {
+    reference_it.get_id(positions[i], &reference_index);
+    if (!(IsMonochromatic && reference_index == args->query_point_id())) {
+      reference_it.get(positions[i], &reference_point);
+      // do not change the order of arguments it will fail in assymetric divergences
+      CalcPrecision_t distance =
+        args->metric()->DistanceSq(reference_point, *(args->query_point()));
+      InsertNeighbor(args, ind, reference_index, distance);
+    }
+  }
+  args->dist_so_far() = (*(args->neighbor_distances()))[ind + kns - 1];
+}
+
+/**
+ * Picks num_of_samples distinct positions of the node with Floyd's
+ * algorithm, it needs as many random numbers as samples, no matter
+ * how big the node is
+ */
+template<typename TypeVector>
+void SingleThreadAllKNTraversal<TypeVector>::
+QueryBinaryReferenceBinary::SampleReferences(const ReferenceTable_t *table,
+    ReferenceTree_t *node,
+    std::size_t seed,
+    index_t num_of_samples,
+    std::vector<index_t> *positions) {
+  index_t count = table->get_node_count(node);
+  boost::minstd_rand generator(static_cast<boost::uint32_t>(seed % 2147483646) + 1);
+  positions->clear();
+  std::unordered_set<index_t> chosen(2 * num_of_samples);
+  for (index_t j = count - num_of_samples; j < count; ++j) {
+    boost::uniform_int<index_t> distribution(0, j);
+    boost::variate_generator<boost::minstd_rand&, boost::uniform_int<index_t> >
+    die(generator, distribution);
+    index_t position = die();
+    if (chosen.insert(position).second == false) {
+      position = j;
+      chosen.insert(position);
+    }
+    positions->push_back(position);
+  }
+  std::sort(positions->begin(), positions->end());
+}
+
+/**
+ * Inserts a neighbor in the sorted neighbors of a query, if it is
+ * better than the last one
+ */
+template<typename TypeVector>
+template<typename ArgsType>
+void SingleThreadAllKNTraversal<TypeVector>::
+QueryBinaryReferenceBinary::InsertNeighbor(ArgsType *args,
+    index_t ind,
+    index_t neighbor,
+    CalcPrecision_t distance) {
+  static const bool IS_RANGE_NEIGHBORS = ArgsType::IS_RANGE_NEIGHBORS;
+  boost::mpl::eval_if <
+  boost::mpl::bool_<IS_RANGE_NEIGHBORS>,
+  ALLKNMPL::UpdateOperator2,
+  ALLKNMPL::UpdateOperator1
+  >::type::template InsertSorted<mode>(args->neighbor_indices(),
+                                       args->neighbor_distances(),
+                                       ind,
+                                       static_cast<index_t>(args->kns()),
+                                       neighbor,
+                                       distance);
+}
+
 template<typename TypeVector>
 template<typename ArgsType>
 void SingleThreadAllKNTraversal<TypeVector>::
@@ -1249,14 +1424,6 @@ QueryBinaryReferenceBinary::ComputeSingleNeighborsProgressive(
   }
   // node->is_leaf() works as one would expect
   // Base Case
-  index_t nearest_size;
-  if (Is1N == true) {
-    nearest_size = 1;
-  }
-  else {
-    nearest_size = static_cast<index_t>(args.kns());
-  }
-  std::vector<std::pair<CalcPrecision_t, index_t> > neighbors;
   index_t ind;
   typename ReferenceTable_t::TreeIterator reference_it(
     *args.reference_table(),
@@ -1266,26 +1433,11 @@ QueryBinaryReferenceBinary::ComputeSingleNeighborsProgressive(
 
   if (!IS_RANGE_NEIGHBORS) {
     if (Is1N == false) {
-      neighbors.resize(nearest_size + reference_it.count());
       ind = args.query_point_id() * static_cast<index_t>(args.kns());
     }
     else {
       ind = args.query_point_id();
     }
-    if (Is1N == false && !IS_RANGE_NEIGHBORS) {
-      for (index_t i = 0; i < static_cast<index_t>(args.kns()); i++) {
-        boost::mpl::eval_if <
-        boost::mpl::bool_<IS_RANGE_NEIGHBORS>,
-        ALLKNMPL::UpdateOperator2,
-        ALLKNMPL::UpdateOperator1
-        >::type::InitTempNeighbors(
-          &neighbors,
-          i,
-          ind,
-          *(args.neighbor_distances()),
-          *(args.neighbor_indices()));
-      }
-    }
   }
   // #pragma omp parallel for  shared(args)
   for (index_t i = 0; i < reference_it.count(); ++i) {
@@ -1313,8 +1465,7 @@ QueryBinaryReferenceBinary::ComputeSingleNeighborsProgressive(
         }
 
         if (push_back_or_not) {
-          neighbors[nearest_size+i].first = distance;
-          neighbors[nearest_size+i].second = reference_index;
+          InsertNeighbor(&args, ind, reference_index, distance);
         }
       }
       else {
@@ -1357,36 +1508,6 @@ QueryBinaryReferenceBinary::ComputeSingleNeighborsProgressive(
     }
   } // for reference_index
   if (Is1N == false && !IS_RANGE_NEIGHBORS) {
-    if (mode == NearestNeighborAllKN) {
-      std::sort(neighbors.begin(), neighbors.end());
-      /* std::nth_element(neighbors.begin(),
-                       neighbors.begin()+static_cast<int>(args.kns())-1,
-                       neighbors.end());
-       */
-    }
-    if (mode == FurthestNeighborAllKN) {
-      /* std::nth_element(neighbors.begin(),
-                        neighbors.begin()+static_cast<int>(args.kns())-1,
-                        neighbors.end(),
-                        std::greater<std::pair<CalcPrecision_t, index_t> >());
-       */
-      std::sort(neighbors.begin(), neighbors.end(),
-                  std::greater<std::pair<CalcPrecision_t, index_t> >());
-    }
-    for (index_t i = 0; i < static_cast<index_t>(args.kns()); i++) {
-      index_t neighbor_id;
-      neighbor_id = ind;
-      boost::mpl::eval_if <
-      boost::mpl::bool_<IS_RANGE_NEIGHBORS>,
-      ALLKNMPL::UpdateOperator2,
-      ALLKNMPL::UpdateOperator1
-      >::type::Insert(args.neighbor_indices(),
-                      args.neighbor_distances(),
-                      neighbor_id,
-                      neighbors[i].second,
-                      i,
-                      neighbors[i].first);
-    }
     args.dist_so_far() = (*(args.neighbor_distances()))
                          [ind+static_cast<index_t>(args.kns())-1];
   }
@@ -1434,12 +1555,12 @@ ComputeBaseCase(ArgsType *args) {
   query_it.Reset();
 
 
-  std::vector<std::pair<CalcPrecision_t, index_t> > neighbors;
-  if (!IS_RANGE_NEIGHBORS) {
-    neighbors.resize(neighbors_size);
-  }
- 
-  ReferencePoint_t reference_point;
+  // the distances to the references are computed in blocks, so that
+  // the metric can use a vectorized kernel
+  const index_t block_size = fl::dense::simd::kBlockSize;
+  ReferencePoint_t block_points[block_size];
+  index_t block_ids[block_size];
+  CalcPrecision_t block_distances[block_size];
   QueryPoint_t query_point; 
   for (index_t k = 0; k < query_it.count(); ++k) {
     index_t  query_id;
@@ -1450,19 +1571,6 @@ ComputeBaseCase(ArgsType *args) {
 
     if (!Is1N && !IS_RANGE_NEIGHBORS) {
       index_t ind = static_cast<index_t>(query_id * args->kns());
-      //index_t ind = 0;
-      for (index_t i = 0; i < static_cast<index_t>(args->kns()); i++) {
-        boost::mpl::eval_if <
-        boost::mpl::bool_<IS_RANGE_NEIGHBORS>,
-        ALLKNMPL::UpdateOperator2,
-        ALLKNMPL::UpdateOperator1
-        >::type::InitTempNeighbors(
-          &neighbors,
-          i,
-          ind,
-          *args->neighbor_distances(),
-          *args->neighbor_indices());
-      }
 
       CalcPrecision_t query_to_node_distance;
       if (mode == NearestNeighborAllKN) {
@@ -1487,59 +1595,53 @@ ComputeBaseCase(ArgsType *args) {
                                           +static_cast<index_t>(args->kns())-1];
       }
       if (search_or_not == true) {
+        // the candidates are compared with the last neighbor before the
+        // node, the row keeps them sorted as they come
+        CalcPrecision_t last_distance =
+          (*(args->neighbor_distances()))[ind + neighbors_size - 1];
         // We'll do the same for the references
-        for (int j = 0; j < reference_it.count(); ++j) {
+        for (index_t j = 0; j < reference_it.count(); j += block_size) {
           // Confirm that points do not identify themselves as neighbors
           // in the monochromatic case
-
-          reference_it.get(j, &reference_point);
-          reference_it.get_id(j, &ref_id);
-          if (!IsMonochromatic ||  query_id != ref_id) {
-            CalcPrecision_t distance = args->metric()->DistanceSq(
-                                         query_point,
-                                         reference_point);
+          index_t block = 0;
+          for (index_t b = j;
+               b < std::min(j + block_size, reference_it.count()); ++b) {
+            reference_it.get_id(b, &ref_id);
+            if (!IsMonochromatic ||  query_id != ref_id) {
+              reference_it.get(b, &block_points[block]);
+              block_ids[block] = ref_id;
+              ++block;
+            }
+          }
+          fl::math::DistanceSqBlock(*args->metric(), query_point,
+                                    block_points, block, block_distances);
+          for (index_t b = 0; b < block; ++b) {
+            ref_id = block_ids[b];
+            CalcPrecision_t distance = block_distances[b];
             // If the reference point is closer than the current candidate,
             // we'll update the candidate
             bool push_back_or_not;
             if (mode == NearestNeighborAllKN) {
-              push_back_or_not =
-                distance < (*(args->neighbor_distances()))[ind+
-                    static_cast<index_t>(args->kns())-1];
+              push_back_or_not = distance < last_distance;
             }
             if (mode == FurthestNeighborAllKN) {
-              push_back_or_not =
-                distance > (*(args->neighbor_distances()))[ind+
-                    static_cast<index_t>(args->kns())-1];
+              push_back_or_not = distance > last_distance;
             }
             if (push_back_or_not) {
-              neighbors.push_back(std::make_pair(distance, ref_id));
+              boost::mpl::eval_if <
+              boost::mpl::bool_<IS_RANGE_NEIGHBORS>,
+              ALLKNMPL::UpdateOperator2,
+              ALLKNMPL::UpdateOperator1
+              >::type::template InsertSorted<mode>(args->neighbor_indices(),
+                                                   args->neighbor_distances(),
+                                                   ind,
+                                                   neighbors_size,
+                                                   ref_id,
+                                                   distance);
             }
           }
         }// for reference_index
 
-        if (mode == NearestNeighborAllKN) {
-          std::sort(neighbors.begin(), neighbors.end());
-        }
-
-        if (mode == FurthestNeighborAllKN) {
-          std::sort(neighbors.begin(), neighbors.end(),
-                      std::greater<std::pair<CalcPrecision_t, index_t> >());
-        }
-        for (index_t i = 0; i < static_cast<index_t>(args->kns()); i++) {
-          index_t neighbor_id;
-          neighbor_id = ind;
-          boost::mpl::eval_if <
-          boost::mpl::bool_<IS_RANGE_NEIGHBORS>,
-          ALLKNMPL::UpdateOperator2,
-          ALLKNMPL::UpdateOperator1
-          >::type::Insert(args->neighbor_indices(),
-                          args->neighbor_distances(),
-                          neighbor_id,
-                          neighbors[i].second,
-                          i,
-                          neighbors[i].first);
-        }
-        neighbors.resize(static_cast<index_t>(args->kns()));
       }
       // We need to find the upper bound distance for this query node
       bool update_upper_bound_or_not;
@@ -1600,17 +1702,25 @@ ComputeBaseCase(ArgsType *args) {
       if (search_or_not) {
         // We'll do the same for the references
         reference_it.Reset();
-        for (index_t j = 0; j < reference_it.count(); ++j) {
-          //if(query
+        for (index_t j = 0; j < reference_it.count(); j += block_size) {
           // Confirm that points do not identify themselves as neighbors
           // in the monochromatic case
-          reference_it.get(j, &reference_point);
-          reference_it.get_id(j, &ref_id);
-          if (!IsMonochromatic ||  query_id != ref_id) {
-            // Do not change the order of arguments, it will fail for non symetric divergences
-            CalcPrecision_t distance = args->metric()->DistanceSq(
-                                         reference_point,
-                                         query_point);
+          index_t block = 0;
+          for (index_t b = j;
+               b < std::min(j + block_size, reference_it.count()); ++b) {
+            reference_it.get_id(b, &ref_id);
+            if (!IsMonochromatic ||  query_id != ref_id) {
+              reference_it.get(b, &block_points[block]);
+              block_ids[block] = ref_id;
+              ++block;
+            }
+          }
+          // Do not change the order of arguments, it will fail for non symetric divergences
+          fl::math::DistanceSqBlock(*args->metric(), block_points, block,
+                                    query_point, block_distances);
+          for (index_t b = 0; b < block; ++b) {
+            ref_id = block_ids[b];
+            CalcPrecision_t distance = block_distances[b];
             // If the reference point is closer than the current candidate,
             // we'll update the candidate
             bool push_or_not;
@@ -28,6 +28,12 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "mlpack/allkn/allkn_computations_dev.h"
 #include "mlpack/allkn/allkn.h"
 #include "mlpack/allkn/allkn_defs.h"
+#include "fastlib/table/graph_index_dev.h"
+#include "fastlib/dense/cppblas.h"
+#include <cmath>
+#include <typeinfo>
+#include "boost/bind.hpp"
+#include "boost/thread/thread.hpp"
 
 namespace fl {
 namespace ml {
@@ -704,6 +710,15 @@ template<typename ArgMap>
 AllKN<ArgMap>::AllKN() {
   query_table_ = NULL;
   reference_table_ = NULL;
+  n_threads_ = 1;
+  epsilon_ = 0;
+  tau_ = 0;
+  alpha_ = 0.95;
+  sample_limit_ = 20;
+  recall_sample_ = 0;
+  recall_ = 1;
+  graph_ = NULL;
+  search_breadth_ = 100;
 }
 
 template<typename ArgMap>
@@ -859,6 +874,38 @@ void  AllKN<ArgMap>::ComputeNeighbors(const std::string &traversal_mode,
   InitContainerWithoutPairs
   >::type::Init(neighbor_distances, kns * query_table_->n_entries());
 
+  if (traversal_mode == "graph") {
+    if (epsilon_ > 0 || tau_ > 0) {
+      fl::logger->Warning() << "The graph search has its own approximation, "
+      << "ignoring the approximation parameters";
+    }
+    ComputeGraphNeighbors_(metric, kns, neighbor_distances, neighbor_indices,
+                           boost::mpl::bool_<IS_RANGE_NEIGHBORS>());
+    number_of_prunes_ = 0;
+    recall_ = 1;
+    if (recall_sample_ > 0) {
+      recall_ = ComputeRecall_(metric, kns, *neighbor_distances,
+                               *neighbor_indices,
+                               boost::mpl::bool_<IS_RANGE_NEIGHBORS>());
+      fl::logger->Message() << "Recall of the graph neighbors on "
+      << std::min(recall_sample_, query_table_->n_entries()) << " queries is "
+      << recall_;
+    }
+    return;
+  }
+
+  if (traversal_mode == "blocked") {
+    if (epsilon_ > 0 || tau_ > 0) {
+      fl::logger->Warning() << "The blocked search is exact, "
+      << "ignoring the approximation parameters";
+    }
+    ComputeBlockedNeighbors_(metric, kns, neighbor_distances,
+                             neighbor_indices);
+    number_of_prunes_ = 0;
+    recall_ = 1;
+    return;
+  }
+
   CalcPrecision_t dist_so_far_init_value;
   if (KNmode == NearestNeighborAllKN) {
     std::fill(neighbor_distances->begin(),
@@ -886,6 +933,30 @@ void  AllKN<ArgMap>::ComputeNeighbors(const std::string &traversal_mode,
     ResetStatistics(dist_so_far_init_value);
   }
 
+  bool approximate = epsilon_ > 0 || tau_ > 0;
+  info->prune_factor() = 1;
+  info->sample_fraction() = 0;
+  if (approximate && IS_RANGE_NEIGHBORS) {
+    fl::logger->Warning() << "Range neighbors are always exact, "
+    << "ignoring the approximation parameters";
+    approximate = false;
+  }
+  if (approximate) {
+    // the distances are squared
+    info->prune_factor() = (1 + epsilon_) * (1 + epsilon_);
+    if (tau_ > 0) {
+      index_t num_of_samples = RankApproximationSamples_(
+                                 reference_table_->n_entries(),
+                                 static_cast<index_t>(kns), tau_, alpha_);
+      info->sample_fraction() = static_cast<double>(num_of_samples)
+                                / reference_table_->n_entries();
+      info->sample_limit() = sample_limit_;
+      fl::logger->Message() << "Rank approximation needs " << num_of_samples
+      << " samples per query, it samples " << 100 * info->sample_fraction()
+      << "% of the reference nodes";
+    }
+  }
+
   TreeArguments < MetricType,
   NeighborMethodType,
   ContainerDistType,
@@ -900,10 +971,9 @@ void  AllKN<ArgMap>::ComputeNeighbors(const std::string &traversal_mode,
                            dist_so_far_init_value,
                            &metric,
                            info);
-  if (traversal_mode == "dual") {
-    if (monochromatic_flag_ == true) {
-      if (IS_RANGE_NEIGHBORS == true ||  kns == 1) {
-        AllKNTraversal:: template type <
+  if (monochromatic_flag_ == true) {
+    if (IS_RANGE_NEIGHBORS == true ||  kns == 1) {
+      ComputeNeighbors_<typename AllKNTraversal:: template type <
         boost::mpl::vector6 <
         ArgMap,
         boost::mpl::bool_<QueryTree_t::IsBinary>,
@@ -912,23 +982,22 @@ void  AllKN<ArgMap>::ComputeNeighbors(const std::string &traversal_mode,
         boost::mpl::bool_<true>,
         boost::mpl::int_<KNmode>
         >
-        >::ComputeDualNeighborsRecursion(&args);
-      }
-      else {
-        AllKNTraversal:: template type <
+      > >(traversal_mode, &args);
+    }
+    else {
+      ComputeNeighbors_<typename AllKNTraversal:: template type <
         boost::mpl::vector6 <
         ArgMap, boost::mpl::bool_<QueryTree_t::IsBinary>,
         boost::mpl::bool_<ReferenceTree_t::IsBinary>,
         boost::mpl::bool_<false>, boost::mpl::bool_<true>,
         boost::mpl::int_<KNmode>
         >
-        >::
-        ComputeDualNeighborsRecursion(&args);
-      }
+      > >(traversal_mode, &args);
     }
-    else {
-      if (IS_RANGE_NEIGHBORS || kns == 1) {
-        AllKNTraversal:: template type <
+  }
+  else {
+    if (IS_RANGE_NEIGHBORS || kns == 1) {
+      ComputeNeighbors_<typename AllKNTraversal:: template type <
         boost::mpl::vector6 <
         ArgMap,
         boost::mpl::bool_<QueryTree_t::IsBinary>,
@@ -936,10 +1005,10 @@ void  AllKN<ArgMap>::ComputeNeighbors(const std::string &traversal_mode,
         boost::mpl::bool_<true>, boost::mpl::bool_<false>,
         boost::mpl::int_<KNmode>
         >
-        >::ComputeDualNeighborsRecursion(&args);
-      }
-      else {
-        AllKNTraversal:: template type <
+      > >(traversal_mode, &args);
+    }
+    else {
+      ComputeNeighbors_<typename AllKNTraversal:: template type <
         boost::mpl::vector6 <
         ArgMap,
         boost::mpl::bool_<QueryTree_t::IsBinary>,
@@ -947,123 +1016,1008 @@ void  AllKN<ArgMap>::ComputeNeighbors(const std::string &traversal_mode,
         boost::mpl::bool_<false>, boost::mpl::bool_<false>,
         boost::mpl::int_<KNmode>
         >
-        >::ComputeDualNeighborsRecursion(&args);
-      }
+      > >(traversal_mode, &args);
     }
   }
+  number_of_prunes_ = info->num_of_prunes();
+  recall_ = 1;
+  if (approximate && recall_sample_ > 0) {
+    recall_ = ComputeRecall_(metric, kns, *neighbor_distances,
+                             *neighbor_indices,
+                             boost::mpl::bool_<IS_RANGE_NEIGHBORS>());
+    fl::logger->Message() << "Recall of the approximate neighbors on "
+    << std::min(recall_sample_, query_table_->n_entries()) << " queries is "
+    << recall_;
+  }
+} // ComputeNeighbors
+
+template<typename ArgMap>
+template<typename MetricType, typename SinkType>
+void AllKN<ArgMap>::ComputeRangeJoin(const std::string &traversal_mode,
+                                     const MetricType &metric,
+                                     CalcPrecision_t radius,
+                                     SinkType *sink) {
+  if (traversal_mode == "blocked") {
+    // the blocks do not have a tree to split, they are handed over at once
+    std::vector<CalcPrecision_t> neighbor_distances;
+    std::vector<std::pair<index_t, index_t> > neighbor_indices;
+    ComputeNeighbors(traversal_mode, metric, radius, &neighbor_distances,
+                     &neighbor_indices);
+    (*sink)(neighbor_indices, neighbor_distances);
+    return;
+  }
+  if (traversal_mode != "dual" && traversal_mode != "single"
+      && traversal_mode != "naive") {
+    fl::logger->Die() << "This choice " << traversal_mode
+    << " is not supported for range neighbors";
+  }
+  if (epsilon_ > 0 || tau_ > 0) {
+    fl::logger->Warning() << "Range neighbors are always exact, "
+    << "ignoring the approximation parameters";
+  }
+  ResetStatistics(radius);
+  DynamicArguments_t info;
+  // the subtrees collect their pairs in buffers of their own,
+  // these stay empty
+  std::vector<CalcPrecision_t> neighbor_distances;
+  std::vector<std::pair<index_t, index_t> > neighbor_indices;
+  TreeArguments < MetricType,
+  CalcPrecision_t,
+  std::vector<CalcPrecision_t>,
+  std::vector<std::pair<index_t, index_t> > > args(query_table_->get_tree(),
+      query_table_,
+      reference_table_->get_tree(),
+      reference_table_,
+      &neighbor_distances,
+      &neighbor_indices,
+      &stat_,
+      radius,
+      radius,
+      &metric,
+      &info);
+  if (monochromatic_flag_ == true) {
+    ComputeRangeTasks_<typename AllKNTraversal:: template type <
+      boost::mpl::vector6 <
+      ArgMap,
+      boost::mpl::bool_<QueryTree_t::IsBinary>,
+      boost::mpl::bool_<ReferenceTree_t::IsBinary>,
+      boost::mpl::bool_<true>,
+      boost::mpl::bool_<true>,
+      boost::mpl::int_<KNmode>
+      >
+    > >(traversal_mode, &args, sink);
+  }
+  else {
+    ComputeRangeTasks_<typename AllKNTraversal:: template type <
+      boost::mpl::vector6 <
+      ArgMap,
+      boost::mpl::bool_<QueryTree_t::IsBinary>,
+      boost::mpl::bool_<ReferenceTree_t::IsBinary>,
+      boost::mpl::bool_<true>,
+      boost::mpl::bool_<false>,
+      boost::mpl::int_<KNmode>
+      >
+    > >(traversal_mode, &args, sink);
+  }
+  number_of_prunes_ = info.num_of_prunes();
+  recall_ = 1;
+}
+
+
+/**
+ * Runs the traversal on a single thread or, when n_threads_ is more than 1,
+ * on the query subtrees of the first levels of the query tree. Every
+ * query subtree replays the calls the single thread recursion makes on it,
+ * in the same order, so the neighbors found are exactly the same.
+ * Range neighbors are the same too, but the pairs of different query
+ * subtrees are not in the order of the single thread
+ */
+template<typename ArgMap>
+template<typename TraversalType, typename ArgsType>
+void AllKN<ArgMap>::ComputeNeighbors_(const std::string &traversal_mode,
+                                      ArgsType *args) {
+  static const bool IS_RANGE_NEIGHBORS = ArgsType::IS_RANGE_NEIGHBORS;
+  if (traversal_mode != "dual" && traversal_mode != "single"
+      && traversal_mode != "naive") {
+    fl::logger->Die() << "This choice " << traversal_mode
+    << " is not supported";
+  }
+  if (n_threads_ <= 1 || query_table_->get_tree() == NULL) {
+    ComputeSingleThread_<TraversalType>(traversal_mode, args);
+    return;
+  }
+  if (IS_RANGE_NEIGHBORS) {
+    RangeAppender_<typename ArgsType::ContainerDist_t,
+                   typename ArgsType::ContainerInd_t> appender(
+                     args->neighbor_distances(), args->neighbor_indices());
+    ComputeRangeTasks_<TraversalType>(traversal_mode, args, &appender);
+    return;
+  }
+  // Go a couple of levels deeper than the threads so that there are
+  // enough subtrees to balance the load
+  int depth = 2;
+  while ((1 << (depth - 2)) < n_threads_) {
+    ++depth;
+  }
+  std::vector<index_t> task_ids(query_table_->num_of_nodes(), -1);
+  std::vector<QueryTask_> tasks;
+  CollectQueryTasks_(*args->metric(),
+                     traversal_mode == "dual",
+                     args->info(),
+                     args->query_node(),
+                     args->reference_node(),
+                     args->bound_distance(),
+                     depth,
+                     &task_ids,
+                     &tasks);
+  index_t next_task = 0;
+  boost::mutex task_mutex;
+  // every thread counts its own prunes, the approximation parameters
+  // are the same for all
+  DynamicArguments_t thread_info;
+  if (args->info() != NULL) {
+    thread_info = *args->info();
+    thread_info.num_of_prunes() = 0;
+    thread_info.num_of_samples() = 0;
+  }
+  std::vector<DynamicArguments_t> infos(n_threads_, thread_info);
+  boost::thread_group threads;
+  for (int i = 1; i < n_threads_; ++i) {
+    threads.create_thread(boost::bind(
+        &AllKN<ArgMap>::template ComputeQueryTasks_<TraversalType, ArgsType>,
+        boost::cref(traversal_mode), args, &tasks, &next_task,
+        &task_mutex, &infos[i]));
+  }
+  ComputeQueryTasks_<TraversalType>(traversal_mode, args, &tasks,
+      &next_task, &task_mutex, &infos[0]);
+  threads.join_all();
+  if (args->info() != NULL) {
+    for (int i = 0; i < n_threads_; ++i) {
+      args->info()->num_of_prunes() += infos[i].num_of_prunes();
+      args->info()->num_of_samples() += infos[i].num_of_samples();
+    }
+  }
+  UpdateQueryBounds_(query_table_->get_tree(), depth);
+}
+
+template<typename ArgMap>
+template<typename TraversalType, typename ArgsType>
+void AllKN<ArgMap>::ComputeSingleThread_(const std::string &traversal_mode,
+                                         ArgsType *args) {
+  if (traversal_mode == "dual") {
+    TraversalType::ComputeDualNeighborsRecursion(args);
+  }
   else {
     if (traversal_mode == "single") {
-      if (monochromatic_flag_ == true) {
-        if (IS_RANGE_NEIGHBORS || kns == 1) {
-          AllKNTraversal:: template type <
-          boost::mpl::vector6 <
-          ArgMap, boost::mpl::bool_<QueryTree_t::IsBinary>,
-          boost::mpl::bool_<ReferenceTree_t::IsBinary>,
-          boost::mpl::bool_<true>,
-          boost::mpl::bool_<true>,
-          boost::mpl::int_<KNmode>
-          >
-          >::ComputeAllSingleNeighborsRecursion(&args);
-        }
-        else {
-          AllKNTraversal:: template type <
-          boost::mpl::vector6 <
-          ArgMap,
-          boost::mpl::bool_<QueryTree_t::IsBinary>,
-          boost::mpl::bool_<ReferenceTree_t::IsBinary>,
-          boost::mpl::bool_<false>, boost::mpl::bool_<true>,
-          boost::mpl::int_<KNmode>
-          >
-          >::ComputeAllSingleNeighborsRecursion(&args);
-        }
+      TraversalType::ComputeAllSingleNeighborsRecursion(args);
+    }
+    else {
+      TraversalType::ComputeNaive(args);
+    }
+  }
+}
+
+/**
+ * Every thread takes the next query subtree until there are none left.
+ * The query subtrees are disjoint, so are the rows of the neighbor
+ * containers and the statistics they update
+ */
+template<typename ArgMap>
+template<typename TraversalType, typename ArgsType>
+void AllKN<ArgMap>::ComputeQueryTasks_(const std::string &traversal_mode,
+                                       const ArgsType *args,
+                                       std::vector<QueryTask_> *tasks,
+                                       index_t *next_task,
+                                       boost::mutex *task_mutex,
+                                       DynamicArguments_t *info) {
+  while (true) {
+    index_t task;
+    {
+      boost::mutex::scoped_lock lock(*task_mutex);
+      if (*next_task >= static_cast<index_t>(tasks->size())) {
+        return;
       }
-      else {
-        if (IS_RANGE_NEIGHBORS || kns == 1) {
-          AllKNTraversal:: template type <
-          boost::mpl::vector6 <
-          ArgMap,
-          boost::mpl::bool_<QueryTree_t::IsBinary>,
-          boost::mpl::bool_<ReferenceTree_t::IsBinary>,
-          boost::mpl::bool_<true>,
-          boost::mpl::bool_<false>,
-          boost::mpl::int_<KNmode>
-          >
-          >::ComputeAllSingleNeighborsRecursion(&args);
-        }
-        else {
-          AllKNTraversal:: template type <
-          boost::mpl::vector6 <
-          ArgMap,
-          boost::mpl::bool_<QueryTree_t::IsBinary>,
-          boost::mpl::bool_<ReferenceTree_t::IsBinary>,
-          boost::mpl::bool_<false>, boost::mpl::bool_<false>,
-          boost::mpl::int_<KNmode>
-          >
-          >::ComputeAllSingleNeighborsRecursion(&args);
-        }
+      task = (*next_task)++;
+    }
+    // the copy gets its own bound, it is not shared with the other threads
+    ArgsType task_args(*args);
+    task_args.info() = info;
+    for (size_t i = 0; i < (*tasks)[task].references.size(); ++i) {
+      task_args.query_node() = (*tasks)[task].query_node;
+      task_args.reference_node() = (*tasks)[task].references[i].first;
+      task_args.bound_distance() = (*tasks)[task].references[i].second;
+      ComputeSingleThread_<TraversalType>(traversal_mode, &task_args);
+    }
+  }
+}
+
+/**
+ * Range neighbors are collected per query subtree, in buffers that go
+ * to the sink as soon as the subtree is done. The subtrees are smaller
+ * than for k neighbors, so that only a few of them wait in memory
+ */
+template<typename ArgMap>
+template<typename TraversalType, typename ArgsType, typename SinkType>
+void AllKN<ArgMap>::ComputeRangeTasks_(const std::string &traversal_mode,
+                                       ArgsType *args,
+                                       SinkType *sink) {
+  if (query_table_->get_tree() == NULL) {
+    typename ArgsType::ContainerDist_t distances;
+    typename ArgsType::ContainerInd_t indices;
+    ArgsType all_args(*args);
+    all_args.neighbor_distances() = &distances;
+    all_args.neighbor_indices() = &indices;
+    ComputeSingleThread_<TraversalType>(traversal_mode, &all_args);
+    (*sink)(indices, distances);
+    return;
+  }
+  int n_threads = std::max(n_threads_, 1);
+  int depth = 6;
+  while ((1 << (depth - 6)) < n_threads) {
+    ++depth;
+  }
+  std::vector<index_t> task_ids(query_table_->num_of_nodes(), -1);
+  std::vector<QueryTask_> tasks;
+  CollectQueryTasks_(*args->metric(),
+                     traversal_mode == "dual",
+                     NULL,
+                     args->query_node(),
+                     args->reference_node(),
+                     args->bound_distance(),
+                     depth,
+                     &task_ids,
+                     &tasks);
+  index_t next_task = 0;
+  boost::mutex task_mutex;
+  boost::mutex sink_mutex;
+  DynamicArguments_t thread_info;
+  if (args->info() != NULL) {
+    thread_info = *args->info();
+    thread_info.num_of_prunes() = 0;
+    thread_info.num_of_samples() = 0;
+  }
+  std::vector<DynamicArguments_t> infos(n_threads, thread_info);
+  boost::thread_group threads;
+  for (int i = 1; i < n_threads; ++i) {
+    threads.create_thread(boost::bind(
+        &AllKN<ArgMap>::template ComputeRangeQueryTasks_<TraversalType,
+                                                         ArgsType, SinkType>,
+        boost::cref(traversal_mode), args, &tasks, &next_task,
+        &task_mutex, &infos[i], sink, &sink_mutex));
+  }
+  ComputeRangeQueryTasks_<TraversalType>(traversal_mode, args, &tasks,
+      &next_task, &task_mutex, &infos[0], sink, &sink_mutex);
+  threads.join_all();
+  if (args->info() != NULL) {
+    for (int i = 0; i < n_threads; ++i) {
+      args->info()->num_of_prunes() += infos[i].num_of_prunes();
+      args->info()->num_of_samples() += infos[i].num_of_samples();
+    }
+  }
+}
+
+template<typename ArgMap>
+template<typename TraversalType, typename ArgsType, typename SinkType>
+void AllKN<ArgMap>::ComputeRangeQueryTasks_(const std::string &traversal_mode,
+                                            const ArgsType *args,
+                                            std::vector<QueryTask_> *tasks,
+                                            index_t *next_task,
+                                            boost::mutex *task_mutex,
+                                            DynamicArguments_t *info,
+                                            SinkType *sink,
+                                            boost::mutex *sink_mutex) {
+  typename ArgsType::ContainerDist_t distances;
+  typename ArgsType::ContainerInd_t indices;
+  while (true) {
+    index_t task;
+    {
+      boost::mutex::scoped_lock lock(*task_mutex);
+      if (*next_task >= static_cast<index_t>(tasks->size())) {
+        return;
+      }
+      task = (*next_task)++;
+    }
+    ArgsType task_args(*args);
+    task_args.info() = info;
+    task_args.neighbor_distances() = &distances;
+    task_args.neighbor_indices() = &indices;
+    for (size_t i = 0; i < (*tasks)[task].references.size(); ++i) {
+      task_args.query_node() = (*tasks)[task].query_node;
+      task_args.reference_node() = (*tasks)[task].references[i].first;
+      task_args.bound_distance() = (*tasks)[task].references[i].second;
+      ComputeSingleThread_<TraversalType>(traversal_mode, &task_args);
+    }
+    {
+      boost::mutex::scoped_lock lock(*sink_mutex);
+      (*sink)(indices, distances);
+    }
+    distances.clear();
+    indices.clear();
+  }
+}
+
+/**
+ * Follows the single thread dual recursion down to depth without pruning
+ * and records for every query subtree the reference nodes it meets, in
+ * the order it meets them. The pairs that the single thread recursion
+ * would have pruned higher in the tree are pruned again by the query
+ * subtree, since its bound can only be tighter. For the single and naive
+ * traversals every query subtree is visited with the reference root
+ */
+template<typename ArgMap>
+template<typename MetricType>
+void AllKN<ArgMap>::CollectQueryTasks_(const MetricType &metric,
+                                       bool is_dual,
+                                       DynamicArguments_t *info,
+                                       QueryTree_t *query_node,
+                                       ReferenceTree_t *reference_node,
+                                       CalcPrecision_t bound_distance,
+                                       int depth,
+                                       std::vector<index_t> *task_ids,
+                                       std::vector<QueryTask_> *tasks) {
+  if (depth == 0 || query_table_->node_is_leaf(query_node)) {
+    index_t &task = (*task_ids)[query_table_->get_node_id(query_node)];
+    if (task < 0) {
+      task = tasks->size();
+      tasks->push_back(QueryTask_());
+      tasks->back().query_node = query_node;
+    }
+    (*tasks)[task].references.push_back(
+      std::make_pair(reference_node, bound_distance));
+    return;
+  }
+  QueryTree_t *query_children[2] = {
+    query_table_->get_node_left_child(query_node),
+    query_table_->get_node_right_child(query_node)
+  };
+  // the single thread recursion samples the whole reference node for
+  // all the queries of the query node, so it is not split either
+  if (is_dual == false ||
+      reference_table_->node_is_leaf(reference_node) ||
+      IsSampled_(info, reference_node)) {
+    for (int i = 0; i < 2; ++i) {
+      CalcPrecision_t distance = bound_distance;
+      if (is_dual && KNmode == NearestNeighborAllKN) {
+        distance = MinNodeDistSq(metric, query_children[i], reference_node);
+      }
+      if (is_dual && KNmode == FurthestNeighborAllKN) {
+        distance = MaxNodeDistSq(metric, query_children[i], reference_node);
       }
+      CollectQueryTasks_(metric, is_dual, info, query_children[i],
+                         reference_node, distance,
+                         depth - 1, task_ids, tasks);
+    }
+    return;
+  }
+  ReferenceTree_t *reference_left =
+    reference_table_->get_node_left_child(reference_node);
+  ReferenceTree_t *reference_right =
+    reference_table_->get_node_right_child(reference_node);
+  for (int i = 0; i < 2; ++i) {
+    CalcPrecision_t left_distance;
+    CalcPrecision_t right_distance;
+    bool go_left = false;
+    if (KNmode == NearestNeighborAllKN) {
+      left_distance = MinNodeDistSq(metric, query_children[i], reference_left);
+      right_distance = MinNodeDistSq(metric, query_children[i], reference_right);
+      go_left = left_distance < right_distance;
+    }
+    if (KNmode == FurthestNeighborAllKN) {
+      left_distance = MaxNodeDistSq(metric, query_children[i], reference_left);
+      right_distance = MaxNodeDistSq(metric, query_children[i], reference_right);
+      go_left = left_distance > right_distance;
+    }
+    if (go_left) {
+      CollectQueryTasks_(metric, is_dual, info, query_children[i],
+                         reference_left, left_distance,
+                         depth - 1, task_ids, tasks);
+      CollectQueryTasks_(metric, is_dual, info, query_children[i],
+                         reference_right, right_distance,
+                         depth - 1, task_ids, tasks);
     }
     else {
-      if (traversal_mode == "naive") {
-        if (monochromatic_flag_ == true) {
-          if (IS_RANGE_NEIGHBORS || kns == 1) {
-            AllKNTraversal:: template type <
-            boost::mpl::vector6 <
-            ArgMap,
-            boost::mpl::bool_<QueryTree_t::IsBinary>,
-            boost::mpl::bool_<ReferenceTree_t::IsBinary>,
-            boost::mpl::bool_<true>,
-            boost::mpl::bool_<true>,
-            boost::mpl::int_<KNmode>
-            >
-            >::ComputeNaive(&args);
+      CollectQueryTasks_(metric, is_dual, info, query_children[i],
+                         reference_right, right_distance,
+                         depth - 1, task_ids, tasks);
+      CollectQueryTasks_(metric, is_dual, info, query_children[i],
+                         reference_left, left_distance,
+                         depth - 1, task_ids, tasks);
+    }
+  }
+}
+
+/**
+ * The same test as the NumOfSamples of the dual traversal
+ */
+template<typename ArgMap>
+bool AllKN<ArgMap>::IsSampled_(DynamicArguments_t *info,
+                               ReferenceTree_t *reference_node) const {
+  if (info == NULL || info->sample_fraction() <= 0
+      || reference_table_->node_is_leaf(reference_node)) {
+    return false;
+  }
+  index_t count = reference_table_->get_node_count(reference_node);
+  return static_cast<index_t>(std::ceil(info->sample_fraction() * count))
+         <= info->sample_limit();
+}
+
+/**
+ * The query subtrees do not update the bounds of the nodes above them,
+ * so we propagate them after the parallel traversal
+ */
+template<typename ArgMap>
+void AllKN<ArgMap>::UpdateQueryBounds_(QueryTree_t *query_node, int depth) {
+  if (depth == 0 || query_table_->node_is_leaf(query_node)) {
+    return;
+  }
+  QueryTree_t *left = query_table_->get_node_left_child(query_node);
+  QueryTree_t *right = query_table_->get_node_right_child(query_node);
+  UpdateQueryBounds_(left, depth - 1);
+  UpdateQueryBounds_(right, depth - 1);
+  CalcPrecision_t left_bound = stat_[query_table_->get_node_id(left)].dist_so_far();
+  CalcPrecision_t right_bound = stat_[query_table_->get_node_id(right)].dist_so_far();
+  if (KNmode == NearestNeighborAllKN) {
+    stat_[query_table_->get_node_id(query_node)].set_dist_so_far(
+      std::max(left_bound, right_bound));
+  }
+  if (KNmode == FurthestNeighborAllKN) {
+    stat_[query_table_->get_node_id(query_node)].set_dist_so_far(
+      std::min(left_bound, right_bound));
+  }
+}
+
+/**
+ * Every query searches the graph on its own, so the queries are handed
+ * to the threads in small blocks
+ */
+template<typename ArgMap>
+template<typename MetricType,
+         typename NeighborMethodType,
+         typename ContainerDistType,
+         typename ContainerIndType>
+void AllKN<ArgMap>::ComputeGraphNeighbors_(const MetricType &metric,
+    NeighborMethodType kns,
+    ContainerDistType *neighbor_distances,
+    ContainerIndType *neighbor_indices,
+    boost::mpl::false_ is_range_neighbors) {
+  if (KNmode == FurthestNeighborAllKN) {
+    fl::logger->Die() << "The graph index finds only nearest neighbors";
+  }
+  if (graph_ == NULL || graph_->is_indexed() == false) {
+    fl::logger->Die() << "There is no graph index for the references, "
+    << "set it with set_graph()";
+  }
+  if (graph_->n_entries() != reference_table_->n_entries()) {
+    fl::logger->Die() << "The graph index has " << graph_->n_entries()
+    << " points, while the references are " << reference_table_->n_entries();
+  }
+  if (graph_->metric_type_id() != typeid(metric).name()) {
+    fl::logger->Die() << "The graph index was built with a different metric ("
+    << graph_->metric_type_id() << ") than " << typeid(metric).name();
+  }
+  std::fill(neighbor_distances->begin(), neighbor_distances->end(),
+            std::numeric_limits<CalcPrecision_t>::max());
+  std::fill(neighbor_indices->begin(), neighbor_indices->end(), -1);
+  index_t next_query = 0;
+  boost::mutex query_mutex;
+  boost::thread_group threads;
+  for (int i = 1; i < n_threads_; ++i) {
+    threads.create_thread(boost::bind(
+        &AllKN<ArgMap>::SearchGraph_<MetricType, ContainerDistType,
+          ContainerIndType>,
+        this, &metric, static_cast<index_t>(kns), neighbor_distances,
+        neighbor_indices, &next_query, &query_mutex));
+  }
+  SearchGraph_(this, &metric, static_cast<index_t>(kns), neighbor_distances,
+               neighbor_indices, &next_query, &query_mutex);
+  threads.join_all();
+}
+
+template<typename ArgMap>
+template<typename MetricType,
+         typename NeighborMethodType,
+         typename ContainerDistType,
+         typename ContainerIndType>
+void AllKN<ArgMap>::ComputeGraphNeighbors_(const MetricType &metric,
+    NeighborMethodType kns,
+    ContainerDistType *neighbor_distances,
+    ContainerIndType *neighbor_indices,
+    boost::mpl::true_ is_range_neighbors) {
+  fl::logger->Die() << "The graph index does not support range neighbors";
+}
+
+/**
+ * In the monochromatic case the query is in the graph too, we ask for
+ * one more neighbor and skip it
+ */
+template<typename ArgMap>
+template<typename MetricType, typename ContainerDistType,
+         typename ContainerIndType>
+void AllKN<ArgMap>::SearchGraph_(const AllKN *allkn,
+                                 const MetricType *metric,
+                                 index_t kns,
+                                 ContainerDistType *neighbor_distances,
+                                 ContainerIndType *neighbor_indices,
+                                 index_t *next_query,
+                                 boost::mutex *query_mutex) {
+  const index_t kBlockSize = 64;
+  index_t n_queries = allkn->query_table_->n_entries();
+  index_t extra = allkn->monochromatic_flag_ ? 1 : 0;
+  fl::table::GraphIndex::SearchSpace space;
+  std::vector<fl::table::GraphIndex::Neighbor_t> neighbors;
+  QueryPoint_t query_point;
+  while (true) {
+    index_t begin;
+    {
+      boost::mutex::scoped_lock lock(*query_mutex);
+      begin = *next_query;
+      *next_query += kBlockSize;
+    }
+    if (begin >= n_queries) {
+      return;
+    }
+    index_t end = std::min(begin + kBlockSize, n_queries);
+    for (index_t q = begin; q < end; ++q) {
+      allkn->query_table_->get(q, &query_point);
+      allkn->graph_->Search(*allkn->reference_table_, *metric, query_point,
+                            kns + extra, allkn->search_breadth_,
+                            &neighbors, &space);
+      index_t j = 0;
+      for (size_t i = 0; i < neighbors.size() && j < kns; ++i) {
+        if (extra == 1 && neighbors[i].second == q) {
+          continue;
+        }
+        (*neighbor_distances)[q * kns + j] = neighbors[i].first;
+        (*neighbor_indices)[q * kns + j] = neighbors[i].second;
+        ++j;
+      }
+    }
+  }
+}
+
+template<typename ArgMap>
+const index_t AllKN<ArgMap>::kBlockedQueries_;
+
+template<typename ArgMap>
+const index_t AllKN<ArgMap>::kBlockedReferences_;
+
+/**
+ * The blocked search is a brute force search that computes the squared
+ * distances of a block of queries to a block of references at once, as
+ * ||q||^2 + ||r||^2 - 2 r^T q with a single gemm. Every query keeps its
+ * best candidates over the reference blocks, their distances are then
+ * recomputed with the metric so that they are the same as the ones of
+ * the other traversals. The threads take the query blocks in turn
+ */
+template<typename ArgMap>
+template<typename MetricType,
+         typename NeighborMethodType,
+         typename ContainerDistType,
+         typename ContainerIndType>
+void AllKN<ArgMap>::ComputeBlockedNeighbors_(const MetricType &metric,
+    NeighborMethodType kns,
+    ContainerDistType *neighbor_distances,
+    ContainerIndType *neighbor_indices) {
+  static const bool IS_RANGE_NEIGHBORS =
+    !boost::is_integral<NeighborMethodType>::value;
+  if (boost::is_same<MetricType, fl::math::LMetric<2> >::value == false) {
+    fl::logger->Die() << "The blocked search supports only the l2 metric";
+  }
+  if (query_table_->n_attributes() != reference_table_->n_attributes()) {
+    fl::logger->Die() << "The queries have " << query_table_->n_attributes()
+    << " dimensions, while the references have "
+    << reference_table_->n_attributes();
+  }
+  if (IS_RANGE_NEIGHBORS == false && kns == 0) {
+    return;
+  }
+  index_t dimension = reference_table_->n_attributes();
+  index_t n_references = reference_table_->n_entries();
+  std::vector<CalcPrecision_t> references(n_references * dimension);
+  std::vector<CalcPrecision_t> reference_norms(n_references);
+  ReferencePoint_t reference_point;
+  for (index_t i = 0; i < n_references; ++i) {
+    reference_table_->get(i, &reference_point);
+    CalcPrecision_t norm = 0;
+    for (index_t j = 0; j < dimension; ++j) {
+      CalcPrecision_t value = reference_point[j];
+      references[i * dimension + j] = value;
+      norm += value * value;
+    }
+    reference_norms[i] = norm;
+  }
+  index_t next_query = 0;
+  boost::mutex query_mutex;
+  boost::thread_group threads;
+  for (int i = 1; i < n_threads_; ++i) {
+    threads.create_thread(boost::bind(
+        &AllKN<ArgMap>::SearchBlocks_<MetricType, NeighborMethodType,
+          ContainerDistType, ContainerIndType>,
+        this, &metric, kns, &references, &reference_norms,
+        neighbor_distances, neighbor_indices, &next_query, &query_mutex));
+  }
+  SearchBlocks_(this, &metric, kns, &references, &reference_norms,
+                neighbor_distances, neighbor_indices, &next_query,
+                &query_mutex);
+  threads.join_all();
+}
+
+/**
+ * The distances of the expansion lose some precision when the points
+ * are far from the origin, by at most slack * (||q||^2 + ||r||^2). So a
+ * reference stays a candidate as long as it can still be one of the k
+ * neighbors within that error: its optimistic distance must not be worse
+ * than the k-th best pessimistic one, which a heap keeps. The candidates
+ * are recomputed with the metric and truncated to k at the end. Range
+ * candidates are taken with the same slack and checked again
+ */
+template<typename ArgMap>
+template<typename MetricType,
+         typename NeighborMethodType,
+         typename ContainerDistType,
+         typename ContainerIndType>
+void AllKN<ArgMap>::SearchBlocks_(const AllKN *allkn,
+    const MetricType *metric,
+    NeighborMethodType kns,
+    const std::vector<CalcPrecision_t> *references,
+    const std::vector<CalcPrecision_t> *reference_norms,
+    ContainerDistType *neighbor_distances,
+    ContainerIndType *neighbor_indices,
+    index_t *next_query,
+    boost::mutex *query_mutex) {
+  static const bool IS_RANGE_NEIGHBORS =
+    !boost::is_integral<NeighborMethodType>::value;
+  typedef std::pair<CalcPrecision_t, index_t> Candidate_t;
+  const QueryTable_t *query_table = allkn->query_table_;
+  const ReferenceTable_t *reference_table = allkn->reference_table_;
+  index_t n_queries = query_table->n_entries();
+  index_t n_references = reference_table->n_entries();
+  index_t dimension = reference_table->n_attributes();
+  index_t k = IS_RANGE_NEIGHBORS ? 0 : static_cast<index_t>(kns);
+  CalcPrecision_t radius = static_cast<CalcPrecision_t>(kns);
+  CalcPrecision_t slack = std::sqrt(
+                            std::numeric_limits<CalcPrecision_t>::epsilon());
+  std::vector<CalcPrecision_t> queries(kBlockedQueries_ * dimension);
+  std::vector<CalcPrecision_t> query_norms(kBlockedQueries_);
+  std::vector<CalcPrecision_t> products(kBlockedQueries_ * kBlockedReferences_);
+  // the optimistic distances of the candidates, and the k best
+  // pessimistic distances of every query
+  std::vector<std::vector<Candidate_t> > candidates(kBlockedQueries_);
+  std::vector<std::vector<CalcPrecision_t> > bounds(kBlockedQueries_);
+  QueryPoint_t query_point;
+  ReferencePoint_t reference_point;
+  while (true) {
+    index_t query_begin;
+    {
+      boost::mutex::scoped_lock lock(*query_mutex);
+      query_begin = *next_query;
+      *next_query += kBlockedQueries_;
+    }
+    if (query_begin >= n_queries) {
+      return;
+    }
+    index_t n_block_queries = std::min(kBlockedQueries_,
+                                       n_queries - query_begin);
+    candidates.resize(n_block_queries);
+    bounds.resize(n_block_queries);
+    for (index_t q = 0; q < n_block_queries; ++q) {
+      query_table->get(query_begin + q, &query_point);
+      CalcPrecision_t norm = 0;
+      for (index_t j = 0; j < dimension; ++j) {
+        CalcPrecision_t value = query_point[j];
+        queries[q * dimension + j] = value;
+        norm += value * value;
+      }
+      query_norms[q] = norm;
+      candidates[q].clear();
+      bounds[q].clear();
+    }
+    for (index_t reference_begin = 0; reference_begin < n_references;
+         reference_begin += kBlockedReferences_) {
+      index_t n_block_references = std::min(kBlockedReferences_,
+                                            n_references - reference_begin);
+      // products(r, q) = r^T q, column major
+      fl::dense::CppBlas<CalcPrecision_t>::gemm("T", "N",
+          n_block_references, n_block_queries, dimension, 1.0,
+          &(*references)[reference_begin * dimension], dimension,
+          &queries[0], dimension,
+          0.0, &products[0], n_block_references);
+      for (index_t q = 0; q < n_block_queries; ++q) {
+        index_t query_id = query_begin + q;
+        std::vector<Candidate_t> &kept = candidates[q];
+        std::vector<CalcPrecision_t> &heap = bounds[q];
+        const CalcPrecision_t *column = &products[q * n_block_references];
+        for (index_t r = 0; r < n_block_references; ++r) {
+          index_t reference_id = reference_begin + r;
+          if (allkn->monochromatic_flag_ && reference_id == query_id) {
+            continue;
           }
-          else {
-            AllKNTraversal:: template type <
-            boost::mpl::vector6 <
-            ArgMap,
-            boost::mpl::bool_<QueryTree_t::IsBinary>,
-            boost::mpl::bool_<ReferenceTree_t::IsBinary>,
-            boost::mpl::bool_<false>, boost::mpl::bool_<true>,
-            boost::mpl::int_<KNmode>
-            >
-            >::ComputeNaive(&args);
+          CalcPrecision_t distance = std::max(CalcPrecision_t(0),
+              query_norms[q] + (*reference_norms)[reference_id]
+              - 2 * column[r]);
+          CalcPrecision_t error = slack *
+            (query_norms[q] + (*reference_norms)[reference_id]);
+          if (IS_RANGE_NEIGHBORS) {
+            if ((KNmode == NearestNeighborAllKN &&
+                 distance < radius + error) ||
+                (KNmode == FurthestNeighborAllKN &&
+                 distance > radius - error)) {
+              kept.push_back(std::make_pair(distance, reference_id));
+            }
+            continue;
           }
-        }
-        else {
-          if (IS_RANGE_NEIGHBORS || kns == 1) {
-            AllKNTraversal:: template type <
-            boost::mpl::vector6 <
-            ArgMap,
-            boost::mpl::bool_<QueryTree_t::IsBinary>,
-            boost::mpl::bool_<ReferenceTree_t::IsBinary>,
-            boost::mpl::bool_<true>, boost::mpl::bool_<false>,
-            boost::mpl::int_<KNmode>
-            >
-            >::ComputeNaive(&args);
+          if (KNmode == NearestNeighborAllKN) {
+            CalcPrecision_t optimistic = distance - error;
+            CalcPrecision_t pessimistic = distance + error;
+            if (static_cast<index_t>(heap.size()) < k) {
+              heap.push_back(pessimistic);
+              std::push_heap(heap.begin(), heap.end());
+            }
+            else if (optimistic > heap.front()) {
+              continue;
+            }
+            else if (pessimistic < heap.front()) {
+              std::pop_heap(heap.begin(), heap.end());
+              heap.back() = pessimistic;
+              std::push_heap(heap.begin(), heap.end());
+            }
+            kept.push_back(std::make_pair(optimistic, reference_id));
+          }
+          if (KNmode == FurthestNeighborAllKN) {
+            CalcPrecision_t optimistic = distance + error;
+            CalcPrecision_t pessimistic = distance - error;
+            if (static_cast<index_t>(heap.size()) < k) {
+              heap.push_back(pessimistic);
+              std::push_heap(heap.begin(), heap.end(),
+                             std::greater<CalcPrecision_t>());
+            }
+            else if (optimistic < heap.front()) {
+              continue;
+            }
+            else if (pessimistic > heap.front()) {
+              std::pop_heap(heap.begin(), heap.end(),
+                            std::greater<CalcPrecision_t>());
+              heap.back() = pessimistic;
+              std::push_heap(heap.begin(), heap.end(),
+                             std::greater<CalcPrecision_t>());
+            }
+            kept.push_back(std::make_pair(optimistic, reference_id));
           }
-          else {
-            AllKNTraversal:: template type <
-            boost::mpl::vector6 <
-            ArgMap,
-            boost::mpl::bool_<QueryTree_t::IsBinary>,
-            boost::mpl::bool_<ReferenceTree_t::IsBinary>,
-            boost::mpl::bool_<false>, boost::mpl::bool_<false>,
-            boost::mpl::int_<KNmode>
-            >
-            >::ComputeNaive(&args);
+        }
+        // the k-th pessimistic distance only gets better, the candidates
+        // it excludes now can be dropped
+        if (IS_RANGE_NEIGHBORS == false &&
+            static_cast<index_t>(heap.size()) == k) {
+          index_t n_kept = 0;
+          for (size_t i = 0; i < kept.size(); ++i) {
+            if ((KNmode == NearestNeighborAllKN &&
+                 kept[i].first <= heap.front()) ||
+                (KNmode == FurthestNeighborAllKN &&
+                 kept[i].first >= heap.front())) {
+              kept[n_kept++] = kept[i];
+            }
           }
+          kept.resize(n_kept);
         }
       }
-      else {
-        fl::logger->Die() << "This choice " << traversal_mode
-        << " is not supported";
+    }
+    for (index_t q = 0; q < n_block_queries; ++q) {
+      query_table->get(query_begin + q, &query_point);
+      std::vector<Candidate_t> &kept = candidates[q];
+      index_t n_kept = 0;
+      for (size_t i = 0; i < kept.size(); ++i) {
+        reference_table->get(kept[i].second, &reference_point);
+        // do not change the order of arguments, as in the other traversals
+        kept[i].first = metric->DistanceSq(reference_point, query_point);
+        if (IS_RANGE_NEIGHBORS &&
+            ((KNmode == NearestNeighborAllKN && !(kept[i].first < radius)) ||
+             (KNmode == FurthestNeighborAllKN && !(kept[i].first > radius)))) {
+          continue;
+        }
+        kept[n_kept++] = kept[i];
       }
+      kept.resize(n_kept);
     }
+    StoreBlockedNeighbors_(query_begin, k, &candidates,
+                           neighbor_distances, neighbor_indices, query_mutex,
+                           boost::mpl::bool_<IS_RANGE_NEIGHBORS>());
   }
-  number_of_prunes_ = info->num_of_prunes();
-} // ComputeNeighbors
+}
+
+template<typename ArgMap>
+template<typename ContainerDistType, typename ContainerIndType>
+void AllKN<ArgMap>::StoreBlockedNeighbors_(
+  index_t query_begin,
+  index_t kns,
+  std::vector<std::vector<std::pair<CalcPrecision_t, index_t> > >
+    *candidates,
+  ContainerDistType *neighbor_distances,
+  ContainerIndType *neighbor_indices,
+  boost::mutex *query_mutex,
+  boost::mpl::false_ is_range_neighbors) {
+  for (size_t q = 0; q < candidates->size(); ++q) {
+    std::vector<std::pair<CalcPrecision_t, index_t> > &neighbors =
+      (*candidates)[q];
+    if (KNmode == NearestNeighborAllKN) {
+      std::sort(neighbors.begin(), neighbors.end());
+    }
+    else {
+      std::sort(neighbors.begin(), neighbors.end(),
+                std::greater<std::pair<CalcPrecision_t, index_t> >());
+    }
+    // the candidates within the error of the k-th one are dropped now
+    if (static_cast<index_t>(neighbors.size()) > kns) {
+      neighbors.resize(kns);
+    }
+    for (size_t i = 0; i < neighbors.size(); ++i) {
+      (*neighbor_distances)[(query_begin + q) * kns + i] = neighbors[i].first;
+      (*neighbor_indices)[(query_begin + q) * kns + i] = neighbors[i].second;
+    }
+    // fewer references than neighbors, the rest keep the initial values
+    for (index_t i = neighbors.size(); i < kns; ++i) {
+      (*neighbor_distances)[(query_begin + q) * kns + i] =
+        KNmode == NearestNeighborAllKN ?
+        std::numeric_limits<CalcPrecision_t>::max() :
+        -std::numeric_limits<CalcPrecision_t>::max();
+      (*neighbor_indices)[(query_begin + q) * kns + i] = -1;
+    }
+  }
+}
+
+/**
+ * The range neighbors of a query block are appended together
+ */
+template<typename ArgMap>
+template<typename ContainerDistType, typename ContainerIndType>
+void AllKN<ArgMap>::StoreBlockedNeighbors_(
+  index_t query_begin,
+  index_t kns,
+  std::vector<std::vector<std::pair<CalcPrecision_t, index_t> > >
+    *candidates,
+  ContainerDistType *neighbor_distances,
+  ContainerIndType *neighbor_indices,
+  boost::mutex *query_mutex,
+  boost::mpl::true_ is_range_neighbors) {
+  boost::mutex::scoped_lock lock(*query_mutex);
+  for (size_t q = 0; q < candidates->size(); ++q) {
+    std::vector<std::pair<CalcPrecision_t, index_t> > &neighbors =
+      (*candidates)[q];
+    for (size_t i = 0; i < neighbors.size(); ++i) {
+      neighbor_indices->push_back(
+        std::make_pair(query_begin + q, neighbors[i].second));
+      neighbor_distances->push_back(neighbors[i].first);
+    }
+  }
+}
+
+/**
+ * The smallest number of samples, so that at least kns of them are in
+ * the tau percent of the references closest to the query with
+ * probability alpha. The number of samples in the top ranks is binomial
+ * and its tail only grows with the number of samples, so we bisect
+ */
+template<typename ArgMap>
+index_t AllKN<ArgMap>::RankApproximationSamples_(index_t n_references,
+    index_t kns,
+    double tau,
+    double alpha) {
+  index_t top_ranks = static_cast<index_t>(
+                        std::ceil(tau * n_references / 100.0));
+  if (top_ranks < kns) {
+    fl::logger->Warning() << "The top " << tau << "% of the references "
+    << "are less than " << kns << " points, the neighbors will be exact";
+    return n_references;
+  }
+  if (top_ranks >= n_references) {
+    return kns;
+  }
+  double p = static_cast<double>(top_ranks) / n_references;
+  index_t low = kns;
+  index_t high = n_references;
+  while (low < high) {
+    index_t n = low + (high - low) / 2;
+    // the probability of less than kns successes in n trials
+    double log_term = n * std::log1p(-p);
+    double miss = 0;
+    for (index_t i = 0; i < kns; ++i) {
+      miss += std::exp(log_term);
+      log_term += std::log(static_cast<double>(n - i))
+                  - std::log(static_cast<double>(i + 1))
+                  + std::log(p) - std::log1p(-p);
+    }
+    if (1 - miss >= alpha) {
+      high = n;
+    }
+    else {
+      low = n + 1;
+    }
+  }
+  return low;
+}
 
+/**
+ * Searches exhaustively a sample of the queries, spread evenly over the
+ * query table, and counts the neighbors found that are not further than
+ * the true k-th neighbor
+ */
+template<typename ArgMap>
+template<typename MetricType,
+         typename NeighborMethodType,
+         typename ContainerDistType,
+         typename ContainerIndType>
+double AllKN<ArgMap>::ComputeRecall_(const MetricType &metric,
+                                     NeighborMethodType kns,
+                                     const ContainerDistType &neighbor_distances,
+                                     const ContainerIndType &neighbor_indices,
+                                     boost::mpl::false_ is_range_neighbors) {
+  index_t n_queries = query_table_->n_entries();
+  index_t n_samples = std::min(recall_sample_, n_queries);
+  index_t k = static_cast<index_t>(kns);
+  index_t found = 0;
+  index_t total = 0;
+  std::vector<CalcPrecision_t> distances;
+  QueryPoint_t query_point;
+  ReferencePoint_t reference_point;
+  for (index_t s = 0; s < n_samples; ++s) {
+    index_t query_id = s * (n_queries / n_samples);
+    query_table_->get(query_id, &query_point);
+    distances.clear();
+    for (index_t i = 0; i < reference_table_->n_entries(); ++i) {
+      if (monochromatic_flag_ && i == query_id) {
+        continue;
+      }
+      reference_table_->get(i, &reference_point);
+      // do not change the order of arguments it will fail in assymetric divergences
+      distances.push_back(metric.DistanceSq(reference_point, query_point));
+    }
+    index_t rank = std::min(k, static_cast<index_t>(distances.size()));
+    if (rank == 0) {
+      continue;
+    }
+    if (KNmode == NearestNeighborAllKN) {
+      std::nth_element(distances.begin(), distances.begin() + rank - 1,
+                       distances.end());
+    }
+    if (KNmode == FurthestNeighborAllKN) {
+      std::nth_element(distances.begin(), distances.begin() + rank - 1,
+                       distances.end(), std::greater<CalcPrecision_t>());
+    }
+    CalcPrecision_t kth_distance = distances[rank - 1];
+    for (index_t j = 0; j < rank; ++j) {
+      index_t neighbor = neighbor_indices[query_id * k + j];
+      if (neighbor < 0) {
+        continue;
+      }
+      // we compute the distance again, the traversal might have computed
+      // it with a different rounding
+      reference_table_->get(neighbor, &reference_point);
+      CalcPrecision_t distance = metric.DistanceSq(reference_point, query_point);
+      if ((KNmode == NearestNeighborAllKN && distance <= kth_distance)
+          || (KNmode == FurthestNeighborAllKN && distance >= kth_distance)) {
+        ++found;
+      }
+    }
+    total += rank;
+  }
+  if (total == 0) {
+    return 1;
+  }
+  return static_cast<double>(found) / total;
+}
+
+template<typename ArgMap>
+template<typename MetricType,
+         typename NeighborMethodType,
+         typename ContainerDistType,
+         typename ContainerIndType>
+double AllKN<ArgMap>::ComputeRecall_(const MetricType &metric,
+                                     NeighborMethodType kns,
+                                     const ContainerDistType &neighbor_distances,
+                                     const ContainerIndType &neighbor_indices,
+                                     boost::mpl::true_ is_range_neighbors) {
+  // range neighbors are always exact
+  return 1;
+}
 
 template<typename ArgMap>
 template<typename TreeType, typename TableType, typename PrecisionType>
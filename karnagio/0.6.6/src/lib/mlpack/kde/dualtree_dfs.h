@@ -26,11 +26,31 @@ POSSIBILITY OF SUCH DAMAGE.
 #ifndef FL_LITE_MLPACK_KDE_DUALTREE_DFS_H
 #define FL_LITE_MLPACK_KDE_DUALTREE_DFS_H
 
+#include <deque>
+#include <vector>
 #include "mlpack/kde/dualtree_trace.h"
+#include "boost/thread/condition_variable.hpp"
+#include "boost/thread/mutex.hpp"
 
 namespace fl {
 namespace ml {
 
+/**
+ * @brief True if the two nodes share points, which happens only when the
+ *        query and the reference table are the same. The base case skips
+ *        the query point itself, so such a pair must not be summarized,
+ *        the bounds and the expansions would count it.
+ */
+template<typename TableType, typename TreeType>
+bool NodesShareAPoint(const TableType *query_table, TreeType *qnode,
+                      const TableType *reference_table, TreeType *rnode) {
+  return query_table == reference_table &&
+         query_table->get_node_begin(qnode) <
+         reference_table->get_node_end(rnode) &&
+         reference_table->get_node_begin(rnode) <
+         query_table->get_node_end(qnode);
+}
+
 template<typename ProblemType>
 class DualtreeDfs {
 
@@ -129,6 +149,47 @@ class DualtreeDfs {
       query_statistics_;
 
     PointFilter_t filter_;
+
+    int n_threads_;
+
+    boost::mutex random_mutex_;
+
+    /**
+     * @brief A reference node that a query subtree still has to visit,
+     *        with the failure probability the recursion would give it
+     */
+    struct ReferenceVisit_ {
+      ReferenceVisit_(Tree_t *rnode_in, double failure_probability_in,
+                      const GenRange<double> &squared_distance_range_in) :
+        rnode(rnode_in),
+        failure_probability(failure_probability_in),
+        squared_distance_range(squared_distance_range_in) {
+      }
+      Tree_t *rnode;
+      double failure_probability;
+      GenRange<double> squared_distance_range;
+    };
+
+    /**
+     * @brief A query subtree and the reference nodes it has to visit,
+     *        the unit of work of the threads
+     */
+    struct QueryTask_ {
+      Tree_t *qnode;
+      int depth;
+      std::vector<ReferenceVisit_> references;
+    };
+
+    /**
+     * @brief The query subtrees that wait for a thread
+     */
+    struct TaskQueue_ {
+      std::deque<QueryTask_> tasks;
+      int busy_threads;
+      boost::mutex mutex;
+      boost::condition_variable condition;
+    };
+
   private:
 
     void ResetStatisticRecursion_(Tree_t *node, 
@@ -163,6 +224,21 @@ class DualtreeDfs {
                     const typename ProblemType::Delta_t &delta,
                     typename ProblemType::Result_t *query_results);
 
+    template<typename MetricType>
+    bool CanSeriesSummarize_(
+      const MetricType &metric,
+      Tree_t *qnode,
+      Tree_t *rnode,
+      const typename ProblemType::Delta_t &delta,
+      typename ProblemType::Series_t *series,
+      typename ProblemType::Result_t *query_results);
+
+    void SeriesSummarize_(Tree_t *qnode,
+                          Tree_t *rnode,
+                          const typename ProblemType::Delta_t &delta,
+                          typename ProblemType::Series_t &series,
+                          typename ProblemType::Result_t *query_results);
+
     template<typename GlobalType>
     void ProbabilisticSummarize_(
       const GlobalType &global,
@@ -197,17 +273,49 @@ class DualtreeDfs {
     void PostProcess_(
       const MetricType &metric, Tree_t *qnode, Result_t *query_results);
 
+    template<typename MetricType>
+    void ComputeParallel_(
+      const MetricType &metric,
+      const GenRange<double> &squared_distance_range,
+      Result_t *query_results);
+
+    template<typename MetricType>
+    void RunQueryTasks_(const MetricType &metric,
+                        int max_depth,
+                        TaskQueue_ *queue,
+                        Result_t *query_results);
+
+    template<typename MetricType>
+    void SplitQueryTask_(const MetricType &metric,
+                         const QueryTask_ &task,
+                         QueryTask_ *left_task,
+                         QueryTask_ *right_task,
+                         Result_t *query_results);
+
   public:
     DualtreeDfs() {
       problem_ = NULL;
       query_table_ = NULL;
       reference_table_ = NULL;
+      n_threads_ = 1;
     }
 
     void set_filter(const PointFilter_t &filter) {
       filter_=filter;
     }
 
+    /**
+     * @brief Compute runs on n_threads threads, the progressive
+     *        iterator always runs on one
+     */
+    void set_n_threads(int n_threads) {
+      n_threads_ = n_threads;
+    }
+
+    int n_threads() const {
+      return n_threads_;
+    }
+
     ProblemType *problem();
 
     Table_t *query_table();
@@ -28,6 +28,10 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "mlpack/kde/dualtree_dfs.h"
 #include "mlpack/kde/dualtree_dfs_iterator_dev.h"
+#include "fastlib/metric_kernel/lmetric.h"
+#include "fastlib/table/point_filters.h"
+#include "boost/bind.hpp"
+#include "boost/thread/thread.hpp"
 
 extern index_t in_recursion_counter;
 
@@ -91,15 +95,214 @@ void fl::ml::DualtreeDfs<ProblemType>::Compute(
   PreProcess_(query_table_->get_tree());
   PreProcessReferenceTree_(reference_table_->get_tree());
   problem_->global().reference_statistic()=reference_statistics_.get();
-  DualtreeCanonical_(metric,
-                     query_table_->get_tree(),
-                     reference_table_->get_tree(),
-                     1.0 - problem_->global().probability(),
-                     squared_distance_range,
-                     query_results);
+  if (n_threads_ > 1) {
+    ComputeParallel_(metric, squared_distance_range, query_results);
+  }
+  else {
+    DualtreeCanonical_(metric,
+                       query_table_->get_tree(),
+                       reference_table_->get_tree(),
+                       1.0 - problem_->global().probability(),
+                       squared_distance_range,
+                       query_results);
+  }
   PostProcess_(metric, query_table_->get_tree(), query_results);
 }
 
+/**
+ * The query tree is split in subtrees that the threads take from a
+ * shared queue. A thread that splits a subtree keeps the left half and
+ * leaves the right half in the queue, where the idle threads steal it.
+ * Every subtree carries the reference nodes it has to visit, so the
+ * reference tree is split together with it. Two threads never work on
+ * the same query points, the statistics of a query subtree, its results
+ * and its Monte Carlo samples belong to the thread that runs it
+ */
+template<typename ProblemType>
+template<typename MetricType>
+void fl::ml::DualtreeDfs<ProblemType>::ComputeParallel_(
+  const MetricType &metric,
+  const GenRange<double> &squared_distance_range,
+  typename ProblemType::Result_t *query_results) {
+
+  // Go a few levels deeper than the threads so that there are
+  // enough subtrees to balance the load
+  int max_depth = 3;
+  while ((1 << (max_depth - 3)) < n_threads_) {
+    ++max_depth;
+  }
+  TaskQueue_ queue;
+  queue.busy_threads = 0;
+  queue.tasks.push_back(QueryTask_());
+  queue.tasks.back().qnode = query_table_->get_tree();
+  queue.tasks.back().depth = 0;
+  queue.tasks.back().references.push_back(ReferenceVisit_(
+      reference_table_->get_tree(),
+      1.0 - problem_->global().probability(),
+      squared_distance_range));
+  boost::thread_group threads;
+  for (int i = 1; i < n_threads_; ++i) {
+    threads.create_thread(boost::bind(
+        &DualtreeDfs<ProblemType>::template RunQueryTasks_<MetricType>,
+        this, boost::cref(metric), max_depth, &queue, query_results));
+  }
+  RunQueryTasks_(metric, max_depth, &queue, query_results);
+  threads.join_all();
+}
+
+/**
+ * Runs query subtrees until the queue is empty and no other thread can
+ * fill it again. Below max_depth a subtree runs the recursion of a
+ * single thread
+ */
+template<typename ProblemType>
+template<typename MetricType>
+void fl::ml::DualtreeDfs<ProblemType>::RunQueryTasks_(
+  const MetricType &metric,
+  int max_depth,
+  TaskQueue_ *queue,
+  typename ProblemType::Result_t *query_results) {
+
+  while (true) {
+    QueryTask_ task;
+    {
+      boost::mutex::scoped_lock lock(queue->mutex);
+      while (queue->tasks.empty() && queue->busy_threads > 0) {
+        queue->condition.wait(lock);
+      }
+      if (queue->tasks.empty()) {
+        return;
+      }
+      // the oldest subtree is the biggest one
+      task = queue->tasks.front();
+      queue->tasks.pop_front();
+      ++queue->busy_threads;
+    }
+    while (task.references.empty() == false) {
+      if (task.depth >= max_depth ||
+          query_table_->node_is_leaf(task.qnode)) {
+        for (size_t i = 0; i < task.references.size(); ++i) {
+          DualtreeCanonical_(metric,
+                             task.qnode,
+                             task.references[i].rnode,
+                             task.references[i].failure_probability,
+                             task.references[i].squared_distance_range,
+                             query_results);
+        }
+        break;
+      }
+      QueryTask_ left_task;
+      QueryTask_ right_task;
+      SplitQueryTask_(metric, task, &left_task, &right_task, query_results);
+      if (left_task.references.empty()) {
+        task = right_task;
+        continue;
+      }
+      if (right_task.references.empty() == false) {
+        boost::mutex::scoped_lock lock(queue->mutex);
+        queue->tasks.push_back(right_task);
+        queue->condition.notify_one();
+      }
+      task = left_task;
+    }
+    {
+      boost::mutex::scoped_lock lock(queue->mutex);
+      --queue->busy_threads;
+      if (queue->busy_threads == 0 && queue->tasks.empty()) {
+        queue->condition.notify_all();
+      }
+    }
+  }
+}
+
+/**
+ * Visits the reference nodes of a query subtree the way the recursion
+ * does before it splits the query node, and hands the pairs that cannot
+ * be summarized to the children. Every pair is visited before the
+ * children run, so the summaries it sees are looser than in the single
+ * thread recursion and it prunes less, never with a bigger error. The
+ * failure probability is halved for both reference children, since the
+ * first one has not run yet
+ */
+template<typename ProblemType>
+template<typename MetricType>
+void fl::ml::DualtreeDfs<ProblemType>::SplitQueryTask_(
+  const MetricType &metric,
+  const QueryTask_ &task,
+  QueryTask_ *left_task,
+  QueryTask_ *right_task,
+  typename ProblemType::Result_t *query_results) {
+
+  typename ProblemType::Table_t::Tree_t *qnode = task.qnode;
+  left_task->qnode = query_table_->get_node_left_child(qnode);
+  left_task->depth = task.depth + 1;
+  right_task->qnode = query_table_->get_node_right_child(qnode);
+  right_task->depth = task.depth + 1;
+  QueryTask_ *children[2] = {left_task, right_task};
+  for (size_t i = 0; i < task.references.size(); ++i) {
+    typename ProblemType::Table_t::Tree_t *rnode = task.references[i].rnode;
+    double failure_probability = task.references[i].failure_probability;
+
+    // Compute the delta change.
+    typename ProblemType::Delta_t delta;
+    delta.DeterministicCompute(metric, problem_->global(), qnode, rnode,
+                               task.references[i].squared_distance_range);
+    if (CanSummarize_(qnode, rnode, delta, query_results)) {
+      Summarize_(qnode, delta, query_results);
+      continue;
+    }
+    typename ProblemType::Series_t series;
+    if (CanSeriesSummarize_(metric, qnode, rnode, delta, &series,
+                            query_results)) {
+      SeriesSummarize_(qnode, rnode, delta, series, query_results);
+      continue;
+    }
+    if (failure_probability > 1e-6 &&
+        CanProbabilisticSummarize_(metric, qnode, rnode,
+                                   failure_probability,
+                                   delta, query_results)) {
+      ProbabilisticSummarize_(problem_->global(), qnode,
+                              failure_probability,
+                              delta, query_results);
+      continue;
+    }
+    for (int j = 0; j < 2; ++j) {
+      if (reference_table_->node_is_leaf(rnode)) {
+        children[j]->references.push_back(ReferenceVisit_(
+            rnode, failure_probability,
+            query_table_->get_node_bound(children[j]->qnode).RangeDistanceSq(
+              metric, reference_table_->get_node_bound(rnode))));
+        continue;
+      }
+      typename ProblemType::Table_t::Tree_t *rnode_first;
+      GenRange<double> squared_distance_range_first,
+      squared_distance_range_second;
+      typename ProblemType::Table_t::Tree_t *rnode_second;
+      Heuristic_(metric, children[j]->qnode, query_table_,
+                 reference_table_->get_node_left_child(rnode),
+                 reference_table_->get_node_right_child(rnode),
+                 reference_table_,
+                 &rnode_first, squared_distance_range_first,
+                 &rnode_second, squared_distance_range_second);
+      children[j]->references.push_back(ReferenceVisit_(
+          rnode_first, failure_probability / 2.0,
+          squared_distance_range_first));
+      children[j]->references.push_back(ReferenceVisit_(
+          rnode_second, failure_probability / 2.0,
+          squared_distance_range_second));
+    }
+  }
+
+  // Push down postponed and clear.
+  typename ProblemType::Statistic_t &qnode_stat =
+    query_statistics_->at(query_table_->get_node_id(qnode));
+  query_statistics_->at(query_table_->get_node_id(left_task->qnode)).
+    postponed.ApplyPostponed(qnode_stat.postponed);
+  query_statistics_->at(query_table_->get_node_id(right_task->qnode)).
+    postponed.ApplyPostponed(qnode_stat.postponed);
+  qnode_stat.postponed.SetZero();
+}
+
 template<typename ProblemType>
 void fl::ml::DualtreeDfs<ProblemType>::ResetStatisticRecursion_(
   typename ProblemType::Table_t::Tree_t *node,
@@ -184,6 +387,13 @@ void fl::ml::DualtreeDfs<ProblemType>::DualtreeBase_(
   typename ProblemType::Table_t::TreeIterator rnode_iterator =
     reference_table_->get_node_iterator(rnode);
 
+  // The reference points are gathered in blocks and their distances
+  // to the query point computed together, so that the metric can use
+  // a vectorized kernel
+  const index_t block_size = fl::dense::simd::kBlockSize;
+  typename ProblemType::Point_t block_points[block_size];
+  typename ProblemType::Point_t::CalcPrecision_t block_distances[block_size];
+
   // Compute unnormalized sum for each query point.
   while (qnode_iterator.HasNext()) {
 
@@ -201,34 +411,28 @@ void fl::ml::DualtreeDfs<ProblemType>::DualtreeBase_(
 
     // Reset the reference node iterator.
     rnode_iterator.Reset();
-    if (qnode==rnode) {
-      while (rnode_iterator.HasNext()) {
-        // Get the reference point and accumulate contribution.
-        typename ProblemType::Point_t r_col;
+    while (rnode_iterator.HasNext()) {
+      index_t block = 0;
+      while (block < block_size && rnode_iterator.HasNext()) {
+        // Get the reference point
         index_t r_col_id;
-        rnode_iterator.Next(&r_col, &r_col_id);
-        if (filter_.FilterOut(q_col, r_col)==true) {
-          continue;
-        }
-        if (q_index==r_col_id) {
+        rnode_iterator.Next(&block_points[block], &r_col_id);
+        if (filter_.FilterOut(q_col, block_points[block])==true) {
           continue;
         }
-        query_contribution.ApplyContribution(problem_->global(),
-                                           metric, q_col, r_col);
-      } // end of iterating over each reference point.
-    } else  {
-      while (rnode_iterator.HasNext()) {
-        // Get the reference point and accumulate contribution.
-        typename ProblemType::Point_t r_col;
-        index_t r_col_id;
-        rnode_iterator.Next(&r_col, &r_col_id);
-        if (filter_.FilterOut(q_col, r_col)==true) {
+        if (qnode==rnode && q_index==r_col_id) {
           continue;
         }
+        block++;
+      }
+      // and accumulate the contributions
+      fl::math::DistanceSqBlock(metric, q_col, block_points, block,
+                                block_distances);
+      for (index_t i = 0; i < block; ++i) {
         query_contribution.ApplyContribution(problem_->global(),
-                                           metric, q_col, r_col);
-      } // end of iterating over each reference point.
-    }
+            block_distances[i], block_points[i]);
+      }
+    } // end of iterating over each reference point.
     // Each query point has taken care of all reference points.
     query_results->ApplyPostponed(q_index, query_contribution);
 
@@ -257,6 +461,9 @@ bool fl::ml::DualtreeDfs<ProblemType>::CanProbabilisticSummarize_(
   new_summary.ApplyPostponed(qnode_stat.postponed);
   new_summary.ApplyDelta(delta);
 
+  // the samples come from the random generator of fl::math, the
+  // threads cannot draw from it at the same time
+  boost::mutex::scoped_lock lock(random_mutex_);
   return new_summary.CanProbabilisticSummarize(metric,
          problem_->global(), delta, qnode, rnode, failure_probability,
          query_results);
@@ -269,6 +476,10 @@ bool fl::ml::DualtreeDfs<ProblemType>::CanSummarize_(
   const typename ProblemType::Delta_t &delta,
   typename ProblemType::Result_t *query_results) {
 
+  if (NodesShareAPoint(query_table_, qnode, reference_table_, rnode)) {
+    return false;
+  }
+
   typename ProblemType::Statistic_t &qnode_stat =
     query_statistics_->at(query_table_->get_node_id(qnode));
   typename ProblemType::Summary_t new_summary(qnode_stat.summary);
@@ -303,6 +514,42 @@ void fl::ml::DualtreeDfs<ProblemType>::Summarize_(
   qnode_stat.postponed.ApplyDelta(delta, query_results);
 }
 
+template<typename ProblemType>
+template<typename MetricType>
+bool fl::ml::DualtreeDfs<ProblemType>::CanSeriesSummarize_(
+  const MetricType &metric,
+  typename ProblemType::Table_t::Tree_t *qnode,
+  typename ProblemType::Table_t::Tree_t *rnode,
+  const typename ProblemType::Delta_t &delta,
+  typename ProblemType::Series_t *series,
+  typename ProblemType::Result_t *query_results) {
+
+  // the expansions sum over every reference point, they cannot leave
+  // out the ones the filter drops
+  if (boost::is_same<PointFilter_t, fl::table::NullFilter>::value == false) {
+    return false;
+  }
+  typename ProblemType::Statistic_t &qnode_stat =
+    query_statistics_->at(query_table_->get_node_id(qnode));
+  typename ProblemType::Summary_t new_summary(qnode_stat.summary);
+  new_summary.ApplyPostponed(qnode_stat.postponed);
+  new_summary.ApplyDelta(delta);
+
+  return series->CanSummarize(metric, problem_->global(), delta,
+                              new_summary, qnode, rnode, query_results);
+}
+
+template<typename ProblemType>
+void fl::ml::DualtreeDfs<ProblemType>::SeriesSummarize_(
+  typename ProblemType::Table_t::Tree_t *qnode,
+  typename ProblemType::Table_t::Tree_t *rnode,
+  const typename ProblemType::Delta_t &delta,
+  typename ProblemType::Series_t &series,
+  typename ProblemType::Result_t *query_results) {
+
+  series.Summarize(problem_->global(), delta, qnode, rnode, query_results);
+}
+
 template<typename ProblemType>
 template<typename MetricType>
 void fl::ml::DualtreeDfs<ProblemType>::Heuristic_(
@@ -361,7 +608,16 @@ bool fl::ml::DualtreeDfs<ProblemType>::DualtreeCanonical_(
     Summarize_(qnode, delta, query_results);
     return true;
   }
-  else if (failure_probability > 1e-6) {
+
+  // Otherwise a series expansion might be cheaper than the base case,
+  // its error is bounded as well.
+  typename ProblemType::Series_t series;
+  if (CanSeriesSummarize_(metric, qnode, rnode, delta, &series,
+                          query_results)) {
+    SeriesSummarize_(qnode, rnode, delta, series, query_results);
+    return true;
+  }
+  if (failure_probability > 1e-6) {
 
     // Try Monte Carlo.
     if (CanProbabilisticSummarize_(metric, qnode, rnode,
@@ -59,6 +59,31 @@ void fl::ml::Kde<TemplateMap>::Init(
   double relative_error_in,
   double probability_in) {
 
+  InitTables_(reference_table, query_table);
+
+  // Declare the global constants.
+  global_.Init(reference_table_, query_table_, NULL, bandwidth_in, is_monochromatic_,
+               relative_error_in, probability_in);
+}
+
+template<typename TemplateMap>
+void fl::ml::Kde<TemplateMap>::Init(
+  typename fl::ml::Kde<TemplateMap>::Table_t *reference_table,
+  typename fl::ml::Kde<TemplateMap>::Table_t *query_table,
+  const std::vector<double> &bandwidths_in,
+  double relative_error_in,
+  double probability_in) {
+
+  InitTables_(reference_table, query_table);
+  global_.Init(reference_table_, query_table_, NULL, bandwidths_in,
+               is_monochromatic_, relative_error_in, probability_in);
+}
+
+template<typename TemplateMap>
+void fl::ml::Kde<TemplateMap>::InitTables_(
+  typename fl::ml::Kde<TemplateMap>::Table_t *reference_table,
+  typename fl::ml::Kde<TemplateMap>::Table_t *query_table) {
+
   if (reference_table == NULL) {
     fl::logger->Die()<<"Reference table cannot be NULL";
   }
@@ -71,10 +96,6 @@ void fl::ml::Kde<TemplateMap>::Init(
     is_monochromatic_ = false;
     query_table_ = query_table;
   }
-
-  // Declare the global constants.
-  global_.Init(reference_table_, query_table_, NULL, bandwidth_in, is_monochromatic_,
-               relative_error_in, probability_in);
 }
 
 template<typename DensityTableType, typename QueryLabelsTableType>
@@ -0,0 +1,174 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef FL_LITE_MLPACK_KDE_KDE_LSCV_GRID_H
+#define FL_LITE_MLPACK_KDE_KDE_LSCV_GRID_H
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "fastlib/base/base.h"
+#include "fastlib/math/fl_math.h"
+#include "mlpack/kde/kde.h"
+#include "mlpack/kde/dualtree_dfs.h"
+
+namespace fl {
+namespace ml {
+
+/**
+ * @brief Scores a grid of bandwidths with the least squares cross
+ *        validation of the gaussian kernel. For every bandwidth h the
+ *        score needs the leave one out densities for h and for sqrt(2)h,
+ *        all of them come from a single monochromatic traversal of
+ *        DualtreeDfs with the KdeGridStructArgs computation.
+ *  @code
+ *   LSCV(h) = 1/n^2 sum_i sum_j K_{sqrt(2)h}(x_i, x_j)
+ *             - 2/n sum_i f_{-i}(x_i)
+ *  @endcode
+ */
+template<typename TemplateArgs>
+class KdeLscvGrid {
+
+  public:
+
+    typedef fl::ml::Kde<TemplateArgs> Kde_t;
+
+    typedef typename TemplateArgs::TableType Table_t;
+
+    typedef typename Kde_t::Result_t Result_t;
+
+    KdeLscvGrid() {
+      n_threads_ = 1;
+      relative_error_ = 0;
+      reference_table_ = NULL;
+    }
+
+    /**
+     * @brief The default grid, 17 bandwidths from 1/4 to 4 times the
+     *        plugin bandwidth evenly spaced in log scale
+     */
+    static void DefaultGrid(double plugin_bandwidth,
+                            std::vector<double> *bandwidths) {
+      bandwidths->resize(0);
+      for (int i = -8; i <= 8; ++i) {
+        bandwidths->push_back(plugin_bandwidth * pow(2.0, i / 4.0));
+      }
+    }
+
+    void Init(Table_t *reference_table,
+              const std::vector<double> &bandwidths,
+              double relative_error) {
+      if (bandwidths.empty()) {
+        fl::logger->Die() << "The grid of bandwidths is empty";
+      }
+      reference_table_ = reference_table;
+      bandwidths_ = bandwidths;
+      relative_error_ = relative_error;
+      scores_.resize(0);
+    }
+
+    void set_n_threads(int n_threads) {
+      n_threads_ = n_threads;
+    }
+
+    const std::vector<double> &bandwidths() const {
+      return bandwidths_;
+    }
+
+    /**
+     * @brief The LSCV score of every bandwidth, valid after Compute
+     */
+    const std::vector<double> &scores() const {
+      return scores_;
+    }
+
+    double optimal_bandwidth() const {
+      return bandwidths_[Best_()];
+    }
+
+    double optimal_score() const {
+      return scores_[Best_()];
+    }
+
+    template<typename MetricType>
+    void Compute(const MetricType &metric) {
+      const int n_bandwidths = bandwidths_.size();
+      std::vector<double> grid(bandwidths_);
+      for (int i = 0; i < n_bandwidths; ++i) {
+        grid.push_back(sqrt(2.0) * bandwidths_[i]);
+      }
+      Kde_t kde_instance;
+      kde_instance.Init(reference_table_, NULL, grid, relative_error_, 1.0);
+      fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
+      dualtree_engine.Init(kde_instance);
+      dualtree_engine.set_n_threads(n_threads_);
+      Result_t result;
+      dualtree_engine.Compute(metric, &result);
+
+      const double num_points = reference_table_->n_entries();
+      const int dimension = reference_table_->n_attributes();
+      scores_.resize(n_bandwidths);
+      for (int i = 0; i < n_bandwidths; ++i) {
+        double leave_one_out = 0;
+        double convolution = 0;
+        for (index_t q = 0; q < reference_table_->n_entries(); ++q) {
+          leave_one_out += result.densities_[q][i];
+          convolution += result.densities_[q][n_bandwidths + i];
+        }
+        // The densities leave the point itself out, the convolution
+        // needs it back.
+        convolution = ((num_points - 1) * convolution + num_points /
+                       kde_instance.global().kernel(n_bandwidths + i).
+                       CalcNormConstant(dimension)) /
+                      fl::math::Sqr(num_points);
+        scores_[i] = convolution - 2.0 * leave_one_out / num_points;
+      }
+    }
+
+  private:
+    /** The index of the lowest score */
+    int Best_() const {
+      int best = 0;
+      for (int i = 1; i < static_cast<int>(scores_.size()); ++i) {
+        if (scores_[i] < scores_[best]) {
+          best = i;
+        }
+      }
+      return best;
+    }
+
+    Table_t *reference_table_;
+
+    std::vector<double> bandwidths_;
+
+    std::vector<double> scores_;
+
+    double relative_error_;
+
+    int n_threads_;
+};
+}
+}
+
+#endif
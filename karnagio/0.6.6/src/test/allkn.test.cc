@@ -0,0 +1,382 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define BOOST_TEST_MAIN
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "boost/test/unit_test.hpp"
+#include "mlpack/allkn/allkn_dev.h"
+#include "fastlib/table/default/dense/labeled/kdtree/table.h"
+
+namespace {
+
+typedef fl::table::dense::labeled::kdtree::Table Table_t;
+
+/**
+ *  Points around a few centers, so that the trees prune. The centers
+ *  are moved by offset from the origin
+ */
+void RandomTable(index_t n_entries, index_t dimension, Table_t *table,
+                 double offset = 0) {
+  table->Init(std::vector<index_t>(1, dimension), std::vector<index_t>(),
+              n_entries);
+  std::vector<std::vector<double> > centers(5,
+      std::vector<double>(dimension));
+  for (size_t i = 0; i < centers.size(); ++i) {
+    for (index_t j = 0; j < dimension; ++j) {
+      centers[i][j] = offset + fl::math::Random(0.0, 10.0);
+    }
+  }
+  for (index_t i = 0; i < n_entries; ++i) {
+    Table_t::Point_t point;
+    table->get(i, &point);
+    const std::vector<double> &center = centers[i % centers.size()];
+    for (index_t j = 0; j < dimension; ++j) {
+      point.set(j, center[j] + fl::math::Random(-2.0, 2.0));
+    }
+  }
+  Table_t::IndexArgs<fl::math::LMetric<2> > index_args;
+  index_args.leaf_size = 10;
+  table->IndexData(index_args);
+}
+
+template<int mode>
+struct AllKNMap : public fl::ml::AllKNArgs {
+  typedef Table_t QueryTableType;
+  typedef Table_t ReferenceTableType;
+  typedef typename boost::mpl::int_<mode>::type KNmode;
+};
+
+/**
+ *  The k neighbors of every query found with n_threads threads,
+ *  queries is NULL for the monochromatic computation
+ */
+template<int mode>
+void KNeighbors(Table_t *references, Table_t *queries,
+                const std::string &traversal, index_t k, int n_threads,
+                std::vector<double> *distances,
+                std::vector<index_t> *indices) {
+  fl::ml::AllKN<AllKNMap<mode> > allkn;
+  allkn.Init(references, queries);
+  allkn.set_n_threads(n_threads);
+  allkn.ComputeNeighbors(traversal, fl::math::LMetric<2>(), k,
+                         distances, indices);
+}
+
+/**
+ *  The parallel traversal replays the single thread recursion on
+ *  every query subtree, so the neighbors must be exactly the same
+ */
+template<int mode>
+void TestSameNeighbors(Table_t *references, Table_t *queries) {
+  const char *traversals[] = {"dual", "single", "naive"};
+  for (size_t t = 0; t < 3; ++t) {
+    std::vector<double> distances;
+    std::vector<index_t> indices;
+    KNeighbors<mode>(references, queries, traversals[t], 4, 1,
+                     &distances, &indices);
+    BOOST_REQUIRE_EQUAL(indices.size(), 4 *
+        (queries == NULL ? references : queries)->n_entries());
+    for (int n_threads = 2; n_threads <= 5; n_threads += 3) {
+      std::vector<double> parallel_distances;
+      std::vector<index_t> parallel_indices;
+      KNeighbors<mode>(references, queries, traversals[t], 4, n_threads,
+                       &parallel_distances, &parallel_indices);
+      BOOST_CHECK(parallel_indices == indices);
+      BOOST_CHECK(parallel_distances == distances);
+    }
+  }
+}
+
+/**
+ *  The squared distances of every query to all the references, sorted
+ */
+void ScanDistances(Table_t *references, Table_t *queries,
+                   std::vector<std::vector<double> > *distances) {
+  fl::math::LMetric<2> metric;
+  distances->resize(queries->n_entries());
+  for (index_t q = 0; q < queries->n_entries(); ++q) {
+    Table_t::Point_t query;
+    queries->get(q, &query);
+    for (index_t r = 0; r < references->n_entries(); ++r) {
+      Table_t::Point_t point;
+      references->get(r, &point);
+      (*distances)[q].push_back(metric.DistanceSq(query, point));
+    }
+    std::sort((*distances)[q].begin(), (*distances)[q].end());
+  }
+}
+
+/**
+ *  Every (1+epsilon) approximate neighbor must be within the relative
+ *  error from the exact neighbor of the same rank, the distances are
+ *  squared
+ */
+template<int mode>
+void TestEpsilonBound(Table_t *references, Table_t *queries,
+                 const std::string &traversal) {
+  const index_t k = 3;
+  const double epsilon = 0.5;
+  std::vector<double> exact;
+  std::vector<index_t> exact_indices;
+  KNeighbors<mode>(references, queries, traversal, k, 1,
+                   &exact, &exact_indices);
+  fl::ml::AllKN<AllKNMap<mode> > allkn;
+  allkn.Init(references, queries);
+  allkn.set_epsilon(epsilon);
+  allkn.set_recall_sample(20);
+  std::vector<double> distances;
+  std::vector<index_t> indices;
+  allkn.ComputeNeighbors(traversal, fl::math::LMetric<2>(), k,
+                         &distances, &indices);
+  BOOST_REQUIRE_EQUAL(distances.size(), exact.size());
+  const double factor = (1 + epsilon) * (1 + epsilon) * (1 + 1e-12);
+  for (size_t i = 0; i < distances.size(); ++i) {
+    if (mode == 0) {
+      BOOST_CHECK(distances[i] >= exact[i] * (1 - 1e-12));
+      BOOST_CHECK(distances[i] <= exact[i] * factor);
+    } else {
+      BOOST_CHECK(distances[i] <= exact[i] * (1 + 1e-12));
+      BOOST_CHECK(distances[i] * factor >= exact[i]);
+    }
+  }
+  BOOST_CHECK(allkn.recall() >= 0 && allkn.recall() <= 1);
+}
+
+typedef std::vector<std::pair<std::pair<index_t, index_t>, double> >
+  RangePairs_t;
+
+/**
+ *  Collects the pairs ComputeRangeJoin streams and checks that all the
+ *  pairs of a query come in the same call
+ */
+struct RangePairCollector {
+  RangePairCollector() : valid(true) {
+  }
+  template<typename ContainerIndType, typename ContainerDistType>
+  void operator()(const ContainerIndType &indices,
+                  const ContainerDistType &distances) {
+    std::set<index_t> queries;
+    for (size_t i = 0; i < indices.size(); ++i) {
+      pairs.push_back(std::make_pair(indices[i], distances[i]));
+      if (queries.insert(indices[i].first).second &&
+          seen.insert(indices[i].first).second == false) {
+        valid = false;
+      }
+    }
+  }
+  RangePairs_t pairs;
+  std::set<index_t> seen;
+  bool valid;
+};
+
+/**
+ *  The range neighbors found with n_threads threads, sorted
+ */
+void RangeNeighbors(Table_t *references, Table_t *queries,
+                    const std::string &traversal, double range,
+                    int n_threads, RangePairs_t *pairs) {
+  fl::ml::AllKN<AllKNMap<0> > allkn;
+  allkn.Init(references, queries);
+  allkn.set_n_threads(n_threads);
+  std::vector<double> distances;
+  std::vector<std::pair<index_t, index_t> > indices;
+  allkn.ComputeNeighbors(traversal, fl::math::LMetric<2>(), range,
+                         &distances, &indices);
+  pairs->clear();
+  for (size_t i = 0; i < indices.size(); ++i) {
+    pairs->push_back(std::make_pair(indices[i], distances[i]));
+  }
+  std::sort(pairs->begin(), pairs->end());
+}
+
+/**
+ *  The range neighbors of many threads and the pairs the range join
+ *  streams must be the pairs of a single thread, in any order
+ */
+void TestSamePairs(Table_t *references, Table_t *queries, double range) {
+  const char *traversals[] = {"dual", "single", "naive"};
+  for (size_t t = 0; t < 3; ++t) {
+    RangePairs_t pairs;
+    RangeNeighbors(references, queries, traversals[t], range, 1, &pairs);
+    BOOST_REQUIRE(pairs.empty() == false);
+    RangePairs_t parallel_pairs;
+    RangeNeighbors(references, queries, traversals[t], range, 3,
+                   &parallel_pairs);
+    BOOST_CHECK(parallel_pairs == pairs);
+    fl::ml::AllKN<AllKNMap<0> > allkn;
+    allkn.Init(references, queries);
+    allkn.set_n_threads(3);
+    RangePairCollector collector;
+    allkn.ComputeRangeJoin(traversals[t], fl::math::LMetric<2>(), range,
+                           &collector);
+    std::sort(collector.pairs.begin(), collector.pairs.end());
+    BOOST_CHECK(collector.valid);
+    BOOST_CHECK(collector.pairs == pairs);
+  }
+}
+
+/**
+ *  The blocked search must find the neighbors and the distances of the
+ *  naive search, with one thread and with many
+ */
+template<int mode>
+void TestBlockedNeighbors(Table_t *references, Table_t *queries) {
+  const index_t ks[] = {1, 10};
+  for (size_t i = 0; i < 2; ++i) {
+    std::vector<double> distances;
+    std::vector<index_t> indices;
+    KNeighbors<mode>(references, queries, "naive", ks[i], 1,
+                     &distances, &indices);
+    for (int n_threads = 1; n_threads <= 3; n_threads += 2) {
+      std::vector<double> blocked_distances;
+      std::vector<index_t> blocked_indices;
+      KNeighbors<mode>(references, queries, "blocked", ks[i], n_threads,
+                       &blocked_distances, &blocked_indices);
+      BOOST_CHECK(blocked_indices == indices);
+      BOOST_CHECK(blocked_distances == distances);
+    }
+  }
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(TestSuiteAllKN)
+
+BOOST_AUTO_TEST_CASE(TestThreads) {
+  fl::mtn19937_gen.seed(11);
+  Table_t references;
+  RandomTable(2000, 4, &references);
+  Table_t queries;
+  RandomTable(300, 4, &queries);
+  TestSameNeighbors<0>(&references, &queries);
+  TestSameNeighbors<1>(&references, &queries);
+  TestSameNeighbors<0>(&references, NULL);
+}
+
+// the range neighbors do not depend on the threads and the range join
+// streams the same pairs
+BOOST_AUTO_TEST_CASE(TestRangeJoin) {
+  fl::mtn19937_gen.seed(19);
+  Table_t references;
+  RandomTable(2000, 3, &references);
+  Table_t queries;
+  RandomTable(300, 3, &queries);
+  TestSamePairs(&references, &queries, 0.1);
+  TestSamePairs(&references, NULL, 0.1);
+}
+
+// the (1+epsilon) neighbors are within the bound, for nearest and
+// furthest neighbors
+BOOST_AUTO_TEST_CASE(TestEpsilon) {
+  fl::mtn19937_gen.seed(13);
+  Table_t references;
+  RandomTable(3000, 5, &references);
+  Table_t queries;
+  RandomTable(200, 5, &queries);
+  TestEpsilonBound<0>(&references, &queries, "dual");
+  TestEpsilonBound<0>(&references, &queries, "single");
+  TestEpsilonBound<1>(&references, &queries, "dual");
+  TestEpsilonBound<1>(&references, &queries, "single");
+}
+
+// with probability alpha all the rank approximate neighbors of a query
+// are among the tau percent closest references. The samples are seeded
+// with the node ids, so the threads find the same neighbors
+BOOST_AUTO_TEST_CASE(TestRankApproximation) {
+  fl::mtn19937_gen.seed(17);
+  Table_t references;
+  RandomTable(5000, 3, &references);
+  Table_t queries;
+  RandomTable(200, 3, &queries);
+  const index_t k = 3;
+  const double tau = 2;
+  const double alpha = 0.95;
+  std::vector<std::vector<double> > scan;
+  ScanDistances(&references, &queries, &scan);
+  const index_t top = static_cast<index_t>(
+      std::ceil(tau / 100 * references.n_entries()));
+  const char *traversals[] = {"dual", "single"};
+  for (size_t t = 0; t < 2; ++t) {
+    fl::ml::AllKN<AllKNMap<0> > allkn;
+    allkn.Init(&references, &queries);
+    allkn.set_rank_approximation(tau, alpha, 1000);
+    std::vector<double> distances;
+    std::vector<index_t> indices;
+    allkn.ComputeNeighbors(traversals[t], fl::math::LMetric<2>(), k,
+                           &distances, &indices);
+    std::vector<double> parallel_distances;
+    std::vector<index_t> parallel_indices;
+    allkn.set_n_threads(3);
+    allkn.ComputeNeighbors(traversals[t], fl::math::LMetric<2>(), k,
+                           &parallel_distances, &parallel_indices);
+    BOOST_CHECK(parallel_indices == indices);
+    index_t within = 0;
+    for (index_t q = 0; q < queries.n_entries(); ++q) {
+      bool all_within = true;
+      for (index_t j = 0; j < k; ++j) {
+        BOOST_CHECK(distances[q * k + j] >= scan[q][j] * (1 - 1e-12));
+        all_within = all_within
+          && distances[q * k + j] <= scan[q][top - 1];
+      }
+      within += all_within;
+    }
+    // the queries of a node share the sample, so the fraction varies
+    // more than with independent queries
+    BOOST_CHECK(within >= (alpha - 0.05) * queries.n_entries());
+  }
+}
+
+// the blocked search computes the distances with gemm, far from the
+// origin the expansion loses the digits that order the neighbors, the
+// candidates are recomputed with the metric
+BOOST_AUTO_TEST_CASE(TestBlocked) {
+  fl::mtn19937_gen.seed(23);
+  Table_t references;
+  RandomTable(1500, 20, &references);
+  Table_t queries;
+  RandomTable(150, 20, &queries);
+  TestBlockedNeighbors<0>(&references, &queries);
+  TestBlockedNeighbors<1>(&references, &queries);
+  TestBlockedNeighbors<0>(&references, NULL);
+  Table_t far_references;
+  RandomTable(1500, 4, &far_references, 1e6);
+  Table_t far_queries;
+  RandomTable(150, 4, &far_queries, 1e6);
+  TestBlockedNeighbors<0>(&far_references, &far_queries);
+  TestBlockedNeighbors<1>(&far_references, &far_queries);
+  RangePairs_t pairs;
+  RangeNeighbors(&references, &queries, "naive", 300, 1, &pairs);
+  BOOST_REQUIRE(pairs.empty() == false);
+  RangePairs_t blocked_pairs;
+  RangeNeighbors(&references, &queries, "blocked", 300, 3, &blocked_pairs);
+  BOOST_CHECK(blocked_pairs == pairs);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,166 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define BOOST_TEST_MAIN
+#include <algorithm>
+#include <vector>
+#include "boost/test/unit_test.hpp"
+#include "mlpack/allkn/allkn_service_defs.h"
+#include "fastlib/table/default/dense/labeled/kdtree/table.h"
+
+namespace {
+
+typedef fl::table::dense::labeled::kdtree::Table Table_t;
+typedef fl::ml::AllKNService<boost::mpl::void_>::QueryBatcher<Table_t>
+  Batcher_t;
+
+/**
+ *  Fills the table with random points and keeps a copy of them in
+ *  points, the ids the service answers with are the rows of points
+ */
+void RandomTable(index_t n_entries, index_t dimension, Table_t *table,
+                 std::vector<std::vector<double> > *points) {
+  table->Init(std::vector<index_t>(1, dimension), std::vector<index_t>(),
+              n_entries);
+  points->resize(n_entries, std::vector<double>(dimension));
+  for (index_t i = 0; i < n_entries; ++i) {
+    Table_t::Point_t point;
+    table->get(i, &point);
+    for (index_t j = 0; j < dimension; ++j) {
+      (*points)[i][j] = fl::math::Random(0.0, 10.0);
+      point.set(j, (*points)[i][j]);
+    }
+  }
+}
+
+/**
+ *  Asks for the k nearest neighbors of n_points random points and checks
+ *  them against a linear scan of the references
+ */
+void CheckQueries(Batcher_t *batcher,
+                  const std::vector<std::vector<double> > *references,
+                  index_t k, index_t n_points, int *n_failed) {
+  const index_t dimension = (*references)[0].size();
+  fl::ml::KnnRequest request;
+  fl::ml::KnnResponse response;
+  request.k = k;
+  request.dimension = dimension;
+  for (index_t i = 0; i < n_points * dimension; ++i) {
+    request.points.push_back(fl::math::Random(0.0, 10.0));
+  }
+  batcher->Query(request, &response);
+  if (response.error != ""
+      || static_cast<index_t>(response.indices.size()) != n_points * k) {
+    ++(*n_failed);
+    return;
+  }
+  for (index_t q = 0; q < n_points; ++q) {
+    std::vector<std::pair<double, index_t> > scan;
+    for (size_t i = 0; i < references->size(); ++i) {
+      double distance = 0;
+      for (index_t j = 0; j < dimension; ++j) {
+        const double diff = (*references)[i][j]
+          - request.points[q * dimension + j];
+        distance += diff * diff;
+      }
+      scan.push_back(std::make_pair(distance, i));
+    }
+    std::sort(scan.begin(), scan.end());
+    for (index_t j = 0; j < k; ++j) {
+      if (response.indices[q * k + j] != scan[j].second
+          || std::fabs(response.distances[q * k + j] - scan[j].first) > 1e-8) {
+        ++(*n_failed);
+        return;
+      }
+    }
+  }
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(TestSuiteAllKNService)
+
+BOOST_AUTO_TEST_CASE(TestBatches) {
+  fl::mtn19937_gen.seed(3);
+  Table_t references;
+  std::vector<std::vector<double> > points;
+  RandomTable(2000, 4, &references, &points);
+  Table_t::IndexArgs<fl::math::LMetric<2> > index_args;
+  index_args.leaf_size = 20;
+  references.IndexData(index_args);
+  // a long window, so that the concurrent requests end up together
+  Batcher_t batcher(&references, 64, 20000, 20, 1);
+  batcher.Start();
+  std::vector<int> n_failed(8, 0);
+  boost::thread_group threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.create_thread(boost::bind(&CheckQueries, &batcher, &points,
+        1 + i % 4, 1 + i, &n_failed[i]));
+  }
+  threads.join_all();
+  batcher.Stop();
+  for (int i = 0; i < 8; ++i) {
+    BOOST_CHECK_EQUAL(n_failed[i], 0);
+  }
+  BOOST_CHECK_EQUAL(batcher.num_of_requests(), 8);
+  BOOST_CHECK(batcher.num_of_batches() < 8);
+}
+
+BOOST_AUTO_TEST_CASE(TestBadRequests) {
+  fl::mtn19937_gen.seed(5);
+  Table_t references;
+  std::vector<std::vector<double> > points;
+  RandomTable(100, 3, &references, &points);
+  Table_t::IndexArgs<fl::math::LMetric<2> > index_args;
+  index_args.leaf_size = 10;
+  references.IndexData(index_args);
+  Batcher_t batcher(&references, 64, 100, 10, 1);
+  batcher.Start();
+  fl::ml::KnnRequest request;
+  fl::ml::KnnResponse response;
+  request.k = 101;
+  request.dimension = 3;
+  request.points.assign(3, 1.0);
+  batcher.Query(request, &response);
+  BOOST_CHECK(response.error != "");
+  request.k = 2;
+  request.dimension = 2;
+  request.points.assign(4, 1.0);
+  batcher.Query(request, &response);
+  BOOST_CHECK(response.error != "");
+  request.dimension = 3;
+  request.points.assign(4, 1.0);
+  batcher.Query(request, &response);
+  BOOST_CHECK(response.error != "");
+  request.points.assign(6, 1.0);
+  batcher.Query(request, &response);
+  BOOST_CHECK_EQUAL(response.error, "");
+  BOOST_CHECK_EQUAL(response.indices.size(), 4);
+  batcher.Stop();
+  batcher.Query(request, &response);
+  BOOST_CHECK(response.error != "");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,120 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define BOOST_TEST_MAIN
+#include <fstream>
+#include <string>
+#include <vector>
+#include "boost/test/unit_test.hpp"
+#include "boost/filesystem.hpp"
+#include "fastlib/base/base.h"
+#include "fastlib/table/default_table.h"
+#include "fastlib/table/table_dev.h"
+#include "fastlib/data/multi_dataset_dev.h"
+
+namespace {
+  typedef fl::table::Table<fl::table::DefaultTableMap> Table_t;
+
+  /**
+   * @brief fills a table with random points in [0, 1)
+   */
+  void RandomTable(index_t n_entries, index_t n_attributes, Table_t *table) {
+    table->Init(std::vector<index_t>(1, n_attributes),
+                std::vector<index_t>(), n_entries);
+    Table_t::Point_t point;
+    for (index_t i = 0; i < n_entries; i++) {
+      table->get(i, &point);
+      for (index_t j = 0; j < n_attributes; j++) {
+        point.set(j, fl::math::Random(0.0, 1.0));
+      }
+    }
+  }
+
+  /**
+   * @brief the nodes of the two trees must cover the same points
+   *        in the same order
+   */
+  void CompareTrees(Table_t &table1, Table_t::Tree_t *node1,
+                    Table_t &table2, Table_t::Tree_t *node2) {
+    BOOST_REQUIRE_EQUAL(table1.get_node_id(node1), table2.get_node_id(node2));
+    BOOST_REQUIRE_EQUAL(table1.get_node_begin(node1),
+                        table2.get_node_begin(node2));
+    BOOST_REQUIRE_EQUAL(table1.get_node_count(node1),
+                        table2.get_node_count(node2));
+    BOOST_REQUIRE_EQUAL(table1.node_is_leaf(node1), table2.node_is_leaf(node2));
+    if (table1.node_is_leaf(node1) == false) {
+      CompareTrees(table1, table1.get_node_left_child(node1),
+                   table2, table2.get_node_left_child(node2));
+      CompareTrees(table1, table1.get_node_right_child(node1),
+                   table2, table2.get_node_right_child(node2));
+    }
+  }
+}
+
+// an indexed table saved in the binary format is attached with its
+// points, its tree and the permutation of the points
+BOOST_AUTO_TEST_CASE(TestBinaryTable) {
+  Table_t table1;
+  RandomTable(1000, 3, &table1);
+  Table_t::IndexArgs<fl::math::LMetric<2> > index_args;
+  index_args.leaf_size = 20;
+  table1.IndexData(index_args);
+  std::string binary_file = (boost::filesystem::temp_directory_path()
+      / "binary_table_test.fltb").string();
+  table1.SaveBinary(binary_file);
+  BOOST_REQUIRE(fl::data::IsBinaryTableFile(binary_file));
+
+  Table_t table2;
+  table2.data()->TryToInit(binary_file);
+  table2.Init(binary_file, "r");
+  BOOST_REQUIRE(table2.is_indexed());
+  BOOST_REQUIRE_EQUAL(table1.n_attributes(), table2.n_attributes());
+  BOOST_REQUIRE_EQUAL(table1.n_entries(), table2.n_entries());
+  BOOST_REQUIRE_EQUAL(table1.num_of_nodes(), table2.num_of_nodes());
+  CompareTrees(table1, table1.get_tree(), table2, table2.get_tree());
+  for (index_t i = 0; i < table1.n_entries(); i++) {
+    Table_t::Point_t point1;
+    Table_t::Point_t point2;
+    table1.get(i, &point1);
+    table2.get(i, &point2);
+    for (index_t j = 0; j < table1.n_attributes(); j++) {
+      BOOST_CHECK_EQUAL(point1[j], point2[j]);
+    }
+  }
+  boost::filesystem::remove(binary_file);
+}
+
+// a file that does not start with the magic number is not taken for
+// a binary table
+BOOST_AUTO_TEST_CASE(TestNotBinaryTable) {
+  std::string text_file = (boost::filesystem::temp_directory_path()
+      / "binary_table_test.csv").string();
+  {
+    std::ofstream fout(text_file.c_str());
+    fout << "1,2,3\n";
+  }
+  BOOST_CHECK(fl::data::IsBinaryTableFile(text_file) == false);
+  boost::filesystem::remove(text_file);
+}
@@ -0,0 +1,199 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define BOOST_TEST_MAIN
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "boost/archive/binary_iarchive.hpp"
+#include "boost/archive/binary_oarchive.hpp"
+#include "boost/test/unit_test.hpp"
+#include "mlpack/allkn/allkn_dev.h"
+#include "fastlib/table/default/dense/labeled/kdtree/table.h"
+#include "fastlib/table/table_dev.h"
+
+namespace {
+
+/**
+ *  The dense labeled kd-tree table with the node boxes stored in
+ *  StoragePrecision
+ */
+template<typename StoragePrecision>
+struct KdTreeMap {
+  struct TableArgs {
+    typedef fl::table::dense::labeled::kdtree::TableMap::TableArgs::DatasetArgs
+      DatasetArgs;
+    typedef fl::data::MultiDataset<DatasetArgs> DatasetType;
+    typedef boost::mpl::bool_<true> SortPoints;
+  };
+  struct TreeArgs : public fl::tree::TreeArgs {
+    typedef fl::tree::MidpointKdTree TreeSpecType;
+    typedef fl::tree::GenHrectBound<StoragePrecision, double, 2> BoundType;
+    typedef boost::mpl::bool_<true> SortPoints;
+  };
+};
+
+template<typename TableType>
+struct AllKNMap : public fl::ml::AllKNArgs {
+  typedef TableType QueryTableType;
+  typedef TableType ReferenceTableType;
+  typedef boost::mpl::int_<0>::type KNmode;
+};
+
+/**
+ *  The coordinates are offset by 1000, so that most of them are not
+ *  floats and the boxes have to be rounded
+ */
+template<typename TableType>
+void RandomTable(index_t n_entries, index_t dimension, TableType *table) {
+  table->Init(std::vector<index_t>(1, dimension), std::vector<index_t>(),
+              n_entries);
+  for (index_t i = 0; i < n_entries; ++i) {
+    typename TableType::Point_t point;
+    table->get(i, &point);
+    for (index_t j = 0; j < dimension; ++j) {
+      point.set(j, 1000 + fl::math::Random(0.0, 1e-3));
+    }
+  }
+}
+
+/**
+ *  Every box must contain its points and the distance bounds to them
+ *  must hold
+ */
+template<typename TableType>
+void CheckNode(TableType *table, typename TableType::Tree_t *node) {
+  fl::math::LMetric<2> metric;
+  const typename TableType::Tree_t::Bound_t &bound =
+    table->get_node_bound(node);
+  typename TableType::TreeIterator it = table->get_node_iterator(node);
+  typename TableType::Point_t first;
+  it.get(0, &first);
+  for (index_t i = 0; i < it.count(); ++i) {
+    typename TableType::Point_t point;
+    it.get(i, &point);
+    for (size_t d = 0; d < point.size(); ++d) {
+      BOOST_REQUIRE(bound.get(d).lo <= point[d]);
+      BOOST_REQUIRE(point[d] <= bound.get(d).hi);
+    }
+    BOOST_REQUIRE_EQUAL(bound.MinDistanceSq(metric, point), 0);
+    BOOST_REQUIRE(bound.MaxDistanceSq(metric, first)
+                  >= metric.DistanceSq(first, point));
+  }
+  if (!table->node_is_leaf(node)) {
+    CheckNode(table, table->get_node_left_child(node));
+    CheckNode(table, table->get_node_right_child(node));
+  }
+}
+
+template<typename TableType>
+void ComputeNeighbors(TableType *references, TableType *queries,
+                      std::vector<double> *distances,
+                      std::vector<index_t> *indices) {
+  fl::math::LMetric<2> metric;
+  fl::ml::AllKN<AllKNMap<TableType> > allkn;
+  allkn.Init(references, queries);
+  allkn.ComputeNeighbors(std::string("dual"), metric, index_t(3),
+                         distances, indices);
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(TestSuiteCompactBounds)
+
+BOOST_AUTO_TEST_CASE(TestFloatBoxesContainPoints) {
+  typedef fl::table::Table<KdTreeMap<float> > Table_t;
+  fl::mtn19937_gen.seed(7);
+  Table_t table;
+  RandomTable(2000, 5, &table);
+  Table_t::IndexArgs<fl::math::LMetric<2> > index_args;
+  index_args.leaf_size = 10;
+  table.IndexData(index_args);
+  CheckNode(&table, table.get_tree());
+}
+
+BOOST_AUTO_TEST_CASE(TestFloatBoxesAllKN) {
+  typedef fl::table::Table<KdTreeMap<float> > FloatTable_t;
+  typedef fl::table::Table<KdTreeMap<double> > DoubleTable_t;
+  FloatTable_t float_references, float_queries;
+  DoubleTable_t double_references, double_queries;
+  fl::mtn19937_gen.seed(9);
+  RandomTable(3000, 4, &float_references);
+  RandomTable(300, 4, &float_queries);
+  fl::mtn19937_gen.seed(9);
+  RandomTable(3000, 4, &double_references);
+  RandomTable(300, 4, &double_queries);
+  FloatTable_t::IndexArgs<fl::math::LMetric<2> > float_args;
+  float_args.leaf_size = 10;
+  float_references.IndexData(float_args);
+  float_queries.IndexData(float_args);
+  DoubleTable_t::IndexArgs<fl::math::LMetric<2> > double_args;
+  double_args.leaf_size = 10;
+  double_references.IndexData(double_args);
+  double_queries.IndexData(double_args);
+
+  // the float boxes are looser, pruning on them must still find the
+  // same neighbors
+  std::vector<double> float_distances, double_distances;
+  std::vector<index_t> float_indices, double_indices;
+  ComputeNeighbors(&float_references, &float_queries,
+                   &float_distances, &float_indices);
+  ComputeNeighbors(&double_references, &double_queries,
+                   &double_distances, &double_indices);
+  BOOST_REQUIRE_EQUAL(float_distances.size(), double_distances.size());
+  for (size_t i = 0; i < float_distances.size(); ++i) {
+    BOOST_REQUIRE_EQUAL(float_distances[i], double_distances[i]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestLoadDoubleBoxesAsFloat) {
+  typedef fl::table::Table<KdTreeMap<double> > Table_t;
+  fl::mtn19937_gen.seed(11);
+  Table_t table;
+  RandomTable(100, 3, &table);
+  Table_t::IndexArgs<fl::math::LMetric<2> > index_args;
+  index_args.leaf_size = 10;
+  table.IndexData(index_args);
+  const fl::tree::GenHrectBound<double, double, 2> &double_bound =
+    table.get_node_bound(table.get_tree());
+  std::stringstream stream;
+  {
+    boost::archive::binary_oarchive oa(stream);
+    oa << double_bound;
+  }
+  fl::tree::GenHrectBound<float, double, 2> float_bound;
+  {
+    boost::archive::binary_iarchive ia(stream);
+    ia >> float_bound;
+  }
+  BOOST_REQUIRE_EQUAL(float_bound.dim(), 3);
+  for (index_t d = 0; d < 3; ++d) {
+    BOOST_CHECK(float_bound.get(d).lo <= double_bound.get(d).lo);
+    BOOST_CHECK(float_bound.get(d).hi >= double_bound.get(d).hi);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
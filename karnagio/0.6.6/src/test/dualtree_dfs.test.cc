@@ -0,0 +1,217 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+#define BOOST_TEST_MAIN
+#include <cmath>
+#include <vector>
+#include "boost/test/unit_test.hpp"
+#include "fastlib/table/default/dense/labeled/kdtree/table.h"
+#include "fastlib/table/point_filters.h"
+#include "mlpack/kde/kde_dev.h"
+#include "mlpack/kde/kde_lscv_grid.h"
+
+namespace {
+
+typedef fl::table::dense::labeled::kdtree::Table Table_t;
+typedef fl::ml::Kde<boost::mpl::void_>::Core<Table_t> Core_t;
+typedef fl::ml::Kde<Core_t::KdeArgs<fl::math::GaussianKernel<double>,
+                                    fl::math::LMetric<2>,
+                                    fl::table::NullFilter,
+                                    Core_t::KdeStructArgs> > Kde_t;
+typedef Core_t::KdeArgs<fl::math::GaussianKernel<double>,
+                        fl::math::LMetric<2>,
+                        fl::table::NullFilter,
+                        Core_t::KdeGridStructArgs> KdeGridArgs_t;
+typedef fl::ml::Kde<KdeGridArgs_t> KdeGrid_t;
+
+/**
+ *  Makes a table with a few gaussian clusters, so that the kernel sums
+ *  of the query points are very different
+ */
+void ClusteredTable(index_t n_entries, index_t dimension, Table_t *table) {
+  table->Init(std::vector<index_t>(1, dimension), std::vector<index_t>(),
+              n_entries);
+  for (index_t i = 0; i < n_entries; ++i) {
+    Table_t::Point_t point;
+    table->get(i, &point);
+    const double center = fl::math::Random(0, 4);
+    for (index_t j = 0; j < dimension; ++j) {
+      point.set(j, fl::math::RandomNormal(center, 0.3));
+    }
+  }
+  Table_t::IndexArgs<fl::math::LMetric<2> > index_args;
+  index_args.leaf_size = 20;
+  table->IndexData(index_args);
+}
+
+/**
+ *  The density of the query point i, a monochromatic run leaves the
+ *  point itself out
+ */
+double NaiveDensity(Table_t *references, Table_t *queries,
+                    index_t i, double bandwidth) {
+  Table_t *query_table = queries == NULL ? references : queries;
+  fl::math::GaussianKernel<double> kernel;
+  kernel.Init(bandwidth);
+  const double norm = kernel.CalcNormConstant(references->n_attributes()) *
+    (queries == NULL ? references->n_entries() - 1 : references->n_entries());
+  fl::math::LMetric<2> metric;
+  Table_t::Point_t query;
+  query_table->get(i, &query);
+  double density = 0;
+  for (index_t j = 0; j < references->n_entries(); ++j) {
+    if (queries == NULL && i == j) {
+      continue;
+    }
+    Table_t::Point_t reference;
+    references->get(j, &reference);
+    density += kernel.EvalUnnormOnSq(metric.DistanceSq(query, reference));
+  }
+  return density / norm;
+}
+
+/**
+ *  Runs kde on n_threads threads and checks every density against the
+ *  naive sum with the relative error of the guarantee
+ */
+void TestDensities(Table_t *references, Table_t *queries,
+                   double bandwidth, int n_threads) {
+  const double relative_error = 0.01;
+  Kde_t kde_instance;
+  kde_instance.Init(references, queries, bandwidth, relative_error, 1.0);
+  fl::ml::DualtreeDfs<Kde_t> dualtree_engine;
+  dualtree_engine.Init(kde_instance);
+  dualtree_engine.set_n_threads(n_threads);
+  Kde_t::Result_t result;
+  dualtree_engine.Compute(fl::math::LMetric<2>(), &result);
+
+  Table_t *query_table = queries == NULL ? references : queries;
+  for (index_t i = 0; i < query_table->n_entries(); ++i) {
+    double density = NaiveDensity(references, queries, i, bandwidth);
+    BOOST_REQUIRE(std::fabs(result.densities_[i] - density) <=
+                  relative_error * density);
+  }
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(TestSuiteDualtreeDfs)
+// a monochromatic run leaves the query point out, the nodes that hold
+// it must not be summarized with the bounds that count it, even on a
+// single thread
+BOOST_AUTO_TEST_CASE(TestCaseMonochromatic) {
+  Table_t references;
+  ClusteredTable(2000, 3, &references);
+  TestDensities(&references, NULL, 0.05, 1);
+  TestDensities(&references, NULL, 0.5, 1);
+}
+BOOST_AUTO_TEST_CASE(TestCaseThreads) {
+  Table_t references;
+  ClusteredTable(3000, 3, &references);
+  Table_t queries;
+  ClusteredTable(1000, 3, &queries);
+  TestDensities(&references, NULL, 0.5, 1);
+  TestDensities(&references, NULL, 0.5, 4);
+  TestDensities(&references, &queries, 0.5, 1);
+  TestDensities(&references, &queries, 0.5, 3);
+}
+// with the wider bandwidths the far away clusters are summarized
+// with the series expansions
+BOOST_AUTO_TEST_CASE(TestCaseSeries) {
+  Table_t references;
+  ClusteredTable(4000, 3, &references);
+  Table_t queries;
+  ClusteredTable(1000, 3, &queries);
+  TestDensities(&references, NULL, 1.0, 1);
+  TestDensities(&references, NULL, 2.0, 3);
+  TestDensities(&references, &queries, 1.0, 1);
+  TestDensities(&references, &queries, 2.0, 1);
+}
+// every bandwidth of the grid must meet the error guarantee
+BOOST_AUTO_TEST_CASE(TestCaseBandwidthGrid) {
+  Table_t references;
+  ClusteredTable(2000, 3, &references);
+  Table_t queries;
+  ClusteredTable(500, 3, &queries);
+  std::vector<double> bandwidths;
+  bandwidths.push_back(0.05);
+  bandwidths.push_back(0.2);
+  // its kernel is the square of the next one
+  bandwidths.push_back(0.5);
+  bandwidths.push_back(sqrt(2.0) * 0.5);
+  bandwidths.push_back(2.0);
+  const double relative_error = 0.01;
+  for (int run = 0; run < 3; ++run) {
+    Table_t *query_table = run == 0 ? NULL : &queries;
+    KdeGrid_t kde_instance;
+    kde_instance.Init(&references, query_table, bandwidths,
+                      relative_error, 1.0);
+    fl::ml::DualtreeDfs<KdeGrid_t> dualtree_engine;
+    dualtree_engine.Init(kde_instance);
+    dualtree_engine.set_n_threads(run == 2 ? 3 : 1);
+    KdeGrid_t::Result_t result;
+    dualtree_engine.Compute(fl::math::LMetric<2>(), &result);
+    for (index_t i = 0; i < static_cast<index_t>(result.densities_.size());
+         ++i) {
+      BOOST_REQUIRE(result.densities_[i].size() == bandwidths.size());
+      for (size_t b = 0; b < bandwidths.size(); ++b) {
+        double density = NaiveDensity(&references, query_table, i,
+                                      bandwidths[b]);
+        BOOST_REQUIRE(std::fabs(result.densities_[i][b] - density) <=
+                      relative_error * density);
+      }
+    }
+  }
+
+  // the least squares cross validation scores of the grid
+  Table_t points;
+  ClusteredTable(400, 2, &points);
+  fl::ml::KdeLscvGrid<KdeGridArgs_t> lscv_grid;
+  lscv_grid.Init(&points, bandwidths, 0.0);
+  lscv_grid.Compute(fl::math::LMetric<2>());
+  fl::math::LMetric<2> metric;
+  const double n = points.n_entries();
+  for (size_t b = 0; b < bandwidths.size(); ++b) {
+    fl::math::GaussianKernel<double> convolution_kernel;
+    convolution_kernel.Init(sqrt(2.0) * bandwidths[b]);
+    double convolution = 0;
+    double leave_one_out = 0;
+    for (index_t i = 0; i < points.n_entries(); ++i) {
+      Table_t::Point_t point1;
+      points.get(i, &point1);
+      for (index_t j = 0; j < points.n_entries(); ++j) {
+        Table_t::Point_t point2;
+        points.get(j, &point2);
+        convolution += convolution_kernel.EvalUnnormOnSq(
+                         metric.DistanceSq(point1, point2));
+      }
+      leave_one_out += NaiveDensity(&points, NULL, i, bandwidths[b]);
+    }
+    convolution /= convolution_kernel.CalcNormConstant(2) * n * n;
+    double score = convolution - 2 * leave_one_out / n;
+    BOOST_REQUIRE(std::fabs(lscv_grid.scores()[b] - score) <=
+                  1e-6 * std::fabs(score));
+  }
+}
+BOOST_AUTO_TEST_SUITE_END()
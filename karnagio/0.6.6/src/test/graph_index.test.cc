@@ -0,0 +1,169 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define BOOST_TEST_MAIN
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+#include "boost/test/unit_test.hpp"
+#include "fastlib/base/base.h"
+#include "fastlib/table/default_table.h"
+#include "fastlib/table/graph_index_dev.h"
+#include "fastlib/metric_kernel/lmetric.h"
+#include "fastlib/metric_kernel/cosine_metric.h"
+
+namespace {
+
+typedef fl::table::Table<fl::table::DefaultTableMap> Table_t;
+
+/**
+ *  Points around a few centers, the first points of a bigger table are
+ *  the same as the points of a smaller one with the same seed
+ */
+void RandomTable(index_t n_entries, index_t dimension, Table_t *table) {
+  table->Init(std::vector<index_t>(1, dimension), std::vector<index_t>(),
+              n_entries);
+  fl::mtn19937_gen.seed(7);
+  std::vector<std::vector<double> > centers(10,
+      std::vector<double>(dimension));
+  for (size_t i = 0; i < centers.size(); ++i) {
+    for (index_t j = 0; j < dimension; ++j) {
+      centers[i][j] = fl::math::Random(0.0, 10.0);
+    }
+  }
+  for (index_t i = 0; i < n_entries; ++i) {
+    Table_t::Point_t point;
+    table->get(i, &point);
+    const std::vector<double> &center = centers[i % centers.size()];
+    for (index_t j = 0; j < dimension; ++j) {
+      point.set(j, center[j] + fl::math::Random(-2.0, 2.0));
+    }
+  }
+}
+
+/**
+ *  The fraction of the true k nearest neighbors the graph finds
+ *  for every tenth point of the table
+ */
+template<typename MetricType>
+double Recall(const fl::table::GraphIndex &graph, const Table_t &table,
+              index_t k, index_t search_breadth) {
+  MetricType metric;
+  double found = 0;
+  double total = 0;
+  fl::table::GraphIndex::SearchSpace space;
+  std::vector<fl::table::GraphIndex::Neighbor_t> neighbors;
+  Table_t::Point_t query;
+  Table_t::Point_t point;
+  for (index_t q = 0; q < table.n_entries(); q += 10) {
+    table.get(q, &query);
+    std::vector<double> distances;
+    for (index_t i = 0; i < table.n_entries(); ++i) {
+      table.get(i, &point);
+      distances.push_back(metric.DistanceSq(point, query));
+    }
+    std::nth_element(distances.begin(), distances.begin() + k - 1,
+                     distances.end());
+    graph.Search(table, metric, query, k, search_breadth,
+                 &neighbors, &space);
+    BOOST_CHECK_EQUAL(static_cast<index_t>(neighbors.size()), k);
+    for (size_t i = 0; i < neighbors.size(); ++i) {
+      if (i > 0) {
+        BOOST_CHECK(neighbors[i - 1].first <= neighbors[i].first);
+      }
+      table.get(neighbors[i].second, &point);
+      BOOST_CHECK_CLOSE(neighbors[i].first + 1,
+                        metric.DistanceSq(point, query) + 1, 1e-8);
+      if (neighbors[i].first <= distances[k - 1]) {
+        found += 1;
+      }
+    }
+    total += k;
+  }
+  return found / total;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(graph_index)
+
+BOOST_AUTO_TEST_CASE(TestRecall) {
+  Table_t table;
+  RandomTable(2000, 20, &table);
+  fl::table::GraphIndex graph;
+  fl::table::GraphIndex::IndexArgs<fl::math::LMetric<2> > args;
+  args.max_degree = 8;
+  graph.IndexData(table, args);
+  BOOST_CHECK(graph.is_indexed());
+  BOOST_CHECK_EQUAL(graph.n_entries(), table.n_entries());
+  for (index_t i = 0; i < graph.n_entries(); ++i) {
+    BOOST_CHECK(graph.num_of_links(i, 0) <= 2 * args.max_degree);
+    BOOST_CHECK(graph.num_of_links(i, 1) <= args.max_degree);
+  }
+  BOOST_CHECK(Recall<fl::math::LMetric<2> >(graph, table, 10, 100) > 0.95);
+  // a wider search must not lose neighbors
+  BOOST_CHECK(Recall<fl::math::LMetric<2> >(graph, table, 10, 200)
+              >= Recall<fl::math::LMetric<2> >(graph, table, 10, 20));
+}
+
+BOOST_AUTO_TEST_CASE(TestThreads) {
+  Table_t table;
+  RandomTable(2000, 20, &table);
+  fl::table::GraphIndex graph;
+  fl::table::GraphIndex::IndexArgs<fl::math::CosineMetric> args;
+  args.n_threads = 4;
+  graph.IndexData(table, args);
+  BOOST_CHECK_EQUAL(graph.n_entries(), table.n_entries());
+  BOOST_CHECK(Recall<fl::math::CosineMetric>(graph, table, 10, 100) > 0.95);
+}
+
+BOOST_AUTO_TEST_CASE(TestInsertAndSave) {
+  Table_t small_table;
+  RandomTable(1000, 20, &small_table);
+  Table_t table;
+  RandomTable(2000, 20, &table);
+  fl::table::GraphIndex graph;
+  fl::table::GraphIndex::IndexArgs<fl::math::LMetric<2> > args;
+  args.n_threads = 2;
+  graph.IndexData(small_table, args);
+  BOOST_CHECK_EQUAL(graph.n_entries(), small_table.n_entries());
+  graph.Insert(table, args);
+  BOOST_CHECK_EQUAL(graph.n_entries(), table.n_entries());
+  double recall = Recall<fl::math::LMetric<2> >(graph, table, 10, 100);
+  BOOST_CHECK(recall > 0.95);
+
+  std::string file = "graph_index_test.graph";
+  graph.Save(file);
+  fl::table::GraphIndex loaded;
+  loaded.Load(file);
+  std::remove(file.c_str());
+  BOOST_CHECK_EQUAL(loaded.n_entries(), graph.n_entries());
+  BOOST_CHECK_EQUAL(loaded.max_level(), graph.max_level());
+  BOOST_CHECK(loaded.metric_type_id() == graph.metric_type_id());
+  BOOST_CHECK_EQUAL(Recall<fl::math::LMetric<2> >(loaded, table, 10, 100),
+                    recall);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
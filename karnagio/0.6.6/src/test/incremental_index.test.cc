@@ -0,0 +1,262 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define BOOST_TEST_MAIN
+#include <algorithm>
+#include <vector>
+#include "boost/test/unit_test.hpp"
+#include "mlpack/allkn/allkn_dev.h"
+#include "fastlib/table/default/dense/labeled/kdtree/table.h"
+#include "fastlib/table/default/dense/labeled/balltree/table.h"
+
+namespace {
+
+/**
+ *  Makes a table of random points in [low, hi) and keeps a copy of them
+ *  in points, in the order of their ids
+ */
+template<typename TableType>
+void RandomTable(index_t n_entries, index_t dimension, double low, double hi,
+                 TableType *table, std::vector<std::vector<double> > *points) {
+  table->Init(std::vector<index_t>(1, dimension), std::vector<index_t>(),
+              n_entries);
+  for (index_t i = 0; i < n_entries; ++i) {
+    typename TableType::Point_t point;
+    table->get(i, &point);
+    points->push_back(std::vector<double>(dimension));
+    for (index_t j = 0; j < dimension; ++j) {
+      points->back()[j] = fl::math::Random(low, hi);
+      point.set(j, points->back()[j]);
+    }
+  }
+}
+
+template<typename TableType>
+struct AllKNMap : public fl::ml::AllKNArgs {
+  typedef TableType QueryTableType;
+  typedef TableType ReferenceTableType;
+  typedef boost::mpl::int_<0>::type KNmode;
+};
+
+/**
+ *  Every node must be a contiguous range that its children split,
+ *  its bound must contain its points and the leaves must not have more
+ *  than leaf_size points
+ */
+template<typename TableType>
+void CheckNode(TableType *table, typename TableType::Tree_t *node,
+               index_t leaf_size) {
+  fl::math::LMetric<2> metric;
+  typename TableType::TreeIterator it = table->get_node_iterator(node);
+  for (index_t i = 0; i < it.count(); ++i) {
+    typename TableType::Point_t point;
+    it.get(i, &point);
+    BOOST_REQUIRE(table->get_node_bound(node).MinDistanceSq(metric, point)
+                  <= 1e-9);
+  }
+  if (table->node_is_leaf(node)) {
+    BOOST_REQUIRE(table->get_node_count(node) <= leaf_size);
+    return;
+  }
+  typename TableType::Tree_t *left = table->get_node_left_child(node);
+  typename TableType::Tree_t *right = table->get_node_right_child(node);
+  BOOST_REQUIRE_EQUAL(table->get_node_begin(left),
+                      table->get_node_begin(node));
+  BOOST_REQUIRE_EQUAL(table->get_node_end(left),
+                      table->get_node_begin(right));
+  BOOST_REQUIRE_EQUAL(table->get_node_end(right),
+                      table->get_node_end(node));
+  CheckNode(table, left, leaf_size);
+  CheckNode(table, right, leaf_size);
+}
+
+/**
+ *  Every node id must be used once, so that the ids stay as many as
+ *  the nodes after any number of updates
+ */
+template<typename TableType>
+void CollectNodeIds(TableType *table, typename TableType::Tree_t *node,
+                    std::vector<index_t> *ids) {
+  ids->push_back(table->get_node_id(node));
+  if (table->node_is_leaf(node)) {
+    return;
+  }
+  CollectNodeIds(table, table->get_node_left_child(node), ids);
+  CollectNodeIds(table, table->get_node_right_child(node), ids);
+}
+
+/**
+ *  The table must hold the points of the copy under the same ids, the
+ *  deleted ones as tombstones, and allkn on it must find the neighbors
+ *  a linear scan of the points that are not deleted finds
+ */
+template<typename TableType>
+void CheckTable(TableType *table,
+                const std::vector<std::vector<double> > &points,
+                const std::vector<bool> &deleted,
+                index_t leaf_size) {
+  const index_t dimension = points[0].size();
+  const index_t n_deleted = std::count(deleted.begin(), deleted.end(), true);
+  BOOST_REQUIRE_EQUAL(table->n_entries(), points.size());
+  BOOST_REQUIRE_EQUAL(table->n_deleted_entries(), n_deleted);
+  BOOST_REQUIRE_EQUAL(table->get_node_count(table->get_tree()),
+                      static_cast<index_t>(points.size()) - n_deleted);
+  for (size_t i = 0; i < points.size(); ++i) {
+    typename TableType::Point_t point;
+    table->get(i, &point);
+    for (index_t j = 0; j < dimension; ++j) {
+      BOOST_REQUIRE_EQUAL(point[j], points[i][j]);
+    }
+    BOOST_REQUIRE_EQUAL(table->is_deleted(i), deleted[i]);
+  }
+  CheckNode(table, table->get_tree(), leaf_size);
+  std::vector<index_t> node_ids;
+  CollectNodeIds(table, table->get_tree(), &node_ids);
+  BOOST_REQUIRE_EQUAL(static_cast<index_t>(node_ids.size()),
+                      table->num_of_nodes());
+  std::sort(node_ids.begin(), node_ids.end());
+  for (size_t i = 0; i < node_ids.size(); ++i) {
+    BOOST_REQUIRE_EQUAL(node_ids[i], static_cast<index_t>(i));
+  }
+
+  TableType queries;
+  std::vector<std::vector<double> > query_points;
+  RandomTable(30, dimension, -2.0, 22.0, &queries, &query_points);
+  typename TableType::template IndexArgs<fl::math::LMetric<2> > index_args;
+  index_args.leaf_size = leaf_size;
+  queries.IndexData(index_args);
+  const index_t k = 3;
+  fl::math::LMetric<2> metric;
+  std::vector<double> distances;
+  std::vector<index_t> indices;
+  fl::ml::AllKN<AllKNMap<TableType> > allkn;
+  allkn.Init(table, &queries);
+  allkn.ComputeNeighbors(std::string("dual"), metric, k,
+                         &distances, &indices);
+  for (size_t q = 0; q < query_points.size(); ++q) {
+    std::vector<std::pair<double, index_t> > scan;
+    for (size_t i = 0; i < points.size(); ++i) {
+      if (deleted[i]) {
+        continue;
+      }
+      double distance = 0;
+      for (index_t j = 0; j < dimension; ++j) {
+        const double diff = points[i][j] - query_points[q][j];
+        distance += diff * diff;
+      }
+      scan.push_back(std::make_pair(distance, i));
+    }
+    std::sort(scan.begin(), scan.end());
+    for (index_t j = 0; j < k; ++j) {
+      BOOST_REQUIRE_EQUAL(indices[q * k + j], scan[j].second);
+    }
+  }
+}
+
+/**
+ *  Inserts and deletes points in rounds, half of the new points are
+ *  outside of the initial bounds, and checks the table after every
+ *  round against a copy that is updated the slow way. The tombstones
+ *  are freed at the end
+ */
+template<typename TableType>
+void TestUpdates() {
+  const index_t leaf_size = 16;
+  const index_t dimension = 3;
+  TableType table;
+  std::vector<std::vector<double> > points;
+  RandomTable(1500, dimension, 0.0, 10.0, &table, &points);
+  std::vector<bool> deleted(points.size(), false);
+  typename TableType::template IndexArgs<fl::math::LMetric<2> > index_args;
+  index_args.leaf_size = leaf_size;
+  table.IndexData(index_args);
+  for (int round = 0; round < 6; ++round) {
+    TableType new_points;
+    RandomTable(150, dimension, 0.0, 10.0 + 2 * round,
+                &new_points, &points);
+    deleted.resize(points.size(), false);
+    table.InsertData(new_points, index_args);
+    CheckTable(&table, points, deleted, leaf_size);
+
+    // some of the ids are deleted again, which must do nothing
+    std::vector<index_t> ids;
+    for (int i = 0; i < 100; ++i) {
+      ids.push_back(fl::math::Random(index_t(0),
+                                     index_t(points.size() - 1)));
+    }
+    table.DeleteData(ids, index_args);
+    for (size_t i = 0; i < ids.size(); ++i) {
+      deleted[ids[i]] = true;
+    }
+    CheckTable(&table, points, deleted, leaf_size);
+  }
+  // the points that remain keep their order and get consecutive ids
+  std::vector<index_t> new_ids;
+  table.CompactData(&new_ids);
+  BOOST_REQUIRE_EQUAL(new_ids.size(), points.size());
+  std::vector<std::vector<double> > remaining;
+  for (size_t i = 0; i < points.size(); ++i) {
+    if (deleted[i]) {
+      BOOST_REQUIRE_EQUAL(new_ids[i], -1);
+    } else {
+      BOOST_REQUIRE_EQUAL(new_ids[i], index_t(remaining.size()));
+      remaining.push_back(points[i]);
+    }
+  }
+  points.swap(remaining);
+  deleted.assign(points.size(), false);
+  CheckTable(&table, points, deleted, leaf_size);
+  // after most of the points changed the tree must be as tight as one
+  // built from scratch, the nodes that changed a lot are rebuilt
+  TableType rebuilt;
+  std::vector<std::vector<double> > copy;
+  rebuilt.Init(std::vector<index_t>(1, dimension), std::vector<index_t>(),
+               points.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    typename TableType::Point_t point;
+    rebuilt.get(i, &point);
+    for (index_t j = 0; j < dimension; ++j) {
+      point.set(j, points[i][j]);
+    }
+  }
+  rebuilt.IndexData(index_args);
+  CheckTable(&rebuilt, points, deleted, leaf_size);
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(TestSuiteIncrementalIndex)
+
+BOOST_AUTO_TEST_CASE(TestKdTree) {
+  fl::mtn19937_gen.seed(7);
+  TestUpdates<fl::table::dense::labeled::kdtree::Table>();
+}
+
+BOOST_AUTO_TEST_CASE(TestBallTree) {
+  fl::mtn19937_gen.seed(11);
+  TestUpdates<fl::table::dense::labeled::balltree::Table>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
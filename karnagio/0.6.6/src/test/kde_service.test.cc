@@ -0,0 +1,240 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define BOOST_TEST_MAIN
+#include <cmath>
+#include <vector>
+#include "boost/test/unit_test.hpp"
+#include "mlpack/kde/kde_service_defs.h"
+#include "fastlib/table/default/dense/labeled/kdtree/table.h"
+
+namespace {
+
+typedef fl::table::dense::labeled::kdtree::Table Table_t;
+typedef fl::ml::KdeService<boost::mpl::void_>::DensityStream<Table_t,
+        fl::math::GaussianKernel<double> > Stream_t;
+
+const double bandwidth = 0.8;
+const double relative_error = 0.01;
+
+/**
+ *  Fills the table with random points and keeps a copy of them in
+ *  points
+ */
+void RandomTable(index_t n_entries, index_t dimension, Table_t *table,
+                 std::vector<std::vector<double> > *points) {
+  table->Init(std::vector<index_t>(1, dimension), std::vector<index_t>(),
+              n_entries);
+  points->resize(n_entries, std::vector<double>(dimension));
+  for (index_t i = 0; i < n_entries; ++i) {
+    Table_t::Point_t point;
+    table->get(i, &point);
+    for (index_t j = 0; j < dimension; ++j) {
+      (*points)[i][j] = fl::math::Random(0.0, 5.0);
+      point.set(j, (*points)[i][j]);
+    }
+  }
+}
+
+/**
+ *  A request with n_points random points
+ */
+void RandomRequest(index_t n_points, index_t dimension,
+                   fl::ml::KdeRequest *request) {
+  request->dimension = dimension;
+  request->points.clear();
+  for (index_t i = 0; i < n_points * dimension; ++i) {
+    request->points.push_back(fl::math::Random(0.0, 5.0));
+  }
+}
+
+/**
+ *  Checks the densities of the points of the request against a linear
+ *  scan of the references from first on
+ */
+bool CheckDensities(const std::vector<std::vector<double> > &references,
+                    size_t first,
+                    const fl::ml::KdeRequest &request,
+                    const fl::ml::KdeResponse &response) {
+  const index_t dimension = request.dimension;
+  const index_t n_points = request.points.size() / dimension;
+  if (response.error != ""
+      || static_cast<index_t>(response.densities.size()) != n_points) {
+    return false;
+  }
+  fl::math::GaussianKernel<double> kernel;
+  kernel.Init(bandwidth);
+  for (index_t q = 0; q < n_points; ++q) {
+    double density = 0;
+    for (size_t i = first; i < references.size(); ++i) {
+      double distance = 0;
+      for (index_t j = 0; j < dimension; ++j) {
+        const double diff = references[i][j]
+          - request.points[q * dimension + j];
+        distance += diff * diff;
+      }
+      density += kernel.EvalUnnormOnSq(distance);
+    }
+    density /= kernel.CalcNormConstant(dimension) *
+      (references.size() - first);
+    if (std::fabs(response.densities[q] - density) > relative_error * density) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ *  Scores n_points random points, the references do not change
+ */
+void CheckScores(Stream_t *stream,
+                 const std::vector<std::vector<double> > *references,
+                 index_t n_points, int *n_failed) {
+  fl::ml::KdeRequest request;
+  fl::ml::KdeResponse response;
+  RandomRequest(n_points, (*references)[0].size(), &request);
+  stream->Submit(request, &response);
+  if (CheckDensities(*references, 0, request, response) == false) {
+    ++(*n_failed);
+  }
+}
+
+/**
+ *  Sends rounds of events that are scored and appended, every round is
+ *  scored against the references and the events of the rounds before it
+ */
+void CheckFeed(Stream_t *stream, std::vector<std::vector<double> > *points,
+               index_t window) {
+  const index_t dimension = (*points)[0].size();
+  fl::ml::KdeRequest request;
+  fl::ml::KdeResponse response;
+  request.append = true;
+  for (int round = 0; round < 8; ++round) {
+    RandomRequest(10 + 7 * round, dimension, &request);
+    stream->Submit(request, &response);
+    const size_t first = window > 0 &&
+      points->size() > static_cast<size_t>(window) ?
+      points->size() - window : 0;
+    BOOST_REQUIRE(CheckDensities(*points, first, request, response));
+    for (size_t i = 0; i < request.points.size(); i += dimension) {
+      points->push_back(std::vector<double>(request.points.begin() + i,
+          request.points.begin() + i + dimension));
+    }
+    const index_t n_references = window > 0 ?
+      std::min(window, static_cast<index_t>(points->size())) :
+      points->size();
+    BOOST_REQUIRE_EQUAL(response.n_references, n_references);
+    BOOST_REQUIRE_EQUAL(stream->num_of_references(), n_references);
+  }
+  // an event that is only appended is not scored
+  request.score = false;
+  RandomRequest(5, dimension, &request);
+  stream->Submit(request, &response);
+  BOOST_REQUIRE_EQUAL(response.error, "");
+  BOOST_REQUIRE(response.densities.empty());
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(TestSuiteKdeService)
+
+BOOST_AUTO_TEST_CASE(TestBatches) {
+  fl::mtn19937_gen.seed(3);
+  Table_t references;
+  std::vector<std::vector<double> > points;
+  RandomTable(2000, 3, &references, &points);
+  Table_t::IndexArgs<fl::math::LMetric<2> > index_args;
+  index_args.leaf_size = 20;
+  references.IndexData(index_args);
+  // a long window, so that the concurrent requests end up together
+  Stream_t stream(&references, bandwidth, relative_error, 64, 20000, 20, 1, 0);
+  stream.Start();
+  std::vector<int> n_failed(8, 0);
+  boost::thread_group threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.create_thread(boost::bind(&CheckScores, &stream, &points,
+        1 + i, &n_failed[i]));
+  }
+  threads.join_all();
+  stream.Stop();
+  for (int i = 0; i < 8; ++i) {
+    BOOST_CHECK_EQUAL(n_failed[i], 0);
+  }
+  BOOST_CHECK_EQUAL(stream.num_of_requests(), 8);
+  BOOST_CHECK(stream.num_of_batches() < 8);
+}
+
+BOOST_AUTO_TEST_CASE(TestFeed) {
+  fl::mtn19937_gen.seed(7);
+  for (int window = 0; window <= 600; window += 600) {
+    Table_t references;
+    std::vector<std::vector<double> > points;
+    RandomTable(500, 3, &references, &points);
+    Table_t::IndexArgs<fl::math::LMetric<2> > index_args;
+    index_args.leaf_size = 10;
+    references.IndexData(index_args);
+    Stream_t stream(&references, bandwidth, relative_error,
+                    64, 100, 10, 2, window);
+    stream.Start();
+    CheckFeed(&stream, &points, window);
+    stream.Stop();
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestBadRequests) {
+  fl::mtn19937_gen.seed(5);
+  Table_t references;
+  std::vector<std::vector<double> > points;
+  RandomTable(100, 3, &references, &points);
+  Table_t::IndexArgs<fl::math::LMetric<2> > index_args;
+  index_args.leaf_size = 10;
+  references.IndexData(index_args);
+  Stream_t stream(&references, bandwidth, relative_error, 64, 100, 10, 1, 0);
+  stream.Start();
+  fl::ml::KdeRequest request;
+  fl::ml::KdeResponse response;
+  request.dimension = 2;
+  request.points.assign(4, 1.0);
+  stream.Submit(request, &response);
+  BOOST_CHECK(response.error != "");
+  request.dimension = 3;
+  request.points.assign(4, 1.0);
+  stream.Submit(request, &response);
+  BOOST_CHECK(response.error != "");
+  request.points.assign(6, 1.0);
+  request.score = false;
+  stream.Submit(request, &response);
+  BOOST_CHECK(response.error != "");
+  request.score = true;
+  stream.Submit(request, &response);
+  BOOST_CHECK_EQUAL(response.error, "");
+  BOOST_CHECK_EQUAL(response.densities.size(), 2);
+  BOOST_CHECK_EQUAL(response.n_references, 100);
+  stream.Stop();
+  stream.Submit(request, &response);
+  BOOST_CHECK(response.error != "");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -292,11 +292,93 @@ class MultiDatasetTest {
       }
     }
 
+    void TestParallelLoad() {
+      // big enough so that it is split in several chunks
+      const index_t n_points = 30000;
+      std::string csv_file = input_files_directory_ + "/parallel_load.csv";
+      {
+        std::ofstream fout(csv_file.c_str());
+        for (index_t i = 0; i < n_points; i++) {
+          fout << 3*i << "," << 3*i + 1 << "," << 3*i + 2 << "\n";
+        }
+        // everything after the first blank line must be ignored
+        fout << "\n" << "-1,-1,-1\n";
+      }
+      fl::data::MultiDataset<Arguments1> dataset1, dataset2;
+      dataset1.set_n_threads(1);
+      dataset1.Init(csv_file, "r");
+      dataset2.set_n_threads(4);
+      dataset2.Init(csv_file, "r");
+      BOOST_ASSERT(dataset1.n_points() == n_points);
+      BOOST_ASSERT(dataset2.n_points() == n_points);
+      fl::data::MultiDataset<Arguments1>::Point_t point1, point2;
+      for (index_t i = 0; i < n_points; i++) {
+        dataset1.get(i, &point1);
+        dataset2.get(i, &point2);
+        BOOST_ASSERT(point1.size() == 3);
+        for (size_t j = 0; j < point1.size(); j++) {
+          BOOST_ASSERT(point1[j] == 3*i + j);
+          BOOST_ASSERT(point2[j] == point1[j]);
+        }
+      }
+    }
+
   public:
     MultiDatasetTest(std::string input_files_dir_in) {
       input_files_directory_ = input_files_dir_in;
     }
 
+    struct Arguments6 : public fl::data::DatasetArgs {
+      typedef boost::mpl::vector1<double> SparseTypes;
+      typedef double CalcPrecisionType;
+      typedef fl::data::DatasetArgs::Extendable StorageType;
+    };
+
+    void TestCompactSparse() {
+      const index_t n_points = 20000;
+      std::string sparse_file = input_files_directory_ + "/compact_sparse.csv";
+      {
+        std::ofstream fout(sparse_file.c_str());
+        fout << "header sparse:double:100\n";
+        for (index_t i = 0; i < n_points; i++) {
+          // blank lines are all zero points
+          if (i % 5 != 2) {
+            fout << i % 50 << ":" << i + 1 << " 99:" << -i << "\n";
+          } else {
+            fout << "\n";
+          }
+        }
+      }
+      fl::data::MultiDataset<Arguments2> compact;
+      fl::data::MultiDataset<Arguments6> extendable;
+      compact.set_n_threads(4);
+      compact.Init(sparse_file, "r");
+      extendable.Init(sparse_file, "r");
+      BOOST_ASSERT(compact.n_points() == n_points);
+      fl::data::MultiDataset<Arguments2>::Point_t point1;
+      fl::data::MultiDataset<Arguments6>::Point_t point2;
+      for (index_t i = 0; i < n_points; i++) {
+        compact.get(i, &point1);
+        extendable.get(i, &point2);
+        // the points of compact datasets view rows of shared arenas
+        BOOST_ASSERT(point1.elem()->is_attached() == true);
+        BOOST_ASSERT(point1.nnz() == point2.nnz());
+        for (size_t j = 0; j < point1.size(); j++) {
+          BOOST_ASSERT(point1[j] == point2[j]);
+        }
+      }
+      // growing a row in the middle of an arena must not touch its neighbours
+      compact.get(n_points/2, &point1);
+      point1.set(70, 3.5);
+      BOOST_ASSERT(point1[70] == 3.5);
+      BOOST_ASSERT(point1[99] == -(n_points/2));
+      compact.get(n_points/2 + 1, &point1);
+      BOOST_ASSERT(point1.nnz() == 2);
+      BOOST_ASSERT(point1[70] == 0);
+      compact.get(n_points/2 - 1, &point1);
+      BOOST_ASSERT(point1[99] == -(n_points/2 - 1));
+    }
+
     void RunTests() {
       TestCsv();
       BOOST_MESSAGE("Csv dataset test passed !!!");
@@ -310,6 +392,10 @@ class MultiDatasetTest {
       BOOST_MESSAGE("Dense Categorical passed!!");
       TestDenseMeta();
       BOOST_MESSAGE("Dense with metadata passed !!!");
+      TestParallelLoad();
+      BOOST_MESSAGE("Parallel load passed !!!");
+      TestCompactSparse();
+      BOOST_MESSAGE("Compact sparse storage passed !!!");
       BOOST_MESSAGE("Congratulations All tests passed");
     }
 
@@ -0,0 +1,105 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define BOOST_TEST_MAIN
+#include <vector>
+#include "boost/test/unit_test.hpp"
+#include "fastlib/base/base.h"
+#include "fastlib/table/default_table.h"
+#include "fastlib/table/table_dev.h"
+#include "fastlib/data/multi_dataset_dev.h"
+
+namespace {
+  typedef fl::table::Table<fl::table::DefaultTableMap> Table_t;
+
+  /**
+   * @brief the nodes of the two trees must have the same ids and
+   *        cover the same ranges of points
+   */
+  void CompareTrees(Table_t &table1, Table_t::Tree_t *node1,
+                    Table_t &table2, Table_t::Tree_t *node2) {
+    BOOST_REQUIRE_EQUAL(table1.get_node_id(node1), table2.get_node_id(node2));
+    BOOST_REQUIRE_EQUAL(table1.get_node_begin(node1),
+                        table2.get_node_begin(node2));
+    BOOST_REQUIRE_EQUAL(table1.get_node_count(node1),
+                        table2.get_node_count(node2));
+    BOOST_REQUIRE_EQUAL(table1.node_is_leaf(node1), table2.node_is_leaf(node2));
+    if (table1.node_is_leaf(node1) == false) {
+      CompareTrees(table1, table1.get_node_left_child(node1),
+                   table2, table2.get_node_left_child(node2));
+      CompareTrees(table1, table1.get_node_right_child(node1),
+                   table2, table2.get_node_right_child(node2));
+    }
+  }
+}
+
+// a tree whose sibling subtrees are built on several threads is the
+// same tree, with the same point order, as the one built on one thread
+BOOST_AUTO_TEST_CASE(TestParallelTreeBuild) {
+  // big enough for several levels to be split in parallel
+  index_t n_entries = 1<<17;
+  std::vector<index_t> dense_dimensions(1, 3);
+  std::vector<index_t> sparse_dimensions;
+  Table_t table1;
+  Table_t table2;
+  table1.Init(dense_dimensions, sparse_dimensions, n_entries);
+  table2.Init(dense_dimensions, sparse_dimensions, n_entries);
+  for (index_t i = 0; i < n_entries; i++) {
+    Table_t::Point_t point1;
+    Table_t::Point_t point2;
+    table1.get(i, &point1);
+    table2.get(i, &point2);
+    for (index_t j = 0; j < table1.n_attributes(); j++) {
+      double value = fl::math::Random(0.0, 1.0);
+      point1.set(j, value);
+      point2.set(j, value);
+    }
+  }
+  Table_t::IndexArgs<fl::math::LMetric<2> > index_args;
+  index_args.leaf_size = 20;
+  table1.IndexData(index_args);
+  index_args.n_threads = 5;
+  table2.IndexData(index_args);
+  BOOST_REQUIRE_EQUAL(table1.num_of_nodes(), table2.num_of_nodes());
+  CompareTrees(table1, table1.get_tree(), table2, table2.get_tree());
+  // the nodes below the root live in the arena of the root
+  BOOST_CHECK(table1.get_tree()->in_arena() == false);
+  BOOST_CHECK(table1.get_node_left_child(table1.get_tree())->in_arena());
+  BOOST_CHECK(table2.get_node_right_child(table2.get_tree())->in_arena());
+  Table_t::TreeIterator it1 = table1.get_node_iterator(table1.get_tree());
+  Table_t::TreeIterator it2 = table2.get_node_iterator(table2.get_tree());
+  while (it1.HasNext()) {
+    Table_t::Point_t point1;
+    Table_t::Point_t point2;
+    index_t point_id1;
+    index_t point_id2;
+    it1.Next(&point1, &point_id1);
+    it2.Next(&point2, &point_id2);
+    BOOST_REQUIRE_EQUAL(point_id1, point_id2);
+    for (index_t j = 0; j < table1.n_attributes(); j++) {
+      BOOST_CHECK_EQUAL(point1[j], point2[j]);
+    }
+  }
+}
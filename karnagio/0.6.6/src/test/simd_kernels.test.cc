@@ -0,0 +1,149 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+#define BOOST_TEST_MAIN
+#include <cmath>
+#include <string>
+#include <vector>
+#include "boost/test/unit_test.hpp"
+#include "fastlib/dense/simd_kernels.h"
+#include "fastlib/math/fl_math.h"
+
+namespace {
+
+const char *instruction_sets[] = {"scalar", "sse2", "avx2", "avx512"};
+
+template<typename T>
+void RandomVector(index_t length, std::vector<T> *v) {
+  v->resize(length);
+  for (index_t i = 0; i < length; ++i) {
+    (*v)[i] = fl::math::Random(-5.0, 5.0);
+  }
+}
+
+/**
+ *  Every instruction set must give exactly what the scalar kernels give,
+ *  and that must be the plain sum up to rounding
+ */
+template<typename T>
+void TestKernels() {
+  std::string best = fl::dense::simd::instruction_set();
+  for (index_t length = 0; length < 70; ++length) {
+    std::vector<T> w, x, y;
+    RandomVector(length, &w);
+    RandomVector(length, &x);
+    RandomVector(length, &y);
+    double l2 = 0, l1 = 0, weighted = 0, dot = 0;
+    for (index_t i = 0; i < length; ++i) {
+      double d = double(x[i]) - double(y[i]);
+      l2 += d * d;
+      l1 += std::fabs(d);
+      weighted += w[i] * d * d;
+      dot += double(x[i]) * double(y[i]);
+    }
+    std::vector<T> expected;
+    for (int s = 0; s < 4; ++s) {
+      if (fl::dense::simd::set_instruction_set(instruction_sets[s]) 
+          == false) {
+        continue;
+      }
+      std::vector<T> result;
+      result.push_back(fl::dense::simd::DistanceSq(length, &x[0], &y[0]));
+      result.push_back(fl::dense::simd::DistanceL1(length, &x[0], &y[0]));
+      result.push_back(fl::dense::simd::WeightedDistanceSq(length, &w[0],
+                       &x[0], &y[0]));
+      result.push_back(fl::dense::simd::Dot(length, &x[0], &y[0]));
+      if (expected.empty()) {
+        expected = result;
+        const double tolerance = 1e-4 * (1 + length * 25);
+        BOOST_CHECK(std::fabs(result[0] - l2) < tolerance);
+        BOOST_CHECK(std::fabs(result[1] - l1) < tolerance);
+        BOOST_CHECK(std::fabs(result[2] - weighted) < tolerance * 5);
+        BOOST_CHECK(std::fabs(result[3] - dot) < tolerance);
+      }
+      BOOST_CHECK(result == expected);
+    }
+  }
+  fl::dense::simd::set_instruction_set(best);
+}
+
+template<typename T>
+void TestBlock() {
+  std::string best = fl::dense::simd::instruction_set();
+  for (index_t length = 1; length < 40; length += 3) {
+    std::vector<T> query;
+    RandomVector(length, &query);
+    std::vector<std::vector<T> > references(fl::dense::simd::kBlockSize + 3);
+    std::vector<const T*> pointers;
+    for (size_t i = 0; i < references.size(); ++i) {
+      RandomVector(length, &references[i]);
+      pointers.push_back(&references[i][0]);
+    }
+    for (int s = 0; s < 4; ++s) {
+      if (fl::dense::simd::set_instruction_set(instruction_sets[s]) 
+          == false) {
+        continue;
+      }
+      std::vector<T> distances(references.size());
+      fl::dense::simd::DistanceSqBlock(length, &query[0], &pointers[0],
+                                       references.size(), &distances[0]);
+      for (size_t i = 0; i < references.size(); ++i) {
+        BOOST_CHECK(distances[i] == fl::dense::simd::DistanceSq(length,
+                    &query[0], &references[i][0]));
+      }
+    }
+  }
+  fl::dense::simd::set_instruction_set(best);
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(simd_kernels)
+
+BOOST_AUTO_TEST_CASE(TestInstructionSet) {
+  std::string best = fl::dense::simd::instruction_set();
+  BOOST_CHECK(fl::dense::simd::set_instruction_set("scalar"));
+  BOOST_CHECK(fl::dense::simd::instruction_set() == "scalar");
+  BOOST_CHECK(fl::dense::simd::set_instruction_set("mmx") == false);
+  BOOST_CHECK(fl::dense::simd::instruction_set() == "scalar");
+  BOOST_CHECK(fl::dense::simd::set_instruction_set(best));
+}
+
+BOOST_AUTO_TEST_CASE(TestDoubleKernels) {
+  TestKernels<double>();
+}
+
+BOOST_AUTO_TEST_CASE(TestFloatKernels) {
+  TestKernels<float>();
+}
+
+BOOST_AUTO_TEST_CASE(TestDoubleBlock) {
+  TestBlock<double>();
+}
+
+BOOST_AUTO_TEST_CASE(TestFloatBlock) {
+  TestBlock<float>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,231 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define BOOST_TEST_MAIN
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+#include "boost/test/unit_test.hpp"
+#include "mlpack/allkn/allkn_dev.h"
+#include "fastlib/table/default/dense/labeled/kdtree/table.h"
+#include "fastlib/table/default/dense/labeled/balltree/table.h"
+#include "fastlib/table/default/dense/labeled/covertree/table.h"
+#include "fastlib/metric_kernel/hellinger_metric.h"
+#include "fastlib/metric_kernel/kl_divergence.h"
+
+namespace {
+
+/**
+ *  Makes a skewed table, most of the points are in a small cluster and
+ *  the rest have exponential coordinates, so that a midpoint split leaves
+ *  few points on one side. A copy of the points is kept in points
+ */
+template<typename TableType>
+void SkewedTable(index_t n_entries, index_t dimension, TableType *table,
+                 std::vector<std::vector<double> > *points) {
+  table->Init(std::vector<index_t>(1, dimension), std::vector<index_t>(),
+              n_entries);
+  for (index_t i = 0; i < n_entries; ++i) {
+    typename TableType::Point_t point;
+    table->get(i, &point);
+    points->push_back(std::vector<double>(dimension));
+    const bool clustered = fl::math::Random(0.0, 1.0) < 0.8;
+    for (index_t j = 0; j < dimension; ++j) {
+      points->back()[j] = clustered ? fl::math::Random(0.0, 0.01)
+        : -std::log(fl::math::Random(1e-9, 1.0)) * 10;
+      point.set(j, points->back()[j]);
+    }
+  }
+}
+
+template<typename TableType>
+struct AllKNMap : public fl::ml::AllKNArgs {
+  typedef TableType QueryTableType;
+  typedef TableType ReferenceTableType;
+  typedef boost::mpl::int_<0>::type KNmode;
+};
+
+/**
+ *  Every node must be a contiguous range that its children split, its
+ *  bound must contain its points under the metric of the tree and the
+ *  leaves must not have more than leaf_size points. It returns the depth
+ *  of the subtree
+ */
+template<typename TableType, typename MetricType>
+index_t CheckNode(const MetricType &metric, TableType *table,
+                  typename TableType::Tree_t *node, index_t leaf_size) {
+  typename TableType::TreeIterator it = table->get_node_iterator(node);
+  for (index_t i = 0; i < it.count(); ++i) {
+    typename TableType::Point_t point;
+    it.get(i, &point);
+    BOOST_REQUIRE(table->get_node_bound(node).MinDistanceSq(metric, point)
+                  <= 1e-9);
+  }
+  if (table->node_is_leaf(node)) {
+    BOOST_REQUIRE(table->get_node_count(node) <= leaf_size);
+    return 0;
+  }
+  typename TableType::Tree_t *left = table->get_node_left_child(node);
+  typename TableType::Tree_t *right = table->get_node_right_child(node);
+  BOOST_REQUIRE_EQUAL(table->get_node_begin(left),
+                      table->get_node_begin(node));
+  BOOST_REQUIRE_EQUAL(table->get_node_end(left),
+                      table->get_node_begin(right));
+  BOOST_REQUIRE_EQUAL(table->get_node_end(right),
+                      table->get_node_end(node));
+  return 1 + std::max(CheckNode(metric, table, left, leaf_size),
+                      CheckNode(metric, table, right, leaf_size));
+}
+
+/**
+ *  Builds the tree with the split rule, checks it and checks that
+ *  allkn on it finds the neighbors a linear scan finds. It returns the
+ *  depth of the tree
+ */
+template<typename TableType>
+index_t TestSplit(const std::string &split) {
+  const index_t leaf_size = 10;
+  const index_t dimension = 3;
+  TableType table;
+  std::vector<std::vector<double> > points;
+  SkewedTable(3000, dimension, &table, &points);
+  typename TableType::template IndexArgs<fl::math::LMetric<2> > index_args;
+  index_args.leaf_size = leaf_size;
+  index_args.split = split;
+  table.IndexData(index_args);
+  BOOST_REQUIRE_EQUAL(table.get_node_count(table.get_tree()),
+                      points.size());
+  const index_t depth = CheckNode(fl::math::LMetric<2>(), &table,
+                                  table.get_tree(), leaf_size);
+
+  TableType queries;
+  std::vector<std::vector<double> > query_points;
+  SkewedTable(50, dimension, &queries, &query_points);
+  queries.IndexData(index_args);
+  const index_t k = 3;
+  fl::math::LMetric<2> metric;
+  std::vector<double> distances;
+  std::vector<index_t> indices;
+  fl::ml::AllKN<AllKNMap<TableType> > allkn;
+  allkn.Init(&table, &queries);
+  allkn.ComputeNeighbors(std::string("dual"), metric, k,
+                         &distances, &indices);
+  for (size_t q = 0; q < query_points.size(); ++q) {
+    std::vector<double> scan;
+    for (size_t i = 0; i < points.size(); ++i) {
+      double distance = 0;
+      for (index_t j = 0; j < dimension; ++j) {
+        const double diff = points[i][j] - query_points[q][j];
+        distance += diff * diff;
+      }
+      scan.push_back(distance);
+    }
+    std::sort(scan.begin(), scan.end());
+    for (index_t j = 0; j < k; ++j) {
+      BOOST_REQUIRE_CLOSE(distances[q * k + j], scan[j], 1e-6);
+    }
+  }
+  return depth;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(TestSuiteSplitRules)
+
+BOOST_AUTO_TEST_CASE(TestKdTreeSplits) {
+  typedef fl::table::dense::labeled::kdtree::Table Table_t;
+  fl::mtn19937_gen.seed(3);
+  const index_t midpoint_depth = TestSplit<Table_t>("midpoint");
+  fl::mtn19937_gen.seed(3);
+  const index_t sliding_depth = TestSplit<Table_t>("sliding_midpoint");
+  fl::mtn19937_gen.seed(3);
+  const index_t median_depth = TestSplit<Table_t>("median");
+  fl::mtn19937_gen.seed(3);
+  const index_t variance_depth = TestSplit<Table_t>("variance");
+  // every split of sliding_midpoint keeps a tenth of the points on each
+  // side and median halves them
+  const double leaves = 3000.0 / 10;
+  BOOST_CHECK(sliding_depth <= std::ceil(std::log(leaves)
+                                         / std::log(10.0 / 9)) + 1);
+  BOOST_CHECK(median_depth <= std::ceil(std::log(leaves) / std::log(2.0)) + 1);
+  BOOST_CHECK(sliding_depth <= midpoint_depth);
+  BOOST_CHECK(variance_depth < midpoint_depth);
+}
+
+BOOST_AUTO_TEST_CASE(TestBallTreeSplits) {
+  typedef fl::table::dense::labeled::balltree::Table Table_t;
+  fl::mtn19937_gen.seed(5);
+  TestSplit<Table_t>("");
+  fl::mtn19937_gen.seed(5);
+  TestSplit<Table_t>("furthest");
+  fl::mtn19937_gen.seed(5);
+  TestSplit<Table_t>("sampled");
+}
+
+BOOST_AUTO_TEST_CASE(TestCoverTreeSplits) {
+  typedef fl::table::dense::labeled::covertree::Table Table_t;
+  fl::mtn19937_gen.seed(7);
+  TestSplit<Table_t>("");
+  fl::mtn19937_gen.seed(7);
+  TestSplit<Table_t>("furthest");
+  // the cover tree is built with the metrics that are not l2 too, the
+  // points are on the simplex for the divergence and on the sphere
+  // for the Hellinger metric
+  const index_t dimension = 8;
+  const index_t leaf_size = 10;
+  Table_t simplex;
+  Table_t sphere;
+  simplex.Init(std::vector<index_t>(1, dimension), std::vector<index_t>(),
+               1000);
+  sphere.Init(std::vector<index_t>(1, dimension), std::vector<index_t>(),
+              1000);
+  for (index_t i = 0; i < simplex.n_entries(); ++i) {
+    std::vector<double> values(dimension);
+    double sum = 0;
+    for (index_t j = 0; j < dimension; ++j) {
+      values[j] = fl::math::Random(0.01, 1.0);
+      sum += values[j];
+    }
+    Table_t::Point_t point;
+    simplex.get(i, &point);
+    Table_t::Point_t sphere_point;
+    sphere.get(i, &sphere_point);
+    for (index_t j = 0; j < dimension; ++j) {
+      point.set(j, values[j] / sum);
+      sphere_point.set(j, std::sqrt(values[j] / sum));
+    }
+  }
+  Table_t::IndexArgs<fl::math::KLDivergence> kl_args;
+  kl_args.leaf_size = leaf_size;
+  simplex.IndexData(kl_args);
+  BOOST_REQUIRE_EQUAL(simplex.get_node_count(simplex.get_tree()), 1000);
+  Table_t::IndexArgs<fl::math::HellingerMetric> hellinger_args;
+  hellinger_args.leaf_size = leaf_size;
+  sphere.IndexData(hellinger_args);
+  CheckNode(hellinger_args.metric, &sphere, sphere.get_tree(), leaf_size);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,135 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define BOOST_TEST_MAIN
+#include <fstream>
+#include <string>
+#include <vector>
+#include "boost/test/unit_test.hpp"
+#include "boost/filesystem.hpp"
+#include "fastlib/base/base.h"
+#include "fastlib/table/default_table.h"
+#include "fastlib/table/table_dev.h"
+#include "fastlib/table/table_stream_dev.h"
+#include "fastlib/data/multi_dataset_dev.h"
+
+namespace {
+  typedef fl::table::Table<fl::table::DefaultTableMap> Table_t;
+
+  /**
+   * @brief writes n_entries random points with n_attributes to a csv
+   *        file in the temp directory and returns its name
+   */
+  std::string RandomCsv(const std::string &name,
+                        index_t n_entries, index_t n_attributes) {
+    std::string filename = (boost::filesystem::temp_directory_path()
+        / name).string();
+    std::ofstream fout(filename.c_str());
+    for (index_t i = 0; i < n_entries; i++) {
+      for (index_t j = 0; j < n_attributes; j++) {
+        fout << (j == 0 ? "" : ",") << fl::math::Random(0.0, 1.0);
+      }
+      fout << "\n";
+    }
+    return filename;
+  }
+
+  /**
+   * @brief reads the stream to the end, the blocks must hold the points
+   *        of the table in the same order, returns the number of blocks
+   */
+  index_t CompareBlocks(fl::table::TableStream<Table_t> *stream,
+                        Table_t &table, index_t first_entry) {
+    boost::shared_ptr<Table_t> block;
+    index_t n_blocks = 0;
+    index_t n_entries = first_entry;
+    while (stream->NextBlock(&block)) {
+      BOOST_REQUIRE_EQUAL(block->n_attributes(), table.n_attributes());
+      for (index_t i = 0; i < block->n_entries(); i++) {
+        Table_t::Point_t point1;
+        Table_t::Point_t point2;
+        table.get(n_entries + i, &point1);
+        block->get(i, &point2);
+        for (index_t j = 0; j < table.n_attributes(); j++) {
+          BOOST_CHECK_EQUAL(point1[j], point2[j]);
+        }
+      }
+      n_entries += block->n_entries();
+      ++n_blocks;
+    }
+    BOOST_CHECK_EQUAL(n_entries, table.n_entries());
+    return n_blocks;
+  }
+}
+
+// small blocks split the file in many of them, with and without
+// read ahead, and Reset reads them again from the first point
+BOOST_AUTO_TEST_CASE(TestTableStream) {
+  std::string filename = RandomCsv("table_stream_test.csv", 1000, 3);
+  Table_t table;
+  table.Init(filename, "r");
+  for (int window = 1; window <= 3; window += 2) {
+    fl::table::TableStream<Table_t> stream;
+    stream.Init(filename, 1<<12, window);
+    BOOST_CHECK_EQUAL(stream.n_attributes(), table.n_attributes());
+    BOOST_CHECK_EQUAL(stream.n_entries(), table.n_entries());
+    for (int pass = 0; pass < 2; ++pass) {
+      BOOST_CHECK(CompareBlocks(&stream, table, 0) > 1);
+      stream.Reset();
+    }
+  }
+  boost::filesystem::remove(filename);
+}
+
+// counting the points in the middle of a pass does not move the
+// position of the stream
+BOOST_AUTO_TEST_CASE(TestCountWhileStreaming) {
+  std::string filename = RandomCsv("table_stream_count_test.csv", 1000, 3);
+  Table_t table;
+  table.Init(filename, "r");
+  for (int window = 1; window <= 3; window += 2) {
+    fl::table::TableStream<Table_t> stream;
+    stream.Init(filename, 1<<12, window);
+    boost::shared_ptr<Table_t> block;
+    BOOST_REQUIRE(stream.NextBlock(&block));
+    const index_t first_entries = block->n_entries();
+    block.reset();
+    BOOST_CHECK_EQUAL(stream.n_entries(), table.n_entries());
+    CompareBlocks(&stream, table, first_entries);
+  }
+  boost::filesystem::remove(filename);
+}
+
+// a table in memory is streamed as a single block
+BOOST_AUTO_TEST_CASE(TestTableInMemory) {
+  std::string filename = RandomCsv("table_stream_memory_test.csv", 500, 2);
+  boost::shared_ptr<Table_t> table(new Table_t());
+  table->Init(filename, "r");
+  fl::table::TableStream<Table_t> stream;
+  stream.Init(table);
+  BOOST_CHECK_EQUAL(stream.n_entries(), table->n_entries());
+  BOOST_CHECK_EQUAL(CompareBlocks(&stream, *table, 0), 1);
+  boost::filesystem::remove(filename);
+}
@@ -0,0 +1,564 @@
+/*
+Copyright © 2010, Ismion Inc
+All rights reserved.
+http://www.ismion.com/
+
+Redistribution and use in source and binary forms, with or without
+modification IS NOT permitted without specific prior written
+permission. Further, neither the name of the company, Ismion
+Inc, nor the names of its employees may be used to endorse or promote
+products derived from this software without specific prior written
+permission.
+
+THIS SOFTWARE IS PROVIDED BY THE Ismion Inc "AS IS" AND ANY
+EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COMPANY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define BOOST_TEST_MAIN
+#include <fstream>
+#include "boost/test/unit_test.hpp"
+#include "boost/bind.hpp"
+#include "boost/date_time/posix_time/posix_time.hpp"
+#include "boost/program_options.hpp"
+#include "fastlib/base/base.h"
+#include "fastlib/table/table_dev.h"
+#include "fastlib/data/multi_dataset_dev.h"
+#include "fastlib/workspace/workspace.h"
+#include "fastlib/workspace/workspace_defs.h"
+#include "fastlib/workspace/arguments.h"
+#include "fastlib/metric_kernel/lmetric.h"
+#include "mlpack/clustering/kmeans_stream.h"
+
+namespace {
+  typedef fl::ws::WorkSpace::DefaultTable_t Table_t;
+
+  /**
+   * @brief counts the finished tasks, the pool does not tell 
+   *        when the running tasks are done
+   */
+  class TaskCounter {
+    public:
+      TaskCounter() : n_done_(0) {
+      }
+      void Done() {
+        boost::mutex::scoped_lock lock(mutex_);
+        n_done_++;
+        done_.notify_all();
+      }
+      void Wait(int n_tasks) {
+        boost::mutex::scoped_lock lock(mutex_);
+        while (n_done_<n_tasks) {
+          done_.wait(lock);
+        }
+      }
+    private:
+      boost::mutex mutex_;
+      boost::condition_variable done_;
+      int n_done_;
+  };
+
+  /**
+   * @brief the paged tables of a workspace stay in its temp directory,
+   *        the tests start from a clean one
+   */
+  std::string CleanWorkSpaceName(const std::string &name) {
+    boost::filesystem::remove_all(
+        boost::filesystem::temp_directory_path()/name);
+    return name;
+  }
+
+  boost::shared_ptr<Table_t> MakeTable(const std::string &name,
+      index_t n_entries, index_t n_attributes, double value) {
+    std::vector<index_t> dense_sizes(1, n_attributes);
+    std::vector<index_t> sparse_sizes;
+    boost::shared_ptr<Table_t> table(new Table_t());
+    table->Init(name, dense_sizes, sparse_sizes, n_entries);
+    Table_t::Point_t point;
+    for(index_t i=0; i<n_entries; ++i) {
+      table->get(i, &point);
+      for(index_t j=0; j<n_attributes; ++j) {
+        point.set(j, value);
+      }
+    }
+    return table;
+  }
+
+  void ReadTask(fl::ws::WorkSpace *ws, const std::string name, 
+      int n_attachments, double expected, 
+      TaskCounter *counter, int *n_errors, boost::mutex *errors_mutex) {
+    int n_local_errors=0;
+    for(int i=0; i<n_attachments; ++i) {
+      boost::shared_ptr<Table_t> table;
+      ws->Attach(name, &table);
+      // a little work on the table, like a real task
+      Table_t::Point_t point;
+      for(index_t j=0; j<10; ++j) {
+        table->get((i+j) % table->n_entries(), &point);
+        if (point[0]!=expected) {
+          n_local_errors++;
+        }
+      }
+    }
+    {
+      boost::mutex::scoped_lock lock(*errors_mutex);
+      *n_errors+=n_local_errors;
+    }
+    counter->Done();
+  }
+
+  void ProduceTask(fl::ws::WorkSpace *ws, const std::string name, 
+      double value, TaskCounter *counter) {
+    std::vector<index_t> dense_sizes(1, 3);
+    std::vector<index_t> sparse_sizes;
+    boost::shared_ptr<Table_t> table;
+    ws->Attach(name, dense_sizes, sparse_sizes, 100, &table);
+    // give the readers the time to wait on the table
+    boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+    Table_t::Point_t point;
+    for(index_t i=0; i<table->n_entries(); ++i) {
+      table->get(i, &point);
+      for(index_t j=0; j<3; ++j) {
+        point.set(j, value);
+      }
+    }
+    ws->Purge(name);
+    ws->Detach(name);
+    counter->Done();
+  }
+
+  void RecordTask(std::vector<std::string> *order, boost::mutex *order_mutex,
+      const std::string name) {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    boost::mutex::scoped_lock lock(*order_mutex);
+    order->push_back(name);
+  }
+
+  void ReadValueTask(fl::ws::WorkSpace *ws, const std::string name,
+      double *value) {
+    boost::shared_ptr<Table_t> table;
+    ws->Attach(name, &table);
+    Table_t::Point_t point;
+    table->get(0, &point);
+    *value=point[0];
+    ws->Detach(name);
+  }
+
+  void WriteValueTask(fl::ws::WorkSpace *ws, const std::string name,
+      double value) {
+    boost::shared_ptr<Table_t> table;
+    ws->Attach(name, &table, "w");
+    Table_t::Point_t point;
+    for(index_t i=0; i<table->n_entries(); ++i) {
+      table->get(i, &point);
+      for(index_t j=0; j<table->n_attributes(); ++j) {
+        point.set(j, value);
+      }
+    }
+    ws->Purge(name, true);
+    ws->Detach(name);
+  }
+
+  void ScaleTask(fl::ws::WorkSpace *ws, const std::string input, 
+      const std::string output, double factor) {
+    boost::shared_ptr<Table_t> input_table;
+    ws->Attach(input, &input_table);
+    std::vector<index_t> dense_sizes(1, input_table->n_attributes());
+    std::vector<index_t> sparse_sizes;
+    boost::shared_ptr<Table_t> output_table;
+    ws->Attach(output, dense_sizes, sparse_sizes, 
+        input_table->n_entries(), &output_table);
+    Table_t::Point_t point1, point2;
+    for(index_t i=0; i<input_table->n_entries(); ++i) {
+      input_table->get(i, &point1);
+      output_table->get(i, &point2);
+      for(index_t j=0; j<input_table->n_attributes(); ++j) {
+        point2.set(j, point1[j]*factor);
+      }
+    }
+    ws->Purge(output);
+    ws->Detach(output);
+    ws->Purge(input);
+    ws->Detach(input);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE(TestSuiteWorkSpace)
+
+// many read only tasks attach the same table, they must not be 
+// serialized. This is also a micro benchmark for the contention on 
+// the workspace, it reports the attachments per second for every
+// number of threads
+BOOST_AUTO_TEST_CASE(TestConcurrentReaders) {
+  const int n_tasks=64;
+  const int n_attachments=20000;
+  for(int n_threads=1; n_threads<=8; n_threads*=2) {
+    // the workspace is destroyed first, it joins the pool
+    TaskCounter counter;
+    int n_errors=0;
+    boost::mutex errors_mutex;
+    fl::ws::WorkSpace ws(CleanWorkSpaceName("workspace_test_readers"));
+    ws.set_schedule_mode(0);
+    ws.set_pool(n_threads);
+    ws.LoadTable("references", MakeTable("references", 1000, 3, 1.5));
+    boost::posix_time::ptime start=
+      boost::posix_time::microsec_clock::universal_time();
+    for(int i=0; i<n_tasks; ++i) {
+      ws.schedule(boost::bind(&ReadTask, &ws, std::string("references"), 
+            n_attachments, 1.5, &counter, &n_errors, &errors_mutex));
+    }
+    counter.Wait(n_tasks);
+    double seconds=(boost::posix_time::microsec_clock::universal_time()
+      -start).total_microseconds()/1e6;
+    BOOST_CHECK_EQUAL(n_errors, 0);
+    BOOST_TEST_MESSAGE("threads: "<<n_threads<<" attachments/sec: "
+        <<n_tasks*n_attachments/seconds);
+    ws.WaitAllTasks();
+  }
+}
+
+// readers that attach a table before it is produced wait until 
+// the producer purges it, then they page it in
+BOOST_AUTO_TEST_CASE(TestReadersWaitForProducer) {
+  TaskCounter counter;
+  int n_errors=0;
+  boost::mutex errors_mutex;
+  fl::ws::WorkSpace ws(CleanWorkSpaceName("workspace_test_producer"));
+  ws.set_schedule_mode(0);
+  ws.set_pool(4);
+  const int n_readers=3;
+  for(int i=0; i<n_readers; ++i) {
+    ws.schedule(boost::bind(&ReadTask, &ws, std::string("result"), 
+          100, 2.5, &counter, &n_errors, &errors_mutex));
+  }
+  ws.schedule(boost::bind(&ProduceTask, &ws, std::string("result"), 
+        2.5, &counter));
+  counter.Wait(n_readers+1);
+  BOOST_CHECK_EQUAL(n_errors, 0);
+  BOOST_CHECK(ws.IsTableAvailable("result"));
+
+  // a writer gets the table exclusively until it purges it
+  boost::shared_ptr<Table_t> table;
+  ws.Attach("result", &table, "w");
+  BOOST_CHECK(ws.IsTableAvailable("result")==false);
+  Table_t::Point_t point;
+  for(index_t i=0; i<table->n_entries(); ++i) {
+    table->get(i, &point);
+    point.set(0, 3.5);
+  }
+  ws.Purge("result", true);
+  BOOST_CHECK(ws.IsTableAvailable("result"));
+  ws.Attach("result", &table);
+  table->get(0, &point);
+  BOOST_CHECK_EQUAL(point[0], 3.5);
+  ws.WaitAllTasks();
+}
+
+// the task graph runs the tasks in the order of their tables, 
+// not in the order they were scheduled
+BOOST_AUTO_TEST_CASE(TestTaskGraph) {
+  std::vector<std::string> order;
+  boost::mutex order_mutex;
+  fl::ws::WorkSpace ws(CleanWorkSpaceName("workspace_test_graph"));
+  ws.set_schedule_mode(3);
+  ws.set_pool(3);
+  std::vector<std::string> args_c;
+  args_c.push_back("--x_in=b");
+  args_c.push_back("--y_out=c");
+  ws.schedule(boost::bind(&RecordTask, &order, &order_mutex, 
+        std::string("c")), args_c);
+  std::vector<std::string> args_b;
+  args_b.push_back("--x_in=a");
+  args_b.push_back("--y_out=b");
+  ws.schedule(boost::bind(&RecordTask, &order, &order_mutex, 
+        std::string("b")), args_b);
+  std::vector<std::string> args_a;
+  args_a.push_back("--y_out=a");
+  args_a.push_back("--k=3");
+  ws.schedule(boost::bind(&RecordTask, &order, &order_mutex, 
+        std::string("a")), args_a);
+  ws.WaitAllTasks();
+  BOOST_CHECK_EQUAL(order.size(), 3);
+  BOOST_CHECK(order[0]=="a" && order[1]=="b" && order[2]=="c");
+}
+
+// a task that writes a table waits for the tasks that were scheduled 
+// before it and read the table, even if they can not start yet
+BOOST_AUTO_TEST_CASE(TestTaskGraphWriteAfterRead) {
+  std::vector<std::string> order;
+  boost::mutex order_mutex;
+  fl::ws::WorkSpace ws(CleanWorkSpaceName("workspace_test_war"));
+  ws.set_schedule_mode(3);
+  ws.set_pool(3);
+  ws.LoadTable("t", MakeTable("t", 10, 2, 1.0));
+  std::vector<std::string> args_gate;
+  args_gate.push_back("--y_out=gate");
+  ws.schedule(boost::bind(&RecordTask, &order, &order_mutex, 
+        std::string("gate")), args_gate);
+  double value=0;
+  std::vector<std::string> args_read;
+  args_read.push_back("--gate_in=gate");
+  args_read.push_back("--x_in=t");
+  ws.schedule(boost::bind(&ReadValueTask, &ws, std::string("t"), &value),
+      args_read);
+  std::vector<std::string> args_write;
+  args_write.push_back("--x_out=t");
+  ws.schedule(boost::bind(&WriteValueTask, &ws, std::string("t"), 2.0),
+      args_write);
+  ws.WaitAllTasks();
+  BOOST_CHECK_EQUAL(value, 1.0);
+  boost::shared_ptr<Table_t> t;
+  ws.Attach("t", &t);
+  Table_t::Point_t point;
+  t->get(9, &point);
+  BOOST_CHECK_EQUAL(point[1], 2.0);
+}
+
+// a reader of the first version of a table runs between the first
+// and the second writer, also when it is scheduled before the first
+// writer and waits for it. A single worker pops the task it released
+// last first, so without that order the second writer would run
+// before the reader
+BOOST_AUTO_TEST_CASE(TestTaskGraphWriteAfterWaitingRead) {
+  for(int reader_first=0; reader_first<2; ++reader_first) {
+    TaskCounter counter;
+    fl::ws::WorkSpace ws(CleanWorkSpaceName("workspace_test_wawr"));
+    ws.set_schedule_mode(3);
+    ws.set_pool(1);
+    double value=0;
+    std::vector<std::string> args_read;
+    args_read.push_back("--x_in=t");
+    if (reader_first) {
+      ws.schedule(boost::bind(&ReadValueTask, &ws, std::string("t"), 
+            &value), args_read);
+    }
+    std::vector<std::string> args_first;
+    args_first.push_back("--x_out=t");
+    ws.schedule(boost::bind(&ProduceTask, &ws, std::string("t"), 1.0,
+          &counter), args_first);
+    if (reader_first==false) {
+      ws.schedule(boost::bind(&ReadValueTask, &ws, std::string("t"), 
+            &value), args_read);
+    }
+    std::vector<std::string> args_second;
+    args_second.push_back("--x_out=t");
+    ws.schedule(boost::bind(&WriteValueTask, &ws, std::string("t"), 2.0),
+        args_second);
+    ws.WaitAllTasks();
+    BOOST_CHECK_EQUAL(value, 1.0);
+    boost::shared_ptr<Table_t> t;
+    ws.Attach("t", &t);
+    Table_t::Point_t point;
+    t->get(99, &point);
+    BOOST_CHECK_EQUAL(point[2], 2.0);
+  }
+}
+
+// a pipeline on real tables, the consumers are scheduled first 
+// and a single worker must never block on them
+BOOST_AUTO_TEST_CASE(TestTaskGraphPipeline) {
+  fl::ws::WorkSpace ws(CleanWorkSpaceName("workspace_test_pipeline"));
+  ws.set_schedule_mode(3);
+  ws.set_pool(1);
+  ws.LoadTable("x", MakeTable("x", 100, 2, 1.0));
+  // this one does not declare its tables, its worker runs the others 
+  // while it waits for z
+  ws.schedule(boost::bind(&ScaleTask, &ws, std::string("z"), 
+        std::string("w"), 0.5));
+  std::vector<std::string> args_z;
+  args_z.push_back("--references_in=y");
+  args_z.push_back("--result_out=z");
+  ws.schedule(boost::bind(&ScaleTask, &ws, std::string("y"), 
+        std::string("z"), 3.0), args_z);
+  std::vector<std::string> args_y;
+  args_y.push_back("--references_in=x");
+  args_y.push_back("--result_out=y");
+  ws.schedule(boost::bind(&ScaleTask, &ws, std::string("x"), 
+        std::string("y"), 2.0), args_y);
+  ws.WaitAllTasks();
+  boost::shared_ptr<Table_t> z;
+  ws.Attach("z", &z);
+  Table_t::Point_t point;
+  z->get(99, &point);
+  BOOST_CHECK_EQUAL(point[1], 6.0);
+  boost::shared_ptr<Table_t> w;
+  ws.Attach("w", &w);
+  w->get(0, &point);
+  BOOST_CHECK_EQUAL(point[0], 3.0);
+}
+
+// a paged out table comes back the same with every spill codec
+BOOST_AUTO_TEST_CASE(TestSpillCodecs) {
+  const char *codecs[]={"binary", "archive", "gzip"};
+  for(int c=0; c<3; ++c) {
+    BOOST_TEST_MESSAGE("spill codec: "<<codecs[c]);
+    fl::ws::WorkSpace ws(CleanWorkSpaceName("workspace_test_spill"));
+    ws.set_spill_codec(codecs[c]);
+    boost::shared_ptr<Table_t> table=MakeTable("references", 500, 4, 0.0);
+    Table_t::Point_t point;
+    for(index_t i=0; i<table->n_entries(); ++i) {
+      table->get(i, &point);
+      point.set(i % 4, i*0.5);
+    }
+    fl::ws::WorkSpace::TableVector<double>::Point_t vector_point;
+    boost::shared_ptr<fl::ws::WorkSpace::TableVector<double> > 
+      vector(new fl::ws::WorkSpace::TableVector<double>());
+    vector->Init(10);
+    for(index_t i=0; i<vector->n_entries(); ++i) {
+      vector->get(i, &vector_point);
+      vector_point.set(0, -i);
+    }
+    ws.LoadTable("references", table);
+    ws.LoadTable("vector", vector);
+    ws.Purge("references", true);
+    ws.Purge("vector", true);
+    table.reset();
+    vector.reset();
+    // twice, the second time the table is paged out again
+    for(int pass=0; pass<2; ++pass) {
+      ws.Attach("references", &table);
+      BOOST_CHECK_EQUAL(table->n_entries(), 500);
+      BOOST_CHECK_EQUAL(table->filename(), "references");
+      for(index_t i=0; i<table->n_entries(); ++i) {
+        table->get(i, &point);
+        BOOST_CHECK_EQUAL(point[i % 4], i*0.5);
+        BOOST_CHECK_EQUAL(point[(i+1) % 4], 0.0);
+      }
+      ws.Attach("vector", &vector);
+      for(index_t i=0; i<vector->n_entries(); ++i) {
+        vector->get(i, &vector_point);
+        BOOST_CHECK_EQUAL(vector_point[0], -i);
+      }
+      ws.Purge("references", true);
+      ws.Purge("vector", true);
+    }
+  }
+}
+
+// a streamed table is not loaded, its points are counted when 
+// somebody asks for them
+BOOST_AUTO_TEST_CASE(TestStreamedTableInfo) {
+  std::string filename=(boost::filesystem::temp_directory_path()
+      /"workspace_test_stream.csv").string();
+  {
+    std::ofstream fout(filename.c_str());
+    for(int i=0; i<5000; ++i) {
+      fout<<i<<","<<i*0.5<<","<<-i<<"\n";
+    }
+  }
+  fl::ws::WorkSpace ws(CleanWorkSpaceName("workspace_test_stream"));
+  ws.set_stream_mode(1<<12, 1);
+  ws.LoadAllTables(std::vector<std::string>(1, "--references_in="+filename));
+  BOOST_CHECK(ws.IsStreamed(filename));
+  index_t n_entries=0;
+  index_t n_attributes=0;
+  ws.GetTableInfo(filename, &n_entries, &n_attributes, NULL, NULL);
+  BOOST_CHECK_EQUAL(n_entries, 5000);
+  BOOST_CHECK_EQUAL(n_attributes, 3);
+  boost::shared_ptr<fl::table::TableStream<Table_t> > stream;
+  ws.AttachStream(filename, &stream);
+  boost::shared_ptr<Table_t> block;
+  index_t n_blocks=0;
+  index_t n_streamed=0;
+  while (stream->NextBlock(&block)) {
+    n_streamed+=block->n_entries();
+    n_blocks++;
+  }
+  BOOST_CHECK(n_blocks>1);
+  BOOST_CHECK_EQUAL(n_streamed, 5000);
+  boost::filesystem::remove(filename);
+}
+
+// kmeans over a table streamed in blocks finds the same centroids 
+// and memberships as over the same table in memory
+BOOST_AUTO_TEST_CASE(TestKMeansStream) {
+  std::string filename=(boost::filesystem::temp_directory_path()
+      /"workspace_test_kmeans.csv").string();
+  {
+    std::ofstream fout(filename.c_str());
+    for(int i=0; i<3000; ++i) {
+      fout<<(i%3)*10+fl::math::Random(-1.0, 1.0)<<","
+        <<fl::math::Random(-1.0, 1.0)<<"\n";
+    }
+  }
+  fl::math::LMetric<2> metric;
+  std::vector<std::vector<double> > centroids(2);
+  std::vector<std::vector<index_t> > memberships(2);
+  for(int streamed=0; streamed<2; ++streamed) {
+    fl::ws::WorkSpace ws(CleanWorkSpaceName("workspace_test_kmeans"));
+    if (streamed==1) {
+      ws.set_stream_mode(1<<12, 2);
+    }
+    ws.LoadAllTables(std::vector<std::string>(1, "--references_in="+filename));
+    BOOST_CHECK_EQUAL(ws.IsStreamed(filename), streamed==1);
+    Table_t cent_table;
+    cent_table.Init(std::vector<index_t>(1, 2), std::vector<index_t>(), 3);
+    Table_t::Point_t cent;
+    for(index_t k=0; k<3; ++k) {
+      cent_table.get(k, &cent);
+      cent.set(0, k*8.0+1);
+      cent.set(1, 0.5);
+    }
+    double distortion=0;
+    fl::ml::KMeansStream::Run<Table_t>(filename, &ws, metric, 100, 0, 
+        &cent_table, &distortion);
+    BOOST_CHECK(distortion<1);
+    Table_t memberships_table;
+    memberships_table.Init(std::vector<index_t>(1, 1), 
+        std::vector<index_t>(), 3000);
+    fl::ml::KMeansStream::Assign<Table_t>(filename, &ws, metric, 
+        cent_table, &memberships_table, static_cast<Table_t*>(NULL));
+    for(index_t k=0; k<3; ++k) {
+      cent_table.get(k, &cent);
+      centroids[streamed].push_back(cent[0]);
+      centroids[streamed].push_back(cent[1]);
+    }
+    Table_t::Point_t mpoint;
+    for(index_t i=0; i<3000; ++i) {
+      memberships_table.get(i, &mpoint);
+      memberships[streamed].push_back(mpoint[0]);
+    }
+  }
+  for(size_t i=0; i<centroids[0].size(); ++i) {
+    BOOST_CHECK_CLOSE(centroids[0][i], centroids[1][i], 1e-9);
+  }
+  BOOST_CHECK(memberships[0]==memberships[1]);
+  BOOST_CHECK_EQUAL(memberships[1][4], 1);
+  boost::filesystem::remove(filename);
+}
+
+// the programs parse their arguments strictly, the options the 
+// workspace reads must not be rejected as unknown
+BOOST_AUTO_TEST_CASE(TestWorkSpaceOptions) {
+  boost::program_options::options_description desc("Available options");
+  desc.add_options()(
+    "references_in",
+    boost::program_options::value<std::string>(),
+    "the references"
+  );
+  fl::ws::AddWorkSpaceOptions(&desc);
+  std::vector<std::string> args;
+  args.push_back("--references_in=r");
+  args.push_back("--index_threads=4");
+  args.push_back("--spill_codec=gzip");
+  args.push_back("--stream_block_mb=16");
+  args.push_back("--stream_window=2");
+  boost::program_options::variables_map vm;
+  boost::program_options::command_line_parser clp(args);
+  clp.style(boost::program_options::command_line_style::default_style
+     ^boost::program_options::command_line_style::allow_guessing );
+  BOOST_CHECK_NO_THROW(
+      boost::program_options::store(clp.options(desc).run(), vm));
+  BOOST_CHECK_EQUAL(vm["index_threads"].as<int>(), 4);
+  BOOST_CHECK_EQUAL(vm["spill_codec"].as<std::string>(), "gzip");
+}
+
+BOOST_AUTO_TEST_SUITE_END()